@@ -231,6 +231,9 @@ help(void) {
 "                 +[no]multiline      (Print records in an expanded format)\n"
 "                 +[no]onesoa         (AXFR prints only one soa record)\n"
 "                 +[no]keepopen       (Keep the TCP socket open between queries)\n"
+"                 +[no]window=###     (Pipeline up to ### queries)\n"
+"                 +[no]connections=## (Connections per server, +tcp +window)\n"
+"                 +[no]ordered        (Print +window results in input order)\n"
 "        global d-opts and servers (before host name) affect all queries.\n"
 "        local d-opts and servers (after host name) affect only that lookup.\n"
 "        -h                           (print help and exit)\n"
@@ -840,11 +843,34 @@ plus_option(char *option, isc_boolean_t is_batchfile,
 			FULLCHECK("cmd");
 			printcmd = state;
 			break;
-		case 'o': /* comments */
-			FULLCHECK("comments");
-			lookup->comments = state;
-			if (lookup == default_lookup)
-				pluscomm = state;
+		case 'o':
+			switch (cmd[2]) {
+			case '\0': /* +co is still comments */
+			case 'm': /* comments */
+				FULLCHECK("comments");
+				lookup->comments = state;
+				if (lookup == default_lookup)
+					pluscomm = state;
+				break;
+			case 'n': /* connections */
+				FULLCHECK("connections");
+				if (is_batchfile)
+					break;
+				if (!state) {
+					pipeline_connections = 1;
+					break;
+				}
+				if (value == NULL)
+					goto need_value;
+				result = parse_uint(&num, value, 256,
+						    "connections");
+				if (result != ISC_R_SUCCESS || num == 0)
+					fatal("Couldn't parse connections");
+				pipeline_connections = num;
+				break;
+			default:
+				goto invalid_option;
+			}
 			break;
 		default:
 			goto invalid_option;
@@ -964,8 +990,18 @@ plus_option(char *option, isc_boolean_t is_batchfile,
 		}
 		break;
 	case 'o':
-		FULLCHECK("onesoa");
-		onesoa = state;
+		switch (cmd[1]) {
+		case 'n': /* onesoa */
+			FULLCHECK("onesoa");
+			onesoa = state;
+			break;
+		case 'r': /* ordered */
+			FULLCHECK("ordered");
+			pipeline_ordered = state;
+			break;
+		default:
+			goto invalid_option;
+		}
 		break;
 	case 'q':
 		switch (cmd[1]) {
@@ -1190,6 +1226,21 @@ plus_option(char *option, isc_boolean_t is_batchfile,
 			lookup->tcp_mode_set = ISC_TRUE;
 		}
 		break;
+	case 'w': /* window */
+		FULLCHECK("window");
+		if (is_batchfile)
+			break;
+		if (!state) {
+			pipeline_window = 0;
+			break;
+		}
+		if (value == NULL)
+			goto need_value;
+		result = parse_uint(&num, value, 65535, "window");
+		if (result != ISC_R_SUCCESS)
+			fatal("Couldn't parse window");
+		pipeline_window = num;
+		break;
 	default:
 	invalid_option:
 	need_value:
@@ -1806,6 +1857,50 @@ parse_args(isc_boolean_t is_batchfile, isc_boolean_t config_only,
 		destroy_lookup(lookup);
 }
 
+/*%
+ * Callback from dighost.c to read more of the batch file when running
+ * lookups with +window.  Returns ISC_FALSE, and closes the file, at
+ * its end.
+ */
+isc_boolean_t
+dig_nextbatch(void) {
+	char batchline[MXNAME];
+	int bargc;
+	char *bargv[16];
+	char *input;
+	int i;
+
+	if (batchname == NULL)
+		return (ISC_FALSE);
+
+	while (fgets(batchline, sizeof(batchline), batchfp) != 0) {
+		debug("batch line %s", batchline);
+		if (batchline[0] == '\r' || batchline[0] == '\n'
+		    || batchline[0] == '#' || batchline[0] == ';')
+			continue;
+		bargc = 1;
+		input = batchline;
+		bargv[bargc] = next_token(&input, " \t\r\n");
+		while ((bargv[bargc] != NULL) && (bargc < 14)) {
+			bargc++;
+			bargv[bargc] = next_token(&input, " \t\r\n");
+		}
+
+		bargv[0] = argv0;
+
+		for(i = 0; i < bargc; i++)
+			debug("batch argv %d: %s", i, bargv[i]);
+		parse_args(ISC_TRUE, ISC_FALSE, bargc, (char **)bargv);
+		return (ISC_TRUE);
+	}
+
+	batchname = NULL;
+	if (batchfp != thread_stdin)
+		fclose(batchfp);
+	batchfp = NULL;
+	return (ISC_FALSE);
+}
+
 /*
  * Callback from dighost.c to allow program-specific shutdown code.
  * Here, we're possibly reading from a batch file, then shutting down
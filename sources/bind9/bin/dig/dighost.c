@@ -128,8 +128,11 @@ __thread isc_boolean_t
 	showsearch = ISC_FALSE,
 	qr = ISC_FALSE,
 	is_dst_up = ISC_FALSE,
-	keep_open = ISC_FALSE;
+	keep_open = ISC_FALSE,
+	pipeline_ordered = ISC_TRUE;
 __thread in_port_t port = 53;
+__thread unsigned int pipeline_window = 0;
+__thread unsigned int pipeline_connections = 1;
 unsigned __thread int timeout = 0;
 unsigned __thread int extrabytes;
 __thread isc_mem_t *mctx = NULL;
@@ -3818,10 +3821,1275 @@ onrun_callback(isc_task_t *task, isc_event_t *event) {
 
 	isc_event_free(&event);
 	LOCK_LOOKUP;
-	start_lookup();
+	if (pipeline_window > 0)
+		start_pipeline();
+	else
+		start_lookup();
 	UNLOCK_LOOKUP;
 }
 
+/*
+ * Pipelined lookups (+window).
+ *
+ * The lookups on the lookup list, refilled from the batch file as it
+ * drains, are sent without waiting for each other: up to
+ * 'pipeline_window' queries are in flight at once, and responses are
+ * matched to their lookup by query ID.  Over UDP the queries share a
+ * few sockets and the source address of a response must match too.
+ * Over TCP (+tcp) they share up to 'pipeline_connections' persistent
+ * connections to each server, and responses may come back in any
+ * order; queries on a connection that is lost are sent again.  Each
+ * query has its own timeout and retries, going round the lookup's
+ * servers.  Results are printed in the order the lookups were read, or
+ * as they complete if 'pipeline_ordered' is false, and a summary of
+ * the rate and latency goes to stderr at the end.
+ *
+ * Lookups that need more than one exchange (+trace, +nssearch, zone
+ * transfers) are reported as unsupported rather than pipelined, and
+ * the search list is not walked.
+ */
+
+#define PIPELINE_SOCKQUERIES	256	/*%< window per socket */
+#define PIPELINE_MAXSOCKETS	16	/*%< sockets per address family */
+#define PIPELINE_BACKLOG	8	/*%< unprinted lookups, in windows */
+#define PIPELINE_TICK		50	/*%< ms between timeout scans */
+
+typedef struct pipeline_query pipeline_query_t;
+typedef struct pipeline_socket pipeline_socket_t;
+
+struct pipeline_query {
+	dig_query_t		query;		/* for the print callbacks */
+	isc_result_t		result;
+	isc_boolean_t		done;
+	isc_boolean_t		freeing;
+	unsigned int		tries;
+	unsigned int		sends;		/* sends not yet done */
+	pipeline_socket_t	*psock;
+	dns_messageid_t		id;
+	isc_region_t		wire;
+	isc_region_t		answer;
+	isc_sockaddr_t		from;
+	ISC_LINK(pipeline_query_t) link;	/* in start order */
+	ISC_LINK(pipeline_query_t) flink;	/* in flight, by send time */
+	ISC_LINK(pipeline_query_t) wlink;	/* waiting for connect */
+};
+
+struct pipeline_socket {
+	isc_socket_t		*sock;
+	int			pf;
+	unsigned char		*recvspace;
+	pipeline_query_t	**ids;		/* in flight, by query ID */
+	unsigned int		nqueries;	/* ... how many */
+	/* TCP only. */
+	isc_boolean_t		tcp;
+	isc_boolean_t		connected;
+	isc_boolean_t		closed;
+	unsigned int		events;		/* connect and recvs */
+	isc_sockaddr_t		peer;
+	unsigned char		lenbuf[2];
+	ISC_LIST(pipeline_query_t) waiting;
+	ISC_LINK(pipeline_socket_t) link;
+};
+
+typedef struct pipeline {
+	unsigned int		window;
+	unsigned int		backlog;
+	isc_boolean_t		eof;
+	isc_boolean_t		finishing;
+	isc_timer_t		*timer;
+	pipeline_socket_t	socks[2][PIPELINE_MAXSOCKETS];
+	unsigned int		nsocks[2];
+	unsigned int		nextsock[2];
+	ISC_LIST(pipeline_socket_t) conns;	/* TCP */
+	unsigned int		active;		/* sockets receiving */
+	unsigned int		sends;
+	ISC_LIST(pipeline_query_t) queries;
+	unsigned int		nqueries;
+	ISC_LIST(pipeline_query_t) inflight;
+	unsigned int		ninflight;
+	struct {
+		char		name[MXNAME];
+		isc_sockaddr_t	address;
+	}			servers[MXSERV];
+	unsigned int		nservers;
+	isc_time_t		start;
+	/* Statistics. */
+	isc_uint64_t		lookups;
+	isc_uint64_t		answers;
+	isc_uint64_t		timeouts;
+	isc_uint64_t		errors;
+	isc_uint64_t		resends;
+	isc_uint64_t		truncated;
+	isc_uint64_t		unexpected;
+	isc_uint64_t		connects;
+	isc_uint64_t		lost;
+	isc_uint64_t		rcodes[16];
+	isc_uint32_t		*latency;	/* microseconds */
+	unsigned int		nlatency;
+	unsigned int		latencysize;
+} pipeline_t;
+
+static __thread pipeline_t *pipeline = NULL;
+
+static void
+pipeline_fill(void);
+
+static void
+pipeline_done(void);
+
+static void
+pipeline_send(pipeline_query_t *pq);
+
+static void
+pipeline_printmessage(dig_query_t *query, dns_message_t *msg,
+		      int bytes, isc_sockaddr_t *from)
+{
+	if (strcmp(progname, "dig") == 0) {
+		dig_printmessage(query, msg, ISC_TRUE);
+		dig_received(bytes, from, query);
+	} else if (strcmp(progname, "host") == 0) {
+		host_printmessage(query, msg, ISC_TRUE);
+		host_received(bytes, from, query);
+	} else if (strcmp(progname, "nslookup") == 0) {
+		nslookup_printmessage(query, msg, ISC_TRUE);
+		nslookup_received(bytes, from, query);
+	}
+}
+
+/*%
+ * Print a response, with the checks recv_done() makes on it.
+ */
+static void
+pipeline_printanswer(pipeline_query_t *pq) {
+	dig_lookup_t *l = pq->query.lookup;
+	dns_message_t *msg = NULL;
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	isc_buffer_t b;
+	isc_result_t result;
+	unsigned int parseflags;
+
+	isc_buffer_init(&b, pq->answer.base, pq->answer.length);
+	isc_buffer_add(&b, pq->answer.length);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+	check_result(result, "dns_message_create");
+	if (key != NULL) {
+		if (l->querysig == NULL) {
+			result = dns_message_getquerytsig(l->sendmsg, mctx,
+							  &l->querysig);
+			check_result(result, "dns_message_getquerytsig");
+		}
+		result = dns_message_setquerytsig(msg, l->querysig);
+		check_result(result, "dns_message_setquerytsig");
+		result = dns_message_settsigkey(msg, key);
+		check_result(result, "dns_message_settsigkey");
+	}
+
+	parseflags = DNS_MESSAGEPARSE_PRESERVEORDER;
+	if (l->besteffort) {
+		parseflags |= DNS_MESSAGEPARSE_BESTEFFORT;
+		parseflags |= DNS_MESSAGEPARSE_IGNORETRUNCATION;
+	}
+	result = dns_message_parse(msg, &b, parseflags);
+	if (result == DNS_R_RECOVERABLE) {
+		fprintf(thread_stdout, ";; Warning: Message parser reports "
+			"malformed message packet.\n");
+		result = ISC_R_SUCCESS;
+	}
+	if (result != ISC_R_SUCCESS) {
+		fprintf(thread_stdout, ";; Got bad packet: %s\n",
+			isc_result_totext(result));
+		hex_dump(&b);
+		dns_message_destroy(&msg);
+		return;
+	}
+
+	for (result = dns_message_firstname(msg, DNS_SECTION_QUESTION);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(msg, DNS_SECTION_QUESTION)) {
+		name = NULL;
+		dns_message_currentname(msg, DNS_SECTION_QUESTION, &name);
+		for (rdataset = ISC_LIST_HEAD(name->list);
+		     rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link)) {
+			char namestr[DNS_NAME_FORMATSIZE];
+			char typebuf[DNS_RDATATYPE_FORMATSIZE];
+			char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+			if (l->rdtype == rdataset->type &&
+			    l->rdclass == rdataset->rdclass &&
+			    dns_name_equal(l->name, name))
+				continue;
+			dns_name_format(name, namestr, sizeof(namestr));
+			dns_rdatatype_format(rdataset->type, typebuf,
+					     sizeof(typebuf));
+			dns_rdataclass_format(rdataset->rdclass, classbuf,
+					      sizeof(classbuf));
+			fprintf(thread_stdout, ";; Question section mismatch: "
+				"got %s/%s/%s\n", namestr, typebuf, classbuf);
+		}
+	}
+
+	if ((msg->flags & DNS_MESSAGEFLAG_TC) != 0 && !l->ignore &&
+	    !l->tcp_mode)
+		fprintf(thread_stdout, ";; Truncated, not retrying in TCP "
+			"mode with +window.\n");
+
+	if (key != NULL) {
+		result = dns_tsig_verify(&b, msg, NULL, NULL);
+		if (result != ISC_R_SUCCESS) {
+			fprintf(thread_stdout, ";; Couldn't verify signature: "
+				"%s\n", isc_result_totext(result));
+			validated = ISC_FALSE;
+		}
+	}
+
+	extrabytes = isc_buffer_remaininglength(&b);
+	pipeline_printmessage(&pq->query, msg, pq->answer.length, &pq->from);
+	dns_message_destroy(&msg);
+}
+
+static void
+pipeline_free(pipeline_query_t *pq) {
+	unsigned char *base;
+
+	if (pq->wire.base != NULL) {
+		/* The wire is preceded by its length. */
+		base = pq->wire.base - 2;
+		isc_mem_put(mctx, base, pq->wire.length + 2);
+		pq->wire.base = NULL;
+	}
+	if (pq->answer.base != NULL) {
+		isc_mem_put(mctx, pq->answer.base, pq->answer.length);
+		pq->answer.base = NULL;
+	}
+	if (pq->query.lookup != NULL) {
+		destroy_lookup(pq->query.lookup);
+		pq->query.lookup = NULL;
+	}
+	/* The sends still refer to the wire region. */
+	if (pq->sends > 0)
+		pq->freeing = ISC_TRUE;
+	else
+		isc_mem_put(mctx, pq, sizeof(*pq));
+}
+
+/*%
+ * Print the result of a finished lookup and free it.
+ */
+static void
+pipeline_print(pipeline_query_t *pq) {
+	dig_lookup_t *l = pq->query.lookup;
+
+	INSIST(pq->done);
+
+	ISC_LIST_UNLINK(pipeline->queries, pq, link);
+	pipeline->nqueries--;
+
+	switch (pq->result) {
+	case ISC_R_SUCCESS:
+		pipeline_printanswer(pq);
+		break;
+	case ISC_R_TIMEDOUT:
+		if (l->cmdline[0] != 0)
+			fputs(l->cmdline, thread_stdout);
+		fprintf(thread_stdout, ";; connection timed out; no servers "
+			"could be reached\n");
+		if (exitcode < 9)
+			exitcode = 9;
+		break;
+	case ISC_R_NOTIMPLEMENTED:
+		fprintf(thread_stdout, ";; %s: lookup not supported with "
+			"+window\n", l->textname);
+		if (exitcode < 10)
+			exitcode = 10;
+		break;
+	default:
+		fprintf(thread_stdout, ";; communications error: %s\n",
+			isc_result_totext(pq->result));
+		if (exitcode < 9)
+			exitcode = 9;
+		break;
+	}
+	pipeline_free(pq);
+}
+
+/*%
+ * Print the finished lookups at the head of the list.
+ */
+static void
+pipeline_flush(void) {
+	pipeline_query_t *pq;
+
+	while ((pq = ISC_LIST_HEAD(pipeline->queries)) != NULL && pq->done)
+		pipeline_print(pq);
+}
+
+/*%
+ * Forget the query ID of 'pq' on its socket.
+ */
+static void
+pipeline_release(pipeline_query_t *pq) {
+	pipeline_socket_t *ps = pq->psock;
+
+	if (ps == NULL)
+		return;
+	INSIST(ps->ids[pq->id] == pq);
+	ps->ids[pq->id] = NULL;
+	ps->nqueries--;
+	if (ISC_LINK_LINKED(pq, wlink))
+		ISC_LIST_UNLINK(ps->waiting, pq, wlink);
+	pq->psock = NULL;
+}
+
+/*%
+ * Take 'pq' out of flight and record its result.
+ */
+static void
+pipeline_complete(pipeline_query_t *pq, isc_result_t result) {
+	isc_uint64_t usec;
+
+	if (ISC_LINK_LINKED(pq, flink)) {
+		ISC_LIST_UNLINK(pipeline->inflight, pq, flink);
+		pipeline->ninflight--;
+	}
+	pipeline_release(pq);
+	pq->result = result;
+	pq->done = ISC_TRUE;
+
+	if (result == ISC_R_SUCCESS) {
+		pipeline->answers++;
+		pipeline->rcodes[pq->answer.base[3] & 0x0f]++;
+		if ((pq->answer.base[2] & 0x02) != 0)
+			pipeline->truncated++;
+		if (pipeline->nlatency == pipeline->latencysize) {
+			unsigned int size = pipeline->latencysize * 2 + 1024;
+			isc_uint32_t *latency;
+
+			latency = isc_mem_get(mctx, size * sizeof(*latency));
+			if (latency == NULL)
+				fatal("memory allocation failure");
+			if (pipeline->latency != NULL) {
+				memmove(latency, pipeline->latency,
+					pipeline->nlatency * sizeof(*latency));
+				isc_mem_put(mctx, pipeline->latency,
+					    pipeline->latencysize *
+					    sizeof(*latency));
+			}
+			pipeline->latency = latency;
+			pipeline->latencysize = size;
+		}
+		usec = isc_time_microdiff(&pq->query.time_recv,
+					  &pq->query.time_sent);
+		if (usec > 0xffffffffU)
+			usec = 0xffffffffU;
+		pipeline->latency[pipeline->nlatency++] = (isc_uint32_t)usec;
+	} else if (result == ISC_R_TIMEDOUT)
+		pipeline->timeouts++;
+	else
+		pipeline->errors++;
+
+	if (!pipeline_ordered)
+		pipeline_print(pq);
+}
+
+/*%
+ * 'pq' got no answer: send it again if it has tries left.
+ */
+static void
+pipeline_retry(pipeline_query_t *pq, isc_result_t result) {
+	if (ISC_LINK_LINKED(pq, flink)) {
+		ISC_LIST_UNLINK(pipeline->inflight, pq, flink);
+		pipeline->ninflight--;
+	}
+	if (pq->tries < pq->query.lookup->retries)
+		pipeline_send(pq);
+	else
+		pipeline_complete(pq, result);
+}
+
+/*%
+ * Carry on after an event: print and start what can be, or finish
+ * the shutdown once the last socket is closed.
+ */
+static void
+pipeline_continue(void) {
+	if (!pipeline->finishing) {
+		pipeline_flush();
+		pipeline_fill();
+	} else if (pipeline->active == 0 && pipeline->sends == 0)
+		pipeline_done();
+}
+
+/*%
+ * Find the address of server 'name', remembering the last few.
+ */
+static isc_result_t
+pipeline_address(const char *name, isc_sockaddr_t *address) {
+	char host[MXNAME];
+	unsigned int i;
+	isc_result_t result;
+
+	for (i = 0; i < pipeline->nservers && i < MXSERV; i++) {
+		if (strcmp(pipeline->servers[i].name, name) == 0) {
+			*address = pipeline->servers[i].address;
+			return (ISC_R_SUCCESS);
+		}
+	}
+
+	strlcpy(host, name, sizeof(host));
+	result = get_address(host, port, address);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	i = pipeline->nservers++ % MXSERV;
+	strlcpy(pipeline->servers[i].name, name,
+		sizeof(pipeline->servers[i].name));
+	pipeline->servers[i].address = *address;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+pipeline_recvdone(isc_task_t *task, isc_event_t *event);
+
+static void
+pipeline_recv(pipeline_socket_t *ps) {
+	isc_region_t r;
+	isc_result_t result;
+
+	r.base = ps->recvspace;
+	r.length = COMMSIZE;
+	result = isc_socket_recv(ps->sock, &r, 1, global_task,
+				 pipeline_recvdone, ps);
+	check_result(result, "isc_socket_recv");
+	recvcount++;
+}
+
+/*%
+ * Pick a socket for a query to an address of family 'pf', opening the
+ * sockets of that family the first time.  One socket per
+ * PIPELINE_SOCKQUERIES of window spreads the queries over a few
+ * source ports.
+ */
+static pipeline_socket_t *
+pipeline_socket(int pf) {
+	pipeline_socket_t *ps;
+	isc_sockaddr_t bind_to;
+	isc_result_t result;
+	unsigned int i, n, family;
+
+	family = (pf == AF_INET6) ? 1 : 0;
+	if (pipeline->nsocks[family] == 0) {
+		n = (pipeline->window + PIPELINE_SOCKQUERIES - 1) /
+			PIPELINE_SOCKQUERIES;
+		if (n > PIPELINE_MAXSOCKETS)
+			n = PIPELINE_MAXSOCKETS;
+		if (specified_source && isc_sockaddr_getport(&bind_address) != 0)
+			n = 1;
+		for (i = 0; i < n; i++) {
+			ps = &pipeline->socks[family][i];
+			ps->pf = pf;
+			result = isc_socket_create(socketmgr, pf,
+						   isc_sockettype_udp,
+						   &ps->sock);
+			check_result(result, "isc_socket_create");
+			sockcount++;
+			if (specified_source)
+				bind_to = bind_address;
+			else
+				isc_sockaddr_anyofpf(&bind_to, pf);
+			result = isc_socket_bind(ps->sock, &bind_to,
+						 specified_source ?
+						 ISC_SOCKET_REUSEADDRESS : 0);
+			check_result(result, "isc_socket_bind");
+
+			ps->recvspace = isc_mempool_get(commctx);
+			ps->ids = isc_mem_get(mctx, 65536 * sizeof(*ps->ids));
+			if (ps->recvspace == NULL || ps->ids == NULL)
+				fatal("memory allocation failure");
+			memset(ps->ids, 0, 65536 * sizeof(*ps->ids));
+			pipeline_recv(ps);
+			pipeline->active++;
+		}
+		pipeline->nsocks[family] = n;
+	}
+
+	i = pipeline->nextsock[family]++ % pipeline->nsocks[family];
+	return (&pipeline->socks[family][i]);
+}
+
+static void
+pipeline_senddone(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *sevent = (isc_socketevent_t *)event;
+	pipeline_query_t *pq = event->ev_arg;
+	isc_result_t result = sevent->result;
+
+	REQUIRE(event->ev_type == ISC_SOCKEVENT_SENDDONE);
+
+	UNUSED(task);
+
+	LOCK_LOOKUP;
+	sendcount--;
+	pipeline->sends--;
+	pq->sends--;
+	isc_event_free(&event);
+
+	/*
+	 * A TCP send fails with its connection, and the queries on the
+	 * connection are dealt with when the receive fails.
+	 */
+	if (pq->freeing) {
+		if (pq->sends == 0)
+			isc_mem_put(mctx, pq, sizeof(*pq));
+	} else if (result != ISC_R_SUCCESS && result != ISC_R_CANCELED &&
+		   !pq->done && !pq->query.lookup->tcp_mode)
+		pipeline_complete(pq, result);
+	pipeline_continue();
+	UNLOCK_LOOKUP;
+}
+
+/*%
+ * Write the query of 'pq' to its socket.
+ */
+static void
+pipeline_write(pipeline_query_t *pq) {
+	pipeline_socket_t *ps = pq->psock;
+	isc_region_t r;
+	isc_result_t result;
+
+	if (ps->tcp) {
+		/* The wire is preceded by its length. */
+		r.base = pq->wire.base - 2;
+		r.length = pq->wire.length + 2;
+		result = isc_socket_send(ps->sock, &r, global_task,
+					 pipeline_senddone, pq);
+		check_result(result, "isc_socket_send");
+	} else {
+		result = isc_socket_sendto(ps->sock, &pq->wire, global_task,
+					   pipeline_senddone, pq,
+					   &pq->query.sockaddr, NULL);
+		check_result(result, "isc_socket_sendto");
+	}
+	pq->sends++;
+	pipeline->sends++;
+	sendcount++;
+}
+
+static void
+pipeline_connectdone(isc_task_t *task, isc_event_t *event);
+
+static void
+pipeline_tcplength(pipeline_socket_t *ps);
+
+/*%
+ * Pick a connection to 'address' for a query, opening one if there
+ * are fewer than 'pipeline_connections' and none is idle.  Otherwise
+ * the one with the fewest queries is used.
+ */
+static pipeline_socket_t *
+pipeline_connection(isc_sockaddr_t *address) {
+	pipeline_socket_t *ps, *best = NULL;
+	isc_sockaddr_t bind_any;
+	isc_result_t result;
+	unsigned int n = 0;
+
+	for (ps = ISC_LIST_HEAD(pipeline->conns);
+	     ps != NULL;
+	     ps = ISC_LIST_NEXT(ps, link)) {
+		if (ps->closed || !isc_sockaddr_equal(&ps->peer, address))
+			continue;
+		n++;
+		if (best == NULL || ps->nqueries < best->nqueries)
+			best = ps;
+	}
+	if (best != NULL &&
+	    (best->nqueries == 0 || n >= pipeline_connections))
+		return (best);
+
+	ps = isc_mem_get(mctx, sizeof(*ps));
+	if (ps == NULL)
+		fatal("memory allocation failure");
+	memset(ps, 0, sizeof(*ps));
+	ps->tcp = ISC_TRUE;
+	ps->pf = isc_sockaddr_pf(address);
+	ps->peer = *address;
+	ISC_LIST_INIT(ps->waiting);
+	ISC_LINK_INIT(ps, link);
+
+	result = isc_socket_create(socketmgr, ps->pf, isc_sockettype_tcp,
+				   &ps->sock);
+	check_result(result, "isc_socket_create");
+	sockcount++;
+	if (specified_source)
+		result = isc_socket_bind(ps->sock, &bind_address,
+					 ISC_SOCKET_REUSEADDRESS);
+	else {
+		isc_sockaddr_anyofpf(&bind_any, ps->pf);
+		result = isc_socket_bind(ps->sock, &bind_any, 0);
+	}
+	check_result(result, "isc_socket_bind");
+
+	ps->recvspace = isc_mempool_get(commctx);
+	ps->ids = isc_mem_get(mctx, 65536 * sizeof(*ps->ids));
+	if (ps->recvspace == NULL || ps->ids == NULL)
+		fatal("memory allocation failure");
+	memset(ps->ids, 0, 65536 * sizeof(*ps->ids));
+
+	result = isc_socket_connect(ps->sock, address, global_task,
+				    pipeline_connectdone, ps);
+	check_result(result, "isc_socket_connect");
+	ps->events++;
+	pipeline->active++;
+	pipeline->connects++;
+	ISC_LIST_APPEND(pipeline->conns, ps, link);
+	return (ps);
+}
+
+/*%
+ * Close connection 'ps' after an error or to finish.  Its queries
+ * are sent again, on another connection, if they have tries left.
+ * The structure itself goes once its pending events are back.
+ */
+static void
+pipeline_tcpclose(pipeline_socket_t *ps, isc_result_t result) {
+	pipeline_query_t *pq;
+	unsigned int id;
+
+	INSIST(!ps->closed);
+
+	debug("pipeline connection closed: %s", isc_result_totext(result));
+	ps->closed = ISC_TRUE;
+	if (ps->nqueries > 0 && !pipeline->finishing)
+		pipeline->lost++;
+	isc_socket_cancel(ps->sock, NULL, ISC_SOCKCANCEL_ALL);
+	isc_socket_detach(&ps->sock);
+	sockcount--;
+	if (pipeline->finishing)
+		return;
+
+	for (id = 0; id < 65536 && ps->nqueries > 0; id++) {
+		pq = ps->ids[id];
+		if (pq == NULL)
+			continue;
+		pipeline_release(pq);
+		pipeline_retry(pq, result);
+	}
+}
+
+/*%
+ * An event for connection 'ps' is back; free it if it is closed and
+ * this was the last.
+ */
+static void
+pipeline_tcpunref(pipeline_socket_t *ps) {
+	INSIST(ps->events > 0);
+	if (--ps->events > 0 || !ps->closed)
+		return;
+	INSIST(ps->nqueries == 0 || pipeline->finishing);
+	ISC_LIST_UNLINK(pipeline->conns, ps, link);
+	isc_mempool_put(commctx, ps->recvspace);
+	isc_mem_put(mctx, ps->ids, 65536 * sizeof(*ps->ids));
+	isc_mem_put(mctx, ps, sizeof(*ps));
+	pipeline->active--;
+}
+
+static void
+pipeline_connectdone(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *sevent = (isc_socketevent_t *)event;
+	pipeline_socket_t *ps = event->ev_arg;
+	pipeline_query_t *pq;
+	isc_result_t result = sevent->result;
+
+	REQUIRE(event->ev_type == ISC_SOCKEVENT_CONNECT);
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK_LOOKUP;
+	if (!ps->closed) {
+		if (result == ISC_R_SUCCESS) {
+			ps->connected = ISC_TRUE;
+			pipeline_tcplength(ps);
+			while ((pq = ISC_LIST_HEAD(ps->waiting)) != NULL) {
+				ISC_LIST_UNLINK(ps->waiting, pq, wlink);
+				pipeline_write(pq);
+			}
+		} else
+			pipeline_tcpclose(ps, result);
+	}
+	pipeline_tcpunref(ps);
+	pipeline_continue();
+	UNLOCK_LOOKUP;
+}
+
+/*%
+ * Send (or resend) the query of 'pq', to the lookup's next server.
+ */
+static void
+pipeline_send(pipeline_query_t *pq) {
+	dig_lookup_t *l = pq->query.lookup;
+	pipeline_socket_t *ps;
+	dig_server_t *serv;
+	isc_result_t result;
+	unsigned int i, n;
+	isc_uint32_t r;
+
+	n = 0;
+	for (serv = ISC_LIST_HEAD(l->my_server_list);
+	     serv != NULL;
+	     serv = ISC_LIST_NEXT(serv, link))
+		n++;
+	INSIST(n > 0);
+	serv = ISC_LIST_HEAD(l->my_server_list);
+	for (i = pq->tries % n; i > 0; i--)
+		serv = ISC_LIST_NEXT(serv, link);
+	pq->query.servname = serv->servername;
+	pq->query.userarg = serv->userarg;
+
+	if (pq->tries++ > 0)
+		pipeline->resends++;
+
+	result = pipeline_address(serv->servername, &pq->query.sockaddr);
+	if (result == ISC_R_SUCCESS && specified_source &&
+	    isc_sockaddr_pf(&pq->query.sockaddr) !=
+	    isc_sockaddr_pf(&bind_address))
+		result = ISC_R_FAMILYMISMATCH;
+	if (result != ISC_R_SUCCESS) {
+		pipeline_complete(pq, result);
+		return;
+	}
+
+	/*
+	 * Over UDP keep the query ID across retries unless the address
+	 * family changes; over TCP a retry may go on another connection.
+	 * Pick an unused ID on the new socket.
+	 */
+	ps = pq->psock;
+	if (ps != NULL &&
+	    (ps->tcp || isc_sockaddr_pf(&pq->query.sockaddr) != ps->pf)) {
+		pipeline_release(pq);
+		ps = NULL;
+	}
+	if (ps == NULL) {
+		if (l->tcp_mode)
+			ps = pipeline_connection(&pq->query.sockaddr);
+		else
+			ps = pipeline_socket(
+				isc_sockaddr_pf(&pq->query.sockaddr));
+		isc_random_get(&r);
+		pq->id = r & 0xffff;
+		while (ps->ids[pq->id] != NULL)
+			pq->id = (pq->id + 1) & 0xffff;
+		ps->ids[pq->id] = pq;
+		ps->nqueries++;
+		pq->psock = ps;
+		pq->wire.base[0] = (pq->id >> 8) & 0xff;
+		pq->wire.base[1] = pq->id & 0xff;
+	}
+
+	TIME_NOW(&pq->query.time_sent);
+	ISC_LIST_APPEND(pipeline->inflight, pq, flink);
+	pipeline->ninflight++;
+
+	if (ps->tcp && !ps->connected)
+		ISC_LIST_APPEND(ps->waiting, pq, wlink);
+	else
+		pipeline_write(pq);
+}
+
+/*%
+ * Render the query for lookup 'l' and send it.
+ */
+static void
+pipeline_start(dig_lookup_t *l) {
+	pipeline_query_t *pq;
+	dig_query_t *query;
+
+	pq = isc_mem_get(mctx, sizeof(*pq));
+	if (pq == NULL)
+		fatal("memory allocation failure");
+	memset(pq, 0, sizeof(*pq));
+	pq->query.lookup = l;
+	ISC_LINK_INIT(pq, link);
+	ISC_LINK_INIT(pq, flink);
+	ISC_LINK_INIT(pq, wlink);
+	ISC_LIST_APPEND(pipeline->queries, pq, link);
+	pipeline->nqueries++;
+	pipeline->lookups++;
+
+	if (l->trace || l->ns_search_only ||
+#ifdef DIG_SIGCHASE
+	    l->sigchase ||
+#endif
+	    l->rdtype == dns_rdatatype_axfr ||
+	    l->rdtype == dns_rdatatype_ixfr)
+		goto unsupported;
+
+	(void)setup_lookup(l);
+
+	/*
+	 * Only the rendered message and the server list are used; the
+	 * queries setup_lookup() made for the serial engine are not.
+	 */
+	while ((query = ISC_LIST_HEAD(l->q)) != NULL)
+		clear_query(query);
+
+	/*
+	 * The wire is preceded by its length for TCP.
+	 */
+	pq->wire.length = isc_buffer_usedlength(&l->renderbuf);
+	pq->wire.base = isc_mem_get(mctx, pq->wire.length + 2);
+	if (pq->wire.base == NULL)
+		fatal("memory allocation failure");
+	pq->wire.base[0] = (pq->wire.length >> 8) & 0xff;
+	pq->wire.base[1] = pq->wire.length & 0xff;
+	pq->wire.base += 2;
+	memmove(pq->wire.base, isc_buffer_base(&l->renderbuf),
+		pq->wire.length);
+	isc_mempool_put(commctx, l->sendspace);
+	l->sendspace = NULL;
+
+	pipeline_send(pq);
+	return;
+
+ unsupported:
+	pipeline_complete(pq, ISC_R_NOTIMPLEMENTED);
+}
+
+/*%
+ * The next lookup to start, reading the batch file when the lookup
+ * list is empty.
+ */
+static dig_lookup_t *
+pipeline_next(void) {
+	dig_lookup_t *l;
+
+	while ((l = ISC_LIST_HEAD(lookup_list)) == NULL) {
+		if (pipeline->eof || strcmp(progname, "dig") != 0 ||
+		    !dig_nextbatch()) {
+			pipeline->eof = ISC_TRUE;
+			return (NULL);
+		}
+	}
+	ISC_LIST_DEQUEUE(lookup_list, l, link);
+	return (l);
+}
+
+static void
+pipeline_printusec(const char *label, isc_uint32_t usec) {
+	fprintf(thread_stderr, "%s %u.%03u", label, usec / 1000, usec % 1000);
+}
+
+static int
+pipeline_cmp(const void *a, const void *b) {
+	isc_uint32_t ua = *(const isc_uint32_t *)a;
+	isc_uint32_t ub = *(const isc_uint32_t *)b;
+
+	return ((ua > ub) - (ua < ub));
+}
+
+static void
+pipeline_summary(void) {
+	static const unsigned int permille[] = { 500, 900, 990, 999 };
+	static const char *labels[] = { ", 50%", ", 90%", ", 99%",
+					", 99.9%" };
+	isc_uint64_t usec, rate;
+	isc_time_t now;
+	char rcode[64];
+	isc_buffer_t b;
+	unsigned int i, n;
+
+	TIME_NOW(&now);
+	usec = isc_time_microdiff(&now, &pipeline->start);
+	rate = (usec == 0) ? 0 : pipeline->answers * 1000000 / usec;
+
+	fprintf(thread_stderr, ";; %" ISC_PRINT_QUADFORMAT "u lookups in "
+		"%u.%03u seconds, window %u: %" ISC_PRINT_QUADFORMAT
+		"u answers/s\n", pipeline->lookups,
+		(unsigned int)(usec / 1000000),
+		(unsigned int)(usec / 1000 % 1000), pipeline->window, rate);
+	fprintf(thread_stderr, ";; %" ISC_PRINT_QUADFORMAT "u answers, %"
+		ISC_PRINT_QUADFORMAT "u timeouts, %" ISC_PRINT_QUADFORMAT
+		"u errors, %" ISC_PRINT_QUADFORMAT "u retransmissions, %"
+		ISC_PRINT_QUADFORMAT "u truncated, %" ISC_PRINT_QUADFORMAT
+		"u unexpected\n", pipeline->answers, pipeline->timeouts,
+		pipeline->errors, pipeline->resends, pipeline->truncated,
+		pipeline->unexpected);
+	if (pipeline->connects > 0)
+		fprintf(thread_stderr, ";; %" ISC_PRINT_QUADFORMAT "u TCP "
+			"connections, %" ISC_PRINT_QUADFORMAT "u lost with "
+			"queries outstanding\n", pipeline->connects,
+			pipeline->lost);
+	if (pipeline->answers == 0)
+		return;
+
+	fprintf(thread_stderr, ";;");
+	for (i = 0; i < 16; i++) {
+		if (pipeline->rcodes[i] == 0)
+			continue;
+		isc_buffer_init(&b, rcode, sizeof(rcode) - 1);
+		if (dns_rcode_totext((dns_rcode_t)i, &b) != ISC_R_SUCCESS)
+			continue;
+		rcode[isc_buffer_usedlength(&b)] = '\0';
+		fprintf(thread_stderr, " %s %" ISC_PRINT_QUADFORMAT "u", rcode,
+			pipeline->rcodes[i]);
+	}
+	fprintf(thread_stderr, "\n");
+
+	n = pipeline->nlatency;
+	qsort(pipeline->latency, n, sizeof(pipeline->latency[0]),
+	      pipeline_cmp);
+	pipeline_printusec(";; latency (ms): min", pipeline->latency[0]);
+	for (i = 0; i < sizeof(permille) / sizeof(permille[0]); i++)
+		pipeline_printusec(labels[i],
+				   pipeline->latency[(n - 1) * permille[i] /
+						     1000]);
+	pipeline_printusec(", max", pipeline->latency[n - 1]);
+	fprintf(thread_stderr, "\n");
+}
+
+/*%
+ * All sockets are closed: print the summary, free what is left and
+ * hand over to the program's shutdown code.
+ */
+static void
+pipeline_done(void) {
+	pipeline_query_t *pq;
+
+	INSIST(pipeline->active == 0 && pipeline->sends == 0);
+	INSIST(ISC_LIST_EMPTY(pipeline->conns));
+
+	if (pipeline->timer != NULL)
+		isc_timer_detach(&pipeline->timer);
+	pipeline_summary();
+	while ((pq = ISC_LIST_HEAD(pipeline->queries)) != NULL) {
+		ISC_LIST_UNLINK(pipeline->queries, pq, link);
+		pipeline_free(pq);
+	}
+	if (pipeline->latency != NULL)
+		isc_mem_put(mctx, pipeline->latency,
+			    pipeline->latencysize * sizeof(*pipeline->latency));
+	isc_mem_put(mctx, pipeline, sizeof(*pipeline));
+	pipeline = NULL;
+
+	if (!cancel_now)
+		check_if_done();
+}
+
+static void
+pipeline_closesocket(pipeline_socket_t *ps) {
+	isc_mempool_put(commctx, ps->recvspace);
+	isc_mem_put(mctx, ps->ids, 65536 * sizeof(*ps->ids));
+	isc_socket_detach(&ps->sock);
+	sockcount--;
+	pipeline->active--;
+}
+
+/*%
+ * Stop: cancel the timer and the receives; pipeline_done() runs once
+ * the last socket is closed.
+ */
+static void
+pipeline_finish(void) {
+	pipeline_socket_t *ps;
+	unsigned int family, i;
+
+	if (pipeline->finishing)
+		return;
+	pipeline->finishing = ISC_TRUE;
+	if (pipeline->timer != NULL)
+		isc_timer_detach(&pipeline->timer);
+	for (family = 0; family < 2; family++)
+		for (i = 0; i < pipeline->nsocks[family]; i++)
+			isc_socket_cancel(pipeline->socks[family][i].sock,
+					  NULL, ISC_SOCKCANCEL_ALL);
+	for (ps = ISC_LIST_HEAD(pipeline->conns);
+	     ps != NULL;
+	     ps = ISC_LIST_NEXT(ps, link))
+		if (!ps->closed)
+			pipeline_tcpclose(ps, ISC_R_CANCELED);
+	if (pipeline->active == 0 && pipeline->sends == 0)
+		pipeline_done();
+}
+
+static void
+pipeline_recvdone(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *sevent = (isc_socketevent_t *)event;
+	pipeline_socket_t *ps = event->ev_arg;
+	pipeline_query_t *pq;
+	dns_messageid_t id;
+	unsigned int flags;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	REQUIRE(event->ev_type == ISC_SOCKEVENT_RECVDONE);
+
+	UNUSED(task);
+
+	LOCK_LOOKUP;
+	recvcount--;
+
+	if (pipeline->finishing || sevent->result == ISC_R_CANCELED) {
+		isc_event_free(&event);
+		pipeline_closesocket(ps);
+		if (pipeline->active == 0 && pipeline->sends == 0)
+			pipeline_done();
+		UNLOCK_LOOKUP;
+		return;
+	}
+
+	pq = NULL;
+	if (sevent->result == ISC_R_SUCCESS) {
+		isc_buffer_init(&b, ps->recvspace, sevent->n);
+		isc_buffer_add(&b, sevent->n);
+		result = dns_message_peekheader(&b, &id, &flags);
+		if (result == ISC_R_SUCCESS &&
+		    (flags & DNS_MESSAGEFLAG_QR) != 0)
+			pq = ps->ids[id];
+		if (pq != NULL &&
+		    !isc_sockaddr_compare(&sevent->address,
+					  &pq->query.sockaddr,
+					  ISC_SOCKADDR_CMPADDR|
+					  ISC_SOCKADDR_CMPPORT|
+					  ISC_SOCKADDR_CMPSCOPE|
+					  ISC_SOCKADDR_CMPSCOPEZERO))
+			pq = NULL;
+		if (pq == NULL)
+			pipeline->unexpected++;
+	} else
+		debug("pipeline recv: %s", isc_result_totext(sevent->result));
+
+	if (pq != NULL) {
+		TIME_NOW(&pq->query.time_recv);
+		pq->from = sevent->address;
+		pq->answer.length = sevent->n;
+		pq->answer.base = isc_mem_get(mctx, sevent->n);
+		if (pq->answer.base == NULL)
+			fatal("memory allocation failure");
+		memmove(pq->answer.base, ps->recvspace, sevent->n);
+		pipeline_complete(pq, ISC_R_SUCCESS);
+	}
+	isc_event_free(&event);
+
+	pipeline_recv(ps);
+	pipeline_flush();
+	pipeline_fill();
+	UNLOCK_LOOKUP;
+}
+
+static void
+pipeline_tcplengthdone(isc_task_t *task, isc_event_t *event);
+
+static void
+pipeline_tcprecvdone(isc_task_t *task, isc_event_t *event);
+
+/*%
+ * Read the length of the next response on connection 'ps'.
+ */
+static void
+pipeline_tcplength(pipeline_socket_t *ps) {
+	isc_region_t r;
+	isc_result_t result;
+
+	r.base = ps->lenbuf;
+	r.length = 2;
+	result = isc_socket_recv(ps->sock, &r, 2, global_task,
+				 pipeline_tcplengthdone, ps);
+	check_result(result, "isc_socket_recv");
+	recvcount++;
+	ps->events++;
+}
+
+static void
+pipeline_tcplengthdone(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *sevent = (isc_socketevent_t *)event;
+	pipeline_socket_t *ps = event->ev_arg;
+	isc_result_t result = sevent->result;
+	unsigned int length;
+	isc_region_t r;
+
+	REQUIRE(event->ev_type == ISC_SOCKEVENT_RECVDONE);
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK_LOOKUP;
+	recvcount--;
+	if (!ps->closed) {
+		length = (ps->lenbuf[0] << 8) | ps->lenbuf[1];
+		if (result != ISC_R_SUCCESS)
+			pipeline_tcpclose(ps, result);
+		else if (length == 0)
+			pipeline_tcplength(ps);
+		else {
+			r.base = ps->recvspace;
+			r.length = length;
+			result = isc_socket_recv(ps->sock, &r, length,
+						 global_task,
+						 pipeline_tcprecvdone, ps);
+			check_result(result, "isc_socket_recv");
+			recvcount++;
+			ps->events++;
+		}
+	}
+	pipeline_tcpunref(ps);
+	pipeline_continue();
+	UNLOCK_LOOKUP;
+}
+
+/*%
+ * A response on connection 'ps': responses may come in any order, so
+ * the query is found by its ID alone.
+ */
+static void
+pipeline_tcprecvdone(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *sevent = (isc_socketevent_t *)event;
+	pipeline_socket_t *ps = event->ev_arg;
+	pipeline_query_t *pq;
+	dns_messageid_t id;
+	unsigned int flags;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	REQUIRE(event->ev_type == ISC_SOCKEVENT_RECVDONE);
+
+	UNUSED(task);
+
+	LOCK_LOOKUP;
+	recvcount--;
+	if (ps->closed) {
+		isc_event_free(&event);
+		goto done;
+	}
+	if (sevent->result != ISC_R_SUCCESS) {
+		result = sevent->result;
+		isc_event_free(&event);
+		pipeline_tcpclose(ps, result);
+		goto done;
+	}
+
+	pq = NULL;
+	isc_buffer_init(&b, ps->recvspace, sevent->n);
+	isc_buffer_add(&b, sevent->n);
+	result = dns_message_peekheader(&b, &id, &flags);
+	if (result == ISC_R_SUCCESS && (flags & DNS_MESSAGEFLAG_QR) != 0)
+		pq = ps->ids[id];
+	if (pq != NULL && ISC_LINK_LINKED(pq, wlink))
+		pq = NULL;
+	if (pq == NULL)
+		pipeline->unexpected++;
+	else {
+		TIME_NOW(&pq->query.time_recv);
+		pq->from = ps->peer;
+		pq->answer.length = sevent->n;
+		pq->answer.base = isc_mem_get(mctx, sevent->n);
+		if (pq->answer.base == NULL)
+			fatal("memory allocation failure");
+		memmove(pq->answer.base, ps->recvspace, sevent->n);
+		pipeline_complete(pq, ISC_R_SUCCESS);
+	}
+	isc_event_free(&event);
+	pipeline_tcplength(ps);
+
+ done:
+	pipeline_tcpunref(ps);
+	pipeline_continue();
+	UNLOCK_LOOKUP;
+}
+
+/*%
+ * Resend or give up on the queries that have timed out.  They are
+ * at the head of the in flight list, which is in send order.
+ */
+static void
+pipeline_tick(isc_task_t *task, isc_event_t *event) {
+	pipeline_query_t *pq;
+	isc_uint64_t limit;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK_LOOKUP;
+	if (pipeline == NULL || pipeline->finishing || cancel_now) {
+		UNLOCK_LOOKUP;
+		return;
+	}
+
+	TIME_NOW(&now);
+	while ((pq = ISC_LIST_HEAD(pipeline->inflight)) != NULL) {
+		if (timeout != 0)
+			limit = timeout;
+		else if (pq->query.lookup->tcp_mode)
+			limit = TCP_TIMEOUT;
+		else
+			limit = UDP_TIMEOUT;
+		if (isc_time_microdiff(&now, &pq->query.time_sent) <
+		    limit * 1000000)
+			break;
+		pipeline_retry(pq, ISC_R_TIMEDOUT);
+	}
+	pipeline_continue();
+	UNLOCK_LOOKUP;
+}
+
+/*%
+ * Start lookups until the window is full.  In order, finished lookups
+ * wait for the ones before them; at most PIPELINE_BACKLOG windows of
+ * lookups are held before starting more waits for the head.
+ */
+static void
+pipeline_fill(void) {
+	dig_lookup_t *l;
+
+	if (pipeline == NULL || pipeline->finishing)
+		return;
+
+	while (!cancel_now && pipeline->ninflight < pipeline->window &&
+	       pipeline->nqueries < pipeline->backlog) {
+		l = pipeline_next();
+		if (l == NULL)
+			break;
+		pipeline_start(l);
+	}
+	pipeline_flush();
+	if (pipeline->eof && pipeline->nqueries == 0)
+		pipeline_finish();
+}
+
+void
+start_pipeline(void) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	debug("start_pipeline()");
+	if (cancel_now)
+		return;
+
+	INSIST(pipeline == NULL);
+	pipeline = isc_mem_get(mctx, sizeof(*pipeline));
+	if (pipeline == NULL)
+		fatal("memory allocation failure");
+	memset(pipeline, 0, sizeof(*pipeline));
+	pipeline->window = pipeline_window;
+	pipeline->backlog = pipeline_window;
+	if (pipeline_ordered)
+		pipeline->backlog *= PIPELINE_BACKLOG;
+	ISC_LIST_INIT(pipeline->queries);
+	ISC_LIST_INIT(pipeline->inflight);
+	ISC_LIST_INIT(pipeline->conns);
+	TIME_NOW(&pipeline->start);
+
+	isc_interval_set(&interval, 0, PIPELINE_TICK * 1000000);
+	result = isc_timer_create(timermgr, isc_timertype_ticker, NULL,
+				  &interval, global_task, pipeline_tick,
+				  NULL, &pipeline->timer);
+	check_result(result, "isc_timer_create");
+
+	pipeline_fill();
+}
+
 /*%
  * Make everything on the lookup queue go away.  Mainly used by the
  * SIGINT handler.
@@ -3839,6 +5107,8 @@ cancel_all(void) {
 		return;
 	}
 	cancel_now = ISC_TRUE;
+	if (pipeline != NULL)
+		pipeline_finish();
 	if (current_lookup != NULL) {
 		if (current_lookup->timer != NULL)
 			isc_timer_detach(&current_lookup->timer);
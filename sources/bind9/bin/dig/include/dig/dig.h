@@ -277,6 +277,9 @@ extern __thread isc_task_t *global_task;
 extern __thread isc_boolean_t free_now;
 extern __thread isc_boolean_t debugging, debugtiming, memdebugging;
 extern __thread isc_boolean_t keep_open;
+extern __thread unsigned int pipeline_window;
+extern __thread unsigned int pipeline_connections;
+extern __thread isc_boolean_t pipeline_ordered;
 
 extern __thread char *progname;
 extern __thread int tries;
@@ -320,6 +323,13 @@ do_lookup(dig_lookup_t *lookup);
 void
 start_lookup(void);
 
+void
+start_pipeline(void);
+/*%<
+ * Run the queued lookups with up to 'pipeline_window' queries in
+ * flight (+window), instead of one at a time.
+ */
+
 void
 onrun_callback(isc_task_t *task, isc_event_t *event);
 
@@ -414,6 +424,12 @@ void dig_dighost_shutdown(void);
 void host_dighost_shutdown(void);
 void nslookup_dighost_shutdown(void);
 
+isc_boolean_t
+dig_nextbatch(void);
+/*%<
+ * Queue the lookups on the next line of the batch file, if any.
+ */
+
 char *
 next_token(char **stringp, const char *delim);
 
@@ -45,6 +45,7 @@
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/iterated_hash.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/os.h>
@@ -691,11 +692,26 @@ signset(dns_diff_t *del, dns_diff_t *add, dns_dbnode_t *node, dns_name_t *name,
 	isc_mem_put(mctx, nowsignedby, arraysize * sizeof(isc_boolean_t));
 }
 
+/*
+ * Names are hashed in batches with isc_iterated_hash_multi(), which
+ * computes the iterations of several names at once.
+ */
+#define HASHLIST_BATCH 64
+
 struct hashlist {
 	unsigned char *hashbuf;
 	size_t entries;
 	size_t size;
 	size_t length;
+	/* Names waiting to be hashed by hashlist_flush(). */
+	unsigned int pending;
+	unsigned char names[HASHLIST_BATCH][DNS_NAME_MAXWIRE];
+	int namelen[HASHLIST_BATCH];
+	isc_boolean_t speculative[HASHLIST_BATCH];
+	unsigned int hashalg;
+	unsigned int iterations;
+	const unsigned char *salt;
+	size_t salt_len;
 };
 
 static void
@@ -703,6 +719,7 @@ hashlist_init(hashlist_t *l, unsigned int nodes, unsigned int length) {
 
 	l->entries = 0;
 	l->length = length + 1;
+	l->pending = 0;
 
 	if (nodes != 0) {
 		l->size = nodes;
@@ -732,28 +749,60 @@ hashlist_add(hashlist_t *l, const unsigned char *hash, size_t len)
 	l->entries++;
 }
 
+static void
+hashlist_flush(hashlist_t *l) {
+	char nametext[DNS_NAME_FORMATSIZE];
+	unsigned char hashes[HASHLIST_BATCH][ISC_SHA1_DIGESTLENGTH + 1];
+	unsigned char *out[HASHLIST_BATCH];
+	const unsigned char *in[HASHLIST_BATCH];
+	unsigned int len, i;
+	dns_name_t name;
+	isc_region_t r;
+	size_t j;
+
+	if (l->pending == 0)
+		return;
+
+	for (i = 0; i < l->pending; i++) {
+		out[i] = hashes[i];
+		in[i] = l->names[i];
+	}
+	len = isc_iterated_hash_multi(out, l->hashalg, l->iterations,
+				      l->salt, (int)l->salt_len,
+				      in, l->namelen, l->pending);
+	for (i = 0; i < l->pending; i++) {
+		if (verbose) {
+			dns_name_init(&name, NULL);
+			r.base = l->names[i];
+			r.length = l->namelen[i];
+			dns_name_fromregion(&name, &r);
+			dns_name_format(&name, nametext, sizeof nametext);
+			for (j = 0 ; j < len; j++)
+				fprintf(stderr, "%02x", hashes[i][j]);
+			fprintf(stderr, " %s\n", nametext);
+		}
+		hashes[i][len] = l->speculative[i] ? 1 : 0;
+		hashlist_add(l, hashes[i], len + 1);
+	}
+	l->pending = 0;
+}
+
 static void
 hashlist_add_dns_name(hashlist_t *l, /*const*/ dns_name_t *name,
 		      unsigned int hashalg, unsigned int iterations,
 		      const unsigned char *salt, size_t salt_len,
 		      isc_boolean_t speculative)
 {
-	char nametext[DNS_NAME_FORMATSIZE];
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH + 1];
-	unsigned int len;
-	size_t i;
-
-	len = isc_iterated_hash(hash, hashalg, iterations,
-				salt, (int)salt_len,
-				name->ndata, name->length);
-	if (verbose) {
-		dns_name_format(name, nametext, sizeof nametext);
-		for (i = 0 ; i < len; i++)
-			fprintf(stderr, "%02x", hash[i]);
-		fprintf(stderr, " %s\n", nametext);
-	}
-	hash[len++] = speculative ? 1 : 0;
-	hashlist_add(l, hash, len);
+	l->hashalg = hashalg;
+	l->iterations = iterations;
+	l->salt = salt;
+	l->salt_len = salt_len;
+
+	memmove(l->names[l->pending], name->ndata, name->length);
+	l->namelen[l->pending] = name->length;
+	l->speculative[l->pending] = speculative;
+	if (++l->pending == HASHLIST_BATCH)
+		hashlist_flush(l);
 }
 
 static int
@@ -763,6 +812,7 @@ hashlist_comp(const void *a, const void *b) {
 
 static void
 hashlist_sort(hashlist_t *l) {
+	hashlist_flush(l);
 	qsort(l->hashbuf, l->entries, l->length, hashlist_comp);
 }
 
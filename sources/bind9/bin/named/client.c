@@ -20,18 +20,22 @@
 #include <config.h>
 
 #include <isc/formatcheck.h>
+#include <isc/histo.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/queue.h>
+#include <isc/random.h>
 #include <isc/stats.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#include <dns/capture.h>
 #include <dns/db.h>
 #include <dns/dispatch.h>
 #include <dns/events.h>
@@ -97,31 +101,62 @@
 #define SEND_BUFFER_SIZE		4096
 #define RECV_BUFFER_SIZE		4096
 
-#ifdef ISC_PLATFORM_USETHREADS
-#define NMCTXS				100
-/*%<
- * Number of 'mctx pools' for clients. (Should this be configurable?)
- * When enabling threads, we use a pool of memory contexts shared by
- * client objects, since concurrent access to a shared context would cause
- * heavy contentions.  The above constant is expected to be enough for
- * completely avoiding contentions among threads for an authoritative-only
- * server.
+/*%
+ * Each client's task is bound to one of the task manager's worker
+ * threads (see isc_task_createbound()), one of 'nthreads' == ns_g_cpus.
+ * The manager keeps, per worker, the inactive clients of that worker
+ * and a memory context used only by its clients, so that a request is
+ * received, answered and its memory reused by one thread, without
+ * contention on the memory context and, if the workers are pinned to
+ * processors ("worker-cpus"), from memory local to that processor.
+ * If named is built without threads, all clients simply share the
+ * manager's context; a separate one would waste memory.
  */
-#else
-#define NMCTXS				0
-/*%<
- * If named with built without thread, simply share manager's context.  Using
- * a separate context in this case would simply waste memory.
+
+/*%
+ * A TCP connection is shared by the client reading requests from it
+ * and, when the requests are pipelined, the clients answering them in
+ * whatever order they complete.  The connection holds the TCP quota,
+ * so "tcp-clients" limits connections rather than clients, and it is
+ * closed when the last of these clients detaches.  Each client holds
+ * its own reference to the socket.
  */
-#endif
+struct ns_tcpconn {
+	unsigned int			magic;
+	isc_socket_t *			socket;
+	isc_quota_t *			tcpquota;
+	isc_boolean_t			pipelined;    /*%< Answer requests
+						       *   out of order */
+
+	/* Locked by the manager's tcplock. */
+	unsigned int			references;
+	unsigned int			nrequests;    /*%< Read so far */
+	unsigned int			nworking;     /*%< Being answered */
+	isc_boolean_t			reclaimed;    /*%< Read canceled */
+	ISC_LINK(ns_tcpconn_t)		link;
+};
+
+typedef ISC_LIST(ns_tcpconn_t) tcpconn_list_t;
+
+#define TCPCONN_MAGIC			ISC_MAGIC('N', 'S', 'T', 'c')
+#define VALID_TCPCONN(c)		ISC_MAGIC_VALID(c, TCPCONN_MAGIC)
+
+/*%
+ * The most requests of one TCP connection that are answered at once;
+ * beyond that, the reading client answers the request itself before
+ * it reads the next one.
+ */
+#define TCP_PIPELINE_MAX		16
 
 /*% nameserver client manager structure */
 struct ns_clientmgr {
 	/* Unlocked. */
 	unsigned int			magic;
+	unsigned int			nthreads;
 
-	/* The queue object has its own locks */
-	client_queue_t			inactive;     /*%< To be recycled */
+	/* The queue objects have their own locks */
+	client_queue_t *		inactive;     /*%< To be recycled,
+						       *   per thread */
 
 	isc_mem_t *			mctx;
 	isc_taskmgr_t *			taskmgr;
@@ -139,16 +174,23 @@ struct ns_clientmgr {
 	isc_mutex_t			reclock;
 	client_list_t			recursing;    /*%< Recursing clients */
 
-#if NMCTXS > 0
-	/*%< mctx pool for clients. */
-	unsigned int			nextmctx;
-	isc_mem_t *			mctxpool[NMCTXS];
+	/* Lock covers the TCP connections and their counters */
+	isc_mutex_t			tcplock;
+	tcpconn_list_t			tcpconns;     /*%< Least recently
+						       *   active first */
+
+	/* Locked by lock. */
+	unsigned int			nextthread;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_mem_t **			mctxpool;     /*%< Per thread */
 #endif
 };
 
 #define MANAGER_MAGIC			ISC_MAGIC('N', 'S', 'C', 'm')
 #define VALID_MANAGER(m)		ISC_MAGIC_VALID(m, MANAGER_MAGIC)
 
+#define INACTIVE(m, c)			((m)->inactive[(c)->threadid])
+
 /*!
  * Client object states.  Ordering is significant: higher-numbered
  * states are generally "more active", meaning that the client can
@@ -190,9 +232,9 @@ struct ns_clientmgr {
 #define NS_CLIENTSTATE_READING  3
 /*%<
  * The client object is a TCP client object that has received
- * a connection.  It has a tcpsocket, tcpmsg, TCP quota, and an
- * outstanding TCP read request.  This state is not used for
- * UDP client objects.
+ * a connection.  It has a tcpsocket, tcpmsg, and TCP connection,
+ * and unless it is answering a pipelined request, an outstanding
+ * TCP read request.  This state is not used for UDP client objects.
  */
 
 #define NS_CLIENTSTATE_WORKING  4
@@ -233,10 +275,18 @@ static void ns_client_endrequest(ns_client_t *client);
 static void client_start(isc_task_t *task, isc_event_t *event);
 static void client_request(isc_task_t *task, isc_event_t *event);
 static void ns_client_dumpmessage(ns_client_t *client, const char *reason);
+static isc_result_t client_alloc(ns_clientmgr_t *manager,
+				 unsigned int threadid, ns_client_t **clientp);
 static isc_result_t get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
-			       dns_dispatch_t *disp, isc_boolean_t tcp);
+			       dns_dispatch_t *disp, unsigned int threadid,
+			       isc_boolean_t tcp);
 static inline isc_boolean_t
 allowed(isc_netaddr_t *addr, dns_name_t *signer, dns_acl_t *acl);
+static void client_faststore(ns_client_t *client, isc_buffer_t *buffer);
+static void client_fastreset(ns_client_t *client);
+static void tcpconn_detach(ns_clientmgr_t *manager, ns_tcpconn_t **connp);
+static void tcpconn_done(ns_client_t *client);
+static void tcpconn_request(ns_client_t *client);
 
 void
 ns_client_recursing(ns_client_t *client) {
@@ -366,14 +416,23 @@ exit_check(ns_client_t *client) {
 			UNLOCK(&manager->reclock);
 		}
 		ns_client_endrequest(client);
+		if (client->tcpconn != NULL)
+			tcpconn_done(client);
 
 		client->state = NS_CLIENTSTATE_READING;
 		INSIST(client->recursionquota == NULL);
 
 		if (NS_CLIENTSTATE_READING == client->newstate) {
-			client_read(client);
-			client->newstate = NS_CLIENTSTATE_MAX;
-			return (ISC_TRUE); /* We're done. */
+			if (!client->pipelined) {
+				client_read(client);
+				client->newstate = NS_CLIENTSTATE_MAX;
+				return (ISC_TRUE); /* We're done. */
+			}
+			/*
+			 * Another client is reading the connection;
+			 * let go of it.
+			 */
+			client->newstate = NS_CLIENTSTATE_READY;
 		}
 	}
 
@@ -400,8 +459,9 @@ exit_check(ns_client_t *client) {
 			isc_socket_detach(&client->tcpsocket);
 		}
 
-		if (client->tcpquota != NULL)
-			isc_quota_detach(&client->tcpquota);
+		if (client->tcpconn != NULL)
+			tcpconn_detach(manager, &client->tcpconn);
+		client->pipelined = ISC_FALSE;
 
 		if (client->timerset) {
 			(void)isc_timer_reset(client->timer,
@@ -424,8 +484,11 @@ exit_check(ns_client_t *client) {
 		 * UDP clients go inactive at this point, but TCP clients
 		 * may remain active if we have fewer active TCP client
 		 * objects than desired due to an earlier quota exhaustion.
+		 * Readers of pipelined connections have no listener to
+		 * accept on, so they always go inactive.
 		 */
-		if (client->mortal && TCP_CLIENT(client) && !ns_g_clienttest) {
+		if (client->mortal && TCP_CLIENT(client) &&
+		    client->tcplistener != NULL && !ns_g_clienttest) {
 			LOCK(&client->interface->lock);
 			if (client->interface->ntcpcurrent <
 				    client->interface->ntcptarget)
@@ -444,6 +507,7 @@ exit_check(ns_client_t *client) {
 
 		if (NS_CLIENTSTATE_READY == client->newstate) {
 			if (TCP_CLIENT(client)) {
+				INSIST(client->tcplistener != NULL);
 				client_accept(client);
 			} else
 				client_udprecv(client);
@@ -511,8 +575,8 @@ exit_check(ns_client_t *client) {
 			client->newstate = NS_CLIENTSTATE_MAX;
 			if (!ns_g_clienttest && manager != NULL &&
 			    !manager->exiting)
-				ISC_QUEUE_PUSH(manager->inactive, client,
-					       ilink);
+				ISC_QUEUE_PUSH(INACTIVE(manager, client),
+					       client, ilink);
 			if (client->needshutdown)
 				isc_task_shutdown(client->task);
 			return (ISC_TRUE);
@@ -546,7 +610,9 @@ exit_check(ns_client_t *client) {
 		}
 
 		ns_query_free(client);
-		isc_mem_put(client->mctx, client->recvbuf, RECV_BUFFER_SIZE);
+		if (client->recvbuf != NULL)
+			isc_mem_put(client->mctx, client->recvbuf,
+				    RECV_BUFFER_SIZE);
 		isc_event_free((isc_event_t **)&client->sendevent);
 		isc_event_free((isc_event_t **)&client->recvevent);
 		isc_timer_detach(&client->timer);
@@ -617,7 +683,10 @@ client_start(isc_task_t *task, isc_event_t *event) {
 		return;
 
 	if (TCP_CLIENT(client)) {
-		client_accept(client);
+		if (client->tcpconn != NULL)
+			client_read(client);
+		else
+			client_accept(client);
 	} else {
 		client_udprecv(client);
 	}
@@ -650,7 +719,8 @@ client_shutdown(isc_task_t *task, isc_event_t *event) {
 	}
 
 	if (ISC_QLINK_LINKED(client, ilink))
-		ISC_QUEUE_UNLINK(client->manager->inactive, client, ilink);
+		ISC_QUEUE_UNLINK(INACTIVE(client->manager, client),
+				 client, ilink);
 
 	client->newstate = NS_CLIENTSTATE_FREED;
 	client->needshutdown = ISC_FALSE;
@@ -683,6 +753,8 @@ ns_client_endrequest(ns_client_t *client) {
 	}
 
 	client->signer = NULL;
+	client->naclcache = 0;
+	client_fastreset(client);
 	client->udpsize = 512;
 	client->extflags = 0;
 	client->ednsversion = -1;
@@ -729,6 +801,42 @@ ns_client_next(ns_client_t *client, isc_result_t result) {
 	(void)exit_check(client);
 }
 
+/*%
+ * Record how long the request took, from its arrival to the completion
+ * of the send, by transport, rcode, view and (authoritative) zone.
+ */
+static void
+client_latency(ns_client_t *client) {
+	isc_time_t now;
+	isc_uint64_t usecs;
+	dns_rcode_t rcode;
+	isc_histo_t *histo;
+
+	if ((client->attributes & NS_CLIENTATTR_LATENCY) == 0)
+		return;
+
+	TIME_NOW(&now);
+	usecs = isc_time_microdiff(&now, &client->requeststart);
+
+	if (TCP_CLIENT(client))
+		isc_histo_add(ns_g_server->tcplatency, usecs);
+	else
+		isc_histo_add(ns_g_server->udplatency, usecs);
+
+	rcode = client->message->rcode;
+	if (rcode >= NS_LATENCY_RCODES - 1)
+		rcode = NS_LATENCY_RCODES - 1;
+	isc_histo_add(ns_g_server->rcodelatency[rcode], usecs);
+
+	if (client->view != NULL && client->view->latencyhisto != NULL)
+		isc_histo_add(client->view->latencyhisto, usecs);
+
+	if (client->query.authzone != NULL) {
+		histo = dns_zone_getlatencyhisto(client->query.authzone);
+		if (histo != NULL)
+			isc_histo_add(histo, usecs);
+	}
+}
 
 static void
 client_senddone(isc_task_t *task, isc_event_t *event) {
@@ -761,6 +869,9 @@ client_senddone(isc_task_t *task, isc_event_t *event) {
 		client->tcpbuf = NULL;
 	}
 
+	if (sevent->result == ISC_R_SUCCESS)
+		client_latency(client);
+
 	ns_client_next(client, ISC_R_SUCCESS);
 }
 
@@ -824,6 +935,24 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 	return (result);
 }
 
+/*%
+ * Queue a capture frame for 'message', exchanged between the client and
+ * the address it sent its request to.
+ */
+static void
+client_capture(ns_client_t *client, dns_capturetype_t type,
+	       const isc_region_t *message)
+{
+	isc_sockaddr_t local;
+
+	isc_sockaddr_fromnetaddr(&local, &client->destaddr,
+			isc_sockaddr_getport(&client->interface->addr));
+	dns_capture_message(client->view->capture, type, TCP_CLIENT(client),
+			    &client->peeraddr, &local,
+			    type == dns_capturetype_clientquery ?
+			    &client->requeststart : NULL, message);
+}
+
 static isc_result_t
 client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	struct in6_pktinfo *pktinfo;
@@ -861,6 +990,17 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 
 	isc_buffer_usedregion(buffer, &r);
 
+	if (client->view != NULL && client->view->capture != NULL &&
+	    (client->view->capturetypes &
+	     dns_capturetype_clientresponse) != 0) {
+		isc_region_t mr = r;
+
+		/* Leave out the TCP length. */
+		if (TCP_CLIENT(client))
+			isc_region_consume(&mr, 2);
+		client_capture(client, dns_capturetype_clientresponse, &mr);
+	}
+
 	CTRACE("sendto");
 
 	result = isc_socket_sendto2(socket, &r, client->task,
@@ -935,6 +1075,7 @@ ns_client_send(ns_client_t *client) {
 	unsigned int render_opts;
 	unsigned int preferred_glue;
 	isc_boolean_t opt_included = ISC_FALSE;
+	isc_boolean_t partial = ISC_FALSE;
 
 	REQUIRE(NS_CLIENT_VALID(client));
 
@@ -1049,7 +1190,9 @@ ns_client_send(ns_client_t *client) {
 	result = dns_message_rendersection(client->message,
 					   DNS_SECTION_ADDITIONAL,
 					   preferred_glue | render_opts);
-	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE)
+	if (result == ISC_R_NOSPACE)
+		partial = ISC_TRUE;
+	else if (result != ISC_R_SUCCESS)
 		goto done;
  renderend:
 	result = dns_message_renderend(client->message);
@@ -1062,6 +1205,19 @@ ns_client_send(ns_client_t *client) {
 		cleanup_cctx = ISC_FALSE;
 	}
 
+	/*
+	 * A response that left out additional data for lack of room
+	 * would be short for clients with more room.
+	 */
+	if (client->fastpath.keylen != 0 && client->fastpath.cacheable &&
+	    !partial)
+		client_faststore(client, &buffer);
+
+	/*
+	 * Set before the send, which may complete, and call
+	 * client_senddone(), immediately.
+	 */
+	client->attributes |= NS_CLIENTATTR_LATENCY;
 	if (TCP_CLIENT(client)) {
 		isc_buffer_usedregion(&buffer, &r);
 		isc_buffer_putuint16(&tcpbuffer, (isc_uint16_t) r.length);
@@ -1468,6 +1624,337 @@ process_opt(ns_client_t *client, dns_rdataset_t *opt) {
 	return (result);
 }
 
+/*
+ * The response cache.
+ *
+ * A UDP query with a single, uncompressed question of class IN and
+ * nothing else but an empty OPT record is looked up in the view's
+ * response cache before it is parsed; a hit is sent back with the ID of
+ * the query.  A miss goes through the normal path and its response is
+ * stored by ns_client_send() unless it depends on something the key and
+ * the recorded ACL outcomes do not capture.
+ */
+typedef struct {
+	dns_messageid_t		id;
+	isc_uint16_t		flags;
+	dns_rdatatype_t		qtype;
+	isc_region_t		qname;
+	isc_boolean_t		edns;
+	isc_uint16_t		udpsize;
+	isc_uint16_t		extflags;
+} fastquery_t;
+
+static isc_boolean_t
+client_fastparse(isc_buffer_t *buffer, fastquery_t *q) {
+	isc_region_t r;
+	unsigned char *p;
+	unsigned int length, n;
+	isc_uint32_t ttl;
+
+	isc_buffer_remainingregion(buffer, &r);
+	if (r.length < DNS_MESSAGE_HEADERLEN)
+		return (ISC_FALSE);
+	p = r.base;
+
+	/* Header: a query with one question and at most an OPT. */
+	q->id = (p[0] << 8) | p[1];
+	q->flags = (p[2] << 8) | p[3];
+	if ((q->flags & (DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_TC)) != 0 ||
+	    ((q->flags >> 11) & 0xf) != dns_opcode_query)
+		return (ISC_FALSE);
+	if (p[4] != 0 || p[5] != 1 || p[6] != 0 || p[7] != 0 ||
+	    p[8] != 0 || p[9] != 0 || p[10] != 0 || p[11] > 1)
+		return (ISC_FALSE);
+	q->edns = ISC_TF(p[11] == 1);
+	isc_region_consume(&r, DNS_MESSAGE_HEADERLEN);
+
+	/* Question: an uncompressed name, then type and class IN. */
+	p = r.base;
+	length = 0;
+	do {
+		if (length >= r.length || (p[length] & 0xc0) != 0)
+			return (ISC_FALSE);
+		n = p[length];
+		length += n + 1;
+		if (length > DNS_NAME_MAXWIRE)
+			return (ISC_FALSE);
+	} while (n != 0);
+	if (r.length < length + 4)
+		return (ISC_FALSE);
+	q->qname.base = p;
+	q->qname.length = length;
+	p += length;
+	q->qtype = (p[0] << 8) | p[1];
+	if (dns_rdatatype_ismeta(q->qtype) ||
+	    ((p[2] << 8) | p[3]) != dns_rdataclass_in)
+		return (ISC_FALSE);
+	isc_region_consume(&r, length + 4);
+
+	/* OPT: root owner, version 0 and no options. */
+	q->udpsize = 512;
+	q->extflags = 0;
+	if (q->edns) {
+		p = r.base;
+		if (r.length < 11 || p[0] != 0 ||
+		    ((p[1] << 8) | p[2]) != dns_rdatatype_opt)
+			return (ISC_FALSE);
+		q->udpsize = (p[3] << 8) | p[4];
+		ttl = ((isc_uint32_t)p[5] << 24) | (p[6] << 16) |
+		      (p[7] << 8) | p[8];
+		if (((ttl >> 16) & 0xff) != 0 || p[9] != 0 || p[10] != 0)
+			return (ISC_FALSE);
+		q->extflags = (isc_uint16_t)(ttl & 0xffff);
+		isc_region_consume(&r, 11);
+	}
+
+	return (ISC_TF(r.length == 0));
+}
+
+static void
+client_fastnext(ns_client_t *client) {
+	if (client->query.authzone != NULL)
+		dns_zone_detach(&client->query.authzone);
+}
+
+/*%
+ * Answer the query in 'buffer' from the response cache if possible,
+ * returning ISC_TRUE if the request has been dealt with.  Otherwise,
+ * if the query is eligible, set up the client so that its response
+ * may be stored.
+ */
+static isc_boolean_t
+client_fastpath(ns_client_t *client, isc_buffer_t *buffer,
+		isc_netaddr_t *netaddr)
+{
+	fastquery_t q;
+	dns_view_t *view;
+	dns_zone_t *zone = NULL;
+	dns_peer_t *peer = NULL;
+	isc_region_t key;
+	isc_buffer_t b;
+	isc_result_t result;
+	isc_stats_t *zonestats;
+	isc_uint16_t udpsize;
+	isc_uint32_t tag;
+	unsigned char *k;
+	unsigned char sendbuf[SEND_BUFFER_SIZE];
+#ifdef NEWSTATS
+	dns_stats_t *querystats;
+#endif
+
+	if (TCP_CLIENT(client) ||
+	    (client->interface->flags & NS_INTERFACEFLAG_ANYADDR) != 0)
+		return (ISC_FALSE);
+	if (!client_fastparse(buffer, &q))
+		return (ISC_FALSE);
+	if (q.edns && (ns_g_noedns || ns_g_dropedns))
+		return (ISC_FALSE);
+
+	isc_netaddr_fromsockaddr(&client->destaddr, &client->interface->addr);
+	for (view = ISC_LIST_HEAD(ns_g_server->viewlist);
+	     view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (view->rdclass == dns_rdataclass_in &&
+		    allowed(netaddr, NULL, view->matchclients) &&
+		    allowed(&client->destaddr, NULL,
+			    view->matchdestinations) &&
+		    !((q.flags & DNS_MESSAGEFLAG_RD) == 0 &&
+		      view->matchrecursiveonly))
+			break;
+	}
+	if (view == NULL || view->respcache == NULL)
+		return (ISC_FALSE);
+
+	/*
+	 * The same adjustments as in client_request() and process_opt().
+	 */
+	udpsize = 512;
+	if (q.edns && q.udpsize > 512) {
+		udpsize = view->maxudp;
+		(void) dns_peerlist_peerbyaddr(view->peers, netaddr, &peer);
+		if (peer != NULL)
+			dns_peer_getmaxudp(peer, &udpsize);
+		if (q.udpsize < udpsize)
+			udpsize = q.udpsize;
+	}
+
+	k = client->fastpath.key;
+	*k++ = q.flags >> 8;
+	*k++ = q.flags & 0xff;
+	*k++ = q.qtype >> 8;
+	*k++ = q.qtype & 0xff;
+	*k++ = q.edns ? 1 : 0;
+	*k++ = q.extflags >> 8;
+	*k++ = q.extflags & 0xff;
+	memmove(k, q.qname.base, q.qname.length);
+	client->fastpath.keylen = 7 + q.qname.length;
+	client->fastpath.generation = dns_db_generation();
+	client->fastpath.cacheable = ISC_TRUE;
+	client->fastpath.nconds = 0;
+
+	/*
+	 * A hit would not be logged.
+	 */
+	if (ns_g_server->log_queries || ns_g_server->querylog != NULL)
+		return (ISC_FALSE);
+
+	key.base = client->fastpath.key;
+	key.length = client->fastpath.keylen;
+	isc_buffer_init(&b, sendbuf, ISC_MIN(udpsize, sizeof(sendbuf)));
+	result = dns_respcache_find(view->respcache, &key,
+				    client->fastpath.generation, netaddr,
+				    &client->destaddr, &ns_g_server->aclenv,
+				    &b, &zone, &tag);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+
+	sendbuf[0] = q.id >> 8;
+	sendbuf[1] = q.id & 0xff;
+	client->message->id = q.id;
+	client->udpsize = udpsize;
+	client->message->rcode = sendbuf[3] & 0x0f;
+
+	dns_view_attach(view, &client->view);
+	client->query.authzone = zone;
+	client->next = client_fastnext;
+
+	isc_stats_increment(ns_g_server->nsstats,
+			    dns_nsstatscounter_respcachehit);
+	dns_opcodestats_increment(ns_g_server->opcodestats, dns_opcode_query);
+	dns_rdatatypestats_increment(ns_g_server->rcvquerystats, q.qtype);
+	if (q.edns)
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_edns0in);
+	isc_stats_increment(ns_g_server->nsstats, tag >> 8);
+	isc_stats_increment(ns_g_server->nsstats, tag & 0xff);
+	if (zone != NULL) {
+		zonestats = dns_zone_getrequeststats(zone);
+		if (zonestats != NULL) {
+			isc_stats_increment(zonestats, tag >> 8);
+			isc_stats_increment(zonestats, tag & 0xff);
+		}
+#ifdef NEWSTATS
+		querystats = dns_zone_getrcvquerystats(zone);
+		if ((tag >> 8) == dns_nsstatscounter_authans &&
+		    querystats != NULL)
+			dns_rdatatypestats_increment(querystats, q.qtype);
+#endif
+	}
+
+	CTRACE("respcache hit");
+	client->attributes |= NS_CLIENTATTR_LATENCY;
+	result = client_sendpkg(client, &b);
+	if (result == ISC_R_SUCCESS) {
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_response);
+		if (q.edns)
+			isc_stats_increment(ns_g_server->nsstats,
+					    dns_nsstatscounter_edns0out);
+	} else
+		ns_client_next(client, result);
+	return (ISC_TRUE);
+}
+
+/*%
+ * Store the response in 'buffer' in the view's response cache if
+ * it is complete and does not depend on the order in which the
+ * records of an answer RRset are rendered.
+ */
+static void
+client_faststore(ns_client_t *client, isc_buffer_t *buffer) {
+	dns_message_t *message = client->message;
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	isc_statscounter_t auth, counter;
+	isc_region_t key, response;
+	isc_result_t result;
+
+	if (client->view == NULL || client->view->respcache == NULL ||
+	    (message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (message->rcode != dns_rcode_noerror &&
+	     message->rcode != dns_rcode_nxdomain) ||
+	    message->tsigkey != NULL || message->sig0key != NULL)
+		return;
+
+	for (result = dns_message_firstname(message, DNS_SECTION_ANSWER);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(message, DNS_SECTION_ANSWER))
+	{
+		name = NULL;
+		dns_message_currentname(message, DNS_SECTION_ANSWER, &name);
+		for (rdataset = ISC_LIST_HEAD(name->list);
+		     rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link))
+			if (dns_rdataset_count(rdataset) > 1 &&
+			    (rdataset->attributes &
+			     DNS_RDATASETATTR_FIXEDORDER) == 0)
+				return;
+	}
+
+	/* The counters query_send() incremented. */
+	if ((message->flags & DNS_MESSAGEFLAG_AA) != 0)
+		auth = dns_nsstatscounter_authans;
+	else
+		auth = dns_nsstatscounter_nonauthans;
+	if (message->rcode == dns_rcode_nxdomain)
+		counter = dns_nsstatscounter_nxdomain;
+	else if (!ISC_LIST_EMPTY(message->sections[DNS_SECTION_ANSWER]))
+		counter = dns_nsstatscounter_success;
+	else if (client->query.isreferral)
+		counter = dns_nsstatscounter_referral;
+	else
+		counter = dns_nsstatscounter_nxrrset;
+
+	key.base = client->fastpath.key;
+	key.length = client->fastpath.keylen;
+	isc_buffer_usedregion(buffer, &response);
+	(void)dns_respcache_add(client->view->respcache, &key,
+				client->fastpath.generation, &response,
+				client->fastpath.conds,
+				client->fastpath.nconds,
+				client->query.authzone,
+				(auth << 8) | counter);
+}
+
+/*%
+ * Note that the response depends on whether 'acl' allowed the client's
+ * source (or, if 'destination', destination) address.
+ */
+static void
+client_fastcond(ns_client_t *client, dns_acl_t *acl,
+		isc_boolean_t destination, isc_boolean_t allowed)
+{
+	dns_respcachecond_t *cond;
+	unsigned int i;
+
+	for (i = 0; i < client->fastpath.nconds; i++) {
+		cond = &client->fastpath.conds[i];
+		if (cond->acl == acl && cond->destination == destination)
+			return;
+	}
+	if (client->fastpath.nconds == DNS_RESPCACHE_MAXCONDS) {
+		client->fastpath.cacheable = ISC_FALSE;
+		return;
+	}
+	cond = &client->fastpath.conds[client->fastpath.nconds++];
+	cond->acl = NULL;
+	dns_acl_attach(acl, &cond->acl);
+	cond->destination = destination;
+	cond->allowed = allowed;
+}
+
+static void
+client_fastreset(ns_client_t *client) {
+	unsigned int i;
+
+	for (i = 0; i < client->fastpath.nconds; i++)
+		dns_acl_detach(&client->fastpath.conds[i].acl);
+	client->fastpath.nconds = 0;
+	client->fastpath.keylen = 0;
+	client->fastpath.cacheable = ISC_FALSE;
+}
+
 /*
  * Handle an incoming request event from the socket (UDP case)
  * or tcpmsg (TCP case).
@@ -1540,8 +2027,12 @@ client_request(isc_task_t *task, isc_event_t *event) {
 		goto cleanup;
 	client->state = client->newstate = NS_CLIENTSTATE_WORKING;
 
+	if (TCP_CLIENT(client))
+		tcpconn_request(client);
+
 	isc_task_getcurrenttime(task, &client->requesttime);
 	client->now = client->requesttime;
+	TIME_NOW(&client->requeststart);
 
 	if (result != ISC_R_SUCCESS) {
 		if (TCP_CLIENT(client)) {
@@ -1651,10 +2142,18 @@ client_request(isc_task_t *task, isc_event_t *event) {
 		isc_stats_increment(ns_g_server->nsstats,
 				    dns_nsstatscounter_tcp);
 
+	if (client_fastpath(client, buffer, &netaddr))
+		goto cleanup;
+
 	/*
-	 * It's a request.  Parse it.
+	 * It's a request.  Parse it.  Only the question and the OPT,
+	 * TSIG and SIG(0) records are needed for most requests, so the
+	 * other sections are checked, which still rejects malformed
+	 * requests, but only decoded when they are first looked at.
+	 * The request buffer stays in place until the client is reset.
 	 */
-	result = dns_message_parse(client->message, buffer, 0);
+	result = dns_message_parse(client->message, buffer,
+				   DNS_MESSAGEPARSE_LAZY);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * Parsing the request failed.  Send a response
@@ -1825,6 +2324,11 @@ client_request(isc_task_t *task, isc_event_t *event) {
 		      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(5),
 		      "using view '%s'", view->name);
 
+	if (view->capture != NULL &&
+	    (view->capturetypes & dns_capturetype_clientquery) != 0)
+		client_capture(client, dns_capturetype_clientquery,
+			       dns_message_getrawmessage(client->message));
+
 	/*
 	 * Check for a signature.  We log bad signatures regardless of
 	 * whether they ultimately cause the request to be rejected or
@@ -1832,6 +2336,7 @@ client_request(isc_task_t *task, isc_event_t *event) {
 	 * debugging.
 	 */
 	client->signer = NULL;
+	client->naclcache = 0;
 	dns_name_init(&client->signername, NULL);
 	result = dns_message_signer(client->message, &client->signername);
 	if (result != ISC_R_NOTFOUND) {
@@ -2029,12 +2534,11 @@ client_timeout(isc_task_t *task, isc_event_t *event) {
 }
 
 static isc_result_t
-get_clientmctx(ns_clientmgr_t *manager, isc_mem_t **mctxp) {
+get_clientmctx(ns_clientmgr_t *manager, unsigned int threadid,
+	       isc_mem_t **mctxp)
+{
 	isc_mem_t *clientmctx;
 	isc_result_t result;
-#if NMCTXS > 0
-	unsigned int nextmctx;
-#endif
 
 	MTRACE("clientmctx");
 
@@ -2047,23 +2551,20 @@ get_clientmctx(ns_clientmgr_t *manager, isc_mem_t **mctxp) {
 			isc_mem_setname(*mctxp, "client", NULL);
 		return (result);
 	}
-#if NMCTXS > 0
-	nextmctx = manager->nextmctx++;
-	if (manager->nextmctx == NMCTXS)
-		manager->nextmctx = 0;
-
-	INSIST(nextmctx < NMCTXS);
+#ifdef ISC_PLATFORM_USETHREADS
+	INSIST(threadid < manager->nthreads);
 
-	clientmctx = manager->mctxpool[nextmctx];
+	clientmctx = manager->mctxpool[threadid];
 	if (clientmctx == NULL) {
 		result = isc_mem_create(0, 0, &clientmctx);
 		if (result != ISC_R_SUCCESS)
 			return (result);
 		isc_mem_setname(clientmctx, "client", NULL);
 
-		manager->mctxpool[nextmctx] = clientmctx;
+		manager->mctxpool[threadid] = clientmctx;
 	}
 #else
+	UNUSED(threadid);
 	clientmctx = manager->mctx;
 #endif
 
@@ -2073,7 +2574,9 @@ get_clientmctx(ns_clientmgr_t *manager, isc_mem_t **mctxp) {
 }
 
 static isc_result_t
-client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
+client_create(ns_clientmgr_t *manager, unsigned int threadid,
+	      ns_client_t **clientp)
+{
 	ns_client_t *client;
 	isc_result_t result;
 	isc_mem_t *mctx = NULL;
@@ -2088,7 +2591,7 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 
 	REQUIRE(clientp != NULL && *clientp == NULL);
 
-	result = get_clientmctx(manager, &mctx);
+	result = get_clientmctx(manager, threadid, &mctx);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
@@ -2100,7 +2603,9 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 	client->mctx = mctx;
 
 	client->task = NULL;
-	result = isc_task_create(manager->taskmgr, 0, &client->task);
+	client->threadid = threadid;
+	result = isc_task_createbound(manager->taskmgr, 0, threadid,
+				      &client->task);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_client;
 	isc_task_setname(client->task, "client", client);
@@ -2131,11 +2636,11 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 		goto cleanup_message;
 	}
 
-	client->recvbuf = isc_mem_get(client->mctx, RECV_BUFFER_SIZE);
-	if  (client->recvbuf == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto cleanup_sendevent;
-	}
+	/*
+	 * The receive buffer is allocated by the client's own worker,
+	 * when it first listens for a UDP request.
+	 */
+	client->recvbuf = NULL;
 
 	client->recvevent = (isc_socketevent_t *)
 			    isc_event_allocate(client->mctx, client,
@@ -2144,7 +2649,7 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 					       sizeof(isc_socketevent_t));
 	if (client->recvevent == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_recvbuf;
+		goto cleanup_sendevent;
 	}
 
 	client->magic = NS_CLIENT_MAGIC;
@@ -2174,9 +2679,14 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 	client->shutdown = NULL;
 	client->shutdown_arg = NULL;
 	client->signer = NULL;
+	client->naclcache = 0;
+	client->fastpath.keylen = 0;
+	client->fastpath.cacheable = ISC_FALSE;
+	client->fastpath.nconds = 0;
 	dns_name_init(&client->signername, NULL);
 	client->mortal = ISC_FALSE;
-	client->tcpquota = NULL;
+	client->pipelined = ISC_FALSE;
+	client->tcpconn = NULL;
 	client->recursionquota = NULL;
 	client->interface = NULL;
 	client->peeraddr_valid = ISC_FALSE;
@@ -2224,9 +2734,6 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
  cleanup_recvevent:
 	isc_event_free((isc_event_t **)&client->recvevent);
 
- cleanup_recvbuf:
-	isc_mem_put(client->mctx, client->recvbuf, RECV_BUFFER_SIZE);
-
  cleanup_sendevent:
 	isc_event_free((isc_event_t **)&client->sendevent);
 
@@ -2247,6 +2754,222 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 	return (result);
 }
 
+/***
+ *** TCP Connections
+ ***/
+
+static isc_result_t
+tcpconn_create(ns_clientmgr_t *manager, isc_socket_t *socket,
+	       ns_tcpconn_t **connp)
+{
+	ns_tcpconn_t *conn;
+
+	REQUIRE(connp != NULL && *connp == NULL);
+
+	conn = isc_mem_get(manager->mctx, sizeof(*conn));
+	if (conn == NULL)
+		return (ISC_R_NOMEMORY);
+
+	conn->socket = NULL;
+	isc_socket_attach(socket, &conn->socket);
+	conn->tcpquota = NULL;
+	conn->pipelined = ISC_FALSE;
+	conn->references = 1;
+	conn->nrequests = 0;
+	conn->nworking = 0;
+	conn->reclaimed = ISC_FALSE;
+	ISC_LINK_INIT(conn, link);
+	conn->magic = TCPCONN_MAGIC;
+
+	LOCK(&manager->tcplock);
+	ISC_LIST_APPEND(manager->tcpconns, conn, link);
+	UNLOCK(&manager->tcplock);
+
+	isc_stats_increment(ns_g_server->nsstats,
+			    dns_nsstatscounter_tcpconnections);
+
+	*connp = conn;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+tcpconn_attach(ns_clientmgr_t *manager, ns_tcpconn_t *source,
+	       ns_tcpconn_t **targetp)
+{
+	REQUIRE(VALID_TCPCONN(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	LOCK(&manager->tcplock);
+	INSIST(source->references > 0);
+	source->references++;
+	UNLOCK(&manager->tcplock);
+
+	*targetp = source;
+}
+
+static void
+tcpconn_detach(ns_clientmgr_t *manager, ns_tcpconn_t **connp) {
+	ns_tcpconn_t *conn;
+	isc_boolean_t destroy;
+
+	REQUIRE(connp != NULL && VALID_TCPCONN(*connp));
+	conn = *connp;
+	*connp = NULL;
+
+	LOCK(&manager->tcplock);
+	INSIST(conn->references > 0);
+	conn->references--;
+	destroy = ISC_TF(conn->references == 0);
+	if (destroy)
+		ISC_LIST_UNLINK(manager->tcpconns, conn, link);
+	UNLOCK(&manager->tcplock);
+
+	if (!destroy)
+		return;
+
+	INSIST(conn->nworking == 0);
+	isc_histo_add(ns_g_server->tcprequests, conn->nrequests);
+	if (conn->tcpquota != NULL)
+		isc_quota_detach(&conn->tcpquota);
+	isc_socket_detach(&conn->socket);
+	conn->magic = 0;
+	isc_mem_put(manager->mctx, conn, sizeof(*conn));
+}
+
+/*
+ * Record the most TCP connections that have held the quota at once.
+ */
+static void
+tcpconn_highwater(void) {
+	isc_quota_t *quota = &ns_g_server->tcpquota;
+
+	LOCK(&quota->lock);
+	if ((unsigned int)quota->used > ns_g_server->tcphighwater)
+		ns_g_server->tcphighwater = quota->used;
+	UNLOCK(&quota->lock);
+}
+
+/*
+ * Close the connection that has been idle the longest, i.e. that has
+ * been waiting for a request with none to answer, to make room for a
+ * new one.  Canceling the read makes its reader let go of it.
+ */
+static void
+tcpconn_reclaim(ns_clientmgr_t *manager) {
+	ns_tcpconn_t *conn;
+
+	LOCK(&manager->tcplock);
+	for (conn = ISC_LIST_HEAD(manager->tcpconns);
+	     conn != NULL;
+	     conn = ISC_LIST_NEXT(conn, link))
+	{
+		if (conn->nworking == 0 && !conn->reclaimed)
+			break;
+	}
+	if (conn != NULL) {
+		conn->reclaimed = ISC_TRUE;
+		isc_socket_cancel(conn->socket, NULL, ISC_SOCKCANCEL_RECV);
+	}
+	UNLOCK(&manager->tcplock);
+
+	if (conn != NULL)
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_tcpreclaimed);
+}
+
+/*
+ * Get a client to read the next request from the TCP connection of
+ * 'client', which is about to answer the request it has just read.
+ * The reader runs on the same worker, and is mortal: the connection
+ * was accepted by another client, which has already been replaced.
+ */
+static isc_result_t
+get_reader(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
+	ns_client_t *reader = NULL;
+	isc_event_t *ev;
+	isc_result_t result;
+
+	CTRACE("get reader");
+
+	result = client_alloc(manager, client->threadid, &reader);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	ns_interface_attach(client->interface, &reader->interface);
+	reader->attributes |= NS_CLIENTATTR_TCP;
+	reader->mortal = ISC_TRUE;
+	isc_socket_attach(client->tcpsocket, &reader->tcpsocket);
+	tcpconn_attach(manager, client->tcpconn, &reader->tcpconn);
+	reader->peeraddr = client->peeraddr;
+	reader->peeraddr_valid = ISC_TRUE;
+	INSIST(reader->tcpmsg_valid == ISC_FALSE);
+	dns_tcpmsg_init(reader->mctx, reader->tcpsocket, &reader->tcpmsg);
+	reader->tcpmsg_valid = ISC_TRUE;
+	reader->state = NS_CLIENTSTATE_READING;
+	INSIST(reader->recursionquota == NULL);
+
+	INSIST(reader->nctls == 0);
+	reader->nctls++;
+	ev = &reader->ctlevent;
+	isc_task_send(reader->task, &ev);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * A TCP client has read a request, or failed to.  If the connection
+ * allows it and not too many of its requests are being answered
+ * already, hand the connection over to a new client to read the next
+ * request while this one answers.
+ */
+static void
+tcpconn_request(ns_client_t *client) {
+	ns_tcpconn_t *conn = client->tcpconn;
+	isc_boolean_t pipeline = ISC_FALSE;
+
+	REQUIRE(VALID_TCPCONN(conn));
+	INSIST(!client->pipelined);
+
+	LOCK(&client->manager->tcplock);
+	conn->nworking++;
+	if (client->tcpmsg.result == ISC_R_SUCCESS) {
+		conn->nrequests++;
+		conn->reclaimed = ISC_FALSE;
+		pipeline = ISC_TF(conn->pipelined &&
+				  conn->nworking < TCP_PIPELINE_MAX);
+	}
+	UNLOCK(&client->manager->tcplock);
+
+	if (pipeline && get_reader(client) == ISC_R_SUCCESS) {
+		client->pipelined = ISC_TRUE;
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_tcppipelined);
+	}
+}
+
+/*
+ * A TCP client has finished with a request.  A connection with none
+ * left to answer moves to the end of the list, which is thus ordered
+ * by how long the connections have been idle.
+ */
+static void
+tcpconn_done(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
+	ns_tcpconn_t *conn = client->tcpconn;
+
+	REQUIRE(VALID_TCPCONN(conn));
+
+	LOCK(&manager->tcplock);
+	INSIST(conn->nworking > 0);
+	conn->nworking--;
+	if (conn->nworking == 0) {
+		ISC_LIST_UNLINK(manager->tcpconns, conn, link);
+		ISC_LIST_APPEND(manager->tcpconns, conn, link);
+	}
+	UNLOCK(&manager->tcplock);
+}
+
 static void
 client_read(ns_client_t *client) {
 	isc_result_t result;
@@ -2278,7 +3001,8 @@ static void
 client_newconn(isc_task_t *task, isc_event_t *event) {
 	ns_client_t *client = event->ev_arg;
 	isc_socket_newconnev_t *nevent = (isc_socket_newconnev_t *)event;
-	isc_result_t result;
+	isc_quota_t *quota = NULL;
+	isc_result_t result, tresult;
 
 	REQUIRE(event->ev_type == ISC_SOCKEVENT_NEWCONN);
 	REQUIRE(NS_CLIENT_VALID(client));
@@ -2353,6 +3077,38 @@ client_newconn(isc_task_t *task, isc_event_t *event) {
 			goto freeevent;
 		}
 
+		/*
+		 * Once most of the TCP quota is in use, make room by
+		 * closing an idle connection.
+		 */
+		result = isc_quota_attach(&ns_g_server->tcpquota, &quota);
+		if (result == ISC_R_SOFTQUOTA || result == ISC_R_QUOTA) {
+			tcpconn_reclaim(client->manager);
+			if (result == ISC_R_SOFTQUOTA)
+				result = ISC_R_SUCCESS;
+		}
+		tcpconn_highwater();
+
+		INSIST(client->tcpconn == NULL);
+		tresult = tcpconn_create(client->manager, client->tcpsocket,
+					 &client->tcpconn);
+		if (tresult != ISC_R_SUCCESS) {
+			if (quota != NULL)
+				isc_quota_detach(&quota);
+			ns_client_log(client, NS_LOGCATEGORY_CLIENT,
+				      NS_LOGMODULE_CLIENT, ISC_LOG_WARNING,
+				      "TCP connection: %s",
+				      isc_result_totext(tresult));
+			client->newstate = NS_CLIENTSTATE_READY;
+			(void)exit_check(client);
+			goto freeevent;
+		}
+		client->tcpconn->tcpquota = quota;
+		client->tcpconn->pipelined =
+			ISC_TF(ns_g_server->keepresporder == NULL ||
+			       !allowed(&netaddr, NULL,
+					ns_g_server->keepresporder));
+
 		INSIST(client->tcpmsg_valid == ISC_FALSE);
 		dns_tcpmsg_init(client->mctx, client->tcpsocket,
 				&client->tcpmsg);
@@ -2364,8 +3120,6 @@ client_newconn(isc_task_t *task, isc_event_t *event) {
 		 * telnetting to port 53 (once per CPU) will
 		 * deny service to legitimate TCP clients.
 		 */
-		result = isc_quota_attach(&ns_g_server->tcpquota,
-					  &client->tcpquota);
 		if (result == ISC_R_SUCCESS)
 			result = ns_client_replace(client);
 		if (result != ISC_R_SUCCESS) {
@@ -2417,6 +3171,16 @@ client_udprecv(ns_client_t *client) {
 
 	CTRACE("udprecv");
 
+	if (client->recvbuf == NULL) {
+		client->recvbuf = isc_mem_get(client->mctx, RECV_BUFFER_SIZE);
+		if (client->recvbuf == NULL) {
+			/* As below, we just go idle. */
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "client_udprecv(): out of memory");
+			return;
+		}
+	}
+
 	r.base = client->recvbuf;
 	r.length = RECV_BUFFER_SIZE;
 	result = isc_socket_recv2(client->udpsocket, &r, 1,
@@ -2467,17 +3231,42 @@ ns_client_shuttingdown(ns_client_t *client) {
 	return (ISC_TF(client->newstate == NS_CLIENTSTATE_FREED));
 }
 
+/*
+ * Choose a worker for a new client, taking them in turn.
+ */
+static unsigned int
+next_threadid(ns_clientmgr_t *manager) {
+	unsigned int threadid;
+
+	LOCK(&manager->lock);
+	threadid = manager->nextthread;
+	manager->nextthread = (threadid + 1) % manager->nthreads;
+	UNLOCK(&manager->lock);
+
+	return (threadid);
+}
+
 isc_result_t
 ns_client_replace(ns_client_t *client) {
 	isc_result_t result;
+	unsigned int threadid;
 
 	CTRACE("replace");
 
 	REQUIRE(client != NULL);
 	REQUIRE(client->manager != NULL);
 
+	/*
+	 * A UDP client is replaced on its own worker, which keeps each
+	 * UDP socket's requests on one thread; TCP connections are
+	 * accepted in turn by each worker.
+	 */
+	if (TCP_CLIENT(client))
+		threadid = next_threadid(client->manager);
+	else
+		threadid = client->threadid;
 	result = get_client(client->manager, client->interface,
-			    client->dispatch, TCP_CLIENT(client));
+			    client->dispatch, threadid, TCP_CLIENT(client));
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
@@ -2497,25 +3286,30 @@ ns_client_replace(ns_client_t *client) {
 
 static void
 clientmgr_destroy(ns_clientmgr_t *manager) {
-#if NMCTXS > 0
-	int i;
-#endif
+	unsigned int i;
 
 	REQUIRE(ISC_LIST_EMPTY(manager->clients));
+	REQUIRE(ISC_LIST_EMPTY(manager->tcpconns));
 
 	MTRACE("clientmgr_destroy");
 
-#if NMCTXS > 0
-	for (i = 0; i < NMCTXS; i++) {
+	for (i = 0; i < manager->nthreads; i++) {
+#ifdef ISC_PLATFORM_USETHREADS
 		if (manager->mctxpool[i] != NULL)
 			isc_mem_detach(&manager->mctxpool[i]);
+#endif
+		ISC_QUEUE_DESTROY(manager->inactive[i]);
 	}
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_mem_put(manager->mctx, manager->mctxpool,
+		    manager->nthreads * sizeof(isc_mem_t *));
 #endif
-
-	ISC_QUEUE_DESTROY(manager->inactive);
+	isc_mem_put(manager->mctx, manager->inactive,
+		    manager->nthreads * sizeof(client_queue_t));
 	DESTROYLOCK(&manager->lock);
 	DESTROYLOCK(&manager->listlock);
 	DESTROYLOCK(&manager->reclock);
+	DESTROYLOCK(&manager->tcplock);
 	manager->magic = 0;
 	isc_mem_put(manager->mctx, manager, sizeof(*manager));
 }
@@ -2526,17 +3320,31 @@ ns_clientmgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 {
 	ns_clientmgr_t *manager;
 	isc_result_t result;
-#if NMCTXS > 0
-	int i;
-#endif
+	unsigned int i;
 
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
 		return (ISC_R_NOMEMORY);
 
+	manager->nthreads = ISC_MAX(ns_g_cpus, 1);
+	manager->inactive = isc_mem_get(mctx, manager->nthreads *
+					sizeof(client_queue_t));
+	if (manager->inactive == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_manager;
+	}
+#ifdef ISC_PLATFORM_USETHREADS
+	manager->mctxpool = isc_mem_get(mctx, manager->nthreads *
+					sizeof(isc_mem_t *));
+	if (manager->mctxpool == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_inactive;
+	}
+#endif
+
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS)
-		goto cleanup_manager;
+		goto cleanup_mctxpool;
 
 	result = isc_mutex_init(&manager->listlock);
 	if (result != ISC_R_SUCCESS)
@@ -2546,18 +3354,30 @@ ns_clientmgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_listlock;
 
+	result = isc_mutex_init(&manager->tcplock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_reclock;
+
 	manager->mctx = mctx;
 	manager->taskmgr = taskmgr;
 	manager->timermgr = timermgr;
 	manager->exiting = ISC_FALSE;
 	ISC_LIST_INIT(manager->clients);
 	ISC_LIST_INIT(manager->recursing);
-	ISC_QUEUE_INIT(manager->inactive, ilink);
-#if NMCTXS > 0
-	manager->nextmctx = 0;
-	for (i = 0; i < NMCTXS; i++)
-		manager->mctxpool[i] = NULL; /* will be created on-demand */
+	ISC_LIST_INIT(manager->tcpconns);
+	for (i = 0; i < manager->nthreads; i++) {
+		ISC_QUEUE_INIT(manager->inactive[i], ilink);
+#ifdef ISC_PLATFORM_USETHREADS
+		/* will be created on-demand */
+		manager->mctxpool[i] = NULL;
 #endif
+	}
+	/*
+	 * Start each interface's clients on a different worker, so that
+	 * the first listeners of all interfaces are not on the same one.
+	 */
+	isc_random_get(&manager->nextthread);
+	manager->nextthread %= manager->nthreads;
 	manager->magic = MANAGER_MAGIC;
 
 	MTRACE("create");
@@ -2566,14 +3386,27 @@ ns_clientmgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 
 	return (ISC_R_SUCCESS);
 
+ cleanup_reclock:
+	(void) isc_mutex_destroy(&manager->reclock);
+
  cleanup_listlock:
 	(void) isc_mutex_destroy(&manager->listlock);
 
  cleanup_lock:
 	(void) isc_mutex_destroy(&manager->lock);
 
+ cleanup_mctxpool:
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_mem_put(mctx, manager->mctxpool,
+		    manager->nthreads * sizeof(isc_mem_t *));
+
+ cleanup_inactive:
+#endif
+	isc_mem_put(mctx, manager->inactive,
+		    manager->nthreads * sizeof(client_queue_t));
+
  cleanup_manager:
-	isc_mem_put(manager->mctx, manager, sizeof(*manager));
+	isc_mem_put(mctx, manager, sizeof(*manager));
 
 	return (result);
 }
@@ -2619,27 +3452,23 @@ ns_clientmgr_destroy(ns_clientmgr_t **managerp) {
 	*managerp = NULL;
 }
 
+/*
+ * Allocate a client for worker 'threadid'.  First try to get a
+ * recycled one; if that fails, make a new one.
+ */
 static isc_result_t
-get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
-	   dns_dispatch_t *disp, isc_boolean_t tcp)
+client_alloc(ns_clientmgr_t *manager, unsigned int threadid,
+	     ns_client_t **clientp)
 {
-	isc_result_t result = ISC_R_SUCCESS;
-	isc_event_t *ev;
+	isc_result_t result;
 	ns_client_t *client;
-	MTRACE("get client");
-
-	REQUIRE(manager != NULL);
 
 	if (manager->exiting)
 		return (ISC_R_SHUTTINGDOWN);
 
-	/*
-	 * Allocate a client.  First try to get a recycled one;
-	 * if that fails, make a new one.
-	 */
 	client = NULL;
 	if (!ns_g_clienttest)
-		ISC_QUEUE_POP(manager->inactive, ilink, client);
+		ISC_QUEUE_POP(manager->inactive[threadid], ilink, client);
 
 	if (client != NULL)
 		MTRACE("recycle");
@@ -2647,7 +3476,7 @@ get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
 		MTRACE("create new");
 
 		LOCK(&manager->lock);
-		result = client_create(manager, &client);
+		result = client_create(manager, threadid, &client);
 		UNLOCK(&manager->lock);
 		if (result != ISC_R_SUCCESS)
 			return (result);
@@ -2658,6 +3487,25 @@ get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
 	}
 
 	client->manager = manager;
+	*clientp = client;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+get_client(ns_clientmgr_t *manager, ns_interface_t *ifp,
+	   dns_dispatch_t *disp, unsigned int threadid, isc_boolean_t tcp)
+{
+	isc_result_t result;
+	isc_event_t *ev;
+	ns_client_t *client = NULL;
+	MTRACE("get client");
+
+	REQUIRE(manager != NULL);
+
+	result = client_alloc(manager, threadid, &client);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
 	ns_interface_attach(ifp, &client->interface);
 	client->state = NS_CLIENTSTATE_READY;
 	INSIST(client->recursionquota == NULL);
@@ -2695,7 +3543,8 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 	MTRACE("createclients");
 
 	for (disp = 0; disp < n; disp++) {
-		result = get_client(manager, ifp, ifp->udpdispatch[disp], tcp);
+		result = get_client(manager, ifp, ifp->udpdispatch[disp],
+				    next_threadid(manager), tcp);
 		if (result != ISC_R_SUCCESS)
 			break;
 	}
@@ -2714,6 +3563,9 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 {
 	isc_result_t result;
 	isc_netaddr_t tmpnetaddr;
+	isc_boolean_t cache = ISC_FALSE;
+	isc_boolean_t destination = ISC_FALSE;
+	unsigned int i;
 	int match;
 
 	if (acl == NULL) {
@@ -2723,7 +3575,24 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 			goto deny;
 	}
 
+	/*
+	 * A response may only be cached if it depends on the client's
+	 * source or destination address alone.
+	 */
+	destination = ISC_TF(netaddr == &client->destaddr);
+	if (netaddr != NULL && !destination)
+		client->fastpath.cacheable = ISC_FALSE;
+
+	/*
+	 * The answer for the client's own address and signer cannot
+	 * change during a request.
+	 */
 	if (netaddr == NULL) {
+		for (i = 0; i < client->naclcache &&
+			    i < NS_CLIENT_ACLCACHESIZE; i++)
+			if (client->aclcache[i].acl == acl)
+				return (client->aclcache[i].result);
+		cache = ISC_TRUE;
 		isc_netaddr_fromsockaddr(&tmpnetaddr, &client->peeraddr);
 		netaddr = &tmpnetaddr;
 	}
@@ -2738,10 +3607,23 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 	goto deny; /* Negative match or no match. */
 
  allow:
-	return (ISC_R_SUCCESS);
+	result = ISC_R_SUCCESS;
+	goto done;
 
  deny:
-	return (DNS_R_REFUSED);
+	result = DNS_R_REFUSED;
+
+ done:
+	if (cache) {
+		i = client->naclcache++ % NS_CLIENT_ACLCACHESIZE;
+		client->aclcache[i].acl = acl;
+		client->aclcache[i].result = result;
+	}
+	if (acl != NULL && client->fastpath.keylen != 0 &&
+	    client->fastpath.cacheable)
+		client_fastcond(client, acl, destination,
+				ISC_TF(result == ISC_R_SUCCESS));
+	return (result);
 }
 
 isc_result_t
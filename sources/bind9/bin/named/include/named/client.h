@@ -65,6 +65,7 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/stdtime.h>
+#include <isc/time.h>
 #include <isc/quota.h>
 #include <isc/queue.h>
 
@@ -73,6 +74,7 @@
 #include <dns/name.h>
 #include <dns/rdataclass.h>
 #include <dns/rdatatype.h>
+#include <dns/respcache.h>
 #include <dns/tcpmsg.h>
 #include <dns/types.h>
 
@@ -83,6 +85,11 @@
  *** Types
  ***/
 
+#define NS_CLIENT_ACLCACHESIZE	4
+
+/*% Header flags, type, EDNS bits, EDNS flags and the question name. */
+#define NS_CLIENT_FASTKEYSIZE	(7 + DNS_NAME_MAXWIRE)
+
 /*% nameserver client structure */
 struct ns_client {
 	unsigned int		magic;
@@ -106,6 +113,7 @@ struct ns_client {
 						 */
 	unsigned int		attributes;
 	isc_task_t *		task;
+	unsigned int		threadid;	/*%< worker running 'task' */
 	dns_view_t *		view;
 	dns_dispatch_t *	dispatch;
 	isc_socket_t *		udpsocket;
@@ -130,10 +138,13 @@ struct ns_client {
 	ns_query_t		query;
 	isc_stdtime_t		requesttime;
 	isc_stdtime_t		now;
+	isc_time_t		requeststart;	/*%< For latency stats */
 	dns_name_t		signername;   /*%< [T]SIG key name */
 	dns_name_t *		signer;	      /*%< NULL if not valid sig */
 	isc_boolean_t		mortal;	      /*%< Die after handling request */
-	isc_quota_t		*tcpquota;
+	isc_boolean_t		pipelined;    /*%< Another client reads the
+					       *   TCP connection */
+	ns_tcpconn_t		*tcpconn;
 	isc_quota_t		*recursionquota;
 	ns_interface_t		*interface;
 	isc_sockaddr_t		peeraddr;
@@ -156,6 +167,35 @@ struct ns_client {
 		dns_messageid_t		id;
 	} formerrcache;
 
+	/*%
+	 * Results of ns_client_checkaclsilent() for the client's own
+	 * address in the current request, so that ACLs consulted more
+	 * than once per request (allow-recursion, allow-query-cache...)
+	 * are only matched once.
+	 */
+	struct {
+		const dns_acl_t		*acl;
+		isc_result_t		result;
+	} aclcache[NS_CLIENT_ACLCACHESIZE];
+	unsigned int		naclcache;
+
+	/*%
+	 * A UDP query that may be answered from, or whose response may be
+	 * stored in, the view's response cache: its cache key, the zone
+	 * data generation when it arrived and the ACL outcomes the
+	 * response depends on.  'keylen' is zero for any other request;
+	 * 'cacheable' is cleared when the response turns out to depend on
+	 * anything else.
+	 */
+	struct {
+		unsigned char		key[NS_CLIENT_FASTKEYSIZE];
+		unsigned int		keylen;
+		isc_uint32_t		generation;
+		isc_boolean_t		cacheable;
+		dns_respcachecond_t	conds[DNS_RESPCACHE_MAXCONDS];
+		unsigned int		nconds;
+	} fastpath;
+
 	ISC_LINK(ns_client_t)	link;
 	ISC_LINK(ns_client_t)	rlink;
 	ISC_QLINK(ns_client_t)	ilink;
@@ -178,6 +218,7 @@ typedef ISC_LIST(ns_client_t) client_list_t;
 #define NS_CLIENTATTR_FILTER_AAAA_RC	0x080 /*%< recursing for A against AAAA */
 #endif
 #define NS_CLIENTATTR_WANTAD		0x100 /*%< want AD in response if possible */
+#define NS_CLIENTATTR_LATENCY		0x200 /*%< response sent, time it */
 
 extern unsigned int ns_client_requests;
 
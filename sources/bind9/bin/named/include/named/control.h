@@ -48,6 +48,8 @@
 #define NS_COMMAND_FLUSH	"flush"
 #define NS_COMMAND_FLUSHNAME	"flushname"
 #define NS_COMMAND_FLUSHTREE	"flushtree"
+#define NS_COMMAND_FLUSHDLZ	"flushdlz"
+#define NS_COMMAND_FLUSHDLZNAME	"flushdlzname"
 #define NS_COMMAND_STATUS	"status"
 #define NS_COMMAND_TSIGLIST	"tsig-list"
 #define NS_COMMAND_TSIGDELETE	"tsig-delete"
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef NAMED_QUERYLOG_H
+#define NAMED_QUERYLOG_H 1
+
+/*! \file
+ * \brief
+ * Binary query log.
+ *
+ * When "querylog-file" is configured, queries are not logged through
+ * the "queries" logging category but appended as compact binary records
+ * to a per-thread ring buffer.  A writer thread drains the rings in
+ * batches into the query log file, rolling it over like a logging
+ * channel file.  A record that does not fit in its ring is dropped and
+ * counted.  named-querylogprint(8) converts the file to text.
+ *
+ * The file starts with a header of NS_QUERYLOG_HEADERLEN octets:
+ * the 8 octet magic NS_QUERYLOG_MAGIC, a 16 bit format version and
+ * 16 bits of zero.  It is followed by records; all integers are in
+ * network byte order:
+ *
+ *\li	16 bits		record length, including this field
+ *\li	32 bits		request time, seconds since the epoch
+ *\li	32 bits		request time, microseconds
+ *\li	8 bits		NS_QUERYLOG_F_* flags
+ *\li	8 bits		client address family: 4, 6 or 0 (unknown)
+ *\li	16 bits		client port
+ *\li	0, 4 or 16	client address
+ *\li	8 bits		destination address family
+ *\li	0, 4 or 16	destination address
+ *\li	16 bits		query class
+ *\li	16 bits		query type
+ *\li	8 bits		length of the query name, followed by the name
+ *			in uncompressed wire format
+ *\li	8 bits		length of the view name, followed by the name
+ *\li	8 bits		length of the TSIG/SIG(0) signer name (0 if the
+ *			request was not signed), followed by the name
+ *			in uncompressed wire format
+ */
+
+#include <named/types.h>
+
+#define NS_QUERYLOG_MAGIC		"BIND9QLG"
+#define NS_QUERYLOG_VERSION		1
+#define NS_QUERYLOG_HEADERLEN		12
+#define NS_QUERYLOG_MAXRECORD		1024
+
+#define NS_QUERYLOG_F_RECURSE		0x01	/*%< RD set ("+") */
+#define NS_QUERYLOG_F_SIGNED		0x02	/*%< "S" */
+#define NS_QUERYLOG_F_EDNS		0x04	/*%< "E" */
+#define NS_QUERYLOG_F_TCP		0x08	/*%< "T" */
+#define NS_QUERYLOG_F_DO		0x10	/*%< "D" */
+#define NS_QUERYLOG_F_CD		0x20	/*%< "C" */
+
+isc_result_t
+ns_querylog_create(isc_mem_t *mctx, const char *path, int versions,
+		   isc_offset_t maxsize, unsigned int nrings,
+		   ns_querylog_t **qlogp);
+/*%<
+ * Create a binary query log writing to 'path', and start its writer
+ * thread.  'versions' and 'maxsize' have the meaning of the "versions"
+ * and "size" of a logging channel file (ISC_LOG_ROLLNEVER,
+ * ISC_LOG_ROLLINFINITE or a number of old versions to keep, 0 for no
+ * size limit).  'nrings' threads get a ring buffer of their own; any
+ * further thread shares one more ring, under a lock.
+ *
+ * Requires:
+ *\li	'path' is not NULL.
+ *\li	'nrings' > 0.
+ *\li	qlogp != NULL && *qlogp == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	any error opening 'path' or starting the writer thread.
+ */
+
+void
+ns_querylog_destroy(ns_querylog_t **qlogp);
+/*%<
+ * Stop the writer thread, write out whatever is left in the rings and
+ * close the file.  No other thread may be logging to '*qlogp'.
+ */
+
+const char *
+ns_querylog_path(ns_querylog_t *qlog);
+/*%<
+ * Return the file name 'qlog' was created with.
+ */
+
+void
+ns_querylog_query(ns_querylog_t *qlog, ns_client_t *client,
+		  unsigned int flags, unsigned int extflags);
+/*%<
+ * Log the query in 'client', whose header flags and extended flags
+ * were 'flags' and 'extflags', without blocking.
+ */
+
+#endif	/* NAMED_QUERYLOG_H */
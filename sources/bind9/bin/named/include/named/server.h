@@ -37,6 +37,13 @@
 #define NS_EVENTCLASS		ISC_EVENTCLASS(0x4E43)
 #define NS_EVENT_RELOAD		(NS_EVENTCLASS + 0)
 #define NS_EVENT_CLIENTCONTROL	(NS_EVENTCLASS + 1)
+#define NS_EVENT_ZONEINDEX	(NS_EVENTCLASS + 2)
+
+/*%
+ * Response latency is kept per rcode for NOERROR through REFUSED, with
+ * all other rcodes counted together in the last histogram.
+ */
+#define NS_LATENCY_RCODES	7
 
 /*%
  * Name server state.  Better here than in lots of separate global variables.
@@ -52,6 +59,7 @@ struct ns_server {
 	isc_quota_t		tcpquota;
 	isc_quota_t		recursionquota;
 	dns_acl_t		*blackholeacl;
+	dns_acl_t		*keepresporder;	/*%< No TCP pipelining */
 	char *			statsfile;	/*%< Statistics file name */
 	char *			dumpfile;	/*%< Dump file name */
 	char *			secrootsfile;	/*%< Secroots file name */
@@ -76,6 +84,7 @@ struct ns_server {
 	dns_loadmgr_t *		loadmgr;
 	dns_zonemgr_t *		zonemgr;
 	dns_viewlist_t		viewlist;
+	ns_zoneindexlist_t	zoneindexes;	/*%< "zone-index" files */
 	ns_interfacemgr_t *	interfacemgr;
 	dns_db_t *		in_roothints;
 	dns_tkeyctx_t *		tkeyctx;
@@ -92,6 +101,9 @@ struct ns_server {
 
 	isc_boolean_t		flushonshutdown;
 	isc_boolean_t		log_queries;	/*%< For BIND 8 compatibility */
+	ns_querylog_t *		querylog;	/*%< Binary query log */
+	dns_capture_t *		capture;	/*%< Message capture output */
+	dns_slabstore_t *	slabstore;	/*%< "share-rdata" store */
 
 	ns_cachelist_t		cachelist;	/*%< Possibly shared caches */
 	isc_stats_t *		nsstats;	/*%< Server stats */
@@ -100,6 +112,15 @@ struct ns_server {
 	isc_stats_t *		zonestats;	/*% Zone management stats */
 	isc_stats_t  *		resolverstats;	/*% Resolver stats */
 	isc_stats_t *		sockstats;	/*%< Socket stats */
+	isc_histo_t *		udplatency;	/*%< UDP response latency */
+	isc_histo_t *		tcplatency;	/*%< TCP response latency */
+	isc_histo_t *		rcodelatency[NS_LATENCY_RCODES];
+						/*%< Latency by rcode */
+	isc_histo_t *		tcprequests;	/*%< Requests per TCP
+						     connection */
+	unsigned int		tcphighwater;	/*%< Most TCP connections
+						     at once; locked by
+						     tcpquota.lock */
 
 	ns_controls_t *		controls;	/*%< Control channels */
 	unsigned int		dispatchgen;
@@ -167,13 +188,21 @@ enum {
 
 	dns_nsstatscounter_rpz_rewrites = 36,
 
+	dns_nsstatscounter_querylogdropped = 37,
+
+	dns_nsstatscounter_respcachehit = 38,
+
+	dns_nsstatscounter_tcpconnections = 39,
+	dns_nsstatscounter_tcppipelined = 40,
+	dns_nsstatscounter_tcpreclaimed = 41,
+
 #ifdef USE_RRL
-	dns_nsstatscounter_ratedropped = 37,
-	dns_nsstatscounter_rateslipped = 38,
+	dns_nsstatscounter_ratedropped = 42,
+	dns_nsstatscounter_rateslipped = 43,
 
-	dns_nsstatscounter_max = 39
+	dns_nsstatscounter_max = 44
 #else /* USE_RRL */
-	dns_nsstatscounter_max = 37
+	dns_nsstatscounter_max = 42
 #endif /* USE_RRL */
 };
 
@@ -250,6 +279,31 @@ ns_server_togglequerylog(ns_server_t *server, char *args);
 isc_result_t
 ns_server_dumpstats(ns_server_t *server);
 
+/*%
+ * Progress in configuring the zones listed in a view's "zone-index" file.
+ */
+typedef struct ns_zoneindexstatus {
+	const char *		file;
+	isc_uint32_t		total;		/*%< Zones in the index */
+	isc_uint32_t		configured;	/*%< Zones configured so far */
+	isc_uint32_t		reused;		/*%< ... kept from the old view */
+	isc_uint32_t		failed;		/*%< Zones that were skipped */
+	isc_uint64_t		elapsed;	/*%< Microseconds */
+	isc_boolean_t		done;
+} ns_zoneindexstatus_t;
+
+isc_result_t
+ns_server_zoneindexstatus(ns_server_t *server, dns_view_t *view,
+			  ns_zoneindexstatus_t *status);
+/*%<
+ * Fill in '*status' for the zone index of 'view'.  'status->elapsed'
+ * runs until the last zone has been configured.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND		'view' has no zone index.
+ */
+
 /*%
  * Dump the current cache to the dump file.
  */
@@ -282,6 +336,13 @@ ns_server_flushcache(ns_server_t *server, char *args);
 isc_result_t
 ns_server_flushnode(ns_server_t *server, char *args, isc_boolean_t tree);
 
+/*%
+ * Flush the DLZ result caches, or if 'byname' is true only the name
+ * given in 'args'.
+ */
+isc_result_t
+ns_server_flushdlz(ns_server_t *server, char *args, isc_boolean_t byname);
+
 /*%
  * Report the server's status.
  */
@@ -28,6 +28,7 @@ typedef struct ns_cache			ns_cache_t;
 typedef ISC_LIST(ns_cache_t)		ns_cachelist_t;
 typedef struct ns_client		ns_client_t;
 typedef struct ns_clientmgr		ns_clientmgr_t;
+typedef struct ns_tcpconn		ns_tcpconn_t;
 typedef struct ns_query			ns_query_t;
 typedef struct ns_server 		ns_server_t;
 typedef struct ns_xmld			ns_xmld_t;
@@ -45,4 +46,7 @@ typedef struct ns_dispatch		ns_dispatch_t;
 typedef ISC_LIST(ns_dispatch_t)		ns_dispatchlist_t;
 typedef struct ns_statschannel		ns_statschannel_t;
 typedef ISC_LIST(ns_statschannel_t)	ns_statschannellist_t;
+typedef struct ns_querylog		ns_querylog_t;
+typedef struct ns_zoneindex		ns_zoneindex_t;
+typedef ISC_LIST(ns_zoneindex_t)	ns_zoneindexlist_t;
 #endif /* NAMED_TYPES_H */
@@ -916,6 +916,12 @@ do_scan(ns_interfacemgr_t *mgr, ns_listenlist_t *ext_listen,
 				 isc_result_totext(result));
 	else
 		result = ISC_R_SUCCESS;
+
+	if (adjusting == ISC_FALSE) {
+		/* The server copies these ACLs once the scan is done. */
+		(void)dns_acl_compile(mgr->aclenv.localhost);
+		(void)dns_acl_compile(mgr->aclenv.localnets);
+	}
  cleanup_iter:
 	isc_interfaceiter_destroy(&iter);
 	return (result);
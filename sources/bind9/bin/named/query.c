@@ -58,6 +58,7 @@
 #include <named/client.h>
 #include <named/globals.h>
 #include <named/log.h>
+#include <named/querylog.h>
 #include <named/server.h>
 #include <named/sortlist.h>
 #include <named/xfrout.h>
@@ -390,6 +391,9 @@ query_reset(ns_client_t *client, isc_boolean_t everything) {
 	if (client->query.rpz_st != NULL) {
 		rpz_st_clear(client);
 		if (everything) {
+			if (client->query.rpz_st->snapshot != NULL)
+				dns_rpz_snapshot_detach(
+					&client->query.rpz_st->snapshot);
 			isc_mem_put(client->mctx, client->query.rpz_st,
 				    sizeof(*client->query.rpz_st));
 			client->query.rpz_st = NULL;
@@ -865,6 +869,13 @@ query_getzonedb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 	if (result != ISC_R_SUCCESS)
 		goto fail;
 
+	/*
+	 * The response cache only learns of changes to the data of
+	 * zones with versioned databases.
+	 */
+	if (dns_db_ispersistent(db))
+		client->fastpath.cacheable = ISC_FALSE;
+
 	/* Transfer ownership. */
 	*zonep = zone;
 	*dbp = db;
@@ -1058,6 +1069,9 @@ query_getcachedb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 
 	/* Approved. */
 
+	/* Cached data expires; don't keep responses built from it. */
+	client->fastpath.cacheable = ISC_FALSE;
+
 	/* Transfer ownership. */
 	*dbp = db;
 
@@ -1143,6 +1157,7 @@ query_getdb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 			 */
 			zone = NULL;
 			result = tresult;
+			client->fastpath.cacheable = ISC_FALSE;
 		}
 	}
 
@@ -4081,6 +4096,49 @@ rpz_rrset_find(ns_client_t *client, dns_rpz_type_t rpz_type,
 	return (result);
 }
 
+/*
+ * Find the policy zones that might have IP or NSIP triggers
+ * for the addresses in an A or AAAA rdataset.
+ */
+static dns_rpz_zbits_t
+rpz_ip_zbits(dns_rpz_snapshot_t *snapshot, dns_rdataset_t *rdataset,
+	     dns_rpz_type_t rpz_type)
+{
+	dns_rpz_zbits_t zbits;
+	struct in_addr ina;
+	struct in6_addr in6a;
+	isc_netaddr_t netaddr;
+	isc_result_t result;
+
+	if (snapshot == NULL)
+		return (DNS_RPZ_ALL_ZBITS);
+
+	zbits = 0;
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset)) {
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(rdataset, &rdata);
+		switch (rdata.type) {
+		case dns_rdatatype_a:
+			INSIST(rdata.length == 4);
+			memmove(&ina.s_addr, rdata.data, 4);
+			isc_netaddr_fromin(&netaddr, &ina);
+			break;
+		case dns_rdatatype_aaaa:
+			INSIST(rdata.length == 16);
+			memmove(in6a.s6_addr, rdata.data, 16);
+			isc_netaddr_fromin6(&netaddr, &in6a);
+			break;
+		default:
+			continue;
+		}
+		zbits |= dns_rpz_snapshot_ip(snapshot, rpz_type, &netaddr);
+	}
+	return (zbits);
+}
+
 /*
  * Check the IP address in an A or AAAA rdataset against
  * the IP or NSIP response policy rules of a view.
@@ -4094,6 +4152,7 @@ rpz_rewrite_ip(ns_client_t *client, dns_rdataset_t *rdataset,
 	dns_zone_t *zone;
 	dns_db_t *db;
 	dns_rpz_zone_t *rpz;
+	dns_rpz_zbits_t zbits;
 	isc_result_t result;
 
 	st = client->query.rpz_st;
@@ -4102,6 +4161,12 @@ rpz_rewrite_ip(ns_client_t *client, dns_rdataset_t *rdataset,
 		if (st->m.rdataset == NULL)
 			return (DNS_R_SERVFAIL);
 	}
+
+	/*
+	 * Find the policy zones with a trigger for any of the addresses.
+	 */
+	zbits = rpz_ip_zbits(st->snapshot, rdataset, rpz_type);
+
 	zone = NULL;
 	db = NULL;
 	for (rpz = ISC_LIST_HEAD(client->view->rpz_zones);
@@ -4109,6 +4174,8 @@ rpz_rewrite_ip(ns_client_t *client, dns_rdataset_t *rdataset,
 	     rpz = ISC_LIST_NEXT(rpz, link)) {
 		if (!RECURSIONOK(client) && rpz->recursive_only)
 			continue;
+		if (DNS_RPZ_SUMMARY_MISS(zbits, rpz->num))
+			continue;
 
 		/*
 		 * Do not check policy zones that cannot replace a policy
@@ -4403,6 +4470,7 @@ rpz_rewrite_name(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	dns_dbversion_t *version;
 	dns_dbnode_t *node;
 	dns_rpz_policy_t policy;
+	dns_rpz_zbits_t zbits, skipped;
 	unsigned int labels;
 	isc_result_t result;
 
@@ -4411,6 +4479,12 @@ rpz_rewrite_name(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	db = NULL;
 	node = NULL;
 
+	/*
+	 * Find the policy zones that might have a trigger for the name.
+	 */
+	zbits = dns_rpz_snapshot_names(st->snapshot, rpz_type, qname);
+	skipped = 0;
+
 	for (rpz = ISC_LIST_HEAD(client->view->rpz_zones);
 	     rpz != NULL;
 	     rpz = ISC_LIST_NEXT(rpz, link)) {
@@ -4428,6 +4502,20 @@ rpz_rewrite_name(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 			    st->m.type < rpz_type)
 				continue;
 		}
+
+		/*
+		 * Skip policy zones without a trigger for the name
+		 * unless the name must be trimmed to fit.
+		 */
+		if (DNS_RPZ_SUMMARY_MISS(zbits, rpz->num) &&
+		    qname->length - 1 +
+		    (rpz_type == DNS_RPZ_TYPE_NSDNAME ?
+		     rpz->nsdname.length : rpz->origin.length) <=
+		    DNS_NAME_MAXWIRE) {
+			skipped |= DNS_RPZ_ZBIT(rpz->num);
+			continue;
+		}
+
 		/*
 		 * Construct the policy's owner name.
 		 */
@@ -4566,6 +4654,11 @@ rpz_rewrite_name(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 		}
 	}
 
+	/*
+	 * Note what the skipped policy zones have as rpz_find() would.
+	 */
+	dns_rpz_snapshot_enabled(st->snapshot, skipped, st);
+
 	rpz_clean(&zone, &db, &node, rdatasetp);
 	return (ISC_R_SUCCESS);
 }
@@ -4620,9 +4713,18 @@ rpz_rewrite(ns_client_t *client, dns_rdatatype_t qtype, isc_result_t qresult,
 		st->qname = dns_fixedname_name(&st->_qnamef);
 		st->r_name = dns_fixedname_name(&st->_r_namef);
 		st->fname = dns_fixedname_name(&st->_fnamef);
+		st->snapshot = NULL;
 		client->query.rpz_st = st;
 	}
 
+	/*
+	 * Use the summary of the policy zones as it is when the query
+	 * starts until the query is done.
+	 */
+	if (!resuming)
+		dns_rpz_summary_current(client->view->rpz_summary,
+					&st->snapshot);
+
 	/*
 	 * There is nothing to rewrite if the main query failed.
 	 */
@@ -7587,6 +7689,12 @@ log_query(ns_client_t *client, unsigned int flags, unsigned int extflags) {
 	dns_rdataset_t *rdataset;
 	int level = ISC_LOG_INFO;
 
+	if (ns_g_server->querylog != NULL) {
+		ns_querylog_query(ns_g_server->querylog, client,
+				  flags, extflags);
+		return;
+	}
+
 	if (! isc_log_wouldlog(ns_g_lctx, level))
 		return;
 
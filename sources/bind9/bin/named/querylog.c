@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <stdio.h>
+
+#include <isc/buffer.h>
+#include <isc/condition.h>
+#include <isc/log.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/netaddr.h>
+#include <isc/print.h>
+#include <isc/ringbuf.h>
+#include <isc/sockaddr.h>
+#include <isc/stats.h>
+#include <isc/stdio.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/view.h>
+
+#include <named/client.h>
+#include <named/globals.h>
+#include <named/log.h>
+#include <named/query.h>
+#include <named/querylog.h>
+#include <named/server.h>
+
+#define QUERYLOG_MAGIC			ISC_MAGIC('Q', 'L', 'o', 'g')
+#define VALID_QUERYLOG(q)		ISC_MAGIC_VALID(q, QUERYLOG_MAGIC)
+
+/*%
+ * Bytes of records each ring can hold; a power of two.
+ */
+#define RINGSIZE		(256 * 1024)
+
+/*%
+ * How long the writer thread sleeps when it is not woken by a ring
+ * filling up, in milliseconds.
+ */
+#define FLUSHINTERVAL		100
+
+struct ns_querylog {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	char			*path;
+	int			versions;
+	isc_offset_t		maxsize;
+	isc_ringbuf_t		*ringbuf;
+
+	/* Writer thread only, after creation. */
+	FILE			*fp;
+	isc_offset_t		offset;
+	isc_boolean_t		exceeded;
+	isc_uint64_t		dropped;	/* as last reported */
+	isc_stdtime_t		reported;
+
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t		thread;
+	isc_mutex_t		lock;
+	isc_condition_t		cond;
+	isc_boolean_t		exiting;	/* locked by lock */
+#else
+	isc_stdtime_t		flushed;
+#endif
+};
+
+static isc_result_t
+openfile(ns_querylog_t *qlog) {
+	unsigned char header[NS_QUERYLOG_HEADERLEN];
+	isc_result_t result;
+	off_t offset;
+
+	result = isc_stdio_open(qlog->path, "ab", &qlog->fp);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = isc_stdio_seek(qlog->fp, 0, SEEK_END);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_tell(qlog->fp, &offset);
+	if (result == ISC_R_SUCCESS && offset == 0) {
+		memmove(header, NS_QUERYLOG_MAGIC, 8);
+		header[8] = 0;
+		header[9] = NS_QUERYLOG_VERSION;
+		header[10] = header[11] = 0;
+		result = isc_stdio_write(header, sizeof(header), 1,
+					 qlog->fp, NULL);
+		offset = sizeof(header);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_stdio_close(qlog->fp);
+		qlog->fp = NULL;
+		return (result);
+	}
+	qlog->offset = offset;
+	qlog->exceeded = ISC_TF(qlog->maxsize != 0 &&
+				qlog->offset >= qlog->maxsize);
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Roll the file as a logging channel with the same number of versions
+ * would be rolled.
+ */
+static void
+rollfile(ns_querylog_t *qlog) {
+	isc_logfile_t file;
+	isc_result_t result;
+
+	memset(&file, 0, sizeof(file));
+	file.name = qlog->path;
+	file.versions = qlog->versions;
+	file.maximum_size = qlog->maxsize;
+	result = isc_logfile_roll(&file);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_QUERY, ISC_LOG_ERROR,
+			      "unable to roll query log '%s': %s",
+			      qlog->path, isc_result_totext(result));
+}
+
+/*%
+ * Count the records in a batch that cannot be written as dropped.
+ */
+static void
+dropbatch(const unsigned char *data, size_t len) {
+	size_t off = 0;
+
+	while (off + 2 <= len) {
+		off += (data[off] << 8) | data[off + 1];
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_querylogdropped);
+	}
+}
+
+static void
+writebatch(void *arg, unsigned char *data, unsigned int len) {
+	ns_querylog_t *qlog = arg;
+	isc_result_t result;
+
+	if (qlog->fp == NULL || qlog->exceeded) {
+		dropbatch(data, len);
+		return;
+	}
+
+	result = isc_stdio_write(data, 1, len, qlog->fp, NULL);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_QUERY, ISC_LOG_ERROR,
+			      "writing query log '%s': %s", qlog->path,
+			      isc_result_totext(result));
+		return;
+	}
+	qlog->offset += len;
+
+	if (qlog->maxsize == 0 || qlog->offset < qlog->maxsize)
+		return;
+
+	/*
+	 * As with a logging channel, a file that may not be rolled
+	 * simply stops growing.
+	 */
+	if (qlog->versions == ISC_LOG_ROLLNEVER) {
+		qlog->exceeded = ISC_TRUE;
+		return;
+	}
+	(void)isc_stdio_close(qlog->fp);
+	qlog->fp = NULL;
+	rollfile(qlog);
+	result = openfile(qlog);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_QUERY, ISC_LOG_ERROR,
+			      "reopening query log '%s': %s", qlog->path,
+			      isc_result_totext(result));
+}
+
+/*%
+ * Move everything queued in the rings to the file.  Called by the
+ * writer thread only.
+ */
+static void
+drain(ns_querylog_t *qlog) {
+	isc_uint64_t dropped;
+	isc_stdtime_t now;
+
+	isc_ringbuf_drain(qlog->ringbuf, writebatch, qlog);
+	if (qlog->fp != NULL)
+		(void)isc_stdio_flush(qlog->fp);
+
+	/* Say so when records are being lost, but not too often. */
+	dropped = isc_ringbuf_dropped(qlog->ringbuf);
+	if (dropped != qlog->dropped) {
+		isc_stdtime_get(&now);
+		if (now - qlog->reported >= 60) {
+			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+				      NS_LOGMODULE_QUERY, ISC_LOG_WARNING,
+				      "query log '%s': %" ISC_PRINT_QUADFORMAT
+				      "u records dropped because the buffers "
+				      "were full", qlog->path,
+				      dropped - qlog->dropped);
+			qlog->dropped = dropped;
+			qlog->reported = now;
+		}
+	}
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+writer(isc_threadarg_t arg) {
+	ns_querylog_t *qlog = arg;
+	isc_interval_t interval;
+	isc_time_t until;
+	isc_boolean_t exiting = ISC_FALSE;
+
+	isc_interval_set(&interval, 0, FLUSHINTERVAL * 1000000);
+	while (!exiting) {
+		LOCK(&qlog->lock);
+		if (!qlog->exiting) {
+			if (isc_time_nowplusinterval(&until, &interval) ==
+			    ISC_R_SUCCESS)
+				(void)isc_condition_waituntil(&qlog->cond,
+							      &qlog->lock,
+							      &until);
+		}
+		exiting = qlog->exiting;
+		UNLOCK(&qlog->lock);
+		drain(qlog);
+	}
+	return ((isc_threadresult_t)0);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
+isc_result_t
+ns_querylog_create(isc_mem_t *mctx, const char *path, int versions,
+		   isc_offset_t maxsize, unsigned int nrings,
+		   ns_querylog_t **qlogp)
+{
+	ns_querylog_t *qlog;
+	isc_result_t result;
+
+	REQUIRE(path != NULL);
+	REQUIRE(nrings > 0);
+	REQUIRE(qlogp != NULL && *qlogp == NULL);
+
+	qlog = isc_mem_get(mctx, sizeof(*qlog));
+	if (qlog == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(qlog, 0, sizeof(*qlog));
+	isc_mem_attach(mctx, &qlog->mctx);
+	qlog->versions = versions;
+	qlog->maxsize = maxsize;
+
+	qlog->path = isc_mem_strdup(mctx, path);
+	if (qlog->path == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	result = isc_ringbuf_create(mctx, nrings, RINGSIZE, &qlog->ringbuf);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	result = openfile(qlog);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+#ifdef ISC_PLATFORM_USETHREADS
+	result = isc_mutex_init(&qlog->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = isc_condition_init(&qlog->cond);
+	if (result != ISC_R_SUCCESS) {
+		DESTROYLOCK(&qlog->lock);
+		goto cleanup;
+	}
+	result = isc_thread_create(writer, qlog, &qlog->thread);
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_condition_destroy(&qlog->cond);
+		DESTROYLOCK(&qlog->lock);
+		goto cleanup;
+	}
+#endif
+
+	qlog->magic = QUERYLOG_MAGIC;
+	*qlogp = qlog;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	if (qlog->fp != NULL)
+		(void)isc_stdio_close(qlog->fp);
+	if (qlog->ringbuf != NULL)
+		isc_ringbuf_destroy(&qlog->ringbuf);
+	if (qlog->path != NULL)
+		isc_mem_free(mctx, qlog->path);
+	isc_mem_putanddetach(&qlog->mctx, qlog, sizeof(*qlog));
+	return (result);
+}
+
+void
+ns_querylog_destroy(ns_querylog_t **qlogp) {
+	ns_querylog_t *qlog;
+
+	REQUIRE(qlogp != NULL && VALID_QUERYLOG(*qlogp));
+	qlog = *qlogp;
+	*qlogp = NULL;
+
+#ifdef ISC_PLATFORM_USETHREADS
+	/* The writer drains the rings once more on its way out. */
+	LOCK(&qlog->lock);
+	qlog->exiting = ISC_TRUE;
+	SIGNAL(&qlog->cond);
+	UNLOCK(&qlog->lock);
+	(void)isc_thread_join(qlog->thread, NULL);
+	(void)isc_condition_destroy(&qlog->cond);
+	DESTROYLOCK(&qlog->lock);
+#else
+	drain(qlog);
+#endif
+
+	if (qlog->fp != NULL)
+		(void)isc_stdio_close(qlog->fp);
+	isc_ringbuf_destroy(&qlog->ringbuf);
+	isc_mem_free(qlog->mctx, qlog->path);
+	qlog->magic = 0;
+	isc_mem_putanddetach(&qlog->mctx, qlog, sizeof(*qlog));
+}
+
+const char *
+ns_querylog_path(ns_querylog_t *qlog) {
+	REQUIRE(VALID_QUERYLOG(qlog));
+
+	return (qlog->path);
+}
+
+static void
+putaddr(isc_buffer_t *b, const isc_netaddr_t *na) {
+	switch (na->family) {
+	case AF_INET:
+		isc_buffer_putuint8(b, 4);
+		isc_buffer_putmem(b, (const unsigned char *)&na->type.in, 4);
+		break;
+	case AF_INET6:
+		isc_buffer_putuint8(b, 6);
+		isc_buffer_putmem(b, (const unsigned char *)&na->type.in6, 16);
+		break;
+	default:
+		isc_buffer_putuint8(b, 0);
+		break;
+	}
+}
+
+static void
+putname(isc_buffer_t *b, dns_name_t *name) {
+	isc_region_t r;
+
+	dns_name_toregion(name, &r);
+	isc_buffer_putuint8(b, (isc_uint8_t)r.length);
+	isc_buffer_putmem(b, r.base, r.length);
+}
+
+void
+ns_querylog_query(ns_querylog_t *qlog, ns_client_t *client,
+		  unsigned int flags, unsigned int extflags)
+{
+	unsigned char data[NS_QUERYLOG_MAXRECORD];
+	isc_buffer_t b;
+	isc_netaddr_t netaddr;
+	dns_rdataset_t *rdataset;
+	isc_region_t r;
+	isc_result_t result;
+	isc_boolean_t wake;
+	unsigned int len, qflags = 0;
+	size_t viewlen;
+
+	REQUIRE(VALID_QUERYLOG(qlog));
+
+	rdataset = ISC_LIST_HEAD(client->query.qname->list);
+	INSIST(rdataset != NULL);
+
+	if ((client->query.attributes & NS_QUERYATTR_WANTRECURSION) != 0)
+		qflags |= NS_QUERYLOG_F_RECURSE;
+	if (client->signer != NULL)
+		qflags |= NS_QUERYLOG_F_SIGNED;
+	if (client->opt != NULL)
+		qflags |= NS_QUERYLOG_F_EDNS;
+	if ((client->attributes & NS_CLIENTATTR_TCP) != 0)
+		qflags |= NS_QUERYLOG_F_TCP;
+	if ((extflags & DNS_MESSAGEEXTFLAG_DO) != 0)
+		qflags |= NS_QUERYLOG_F_DO;
+	if ((flags & DNS_MESSAGEFLAG_CD) != 0)
+		qflags |= NS_QUERYLOG_F_CD;
+
+	/*
+	 * Names are at most 255 octets and the view name is cut to as
+	 * much, so a record always fits in 'data'.
+	 */
+	isc_buffer_init(&b, data, sizeof(data));
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putuint32(&b, isc_time_seconds(&client->requeststart));
+	isc_buffer_putuint32(&b,
+			     isc_time_nanoseconds(&client->requeststart) /
+			     1000);
+	isc_buffer_putuint8(&b, qflags);
+	if (client->peeraddr_valid) {
+		isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
+		isc_buffer_putuint8(&b, netaddr.family == AF_INET6 ? 6 :
+				    (netaddr.family == AF_INET ? 4 : 0));
+		isc_buffer_putuint16(&b, isc_sockaddr_getport(&client->peeraddr));
+		if (netaddr.family == AF_INET)
+			isc_buffer_putmem(&b,
+				(const unsigned char *)&netaddr.type.in, 4);
+		else if (netaddr.family == AF_INET6)
+			isc_buffer_putmem(&b,
+				(const unsigned char *)&netaddr.type.in6, 16);
+	} else {
+		isc_buffer_putuint8(&b, 0);
+		isc_buffer_putuint16(&b, 0);
+	}
+	putaddr(&b, &client->destaddr);
+	isc_buffer_putuint16(&b, rdataset->rdclass);
+	isc_buffer_putuint16(&b, rdataset->type);
+	putname(&b, client->query.qname);
+	viewlen = 0;
+	if (client->view != NULL)
+		viewlen = ISC_MIN(strlen(client->view->name), 255);
+	isc_buffer_putuint8(&b, (isc_uint8_t)viewlen);
+	if (viewlen != 0)
+		isc_buffer_putmem(&b, (const unsigned char *)client->view->name,
+				  viewlen);
+	if (client->signer != NULL)
+		putname(&b, client->signer);
+	else
+		isc_buffer_putuint8(&b, 0);
+
+	len = isc_buffer_usedlength(&b);
+	data[0] = (len >> 8) & 0xff;
+	data[1] = len & 0xff;
+
+	r.base = data;
+	r.length = len;
+	result = isc_ringbuf_putv(qlog->ringbuf, &r, 1, &wake);
+	if (result != ISC_R_SUCCESS) {
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_querylogdropped);
+		return;
+	}
+
+#ifdef ISC_PLATFORM_USETHREADS
+	/*
+	 * Wake the writer early when the ring passes half full.  The
+	 * condition is signalled without the lock; a missed wakeup only
+	 * delays the writer until its next timeout.
+	 */
+	if (wake)
+		SIGNAL(&qlog->cond);
+#else
+	if (wake || client->now != qlog->flushed) {
+		drain(qlog);
+		qlog->flushed = client->now;
+	}
+#endif
+}
@@ -33,6 +33,7 @@
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/histo.h>
 #include <isc/httpd.h>
 #include <isc/lex.h>
 #include <isc/parseint.h>
@@ -58,6 +59,7 @@
 #include <dns/acache.h>
 #include <dns/adb.h>
 #include <dns/cache.h>
+#include <dns/capture.h>
 #include <dns/db.h>
 #include <dns/dispatch.h>
 #include <dns/dlz.h>
@@ -79,8 +81,11 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
+#include <dns/sdlz.h>
 #include <dns/secalg.h>
+#include <dns/slabstore.h>
 #include <dns/soa.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -101,6 +106,7 @@
 #include <named/lwresd.h>
 #include <named/main.h>
 #include <named/os.h>
+#include <named/querylog.h>
 #include <named/server.h>
 #include <named/statschannel.h>
 #include <named/tkeyconf.h>
@@ -240,6 +246,61 @@ typedef struct {
 		isc_refcount_t refs;
 } ns_zoneload_t;
 
+/*%
+ * A view's "zone-index" file: one master zone per line, each using the
+ * view's options.  The file is read into 'data' when the configuration
+ * is loaded, and zones that can be kept from the previous view are moved
+ * over at once.  All other zones are created and configured in batches
+ * on the server task after the new configuration has been committed,
+ * so that neither startup nor reconfiguration waits for the whole index.
+ */
+#define ZONEINDEX_MAGIC		ISC_MAGIC('Z', 'I', 'd', 'x')
+#define ZONEINDEX_VALID(z)	ISC_MAGIC_VALID(z, ZONEINDEX_MAGIC)
+
+#define ZONEINDEX_BATCH		1000	/* zones per server task event */
+
+#define ZONEINDEX_NEW		0
+#define ZONEINDEX_REUSED	1	/* moved from the previous view */
+#define ZONEINDEX_SKIP		2	/* duplicate of another zone */
+
+typedef struct {
+	isc_uint32_t			name;	/* offsets into 'data' */
+	isc_uint32_t			file;
+} zoneindex_entry_t;
+
+struct ns_zoneindex {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	dns_view_t			*view;
+	char				*path;
+	/* named.conf, kept for ns_zone_configure() */
+	cfg_parser_t			*parser;
+	cfg_obj_t			*config;
+	const cfg_obj_t			*vconfig;
+	cfg_aclconfctx_t		*actx;
+	/* The "zone" statement that each entry is configured with */
+	cfg_parser_t			*zparser;
+	cfg_obj_t			*zconfig;
+	const cfg_obj_t			*zone;
+	dns_masterformat_t		format;
+	char				*data;
+	size_t				datalen;
+	zoneindex_entry_t		*entries;
+	unsigned char			*state;
+	isc_uint32_t			nentries;
+	isc_uint32_t			next;
+	isc_uint32_t			configured;
+	isc_uint32_t			reused;
+	isc_uint32_t			failed;
+	isc_time_t			started;
+	isc_time_t			finished;
+	isc_boolean_t			running;
+	isc_boolean_t			done;
+	isc_boolean_t			posted;
+	isc_boolean_t			canceled;
+	ISC_LINK(ns_zoneindex_t)	link;
+};
+
 /*
  * These zones should not leak onto the Internet.
  */
@@ -386,6 +447,9 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 static isc_result_t
 add_keydata_zone(dns_view_t *view, const char *directory, isc_mem_t *mctx);
 
+static isc_result_t
+configure_zoneindex(dns_view_t *view);
+
 static void
 end_reserved_dispatches(ns_server_t *server, isc_boolean_t all);
 
@@ -1457,6 +1521,63 @@ dlzconfigure_callback(dns_view_t *view, dns_zone_t *zone) {
 						zone, zclass, origin));
 }
 
+/*
+ * Set up the result cache of the view's DLZ database if 'max-cache-ttl'
+ * is set.
+ */
+static isc_result_t
+configure_dlzcache(dns_view_t *view, const cfg_obj_t *dlz) {
+	const cfg_obj_t *obj;
+	dns_ttl_t maxttl, maxncachettl;
+	isc_resourcevalue_t maxsize = 16 * 1024 * 1024;
+	unsigned int threads = 2;
+	isc_result_t result;
+
+	obj = NULL;
+	(void)cfg_map_get(dlz, "max-cache-ttl", &obj);
+	if (obj == NULL || cfg_obj_asuint32(obj) == 0)
+		return (ISC_R_SUCCESS);
+	maxttl = maxncachettl = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	(void)cfg_map_get(dlz, "max-ncache-ttl", &obj);
+	if (obj != NULL)
+		maxncachettl = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	(void)cfg_map_get(dlz, "max-cache-size", &obj);
+	if (obj != NULL && cfg_obj_isstring(obj))
+		maxsize = 0;
+	else if (obj != NULL) {
+		maxsize = cfg_obj_asuint64(obj);
+		if (maxsize > SIZE_MAX) {
+			cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+				    "'max-cache-size "
+				    "%" ISC_PRINT_QUADFORMAT "u' "
+				    "is too large for this "
+				    "system; reducing to %lu",
+				    maxsize, (unsigned long)SIZE_MAX);
+			maxsize = SIZE_MAX;
+		}
+	}
+
+	obj = NULL;
+	(void)cfg_map_get(dlz, "refresh-threads", &obj);
+	if (obj != NULL)
+		threads = cfg_obj_asuint32(obj);
+
+	result = dns_sdlz_setcache(view->dlzdatabase, maxttl, maxncachettl,
+				   (size_t)maxsize, threads);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		cfg_obj_log(dlz, ns_g_lctx, ISC_LOG_WARNING,
+			    "dlz '%s': driver does not support caching; "
+			    "'max-cache-ttl' ignored",
+			    cfg_obj_asstring(cfg_map_getname(dlz)));
+		result = ISC_R_SUCCESS;
+	}
+	return (result);
+}
+
 static isc_result_t
 dns64_reverse(dns_view_t *view, isc_mem_t *mctx, isc_netaddr_t *na,
 	      unsigned int prefixlen, const char *server,
@@ -1653,6 +1774,28 @@ configure_rpz(dns_view_t *view, const cfg_listelt_t *element,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Can a view share the summary of the policy zones of the view
+ * that it replaces?  Only if the policy zones are the same and
+ * in the same order, so that each keeps its number in the summary.
+ */
+static isc_boolean_t
+rpz_summary_reusable(dns_view_t *originview, dns_view_t *view) {
+	dns_rpz_zone_t *old, *new;
+
+	if (originview->rpz_summary == NULL)
+		return (ISC_FALSE);
+	for (old = ISC_LIST_HEAD(originview->rpz_zones),
+	     new = ISC_LIST_HEAD(view->rpz_zones);
+	     old != NULL && new != NULL;
+	     old = ISC_LIST_NEXT(old, link),
+	     new = ISC_LIST_NEXT(new, link)) {
+		if (!dns_name_equal(&old->origin, &new->origin))
+			return (ISC_FALSE);
+	}
+	return (ISC_TF(old == NULL && new == NULL));
+}
+
 #ifdef USE_RRL
 #define CHECK_RRL(cond, pat, val1, val2)				\
 	do {								\
@@ -2059,6 +2202,57 @@ create_empty_zone(dns_zone_t *zone, dns_name_t *name, dns_view_t *view,
 	return (result);
 }
 
+/*
+ * Set up the response cache of 'view' if "response-cache-entries" is
+ * not zero.  The cached responses cannot vary by client in the ways
+ * the options below make them, so those rule it out.
+ */
+static isc_result_t
+configure_respcache(dns_view_t *view, const cfg_obj_t **maps) {
+	const cfg_obj_t *obj = NULL;
+	dns_respcache_t *respcache = NULL;
+	const char *conflict = NULL;
+	isc_uint32_t entries;
+	isc_result_t result;
+
+	result = ns_config_get(maps, "response-cache-entries", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	entries = cfg_obj_asuint32(obj);
+	if (entries == 0)
+		return (ISC_R_SUCCESS);
+
+	if (view->recursion)
+		conflict = "recursion";
+	else if (!ISC_LIST_EMPTY(view->rpz_zones))
+		conflict = "response-policy";
+	else if (view->dns64cnt != 0)
+		conflict = "dns64";
+	else if (view->sortlist != NULL)
+		conflict = "sortlist";
+	else if (view->nocasecompress != NULL)
+		conflict = "no-case-compress";
+	else if (view->capture != NULL)
+		conflict = "capture";
+	else if (view->v4_aaaa != dns_v4_aaaa_ok)
+		conflict = "filter-aaaa-on-v4";
+	else if (view->rrl != NULL)
+		conflict = "rate-limit";
+	if (conflict != NULL) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "view '%s': 'response-cache-entries' has no "
+			      "effect with '%s'", view->name, conflict);
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_respcache_create(view->mctx, entries, &respcache);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	dns_view_setrespcache(view, respcache);
+	dns_respcache_detach(&respcache);
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Configure 'view' according to 'vconfig', taking defaults from 'config'
  * where values are missing in 'vconfig'.
@@ -2115,6 +2309,7 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	const cfg_obj_t *disablelist = NULL;
 	isc_stats_t *resstats = NULL;
 	dns_stats_t *resquerystats = NULL;
+	isc_histo_t *latency = NULL;
 	isc_boolean_t auto_dlv = ISC_FALSE;
 	isc_boolean_t auto_root = ISC_FALSE;
 	ns_cache_t *nsc;
@@ -2258,6 +2453,51 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 				goto cleanup;
 			element = cfg_list_next(element);
 		}
+
+		/*
+		 * The policy zones report their triggers to a summary
+		 * that lets queries skip the zones that cannot match.
+		 * Keep the summary, or at least its policy update latency
+		 * histogram, across reconfiguration.  A new summary must
+		 * be sent the triggers of every policy zone again.
+		 */
+		if (!ISC_LIST_EMPTY(view->rpz_zones)) {
+			isc_histo_t *histo = NULL, *updates = NULL;
+
+			result = dns_viewlist_find(&ns_g_server->viewlist,
+						   view->name, view->rdclass,
+						   &pview);
+			if (result != ISC_R_NOTFOUND &&
+			    result != ISC_R_SUCCESS)
+				goto cleanup;
+			if (pview != NULL) {
+				if (rpz_summary_reusable(pview, view))
+					dns_rpz_summary_attach(
+						pview->rpz_summary,
+						&view->rpz_summary);
+				else if (pview->rpz_summary != NULL)
+					histo = dns_rpz_summary_getupdatehisto(
+							pview->rpz_summary);
+				if (histo != NULL)
+					isc_histo_attach(histo, &updates);
+				dns_view_detach(&pview);
+			}
+			result = ISC_R_SUCCESS;
+			if (view->rpz_summary == NULL)
+				result = dns_rpz_summary_create(mctx,
+							&view->rpz_summary);
+			if (result == ISC_R_SUCCESS && updates == NULL &&
+			    dns_rpz_summary_getupdatehisto(
+					view->rpz_summary) == NULL)
+				result = isc_histo_create(mctx, 1, &updates);
+			if (result == ISC_R_SUCCESS && updates != NULL)
+				dns_rpz_summary_setupdatehisto(
+					view->rpz_summary, updates);
+			if (updates != NULL)
+				isc_histo_detach(&updates);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup;
+		}
 	}
 
 	/*
@@ -2323,6 +2563,11 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		}
 	}
 
+	/*
+	 * Carry over the unchanged zones of the "zone-index" file.
+	 */
+	CHECK(configure_zoneindex(view));
+
 	/*
 	 * Create Dynamically Loadable Zone driver.
 	 */
@@ -2365,6 +2610,10 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 			result = dns_dlzconfigure(view, dlzconfigure_callback);
 			if (result != ISC_R_SUCCESS)
 				goto cleanup;
+
+			result = configure_dlzcache(view, dlz);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup;
 		}
 	}
 
@@ -2713,8 +2962,8 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 				      dispatch4, dispatch6));
 
 	if (resstats == NULL) {
-		CHECK(isc_stats_create(mctx, &resstats,
-				       dns_resstatscounter_max));
+		CHECK(isc_stats_create2(mctx, &resstats,
+					dns_resstatscounter_max, ns_g_cpus));
 	}
 	dns_view_setresstats(view, resstats);
 	if (resquerystats == NULL)
@@ -2888,10 +3137,61 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		if (ring != NULL)
 			dns_view_setdynamickeyring(view, ring);
 		dns_tsigkeyring_detach(&ring);
+		dns_view_getlatencyhisto(pview, &latency);
 		dns_view_detach(&pview);
 	} else
 		dns_view_restorekeyring(view);
 
+	/*
+	 * Response latency histogram; kept across reconfiguration.
+	 */
+	if (latency == NULL)
+		CHECK(isc_histo_create(mctx, ns_g_cpus, &latency));
+	dns_view_setlatencyhisto(view, latency);
+
+	/*
+	 * Message capture.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "capture", &obj);
+	if (result == ISC_R_SUCCESS && ns_g_server->capture == NULL) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "view '%s': 'capture' has no effect without "
+			      "a working 'capture-output'", view->name);
+	} else if (result == ISC_R_SUCCESS) {
+		unsigned int types = 0, bits;
+		const cfg_obj_t *typeobj, *modeobj;
+		const char *str;
+
+		for (element = cfg_list_first(obj);
+		     element != NULL;
+		     element = cfg_list_next(element))
+		{
+			typeobj = cfg_tuple_get(cfg_listelt_value(element),
+						"type");
+			modeobj = cfg_tuple_get(cfg_listelt_value(element),
+						"mode");
+			str = cfg_obj_asstring(typeobj);
+			if (strcasecmp(str, "client") == 0)
+				bits = DNS_CAPTURE_CLIENT;
+			else if (strcasecmp(str, "resolver") == 0)
+				bits = DNS_CAPTURE_RESOLVER;
+			else
+				bits = DNS_CAPTURE_ALL;
+			if (cfg_obj_isstring(modeobj)) {
+				str = cfg_obj_asstring(modeobj);
+				if (strcasecmp(str, "query") == 0)
+					bits &= DNS_CAPTURE_QUERY;
+				else
+					bits &= DNS_CAPTURE_RESPONSE;
+			}
+			types |= bits;
+		}
+		if (types != 0)
+			dns_view_setcapture(view, ns_g_server->capture, types);
+	}
+
 	/*
 	 * Configure the view's peer list.
 	 */
@@ -3424,6 +3724,8 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	}
 #endif /* USE_RRL */
 
+	CHECK(configure_respcache(view, maps));
+
 	result = ISC_R_SUCCESS;
 
  cleanup:
@@ -3445,6 +3747,8 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		isc_stats_detach(&resstats);
 	if (resquerystats != NULL)
 		dns_stats_detach(&resquerystats);
+	if (latency != NULL)
+		isc_histo_detach(&latency);
 	if (order != NULL)
 		dns_order_detach(&order);
 	if (cmctx != NULL)
@@ -4002,7 +4306,8 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	}
 
 	if (is_rpz) {
-		result = dns_zone_rpz_enable(zone);
+		result = dns_zone_rpz_enable(zone, view->rpz_summary,
+					     rpz->num);
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 				      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -4296,7 +4601,7 @@ adjust_interfaces(ns_server_t *server, isc_mem_t *mctx) {
 	ns_listenlist_t *list = NULL;
 	dns_view_t *view;
 	dns_zone_t *zone, *next;
-	isc_sockaddr_t addr, *addrp;
+	isc_sockaddr_t addr;
 
 	result = ns_listenlist_create(mctx, &list);
 	if (result != ISC_R_SUCCESS)
@@ -4351,13 +4656,13 @@ adjust_interfaces(ns_server_t *server, isc_mem_t *mctx) {
 		if (view == NULL)
 			continue;
 
-		addrp = dns_zone_getnotifysrc6(zone);
-		result = add_listenelt(mctx, list, addrp, ISC_FALSE);
+		addr = dns_zone_getnotifysrc6(zone);
+		result = add_listenelt(mctx, list, &addr, ISC_FALSE);
 		if (result != ISC_R_SUCCESS)
 			goto fail;
 
-		addrp = dns_zone_getxfrsource6(zone);
-		result = add_listenelt(mctx, list, addrp, ISC_FALSE);
+		addr = dns_zone_getxfrsource6(zone);
+		result = add_listenelt(mctx, list, &addr, ISC_FALSE);
 		if (result != ISC_R_SUCCESS)
 			goto fail;
 	}
@@ -4886,106 +5191,827 @@ count_zones(const cfg_obj_t *conf) {
 	return (n);
 }
 
+static void
+zoneindex_destroy(ns_zoneindex_t **zip) {
+	ns_zoneindex_t *zi;
+
+	REQUIRE(zip != NULL && ZONEINDEX_VALID(*zip));
+
+	zi = *zip;
+	*zip = NULL;
+
+	if (zi->view != NULL)
+		dns_view_detach(&zi->view);
+	if (zi->actx != NULL)
+		cfg_aclconfctx_detach(&zi->actx);
+	if (zi->parser != NULL) {
+		if (zi->config != NULL)
+			cfg_obj_destroy(zi->parser, &zi->config);
+		cfg_parser_destroy(&zi->parser);
+	}
+	if (zi->zparser != NULL) {
+		if (zi->zconfig != NULL)
+			cfg_obj_destroy(zi->zparser, &zi->zconfig);
+		cfg_parser_destroy(&zi->zparser);
+	}
+	if (zi->entries != NULL)
+		isc_mem_put(zi->mctx, zi->entries,
+			    zi->nentries * sizeof(*zi->entries));
+	if (zi->state != NULL)
+		isc_mem_put(zi->mctx, zi->state, zi->nentries);
+	if (zi->data != NULL)
+		isc_mem_put(zi->mctx, zi->data, zi->datalen);
+	if (zi->path != NULL)
+		isc_mem_free(zi->mctx, zi->path);
+	zi->magic = 0;
+	isc_mem_putanddetach(&zi->mctx, zi, sizeof(*zi));
+}
+
+/*
+ * Stop configuring the zones of 'zi'.  If a batch is queued it frees
+ * 'zi' when it runs.
+ */
+static void
+zoneindex_cancel(ns_server_t *server, ns_zoneindex_t *zi) {
+	ISC_LIST_UNLINK(server->zoneindexes, zi, link);
+	if (zi->posted)
+		zi->canceled = ISC_TRUE;
+	else
+		zoneindex_destroy(&zi);
+}
+
 static isc_result_t
-load_configuration(const char *filename, ns_server_t *server,
-		   isc_boolean_t first_time)
-{
-	cfg_obj_t *config = NULL, *bindkeys = NULL;
-	cfg_parser_t *conf_parser = NULL, *bindkeys_parser = NULL;
-	const cfg_listelt_t *element;
-	const cfg_obj_t *builtin_views;
-	const cfg_obj_t *maps[3];
-	const cfg_obj_t *obj;
-	const cfg_obj_t *options;
-	const cfg_obj_t *usev4ports, *avoidv4ports, *usev6ports, *avoidv6ports;
-	const cfg_obj_t *views;
-	dns_view_t *view = NULL;
-	dns_view_t *view_next;
-	dns_viewlist_t tmpviewlist;
-	dns_viewlist_t viewlist, builtin_viewlist;
-	in_port_t listen_port, udpport_low, udpport_high;
-	int i;
-	int num_zones = 0;
-	isc_boolean_t exclusive = ISC_FALSE;
-	isc_interval_t interval;
-	isc_logconfig_t *logc = NULL;
-	isc_portset_t *v4portset = NULL;
-	isc_portset_t *v6portset = NULL;
-	isc_resourcevalue_t nfiles;
+zoneindex_name(const char *text, dns_fixedname_t *fixed) {
+	isc_buffer_t b;
+
+	isc_buffer_constinit(&b, text, strlen(text));
+	isc_buffer_add(&b, strlen(text));
+	dns_fixedname_init(fixed);
+	return (dns_name_fromtext(dns_fixedname_name(fixed), &b,
+				  dns_rootname, 0, NULL));
+}
+
+/*
+ * Return the next whitespace separated token in '*p' and terminate it.
+ */
+static char *
+zoneindex_token(char **p) {
+	char *s = *p, *token;
+
+	while (*s == ' ' || *s == '\t' || *s == '\r')
+		s++;
+	if (*s == '\0')
+		return (NULL);
+	token = s;
+	while (*s != '\0' && *s != ' ' && *s != '\t' && *s != '\r')
+		s++;
+	if (*s != '\0')
+		*s++ = '\0';
+	*p = s;
+	return (token);
+}
+
+/*
+ * Read the index file.  Each line holds a zone name and the zone's
+ * master file; '#' or ';' starts a comment.
+ */
+static isc_result_t
+zoneindex_read(ns_zoneindex_t *zi) {
 	isc_result_t result;
-	isc_uint32_t heartbeat_interval;
-	isc_uint32_t interface_interval;
-	isc_uint32_t reserved;
-	isc_uint32_t udpsize;
-	ns_cache_t *nsc;
-	ns_cachelist_t cachelist, tmpcachelist;
-	struct cfg_context *nzctx;
-	unsigned int maxsocks;
+	FILE *fp = NULL;
+	off_t size;
+	size_t length;
+	char *p, *end, *eol, *comment, *name, *file;
+	isc_uint32_t lines = 0, n = 0, lineno = 0;
+	dns_fixedname_t fixed;
 
-	ISC_LIST_INIT(viewlist);
-	ISC_LIST_INIT(builtin_viewlist);
-	ISC_LIST_INIT(cachelist);
+	CHECK(isc_stdio_open(zi->path, "r", &fp));
+	CHECK(isc_stdio_seek(fp, 0, SEEK_END));
+	CHECK(isc_stdio_tell(fp, &size));
+	CHECK(isc_stdio_seek(fp, 0, SEEK_SET));
+	if (size < 0 || (isc_uint64_t)size >= 0xffffffffU) {
+		result = ISC_R_RANGE;
+		goto cleanup;
+	}
 
-	/* Create the ACL configuration context */
-	if (ns_g_aclconfctx != NULL)
-		cfg_aclconfctx_detach(&ns_g_aclconfctx);
-	CHECK(cfg_aclconfctx_create(ns_g_mctx, &ns_g_aclconfctx));
+	zi->datalen = (size_t)size + 1;
+	zi->data = isc_mem_get(zi->mctx, zi->datalen);
+	if (zi->data == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	result = isc_stdio_read(zi->data, 1, (size_t)size, fp, &length);
+	if (result != ISC_R_SUCCESS && result != ISC_R_EOF)
+		goto cleanup;
+	zi->data[length] = '\0';
+	end = zi->data + length;
+
+	lines = 1;
+	for (p = zi->data; p < end; p++)
+		if (*p == '\n')
+			lines++;
+	zi->entries = isc_mem_get(zi->mctx, lines * sizeof(*zi->entries));
+	if (zi->entries == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
 
-	/*
-	 * Parse the global default pseudo-config file.
-	 */
-	if (first_time) {
-		CHECK(ns_config_parsedefaults(ns_g_parser, &ns_g_config));
-		RUNTIME_CHECK(cfg_map_get(ns_g_config, "options",
-					  &ns_g_defaults) == ISC_R_SUCCESS);
+	for (p = zi->data; p < end; p = eol) {
+		lineno++;
+		eol = strchr(p, '\n');
+		if (eol != NULL)
+			*eol++ = '\0';
+		else
+			eol = end;
+		comment = strpbrk(p, "#;");
+		if (comment != NULL)
+			*comment = '\0';
+
+		name = zoneindex_token(&p);
+		if (name == NULL)
+			continue;
+		file = zoneindex_token(&p);
+		if (file == NULL || zoneindex_token(&p) != NULL) {
+			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+				      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "%s:%u: expected a zone name and "
+				      "a file name", zi->path, lineno);
+			result = ISC_R_UNEXPECTEDTOKEN;
+			goto cleanup;
+		}
+		result = zoneindex_name(name, &fixed);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+				      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "%s:%u: '%s': %s", zi->path, lineno,
+				      name, isc_result_totext(result));
+			goto cleanup;
+		}
+		zi->entries[n].name = (isc_uint32_t)(name - zi->data);
+		zi->entries[n].file = (isc_uint32_t)(file - zi->data);
+		n++;
 	}
 
-	/*
-	 * Parse the configuration file using the new config code.
-	 */
-	result = ISC_R_FAILURE;
-	config = NULL;
+	/* Give back what the blank lines and comments did not use. */
+	if (n < lines) {
+		zoneindex_entry_t *entries = NULL;
 
-	/*
-	 * Unless this is lwresd with the -C option, parse the config file.
-	 */
-	if (!(ns_g_lwresdonly && lwresd_g_useresolvconf)) {
-		isc_log_write(ns_g_lctx,
-			      NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_SERVER,
-			      ISC_LOG_INFO, "loading configuration from '%s'",
-			      filename);
-		CHECK(cfg_parser_create(ns_g_mctx, ns_g_lctx, &conf_parser));
-		cfg_parser_setcallback(conf_parser, directory_callback, NULL);
-		result = cfg_parse_file(conf_parser, filename,
-					&cfg_type_namedconf, &config);
+		if (n > 0) {
+			entries = isc_mem_get(zi->mctx,
+					      n * sizeof(*entries));
+			if (entries == NULL) {
+				result = ISC_R_NOMEMORY;
+				goto cleanup;
+			}
+			memmove(entries, zi->entries, n * sizeof(*entries));
+		}
+		isc_mem_put(zi->mctx, zi->entries,
+			    lines * sizeof(*zi->entries));
+		zi->entries = entries;
 	}
+	lines = n;
+	zi->nentries = n;
 
-	/*
-	 * If this is lwresd with the -C option, or lwresd with no -C or -c
-	 * option where the above parsing failed, parse resolv.conf.
-	 */
-	if (ns_g_lwresdonly &&
-	    (lwresd_g_useresolvconf ||
-	     (!ns_g_conffileset && result == ISC_R_FILENOTFOUND)))
-	{
-		isc_log_write(ns_g_lctx,
-			      NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_SERVER,
-			      ISC_LOG_INFO, "loading configuration from '%s'",
-			      lwresd_g_resolvconffile);
-		if (conf_parser != NULL)
-			cfg_parser_destroy(&conf_parser);
-		CHECK(cfg_parser_create(ns_g_mctx, ns_g_lctx, &conf_parser));
-		result = ns_lwresd_parseeresolvconf(ns_g_mctx, conf_parser,
-						    &config);
+	if (n > 0) {
+		zi->state = isc_mem_get(zi->mctx, n);
+		if (zi->state == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		memset(zi->state, ZONEINDEX_NEW, n);
 	}
-	CHECK(result);
+	result = ISC_R_SUCCESS;
 
-	/*
-	 * Check the validity of the configuration.
-	 */
-	CHECK(bind9_check_namedconf(config, ns_g_lctx, ns_g_mctx));
+ cleanup:
+	if (result != ISC_R_SUCCESS && zi->entries != NULL) {
+		isc_mem_put(zi->mctx, zi->entries,
+			    lines * sizeof(*zi->entries));
+		zi->entries = NULL;
+		zi->nentries = 0;
+	}
+	if (fp != NULL)
+		(void)isc_stdio_close(fp);
+	return (result);
+}
 
-	/*
+/*
+ * Read the "zone-index" file of 'view', if it has one, and add the
+ * number of zones it lists to '*num_zones'.  The zones themselves are
+ * set up by configure_zoneindex() and zoneindex_commit().
+ */
+static isc_result_t
+setup_zoneindex(ns_server_t *server, dns_view_t *view, cfg_obj_t *config,
+		cfg_obj_t *vconfig, cfg_parser_t *parser,
+		cfg_aclconfctx_t *actx, int *num_zones)
+{
+	static const char zonetext[] =
+		"addzone \".\" { type master; file \"zone-index\"; };";
+	isc_result_t result;
+	ns_zoneindex_t *zi = NULL;
+	const cfg_obj_t *maps[4];
+	const cfg_obj_t *options = NULL, *voptions = NULL;
+	const cfg_obj_t *obj = NULL;
+	isc_buffer_t b;
+	int i = 0;
+
+	if (vconfig != NULL)
+		voptions = cfg_tuple_get(vconfig, "options");
+	if (voptions != NULL)
+		maps[i++] = voptions;
+	if (cfg_map_get(config, "options", &options) == ISC_R_SUCCESS)
+		maps[i++] = options;
+	maps[i++] = ns_g_defaults;
+	maps[i] = NULL;
+
+	if (ns_config_get(maps, "zone-index", &obj) != ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+	zi = isc_mem_get(view->mctx, sizeof(*zi));
+	if (zi == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(zi, 0, sizeof(*zi));
+	isc_mem_attach(view->mctx, &zi->mctx);
+	ISC_LINK_INIT(zi, link);
+	zi->magic = ZONEINDEX_MAGIC;
+
+	zi->path = isc_mem_strdup(zi->mctx, cfg_obj_asstring(obj));
+	if (zi->path == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+
+	zi->format = dns_masterformat_text;
+	obj = NULL;
+	if (ns_config_get(maps, "masterfile-format", &obj) == ISC_R_SUCCESS &&
+	    strcasecmp(cfg_obj_asstring(obj), "raw") == 0)
+		zi->format = dns_masterformat_raw;
+
+	result = zoneindex_read(zi);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "could not read zone index '%s': %s",
+			      zi->path, isc_result_totext(result));
+		goto cleanup;
+	}
+
+	isc_buffer_constinit(&b, zonetext, sizeof(zonetext) - 1);
+	isc_buffer_add(&b, sizeof(zonetext) - 1);
+	CHECK(cfg_parser_create(zi->mctx, ns_g_lctx, &zi->zparser));
+	CHECK(cfg_parse_buffer(zi->zparser, &b, &cfg_type_addzoneconf,
+			       &zi->zconfig));
+	CHECK(cfg_map_get(zi->zconfig, "addzone", &zi->zone));
+
+	dns_view_attach(view, &zi->view);
+	cfg_parser_attach(parser, &zi->parser);
+	cfg_obj_attach(config, &zi->config);
+	zi->vconfig = vconfig;
+	cfg_aclconfctx_attach(actx, &zi->actx);
+
+	ISC_LIST_APPEND(server->zoneindexes, zi, link);
+	*num_zones += zi->nentries;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	zoneindex_destroy(&zi);
+	return (result);
+}
+
+static isc_boolean_t
+zoneindex_reusable(dns_zone_t *zone, const char *file) {
+	dns_zone_t *raw = NULL;
+	const char *zfile;
+
+	dns_zone_getraw(zone, &raw);
+	if (raw != NULL) {
+		dns_zone_detach(&raw);
+		return (ISC_FALSE);
+	}
+	zfile = dns_zone_getfile(zone);
+	return (ISC_TF(dns_zone_gettype(zone) == dns_zone_master &&
+		       !dns_zone_getadded(zone) && !dns_zone_get_rpz(zone) &&
+		       zfile != NULL && strcmp(zfile, file) == 0));
+}
+
+/*
+ * Move the zones of the index that are unchanged from the previous
+ * view into 'view', so that they go on answering while the index is
+ * worked through, and drop the entries that clash with zones that
+ * are already configured.
+ */
+static isc_result_t
+configure_zoneindex(dns_view_t *view) {
+	isc_result_t result;
+	ns_zoneindex_t *zi;
+	dns_view_t *pview = NULL;
+	dns_zone_t *zone = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	const char *name, *file;
+	isc_uint32_t i;
+
+	for (zi = ISC_LIST_HEAD(ns_g_server->zoneindexes);
+	     zi != NULL;
+	     zi = ISC_LIST_NEXT(zi, link))
+		if (zi->view == view && !zi->running)
+			break;
+	if (zi == NULL)
+		return (ISC_R_SUCCESS);
+
+	result = dns_viewlist_find(&ns_g_server->viewlist, view->name,
+				   view->rdclass, &pview);
+	if (result != ISC_R_NOTFOUND && result != ISC_R_SUCCESS)
+		return (result);
+	result = ISC_R_SUCCESS;
+
+	for (i = 0; i < zi->nentries; i++) {
+		name = zi->data + zi->entries[i].name;
+		file = zi->data + zi->entries[i].file;
+		RUNTIME_CHECK(zoneindex_name(name, &fixed) == ISC_R_SUCCESS);
+		origin = dns_fixedname_name(&fixed);
+
+		if (dns_view_findzone(view, origin, &zone) == ISC_R_SUCCESS) {
+			isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+				      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "zone index '%s': zone '%s' already "
+				      "exists", zi->path, name);
+			dns_zone_detach(&zone);
+			zi->state[i] = ZONEINDEX_SKIP;
+			zi->failed++;
+			continue;
+		}
+		if (pview == NULL ||
+		    dns_view_findzone(pview, origin, &zone) != ISC_R_SUCCESS)
+			continue;
+		if (zoneindex_reusable(zone, file)) {
+			dns_zone_setview(zone, view);
+			if (view->acache != NULL)
+				dns_zone_setacache(zone, view->acache);
+			CHECK(dns_view_addzone(view, zone));
+			zi->state[i] = ZONEINDEX_REUSED;
+			zi->reused++;
+		}
+		dns_zone_detach(&zone);
+	}
+
+ cleanup:
+	if (zone != NULL)
+		dns_zone_detach(&zone);
+	if (pview != NULL)
+		dns_view_detach(&pview);
+	return (result);
+}
+
+/*
+ * Configure entry 'i' of the index, creating the zone unless it was
+ * kept from the previous view.  A new zone is returned in '*zonep' to
+ * be loaded.
+ */
+static isc_result_t
+zoneindex_configure(ns_zoneindex_t *zi, isc_uint32_t i, dns_zone_t **zonep) {
+	isc_result_t result;
+	dns_view_t *view = zi->view;
+	dns_zone_t *zone = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	const char *name, *file;
+	isc_boolean_t reused = ISC_TF(zi->state[i] == ZONEINDEX_REUSED);
+
+	name = zi->data + zi->entries[i].name;
+	file = zi->data + zi->entries[i].file;
+	RUNTIME_CHECK(zoneindex_name(name, &fixed) == ISC_R_SUCCESS);
+	origin = dns_fixedname_name(&fixed);
+
+	result = dns_view_findzone(view, origin, &zone);
+	if (reused) {
+		/* Unless "rndc delzone" got there first. */
+		if (result == ISC_R_SUCCESS &&
+		    !zoneindex_reusable(zone, file))
+			result = ISC_R_NOTFOUND;
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	} else {
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_EXISTS;
+			goto cleanup;
+		}
+		CHECK(dns_zonemgr_createzone(ns_g_server->zonemgr, &zone));
+		CHECK(dns_zone_setorigin(zone, origin));
+		dns_zone_setview(zone, view);
+		if (view->acache != NULL)
+			dns_zone_setacache(zone, view->acache);
+		CHECK(dns_zonemgr_managezone(ns_g_server->zonemgr, zone));
+		dns_zone_setstats(zone, ns_g_server->zonestats);
+	}
+
+	CHECK(ns_zone_configure(zi->config, zi->vconfig, zi->zone, zi->actx,
+				zone, NULL));
+	CHECK(dns_zone_setfile2(zone, file, zi->format));
+
+	if (reused) {
+		if ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_MAINTAIN) != 0)
+			dns_zone_rekey(zone, ISC_FALSE);
+	} else {
+		CHECK(dns_view_addzone(view, zone));
+		*zonep = zone;
+		zone = NULL;
+	}
+
+ cleanup:
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "zone index '%s': zone '%s': %s",
+			      zi->path, name, isc_result_totext(result));
+	if (zone != NULL)
+		dns_zone_detach(&zone);
+	return (result);
+}
+
+static void
+zoneindex_batch(isc_task_t *task, isc_event_t *event);
+
+static void
+zoneindex_post(ns_zoneindex_t *zi) {
+	isc_event_t *event;
+
+	event = isc_event_allocate(zi->mctx, zi, NS_EVENT_ZONEINDEX,
+				   zoneindex_batch, zi, sizeof(isc_event_t));
+	if (event == NULL) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "zone index '%s': out of memory; %u zones "
+			      "not configured", zi->path,
+			      zi->nentries - zi->next);
+		zi->failed += zi->nentries - zi->next;
+		zi->next = zi->nentries;
+		TIME_NOW(&zi->finished);
+		zi->done = ISC_TRUE;
+		return;
+	}
+	zi->posted = ISC_TRUE;
+	isc_task_send(ns_g_server->task, &event);
+}
+
+/*
+ * Configure the next ZONEINDEX_BATCH zones in one exclusive section,
+ * then queue the new ones to be loaded by the zone manager.
+ */
+static void
+zoneindex_batch(isc_task_t *task, isc_event_t *event) {
+	ns_zoneindex_t *zi = event->ev_arg;
+	dns_zone_t *zones[ZONEINDEX_BATCH];
+	isc_result_t result;
+	unsigned int i, n = 0;
+	isc_uint64_t usec;
+
+	REQUIRE(ZONEINDEX_VALID(zi));
+
+	isc_event_free(&event);
+	zi->posted = ISC_FALSE;
+	if (zi->canceled) {
+		zoneindex_destroy(&zi);
+		return;
+	}
+
+	result = isc_task_beginexclusive(task);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_view_thaw(zi->view);
+	for (i = 0;
+	     i < ZONEINDEX_BATCH && zi->next < zi->nentries;
+	     i++, zi->next++)
+	{
+		dns_zone_t *zone = NULL;
+
+		if (zi->state[zi->next] == ZONEINDEX_SKIP)
+			continue;
+		result = zoneindex_configure(zi, zi->next, &zone);
+		if (result != ISC_R_SUCCESS) {
+			zi->failed++;
+			continue;
+		}
+		zi->configured++;
+		if (zone != NULL)
+			zones[n++] = zone;
+	}
+	dns_view_freeze(zi->view);
+	isc_task_endexclusive(task);
+
+	for (i = 0; i < n; i++) {
+		result = dns_zone_asyncload(zones[i], NULL, NULL);
+		if (result != ISC_R_SUCCESS)
+			dns_zone_log(zones[i], ISC_LOG_ERROR,
+				     "could not queue zone load: %s",
+				     isc_result_totext(result));
+		dns_zone_detach(&zones[i]);
+	}
+
+	if (zi->next < zi->nentries) {
+		zoneindex_post(zi);
+		return;
+	}
+
+	TIME_NOW(&zi->finished);
+	zi->done = ISC_TRUE;
+	usec = isc_time_microdiff(&zi->finished, &zi->started);
+	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+		      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "zone index '%s': %u zones configured (%u reused, "
+		      "%u failed) in %u.%03us", zi->path, zi->configured,
+		      zi->reused, zi->failed, (unsigned int)(usec / 1000000),
+		      (unsigned int)(usec / 1000 % 1000));
+}
+
+/*
+ * Called once the configuration has been loaded or abandoned: start on
+ * the zone indexes of views that are now in service and cancel all
+ * others, including those of the views that have just been replaced.
+ */
+static void
+zoneindex_commit(ns_server_t *server) {
+	ns_zoneindex_t *zi, *next;
+	dns_view_t *view;
+
+	for (zi = ISC_LIST_HEAD(server->zoneindexes); zi != NULL; zi = next) {
+		next = ISC_LIST_NEXT(zi, link);
+		for (view = ISC_LIST_HEAD(server->viewlist);
+		     view != NULL;
+		     view = ISC_LIST_NEXT(view, link))
+			if (view == zi->view)
+				break;
+		if (view == NULL) {
+			zoneindex_cancel(server, zi);
+			continue;
+		}
+		if (zi->running)
+			continue;
+		zi->running = ISC_TRUE;
+		TIME_NOW(&zi->started);
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "zone index '%s': configuring %u zones for "
+			      "view '%s'", zi->path, zi->nentries,
+			      zi->view->name);
+		zoneindex_post(zi);
+	}
+}
+
+/*
+ * (Re)start the binary query log from "querylog-file".  Failing to
+ * open the file is not fatal; queries are then logged as text.
+ */
+static void
+configure_querylog(ns_server_t *server, const cfg_obj_t **maps) {
+	const cfg_obj_t *obj = NULL;
+	const cfg_obj_t *sizeobj, *versionsobj;
+	isc_int32_t versions = ISC_LOG_ROLLNEVER;
+	isc_offset_t size = 0;
+	const char *path;
+	isc_result_t result;
+
+	if (server->querylog != NULL)
+		ns_querylog_destroy(&server->querylog);
+
+	if (ns_config_get(maps, "querylog-file", &obj) != ISC_R_SUCCESS)
+		return;
+
+	path = cfg_obj_asstring(cfg_tuple_get(obj, "file"));
+	sizeobj = cfg_tuple_get(obj, "size");
+	versionsobj = cfg_tuple_get(obj, "versions");
+	if (sizeobj != NULL && cfg_obj_isuint64(sizeobj))
+		size = (isc_offset_t)cfg_obj_asuint64(sizeobj);
+	if (versionsobj != NULL && cfg_obj_isuint32(versionsobj))
+		versions = cfg_obj_asuint32(versionsobj);
+	if (versionsobj != NULL && cfg_obj_isstring(versionsobj) &&
+	    strcasecmp(cfg_obj_asstring(versionsobj), "unlimited") == 0)
+		versions = ISC_LOG_ROLLINFINITE;
+
+	result = ns_querylog_create(server->mctx, path, versions, size,
+				    ns_g_cpus, &server->querylog);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "could not open query log '%s': %s",
+			      path, isc_result_totext(result));
+}
+
+/*
+ * Open the "capture-output" file or socket, keeping the current one if
+ * it is unchanged so that a reader is not disconnected by a reload.
+ */
+static void
+configure_capture(ns_server_t *server, const cfg_obj_t **maps) {
+	const cfg_obj_t *obj = NULL;
+	dns_captureoutput_t output;
+	const char *path;
+	isc_result_t result;
+
+	if (ns_config_get(maps, "capture-output", &obj) != ISC_R_SUCCESS) {
+		if (server->capture != NULL)
+			dns_capture_detach(&server->capture);
+		return;
+	}
+
+	if (strcasecmp(cfg_obj_asstring(cfg_tuple_get(obj, "type")),
+		       "unix") == 0)
+		output = dns_captureoutput_unix;
+	else
+		output = dns_captureoutput_file;
+	path = cfg_obj_asstring(cfg_tuple_get(obj, "path"));
+
+	if (server->capture != NULL) {
+		if (dns_capture_matches(server->capture, output, path))
+			return;
+		dns_capture_detach(&server->capture);
+	}
+
+	result = dns_capture_create(server->mctx, output, path, ns_g_cpus,
+				    &server->capture);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "could not start capture to '%s': %s",
+			      path, isc_result_totext(result));
+}
+
+/*
+ * With "share-rdata yes", zone databases loaded or transferred from now
+ * on keep identical RRsets once, in a slab store with a memory context
+ * of its own.  Databases that were created with an earlier store keep
+ * it until they are replaced.
+ */
+static void
+configure_slabstore(ns_server_t *server, const cfg_obj_t **maps) {
+	const cfg_obj_t *obj = NULL;
+	isc_mem_t *smctx = NULL;
+	isc_result_t result;
+
+	result = ns_config_get(maps, "share-rdata", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (!cfg_obj_asboolean(obj)) {
+		if (server->slabstore != NULL)
+			dns_slabstore_detach(&server->slabstore);
+		dns_zonemgr_setslabstore(server->zonemgr, NULL);
+		return;
+	}
+	if (server->slabstore != NULL)
+		return;
+
+	result = isc_mem_create(0, 0, &smctx);
+	if (result == ISC_R_SUCCESS) {
+		isc_mem_setname(smctx, "slabstore", NULL);
+		result = dns_slabstore_create(smctx, &server->slabstore);
+		isc_mem_detach(&smctx);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "could not create the shared rdata store: %s",
+			      isc_result_totext(result));
+		return;
+	}
+	dns_zonemgr_setslabstore(server->zonemgr, server->slabstore);
+}
+
+/*
+ * "worker-cpus" pins the task manager's worker threads, in order, to the
+ * listed processors.  Clients are bound to workers, so this also decides
+ * which processor (and NUMA node) each client and its memory live on.
+ * Only applied at startup.
+ */
+static void
+configure_workercpus(const cfg_obj_t **maps) {
+	const cfg_obj_t *obj = NULL;
+	const cfg_listelt_t *element;
+	unsigned int cpus[256];
+	unsigned int ncpus = 0;
+	isc_result_t result;
+
+	result = ns_config_get(maps, "worker-cpus", &obj);
+	if (result != ISC_R_SUCCESS)
+		return;
+
+	for (element = cfg_list_first(obj);
+	     element != NULL && ncpus < sizeof(cpus) / sizeof(cpus[0]);
+	     element = cfg_list_next(element))
+		cpus[ncpus++] = cfg_obj_asuint32(cfg_listelt_value(element));
+	if (ncpus == 0)
+		return;
+
+	result = isc_taskmgr_setaffinity(ns_g_taskmgr, cpus, ncpus);
+	if (result != ISC_R_SUCCESS)
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "could not set 'worker-cpus': %s",
+			      isc_result_totext(result));
+	else
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "%u worker thread%s pinned to %u cpu%s",
+			      ns_g_cpus, ns_g_cpus == 1 ? "" : "s",
+			      ncpus, ncpus == 1 ? "" : "s");
+}
+
+static isc_result_t
+load_configuration(const char *filename, ns_server_t *server,
+		   isc_boolean_t first_time)
+{
+	cfg_obj_t *config = NULL, *bindkeys = NULL;
+	cfg_parser_t *conf_parser = NULL, *bindkeys_parser = NULL;
+	const cfg_listelt_t *element;
+	const cfg_obj_t *builtin_views;
+	const cfg_obj_t *maps[3];
+	const cfg_obj_t *obj;
+	const cfg_obj_t *options;
+	const cfg_obj_t *usev4ports, *avoidv4ports, *usev6ports, *avoidv6ports;
+	const cfg_obj_t *views;
+	dns_view_t *view = NULL;
+	dns_view_t *view_next;
+	dns_viewlist_t tmpviewlist;
+	dns_viewlist_t viewlist, builtin_viewlist;
+	in_port_t listen_port, udpport_low, udpport_high;
+	int i;
+	int num_zones = 0;
+	isc_boolean_t exclusive = ISC_FALSE;
+	isc_interval_t interval;
+	isc_logconfig_t *logc = NULL;
+	isc_portset_t *v4portset = NULL;
+	isc_portset_t *v6portset = NULL;
+	isc_resourcevalue_t nfiles;
+	isc_result_t result;
+	isc_uint32_t heartbeat_interval;
+	isc_uint32_t interface_interval;
+	isc_uint32_t reserved;
+	isc_uint32_t udpsize;
+	ns_cache_t *nsc;
+	ns_cachelist_t cachelist, tmpcachelist;
+	struct cfg_context *nzctx;
+	unsigned int maxsocks;
+
+	ISC_LIST_INIT(viewlist);
+	ISC_LIST_INIT(builtin_viewlist);
+	ISC_LIST_INIT(cachelist);
+
+	/* Create the ACL configuration context */
+	if (ns_g_aclconfctx != NULL)
+		cfg_aclconfctx_detach(&ns_g_aclconfctx);
+	CHECK(cfg_aclconfctx_create(ns_g_mctx, &ns_g_aclconfctx));
+
+	/*
+	 * Parse the global default pseudo-config file.
+	 */
+	if (first_time) {
+		CHECK(ns_config_parsedefaults(ns_g_parser, &ns_g_config));
+		RUNTIME_CHECK(cfg_map_get(ns_g_config, "options",
+					  &ns_g_defaults) == ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Parse the configuration file using the new config code.
+	 */
+	result = ISC_R_FAILURE;
+	config = NULL;
+
+	/*
+	 * Unless this is lwresd with the -C option, parse the config file.
+	 */
+	if (!(ns_g_lwresdonly && lwresd_g_useresolvconf)) {
+		isc_log_write(ns_g_lctx,
+			      NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "loading configuration from '%s'",
+			      filename);
+		CHECK(cfg_parser_create(ns_g_mctx, ns_g_lctx, &conf_parser));
+		cfg_parser_setcallback(conf_parser, directory_callback, NULL);
+		result = cfg_parse_file(conf_parser, filename,
+					&cfg_type_namedconf, &config);
+	}
+
+	/*
+	 * If this is lwresd with the -C option, or lwresd with no -C or -c
+	 * option where the above parsing failed, parse resolv.conf.
+	 */
+	if (ns_g_lwresdonly &&
+	    (lwresd_g_useresolvconf ||
+	     (!ns_g_conffileset && result == ISC_R_FILENOTFOUND)))
+	{
+		isc_log_write(ns_g_lctx,
+			      NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "loading configuration from '%s'",
+			      lwresd_g_resolvconffile);
+		if (conf_parser != NULL)
+			cfg_parser_destroy(&conf_parser);
+		CHECK(cfg_parser_create(ns_g_mctx, ns_g_lctx, &conf_parser));
+		result = ns_lwresd_parseeresolvconf(ns_g_mctx, conf_parser,
+						    &config);
+	}
+	CHECK(result);
+
+	/*
+	 * Check the validity of the configuration.
+	 */
+	CHECK(bind9_check_namedconf(config, ns_g_lctx, ns_g_mctx));
+
+	/*
 	 * Fill in the maps array, used for resolving defaults.
 	 */
 	i = 0;
@@ -5080,6 +6106,12 @@ load_configuration(const char *filename, ns_server_t *server,
 	 */
 	configure_server_quota(maps, "transfers-out", &server->xfroutquota);
 	configure_server_quota(maps, "tcp-clients", &server->tcpquota);
+	/*
+	 * Idle TCP connections are closed to make room for new ones
+	 * once 90% of the quota is in use.
+	 */
+	isc_quota_soft(&server->tcpquota,
+		       server->tcpquota.max - server->tcpquota.max / 10);
 	configure_server_quota(maps, "recursive-clients",
 			       &server->recursionquota);
 	if (server->recursionquota.max > 1000)
@@ -5091,6 +6123,12 @@ load_configuration(const char *filename, ns_server_t *server,
 	CHECK(configure_view_acl(NULL, config, "blackhole", NULL,
 				 ns_g_aclconfctx, ns_g_mctx,
 				 &server->blackholeacl));
+	CHECK(configure_view_acl(NULL, config, "keep-response-order", NULL,
+				 ns_g_aclconfctx, ns_g_mctx,
+				 &server->keepresporder));
+
+	/* Before the views, which attach to it. */
+	configure_capture(server, maps);
 	if (server->blackholeacl != NULL)
 		dns_dispatchmgr_setblackhole(ns_g_dispatchmgr,
 					     server->blackholeacl);
@@ -5195,6 +6233,21 @@ load_configuration(const char *filename, ns_server_t *server,
 	INSIST(result == ISC_R_SUCCESS);
 	dns_zonemgr_setserialqueryrate(server->zonemgr, cfg_obj_asuint32(obj));
 
+	/*
+	 * Master files are loaded one per CPU unless configured otherwise.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "zone-load-concurrency", &obj);
+	if (result == ISC_R_SUCCESS)
+		dns_zonemgr_setiolimit(server->zonemgr,
+				       ISC_MAX(cfg_obj_asuint32(obj), 1));
+	else
+		dns_zonemgr_setiolimit(server->zonemgr, ns_g_cpus);
+
+	configure_slabstore(server, maps);
+	if (first_time)
+		configure_workercpus(maps);
+
 	/*
 	 * Determine which port to use for listening for incoming connections.
 	 */
@@ -5389,6 +6442,10 @@ load_configuration(const char *filename, ns_server_t *server,
 		if (nzctx != NULL && nzctx->nzconfig != NULL)
 			num_zones += count_zones(nzctx->nzconfig);
 
+		CHECK(setup_zoneindex(server, view, config, vconfig,
+				      conf_parser, ns_g_aclconfctx,
+				      &num_zones));
+
 		dns_view_detach(&view);
 	}
 
@@ -5409,6 +6466,10 @@ load_configuration(const char *filename, ns_server_t *server,
 		if (nzctx != NULL && nzctx->nzconfig != NULL)
 			num_zones += count_zones(nzctx->nzconfig);
 
+		CHECK(setup_zoneindex(server, view, config, NULL,
+				      conf_parser, ns_g_aclconfctx,
+				      &num_zones));
+
 		dns_view_detach(&view);
 	}
 
@@ -5674,6 +6735,7 @@ load_configuration(const char *filename, ns_server_t *server,
 		}
 	}
 
+	configure_querylog(server, maps);
 
 	obj = NULL;
 	if (options != NULL &&
@@ -5784,6 +6846,8 @@ load_configuration(const char *filename, ns_server_t *server,
 	if (view != NULL)
 		dns_view_detach(&view);
 
+	zoneindex_commit(server);
+
 	/*
 	 * This cleans up either the old production view list
 	 * or our temporary list depending on whether they
@@ -6030,6 +7094,7 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	ns_server_t *server = (ns_server_t *)event->ev_arg;
 	isc_boolean_t flush = server->flushonshutdown;
 	ns_cache_t *nsc;
+	ns_zoneindex_t *zi;
 
 	UNUSED(task);
 	INSIST(task == server->task);
@@ -6052,6 +7117,9 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	cfg_obj_destroy(ns_g_parser, &ns_g_config);
 	cfg_parser_destroy(&ns_g_parser);
 
+	while ((zi = ISC_LIST_HEAD(server->zoneindexes)) != NULL)
+		zoneindex_cancel(server, zi);
+
 	for (view = ISC_LIST_HEAD(server->viewlist);
 	     view != NULL;
 	     view = view_next) {
@@ -6087,6 +7155,8 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 
 	if (server->blackholeacl != NULL)
 		dns_acl_detach(&server->blackholeacl);
+	if (server->keepresporder != NULL)
+		dns_acl_detach(&server->keepresporder);
 
 	dns_db_detach(&server->in_roothints);
 
@@ -6100,6 +7170,7 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 void
 ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	isc_result_t result;
+	unsigned int i;
 	ns_server_t *server = isc_mem_get(mctx, sizeof(*server));
 
 	if (server == NULL)
@@ -6124,8 +7195,10 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->zonemgr = NULL;
 	server->interfacemgr = NULL;
 	ISC_LIST_INIT(server->viewlist);
+	ISC_LIST_INIT(server->zoneindexes);
 	server->in_roothints = NULL;
 	server->blackholeacl = NULL;
+	server->keepresporder = NULL;
 
 	CHECKFATAL(dns_rootns_create(mctx, dns_rdataclass_in, NULL,
 				     &server->in_roothints),
@@ -6178,6 +7251,9 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 		   "dns_zonemgr_create");
 	CHECKFATAL(dns_zonemgr_setsize(server->zonemgr, 1000),
 		   "dns_zonemgr_setsize");
+	CHECKFATAL(dns_zonemgr_setsigningtasks(server->zonemgr,
+					       ns_g_cpus > 1 ? ns_g_cpus - 1 : 0),
+		   "dns_zonemgr_setsigningtasks");
 
 	server->statsfile = isc_mem_strdup(server->mctx, "named.stats");
 	CHECKFATAL(server->statsfile == NULL ? ISC_R_NOMEMORY : ISC_R_SUCCESS,
@@ -6188,8 +7264,8 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->zonestats = NULL;
 	server->resolverstats = NULL;
 	server->sockstats = NULL;
-	CHECKFATAL(isc_stats_create(server->mctx, &server->sockstats,
-				    isc_sockstatscounter_max),
+	CHECKFATAL(isc_stats_create2(server->mctx, &server->sockstats,
+				     isc_sockstatscounter_max, ns_g_cpus),
 		   "isc_stats_create");
 	isc_socketmgr_setstats(ns_g_socketmgr, server->sockstats);
 
@@ -6218,8 +7294,8 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->server_usehostname = ISC_FALSE;
 	server->server_id = NULL;
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->nsstats,
-				    dns_nsstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->nsstats,
+				     dns_nsstatscounter_max, ns_g_cpus),
 		   "dns_stats_create (server)");
 
 	CHECKFATAL(dns_rdatatypestats_create(ns_g_mctx,
@@ -6233,12 +7309,35 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 				    dns_zonestatscounter_max),
 		   "dns_stats_create (zone)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->resolverstats,
-				    dns_resstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->resolverstats,
+				     dns_resstatscounter_max, ns_g_cpus),
 		   "dns_stats_create (resolver)");
 
+	server->udplatency = NULL;
+	CHECKFATAL(isc_histo_create(ns_g_mctx, ns_g_cpus,
+				    &server->udplatency),
+		   "isc_histo_create (udp)");
+	server->tcplatency = NULL;
+	CHECKFATAL(isc_histo_create(ns_g_mctx, ns_g_cpus,
+				    &server->tcplatency),
+		   "isc_histo_create (tcp)");
+	for (i = 0; i < NS_LATENCY_RCODES; i++) {
+		server->rcodelatency[i] = NULL;
+		CHECKFATAL(isc_histo_create(ns_g_mctx, ns_g_cpus,
+					    &server->rcodelatency[i]),
+			   "isc_histo_create (rcode)");
+	}
+	server->tcprequests = NULL;
+	CHECKFATAL(isc_histo_create(ns_g_mctx, ns_g_cpus,
+				    &server->tcprequests),
+		   "isc_histo_create (tcp requests)");
+	server->tcphighwater = 0;
+
 	server->flushonshutdown = ISC_FALSE;
 	server->log_queries = ISC_FALSE;
+	server->querylog = NULL;
+	server->capture = NULL;
+	server->slabstore = NULL;
 
 	server->controls = NULL;
 	CHECKFATAL(ns_controls_create(server, &server->controls),
@@ -6263,16 +7362,27 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 void
 ns_server_destroy(ns_server_t **serverp) {
 	ns_server_t *server = *serverp;
+	unsigned int i;
 	REQUIRE(NS_SERVER_VALID(server));
 
 	ns_controls_destroy(&server->controls);
 
+	if (server->querylog != NULL)
+		ns_querylog_destroy(&server->querylog);
+	if (server->capture != NULL)
+		dns_capture_detach(&server->capture);
+
 	isc_stats_detach(&server->nsstats);
 	dns_stats_detach(&server->rcvquerystats);
 	dns_stats_detach(&server->opcodestats);
 	isc_stats_detach(&server->zonestats);
 	isc_stats_detach(&server->resolverstats);
 	isc_stats_detach(&server->sockstats);
+	isc_histo_detach(&server->udplatency);
+	isc_histo_detach(&server->tcplatency);
+	for (i = 0; i < NS_LATENCY_RCODES; i++)
+		isc_histo_detach(&server->rcodelatency[i]);
+	isc_histo_detach(&server->tcprequests);
 
 	isc_mem_free(server->mctx, server->statsfile);
 	isc_mem_free(server->mctx, server->bindkeysfile);
@@ -6289,6 +7399,8 @@ ns_server_destroy(ns_server_t **serverp) {
 
 	if (server->zonemgr != NULL)
 		dns_zonemgr_detach(&server->zonemgr);
+	if (server->slabstore != NULL)
+		dns_slabstore_detach(&server->slabstore);
 
 	if (server->tkeyctx != NULL)
 		dns_tkeyctx_destroy(&server->tkeyctx);
@@ -6932,6 +8044,38 @@ ns_server_dumpstats(ns_server_t *server) {
 	return (result);
 }
 
+isc_result_t
+ns_server_zoneindexstatus(ns_server_t *server, dns_view_t *view,
+			  ns_zoneindexstatus_t *status)
+{
+	ns_zoneindex_t *zi;
+	isc_time_t now;
+
+	REQUIRE(NS_SERVER_VALID(server));
+	REQUIRE(status != NULL);
+
+	for (zi = ISC_LIST_HEAD(server->zoneindexes);
+	     zi != NULL;
+	     zi = ISC_LIST_NEXT(zi, link))
+		if (zi->view == view && zi->running)
+			break;
+	if (zi == NULL)
+		return (ISC_R_NOTFOUND);
+
+	status->file = zi->path;
+	status->total = zi->nentries;
+	status->configured = zi->configured;
+	status->reused = zi->reused;
+	status->failed = zi->failed;
+	status->done = zi->done;
+	if (zi->done)
+		now = zi->finished;
+	else
+		TIME_NOW(&now);
+	status->elapsed = isc_time_microdiff(&now, &zi->started);
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 add_zone_tolist(dns_zone_t *zone, void *uap) {
 	struct dumpcontext *dctx = uap;
@@ -7608,6 +8752,78 @@ ns_server_flushnode(ns_server_t *server, char *args, isc_boolean_t tree) {
 	return (result);
 }
 
+isc_result_t
+ns_server_flushdlz(ns_server_t *server, char *args, isc_boolean_t byname) {
+	char *ptr, *target = NULL, *viewname;
+	char what[DNS_NAME_FORMATSIZE + sizeof("name ''")];
+	dns_view_t *view;
+	isc_boolean_t found;
+	isc_result_t result;
+	isc_buffer_t b;
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+
+	/* Skip the command name. */
+	ptr = next_token(&args, " \t");
+	if (ptr == NULL)
+		return (ISC_R_UNEXPECTEDEND);
+
+	if (byname) {
+		/* Find the domain name to flush. */
+		target = next_token(&args, " \t");
+		if (target == NULL)
+			return (ISC_R_UNEXPECTEDEND);
+
+		isc_buffer_constinit(&b, target, strlen(target));
+		isc_buffer_add(&b, strlen(target));
+		dns_fixedname_init(&fixed);
+		name = dns_fixedname_name(&fixed);
+		result = dns_name_fromtext(name, &b, dns_rootname, 0, NULL);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		snprintf(what, sizeof(what), "name '%s'", target);
+	} else
+		snprintf(what, sizeof(what), "all names");
+
+	/* Look for the view name. */
+	viewname = next_token(&args, " \t");
+
+	result = isc_task_beginexclusive(server->task);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	found = ISC_FALSE;
+	for (view = ISC_LIST_HEAD(server->viewlist);
+	     view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (viewname != NULL && strcasecmp(viewname, view->name) != 0)
+			continue;
+		if (view->dlzdatabase == NULL)
+			continue;
+		if (dns_sdlz_flushcache(view->dlzdatabase, name) ==
+		    ISC_R_SUCCESS)
+			found = ISC_TRUE;
+	}
+	isc_task_endexclusive(server->task);
+
+	if (!found) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "flushing %s in DLZ cache%s%s%s failed: "
+			      "no DLZ cache found", what,
+			      viewname != NULL ? " of view '" : "",
+			      viewname != NULL ? viewname : "",
+			      viewname != NULL ? "'" : "");
+		return (ISC_R_NOTFOUND);
+	}
+	isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+		      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "flushing %s in DLZ cache%s%s%s succeeded", what,
+		      viewname != NULL ? " of view '" : "s",
+		      viewname != NULL ? viewname : "",
+		      viewname != NULL ? "'" : "");
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 ns_server_status(ns_server_t *server, isc_buffer_t *text) {
 	int zonecount, xferrunning, xferdeferred, soaqueries;
@@ -7646,6 +8862,7 @@ ns_server_status(ns_server_t *server, isc_buffer_t *text) {
 		     "query logging is %s\n"
 		     "recursive clients: %d/%d/%d\n"
 		     "tcp clients: %d/%d\n"
+		     "tcp clients high-water: %u\n"
 		     "server is up and running",
 		     ns_g_version, ob, alt, cb, ns_g_srcid,
 #ifdef ISC_PLATFORM_USETHREADS
@@ -7655,7 +8872,8 @@ ns_server_status(ns_server_t *server, isc_buffer_t *text) {
 		     soaqueries, server->log_queries ? "ON" : "OFF",
 		     server->recursionquota.used, server->recursionquota.soft,
 		     server->recursionquota.max,
-		     server->tcpquota.used, server->tcpquota.max);
+		     server->tcpquota.used, server->tcpquota.max,
+		     server->tcphighwater);
 	if (n >= isc_buffer_availablelength(text))
 		return (ISC_R_NOSPACE);
 	isc_buffer_add(text, n);
@@ -8647,6 +9865,7 @@ ns_server_signing(ns_server_t *server, char *args, isc_buffer_t *text) {
 	char keystr[DNS_SECALG_FORMATSIZE + 7]; /* <5-digit keyid>/<alg> */
 	unsigned short hash = 0, flags = 0, iter = 0, saltlen = 0;
 	unsigned char salt[255];
+	isc_uint32_t nodes, signatures, seconds;
 	const char *ptr;
 	size_t n;
 
@@ -8770,6 +9989,28 @@ ns_server_signing(ns_server_t *server, char *args, isc_buffer_t *text) {
 				CHECK(ISC_R_NOSPACE);
 
 			isc_buffer_add(text, (unsigned int)n);
+
+			/*
+			 * Show how far signing with an active key has got.
+			 */
+			if (priv.length == 5 && priv.data[0] != 0 &&
+			    priv.data[3] == 0 && priv.data[4] == 0 &&
+			    dns_zone_getsigningprogress(zone, priv.data[0],
+					(priv.data[1] << 8) | priv.data[2],
+					&nodes, &signatures,
+					&seconds) == ISC_R_SUCCESS)
+			{
+				n = snprintf((char *)isc_buffer_used(text),
+					     isc_buffer_availablelength(text),
+					     " (%u nodes, %u signatures, "
+					     "%u signatures/sec)",
+					     nodes, signatures,
+					     signatures / (seconds > 0 ?
+							   seconds : 1));
+				if (n >= isc_buffer_availablelength(text))
+					CHECK(ISC_R_NOSPACE);
+				isc_buffer_add(text, (unsigned int)n);
+			}
 		}
 		if (!first)
 			putnull(text);
@@ -20,7 +20,11 @@
 
 #include <config.h>
 
+#include <stdarg.h>
+
 #include <isc/buffer.h>
+#include <isc/formatcheck.h>
+#include <isc/histo.h>
 #include <isc/httpd.h>
 #include <isc/mem.h>
 #include <isc/once.h>
@@ -34,10 +38,12 @@
 #include <dns/db.h>
 #include <dns/opcode.h>
 #include <dns/resolver.h>
+#include <dns/slabstore.h>
 #include <dns/rdataclass.h>
 #include <dns/rdatatype.h>
 #include <dns/stats.h>
 #include <dns/view.h>
+#include <dns/zone.h>
 #include <dns/zt.h>
 
 #include <named/log.h>
@@ -118,6 +124,29 @@ static int zonestats_index[dns_zonestatscounter_max];
 static int sockstats_index[isc_sockstatscounter_max];
 static int dnssecstats_index[dns_dnssecstats_max];
 
+/*%
+ * Response latency histograms are reported in microseconds, with the
+ * quantiles below and every non-empty bucket.
+ */
+static const char *latency_rcodes[NS_LATENCY_RCODES] = {
+	"NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED",
+	"other"
+};
+
+static const struct {
+	const char	*name;
+	const char	*desc;
+	unsigned int	permille;
+} latency_quantiles[] = {
+	{ "p50", "50%", 500 },
+	{ "p90", "90%", 900 },
+	{ "p99", "99%", 990 },
+	{ "p999", "99.9%", 999 }
+};
+
+#define LATENCY_QUANTILES \
+	(sizeof(latency_quantiles) / sizeof(latency_quantiles[0]))
+
 static inline void
 set_desc(int counter, int maxcounter, const char *fdesc, const char **fdescs,
 	 const char *xdesc, const char **xdescs)
@@ -209,6 +238,16 @@ init_desc(void) {
 		       "UpdateBadPrereq");
 	SET_NSSTATDESC(rpz_rewrites, "response policy zone rewrites",
 		       "RPZRewrites");
+	SET_NSSTATDESC(querylogdropped, "query log records dropped",
+		       "QryLogDropped");
+	SET_NSSTATDESC(respcachehit, "queries answered from the response cache",
+		       "QryRespCache");
+	SET_NSSTATDESC(tcpconnections, "TCP connections accepted",
+		       "TCPConnections");
+	SET_NSSTATDESC(tcppipelined, "pipelined TCP requests",
+		       "TCPPipelined");
+	SET_NSSTATDESC(tcpreclaimed, "idle TCP connections closed",
+		       "TCPReclaimed");
 #ifdef USE_RRL
 	SET_NSSTATDESC(ratedropped, "responses dropped for rate limits",
 		       "RateDropped");
@@ -479,6 +518,48 @@ init_desc(void) {
 #endif
 }
 
+/*%
+ * Zones configured per second from a view's zone index.
+ */
+static isc_uint64_t
+zoneindex_rate(const ns_zoneindexstatus_t *status) {
+	if (status->elapsed == 0)
+		return (0);
+	return ((isc_uint64_t)status->configured * 1000000 / status->elapsed);
+}
+
+/*%
+ * Print a one line summary of a latency histogram: the number of
+ * responses and the upper bounds of the quantiles.  This serves for
+ * the other histograms too.
+ */
+static void
+latency_dump(FILE *fp, const char *desc, isc_histo_t *histo) {
+	isc_uint64_t buckets[ISC_HISTO_BUCKETS];
+	isc_uint64_t count;
+	unsigned int i;
+
+	isc_histo_merge(histo, buckets, &count);
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s", count, desc);
+	for (i = 0; i < LATENCY_QUANTILES; i++)
+		fprintf(fp, " %s<=%" ISC_PRINT_QUADFORMAT "u",
+			latency_quantiles[i].desc,
+			isc_histo_quantile(buckets, count,
+					   latency_quantiles[i].permille));
+	fprintf(fp, "\n");
+}
+
+/*%
+ * The histogram of the time taken to apply updates to the response
+ * policy zones of a view, if it has any.
+ */
+static isc_histo_t *
+rpzupdate_histo(dns_view_t *view) {
+	if (view->rpz_summary == NULL)
+		return (NULL);
+	return (dns_rpz_summary_getupdatehisto(view->rpz_summary));
+}
+
 /*%
  * Dump callback functions.
  */
@@ -888,6 +969,150 @@ opcodestat_dump(dns_opcode_t code, isc_uint64_t val, void *arg) {
 
 /* XXXMLG below here sucks. (not so much) */
 
+static isc_result_t
+latency_xmlrender(xmlTextWriterPtr writer, const char *name,
+		  isc_histo_t *histo)
+{
+	isc_uint64_t buckets[ISC_HISTO_BUCKETS];
+	isc_uint64_t count, min, max;
+	unsigned int i;
+	int xmlrc;
+
+	isc_histo_merge(histo, buckets, &count);
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "latency"));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "name",
+					 ISC_XMLCHAR name));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "count",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       count));
+	for (i = 0; i < LATENCY_QUANTILES; i++) {
+		TRY0(xmlTextWriterWriteFormatAttribute(writer,
+				ISC_XMLCHAR latency_quantiles[i].name,
+				"%" ISC_PRINT_QUADFORMAT "u",
+				isc_histo_quantile(buckets, count,
+					latency_quantiles[i].permille)));
+	}
+	for (i = 0; i < ISC_HISTO_BUCKETS; i++) {
+		if (buckets[i] == 0)
+			continue;
+		isc_histo_bucketrange(i, &min, &max);
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "bucket"));
+		TRY0(xmlTextWriterWriteFormatAttribute(writer,
+						       ISC_XMLCHAR "min",
+						       "%" ISC_PRINT_QUADFORMAT
+						       "u", min));
+		TRY0(xmlTextWriterWriteFormatAttribute(writer,
+						       ISC_XMLCHAR "max",
+						       "%" ISC_PRINT_QUADFORMAT
+						       "u", max));
+		TRY0(xmlTextWriterWriteFormatString(writer,
+						    "%" ISC_PRINT_QUADFORMAT
+						    "u", buckets[i]));
+		TRY0(xmlTextWriterEndElement(writer)); /* bucket */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* latency */
+
+	return (ISC_R_SUCCESS);
+ error:
+	return (ISC_R_FAILURE);
+}
+
+static isc_result_t
+server_latency_xmlrender(ns_server_t *server, xmlTextWriterPtr writer) {
+	isc_result_t result;
+	unsigned int i;
+
+	result = latency_xmlrender(writer, "udp", server->udplatency);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = latency_xmlrender(writer, "tcp", server->tcplatency);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	for (i = 0; i < NS_LATENCY_RCODES; i++) {
+		result = latency_xmlrender(writer, latency_rcodes[i],
+					   server->rcodelatency[i]);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Counters of the "share-rdata" store, if there is one.  The memory it
+ * uses is in the "slabstore" memory context.
+ */
+static isc_result_t
+slabstore_xmlrender(ns_server_t *server, xmlTextWriterPtr writer) {
+	dns_slabstorestats_t stats;
+	int xmlrc;
+
+	if (server->slabstore == NULL)
+		return (ISC_R_SUCCESS);
+	dns_slabstore_getstats(server->slabstore, &stats);
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "shared-rdata"));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "lookups",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       stats.lookups));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "hits",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       stats.hits));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "entries",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       stats.entries));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer,
+					       ISC_XMLCHAR "references",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       stats.references));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "bytes",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       stats.bytes));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "saved",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       stats.saved));
+	TRY0(xmlTextWriterEndElement(writer)); /* shared-rdata */
+
+	return (ISC_R_SUCCESS);
+ error:
+	return (ISC_R_FAILURE);
+}
+
+/*%
+ * Progress of the view's zone index, with the rate in zones per second.
+ */
+static isc_result_t
+zoneindex_xmlrender(xmlTextWriterPtr writer, ns_zoneindexstatus_t *status) {
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "zone-index"));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "file",
+					 ISC_XMLCHAR status->file));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "state",
+					 ISC_XMLCHAR (status->done ?
+						      "done" : "running")));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "zones",
+					       "%u", status->total));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer,
+					       ISC_XMLCHAR "configured",
+					       "%u", status->configured));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "reused",
+					       "%u", status->reused));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "failed",
+					       "%u", status->failed));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "elapsed",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       status->elapsed));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "rate",
+					       "%" ISC_PRINT_QUADFORMAT "u",
+					       zoneindex_rate(status)));
+	TRY0(xmlTextWriterEndElement(writer)); /* zone-index */
+
+	return (ISC_R_SUCCESS);
+ error:
+	return (ISC_R_FAILURE);
+}
+
 #ifdef NEWSTATS
 static isc_result_t
 zone_xmlrender(dns_zone_t *zone, void *arg) {
@@ -899,6 +1124,7 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 	xmlTextWriterPtr writer = arg;
 	isc_stats_t *zonestats;
 	dns_stats_t *rcvquerystats;
+	isc_histo_t *latency;
 	dns_zonestat_level_t statlevel;
 	isc_uint64_t nsstat_values[dns_nsstatscounter_max];
 	int xmlrc;
@@ -963,6 +1189,13 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 		TRY0(xmlTextWriterEndElement(writer));
 	}
 
+	latency = dns_zone_getlatencyhisto(zone);
+	if (statlevel == dns_zonestat_full && latency != NULL) {
+		result = latency_xmlrender(writer, "response", latency);
+		if (result != ISC_R_SUCCESS)
+			goto error;
+	}
+
 	TRY0(xmlTextWriterEndElement(writer)); /* zone */
 
 	return (ISC_R_SUCCESS);
@@ -979,6 +1212,7 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 	isc_uint32_t serial;
 	xmlTextWriterPtr writer = arg;
 	isc_stats_t *zonestats;
+	isc_histo_t *latency;
 	dns_zonestat_level_t statlevel;
 	isc_uint64_t nsstat_values[dns_nsstatscounter_max];
 	int xmlrc;
@@ -1020,6 +1254,13 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 		TRY0(xmlTextWriterEndElement(writer)); /* counters */
 	}
 
+	latency = dns_zone_getlatencyhisto(zone);
+	if (latency != NULL) {
+		result = latency_xmlrender(writer, "response", latency);
+		if (result != ISC_R_SUCCESS)
+			goto error;
+	}
+
 	TRY0(xmlTextWriterEndElement(writer)); /* zone */
 
 	return (ISC_R_SUCCESS);
@@ -1038,6 +1279,7 @@ generatexml(ns_server_t *server, int *buflen, xmlChar **buf) {
 	xmlDocPtr doc = NULL;
 	int xmlrc;
 	dns_view_t *view;
+	ns_zoneindexstatus_t zistatus;
 	stats_dumparg_t dumparg;
 	dns_stats_t *cacherrstats;
 	isc_uint64_t nsstat_values[dns_nsstatscounter_max];
@@ -1128,6 +1370,25 @@ else fprintf(stderr, "WTF WHERE'S RESQUERYRSTATS\n");
 			TRY0(xmlTextWriterEndElement(writer)); /* cache */
 		}
 
+		if (view->latencyhisto != NULL) {
+			result = latency_xmlrender(writer, "response",
+						   view->latencyhisto);
+			if (result != ISC_R_SUCCESS)
+				goto error;
+		}
+		if (rpzupdate_histo(view) != NULL) {
+			result = latency_xmlrender(writer, "rpz-update",
+						   rpzupdate_histo(view));
+			if (result != ISC_R_SUCCESS)
+				goto error;
+		}
+		if (ns_server_zoneindexstatus(server, view,
+					      &zistatus) == ISC_R_SUCCESS) {
+			result = zoneindex_xmlrender(writer, &zistatus);
+			if (result != ISC_R_SUCCESS)
+				goto error;
+		}
+
 		TRY0(xmlTextWriterEndElement(writer)); /* view */
 
 		view = ISC_LIST_NEXT(view, link);
@@ -1231,6 +1492,13 @@ else fprintf(stderr, "WTF WHERE'S RESQUERYRSTATS\n");
 
 	TRY0(xmlTextWriterEndElement(writer)); /* counters type=sockstat */
 
+	result = server_latency_xmlrender(server, writer);
+	if (result != ISC_R_SUCCESS)
+		goto error;
+	result = slabstore_xmlrender(server, writer);
+	if (result != ISC_R_SUCCESS)
+		goto error;
+
 	TRY0(xmlTextWriterEndElement(writer)); /* server */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
@@ -1268,6 +1536,7 @@ generatexml(ns_server_t *server, int *buflen, xmlChar **buf) {
 	xmlDocPtr doc = NULL;
 	int xmlrc;
 	dns_view_t *view;
+	ns_zoneindexstatus_t zistatus;
 	stats_dumparg_t dumparg;
 	dns_stats_t *cachestats;
 	isc_uint64_t nsstat_values[dns_nsstatscounter_max];
@@ -1354,6 +1623,25 @@ generatexml(ns_server_t *server, int *buflen, xmlChar **buf) {
 			TRY0(xmlTextWriterEndElement(writer)); /* cache */
 		}
 
+		if (view->latencyhisto != NULL) {
+			result = latency_xmlrender(writer, "response",
+						   view->latencyhisto);
+			if (result != ISC_R_SUCCESS)
+				goto error;
+		}
+		if (rpzupdate_histo(view) != NULL) {
+			result = latency_xmlrender(writer, "rpz-update",
+						   rpzupdate_histo(view));
+			if (result != ISC_R_SUCCESS)
+				goto error;
+		}
+		if (ns_server_zoneindexstatus(server, view,
+					      &zistatus) == ISC_R_SUCCESS) {
+			result = zoneindex_xmlrender(writer, &zistatus);
+			if (result != ISC_R_SUCCESS)
+				goto error;
+		}
+
 		TRY0(xmlTextWriterEndElement(writer)); /* view */
 
 		view = ISC_LIST_NEXT(view, link);
@@ -1425,6 +1713,13 @@ generatexml(ns_server_t *server, int *buflen, xmlChar **buf) {
 	if (result != ISC_R_SUCCESS)
 		goto error;
 
+	result = server_latency_xmlrender(server, writer);
+	if (result != ISC_R_SUCCESS)
+		goto error;
+	result = slabstore_xmlrender(server, writer);
+	if (result != ISC_R_SUCCESS)
+		goto error;
+
 	TRY0(xmlTextWriterEndElement(writer)); /* server */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
@@ -1498,6 +1793,239 @@ render_index(const char *url, isc_httpdurl_t *urlinfo,
 
 #endif	/* HAVE_LIBXML2 */
 
+/*%
+ * The latency histograms are also available as JSON, which is built by
+ * hand into a growing buffer as there is no JSON library to rely on.
+ */
+typedef struct {
+	isc_mem_t	*mctx;
+	char		*base;
+	size_t		size;
+	size_t		used;
+	isc_result_t	result;
+} jsonbuf_t;
+
+static void
+json_printf(jsonbuf_t *jb, const char *fmt, ...) ISC_FORMAT_PRINTF(2, 3);
+
+static void
+json_printf(jsonbuf_t *jb, const char *fmt, ...) {
+	va_list ap;
+	size_t size;
+	char *base;
+	int n;
+
+	if (jb->result != ISC_R_SUCCESS)
+		return;
+
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(jb->base + jb->used, jb->size - jb->used,
+			      fmt, ap);
+		va_end(ap);
+		if (n < 0) {
+			jb->result = ISC_R_FAILURE;
+			return;
+		}
+		if ((size_t)n < jb->size - jb->used) {
+			jb->used += n;
+			return;
+		}
+
+		size = jb->size * 2;
+		while (size - jb->used <= (size_t)n)
+			size *= 2;
+		base = isc_mem_allocate(jb->mctx, size);
+		if (base == NULL) {
+			jb->result = ISC_R_NOMEMORY;
+			return;
+		}
+		memmove(base, jb->base, jb->used);
+		isc_mem_free(jb->mctx, jb->base);
+		jb->base = base;
+		jb->size = size;
+	}
+}
+
+static void
+json_string(jsonbuf_t *jb, const char *str) {
+	const unsigned char *p;
+
+	json_printf(jb, "\"");
+	for (p = (const unsigned char *)str; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			json_printf(jb, "\\%c", *p);
+		else if (*p < 0x20)
+			json_printf(jb, "\\u%04x", *p);
+		else
+			json_printf(jb, "%c", *p);
+	}
+	json_printf(jb, "\"");
+}
+
+static void
+latency_jsonrender(jsonbuf_t *jb, const char *name, isc_histo_t *histo) {
+	isc_uint64_t buckets[ISC_HISTO_BUCKETS];
+	isc_uint64_t count, min, max;
+	const char *sep = "";
+	unsigned int i;
+
+	isc_histo_merge(histo, buckets, &count);
+
+	json_string(jb, name);
+	json_printf(jb, ":{\"count\":%" ISC_PRINT_QUADFORMAT "u", count);
+	for (i = 0; i < LATENCY_QUANTILES; i++)
+		json_printf(jb, ",\"%s\":%" ISC_PRINT_QUADFORMAT "u",
+			    latency_quantiles[i].name,
+			    isc_histo_quantile(buckets, count,
+					       latency_quantiles[i].permille));
+	json_printf(jb, ",\"buckets\":[");
+	for (i = 0; i < ISC_HISTO_BUCKETS; i++) {
+		if (buckets[i] == 0)
+			continue;
+		isc_histo_bucketrange(i, &min, &max);
+		json_printf(jb, "%s[%" ISC_PRINT_QUADFORMAT "u,%"
+			    ISC_PRINT_QUADFORMAT "u,%" ISC_PRINT_QUADFORMAT
+			    "u]", sep, min, max, buckets[i]);
+		sep = ",";
+	}
+	json_printf(jb, "]}");
+}
+
+typedef struct {
+	jsonbuf_t	*jb;
+	const char	*sep;
+} zone_jsonarg_t;
+
+static isc_result_t
+zone_jsonrender(dns_zone_t *zone, void *arg) {
+	zone_jsonarg_t *zarg = arg;
+	char buf[1024 + 32];	/* sufficiently large for zone name and class */
+	isc_histo_t *latency;
+
+	latency = dns_zone_getlatencyhisto(zone);
+	if (dns_zone_getstatlevel(zone) != dns_zonestat_full ||
+	    latency == NULL)
+		return (ISC_R_SUCCESS);
+
+	dns_zone_name(zone, buf, sizeof(buf));
+	json_printf(zarg->jb, "%s", zarg->sep);
+	latency_jsonrender(zarg->jb, buf, latency);
+	zarg->sep = ",";
+
+	return (zarg->jb->result);
+}
+
+static isc_result_t
+generatejson(ns_server_t *server, jsonbuf_t *jb) {
+	char boottime[sizeof "yyyy-mm-ddThh:mm:ssZ"];
+	char nowstr[sizeof "yyyy-mm-ddThh:mm:ssZ"];
+	isc_time_t now;
+	dns_view_t *view;
+	zone_jsonarg_t zarg;
+	const char *sep = "";
+	isc_result_t result;
+	unsigned int i;
+
+	isc_time_now(&now);
+	isc_time_formatISO8601(&ns_g_boottime, boottime, sizeof boottime);
+	isc_time_formatISO8601(&now, nowstr, sizeof nowstr);
+
+	json_printf(jb, "{\"boot-time\":\"%s\",\"current-time\":\"%s\","
+		    "\"unit\":\"microseconds\",\"server\":{",
+		    boottime, nowstr);
+	latency_jsonrender(jb, "udp", server->udplatency);
+	json_printf(jb, ",");
+	latency_jsonrender(jb, "tcp", server->tcplatency);
+	json_printf(jb, ",\"rcodes\":{");
+	for (i = 0; i < NS_LATENCY_RCODES; i++) {
+		json_printf(jb, "%s", i == 0 ? "" : ",");
+		latency_jsonrender(jb, latency_rcodes[i],
+				   server->rcodelatency[i]);
+	}
+	json_printf(jb, "}},\"views\":{");
+
+	for (view = ISC_LIST_HEAD(server->viewlist);
+	     view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		json_printf(jb, "%s", sep);
+		json_string(jb, view->name);
+		json_printf(jb, ":{");
+		if (view->latencyhisto != NULL) {
+			latency_jsonrender(jb, "response", view->latencyhisto);
+			json_printf(jb, ",");
+		}
+		if (rpzupdate_histo(view) != NULL) {
+			latency_jsonrender(jb, "rpz-update",
+					   rpzupdate_histo(view));
+			json_printf(jb, ",");
+		}
+		json_printf(jb, "\"zones\":{");
+		zarg.jb = jb;
+		zarg.sep = "";
+		result = dns_zt_apply(view->zonetable, ISC_TRUE,
+				      zone_jsonrender, &zarg);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		json_printf(jb, "}}");
+		sep = ",";
+	}
+	json_printf(jb, "}}\n");
+
+	return (jb->result);
+}
+
+static void
+wrap_jsonfree(isc_buffer_t *buffer, void *arg) {
+	void *base = isc_buffer_base(buffer);
+
+	isc_mem_free(arg, base);
+}
+
+static isc_result_t
+render_json_latency(const char *url, isc_httpdurl_t *urlinfo,
+		    const char *querystring, const char *headers, void *arg,
+		    unsigned int *retcode, const char **retmsg,
+		    const char **mimetype, isc_buffer_t *b,
+		    isc_httpdfree_t **freecb, void **freecb_args)
+{
+	ns_server_t *server = arg;
+	jsonbuf_t jb;
+	isc_result_t result;
+
+	UNUSED(url);
+	UNUSED(urlinfo);
+	UNUSED(querystring);
+	UNUSED(headers);
+
+	jb.mctx = server->mctx;
+	jb.size = 4096;
+	jb.used = 0;
+	jb.result = ISC_R_SUCCESS;
+	jb.base = isc_mem_allocate(jb.mctx, jb.size);
+	if (jb.base == NULL)
+		return (ISC_R_NOMEMORY);
+
+	result = generatejson(server, &jb);
+	if (result == ISC_R_SUCCESS) {
+		*retcode = 200;
+		*retmsg = "OK";
+		*mimetype = "application/json";
+		isc_buffer_reinit(b, jb.base, jb.used);
+		isc_buffer_add(b, jb.used);
+		*freecb = wrap_jsonfree;
+		*freecb_args = server->mctx;
+	} else {
+		isc_mem_free(jb.mctx, jb.base);
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "failed at rendering JSON()");
+	}
+
+	return (result);
+}
+
 static isc_result_t
 render_xsl(const char *url, isc_httpdurl_t *urlinfo,
 	   const char *querystring, const char *headers,
@@ -1684,6 +2212,8 @@ add_listener(ns_server_t *server, ns_statschannel_t **listenerp,
 			    server);
 #endif /* NEWSTATS */
 #endif
+	isc_httpdmgr_addurl(listener->httpdmgr, "/json/v1/latency",
+			    render_json_latency, server);
 #ifdef NEWSTATS
 	isc_httpdmgr_addurl2(listener->httpdmgr, "/bind9.ver3.xsl", ISC_TRUE,
 			     render_xsl, server);
@@ -1794,8 +2324,9 @@ ns_statschannels_configure(ns_server_t *server, const cfg_obj_t *config,
 #ifndef HAVE_LIBXML2
 		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
-			      "statistics-channels specified but not effective "
-			      "due to missing XML library");
+			      "statistics-channels specified but only "
+			      "/json/v1/latency is effective due to missing "
+			      "XML library");
 #endif
 
 		for (element = cfg_list_first(statschannellist);
@@ -1909,6 +2440,8 @@ ns_stats_dump(ns_server_t *server, FILE *fp) {
 	isc_uint64_t resstat_values[dns_resstatscounter_max];
 	isc_uint64_t zonestat_values[dns_zonestatscounter_max];
 	isc_uint64_t sockstat_values[isc_sockstatscounter_max];
+	isc_histo_t *latency;
+	unsigned int i;
 
 	RUNTIME_CHECK(isc_once_do(&once, init_desc) == ISC_R_SUCCESS);
 
@@ -1999,6 +2532,78 @@ ns_stats_dump(ns_server_t *server, FILE *fp) {
 			     sockstats_desc, isc_sockstatscounter_max,
 			     sockstats_index, sockstat_values, 0);
 
+	fprintf(fp, "++ Response Latency (usec) ++\n");
+	fprintf(fp, "[Common]\n");
+	latency_dump(fp, "UDP", server->udplatency);
+	latency_dump(fp, "TCP", server->tcplatency);
+	for (i = 0; i < NS_LATENCY_RCODES; i++)
+		latency_dump(fp, latency_rcodes[i], server->rcodelatency[i]);
+	for (view = ISC_LIST_HEAD(server->viewlist);
+	     view != NULL;
+	     view = ISC_LIST_NEXT(view, link)) {
+		if (view->latencyhisto == NULL &&
+		    rpzupdate_histo(view) == NULL)
+			continue;
+		if (strcmp(view->name, "_default") == 0)
+			fprintf(fp, "[View: default]\n");
+		else
+			fprintf(fp, "[View: %s]\n", view->name);
+		if (view->latencyhisto != NULL)
+			latency_dump(fp, "responses", view->latencyhisto);
+		if (rpzupdate_histo(view) != NULL)
+			latency_dump(fp, "policy zone updates",
+				     rpzupdate_histo(view));
+	}
+
+	fprintf(fp, "++ TCP Connections ++\n");
+	fprintf(fp, "%20d connections open\n", server->tcpquota.used);
+	fprintf(fp, "%20u most connections open at once\n",
+		server->tcphighwater);
+	latency_dump(fp, "connections closed, requests per connection",
+		     server->tcprequests);
+
+	fprintf(fp, "++ Zone Index ++\n");
+	for (view = ISC_LIST_HEAD(server->viewlist);
+	     view != NULL;
+	     view = ISC_LIST_NEXT(view, link)) {
+		ns_zoneindexstatus_t zistatus;
+
+		if (ns_server_zoneindexstatus(server, view,
+					      &zistatus) != ISC_R_SUCCESS)
+			continue;
+		if (strcmp(view->name, "_default") == 0)
+			fprintf(fp, "[View: default (%s)]\n", zistatus.file);
+		else
+			fprintf(fp, "[View: %s (%s)]\n", view->name,
+				zistatus.file);
+		fprintf(fp, "%20u zones listed\n", zistatus.total);
+		fprintf(fp, "%20u zones configured\n", zistatus.configured);
+		fprintf(fp, "%20u zones reused\n", zistatus.reused);
+		fprintf(fp, "%20u zones failed\n", zistatus.failed);
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u zones per second%s\n",
+			zoneindex_rate(&zistatus),
+			zistatus.done ? "" : " (running)");
+	}
+
+	if (server->slabstore != NULL) {
+		dns_slabstorestats_t ssstats;
+
+		dns_slabstore_getstats(server->slabstore, &ssstats);
+		fprintf(fp, "++ Shared Rdata ++\n");
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u lookups\n",
+			ssstats.lookups);
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u hits\n",
+			ssstats.hits);
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u distinct RRsets\n",
+			ssstats.entries);
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u references\n",
+			ssstats.references);
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u bytes stored\n",
+			ssstats.bytes);
+		fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u bytes saved\n",
+			ssstats.saved);
+	}
+
 	fprintf(fp, "++ Per Zone Query Statistics ++\n");
 	zone = NULL;
 	for (result = dns_zone_first(server->zonemgr, &zone);
@@ -2022,6 +2627,10 @@ ns_stats_dump(ns_server_t *server, FILE *fp) {
 					     NULL, nsstats_desc,
 					     dns_nsstatscounter_max,
 					     nsstats_index, nsstat_values, 0);
+
+			latency = dns_zone_getlatencyhisto(zone);
+			if (latency != NULL)
+				latency_dump(fp, "responses (usec)", latency);
 		}
 	}
 
@@ -21,6 +21,7 @@
 
 #include <isc/buffer.h>
 #include <isc/file.h>
+#include <isc/histo.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/stats.h>
@@ -1052,6 +1053,16 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		dns_stats_detach(&rcvquerystats);
 #endif
 
+	if (statlevel == dns_zonestat_full &&
+	    dns_zone_getlatencyhisto(zone) == NULL)
+	{
+		isc_histo_t *latency = NULL;
+
+		RETERR(isc_histo_create(mctx, ns_g_cpus, &latency));
+		dns_zone_setlatencyhisto(zone, latency);
+		isc_histo_detach(&latency);
+	}
+
 	/*
 	 * Configure master functionality.  This applies
 	 * to primary masters (type "master") and slaves
@@ -111,6 +111,10 @@ command is one of the following:\n\
 		Flush the given name from the server's cache(s)\n\
   flushtree name [view]\n\
 		Flush all names under the given name from the server's cache(s)\n\
+  flushdlz [view]\n\
+		Flush the server's cache(s) of DLZ driver answers.\n\
+  flushdlzname name [view]\n\
+		Flush the given name from the server's DLZ cache(s).\n\
   freeze	Suspend updates to all dynamic zones.\n\
   freeze zone [class [view]]\n\
 		Suspend updates to a dynamic zone.\n\
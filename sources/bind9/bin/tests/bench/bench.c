@@ -0,0 +1,836 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file
+ * \brief
+ * Microbenchmarks for the libdns hot paths.
+ *
+ * Each benchmark runs an operation (parsing one name, looking up one
+ * name, loading the zone, ...) over the corpus files in the benchmark
+ * directory until the run lasts long enough to time, and reports the
+ * time, the number of allocations and the bytes allocated per operation.
+ * Allocations are counted by giving libdns a memory context without
+ * internal pools, whose every isc_mem_get() reaches the allocator below.
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/entropy.h>
+#include <isc/hash.h>
+#include <isc/mem.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdataslab.h>
+#include <dns/result.h>
+
+#define MAXMESSAGES	64
+#define MAXNAMES	10000
+
+typedef struct bench {
+	const char	*name;
+	const char	*description;
+	void		(*setup)(void);
+	void		(*run)(unsigned int count);
+	void		(*cleanup)(void);
+} bench_t;
+
+static char *progname;
+static isc_mem_t *mctx = NULL;
+static isc_entropy_t *ectx = NULL;
+static const char *directory = ".";
+static dns_fixedname_t forigin;
+static dns_name_t *origin;
+
+static isc_uint64_t allocs;
+static isc_uint64_t allocated;
+
+static char *texts[MAXNAMES];
+static dns_fixedname_t names[MAXNAMES];
+static unsigned int nnames;
+
+static isc_buffer_t *messages[MAXMESSAGES];
+static unsigned int nmessages;
+
+static void *
+bench_alloc(void *arg, size_t size) {
+	UNUSED(arg);
+
+	allocs++;
+	allocated += size;
+	return (malloc(size));
+}
+
+static void
+bench_free(void *arg, void *ptr) {
+	UNUSED(arg);
+
+	free(ptr);
+}
+
+static void
+check_result(isc_result_t result, const char *what) {
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s: %s\n", progname, what,
+			isc_result_totext(result));
+		exit(1);
+	}
+}
+
+static const char *
+corpus(const char *file) {
+	static char path[1024];
+
+	snprintf(path, sizeof(path), "%s/%s", directory, file);
+	return (path);
+}
+
+static void
+fromtext(const char *text, dns_name_t *name) {
+	isc_buffer_t source;
+	size_t length = strlen(text);
+
+	isc_buffer_constinit(&source, text, length);
+	isc_buffer_add(&source, length);
+	check_result(dns_name_fromtext(name, &source, dns_rootname, 0, NULL),
+		     text);
+}
+
+/*%
+ * names.txt: one name per line, the names the benchmarks look up.
+ */
+static void
+load_names(void) {
+	char line[DNS_NAME_FORMATSIZE + 2];
+	FILE *fp;
+
+	if (nnames != 0)
+		return;
+
+	fp = fopen(corpus("names.txt"), "r");
+	if (fp == NULL) {
+		perror(corpus("names.txt"));
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL && nnames < MAXNAMES) {
+		char *end = line + strlen(line);
+
+		while (end > line && isspace((unsigned char)end[-1]))
+			*--end = '\0';
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+		texts[nnames] = strdup(line);
+		RUNTIME_CHECK(texts[nnames] != NULL);
+		dns_fixedname_init(&names[nnames]);
+		fromtext(line, dns_fixedname_name(&names[nnames]));
+		nnames++;
+	}
+	fclose(fp);
+	if (nnames == 0) {
+		fprintf(stderr, "%s: no names in %s\n", progname,
+			corpus("names.txt"));
+		exit(1);
+	}
+}
+
+static int
+fromhex(char c) {
+	if (c >= '0' && c <= '9')
+		return (c - '0');
+	if (c >= 'a' && c <= 'f')
+		return (c - 'a' + 10);
+	return (c - 'A' + 10);
+}
+
+/*%
+ * messages.data: wire format messages in hex, '#' starting a comment
+ * and an empty line ending each message.
+ */
+static void
+load_messages(void) {
+	unsigned char wire[65535];
+	char line[1024], *p;
+	unsigned int length = 0;
+	isc_boolean_t done;
+	FILE *fp;
+
+	if (nmessages != 0)
+		return;
+
+	fp = fopen(corpus("messages.data"), "r");
+	if (fp == NULL) {
+		perror(corpus("messages.data"));
+		exit(1);
+	}
+	do {
+		done = ISC_TF(fgets(line, sizeof(line), fp) == NULL);
+		if (done || line[strspn(line, " \t\r\n")] == '\0') {
+			if (length == 0)
+				continue;
+			INSIST(nmessages < MAXMESSAGES);
+			check_result(isc_buffer_allocate(mctx,
+						 &messages[nmessages],
+						 length),
+				     "isc_buffer_allocate");
+			isc_buffer_putmem(messages[nmessages], wire, length);
+			nmessages++;
+			length = 0;
+			continue;
+		}
+		for (p = line; *p != '\0' && *p != '#'; p++) {
+			if (!isxdigit((unsigned char)p[0]))
+				continue;
+			if (!isxdigit((unsigned char)p[1]) ||
+			    length == sizeof(wire))
+			{
+				fprintf(stderr, "%s: bad line in %s: %s",
+					progname, corpus("messages.data"),
+					line);
+				exit(1);
+			}
+			wire[length++] = fromhex(p[0]) << 4 | fromhex(p[1]);
+			p++;
+		}
+	} while (!done);
+	fclose(fp);
+	if (nmessages == 0) {
+		fprintf(stderr, "%s: no messages in %s\n", progname,
+			corpus("messages.data"));
+		exit(1);
+	}
+}
+
+static void
+free_messages(void) {
+	while (nmessages > 0)
+		isc_buffer_free(&messages[--nmessages]);
+}
+
+/*
+ * name_fromtext, name_totext
+ */
+
+static void
+name_fromtext_run(unsigned int count) {
+	dns_fixedname_t fixed;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		dns_fixedname_init(&fixed);
+		fromtext(texts[i % nnames], dns_fixedname_name(&fixed));
+	}
+}
+
+static void
+name_totext_run(unsigned int count) {
+	char text[DNS_NAME_FORMATSIZE];
+	isc_buffer_t target;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		isc_buffer_init(&target, text, sizeof(text));
+		check_result(dns_name_totext(
+				dns_fixedname_name(&names[i % nnames]),
+				ISC_FALSE, &target),
+			     "dns_name_totext");
+	}
+}
+
+/*
+ * rbt_findnode: the owner names of zone.db in a tree.
+ */
+
+static dns_rbt_t *rbt = NULL;
+
+static isc_result_t
+rbt_add(void *arg, dns_name_t *owner, dns_rdataset_t *rdataset) {
+	isc_result_t result;
+
+	UNUSED(arg);
+	UNUSED(rdataset);
+
+	result = dns_rbt_addname(rbt, owner, rbt);
+	if (result == ISC_R_EXISTS)
+		result = ISC_R_SUCCESS;
+	return (result);
+}
+
+static void
+rbt_setup(void) {
+	dns_rdatacallbacks_t callbacks;
+
+	load_names();
+	check_result(dns_rbt_create(mctx, NULL, NULL, &rbt), "dns_rbt_create");
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = rbt_add;
+	check_result(dns_master_loadfile(corpus("zone.db"), origin, origin,
+					 dns_rdataclass_in, 0, &callbacks,
+					 mctx),
+		     corpus("zone.db"));
+}
+
+static void
+rbt_run(unsigned int count) {
+	dns_fixedname_t fixed;
+	dns_rbtnode_t *node;
+	isc_result_t result;
+	unsigned int i;
+
+	dns_fixedname_init(&fixed);
+	for (i = 0; i < count; i++) {
+		node = NULL;
+		result = dns_rbt_findnode(rbt,
+					  dns_fixedname_name(&names[i % nnames]),
+					  dns_fixedname_name(&fixed), &node,
+					  NULL, DNS_RBTFIND_EMPTYDATA,
+					  NULL, NULL);
+		if (result != ISC_R_SUCCESS && result != DNS_R_PARTIALMATCH)
+			check_result(result, "dns_rbt_findnode");
+	}
+}
+
+static void
+rbt_cleanup(void) {
+	dns_rbt_destroy(&rbt);
+}
+
+/*
+ * db_find: address lookups in zone.db loaded in an rbtdb.
+ */
+
+static dns_db_t *db = NULL;
+static dns_dbversion_t *version = NULL;
+
+static void
+db_setup(void) {
+	load_names();
+	check_result(dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+				   dns_rdataclass_in, 0, NULL, &db),
+		     "dns_db_create");
+	check_result(dns_db_load(db, corpus("zone.db")), corpus("zone.db"));
+	dns_db_currentversion(db, &version);
+}
+
+static void
+db_run(unsigned int count) {
+	dns_fixedname_t fixed;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node;
+	isc_result_t result;
+	unsigned int i;
+
+	dns_fixedname_init(&fixed);
+	dns_rdataset_init(&rdataset);
+	for (i = 0; i < count; i++) {
+		node = NULL;
+		result = dns_db_find(db, dns_fixedname_name(&names[i % nnames]),
+				     version, dns_rdatatype_a, 0, 0, &node,
+				     dns_fixedname_name(&fixed), &rdataset,
+				     NULL);
+		switch (result) {
+		case ISC_R_SUCCESS:
+		case DNS_R_CNAME:
+		case DNS_R_DELEGATION:
+		case DNS_R_NXDOMAIN:
+		case DNS_R_NXRRSET:
+		case DNS_R_EMPTYNAME:
+			break;
+		default:
+			check_result(result, "dns_db_find");
+		}
+		if (dns_rdataset_isassociated(&rdataset))
+			dns_rdataset_disassociate(&rdataset);
+		if (node != NULL)
+			dns_db_detachnode(db, &node);
+	}
+}
+
+static void
+db_cleanup(void) {
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	dns_db_detach(&db);
+}
+
+/*
+ * master_loadfile: load all of zone.db into a new rbtdb.
+ */
+
+static void
+master_run(unsigned int count) {
+	dns_rdatacallbacks_t callbacks;
+	dns_db_t *zone;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		zone = NULL;
+		check_result(dns_db_create(mctx, "rbt", origin,
+					   dns_dbtype_zone, dns_rdataclass_in,
+					   0, NULL, &zone),
+			     "dns_db_create");
+		dns_rdatacallbacks_init(&callbacks);
+		check_result(dns_db_beginload(zone, &callbacks.add,
+					      &callbacks.add_private),
+			     "dns_db_beginload");
+		check_result(dns_master_loadfile(corpus("zone.db"), origin,
+						 origin, dns_rdataclass_in, 0,
+						 &callbacks, mctx),
+			     corpus("zone.db"));
+		check_result(dns_db_endload(zone, &callbacks.add_private),
+			     "dns_db_endload");
+		dns_db_detach(&zone);
+	}
+}
+
+/*
+ * message_parse: each message of messages.data in turn, reusing one
+ * message structure as a server does.
+ */
+
+static dns_message_t *parsed[MAXMESSAGES];
+
+static void
+message_parse_setup(void) {
+	load_messages();
+	check_result(dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE,
+					&parsed[0]),
+		     "dns_message_create");
+}
+
+static void
+parse_messages(unsigned int count, unsigned int options) {
+	isc_buffer_t source;
+	isc_region_t r;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		isc_buffer_usedregion(messages[i % nmessages], &r);
+		isc_buffer_init(&source, r.base, r.length);
+		isc_buffer_add(&source, r.length);
+		check_result(dns_message_parse(parsed[0], &source, options),
+			     "dns_message_parse");
+		dns_message_reset(parsed[0], DNS_MESSAGE_INTENTPARSE);
+	}
+}
+
+static void
+message_parse_run(unsigned int count) {
+	parse_messages(count, 0);
+}
+
+/*
+ * message_parse_lazy: the same with DNS_MESSAGEPARSE_LAZY, leaving
+ * the sections no one looks at undecoded.
+ */
+static void
+message_parse_lazy_run(unsigned int count) {
+	parse_messages(count, DNS_MESSAGEPARSE_LAZY);
+}
+
+static void
+message_parse_cleanup(void) {
+	dns_message_destroy(&parsed[0]);
+	free_messages();
+}
+
+/*
+ * message_render: each message of messages.data in turn, built once
+ * from its parsed form and rendered with compression.
+ */
+
+static dns_message_t *rendered[MAXMESSAGES];
+
+static void
+build_render(dns_message_t *source, dns_message_t *target) {
+	dns_name_t *name, *newname;
+	dns_rdataset_t *rdataset, *newrdataset;
+	dns_section_t section;
+
+	target->id = source->id;
+	target->flags = source->flags;
+	target->rcode = source->rcode;
+	target->opcode = source->opcode;
+	target->rdclass = source->rdclass;
+
+	for (section = DNS_SECTION_QUESTION;
+	     section <= DNS_SECTION_ADDITIONAL;
+	     section++)
+	{
+		for (name = ISC_LIST_HEAD(source->sections[section]);
+		     name != NULL;
+		     name = ISC_LIST_NEXT(name, link))
+		{
+			newname = NULL;
+			check_result(dns_message_gettempname(target, &newname),
+				     "dns_message_gettempname");
+			dns_name_init(newname, NULL);
+			dns_name_clone(name, newname);
+			for (rdataset = ISC_LIST_HEAD(name->list);
+			     rdataset != NULL;
+			     rdataset = ISC_LIST_NEXT(rdataset, link))
+			{
+				newrdataset = NULL;
+				check_result(dns_message_gettemprdataset(target,
+							&newrdataset),
+					     "dns_message_gettemprdataset");
+				dns_rdataset_init(newrdataset);
+				dns_rdataset_clone(rdataset, newrdataset);
+				ISC_LIST_APPEND(newname->list, newrdataset,
+						link);
+			}
+			dns_message_addname(target, newname, section);
+		}
+	}
+
+	rdataset = dns_message_getopt(source);
+	if (rdataset != NULL) {
+		newrdataset = NULL;
+		check_result(dns_message_gettemprdataset(target, &newrdataset),
+			     "dns_message_gettemprdataset");
+		dns_rdataset_init(newrdataset);
+		dns_rdataset_clone(rdataset, newrdataset);
+		check_result(dns_message_setopt(target, newrdataset),
+			     "dns_message_setopt");
+	}
+}
+
+static void
+message_render_setup(void) {
+	isc_buffer_t source;
+	isc_region_t r;
+	unsigned int i;
+
+	load_messages();
+	for (i = 0; i < nmessages; i++) {
+		check_result(dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE,
+						&parsed[i]),
+			     "dns_message_create");
+		isc_buffer_usedregion(messages[i], &r);
+		isc_buffer_init(&source, r.base, r.length);
+		isc_buffer_add(&source, r.length);
+		check_result(dns_message_parse(parsed[i], &source, 0),
+			     "dns_message_parse");
+		check_result(dns_message_create(mctx,
+						DNS_MESSAGE_INTENTRENDER,
+						&rendered[i]),
+			     "dns_message_create");
+		build_render(parsed[i], rendered[i]);
+	}
+}
+
+static void
+message_render_run(unsigned int count) {
+	static unsigned char wire[65535];
+	dns_message_t *msg;
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		msg = rendered[i % nmessages];
+		isc_buffer_init(&target, wire, sizeof(wire));
+		check_result(dns_compress_init(&cctx, -1, mctx),
+			     "dns_compress_init");
+		dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+		check_result(dns_message_renderbegin(msg, &cctx, &target),
+			     "dns_message_renderbegin");
+		check_result(dns_message_rendersection(msg,
+						       DNS_SECTION_QUESTION,
+						       0),
+			     "dns_message_rendersection");
+		check_result(dns_message_rendersection(msg,
+						       DNS_SECTION_ANSWER,
+						       0),
+			     "dns_message_rendersection");
+		check_result(dns_message_rendersection(msg,
+						       DNS_SECTION_AUTHORITY,
+						       0),
+			     "dns_message_rendersection");
+		check_result(dns_message_rendersection(msg,
+						       DNS_SECTION_ADDITIONAL,
+						       0),
+			     "dns_message_rendersection");
+		check_result(dns_message_renderend(msg),
+			     "dns_message_renderend");
+		dns_compress_invalidate(&cctx);
+		dns_message_renderreset(msg);
+	}
+}
+
+static void
+message_render_cleanup(void) {
+	unsigned int i;
+
+	for (i = 0; i < nmessages; i++) {
+		dns_message_destroy(&rendered[i]);
+		dns_message_destroy(&parsed[i]);
+	}
+	free_messages();
+}
+
+/*
+ * rdataslab_merge: add a 4 record RRset to a 16 record one, half of
+ * the new records being already there.
+ */
+
+static unsigned char *oslab, *nslab;
+
+static unsigned char *
+make_slab(unsigned int first, unsigned int count) {
+	unsigned char addrs[16][4];
+	dns_rdata_t rdatas[16];
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_region_t region;
+	unsigned int i;
+
+	INSIST(count <= 16);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 3600;
+	for (i = 0; i < count; i++) {
+		addrs[i][0] = 192;
+		addrs[i][1] = 0;
+		addrs[i][2] = 2;
+		addrs[i][3] = first + i;
+		dns_rdata_init(&rdatas[i]);
+		region.base = addrs[i];
+		region.length = 4;
+		dns_rdata_fromregion(&rdatas[i], dns_rdataclass_in,
+				     dns_rdatatype_a, &region);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdatas[i], link);
+	}
+	dns_rdataset_init(&rdataset);
+	check_result(dns_rdatalist_tordataset(&rdatalist, &rdataset),
+		     "dns_rdatalist_tordataset");
+	check_result(dns_rdataslab_fromrdataset(&rdataset, mctx, &region, 0),
+		     "dns_rdataslab_fromrdataset");
+	dns_rdataset_disassociate(&rdataset);
+	return (region.base);
+}
+
+static void
+slab_setup(void) {
+	oslab = make_slab(1, 16);
+	nslab = make_slab(15, 4);
+}
+
+static void
+slab_run(unsigned int count) {
+	unsigned char *tslab;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		tslab = NULL;
+		check_result(dns_rdataslab_merge(oslab, nslab, 0, mctx,
+						 dns_rdataclass_in,
+						 dns_rdatatype_a, 0, &tslab),
+			     "dns_rdataslab_merge");
+		isc_mem_put(mctx, tslab, dns_rdataslab_size(tslab, 0));
+	}
+}
+
+static void
+slab_cleanup(void) {
+	isc_mem_put(mctx, oslab, dns_rdataslab_size(oslab, 0));
+	isc_mem_put(mctx, nslab, dns_rdataslab_size(nslab, 0));
+}
+
+static bench_t benches[] = {
+	{ "name_fromtext", "dns_name_fromtext() of names.txt",
+	  load_names, name_fromtext_run, NULL },
+	{ "name_totext", "dns_name_totext() of names.txt",
+	  load_names, name_totext_run, NULL },
+	{ "rbt_findnode", "names.txt in a tree of the zone.db names",
+	  rbt_setup, rbt_run, rbt_cleanup },
+	{ "db_find", "names.txt/A in zone.db, rbtdb",
+	  db_setup, db_run, db_cleanup },
+	{ "master_loadfile", "all of zone.db into an rbtdb",
+	  NULL, master_run, NULL },
+	{ "message_parse", "messages.data",
+	  message_parse_setup, message_parse_run, message_parse_cleanup },
+	{ "message_parse_lazy", "messages.data, sections left undecoded",
+	  message_parse_setup, message_parse_lazy_run,
+	  message_parse_cleanup },
+	{ "message_render", "messages.data, with compression",
+	  message_render_setup, message_render_run, message_render_cleanup },
+	{ "rdataslab_merge", "4 A records into 16, 2 new",
+	  slab_setup, slab_run, slab_cleanup },
+	{ NULL, NULL, NULL, NULL, NULL }
+};
+
+/*%
+ * Run 'b' 'count' times, or when 'count' is 0 as many times as it takes
+ * to last 'seconds', and print the result of the last run.
+ */
+static void
+run_bench(bench_t *b, unsigned int count, double seconds,
+	  isc_boolean_t machine)
+{
+	isc_time_t start, end;
+	isc_uint64_t us;
+	unsigned int n;
+	double ns;
+
+	if (b->setup != NULL)
+		(b->setup)();
+
+	n = (count != 0) ? count : 1;
+	for (;;) {
+		allocs = allocated = 0;
+		RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+		(b->run)(n);
+		RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+		us = isc_time_microdiff(&end, &start);
+		if (count != 0 || us >= seconds * 1000000 || n >= 1000000000)
+			break;
+		/* aim 20% past the target, growing at most 100 fold */
+		if (us * 100 < seconds * 1000000)
+			n *= 100;
+		else
+			n = (unsigned int)(n * seconds * 1200000 / us) + 1;
+	}
+	ns = us * 1000.0 / n;
+
+	if (machine)
+		printf("%s\t%u\t%.1f\t%.2f\t%.0f\n", b->name, n, ns,
+		       (double)allocs / n, (double)allocated / n);
+	else
+		printf("%-18s %10u %12.1f ns/op %8.2f allocs/op "
+		       "%8.0f bytes/op\n", b->name, n, ns,
+		       (double)allocs / n, (double)allocated / n);
+	fflush(stdout);
+
+	if (b->cleanup != NULL)
+		(b->cleanup)();
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"usage: %s [-lm] [-c count] [-d directory] [-r repeat] "
+		"[-t seconds]\n"
+		"       [benchmark ...]\n", progname);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int count = 0, repeat = 1, i;
+	isc_boolean_t list = ISC_FALSE, machine = ISC_FALSE, found;
+	double seconds = 1.0;
+	bench_t *b;
+	int ch, j;
+
+	progname = argv[0];
+	while ((ch = isc_commandline_parse(argc, argv, "c:d:lmr:t:")) != -1) {
+		switch (ch) {
+		case 'c':
+			count = atoi(isc_commandline_argument);
+			break;
+		case 'd':
+			directory = isc_commandline_argument;
+			break;
+		case 'l':
+			list = ISC_TRUE;
+			break;
+		case 'm':
+			machine = ISC_TRUE;
+			break;
+		case 'r':
+			repeat = atoi(isc_commandline_argument);
+			if (repeat == 0)
+				usage();
+			break;
+		case 't':
+			seconds = atof(isc_commandline_argument);
+			if (seconds <= 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	for (j = 0; j < argc; j++) {
+		for (b = benches; b->name != NULL; b++)
+			if (strcmp(argv[j], b->name) == 0)
+				break;
+		if (b->name == NULL) {
+			fprintf(stderr, "%s: unknown benchmark '%s'\n",
+				progname, argv[j]);
+			exit(1);
+		}
+	}
+
+	if (list) {
+		for (b = benches; b->name != NULL; b++)
+			printf("%-18s %s\n", b->name, b->description);
+		return (0);
+	}
+
+	dns_result_register();
+	RUNTIME_CHECK(isc_mem_createx2(0, 0, bench_alloc, bench_free, NULL,
+				       &mctx, 0) == ISC_R_SUCCESS);
+	check_result(isc_entropy_create(mctx, &ectx), "isc_entropy_create");
+	check_result(isc_hash_create(mctx, ectx, DNS_NAME_MAXWIRE),
+		     "isc_hash_create");
+
+	dns_fixedname_init(&forigin);
+	origin = dns_fixedname_name(&forigin);
+	fromtext("bench.example.", origin);
+
+	if (machine)
+		printf("# benchmark\titerations\tns/op\tallocs/op\t"
+		       "bytes/op\n");
+	for (b = benches; b->name != NULL; b++) {
+		found = ISC_TF(argc == 0);
+		for (j = 0; j < argc; j++)
+			if (strcmp(argv[j], b->name) == 0)
+				found = ISC_TRUE;
+		if (!found)
+			continue;
+		for (i = 0; i < repeat; i++)
+			run_bench(b, count, seconds, machine);
+	}
+
+	for (i = 0; i < nnames; i++)
+		free(texts[i]);
+	isc_hash_destroy();
+	isc_entropy_detach(&ectx);
+	isc_mem_destroy(&mctx);
+	return (0);
+}
@@ -0,0 +1,66 @@
+#!/usr/bin/perl
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+# Compare two "bench -m" outputs: compare.pl old new
+# Repeated runs of a benchmark (bench -r) count with their best time.
+
+use strict;
+
+sub readresults {
+	my ($file) = @_;
+	my (%results, @order);
+
+	open(my $fh, "<", $file) or die "$file: $!\n";
+	while (<$fh>) {
+		next if /^#/;
+		chomp;
+		my ($name, $n, $ns, $allocs, $bytes) = split(/\t/);
+		next unless defined($bytes);
+		if (!exists($results{$name})) {
+			push(@order, $name);
+		} elsif ($results{$name}->[0] <= $ns) {
+			next;
+		}
+		$results{$name} = [ $ns, $allocs, $bytes ];
+	}
+	close($fh);
+	return (\%results, \@order);
+}
+
+die "usage: compare.pl old new\n" unless @ARGV == 2;
+my ($old) = readresults($ARGV[0]);
+my ($new, $order) = readresults($ARGV[1]);
+
+printf("%-16s %12s %12s %8s %10s %10s\n", "benchmark", "old ns/op",
+       "new ns/op", "delta", "allocs/op", "bytes/op");
+foreach my $name (@$order) {
+	my $n = $new->{$name};
+	my $o = $old->{$name};
+	if (!defined($o)) {
+		printf("%-16s %12s %12.1f %8s %10.2f %10.0f\n", $name, "-",
+		       $n->[0], "-", $n->[1], $n->[2]);
+		next;
+	}
+	my $delta = $o->[0] > 0 ? ($n->[0] - $o->[0]) * 100 / $o->[0] : 0;
+	my $allocs = sprintf("%.2f", $n->[1]);
+	my $bytes = sprintf("%.0f", $n->[2]);
+	$allocs = sprintf("%.2f>%.2f", $o->[1], $n->[1])
+		if $o->[1] != $n->[1];
+	$bytes = sprintf("%.0f>%.0f", $o->[2], $n->[2])
+		if $o->[2] != $n->[2];
+	printf("%-16s %12.1f %12.1f %+7.1f%% %10s %10s\n", $name, $o->[0],
+	       $n->[0], $delta, $allocs, $bytes);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file
+ * Measure the throughput of NSEC3 hashing one name at a time with
+ * isc_iterated_hash() against batches with isc_iterated_hash_multi().
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/hex.h>
+#include <isc/iterated_hash.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define MAXBATCH 256
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: nsec3hash_test [-b batch] [-i iterations] "
+		"[-n names] [-s salt]\n");
+	exit(1);
+}
+
+static double
+elapsed(isc_time_t *start) {
+	isc_time_t now;
+
+	TIME_NOW(&now);
+	return ((double)isc_time_microdiff(&now, start) / 1000000.0);
+}
+
+int
+main(int argc, char **argv) {
+	unsigned char salt[255], hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char (*names)[32], (*single)[ISC_SHA1_DIGESTLENGTH];
+	unsigned char (*batched)[ISC_SHA1_DIGESTLENGTH];
+	unsigned char *out[MAXBATCH];
+	const unsigned char *in[MAXBATCH];
+	int inlength[MAXBATCH];
+	unsigned int count = 100000, batch = 64, iterations = 10;
+	unsigned int i, j, n, mismatch = 0;
+	const char *saltstr = "aabbccdd";
+	isc_buffer_t buf;
+	isc_time_t start;
+	double t1, t2;
+	int saltlen = 0, ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "b:i:n:s:")) != -1) {
+		switch (ch) {
+		case 'b':
+			batch = atoi(isc_commandline_argument);
+			if (batch == 0 || batch > MAXBATCH)
+				usage();
+			break;
+		case 'i':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		case 'n':
+			count = atoi(isc_commandline_argument);
+			break;
+		case 's':
+			saltstr = isc_commandline_argument;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (strcmp(saltstr, "-") != 0) {
+		isc_buffer_init(&buf, salt, sizeof(salt));
+		if (isc_hex_decodestring(saltstr, &buf) != ISC_R_SUCCESS) {
+			fprintf(stderr, "bad salt '%s'\n", saltstr);
+			exit(1);
+		}
+		saltlen = isc_buffer_usedlength(&buf);
+	}
+
+	names = malloc(count * sizeof(*names));
+	single = malloc(count * sizeof(*single));
+	batched = malloc(count * sizeof(*batched));
+	if (names == NULL || single == NULL || batched == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	/* Names of the form <number>.example. */
+	for (i = 0; i < count; i++) {
+		n = snprintf((char *)names[i] + 1, sizeof(names[i]) - 1,
+			     "%u\007example", i);
+		names[i][0] = n - 8;
+		names[i][n + 1] = 0;
+	}
+
+	TIME_NOW(&start);
+	for (i = 0; i < count; i++) {
+		isc_iterated_hash(hash, 1, iterations, salt, saltlen,
+				  names[i], strlen((char *)names[i]) + 1);
+		memmove(single[i], hash, ISC_SHA1_DIGESTLENGTH);
+	}
+	t1 = elapsed(&start);
+
+	TIME_NOW(&start);
+	for (i = 0; i < count; i += n) {
+		n = ISC_MIN(batch, count - i);
+		for (j = 0; j < n; j++) {
+			out[j] = batched[i + j];
+			in[j] = names[i + j];
+			inlength[j] = strlen((char *)names[i + j]) + 1;
+		}
+		isc_iterated_hash_multi(out, 1, iterations, salt, saltlen,
+					in, inlength, n);
+	}
+	t2 = elapsed(&start);
+
+	for (i = 0; i < count; i++)
+		if (memcmp(single[i], batched[i], ISC_SHA1_DIGESTLENGTH) != 0)
+			mismatch++;
+
+	printf("%u names, %u iterations, %d octet salt\n",
+	       count, iterations, saltlen);
+	printf("isc_iterated_hash:       %8.3f sec %10.0f names/sec\n",
+	       t1, t1 > 0 ? count / t1 : 0.0);
+	printf("isc_iterated_hash_multi: %8.3f sec %10.0f names/sec "
+	       "(batch %u)\n", t2, t2 > 0 ? count / t2 : 0.0, batch);
+	if (mismatch != 0)
+		printf("%u hashes differ\n", mismatch);
+
+	free(names);
+	free(single);
+	free(batched);
+	return (mismatch == 0 ? 0 : 1);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file
+ * Measure how fast a number of threads can increment the same few
+ * statistics counters, with a single set of counters (isc_stats_create())
+ * and with a shard per thread (isc_stats_create2()).
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#ifdef ISC_PLATFORM_USETHREADS
+
+#define MAXTHREADS	256
+#define NCOUNTERS	40	/* about dns_nsstatscounter_max */
+
+static isc_stats_t *stats;
+static unsigned int count = 1000000, used = 4;
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+run(void *arg) {
+	unsigned int i;
+
+	UNUSED(arg);
+
+	/* Like a response: a handful of counters per query. */
+	for (i = 0; i < count; i++)
+		isc_stats_increment(stats, i % used);
+	return ((isc_threadresult_t)0);
+}
+
+static isc_uint64_t total;
+
+static void
+sum(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	UNUSED(counter);
+	UNUSED(arg);
+
+	total += value;
+}
+
+static double
+measure(isc_mem_t *mctx, unsigned int nthreads, unsigned int nshards) {
+	isc_thread_t threads[MAXTHREADS];
+	isc_time_t start, now;
+	unsigned int i;
+
+	if (nshards == 1)
+		RUNTIME_CHECK(isc_stats_create(mctx, &stats, NCOUNTERS) ==
+			      ISC_R_SUCCESS);
+	else
+		RUNTIME_CHECK(isc_stats_create2(mctx, &stats, NCOUNTERS,
+						nshards) == ISC_R_SUCCESS);
+
+	TIME_NOW(&start);
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_create(run, NULL, &threads[i]) ==
+			      ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(threads[i], NULL);
+	TIME_NOW(&now);
+
+	total = 0;
+	isc_stats_dump(stats, sum, NULL, 0);
+	if (total != (isc_uint64_t)nthreads * count)
+		printf("lost %" ISC_PRINT_QUADFORMAT "u increments\n",
+		       (isc_uint64_t)nthreads * count - total);
+	isc_stats_detach(&stats);
+
+	return ((double)isc_time_microdiff(&now, &start) / 1000000.0);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: stats_test [-c counters] [-n increments] "
+		"[-t threads]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	isc_mem_t *mctx = NULL;
+	unsigned int nthreads = 32;
+	double t1, t2, n;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "c:n:t:")) != -1) {
+		switch (ch) {
+		case 'c':
+			used = atoi(isc_commandline_argument);
+			if (used == 0 || used > NCOUNTERS)
+				usage();
+			break;
+		case 'n':
+			count = atoi(isc_commandline_argument);
+			break;
+		case 't':
+			nthreads = atoi(isc_commandline_argument);
+			if (nthreads == 0 || nthreads > MAXTHREADS)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+
+	n = (double)nthreads * count;
+	printf("%u threads, %u increments each over %u counters\n",
+	       nthreads, count, used);
+	t1 = measure(mctx, nthreads, 1);
+	printf("1 shard:    %8.3f sec %12.0f increments/sec\n",
+	       t1, t1 > 0 ? n / t1 : 0.0);
+	t2 = measure(mctx, nthreads, nthreads);
+	printf("%u shards: %8.3f sec %12.0f increments/sec\n",
+	       nthreads, t2, t2 > 0 ? n / t2 : 0.0);
+
+	isc_mem_destroy(&mctx);
+	return (0);
+}
+
+#else
+
+int
+main(int argc, char *argv[]) {
+	UNUSED(argc);
+	UNUSED(argv);
+	fprintf(stderr, "This test requires threads.\n");
+	return(1);
+}
+
+#endif
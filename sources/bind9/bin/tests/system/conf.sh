@@ -56,22 +56,25 @@ ARPANAME=$TOP/bin/tools/arpaname
 SAMPLE=$TOP/lib/export/samples/sample
 GENRANDOM=$TOP/bin/tools/genrandom
 NSLOOKUP=$TOP/bin/dig/nslookup
+QUERYPERF=$TOP/contrib/queryperf/queryperf
 
 RANDFILE=$TOP/bin/tests/system/random.data
 
 # The "stress" test is not run by default since it creates enough
 # load on the machine to make it unusable to other users.
+# Neither is the "perf" benchmark, for the same reason.
 # v6synth
 SUBDIRS="acl additional allow_query addzone autosign builtin
 	 cacheclean case checkconf checkds checknames checkzone
-	 coverage database dlv dlvauto dlz dlzexternal dname dns64
-	 dnssec ecdsa emptyzones filter-aaaa formerr forward glue
+	 coverage database digwindow dlv dlvauto dlz dlzexternal dname
+	 dns64 dnssec ecdsa emptyzones filter-aaaa formerr forward glue
 	 gost ixfr inline legacy limits logfileconfig lwresd masterfile
-	 masterformat metadata notify nslookup nsupdate pending pkcs11
-	 reclimit redirect resolver rndc rpz rrl rrsetorder rsabigexponent
-	 smartsign sortlist spf staticstub stub tkey tsig tsiggss
+	 masterformat metadata notify nslookup nsupdate parallelsign
+	 pending pipelined pkcs11 reclimit redirect resolver rndc rpz rrl
+	 rrsetorder rsabigexponent smartsign sortlist spf staticstub stub
+	 tkey tsig tsiggss
 	 unknown upforwd verify views wildcard xfer xferquota zero
-	 zonechecks"
+	 zonechecks zoneindex"
 
 # Use the CONFIG_SHELL detected by configure for tests
 SHELL=/bin/sh
@@ -92,4 +95,4 @@ fi
 
 export NAMED LWRESD DIG NSUPDATE KEYGEN KEYFRLAB SIGNER KEYSIGNER KEYSETTOOL \
        PERL SUBDIRS RNDC CHECKZONE PK11GEN PK11LIST PK11DEL TESTSOCK6 \
-       JOURNALPRINT ARPANAME SAMPLE NSLOOKUP
+       JOURNALPRINT ARPANAME SAMPLE NSLOOKUP QUERYPERF
@@ -0,0 +1,92 @@
+#!/usr/bin/perl
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+#
+# A TCP only server that answers pipelined queries in reverse order.
+# It collects the queries on a connection until none has arrived for
+# a moment, then answers the latest first.  nN/A is answered with
+# 10.0.0.N and everything else with NXDOMAIN.
+#
+
+require 5.006_001;
+
+use strict;
+use IO::File;
+use IO::Select;
+use IO::Socket;
+
+my $pidf = new IO::File "ans.pid", "w" or die "cannot open pid file: $!";
+print $pidf "$$\n" or die "cannot write pid file: $!";
+$pidf->close or die "cannot close pid file: $!";
+sub rmpid { unlink "ans.pid"; exit 1; };
+
+$SIG{INT} = \&rmpid;
+$SIG{TERM} = \&rmpid;
+
+$| = 1;
+
+my $server = IO::Socket::INET->new(LocalAddr => "10.53.0.2",
+				   LocalPort => 5300, Proto => "tcp",
+				   Listen => 5, ReuseAddr => 1) or die "$!";
+
+sub answer {
+    my ($query) = @_;
+    my ($id, $flags) = unpack("nn", $query);
+    my ($offset, $name) = (12, "");
+    my $rcode = 3;
+    my $answer = "";
+
+    while ((my $len = ord(substr($query, $offset, 1))) != 0) {
+	$name .= substr($query, $offset + 1, $len) . ".";
+	$offset += $len + 1;
+    }
+    my $qtype = unpack("n", substr($query, $offset + 1, 2));
+    my $question = substr($query, 12, $offset + 5 - 12);
+
+    if ($name =~ /^n(\d+)\./ && $qtype == 1) {
+	$rcode = 0;
+	$answer = pack("nnnNnC4", 0xc00c, 1, 1, 300, 4, 10, 0, 0, $1);
+    }
+    print "answered $name id $id\n";
+    return pack("nnnnnn", $id, 0x8400 | ($flags & 0x0100) | $rcode,
+		1, $answer eq "" ? 0 : 1, 0, 0) . $question . $answer;
+}
+
+while (my $conn = $server->accept) {
+    my $select = IO::Select->new($conn);
+    my $buf = "";
+    my @pending;
+    my $open = 1;
+
+    while ($open) {
+	if ($select->can_read(0.5)) {
+	    my $n = $conn->sysread($buf, 65536, length $buf);
+	    $open = 0 if (!defined $n || $n == 0);
+	    while (length $buf >= 2) {
+		my $len = unpack("n", $buf);
+		last if (length $buf < $len + 2);
+		push @pending, substr($buf, 2, $len);
+		$buf = substr($buf, $len + 2);
+	    }
+	    next if $open;
+	}
+	while (my $query = pop @pending) {
+	    my $response = answer($query);
+	    $conn->syswrite(pack("n", length $response) . $response);
+	}
+    }
+    $conn->close;
+}
@@ -0,0 +1,122 @@
+#!/bin/sh
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+DIGOPTS="+norec +noall +answer -p 5300"
+
+status=0
+n=0
+
+# Batch files of 'count' lookups of nN.example/A, with a lookup of a
+# name that does not exist after the first 'count'/2, and the answers
+# they should print, in order.
+makebatch () {
+	i=1
+	rm -f batch.$1 batch.$1.expect
+	while [ $i -le $1 ]
+	do
+		echo "n$i.example a" >> batch.$1
+		echo "n$i.example. 10.0.0.$i" >> batch.$1.expect
+		[ $i -eq `expr $1 / 2` ] && echo "missing.example a" >> batch.$1
+		i=`expr $i + 1`
+	done
+}
+
+# check_answers output expected: the answers were printed in order.
+check_answers () {
+	awk '{ print $1, $5 }' $1 > $1.answers
+	cmp -s $1.answers $2
+}
+
+# check_summary stderr lookups: every lookup was answered once, with
+# one NXDOMAIN.
+check_summary () {
+	grep "^;; $2 lookups in " $1 > /dev/null || return 1
+	grep "^;; $2 answers, 0 timeouts, 0 errors, 0 retransmissions, " \
+		$1 > /dev/null || return 1
+	grep " 0 truncated, 0 unexpected\$" $1 > /dev/null || return 1
+	grep "^;; NOERROR `expr $2 - 1` NXDOMAIN 1\$" $1 > /dev/null ||
+		return 1
+	grep "^;; latency (ms): min " $1 > /dev/null || return 1
+}
+
+makebatch 40
+makebatch 8
+
+n=`expr $n + 1`
+echo "I:checking +window prints UDP answers in order ($n)"
+ret=0
+$DIG $DIGOPTS @10.53.0.1 +window=16 -f batch.40 > dig.out.$n \
+	2> dig.err.$n || ret=1
+check_answers dig.out.$n batch.40.expect || ret=1
+udperr=dig.err.$n
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking the +window summary ($n)"
+ret=0
+check_summary $udperr 41 || ret=1
+grep "TCP connections" $udperr > /dev/null && ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking +window +tcp prints answers in order ($n)"
+ret=0
+$DIG $DIGOPTS @10.53.0.1 +tcp +window=16 -f batch.40 > dig.out.$n \
+	2> dig.err.$n || ret=1
+check_answers dig.out.$n batch.40.expect || ret=1
+check_summary dig.err.$n 41 || ret=1
+grep "^;; 1 TCP connections, 0 lost with queries outstanding\$" \
+	dig.err.$n > /dev/null || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+#
+# ans2 answers the queries pipelined on a connection in reverse order,
+# so the answers must be matched to their queries by ID.
+#
+n=`expr $n + 1`
+echo "I:checking +window +tcp matches answers sent out of order ($n)"
+ret=0
+$DIG $DIGOPTS @10.53.0.2 +tcp +window=16 -f batch.8 > dig.out.$n \
+	2> dig.err.$n || ret=1
+check_answers dig.out.$n batch.8.expect || ret=1
+check_summary dig.err.$n 9 || ret=1
+grep "^;; 1 TCP connections, 0 lost with queries outstanding\$" \
+	dig.err.$n > /dev/null || ret=1
+grep "answered n8.example. " ans2/ans.run > /dev/null || ret=1
+sed -n '1s/^answered \([^ ]*\) .*/\1/p' ans2/ans.run > dig.out.$n.first
+echo "n8.example." | cmp -s - dig.out.$n.first || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking +window +tcp +noordered prints answers as they arrive ($n)"
+ret=0
+$DIG $DIGOPTS @10.53.0.2 +tcp +window=16 +noordered -f batch.8 \
+	> dig.out.$n 2> dig.err.$n || ret=1
+sed -n '1!G;h;$p' batch.8.expect > batch.8.reversed
+check_answers dig.out.$n batch.8.reversed || ret=1
+check_summary dig.err.$n 9 || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:exit status: $status"
+exit $status
@@ -0,0 +1,98 @@
+#!/bin/sh
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+RNDCCMD="$RNDC -c ../common/rndc.conf -s 10.53.0.1 -p 9953"
+DIGOPTS="+tcp +noall +answer -p 5300"
+
+status=0
+n=0
+
+n=`expr $n + 1`
+echo "I:checking the zone is loaded unsigned ($n)"
+ret=0
+$DIG $DIGOPTS +dnssec n3000.example a @10.53.0.1 > dig.out.test$n || ret=1
+grep "n3000.example.*10.0.11.184" dig.out.test$n > /dev/null || ret=1
+grep "RRSIG" dig.out.test$n > /dev/null && ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:generating keys and starting to sign"
+(
+cd ns1
+$KEYGEN -q -r $RANDFILE -a RSASHA256 -b 1024 -fk example > /dev/null &&
+$KEYGEN -q -r $RANDFILE -a RSASHA256 -b 1024 example > /dev/null
+) || status=`expr $status + 1`
+$RNDCCMD loadkeys example 2>&1 | sed 's/^/I:ns1 /'
+
+#
+# The progress counters are only shown while a key is being signed
+# with, so poll as fast as rndc allows.
+#
+n=`expr $n + 1`
+echo "I:checking signing progress is reported ($n)"
+ret=0
+progress="^Signing with key [0-9]*/RSASHA256"
+progress="$progress ([1-9][0-9]* nodes, [1-9][0-9]* signatures,"
+seen=0
+i=0
+while [ $i -lt 1000 ]
+do
+	$RNDCCMD signing -list example > signing.out.test$n 2>&1
+	grep "$progress" signing.out.test$n > /dev/null && seen=1
+	[ `grep -c "^Done signing" signing.out.test$n` = 2 ] && break
+	i=`expr $i + 1`
+done
+[ $seen = 1 ] || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:waiting for signing to complete ($n)"
+ret=0
+for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20
+do
+	$RNDCCMD signing -list example > signing.out.test$n 2>&1
+	[ `grep -c "^Done signing" signing.out.test$n` = 2 ] && break
+	sleep 1
+done
+[ `grep -c "^Done signing" signing.out.test$n` = 2 ] || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking the signing tasks computed the signatures used ($n)"
+ret=0
+# "zone_sign: used N of M signatures computed ahead", one per pass.
+grep "zone_sign: used [0-9]* of" ns1/named.run |
+	awk '{ used += $(NF-5); ahead += $(NF-3) }
+	     END { exit (used == 0 || used != ahead) }' || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking the signed zone verifies ($n)"
+ret=0
+$DIG $DIGOPTS axfr example @10.53.0.1 > dig.out.test$n || ret=1
+$VERIFY -o example dig.out.test$n > verify.out.test$n 2>&1 || ret=1
+grep "n3000.example.*RRSIG.*A 8 2 300" dig.out.test$n > /dev/null || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:exit status: $status"
+exit $status
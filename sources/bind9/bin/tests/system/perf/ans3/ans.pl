@@ -0,0 +1,125 @@
+#!/usr/bin/perl
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+#
+# A slow and lossy path to ns1 for the "lossy" scenario: queries to
+# 10.53.0.3 are forwarded to ns1 after a delay, and queries and
+# responses are dropped at random.  The settings are read from
+# lossy.conf ("delay", "jitter" in milliseconds, "loss" in percent).
+#
+
+use strict;
+use IO::File;
+use IO::Select;
+use IO::Socket::INET;
+use Socket;
+use Time::HiRes qw(time);
+
+$| = 1;
+
+my %conf = (delay => 50, jitter => 20, loss => 10);
+
+if (open(my $fh, "<", "lossy.conf")) {
+	while (<$fh>) {
+		$conf{$1} = $2 if (/^(\w+)\s+([\d.]+)/);
+	}
+	close($fh);
+}
+
+my $server = IO::Socket::INET->new(LocalAddr => "10.53.0.3",
+   LocalPort => 5300, Proto => "udp") or die "$!";
+my $upstream = IO::Socket::INET->new(LocalAddr => "10.53.0.3",
+   Proto => "udp") or die "$!";
+my $ns1 = sockaddr_in(5300, inet_aton("10.53.0.1"));
+
+my $pidf = new IO::File "ans.pid", "w" or die "cannot open pid file: $!";
+print $pidf "$$\n" or die "cannot write pid file: $!";
+$pidf->close or die "cannot close pid file: $!";
+sub rmpid { unlink "ans.pid"; exit 1; };
+
+$SIG{INT} = \&rmpid;
+$SIG{TERM} = \&rmpid;
+
+print "delay $conf{delay}ms jitter $conf{jitter}ms loss $conf{loss}%\n";
+
+# Queries are matched to their responses by ID and question.
+sub key {
+	my ($msg) = @_;
+	my $i = 12;
+
+	while ($i < length($msg)) {
+		my $l = ord(substr($msg, $i, 1));
+		last if ($l == 0 || $l >= 0xc0);
+		$i += $l + 1;
+	}
+	return (substr($msg, 0, 2) . lc(substr($msg, 12, $i + 5 - 12)));
+}
+
+my %clients;		# key => [ client address, time ]
+my @queue;		# [ due, message ] sorted by due time
+my $select = IO::Select->new($server, $upstream);
+my $purged = time;
+my ($forwarded, $dropped) = (0, 0);
+
+srand(1);
+
+for (;;) {
+	my $timeout;
+
+	if (@queue) {
+		$timeout = $queue[0][0] - time;
+		$timeout = 0 if ($timeout < 0);
+	}
+	foreach my $sock ($select->can_read($timeout)) {
+		my $msg;
+		my $from = $sock->recv($msg, 65535);
+
+		next if (!defined($from) || length($msg) < 12);
+		if (rand(100) < $conf{loss}) {
+			$dropped++;
+			next;
+		}
+		if ($sock == $server) {
+			my $due = time + ($conf{delay} +
+					  rand($conf{jitter})) / 1000;
+
+			$clients{key($msg)} = [ $from, time ];
+			@queue = sort { $a->[0] <=> $b->[0] }
+				 (@queue, [ $due, $msg ]);
+		} else {
+			my $client = delete $clients{key($msg)};
+
+			$server->send($msg, 0, $client->[0]) if ($client);
+		}
+	}
+
+	my $now = time;
+	while (@queue && $queue[0][0] <= $now) {
+		my $q = shift(@queue);
+
+		$upstream->send($q->[1], 0, $ns1);
+		$forwarded++;
+	}
+
+	# Forget the queries whose responses were lost.
+	if ($now - $purged > 10) {
+		foreach my $k (keys %clients) {
+			delete $clients{$k} if ($now - $clients{$k}[1] > 10);
+		}
+		print "forwarded $forwarded dropped $dropped\n";
+		$purged = $now;
+	}
+}
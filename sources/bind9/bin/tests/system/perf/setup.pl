@@ -0,0 +1,119 @@
+#!/usr/bin/perl
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+#
+# Generate the zones and the query files of the perf test.  The seed is
+# fixed so that every build is measured with the same data.
+#
+
+use strict;
+
+my $hosts = 10000;		# hosts in auth.example
+my $delegations = 100;		# dNNN.perf zones on ns1
+my $names = 50000;		# distinct names below them
+my $queries = 20000;		# lines per query file
+
+srand(20151019);
+
+sub writefile {
+	my ($file, @lines) = @_;
+
+	open(my $fh, ">", $file) or die "$file: $!\n";
+	print $fh @lines;
+	close($fh);
+}
+
+sub soa {
+	my ($ns) = @_;
+
+	return ("\$TTL 300\n",
+		"\@\tSOA\t$ns hostmaster 1 3600 600 86400 300\n");
+}
+
+# ns1: ".", "perf" delegating to dNNN.perf, and "slow" behind ans3.
+writefile("ns1/root.db", soa("a.root-servers.nil."),
+	  "\@\tNS\ta.root-servers.nil.\n",
+	  "a.root-servers.nil.\tA\t10.53.0.1\n",
+	  "perf.\tNS\tns.perf.\n",
+	  "ns.perf.\tA\t10.53.0.1\n",
+	  "slow.\tNS\tns.slow.\n",
+	  "ns.slow.\tA\t10.53.0.3\n");
+
+my @perf = (soa("ns"), "\@\tNS\tns\n", "ns\tA\t10.53.0.1\n");
+my @zones;
+for (my $i = 0; $i < $delegations; $i++) {
+	my $d = sprintf("d%03d", $i);
+	push(@perf, "$d\tNS\tns.$d\n", "ns.$d\tA\t10.53.0.1\n");
+	push(@zones, "zone \"$d.perf\" { type master; file \"leaf.db\"; };\n");
+}
+writefile("ns1/perf.db", @perf);
+writefile("ns1/zones.conf", @zones);
+
+# Each leaf zone answers any name with an address.
+writefile("ns1/leaf.db", soa("ns"),
+	  "\@\tNS\tns\n",
+	  "ns\tA\t10.53.0.1\n",
+	  "*\tA\t192.0.2.1\n",
+	  "*\tAAAA\t2001:db8::1\n");
+writefile("ns1/slow.db", soa("ns"),
+	  "\@\tNS\tns\n",
+	  "ns\tA\t10.53.0.3\n",
+	  "*\tA\t192.0.2.2\n");
+
+# ns2: auth.example.
+my @auth = (soa("ns"), "\@\tNS\tns\n", "\@\tMX\t10 mail\n",
+	    "ns\tA\t10.53.0.2\n", "mail\tA\t192.0.2.25\n",
+	    "www\tCNAME\thost00000\n");
+for (my $i = 0; $i < $hosts; $i++) {
+	my $h = sprintf("host%05d", $i);
+	push(@auth, sprintf("%s\tA\t10.%d.%d.%d\n", $h, $i >> 16,
+			    ($i >> 8) & 0xff, $i & 0xff));
+	push(@auth, sprintf("\tAAAA\t2001:db8::%x\n", $i)) if ($i % 4 == 0);
+	push(@auth, "\tTXT\t\"host $i\"\n") if ($i % 10 == 0);
+}
+writefile("ns2/auth.db", @auth);
+
+# Queries: authoritative, recursive, both, and through the slow server.
+sub authquery {
+	my $r = rand(100);
+
+	return (sprintf("host%05d.auth.example A\n", int(rand($hosts))))
+		if ($r < 75);
+	return (sprintf("host%05d.auth.example AAAA\n", int(rand($hosts))))
+		if ($r < 85);
+	return ("auth.example MX\n") if ($r < 88);
+	return ("www.auth.example A\n") if ($r < 90);
+	return (sprintf("nx%05d.auth.example A\n", int(rand($hosts))));
+}
+
+sub recquery {
+	my $n = int(rand($names));
+
+	return (sprintf("h%05d.d%03d.perf %s\n", $n, $n % $delegations,
+			rand(100) < 80 ? "A" : "AAAA"));
+}
+
+my (@a, @r, @m, @s);
+for (my $i = 0; $i < $queries; $i++) {
+	push(@a, authquery());
+	push(@r, recquery());
+	push(@m, ($i % 2) ? authquery() : recquery());
+	push(@s, sprintf("h%05d.slow A\n", int(rand($names))));
+}
+writefile("auth.queries", @a);
+writefile("recursive.queries", @r);
+writefile("mixed.queries", @m);
+writefile("lossy.queries", @s);
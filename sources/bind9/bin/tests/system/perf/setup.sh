@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+$SHELL clean.sh
+
+$PERL setup.pl
+
+cp ns2/named1.conf ns2/named.conf
+
+# Run the server under test without the debug logging of the other
+# system tests, with PERF_CPUS worker threads if set.
+echo "-c named.conf -g -U ${PERF_UDP:-4}${PERF_CPUS:+ -n $PERF_CPUS}" \
+	> ns2/named.args
+
+# How badly ans3 treats the queries it forwards to ns1.
+cat > ans3/lossy.conf <<EOC
+delay ${PERF_DELAY:-50}
+jitter ${PERF_JITTER:-20}
+loss ${PERF_LOSS:-10}
+EOC
@@ -0,0 +1,117 @@
+#!/bin/sh
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+#
+# Load ns2 with contrib/queryperf in open loop mode, once per scenario,
+# and record what it did in $PERF_REPORT:
+#
+#   auth       authoritative only (ns2/named1.conf)
+#   recursive  recursive only, the names being served by ns1
+#   mixed      both, half the queries each (ns2/named3.conf)
+#   lossy      recursive, the names being behind the slow and lossy ans3
+#
+# ns2 is restarted for each scenario, so that every one starts with an
+# empty cache and its own CPU time and memory.
+#
+
+scenarios=${PERF_SCENARIOS:-"auth recursive mixed lossy"}
+qps=${PERF_QPS:-10000}
+slowqps=${PERF_SLOWQPS:-500}
+seconds=${PERF_TIME:-10}
+threads=${PERF_THREADS:-2}
+report=${PERF_REPORT:-report.txt}
+hz=`getconf CLK_TCK`
+
+status=0
+
+# user + system time of a process, in clock ticks
+cputicks () {
+	awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+# the value of a queryperf statistic
+qpstat () {
+	sed -n "s/^  $2: *\([0-9.]*\).*/\1/p" $1 | head -1
+}
+
+{
+	echo "# `$NAMED -v` on `uname -n` (`uname -sr`), `date`"
+	echo "# $seconds seconds per scenario, $threads load threads," \
+	     "ans3: `tr '\n' ' ' < ans3/lossy.conf`"
+	printf "# scenario\ttarget\tqps\tlost%%\tservfail%%\tp50ms\tp90ms"
+	printf "\tp99ms\tp99.9ms\tcpu-us/q\trss-kb\tpeak-kb\n"
+} > $report
+
+for scenario in $scenarios
+do
+	case $scenario in
+	auth)		conf=named1.conf target=$qps ;;
+	recursive)	conf=named2.conf target=$qps ;;
+	mixed)		conf=named3.conf target=$qps ;;
+	lossy)		conf=named2.conf target=$slowqps ;;
+	*)		echo "I:unknown scenario $scenario"; status=1; continue ;;
+	esac
+
+	echo "I:scenario $scenario: $target qps for $seconds seconds"
+	$PERL $SYSTEMTESTTOP/stop.pl . ns2
+	cp ns2/$conf ns2/named.conf
+	$PERL $SYSTEMTESTTOP/start.pl --noclean --restart . ns2 || {
+		echo "I:ns2 failed to start"
+		status=1
+		break
+	}
+	pid=`cat ns2/named.pid`
+
+	out=queryperf.$scenario.out
+	before=`cputicks $pid`
+	$QUERYPERF -s 10.53.0.2 -p 5300 -d $scenario.queries -c \
+		-T $target -P $threads -l $seconds > $out 2>&1 || {
+		echo "I:queryperf failed:"
+		sed 's/^/I:  /' $out
+		status=1
+		continue
+	}
+	after=`cputicks $pid`
+	rss=`awk '/^VmRSS:/ { print $2 }' /proc/$pid/status`
+	peak=`awk '/^VmHWM:/ { print $2 }' /proc/$pid/status`
+
+	completed=`qpstat $out "Queries completed"`
+	sent=`qpstat $out "Queries sent"`
+	servfail=`qpstat $out "Returned SERVFAIL"`
+	echo "$scenario $target `qpstat $out "Queries per second"`" \
+	     "`qpstat $out "Percentage lost"` ${servfail:-0} $sent" \
+	     "`qpstat $out "RTT 50%ile"` `qpstat $out "RTT 90%ile"`" \
+	     "`qpstat $out "RTT 99%ile"` `qpstat $out "RTT 99.9%ile"`" \
+	     "$before $after $completed $rss $peak" |
+	awk -v hz=$hz '{
+		printf("%s\t%d\t%.0f\t%.2f\t%.2f\t%.3f\t%.3f\t%.3f\t%.3f" \
+		       "\t%.1f\t%d\t%d\n", $1, $2, $3, $4,
+		       $6 ? 100 * $5 / $6 : 0, $7 * 1000, $8 * 1000,
+		       $9 * 1000, $10 * 1000,
+		       $13 ? ($12 - $11) * 1000000 / hz / $13 : 0,
+		       $14, $15)
+	}' >> $report
+	tail -1 $report | sed 's/^/I:/'
+done
+
+echo "I:report in $report:"
+sed 's/^/I:/' $report
+
+echo "I:exit status: $status"
+exit $status
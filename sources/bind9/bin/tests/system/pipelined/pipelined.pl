@@ -0,0 +1,70 @@
+#!/usr/bin/perl
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+# Close a pipelined TCP connection while the server has fewer clients
+# accepting connections than it wants.
+#
+# The server is configured with "tcp-clients 1".  The first connection
+# sends a query that recurses to a forwarder that never answers, so the
+# client answering it stays busy while another client reads the next
+# query on the connection.  The second connection then exceeds the
+# quota, leaving no client accepting connections, and closing the first
+# connection makes its reader give up.  A reader has no listening socket
+# to accept on and must simply go away.
+#
+# Usage: pipelined.pl [-a <address>] [-p <port>]
+
+require 5.006_001;
+
+use strict;
+use Getopt::Std;
+use IO::Socket;
+
+my %options={};
+getopts("a:p:", \%options);
+
+my $addr = "10.53.0.1";
+$addr = $options{a} if defined $options{a};
+
+my $port = 5300;
+$port = $options{p} if defined $options{p};
+
+sub connection {
+    my $sock = IO::Socket::INET->new(PeerAddr => $addr, PeerPort => $port,
+				     Proto => "tcp") or die "$!";
+    print "connected\n";
+    return $sock;
+}
+
+# A recursive query for hang.test/A/IN.
+my $query = pack("H*", "2c9a01000001000000000000" .
+		       "0468616e670474657374000001" . "0001");
+
+my $first = connection();
+$first->syswrite(pack("n", length $query), 2);
+$first->syswrite($query, length $query);
+print "sent query\n";
+sleep 1;
+
+my $second = connection();
+sleep 1;
+
+$first->close;
+print "closed first connection\n";
+sleep 1;
+
+$second->close;
+print "closed second connection\n";
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+status=0
+
+echo "I:closing a pipelined connection with no client accepting"
+$PERL pipelined.pl -a 10.53.0.1 -p 5300 > pipelined.out || status=1
+
+echo "I:checking the server still answers over TCP"
+$DIG +tcp +norec a.example. @10.53.0.1 a -p 5300 > dig.out.tcp || status=1
+grep "status: NOERROR" dig.out.tcp > /dev/null || status=1
+grep "10.0.0.1" dig.out.tcp > /dev/null || status=1
+
+echo "I:checking the server still answers over UDP"
+$DIG +norec a.example. @10.53.0.1 a -p 5300 > dig.out.udp || status=1
+grep "status: NOERROR" dig.out.udp > /dev/null || status=1
+grep "10.0.0.1" dig.out.udp > /dev/null || status=1
+
+echo "I:exit status: $status"
+exit $status
@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+DIGOPTS="+tcp +norec +noadd +nosea +nostat +nocmd +noquest -p 5300"
+RNDCCMD="$RNDC -s 10.53.0.2 -p 9953 -c ../common/rndc.conf"
+
+status=0
+n=0
+
+# wait_configured count: wait until the index has been worked through
+# 'count' times since the server started.
+wait_configured () {
+	for i in 1 2 3 4 5 6 7 8 9 10
+	do
+		c=`grep "zone index 'zones.idx': .* zones configured" \
+			ns2/named.run | wc -l`
+		[ $c -ge $1 ] && return 0
+		sleep 1
+	done
+	return 1
+}
+
+# check_www zone address: the zone answers www with 'address'.
+check_www () {
+	$DIG $DIGOPTS www.$1 a @10.53.0.2 > dig.out.$1.$n || return 1
+	grep "status: NOERROR" dig.out.$1.$n > /dev/null || return 1
+	grep "^www.$1.	.*A	$2\$" dig.out.$1.$n > /dev/null || return 1
+}
+
+# check_refused zone: the zone is not served.
+check_refused () {
+	$DIG $DIGOPTS www.$1 a @10.53.0.2 > dig.out.$1.$n || return 1
+	grep "status: REFUSED" dig.out.$1.$n > /dev/null || return 1
+}
+
+n=`expr $n + 1`
+echo "I:checking zones are loaded from the index ($n)"
+ret=0
+wait_configured 1 || ret=1
+grep "3 zones configured (0 reused, 0 failed)" ns2/named.run > /dev/null ||
+	ret=1
+for z in a.example b.example c.example
+do
+	check_www $z 10.0.0.1 || ret=1
+done
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:changing the index and reconfiguring"
+cp -f ns2/example2.db ns2/example.db
+cp -f ns2/zones2.idx ns2/zones.idx
+$RNDCCMD reconfig 2>&1 | sed 's/^/I:ns2 /'
+
+n=`expr $n + 1`
+echo "I:checking the unchanged zone is reused ($n)"
+ret=0
+wait_configured 2 || ret=1
+grep "3 zones configured (1 reused, 0 failed)" ns2/named.run > /dev/null ||
+	ret=1
+# a.example was not reloaded, so it still has the old contents.
+check_www a.example 10.0.0.1 || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking zones are added, changed and removed ($n)"
+ret=0
+check_www c.example 10.0.0.2 || ret=1
+check_www d.example 10.0.0.2 || ret=1
+check_refused b.example || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking a malformed index is rejected ($n)"
+ret=0
+cp -f ns2/zones3.idx ns2/zones.idx
+$RNDCCMD reconfig 2>&1 | sed 's/^/I:ns2 /'
+grep "zones.idx:[0-9]*: expected a zone name and a file name" \
+	ns2/named.run > /dev/null || ret=1
+grep "reloading configuration failed: unexpected token" \
+	ns2/named.run > /dev/null || ret=1
+# The previous configuration stays in service.
+check_www a.example 10.0.0.1 || ret=1
+check_www c.example 10.0.0.2 || ret=1
+check_www d.example 10.0.0.2 || ret=1
+check_refused e.example || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:exit status: $status"
+exit $status
@@ -29,9 +29,11 @@
 #include <isc/app.h>
 #include <isc/commandline.h>
 #include <isc/mem.h>
+#include <isc/sockaddr.h>
 #include <isc/socket.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
@@ -78,7 +80,8 @@ isc_sockaddr_t addr;
 static void
 usage(void) {
 	fprintf(stderr,
-		"usage: zone_test [-dqsSM] [-c class] [-f file] zone\n");
+		"usage: zone_test [-dqsSM] [-B count] [-c class] [-f file] "
+		"zone\n");
 	exit(1);
 }
 
@@ -135,6 +138,96 @@ setup(const char *zonename, const char *filename, const char *classname) {
 	ERRRET(result, "dns_zonemgr_managezone");
 }
 
+/*
+ * Create 'count' zones below 'zonename', configured the way named
+ * configures them by default, and report the memory used per zone.
+ */
+static void
+bench(const char *zonename, const char *classname, unsigned int count) {
+	isc_result_t result;
+	dns_rdataclass_t rdclass;
+	isc_textregion_t region;
+	isc_buffer_t buffer;
+	isc_sockaddr_t any, any6;
+	isc_time_t start, finish;
+	dns_fixedname_t fixorigin;
+	dns_zone_t **zones;
+	size_t before, after;
+	const char *rbt = "rbt";
+	char name[DNS_NAME_FORMATSIZE + 32];
+	unsigned int i;
+
+	DE_CONST(classname, region.base);
+	region.length = strlen(classname);
+	result = dns_rdataclass_fromtext(&rdclass, &region);
+	ERRRET(result, "dns_rdataclass_fromtext");
+
+	result = dns_zonemgr_setsize(zonemgr, count);
+	ERRRET(result, "dns_zonemgr_setsize");
+
+	zones = isc_mem_get(mctx, count * sizeof(*zones));
+	if (zones == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return;
+	}
+	memset(zones, 0, count * sizeof(*zones));
+	isc_sockaddr_any(&any);
+	isc_sockaddr_any6(&any6);
+	dns_fixedname_init(&fixorigin);
+
+	before = isc_mem_inuse(mctx);
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (i = 0; i < count; i++) {
+		snprintf(name, sizeof(name), "z%u.%s", i, zonename);
+		isc_buffer_constinit(&buffer, name, strlen(name));
+		isc_buffer_add(&buffer, strlen(name));
+		result = dns_name_fromtext(dns_fixedname_name(&fixorigin),
+					   &buffer, dns_rootname, 0, NULL);
+		if (result != ISC_R_SUCCESS)
+			break;
+		result = dns_zone_create(&zones[i], mctx);
+		if (result != ISC_R_SUCCESS)
+			break;
+		dns_zone_settype(zones[i], zonetype);
+		dns_zone_setclass(zones[i], rdclass);
+		result = dns_zone_setorigin(zones[i],
+					    dns_fixedname_name(&fixorigin));
+		if (result == ISC_R_SUCCESS)
+			result = dns_zone_setdbtype(zones[i], 1, &rbt);
+		if (result == ISC_R_SUCCESS)
+			result = dns_zone_setfile(zones[i], name);
+		if (result == ISC_R_SUCCESS)
+			result = dns_zone_setnotifysrc4(zones[i], &any);
+		if (result == ISC_R_SUCCESS)
+			result = dns_zone_setnotifysrc6(zones[i], &any6);
+		if (result == ISC_R_SUCCESS)
+			result = dns_zone_setxfrsource4(zones[i], &any);
+		if (result == ISC_R_SUCCESS)
+			result = dns_zone_setxfrsource6(zones[i], &any6);
+		if (result == ISC_R_SUCCESS && zonetype == dns_zone_slave)
+			result = dns_zone_setmasters(zones[i], &addr, 1);
+		if (result == ISC_R_SUCCESS)
+			result = dns_zonemgr_managezone(zonemgr, zones[i]);
+		if (result != ISC_R_SUCCESS)
+			break;
+	}
+	RUNTIME_CHECK(isc_time_now(&finish) == ISC_R_SUCCESS);
+	after = isc_mem_inuse(mctx);
+
+	if (result != ISC_R_SUCCESS)
+		fprintf(stderr, "zone %u: %s\n", i, isc_result_totext(result));
+	else if (count > 0)
+		printf("%u zones: %lu bytes per zone, %lu us per zone\n",
+		       count, (unsigned long)((after - before) / count),
+		       (unsigned long)(isc_time_microdiff(&finish, &start) /
+				       count));
+
+	for (i = 0; i < count; i++)
+		if (zones[i] != NULL)
+			dns_zone_detach(&zones[i]);
+	isc_mem_put(mctx, zones, count * sizeof(*zones));
+}
+
 static void
 print_rdataset(dns_name_t *name, dns_rdataset_t *rdataset) {
 	isc_buffer_t text;
@@ -244,9 +337,13 @@ main(int argc, char **argv) {
 	int c;
 	char *filename = NULL;
 	const char *classname = "IN";
+	unsigned int count = 0;
 
-	while ((c = isc_commandline_parse(argc, argv, "cdf:m:qsMS")) != EOF) {
+	while ((c = isc_commandline_parse(argc, argv, "B:cdf:m:qsMS")) != EOF) {
 		switch (c) {
+		case 'B':
+			count = atoi(isc_commandline_argument);
+			break;
 		case 'c':
 			classname = isc_commandline_argument;
 			break;
@@ -297,10 +394,14 @@ main(int argc, char **argv) {
 	RUNTIME_CHECK(isc_socketmgr_create(mctx, &socketmgr) == ISC_R_SUCCESS);
 	RUNTIME_CHECK(dns_zonemgr_create(mctx, taskmgr, timermgr, socketmgr,
 					 &zonemgr) == ISC_R_SUCCESS);
-	if (filename == NULL)
-		filename = argv[isc_commandline_index];
-	setup(argv[isc_commandline_index], filename, classname);
-	query();
+	if (count > 0) {
+		bench(argv[isc_commandline_index], classname, count);
+	} else {
+		if (filename == NULL)
+			filename = argv[isc_commandline_index];
+		setup(argv[isc_commandline_index], filename, classname);
+		query();
+	}
 	if (zone != NULL)
 		dns_zone_detach(&zone);
 	dns_zonemgr_shutdown(zonemgr);
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file
+ * Print the DNS messages captured by named ("capture-output") from
+ * capture files, or from a Unix domain socket named connects to.
+ */
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef ISC_PLATFORM_HAVESYSUNH
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/print.h>
+#include <isc/sockaddr.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/capture.h>
+#include <dns/masterdump.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rdataset.h>
+#include <dns/rdatatype.h>
+#include <dns/result.h>
+
+#define MAXFRAME	(DNS_CAPTURE_FRAMEHEADER + 65535)
+
+static isc_mem_t *mctx = NULL;
+static isc_boolean_t printmessage = ISC_FALSE;
+
+static void
+usage(const char *program) {
+	fprintf(stderr, "usage: %s [-p] file ...\n"
+			"       %s [-p] -u socket\n", program, program);
+	exit(1);
+}
+
+static isc_boolean_t
+getaddr(isc_buffer_t *b, unsigned int family, char *text, size_t size) {
+	isc_netaddr_t na;
+	isc_sockaddr_t sa;
+	struct in_addr in;
+	struct in6_addr in6;
+	unsigned int port;
+
+	if (isc_buffer_remaininglength(b) < 2)
+		return (ISC_FALSE);
+	port = isc_buffer_getuint16(b);
+	switch (family) {
+	case 4:
+		if (isc_buffer_remaininglength(b) < 4)
+			return (ISC_FALSE);
+		memmove(&in, isc_buffer_current(b), 4);
+		isc_buffer_forward(b, 4);
+		isc_netaddr_fromin(&na, &in);
+		break;
+	case 6:
+		if (isc_buffer_remaininglength(b) < 16)
+			return (ISC_FALSE);
+		memmove(&in6, isc_buffer_current(b), 16);
+		isc_buffer_forward(b, 16);
+		isc_netaddr_fromin6(&na, &in6);
+		break;
+	default:
+		strlcpy(text, "?", size);
+		return (ISC_TRUE);
+	}
+	isc_sockaddr_fromnetaddr(&sa, &na, port);
+	isc_sockaddr_format(&sa, text, size);
+	return (ISC_TRUE);
+}
+
+/*
+ * Print the question, and the rcode of a response, of the message in
+ * 'r'; with -p, print the whole message after it.
+ */
+static void
+printquestion(isc_region_t *r, isc_boolean_t response) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char classbuf[DNS_RDATACLASS_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	char rcodebuf[64];
+	dns_message_t *message = NULL;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset;
+	isc_buffer_t source, target, *text = NULL;
+	isc_result_t result;
+	unsigned int size;
+
+	RUNTIME_CHECK(dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE,
+					 &message) == ISC_R_SUCCESS);
+	isc_buffer_init(&source, r->base, r->length);
+	isc_buffer_add(&source, r->length);
+	result = dns_message_parse(message, &source, DNS_MESSAGEPARSE_BESTEFFORT);
+	if (result != ISC_R_SUCCESS && result != DNS_R_RECOVERABLE) {
+		printf(" (%s)\n", isc_result_totext(result));
+		goto cleanup;
+	}
+
+	if (dns_message_firstname(message, DNS_SECTION_QUESTION) ==
+	    ISC_R_SUCCESS) {
+		dns_message_currentname(message, DNS_SECTION_QUESTION, &name);
+		rdataset = ISC_LIST_HEAD(name->list);
+		dns_name_format(name, namebuf, sizeof(namebuf));
+		if (rdataset != NULL) {
+			dns_rdataclass_format(rdataset->rdclass, classbuf,
+					      sizeof(classbuf));
+			dns_rdatatype_format(rdataset->type, typebuf,
+					     sizeof(typebuf));
+			printf(" %s/%s/%s", namebuf, classbuf, typebuf);
+		} else
+			printf(" %s", namebuf);
+	}
+	if (response) {
+		isc_buffer_init(&target, rcodebuf, sizeof(rcodebuf) - 1);
+		if (dns_rcode_totext(message->rcode, &target) ==
+		    ISC_R_SUCCESS) {
+			rcodebuf[isc_buffer_usedlength(&target)] = '\0';
+			printf(" %s", rcodebuf);
+		}
+	}
+	printf("\n");
+
+	if (printmessage) {
+		for (size = 4096; ; size *= 2) {
+			RUNTIME_CHECK(isc_buffer_allocate(mctx, &text, size)
+				      == ISC_R_SUCCESS);
+			result = dns_message_totext(message,
+						    &dns_master_style_debug,
+						    0, text);
+			if (result != ISC_R_NOSPACE)
+				break;
+			isc_buffer_free(&text);
+		}
+		if (result == ISC_R_SUCCESS)
+			printf("%.*s", (int)isc_buffer_usedlength(text),
+			       (char *)isc_buffer_base(text));
+		isc_buffer_free(&text);
+	}
+
+ cleanup:
+	dns_message_destroy(&message);
+}
+
+static isc_boolean_t
+printframe(isc_buffer_t *b) {
+	static const char *types[] = { "??", "CQ", "CR", "??", "RQ",
+				       "??", "??", "??", "RR" };
+	char timebuf[64];
+	char qbuf[ISC_SOCKADDR_FORMATSIZE];
+	char rbuf[ISC_SOCKADDR_FORMATSIZE];
+	isc_region_t r;
+	isc_time_t when;
+	isc_uint32_t seconds, usec;
+	unsigned int type, flags, family;
+
+	if (isc_buffer_remaininglength(b) < 12)
+		return (ISC_FALSE);
+	type = isc_buffer_getuint8(b);
+	flags = isc_buffer_getuint8(b);
+	family = isc_buffer_getuint8(b);
+	(void)isc_buffer_getuint8(b);
+	seconds = isc_buffer_getuint32(b);
+	usec = isc_buffer_getuint32(b);
+	if (!getaddr(b, family, qbuf, sizeof(qbuf)) ||
+	    !getaddr(b, family, rbuf, sizeof(rbuf)))
+		return (ISC_FALSE);
+	isc_buffer_remainingregion(b, &r);
+
+	isc_time_set(&when, seconds, usec * 1000);
+	isc_time_formattimestamp(&when, timebuf, sizeof(timebuf));
+	printf("%s %s %s %s %s %s %ub", timebuf,
+	       type < sizeof(types) / sizeof(types[0]) ? types[type] : "??",
+	       qbuf,
+	       (type & DNS_CAPTURE_QUERY) != 0 ? "->" : "<-",
+	       rbuf, (flags & DNS_CAPTURE_F_TCP) != 0 ? "TCP" : "UDP",
+	       r.length);
+	printquestion(&r, ISC_TF((type & DNS_CAPTURE_RESPONSE) != 0));
+	return (ISC_TRUE);
+}
+
+/*
+ * Print a capture stream: a header followed by frames.
+ */
+static int
+printstream(FILE *fp, const char *name) {
+	unsigned char header[DNS_CAPTURE_HEADERLEN];
+	unsigned char *frame;
+	isc_buffer_t b;
+	unsigned int len;
+	unsigned long count = 0;
+	int ret = 0;
+
+	if (fread(header, sizeof(header), 1, fp) != 1 ||
+	    memcmp(header, DNS_CAPTURE_MAGIC, 8) != 0) {
+		fprintf(stderr, "%s: not a message capture\n", name);
+		return (1);
+	}
+	if (header[8] != 0 || header[9] != DNS_CAPTURE_VERSION) {
+		fprintf(stderr, "%s: unsupported capture version %u\n",
+			name, (header[8] << 8) | header[9]);
+		return (1);
+	}
+
+	frame = isc_mem_get(mctx, MAXFRAME);
+	RUNTIME_CHECK(frame != NULL);
+	while (fread(frame, 4, 1, fp) == 1) {
+		len = (frame[0] << 24) | (frame[1] << 16) |
+		      (frame[2] << 8) | frame[3];
+		if (len < 4 || len > MAXFRAME ||
+		    fread(frame + 4, len - 4, 1, fp) != 1) {
+			fprintf(stderr, "%s: truncated frame after %lu "
+				"frames\n", name, count);
+			ret = 1;
+			break;
+		}
+		isc_buffer_init(&b, frame, len);
+		isc_buffer_add(&b, len);
+		isc_buffer_forward(&b, 4);
+		if (!printframe(&b)) {
+			fprintf(stderr, "%s: malformed frame after %lu "
+				"frames\n", name, count);
+			ret = 1;
+			break;
+		}
+		count++;
+		fflush(stdout);
+	}
+	isc_mem_put(mctx, frame, MAXFRAME);
+	return (ret);
+}
+
+/*
+ * Listen on 'path' and print whatever named sends, one connection
+ * after another.
+ */
+static int
+listensocket(const char *path) {
+#ifdef ISC_PLATFORM_HAVESYSUNH
+	struct sockaddr_un addr;
+	FILE *fp;
+	int fd, conn;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: socket name too long\n", path);
+		return (1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+	(void)unlink(path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1 ||
+	    bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+	    listen(fd, 1) == -1) {
+		perror(path);
+		return (1);
+	}
+	for (;;) {
+		conn = accept(fd, NULL, NULL);
+		if (conn == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			break;
+		}
+		fp = fdopen(conn, "rb");
+		if (fp == NULL) {
+			(void)close(conn);
+			continue;
+		}
+		(void)printstream(fp, path);
+		fclose(fp);
+	}
+	(void)close(fd);
+	return (1);
+#else
+	fprintf(stderr, "%s: Unix domain sockets are not supported\n", path);
+	return (1);
+#endif
+}
+
+int
+main(int argc, char **argv) {
+	const char *socketpath = NULL;
+	FILE *fp;
+	int ch, i, ret = 0;
+
+	while ((ch = isc_commandline_parse(argc, argv, "pu:")) != -1) {
+		switch (ch) {
+		case 'p':
+			printmessage = ISC_TRUE;
+			break;
+		case 'u':
+			socketpath = isc_commandline_argument;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+	if ((socketpath == NULL) == (argc == 0))
+		usage(argv[-isc_commandline_index]);
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	dns_result_register();
+
+	if (socketpath != NULL)
+		ret = listensocket(socketpath);
+	for (i = 0; i < argc; i++) {
+		fp = fopen(argv[i], "rb");
+		if (fp == NULL) {
+			perror(argv[i]);
+			ret = 1;
+			continue;
+		}
+		if (printstream(fp, argv[i]) != 0)
+			ret = 1;
+		fclose(fp);
+	}
+
+	isc_mem_destroy(&mctx);
+	return (ret);
+}
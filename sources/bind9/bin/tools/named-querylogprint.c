@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file
+ * Print a binary query log written by named ("querylog-file") as the
+ * text lines the "queries" logging category would have had.
+ */
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/netaddr.h>
+#include <isc/print.h>
+#include <isc/sockaddr.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+
+#include <named/querylog.h>
+
+static isc_boolean_t
+getaddr(isc_buffer_t *b, isc_netaddr_t *na, unsigned int family) {
+	struct in_addr in;
+	struct in6_addr in6;
+
+	switch (family) {
+	case 4:
+		if (isc_buffer_remaininglength(b) < 4)
+			return (ISC_FALSE);
+		memmove(&in, isc_buffer_current(b), 4);
+		isc_buffer_forward(b, 4);
+		isc_netaddr_fromin(na, &in);
+		return (ISC_TRUE);
+	case 6:
+		if (isc_buffer_remaininglength(b) < 16)
+			return (ISC_FALSE);
+		memmove(&in6, isc_buffer_current(b), 16);
+		isc_buffer_forward(b, 16);
+		isc_netaddr_fromin6(na, &in6);
+		return (ISC_TRUE);
+	case 0:
+		memset(na, 0, sizeof(*na));
+		return (ISC_TRUE);
+	default:
+		return (ISC_FALSE);
+	}
+}
+
+/*
+ * Format the length-prefixed wire name at the current position of 'b',
+ * or the empty string if the length is zero.
+ */
+static isc_boolean_t
+getname(isc_buffer_t *b, char *text, size_t size) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_decompress_t dctx;
+	isc_buffer_t source;
+	isc_result_t result;
+	unsigned int len;
+
+	if (isc_buffer_remaininglength(b) < 1)
+		return (ISC_FALSE);
+	len = isc_buffer_getuint8(b);
+	if (isc_buffer_remaininglength(b) < len)
+		return (ISC_FALSE);
+	text[0] = '\0';
+	if (len == 0)
+		return (ISC_TRUE);
+
+	isc_buffer_init(&source, isc_buffer_current(b), len);
+	isc_buffer_add(&source, len);
+	isc_buffer_setactive(&source, len);
+	isc_buffer_forward(b, len);
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
+	result = dns_name_fromwire(name, &source, &dctx, 0, NULL);
+	dns_decompress_invalidate(&dctx);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+	dns_name_format(name, text, size);
+	return (ISC_TRUE);
+}
+
+static isc_boolean_t
+printrecord(isc_buffer_t *b) {
+	char timebuf[64];
+	char peerbuf[ISC_SOCKADDR_FORMATSIZE];
+	char destbuf[ISC_NETADDR_FORMATSIZE];
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char signerbuf[DNS_NAME_FORMATSIZE];
+	char classbuf[DNS_RDATACLASS_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	char viewbuf[256];
+	isc_netaddr_t peer, dest;
+	isc_sockaddr_t peeraddr;
+	isc_time_t when;
+	isc_uint32_t seconds, usec;
+	unsigned int flags, peerfamily, destfamily, port, viewlen;
+	dns_rdataclass_t rdclass;
+	dns_rdatatype_t type;
+
+	if (isc_buffer_remaininglength(b) < 14)
+		return (ISC_FALSE);
+	seconds = isc_buffer_getuint32(b);
+	usec = isc_buffer_getuint32(b);
+	flags = isc_buffer_getuint8(b);
+	peerfamily = isc_buffer_getuint8(b);
+	port = isc_buffer_getuint16(b);
+	if (!getaddr(b, &peer, peerfamily))
+		return (ISC_FALSE);
+	if (isc_buffer_remaininglength(b) < 1)
+		return (ISC_FALSE);
+	destfamily = isc_buffer_getuint8(b);
+	if (!getaddr(b, &dest, destfamily))
+		return (ISC_FALSE);
+	if (isc_buffer_remaininglength(b) < 4)
+		return (ISC_FALSE);
+	rdclass = isc_buffer_getuint16(b);
+	type = isc_buffer_getuint16(b);
+	if (!getname(b, namebuf, sizeof(namebuf)))
+		return (ISC_FALSE);
+	if (isc_buffer_remaininglength(b) < 1)
+		return (ISC_FALSE);
+	viewlen = isc_buffer_getuint8(b);
+	if (isc_buffer_remaininglength(b) < viewlen)
+		return (ISC_FALSE);
+	memmove(viewbuf, isc_buffer_current(b), viewlen);
+	viewbuf[viewlen] = '\0';
+	isc_buffer_forward(b, viewlen);
+	if (!getname(b, signerbuf, sizeof(signerbuf)))
+		return (ISC_FALSE);
+
+	isc_time_set(&when, seconds, usec * 1000);
+	isc_time_formattimestamp(&when, timebuf, sizeof(timebuf));
+	if (peerfamily != 0) {
+		isc_sockaddr_fromnetaddr(&peeraddr, &peer, port);
+		isc_sockaddr_format(&peeraddr, peerbuf, sizeof(peerbuf));
+	} else
+		strlcpy(peerbuf, "?", sizeof(peerbuf));
+	if (destfamily != 0)
+		isc_netaddr_format(&dest, destbuf, sizeof(destbuf));
+	else
+		strlcpy(destbuf, "?", sizeof(destbuf));
+	dns_rdataclass_format(rdclass, classbuf, sizeof(classbuf));
+	dns_rdatatype_format(type, typebuf, sizeof(typebuf));
+
+	printf("%s client %s%s%s (%s)%s%s: query: %s %s %s %s%s%s%s%s%s (%s)\n",
+	       timebuf, peerbuf,
+	       signerbuf[0] != '\0' ? "/key " : "", signerbuf,
+	       namebuf,
+	       (viewlen != 0 && strcmp(viewbuf, "_default") != 0 &&
+		strcmp(viewbuf, "_bind") != 0) ? ": view " : "",
+	       (viewlen != 0 && strcmp(viewbuf, "_default") != 0 &&
+		strcmp(viewbuf, "_bind") != 0) ? viewbuf : "",
+	       namebuf, classbuf, typebuf,
+	       (flags & NS_QUERYLOG_F_RECURSE) != 0 ? "+" : "-",
+	       (flags & NS_QUERYLOG_F_SIGNED) != 0 ? "S" : "",
+	       (flags & NS_QUERYLOG_F_EDNS) != 0 ? "E" : "",
+	       (flags & NS_QUERYLOG_F_TCP) != 0 ? "T" : "",
+	       (flags & NS_QUERYLOG_F_DO) != 0 ? "D" : "",
+	       (flags & NS_QUERYLOG_F_CD) != 0 ? "C" : "",
+	       destbuf);
+	return (ISC_TRUE);
+}
+
+static int
+printfile(const char *file) {
+	unsigned char header[NS_QUERYLOG_HEADERLEN];
+	unsigned char record[NS_QUERYLOG_MAXRECORD];
+	isc_buffer_t b;
+	unsigned int len;
+	unsigned long count = 0;
+	FILE *fp;
+	int ret = 0;
+
+	fp = fopen(file, "rb");
+	if (fp == NULL) {
+		perror(file);
+		return (1);
+	}
+	if (fread(header, sizeof(header), 1, fp) != 1 ||
+	    memcmp(header, NS_QUERYLOG_MAGIC, 8) != 0) {
+		fprintf(stderr, "%s: not a query log\n", file);
+		fclose(fp);
+		return (1);
+	}
+	if (header[8] != 0 || header[9] != NS_QUERYLOG_VERSION) {
+		fprintf(stderr, "%s: unsupported query log version %u\n",
+			file, (header[8] << 8) | header[9]);
+		fclose(fp);
+		return (1);
+	}
+
+	while (fread(record, 2, 1, fp) == 1) {
+		len = (record[0] << 8) | record[1];
+		if (len < 2 || len > sizeof(record) ||
+		    fread(record + 2, len - 2, 1, fp) != 1) {
+			fprintf(stderr, "%s: truncated record after %lu "
+				"records\n", file, count);
+			ret = 1;
+			break;
+		}
+		isc_buffer_init(&b, record, len);
+		isc_buffer_add(&b, len);
+		isc_buffer_forward(&b, 2);
+		if (!printrecord(&b)) {
+			fprintf(stderr, "%s: malformed record after %lu "
+				"records\n", file, count);
+			ret = 1;
+			break;
+		}
+		count++;
+	}
+	fclose(fp);
+	return (ret);
+}
+
+int
+main(int argc, char **argv) {
+	int i, ret = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s querylog ...\n", argv[0]);
+		return (1);
+	}
+
+	for (i = 1; i < argc; i++)
+		if (printfile(argv[i]) != 0)
+			ret = 1;
+	return (ret);
+}
@@ -61,6 +61,13 @@
  *   from not blocking connect()) are printed. When an error is
  *   related to a local limit (e.g., EMFILE, EADDRNOTAVAIL or the
  *   internal ENOMEM) the locallimit counter is incremented.
+ *
+ * Replay (-C<capture-file>):
+ *  - the queries sent to port 53 in a pcap file are read at startup,
+ *   each one is sent on its own connection (so from its own port)
+ *   at its captured time relative to the first one, divided by the
+ *   -F<speed> factor, in place of the -r<rate> schedule.
+ *  - the RTT and rcodes are also reported per query type.
  */
 
 #ifdef __linux__
@@ -193,6 +200,7 @@ struct exchange {				/* per exchange structure */
 #define X_SENT	3
 	int state;				/* state */
 	uint16_t id;				/* ID */
+	int query;				/* captured query (replay) */
 	uint64_t order;				/* number of this exchange */
 	struct timespec ts0, ts1, ts2, ts3;	/* timespecs */
 };
@@ -223,6 +231,17 @@ double dmax = 0.;				/* maximum delay */
 double dsum = 0.;				/* delay sum */
 double dsumsq = 0.;				/* square delay sum */
 
+/*
+ * per query type statistics (replay), the last one for types >= 256
+ */
+
+#define QT_OTHER	256
+struct qtstats {
+	uint64_t sent, rcvd;			/* counters */
+	uint64_t rcodes[NS_RCODE_LAST + 1];	/* rcode counters */
+	double dmin, dmax, dsum;		/* delays */
+} qtstats[QT_OTHER + 1];
+
 /*
  * command line parameters
  */
@@ -255,6 +274,8 @@ char *servername;			/* server */
 int ixann;				/* ixann NXDOMAIN */
 int udp;				/* use UDP in place of TCP */
 int minport, maxport, curport;		/* port range */
+char *capturefile;			/* capture file name */
+double speed = 1.;			/* replay speed factor */
 
 /*
  * global variables
@@ -289,6 +310,22 @@ size_t length_query;
 uint8_t template_query[4096];
 size_t random_query;
 
+/*
+ * captured queries (replay)
+ */
+
+struct captured {
+	uint8_t *msg;				/* the query */
+	uint16_t length;			/* its length */
+	uint16_t qlength;			/* header and question length */
+	uint16_t qtype;				/* query type */
+	double when;				/* time from the first one */
+};
+struct captured *captured;		/* captured query table */
+int ncaptured;				/* number of captured queries */
+int curcaptured;			/* next one to send */
+int replayed;				/* all were sent */
+
 /*
  * threads
  */
@@ -491,6 +528,249 @@ get_template_query(void)
 	}
 }
 
+/*
+ * get a 32 bit value from a pcap header (in the capture byte order)
+ */
+
+uint32_t
+get_capture32(const uint8_t *p, int bigendian)
+{
+	if (bigendian)
+		return ((uint32_t) p[0] << 24) | (p[1] << 16) |
+		       (p[2] << 8) | p[3];
+	return ((uint32_t) p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+/*
+ * add a captured DNS message when it is a query (with its time)
+ */
+
+void
+add_captured(const uint8_t *msg, size_t length, double when)
+{
+	static int allocated;
+	struct captured *c;
+	const uint8_t *p, *end;
+	uint16_t v;
+
+	/* a QUERY with a question */
+	if ((length < NS_OFF_QUESTION + 5) || (length > 4096))
+		return;
+	memcpy(&v, msg + NS_OFF_FLAGS, 2);
+	v = ntohs(v);
+	if ((v & (NS_FLAG_QR | NS_OPCODE_MASK)) != 0)
+		return;
+	memcpy(&v, msg + NS_OFF_QDCOUNT, 2);
+	if (v == 0)
+		return;
+	/* skip the qname */
+	p = msg + NS_OFF_QUESTION;
+	end = msg + length;
+	while ((p < end) && (*p != 0)) {
+		if ((*p & 0xc0) == 0xc0) {
+			p++;
+			break;
+		}
+		if ((*p & 0xc0) != 0)
+			return;
+		p += *p + 1;
+	}
+	p++;
+	if (p + 4 > end)
+		return;
+
+	if (ncaptured == allocated) {
+		allocated = (allocated == 0) ? 1024 : allocated * 2;
+		captured = (struct captured *)
+			realloc(captured, allocated * sizeof(*captured));
+		if (captured == NULL) {
+			perror("realloc(captured)");
+			exit(1);
+		}
+	}
+	c = captured + ncaptured;
+	c->msg = (uint8_t *) malloc(length);
+	if (c->msg == NULL) {
+		perror("malloc(captured)");
+		exit(1);
+	}
+	memcpy(c->msg, msg, length);
+	c->length = length;
+	c->qlength = p + 4 - msg;
+	c->qtype = (p[0] << 8) | p[1];
+	c->when = when;
+	ncaptured++;
+}
+
+/*
+ * read the queries to port 53 (UDP, or whole in a TCP segment)
+ * from the file given in the command line (-C<capture-file>)
+ */
+
+void
+get_capture(void)
+{
+	uint8_t hdr[24], *frame, *ip, *data;
+	uint32_t linktype, caplen, off, hlen, dlen, mlen, proto, etype;
+	double ts, first = -1., when = 0.;
+	int bigendian, nsec;
+	FILE *fp;
+
+	fp = fopen(capturefile, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "fopen(%s): %s\n",
+			capturefile, strerror(errno));
+		exit(2);
+	}
+	if (fread(hdr, sizeof(hdr), 1, fp) != 1) {
+		fprintf(stderr, "file '%s' too small\n", capturefile);
+		exit(2);
+	}
+	switch (get_capture32(hdr, 0)) {
+	case 0xa1b2c3d4:
+		bigendian = 0;
+		nsec = 0;
+		break;
+	case 0xa1b23c4d:
+		bigendian = 0;
+		nsec = 1;
+		break;
+	case 0xd4c3b2a1:
+		bigendian = 1;
+		nsec = 0;
+		break;
+	case 0x4d3cb2a1:
+		bigendian = 1;
+		nsec = 1;
+		break;
+	default:
+		fprintf(stderr, "file '%s' is not in pcap format\n",
+			capturefile);
+		exit(2);
+	}
+	linktype = get_capture32(hdr + 20, bigendian) & 0xffff;
+	switch (linktype) {
+	case 0:		/* BSD loopback */
+	case 108:	/* OpenBSD loopback */
+	case 1:		/* Ethernet */
+	case 113:	/* Linux cooked */
+	case 12:	/* raw IP */
+	case 14:
+	case 101:
+	case 228:	/* raw IPv4 */
+	case 229:	/* raw IPv6 */
+		break;
+	default:
+		fprintf(stderr, "file '%s' has unsupported link type %u\n",
+			capturefile, (unsigned int) linktype);
+		exit(2);
+	}
+	frame = (uint8_t *) malloc(262144);
+	if (frame == NULL) {
+		perror("malloc(frame)");
+		exit(1);
+	}
+
+	while (fread(hdr, 16, 1, fp) == 1) {
+		caplen = get_capture32(hdr + 8, bigendian);
+		if ((caplen > 262144) ||
+		    (fread(frame, 1, caplen, fp) != caplen)) {
+			fprintf(stderr, "file '%s' is truncated\n",
+				capturefile);
+			break;
+		}
+		ts = get_capture32(hdr, bigendian);
+		ts += get_capture32(hdr + 4, bigendian) / (nsec ? 1e9 : 1e6);
+		if (first < 0.)
+			first = ts;
+		/* keep the queries in order */
+		if (ts - first > when)
+			when = ts - first;
+
+		/* link layer */
+		switch (linktype) {
+		case 0:
+		case 108:
+			off = 4;
+			break;
+		case 1:
+			off = 14;
+			if (caplen < off)
+				continue;
+			etype = (frame[12] << 8) | frame[13];
+			while (((etype == 0x8100) || (etype == 0x88a8)) &&
+			       (caplen >= off + 4)) {
+				etype = (frame[off + 2] << 8) | frame[off + 3];
+				off += 4;
+			}
+			break;
+		case 113:
+			off = 16;
+			break;
+		default:
+			off = 0;
+			break;
+		}
+		if (caplen <= off)
+			continue;
+		ip = frame + off;
+		caplen -= off;
+
+		/* network layer: no fragments, no IPv6 extensions */
+		if (((ip[0] >> 4) == 4) && (caplen >= 20)) {
+			hlen = (ip[0] & 0xf) * 4;
+			dlen = (ip[2] << 8) | ip[3];
+			if ((hlen < 20) || (dlen < hlen) || (dlen > caplen))
+				continue;
+			if (((ip[6] & 0x3f) != 0) || (ip[7] != 0))
+				continue;
+			proto = ip[9];
+			data = ip + hlen;
+			dlen -= hlen;
+		} else if (((ip[0] >> 4) == 6) && (caplen >= 40)) {
+			dlen = (ip[4] << 8) | ip[5];
+			if (dlen + 40 > caplen)
+				continue;
+			proto = ip[6];
+			data = ip + 40;
+		} else
+			continue;
+
+		/* transport layer */
+		if ((proto == IPPROTO_UDP) && (dlen >= 8)) {
+			if (((data[2] << 8) | data[3]) != 53)
+				continue;
+			mlen = (data[4] << 8) | data[5];
+			if ((mlen < 8) || (mlen > dlen))
+				continue;
+			add_captured(data + 8, mlen - 8, when);
+		} else if ((proto == IPPROTO_TCP) && (dlen >= 20)) {
+			if (((data[2] << 8) | data[3]) != 53)
+				continue;
+			off = (data[12] >> 4) * 4;
+			if ((off < 20) || (off > dlen))
+				continue;
+			data += off;
+			dlen -= off;
+			while (dlen >= 2) {
+				mlen = (data[0] << 8) | data[1];
+				if (mlen + 2 > dlen)
+					break;
+				add_captured(data + 2, mlen, when);
+				data += mlen + 2;
+				dlen -= mlen + 2;
+			}
+		}
+	}
+	free(frame);
+	(void) fclose(fp);
+
+	if (ncaptured == 0) {
+		fprintf(stderr, "no query in '%s'\n", capturefile);
+		exit(2);
+	}
+}
+
 #if 0
 /*
  * randomize the value of the given field:
@@ -669,18 +949,26 @@ int
 sendquery(struct exchange *x)
 {
 	ssize_t ret;
-	size_t off;
+	size_t off, length;
+	uint8_t *query;
 
+	if (capturefile != NULL) {
+		query = captured[x->query].msg;
+		length = captured[x->query].length;
+	} else {
+		query = template_query;
+		length = length_query;
+	}
 	if (udp)
 		off = 0;
 	else {
 		off = 2;
 		/* message length */
-		obuf[0] = length_query >> 8;
-		obuf[1]= length_query & 0xff;
+		obuf[0] = length >> 8;
+		obuf[1]= length & 0xff;
 	}
-	/* message from template */
-	memcpy(obuf + off, template_query, length_query);
+	/* message from template (or capture) */
+	memcpy(obuf + off, query, length);
 	/* ID */
 	memcpy(obuf + off + NS_OFF_ID, &x->id, 2);
 #if 0
@@ -697,9 +985,13 @@ sendquery(struct exchange *x)
 		(void) pthread_kill(master, SIGTERM);
 		return -errno;
 	}
-	ret = send(x->sock, obuf, length_query + off, 0);
-	if ((size_t) ret == length_query + off)
+	ret = send(x->sock, obuf, length + off, 0);
+	if ((size_t) ret == length + off) {
+		if (capturefile != NULL)
+			qtstats[captured[x->query].qtype < QT_OTHER ?
+				captured[x->query].qtype : QT_OTHER].sent++;
 		return 0;
+	}
 	return -errno;
 }
 
@@ -777,8 +1069,9 @@ void
 receiveresp(struct exchange *x)
 {
 	struct timespec now;
+	struct qtstats *qt = NULL;
 	ssize_t cc;
-	size_t off;
+	size_t off, length;
 	uint16_t v;
 	double delta;
 
@@ -801,7 +1094,11 @@ receiveresp(struct exchange *x)
 	else
 		off = 2;
 	/* enforce a reasonable length */
-	if ((size_t) cc < length_query + off) {
+	if (capturefile != NULL)
+		length = captured[x->query].qlength;
+	else
+		length = length_query;
+	if ((size_t) cc < length + off) {
 		tooshort++;
 		return;
 	}
@@ -838,6 +1135,17 @@ receiveresp(struct exchange *x)
 	if (v >= NS_RCODE_LAST)
 		v = NS_RCODE_LAST;
 	rcodes[v] += 1;
+	if (capturefile != NULL) {
+		qt = &qtstats[captured[x->query].qtype < QT_OTHER ?
+			      captured[x->query].qtype : QT_OTHER];
+		if ((qt->rcvd == 0) || (delta < qt->dmin))
+			qt->dmin = delta;
+		if (delta > qt->dmax)
+			qt->dmax = delta;
+		qt->dsum += delta;
+		qt->rcvd++;
+		qt->rcodes[v] += 1;
+	}
 }
 
 /*
@@ -1070,6 +1378,14 @@ connect4(void)
 	x->next = -1;
 	x->prev = NULL;
 	x->ts0 = last;
+	x->query = curcaptured;
+	/* set before the socket is handed to the main thread */
+	x->order = xccount++;
+	x->id = (uint16_t) random();
+#if 0
+	if (random_query > 0)
+		x->rnd = (uint32_t) random();
+#endif
 	x->sock = getsock4();
 	if (x->sock < 0) {
 		int result = x->sock;
@@ -1116,12 +1432,6 @@ connect4(void)
 		(void) pthread_kill(master, SIGTERM);
 		return -errno;
 	}
-	x->order = xccount++;
-	x->id = (uint16_t) random();
-#if 0
-	if (random_query > 0)
-		x->rnd = (uint32_t) random();
-#endif
 	return idx;
 }
 
@@ -1235,6 +1545,14 @@ connect6(void)
 	x->next = -1;
 	x->prev = NULL;
 	x->ts0 = last;
+	x->query = curcaptured;
+	/* set before the socket is handed to the main thread */
+	x->order = xccount++;
+	x->id = (uint16_t) random();
+#if 0
+	if (random_query > 0)
+		x->rnd = (uint32_t) random();
+#endif
 	x->sock = getsock6();
 	if (x->sock < 0) {
 		int result = x->sock;
@@ -1281,12 +1599,6 @@ connect6(void)
 		(void) pthread_kill(master, SIGTERM);
 		return -errno;
 	}
-	x->order = xccount++;
-	x->id = (uint16_t) random();
-#if 0
-	if (random_query > 0)
-		x->rnd = (uint32_t) random();
-#endif
 	return idx;
 }
 
@@ -1415,6 +1727,118 @@ connecting(void *dummy)
 	return NULL;
 }
 
+/*
+ * replaying connector working routine
+ */
+
+void *
+replaying(void *dummy)
+{
+	struct timespec now, ts;
+	double offset, elapsed;
+	int ret;
+	char name[16];
+
+	dummy = dummy;
+
+	/* set repl-name */
+	memset(name, 0, sizeof(name));
+	ret = prctl(PR_GET_NAME, name, 0, 0, 0);
+	if (ret < 0)
+		perror("prctl(PR_GET_NAME)");
+	else {
+		memmove(name + 5, name, 11);
+		memcpy(name, "repl-", 5);
+		ret = prctl(PR_SET_NAME, name, 0, 0, 0);
+		if (ret < 0)
+			perror("prctl(PR_SET_NAME");
+	}
+
+	while (curcaptured < ncaptured) {
+		if (fatal)
+			break;
+
+		loops[1]++;
+
+		/* the date of the next captured query */
+		offset = captured[curcaptured].when / speed;
+		due = boot;
+		due.tv_sec += (time_t) offset;
+		due.tv_nsec += (long) ((offset - floor(offset)) * 1e9);
+		while (due.tv_nsec >= 1000000000) {
+			due.tv_sec += 1;
+			due.tv_nsec -= 1000000000;
+		}
+		if (clock_gettime(CLOCK_REALTIME, &now) < 0) {
+			perror("clock_gettime(replaying)");
+			fatal = 1;
+			(void) pthread_kill(master, SIGTERM);
+			break;
+		}
+		ts = due;
+		ts.tv_sec -= now.tv_sec;
+		ts.tv_nsec -= now.tv_nsec;
+		while (ts.tv_nsec < 0) {
+			ts.tv_sec -= 1;
+			ts.tv_nsec += 1000000000;
+		}
+		/* the connection was already due? */
+		if (ts.tv_sec < 0)
+			lateconn++;
+		else {
+			/* wait until */
+			ret = clock_nanosleep(CLOCK_REALTIME, 0, &ts, NULL);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				perror("clock_nanosleep");
+				fatal = 1;
+				(void) pthread_kill(master, SIGTERM);
+				break;
+			}
+			if (clock_gettime(CLOCK_REALTIME, &now) < 0) {
+				perror("clock_gettime(replaying)");
+				fatal = 1;
+				(void) pthread_kill(master, SIGTERM);
+				break;
+			}
+		}
+
+		/* open the connections of all the due queries */
+		elapsed = now.tv_sec - boot.tv_sec;
+		elapsed += (now.tv_nsec - boot.tv_nsec) / 1e9;
+		if (captured[curcaptured].when / speed > elapsed) {
+			shortwait[0]++;
+			continue;
+		}
+		while ((curcaptured < ncaptured) &&
+		       (captured[curcaptured].when / speed <= elapsed)) {
+			compconn++;
+			if (ipversion == 4)
+				ret = connect4();
+			else
+				ret = connect6();
+			curcaptured++;
+			if (ret < 0) {
+				if ((ret == -EAGAIN) ||
+				    (ret == -EWOULDBLOCK) ||
+				    (ret == -ENOBUFS) ||
+				    (ret == -ENFILE) ||
+				    (ret == -EMFILE) ||
+				    (ret == -EADDRNOTAVAIL) ||
+				    (ret == -ENOMEM))
+					locallimit++;
+				fprintf(stderr,
+					"connect: %s\n",
+					strerror(-ret));
+			}
+		}
+	}
+
+	replayed = 1;
+	return NULL;
+}
+
 /*
  * sender working routine
  */
@@ -1688,6 +2112,59 @@ terminate(int sig)
 	fatal = 1;
 }
 
+/*
+ * name of a query type (for the per query type statistics)
+ */
+
+const char *
+qtypename(int qtype)
+{
+	static char buf[16];
+
+	switch (qtype) {
+	case NS_TYPE_A:
+		return "A";
+	case NS_TYPE_NS:
+		return "NS";
+	case NS_TYPE_CNAME:
+		return "CNAME";
+	case NS_TYPE_SOA:
+		return "SOA";
+	case NS_TYPE_NULL:
+		return "NULL";
+	case NS_TYPE_PTR:
+		return "PTR";
+	case NS_TYPE_MX:
+		return "MX";
+	case NS_TYPE_TXT:
+		return "TXT";
+	case NS_TYPE_AAAA:
+		return "AAAA";
+	case NS_TYPE_DS:
+		return "DS";
+	case NS_TYPE_RRSIG:
+		return "RRSIG";
+	case NS_TYPE_NSEC:
+		return "NSEC";
+	case NS_TYPE_DNSKEY:
+		return "DNSKEY";
+	case NS_TYPE_NSEC3:
+		return "NSEC3";
+	case NS_TYPE_NSEC3PARAM:
+		return "NSEC3PARAM";
+	case NS_TYPE_IXFR:
+		return "IXFR";
+	case NS_TYPE_AXFR:
+		return "AXFR";
+	case NS_TYPE_ANY:
+		return "ANY";
+	case QT_OTHER:
+		return "others";
+	}
+	(void) snprintf(buf, sizeof(buf), "TYPE%d", qtype);
+	return buf;
+}
+
 /*
  * '-v' handler
  */
@@ -1709,7 +2186,8 @@ usage(void)
 "perftcpdns [-huvX0] [-4|-6] [-r<rate>] [-t<report>] [-p<test-period>]\n"
 "    [-n<num-request>]* [-d<lost-time>]* [-D<max-loss>]* [-T<template-file>]\n"
 "    [-l<local-addr>] [-L<local-port>]* [-a<aggressiveness>] [-s<seed>]\n"
-"    [-M<memory>] [-x<diagnostic-selector>] [-P<port>] server\n"
+"    [-M<memory>] [-x<diagnostic-selector>] [-P<port>]\n"
+"    [-C<capture-file> [-F<speed>]] server\n"
 "\f\n"
 "The server argument is the name/address of the DNS server to contact.\n"
 "\n"
@@ -1719,9 +2197,14 @@ usage(void)
 "-6: TCP/IPv6 operation. This is incompatible with the -4 option.\n"
 "-a<aggressiveness>: When the target sending rate is not yet reached,\n"
 "    control how many connections are initiated before the next pause.\n"
+"-C<capture-file>: Replay the queries sent to port 53 in a pcap file,\n"
+"    each on a new connection at its captured time relative to the first\n"
+"    one, in place of the -r<rate> schedule.  The test ends one lost-time\n"
+"    after the last one, with statistics per query type.\n"
 "-d<lost-time>: Specify the time after which a connection or a query is\n"
 "    treated as having been lost. The value is given in seconds and\n"
 "    may contain a fractional component. The default is 1 second.\n"
+"-F<speed>: Replay the capture <speed> times faster (default 1).\n"
 "-h: Print this help.\n"
 "-l<local-addr>: Specify the local hostname/address to use when\n"
 "    communicating with the server.\n"
@@ -1802,7 +2285,7 @@ main(const int argc, char * const argv[])
 	extern char *optarg;
 	extern int optind;
 
-#define OPTIONS	"hv46u0XM:r:t:R:b:n:p:d:D:l:L:a:s:T:O:x:P:"
+#define OPTIONS	"hv46u0XM:r:t:R:b:n:p:d:D:l:L:a:s:T:O:x:P:C:F:"
 
 	/* decode options */
 	while ((opt = getopt(argc, argv, OPTIONS)) != -1)
@@ -2045,6 +2528,24 @@ main(const int argc, char * const argv[])
 		diags = optarg;
 		break;
 
+	case 'C':
+		if (capturefile != NULL) {
+			fprintf(stderr, "capture-file is already set\n");
+			usage();
+			exit(2);
+		}
+		capturefile = optarg;
+		break;
+
+	case 'F':
+		speed = atof(optarg);
+		if (speed <= 0.) {
+			fprintf(stderr, "speed must be a positive number\n");
+			usage();
+			exit(2);
+		}
+		break;
+
 	case 'P':
 		i = atoi(optarg);
 		if ((i <= 0) || (i > 65535)) {
@@ -2134,6 +2635,9 @@ main(const int argc, char * const argv[])
 			printf(" Xflag");
 		if (rndoffset >= 0)
 			printf(" rnd-offset=%d", rndoffset);
+		if (capturefile != NULL)
+			printf(" capture-file='%s' speed=%g",
+			       capturefile, speed);
 		printf(" diagnotic-selectors='%s'", diags);
 		printf("\n");
 	}
@@ -2155,6 +2659,15 @@ main(const int argc, char * const argv[])
 		exit(2);
 	}
 
+	/* check capture file options */
+	if ((capturefile != NULL) && (templatefile != NULL)) {
+		fprintf(stderr,
+			"-C<capture-file> and -T<template-file> "
+			"are incompatible\n");
+		usage();
+		exit(2);
+	}
+
 	/* check various template file(s) and other condition(s) options */
 	if ((templatefile != NULL) && (range > 0) && (rndoffset < 0)) {
 		fprintf(stderr,
@@ -2220,8 +2733,10 @@ main(const int argc, char * const argv[])
 	/* initialize exchange structures */
 	inits();
 
-	/* get the socket descriptor and template(s) */
-	if (templatefile == NULL)
+	/* get the socket descriptor and template(s) (or queries) */
+	if (capturefile != NULL)
+		get_capture();
+	else if (templatefile == NULL)
 		build_template_query();
 	else
 		get_template_query();
@@ -2249,7 +2764,9 @@ main(const int argc, char * const argv[])
 
 	/* threads */
 	master = pthread_self();
-	ret = pthread_create(&connector, NULL, connecting, NULL);
+	ret = pthread_create(&connector, NULL,
+			     capturefile != NULL ? replaying : connecting,
+			     NULL);
 	if (ret != 0) {
 		fprintf(stderr, "pthread_create: %s\n", strerror(ret));
 		exit(1);
@@ -2297,6 +2814,19 @@ main(const int argc, char * const argv[])
 				printf("reached test-period\n");
 			break;
 		}
+		if (replayed) {
+			double waited;
+
+			/* give the last exchanges time to finish */
+			waited = now.tv_sec - last.tv_sec;
+			waited += (now.tv_nsec - last.tv_nsec) / 1e9;
+			if (waited > losttime[0] + losttime[1]) {
+				if ((diags != NULL) &&
+				    (strchr(diags, 'e') != NULL))
+					printf("reached end of capture\n");
+				break;
+			}
+		}
 		if ((report != 0) &&
 		    ((dreport.tv_sec < now.tv_sec) ||
 		     ((dreport.tv_sec == now.tv_sec) &&
@@ -2407,8 +2937,53 @@ main(const int argc, char * const argv[])
 		erate[0] = xccount / dall;
 		erate[1] = xscount / dall;
 		erate[2] = xrcount / dall;
-		printf("rates: %.0f,%.0f,%.0f (target %d)\n",
-		       erate[0], erate[1], erate[2], rate);
+		if (capturefile == NULL)
+			printf("rates: %.0f,%.0f,%.0f (target %d)\n",
+			       erate[0], erate[1], erate[2], rate);
+		else
+			printf("rates: %.0f,%.0f,%.0f (captured %.0f)\n",
+			       erate[0], erate[1], erate[2],
+			       captured[ncaptured - 1].when > 0. ?
+			       ncaptured * speed /
+			       captured[ncaptured - 1].when : 0.);
+	}
+
+	/* per query type statistics */
+	if (capturefile != NULL) {
+		printf("per query type:\n");
+		for (i = 0; i <= QT_OTHER; i++) {
+			struct qtstats *qt = &qtstats[i];
+
+			if (qt->sent == 0)
+				continue;
+			printf(" %s: sent: %llu, received: %llu",
+			       qtypename(i),
+			       (unsigned long long) qt->sent,
+			       (unsigned long long) qt->rcvd);
+			if (qt->rcvd != 0)
+				printf(", RTT min/avg/max: %.3f/%.3f/%.3f ms",
+				       qt->dmin * 1e3,
+				       qt->dsum / qt->rcvd * 1e3,
+				       qt->dmax * 1e3);
+			printf("\n  noerror: %llu, formerr: %llu, "
+			       "servfail: %llu, nxdomain: %llu,\n"
+			       "  noimp: %llu, refused: %llu, "
+			       "others: %llu\n",
+			       (unsigned long long)
+			       qt->rcodes[NS_RCODE_NOERROR],
+			       (unsigned long long)
+			       qt->rcodes[NS_RCODE_FORMERR],
+			       (unsigned long long)
+			       qt->rcodes[NS_RCODE_SERVFAIL],
+			       (unsigned long long)
+			       qt->rcodes[NS_RCODE_NXDOMAIN],
+			       (unsigned long long)
+			       qt->rcodes[NS_RCODE_NOIMP],
+			       (unsigned long long)
+			       qt->rcodes[NS_RCODE_REFUSED],
+			       (unsigned long long)
+			       qt->rcodes[NS_RCODE_LAST]);
+		}
 	}
 
 	/* rate processing instrumentation */
@@ -24,10 +24,12 @@
  ***/
 
 #define BIND_8_COMPAT	/* Pull in <arpa/nameser_compat.h> */
+#define _GNU_SOURCE	/* Pull in sendmmsg() and recvmmsg() */
 
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -60,6 +62,8 @@
 
 #define DEF_RTTARRAY_SIZE		50000
 #define DEF_RTTARRAY_UNIT		100		/* in usec */
+#define DEF_OL_SOCKETS			1		/* per thread */
+#define DEF_OL_BATCH			32
 
 /*
  * Other constants / definitions
@@ -75,6 +79,22 @@
 #define RESPONSE_BLOCKING_WAIT_TIME	0.1		/* in seconds */
 #define EDNSLEN				11
 #define DNS_HEADERLEN			12
+#define MAX_OL_THREADS			256
+#define MAX_OL_SOCKETS			64		/* per thread */
+#define MAX_OL_BATCH			1024
+#define OL_START_DELAY			10000000	/* in nsec */
+#define OL_MAX_WAIT			10000		/* in usec */
+#define OL_TYPES			257		/* qtypes < 256, other */
+#define MAX_CAPTURE_LEN			262144
+
+/*
+ * RTT histogram: values (in usec) below 2^HIST_SUBBITS are counted
+ * exactly, larger ones in buckets no wider than 1/2^(HIST_SUBBITS-1)
+ * of their value, up to 2^32 usec.
+ */
+#define HIST_SUBBITS			7
+#define HIST_HALF			(1U << (HIST_SUBBITS - 1))
+#define HIST_BUCKETS			((32 - HIST_SUBBITS + 2) * HIST_HALF)
 
 #define FALSE				0
 #define TRUE				1
@@ -139,6 +159,77 @@ struct query_mininfo {		/* minimum info for timeout queries */
 	char qname[MAX_DOMAIN_LEN + 1];
 };
 
+struct histogram {
+	unsigned long long counts[HIST_BUCKETS];
+	unsigned long long total;
+	unsigned int min;
+	unsigned int max;
+};
+
+/*
+ * Open loop mode (-P): the input is read into memory first, and each
+ * thread sends its share of it on a fixed schedule, whether or not the
+ * earlier queries have been answered.  When replaying a capture (-C)
+ * the schedule is the one recorded in the capture.
+ */
+struct ol_query {		/* a query ready to send */
+	unsigned char *wire;
+	unsigned short len;
+	unsigned short qlen;	/* length of the question section */
+	unsigned short qtype;
+	unsigned int source;	/* hash of the captured source */
+	unsigned long long when;	/* offset in the capture, in nsec */
+};
+
+struct ol_typestats {		/* results for one query type */
+	unsigned long long sent;
+	unsigned long long completed;
+	unsigned long long timed_out;
+	unsigned int rcodecounts[16];
+	struct histogram hist;
+};
+
+struct ol_slot {		/* an outstanding query, by id */
+	int in_use;
+	unsigned int query;	/* index into ol_queries[] */
+	unsigned long long intended;	/* scheduled send time in nsec */
+};
+
+struct ol_socket {
+	int fd;
+	unsigned short next_id;
+	unsigned short oldest;	/* ids from oldest to next_id may be used */
+	unsigned int outstanding;
+	struct ol_slot *slots;	/* 65536 of them */
+};
+
+struct ol_thread {
+	pthread_t thread;
+	unsigned int index;
+	struct ol_socket sockets[MAX_OL_SOCKETS];
+	unsigned int cursock;
+	unsigned long long start;	/* scheduled time of the first query */
+	unsigned long long interval;	/* between queries, in nsec */
+	unsigned long long scheduled;	/* queries scheduled so far */
+	unsigned int next_query;
+	unsigned int *replay;	/* this thread's queries when replaying */
+	unsigned int nreplay;
+	unsigned int pass;	/* through the capture */
+	unsigned long long last_send;
+	/* Results */
+	unsigned long long sent;
+	unsigned long long completed;
+	unsigned long long timed_out;
+	unsigned long long overruns;
+	unsigned long long delayed;
+	unsigned long long mismatched;
+	unsigned long long send_errors;
+	unsigned long long max_lag;	/* behind schedule, in nsec */
+	unsigned int rcodecounts[16];
+	struct histogram hist;
+	struct ol_typestats *types[OL_TYPES];
+};
+
 /*
  * Forward declarations.
  */
@@ -177,6 +268,12 @@ int rcodecounts[16] = {0};
 int verbose = FALSE;
 int recurse = 1;
 
+unsigned int ol_threads;				/* init 0 */
+unsigned int ol_sockets = DEF_OL_SOCKETS;
+unsigned int ol_batch = DEF_OL_BATCH;
+char *capture_file;					/* init NULL */
+double replay_speed = 1.0;
+
 /*
  * Other global stuff
  */
@@ -220,6 +317,8 @@ unsigned int rtt_overflows_interval;
 unsigned int rtt_counted;
 unsigned int rtt_counted_interval;
 char *rtt_histogram_file = NULL;
+struct histogram rtt_hist;
+struct histogram rtt_hist_interval;
 
 struct query_status *status;				/* init NULL */
 unsigned int query_status_allocated;			/* init 0 */
@@ -231,6 +330,10 @@ static char *rcode_strings[] = RCODE_STRINGS;
 
 static struct query_mininfo *timeout_queries;
 
+static struct ol_query *ol_queries;
+static unsigned int ol_nqueries;
+static unsigned long long ol_span;	/* of one pass through the capture */
+
 /*
  * get_uint16:
  *   Get an unsigned short integer from a buffer (in network order)
@@ -267,7 +370,9 @@ show_usage(void) {
 "Usage: queryperf [-d datafile] [-s server_addr] [-p port] [-q num_queries]\n"
 "                 [-b bufsize] [-t timeout] [-n] [-l limit] [-f family] [-1]\n"
 "                 [-i interval] [-r arraysize] [-u unit] [-H histfile]\n"
-"                 [-T qps] [-e] [-D] [-R] [-c] [-v] [-h]\n"
+"                 [-T qps] [-P threads] [-S sockets] [-B batch]\n"
+"                 [-C capture] [-F speed]\n"
+"                 [-e] [-D] [-R] [-c] [-v] [-h]\n"
 "  -d specifies the input data file (default: stdin)\n"
 "  -s sets the server to query (default: %s)\n"
 "  -p sets the port on which to query the server (default: %s)\n"
@@ -283,6 +388,11 @@ show_usage(void) {
 "  -u set RTT statistics time unit in usec (default: %d)\n"
 "  -H specifies RTT histogram data file (default: none)\n"
 "  -T specify the target qps (default: 0=unspecified)\n"
+"  -P send open loop at the -T rate from this many threads (default: 0=off)\n"
+"  -S sockets per thread in open loop mode (default: %d)\n"
+"  -B queries per send or receive call in open loop mode (default: %d)\n"
+"  -C replay the queries in a pcap file with their original timing\n"
+"  -F replay speed factor, 2 = twice as fast (default: 1)\n"
 "  -e enable EDNS 0\n"
 "  -D set the DNSSEC OK bit (implies EDNS)\n"
 "  -R disable recursion\n"
@@ -292,7 +402,8 @@ show_usage(void) {
 "\n",
 	        DEF_SERVER_TO_QUERY, DEF_SERVER_PORT,
 	        DEF_MAX_QUERIES_OUTSTANDING, DEF_QUERY_TIMEOUT,
-		DEF_BUFFER_SIZE, DEF_RTTARRAY_SIZE, DEF_RTTARRAY_UNIT);
+		DEF_BUFFER_SIZE, DEF_RTTARRAY_SIZE, DEF_RTTARRAY_UNIT,
+		DEF_OL_SOCKETS, DEF_OL_BATCH);
 }
 
 /*
@@ -539,9 +650,10 @@ int
 parse_args(int argc, char **argv) {
 	int c;
 	unsigned int uint_arg_val;
+	char *endp;
 
 	while ((c = getopt(argc, argv,
-			   "f:q:t:i:nd:s:p:1l:b:eDcvr:RT:u:H:h")) != -1) {
+			   "f:q:t:i:nd:s:p:1l:b:eDcvr:RT:u:H:P:S:B:C:F:h")) != -1) {
 		switch (c) {
 		case 'f':
 			if (strcmp(optarg, "inet") == 0)
@@ -698,6 +810,50 @@ parse_args(int argc, char **argv) {
 				return (-1);
 			}
 			break;
+		case 'P':
+			if (is_uint(optarg, &uint_arg_val) == TRUE &&
+			    uint_arg_val <= MAX_OL_THREADS)
+				ol_threads = uint_arg_val;
+			else {
+				fprintf(stderr, "Invalid number of threads "
+					"(at most %d): %s\n", MAX_OL_THREADS,
+					optarg);
+				return (-1);
+			}
+			break;
+		case 'S':
+			if (is_uint(optarg, &uint_arg_val) == TRUE &&
+			    uint_arg_val > 0 && uint_arg_val <= MAX_OL_SOCKETS)
+				ol_sockets = uint_arg_val;
+			else {
+				fprintf(stderr, "Invalid number of sockets "
+					"(1 to %d): %s\n", MAX_OL_SOCKETS,
+					optarg);
+				return (-1);
+			}
+			break;
+		case 'B':
+			if (is_uint(optarg, &uint_arg_val) == TRUE &&
+			    uint_arg_val > 0 && uint_arg_val <= MAX_OL_BATCH)
+				ol_batch = uint_arg_val;
+			else {
+				fprintf(stderr, "Invalid batch size "
+					"(1 to %d): %s\n", MAX_OL_BATCH,
+					optarg);
+				return (-1);
+			}
+			break;
+		case 'C':
+			capture_file = optarg;
+			break;
+		case 'F':
+			replay_speed = strtod(optarg, &endp);
+			if (*endp != '\0' || replay_speed <= 0.0) {
+				fprintf(stderr, "Invalid replay speed: %s\n",
+					optarg);
+				return (-1);
+			}
+			break;
 		case 'h':
 			return (-1);
 		default:
@@ -709,6 +865,20 @@ parse_args(int argc, char **argv) {
 	if (run_only_once == FALSE && use_timelimit == FALSE)
 		run_only_once = TRUE;
 
+	if (capture_file != NULL) {
+		if (target_qps != 0) {
+			fprintf(stderr, "A capture (-C) is replayed at its "
+				"own rate, use -F instead of -T\n");
+			return (-1);
+		}
+		if (ol_threads == 0)
+			ol_threads = 1;
+	} else if (ol_threads > 0 && target_qps == 0) {
+		fprintf(stderr, "Open loop mode (-P) needs a target qps "
+			"(-T)\n");
+		return (-1);
+	}
+
 	return (0);
 }
 
@@ -984,7 +1154,7 @@ setup(int argc, char **argv) {
 		return (-1);
 	}
 
-	if (open_datafile() == -1)
+	if (capture_file == NULL && open_datafile() == -1)
 		return (-1);
 
 	if (set_server_sa() == -1)
@@ -1388,19 +1558,16 @@ parse_query(char *input, char *qname, unsigned int qnlen, int *qtype) {
 }
 
 /*
- * dispatch_query:
- *   Send the query packet for the entry 
+ * make_query:
+ *   Build the query packet for the entry in packet_buffer, which must
+ *   hold PACKETSZ bytes
  *
  *   Return -1 on failure
- *   Return a non-negative integer otherwise
+ *   Return the length of the packet otherwise
  */
 int
-dispatch_query(unsigned short int id, char *dom, int qt, u_char **pktp,
-	       int *pktlenp)
-{
-	static u_char packet_buffer[PACKETSZ + 1];
+make_query(unsigned short int id, char *dom, int qt, u_char *packet_buffer) {
 	int buffer_len = PACKETSZ;
-	int bytes_sent;
 	unsigned short int net_id = htons(id);
 	char *id_ptr = (char *)&net_id;
 	HEADER *hp = (HEADER *)packet_buffer;
@@ -1441,6 +1608,28 @@ dispatch_query(unsigned short int id, char *dom, int qt, u_char **pktp,
 	packet_buffer[0] = id_ptr[0];
 	packet_buffer[1] = id_ptr[1];
 
+	return (buffer_len);
+}
+
+/*
+ * dispatch_query:
+ *   Send the query packet for the entry 
+ *
+ *   Return -1 on failure
+ *   Return a non-negative integer otherwise
+ */
+int
+dispatch_query(unsigned short int id, char *dom, int qt, u_char **pktp,
+	       int *pktlenp)
+{
+	static u_char packet_buffer[PACKETSZ + 1];
+	int buffer_len;
+	int bytes_sent;
+
+	buffer_len = make_query(id, dom, qt, packet_buffer);
+	if (buffer_len == -1)
+		return (-1);
+
 	bytes_sent = sendto(query_socket, packet_buffer, buffer_len, 0,
 			    server_ai->ai_addr, server_ai->ai_addrlen);
 	if (bytes_sent == -1) {
@@ -1542,6 +1731,123 @@ send_query(char *query_desc) {
 	num_queries_outstanding++;
 }
 
+/*
+ * hist_index:
+ *   Find the histogram bucket of a value
+ */
+static unsigned int
+hist_index(unsigned int value) {
+	unsigned int shift = 0;
+
+	while ((value >> shift) >= 2 * HIST_HALF)
+		shift++;
+
+	return (shift * HIST_HALF + (value >> shift));
+}
+
+/*
+ * hist_value:
+ *   Find the largest value counted in a histogram bucket
+ */
+static unsigned long long
+hist_value(unsigned int index) {
+	unsigned int shift;
+
+	if (index < 2 * HIST_HALF)
+		return (index);
+
+	shift = index / HIST_HALF - 1;
+	return ((((unsigned long long)(index - shift * HIST_HALF) + 1)
+		 << shift) - 1);
+}
+
+/*
+ * hist_record:
+ *   Count a value (in usec) in a histogram
+ */
+void
+hist_record(struct histogram *hist, unsigned long long usec) {
+	unsigned int value;
+
+	value = (usec > UINT_MAX) ? UINT_MAX : (unsigned int)usec;
+	if (hist->total == 0 || value < hist->min)
+		hist->min = value;
+	if (hist->total == 0 || value > hist->max)
+		hist->max = value;
+	hist->counts[hist_index(value)]++;
+	hist->total++;
+}
+
+/*
+ * hist_merge:
+ *   Add the counts of one histogram to another
+ */
+void
+hist_merge(struct histogram *to, struct histogram *from) {
+	unsigned int i;
+
+	if (from->total == 0)
+		return;
+
+	if (to->total == 0 || from->min < to->min)
+		to->min = from->min;
+	if (to->total == 0 || from->max > to->max)
+		to->max = from->max;
+	for (i = 0; i < HIST_BUCKETS; i++)
+		to->counts[i] += from->counts[i];
+	to->total += from->total;
+}
+
+/*
+ * hist_percentile:
+ *   Find the value (in usec) below which the given percentage of the
+ *   counted values lie
+ */
+unsigned long long
+hist_percentile(struct histogram *hist, double percent) {
+	unsigned long long rank, seen = 0;
+	unsigned int i;
+
+	if (hist->total == 0)
+		return (0);
+
+	rank = (unsigned long long)ceil((percent / 100.0) *
+					(double)hist->total);
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += hist->counts[i];
+		if (seen >= rank)
+			break;
+	}
+
+	if (i == HIST_BUCKETS || hist_value(i) > hist->max)
+		return (hist->max);
+	return (hist_value(i));
+}
+
+/*
+ * print_percentiles:
+ *   Print the RTT percentiles of a histogram
+ */
+void
+print_percentiles(struct histogram *hist) {
+	static const double percents[] = { 50, 90, 99, 99.9, 99.99 };
+	char label[32];
+	unsigned int i;
+
+	if (hist->total == 0)
+		return;
+
+	for (i = 0; i < sizeof(percents) / sizeof(percents[0]); i++) {
+		snprintf(label, sizeof(label), "RTT %g%%ile:",
+			 percents[i]);
+		printf("  %-22s%3.6lf sec\n", label,
+		       (double)hist_percentile(hist, percents[i]) / 1000000.0);
+	}
+}
+
 void
 register_rtt(struct timeval *timestamp, char *qname, int qtype,
 	     unsigned int rcode)
@@ -1565,6 +1871,7 @@ register_rtt(struct timeval *timestamp, char *qname, int qtype,
 
 	rtt_total += rtt;
 	rtt_counted++;
+	hist_record(&rtt_hist, (unsigned long long)(rtt * 1000000.0));
 
 	if (!oldquery) {
 		if (rtt_max_interval < 0 || rtt_max_interval < rtt)
@@ -1575,6 +1882,8 @@ register_rtt(struct timeval *timestamp, char *qname, int qtype,
 
 		rtt_total_interval += rtt;
 		rtt_counted_interval++;
+		hist_record(&rtt_hist_interval,
+			    (unsigned long long)(rtt * 1000000.0));
 	}
 
 	if (rttarray == NULL)
@@ -1933,7 +2242,8 @@ print_statistics(int intermediate, unsigned int sent, unsigned int timed_out,
 		 struct timeval *program_start,
 		 struct timeval *end_perf, struct timeval *end_query,
 		 unsigned int rcounted, double rmax, double rmin, double rtotal,
-		 unsigned int roverflows, unsigned int *rarray)
+		 unsigned int roverflows, unsigned int *rarray,
+		 struct histogram *rhist)
 {
 	unsigned int num_queries_completed;
 	double per_lost, per_completed, per_lost2, per_completed2; 
@@ -2034,6 +2344,7 @@ print_statistics(int intermediate, unsigned int sent, unsigned int timed_out,
 	printf("  RTT average:          %3.6lf sec\n", rtt_average);
 	printf("  RTT std deviation:    %3.6lf sec\n", rtt_stddev);
 	printf("  RTT out of range:     %u queries\n", roverflows);
+	print_percentiles(rhist);
 
 	if (!intermediate)	/* XXX should we print this case also? */
 		print_histogram(num_queries_completed);
@@ -2112,7 +2423,8 @@ print_interval_statistics() {
 			 &time_of_first_query_interval, &time_now, &time_now,
 			 rtt_counted_interval, rtt_max_interval,
 			 rtt_min_interval, rtt_total_interval,
-			 rtt_overflows_interval, rttarray_interval);
+			 rtt_overflows_interval, rttarray_interval,
+			 &rtt_hist_interval);
 
 	/* Reset intermediate counters */
 	num_queries_sent_interval = 0;
@@ -2127,6 +2439,1169 @@ print_interval_statistics() {
 		memset(rttarray_interval, 0,
 		       sizeof(rttarray_interval[0]) * rttarray_size);
 	}
+	memset(&rtt_hist_interval, 0, sizeof(rtt_hist_interval));
+}
+
+/*
+ * now_ns:
+ *   Current time in nsec, from a monotonic clock if there is one
+ */
+unsigned long long
+now_ns(void) {
+	struct timeval tv;
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return ((unsigned long long)ts.tv_sec * 1000000000ULL +
+			ts.tv_nsec);
+#endif
+	set_timenow(&tv);
+	return ((unsigned long long)tv.tv_sec * 1000000000ULL +
+		tv.tv_usec * 1000ULL);
+}
+
+/*
+ * ol_add:
+ *   Add a query packet to ol_queries[]
+ *
+ *   Return -1 on failure
+ *   Return a non-negative integer otherwise
+ */
+int
+ol_add(const u_char *packet, int len, int qlen, unsigned int qtype,
+       unsigned int source, unsigned long long when)
+{
+	static unsigned int allocated;
+	struct ol_query *q;
+
+	if (ol_nqueries == allocated) {
+		struct ol_query *queries;
+
+		allocated = (allocated == 0) ? 1024 : allocated * 2;
+		queries = realloc(ol_queries, allocated * sizeof(*queries));
+		if (queries == NULL) {
+			fprintf(stderr,
+				"Error: allocating memory for queries\n");
+			return (-1);
+		}
+		ol_queries = queries;
+	}
+
+	q = &ol_queries[ol_nqueries];
+	q->wire = malloc(len);
+	if (q->wire == NULL) {
+		fprintf(stderr, "Error: allocating memory for queries\n");
+		return (-1);
+	}
+	memcpy(q->wire, packet, len);
+	q->len = len;
+	q->qlen = qlen;
+	q->qtype = qtype;
+	q->source = source;
+	q->when = when;
+	ol_nqueries++;
+
+	return (0);
+}
+
+/*
+ * ol_load:
+ *   Read the whole input and build the query packets for open loop mode
+ *
+ *   Return -1 on failure
+ *   Return a non-negative integer otherwise
+ */
+int
+ol_load(void) {
+	static char domain[MAX_DOMAIN_LEN + 1];
+	char input_line[MAX_INPUT_LEN + 1];
+	u_char packet[PACKETSZ + 1];
+	int warned = FALSE;
+	int len, qlen, query_type;
+
+	while ((len = next_input_line(input_line, sizeof(input_line))) != 0) {
+		if (input_line[len - 1] == '\n')
+			input_line[len - 1] = '\0';
+
+		if (input_line[0] == CONFIG_CHAR) {
+			if (!warned)
+				fprintf(stderr, "Warning: configuration "
+					"directives are ignored in open loop "
+					"mode\n");
+			warned = TRUE;
+			continue;
+		}
+
+		if (parse_query(input_line, domain, MAX_DOMAIN_LEN,
+				&query_type) == -1) {
+			fprintf(stderr, "Error parsing query: %s\n",
+				input_line);
+			continue;
+		}
+
+		len = make_query(0, domain, query_type, packet);
+		if (len == -1)
+			continue;
+		qlen = dn_skipname(packet + DNS_HEADERLEN, packet + len);
+		if (qlen == -1)
+			continue;
+
+		if (ol_add(packet, len, qlen + 4, query_type, 0, 0) == -1)
+			return (-1);
+	}
+
+	if (ol_nqueries == 0) {
+		fprintf(stderr, "Error: no queries in the input\n");
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * capture_uint32:
+ *   Get a 32 bit integer from a pcap header, in the byte order of the
+ *   capture file
+ */
+static unsigned int
+capture_uint32(const unsigned char *p, int bigendian) {
+	if (bigendian)
+		return (((unsigned int)p[0] << 24) | (p[1] << 16) |
+			(p[2] << 8) | p[3]);
+	return (((unsigned int)p[3] << 24) | (p[2] << 16) |
+		(p[1] << 8) | p[0]);
+}
+
+/*
+ * capture_hash:
+ *   Add bytes to a hash of the source of a captured query
+ */
+static unsigned int
+capture_hash(unsigned int hash, const unsigned char *p, unsigned int len) {
+	while (len-- > 0)
+		hash = (hash ^ *p++) * 16777619U;
+	return (hash);
+}
+
+/*
+ * capture_transport:
+ *   Find the transport header in a captured frame
+ *
+ *   Return -1 if the frame is not an unfragmented UDP or TCP packet
+ *   Return the IP protocol otherwise, with the transport header and its
+ *   length in *datap and *lenp and a hash of the source address in
+ *   *sourcep
+ */
+static int
+capture_transport(unsigned int linktype, const unsigned char *frame,
+		  unsigned int len, const unsigned char **datap,
+		  unsigned int *lenp, unsigned int *sourcep)
+{
+	const unsigned char *ip, *data;
+	unsigned int off, etype, hlen, dlen, proto;
+
+	switch (linktype) {
+	case 0:			/* DLT_NULL */
+	case 108:		/* DLT_LOOP */
+		off = 4;
+		break;
+	case 1:			/* DLT_EN10MB */
+		off = 14;
+		if (len < off)
+			return (-1);
+		etype = (frame[12] << 8) | frame[13];
+		while ((etype == 0x8100 || etype == 0x88a8) &&
+		       len >= off + 4) {
+			etype = (frame[off + 2] << 8) | frame[off + 3];
+			off += 4;
+		}
+		if (etype != 0x0800 && etype != 0x86dd)
+			return (-1);
+		break;
+	case 113:		/* DLT_LINUX_SLL */
+		off = 16;
+		break;
+	default:		/* raw IP */
+		off = 0;
+		break;
+	}
+	if (len <= off)
+		return (-1);
+	ip = frame + off;
+	len -= off;
+
+	switch (ip[0] >> 4) {
+	case 4:
+		if (len < 20)
+			return (-1);
+		hlen = (ip[0] & 0xf) * 4;
+		dlen = (ip[2] << 8) | ip[3];
+		if (hlen < 20 || dlen < hlen || dlen > len)
+			return (-1);
+		/* Fragments: MF set or a non-zero offset. */
+		if ((ip[6] & 0x3f) != 0 || ip[7] != 0)
+			return (-1);
+		proto = ip[9];
+		*sourcep = capture_hash(2166136261U, ip + 12, 4);
+		data = ip + hlen;
+		dlen -= hlen;
+		break;
+	case 6:
+		if (len < 40)
+			return (-1);
+		dlen = (ip[4] << 8) | ip[5];
+		if (40 + dlen > len)
+			return (-1);
+		proto = ip[6];
+		*sourcep = capture_hash(2166136261U, ip + 8, 16);
+		data = ip + 40;
+		/* Hop-by-hop, routing and destination options. */
+		while (proto == 0 || proto == 43 || proto == 60) {
+			if (dlen < 8)
+				return (-1);
+			hlen = (data[1] + 1) * 8;
+			if (hlen > dlen)
+				return (-1);
+			proto = data[0];
+			data += hlen;
+			dlen -= hlen;
+		}
+		break;
+	default:
+		return (-1);
+	}
+
+	if (proto != IPPROTO_UDP && proto != IPPROTO_TCP)
+		return (-1);
+	*datap = data;
+	*lenp = dlen;
+	return (proto);
+}
+
+/*
+ * capture_query:
+ *   Add a captured DNS message to ol_queries[] if it is a query
+ *
+ *   Return -1 on failure
+ *   Return 1 if the message was added
+ *   Return 0 if it was skipped
+ */
+static int
+capture_query(const unsigned char *msg, unsigned int len, unsigned int source,
+	      unsigned long long when)
+{
+	int qlen;
+
+	if (len < DNS_HEADERLEN || len > PACKETSZ)
+		return (0);
+	/* A query (QR clear) with opcode QUERY and a question. */
+	if ((msg[2] & 0xf8) != 0 || get_uint16((u_char *)msg + 4) == 0)
+		return (0);
+	qlen = dn_skipname(msg + DNS_HEADERLEN, msg + len);
+	if (qlen == -1 || DNS_HEADERLEN + qlen + 4 > (int)len)
+		return (0);
+
+	if (ol_add(msg, len, qlen + 4,
+		   get_uint16((u_char *)msg + DNS_HEADERLEN + qlen),
+		   source, when) == -1)
+		return (-1);
+	return (1);
+}
+
+/*
+ * ol_load_capture:
+ *   Read the queries sent to port 53 over UDP or TCP from a pcap file,
+ *   with their times relative to the first one
+ *
+ *   Return -1 on failure
+ *   Return a non-negative integer otherwise
+ */
+int
+ol_load_capture(void) {
+	unsigned char header[24], *frame = NULL;
+	const unsigned char *data, *msg;
+	unsigned int linktype, caplen, dlen, mlen, source, skipped = 0;
+	unsigned long long ts, first = 0, when = 0;
+	int bigendian, nsec, proto, added, result = -1;
+	FILE *fp;
+
+	fp = fopen(capture_file, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: unable to open capture: %s\n",
+			capture_file);
+		return (-1);
+	}
+
+	if (fread(header, sizeof(header), 1, fp) != 1) {
+		fprintf(stderr, "Error: %s is not a pcap file\n",
+			capture_file);
+		goto cleanup;
+	}
+	switch (capture_uint32(header, FALSE)) {
+	case 0xa1b2c3d4:
+		bigendian = FALSE;
+		nsec = FALSE;
+		break;
+	case 0xa1b23c4d:
+		bigendian = FALSE;
+		nsec = TRUE;
+		break;
+	case 0xd4c3b2a1:
+		bigendian = TRUE;
+		nsec = FALSE;
+		break;
+	case 0x4d3cb2a1:
+		bigendian = TRUE;
+		nsec = TRUE;
+		break;
+	default:
+		fprintf(stderr, "Error: %s is not a pcap file (pcapng files "
+			"can be converted with \"editcap -F pcap\")\n",
+			capture_file);
+		goto cleanup;
+	}
+	linktype = capture_uint32(header + 20, bigendian) & 0xffff;
+	switch (linktype) {
+	case 0: case 1: case 12: case 14: case 101: case 108: case 113:
+	case 228: case 229:
+		break;
+	default:
+		fprintf(stderr, "Error: unsupported link type %u in %s\n",
+			linktype, capture_file);
+		goto cleanup;
+	}
+
+	frame = malloc(MAX_CAPTURE_LEN);
+	if (frame == NULL) {
+		fprintf(stderr, "Error: allocating memory for capture\n");
+		goto cleanup;
+	}
+
+	while (fread(header, 16, 1, fp) == 1) {
+		caplen = capture_uint32(header + 8, bigendian);
+		if (caplen > MAX_CAPTURE_LEN ||
+		    fread(frame, 1, caplen, fp) != caplen) {
+			fprintf(stderr, "Warning: %s is truncated\n",
+				capture_file);
+			break;
+		}
+
+		ts = capture_uint32(header, bigendian) * 1000000000ULL;
+		if (nsec)
+			ts += capture_uint32(header + 4, bigendian);
+		else
+			ts += capture_uint32(header + 4, bigendian) * 1000ULL;
+		if (ol_nqueries == 0)
+			first = ts;
+		/* Keep the schedule in order if the clock stepped back. */
+		if (ts >= first && ts - first > when)
+			when = ts - first;
+
+		proto = capture_transport(linktype, frame, caplen, &data,
+					  &dlen, &source);
+		if (proto == IPPROTO_UDP) {
+			if (dlen < 8 || ((data[2] << 8) | data[3]) != 53) {
+				skipped++;
+				continue;
+			}
+			source = capture_hash(source, data, 2);
+			mlen = (data[4] << 8) | data[5];
+			if (mlen < 8 || mlen > dlen) {
+				skipped++;
+				continue;
+			}
+			added = capture_query(data + 8, mlen - 8, source,
+					      when);
+			if (added == -1)
+				goto cleanup;
+			if (added == 0)
+				skipped++;
+		} else if (proto == IPPROTO_TCP) {
+			unsigned int off;
+
+			if (dlen < 20 || ((data[2] << 8) | data[3]) != 53)
+				continue;
+			source = capture_hash(source, data, 2);
+			off = (data[12] >> 4) * 4;
+			if (off < 20 || off > dlen)
+				continue;
+			/* Only messages that are whole in the segment. */
+			msg = data + off;
+			dlen -= off;
+			while (dlen >= 2) {
+				mlen = (msg[0] << 8) | msg[1];
+				if (mlen + 2 > dlen)
+					break;
+				added = capture_query(msg + 2, mlen, source,
+						      when);
+				if (added == -1)
+					goto cleanup;
+				if (added == 0)
+					skipped++;
+				msg += mlen + 2;
+				dlen -= mlen + 2;
+			}
+		} else
+			skipped++;
+	}
+
+	if (ol_nqueries == 0) {
+		fprintf(stderr, "Error: no queries in %s\n", capture_file);
+		goto cleanup;
+	}
+
+	/* Leave one average gap between passes through the capture. */
+	if (ol_nqueries > 1)
+		ol_span = when + when / (ol_nqueries - 1);
+	if (ol_span == 0)
+		ol_span = 1000000000ULL;
+
+	printf("[Status] Read %u queries from %s (%u packets skipped), "
+	       "%.3lf seconds\n", ol_nqueries, capture_file, skipped,
+	       (double)when / 1000000000.0);
+	result = 0;
+
+ cleanup:
+	if (frame != NULL)
+		free(frame);
+	(void)fclose(fp);
+	return (result);
+}
+
+/*
+ * ol_next:
+ *   Find the next query of the thread, starting over if the input is
+ *   to be used more than once
+ *
+ *   Return FALSE if the thread has sent all its queries
+ *   Return TRUE otherwise, with the index of the query in *query
+ */
+static int
+ol_next(struct ol_thread *t, unsigned int *query) {
+	if (t->replay != NULL) {
+		if (t->next_query >= t->nreplay) {
+			if (run_only_once || t->nreplay == 0)
+				return (FALSE);
+			t->next_query = 0;
+			t->pass++;
+		}
+		*query = t->replay[t->next_query];
+		return (TRUE);
+	}
+
+	if (t->next_query >= ol_nqueries) {
+		if (run_only_once)
+			return (FALSE);
+		t->next_query %= ol_nqueries;
+	}
+	*query = t->next_query;
+	return (TRUE);
+}
+
+/*
+ * ol_intended:
+ *   When the thread should send its next query, in nsec
+ */
+static unsigned long long
+ol_intended(struct ol_thread *t, unsigned int query) {
+	if (t->replay != NULL)
+		return (t->start + (unsigned long long)
+			((t->pass * ol_span + ol_queries[query].when) /
+			 replay_speed));
+
+	return (t->start + ((t->index + t->scheduled * ol_threads) *
+			    1000000000ULL) / target_qps);
+}
+
+/*
+ * ol_type:
+ *   Find the results for a query type, allocating them the first time
+ *
+ *   Return NULL if there is no memory for them
+ */
+static struct ol_typestats *
+ol_type(struct ol_thread *t, unsigned int qtype) {
+	unsigned int i = (qtype < OL_TYPES - 1) ? qtype : OL_TYPES - 1;
+
+	if (t->types[i] == NULL)
+		t->types[i] = calloc(1, sizeof(*t->types[i]));
+	return (t->types[i]);
+}
+
+/*
+ * ol_lost:
+ *   Count an outstanding query as lost
+ */
+static void
+ol_lost(struct ol_thread *t, struct ol_socket *s, struct ol_slot *slot) {
+	struct ol_typestats *ts;
+
+	slot->in_use = FALSE;
+	s->outstanding--;
+	t->timed_out++;
+	ts = ol_type(t, ol_queries[slot->query].qtype);
+	if (ts != NULL)
+		ts->timed_out++;
+}
+
+/*
+ * ol_retire:
+ *   Time out the old queries of a socket
+ */
+static void
+ol_retire(struct ol_thread *t, struct ol_socket *s, unsigned long long now) {
+	unsigned long long timeout = query_timeout * 1000000000ULL;
+	struct ol_slot *slot;
+
+	/*
+	 * oldest == next_id means either no or all 65536 ids are in use,
+	 * so go by the count.
+	 */
+	while (s->outstanding > 0) {
+		slot = &s->slots[s->oldest];
+		if (slot->in_use) {
+			if (now < slot->intended + timeout)
+				break;
+			ol_lost(t, s, slot);
+		}
+		s->oldest++;
+	}
+	if (s->outstanding == 0)
+		s->oldest = s->next_id;
+}
+
+/*
+ * ol_receive:
+ *   Process the responses waiting on a socket
+ */
+static void
+ol_receive(struct ol_thread *t, struct ol_socket *s, unsigned char *bufs,
+	   struct iovec *iovs, void *msgs)
+{
+	struct ol_typestats *ts;
+	struct ol_slot *slot;
+	struct ol_query *q;
+	unsigned long long now, rtt;
+	unsigned char *buf;
+	int i, n, numbytes;
+
+	for (;;) {
+#ifdef HAVE_RECVMMSG
+		struct mmsghdr *mmsgs = msgs;
+
+		for (i = 0; i < (int)ol_batch; i++) {
+			iovs[i].iov_base = bufs + i * PACKETSZ;
+			iovs[i].iov_len = PACKETSZ;
+			memset(&mmsgs[i], 0, sizeof(mmsgs[i]));
+			mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+			mmsgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		n = recvmmsg(s->fd, mmsgs, ol_batch, MSG_DONTWAIT, NULL);
+#else
+		(void)iovs;
+		(void)msgs;
+		n = recv(s->fd, bufs, PACKETSZ, MSG_DONTWAIT);
+		if (n >= 0) {
+			numbytes = n;
+			n = 1;
+		}
+#endif
+		if (n == -1) {
+			/* An ICMP error for an earlier query. */
+			if (errno == ECONNREFUSED || errno == EINTR)
+				continue;
+			return;
+		}
+
+		now = now_ns();
+		for (i = 0; i < n; i++) {
+			buf = bufs + i * PACKETSZ;
+#ifdef HAVE_RECVMMSG
+			numbytes = mmsgs[i].msg_len;
+#endif
+			if (numbytes < DNS_HEADERLEN) {
+				t->mismatched++;
+				continue;
+			}
+			slot = &s->slots[get_uint16(buf)];
+			if (!slot->in_use) {
+				t->delayed++;
+				continue;
+			}
+			q = &ol_queries[slot->query];
+			if (numbytes < DNS_HEADERLEN + q->qlen ||
+			    memcmp(buf + DNS_HEADERLEN,
+				   q->wire + DNS_HEADERLEN, q->qlen) != 0) {
+				t->mismatched++;
+				continue;
+			}
+			rtt = (now > slot->intended) ?
+				(now - slot->intended) / 1000 : 0;
+			hist_record(&t->hist, rtt);
+			t->rcodecounts[buf[3] & 0xF]++;
+			t->completed++;
+			ts = ol_type(t, q->qtype);
+			if (ts != NULL) {
+				hist_record(&ts->hist, rtt);
+				ts->rcodecounts[buf[3] & 0xF]++;
+				ts->completed++;
+			}
+			slot->in_use = FALSE;
+			s->outstanding--;
+		}
+
+		if (n < (int)ol_batch)
+			return;
+	}
+}
+
+/*
+ * ol_send:
+ *   Send the queries that are due, as many as go on one socket in one
+ *   call
+ *
+ *   Return FALSE when the thread has sent all it should
+ *   Return TRUE otherwise
+ */
+static int
+ol_send(struct ol_thread *t, unsigned long long end, unsigned char *bufs,
+	struct iovec *iovs, void *msgs)
+{
+	struct ol_typestats *ts;
+	struct ol_socket *s = NULL;
+	struct ol_slot *slot;
+	struct ol_query *q;
+	unsigned long long now, intended;
+	unsigned short ids[MAX_OL_BATCH];
+	unsigned int query, sock;
+	unsigned char *buf;
+	int i, n = 0, sent;
+	int more = TRUE;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr *mmsgs = msgs;
+#else
+	(void)msgs;
+#endif
+
+	now = now_ns();
+
+	while (n < (int)ol_batch) {
+		if (!ol_next(t, &query)) {
+			more = FALSE;
+			break;
+		}
+		intended = ol_intended(t, query);
+		if (end != 0 && intended >= end) {
+			more = FALSE;
+			break;
+		}
+		if (intended > now)
+			break;
+
+		/*
+		 * A replayed source always uses the same socket, so
+		 * stop when the next query is for another one.
+		 */
+		q = &ol_queries[query];
+		if (t->replay != NULL)
+			sock = (q->source / ol_threads) % ol_sockets;
+		else
+			sock = t->cursock;
+		if (s != NULL && s != &t->sockets[sock])
+			break;
+		s = &t->sockets[sock];
+
+		/* Reuse the id of the oldest query if all are in use. */
+		slot = &s->slots[s->next_id];
+		if (s->outstanding > 0 && s->next_id == s->oldest) {
+			if (slot->in_use) {
+				ol_lost(t, s, slot);
+				t->overruns++;
+			}
+			s->oldest++;
+		}
+		slot->in_use = TRUE;
+		slot->query = query;
+		slot->intended = intended;
+		s->outstanding++;
+		ids[n] = s->next_id++;
+
+		buf = bufs + n * PACKETSZ;
+		memcpy(buf, q->wire, q->len);
+		buf[0] = ids[n] >> 8;
+		buf[1] = ids[n] & 0xff;
+		iovs[n].iov_base = buf;
+		iovs[n].iov_len = q->len;
+#ifdef HAVE_SENDMMSG
+		memset(&mmsgs[n], 0, sizeof(mmsgs[n]));
+		mmsgs[n].msg_hdr.msg_iov = &iovs[n];
+		mmsgs[n].msg_hdr.msg_iovlen = 1;
+#endif
+		n++;
+
+		ts = ol_type(t, q->qtype);
+		if (ts != NULL)
+			ts->sent++;
+		if (now - intended > t->max_lag)
+			t->max_lag = now - intended;
+		t->scheduled++;
+		if (t->replay != NULL)
+			t->next_query++;
+		else
+			t->next_query += ol_threads;
+	}
+	t->cursock = (t->cursock + 1) % ol_sockets;
+
+	for (i = 0; i < n; i += sent) {
+#ifdef HAVE_SENDMMSG
+		sent = sendmmsg(s->fd, &mmsgs[i], n - i, 0);
+#else
+		sent = (send(s->fd, iovs[i].iov_base, iovs[i].iov_len, 0)
+			== -1) ? -1 : 1;
+#endif
+		if (sent == -1) {
+			if (errno == EINTR) {
+				sent = 0;
+				continue;
+			}
+			/* Forget the query so it is not counted as lost. */
+			slot = &s->slots[ids[i]];
+			slot->in_use = FALSE;
+			s->outstanding--;
+			ts = ol_type(t, ol_queries[slot->query].qtype);
+			if (ts != NULL)
+				ts->sent--;
+			t->send_errors++;
+			sent = 1;
+			continue;
+		}
+		t->sent += sent;
+	}
+	if (n > 0)
+		t->last_send = now_ns();
+
+	return (more);
+}
+
+/*
+ * ol_run:
+ *   Open loop sender and receiver thread
+ */
+static void *
+ol_run(void *arg) {
+	struct ol_thread *t = arg;
+	struct ol_socket *s;
+	unsigned long long now, next, end = 0;
+	unsigned int i, outstanding, query;
+	unsigned char *bufs;
+	struct iovec *iovs;
+	void *msgs;
+	struct timeval tv;
+	fd_set read_fds;
+	int sending = TRUE, maxfd = -1;
+
+	bufs = malloc(ol_batch * PACKETSZ);
+	iovs = malloc(ol_batch * sizeof(*iovs));
+#if defined(HAVE_SENDMMSG) || defined(HAVE_RECVMMSG)
+	msgs = malloc(ol_batch * sizeof(struct mmsghdr));
+#else
+	msgs = malloc(1);
+#endif
+	if (bufs == NULL || iovs == NULL || msgs == NULL) {
+		fprintf(stderr, "Error: allocating memory for thread %u\n",
+			t->index);
+		goto done;
+	}
+
+	if (use_timelimit)
+		end = t->start + run_timelimit * 1000000000ULL;
+
+	for (i = 0; i < ol_sockets; i++)
+		if (t->sockets[i].fd > maxfd)
+			maxfd = t->sockets[i].fd;
+
+	for (;;) {
+		if (sending)
+			sending = ol_send(t, end, bufs, iovs, msgs);
+
+		now = now_ns();
+		outstanding = 0;
+		for (i = 0; i < ol_sockets; i++) {
+			s = &t->sockets[i];
+			ol_receive(t, s, bufs, iovs, msgs);
+			ol_retire(t, s, now);
+			outstanding += s->outstanding;
+		}
+
+		if (!sending && outstanding == 0)
+			break;
+
+		/* Wait for a response or for the next query to be due. */
+		now = now_ns();
+		next = now + OL_MAX_WAIT * 1000ULL;
+		if (sending && ol_next(t, &query) &&
+		    ol_intended(t, query) < next)
+			next = ol_intended(t, query);
+		if (next <= now)
+			continue;
+		tv.tv_sec = (next - now) / 1000000000ULL;
+		tv.tv_usec = ((next - now) % 1000000000ULL) / 1000;
+		FD_ZERO(&read_fds);
+		for (i = 0; i < ol_sockets; i++)
+			FD_SET(t->sockets[i].fd, &read_fds);
+		(void)select(maxfd + 1, &read_fds, NULL, NULL, &tv);
+	}
+
+ done:
+	if (bufs != NULL)
+		free(bufs);
+	if (iovs != NULL)
+		free(iovs);
+	if (msgs != NULL)
+		free(msgs);
+	return (NULL);
+}
+
+/*
+ * print_ol_histogram:
+ *   Print the open loop RTT histogram to the specified file, one line
+ *   per bucket: the upper bound in usec, the percentage of the responses
+ *   in the bucket and the cumulative percentage
+ */
+void
+print_ol_histogram(struct histogram *hist) {
+	unsigned long long seen = 0;
+	unsigned int i;
+	FILE *fp;
+
+	if (rtt_histogram_file == NULL || hist->total == 0)
+		return;
+
+	fp = fopen((const char *)rtt_histogram_file, "w+");
+	if (fp == NULL) {
+		fprintf(stderr, "Error opening RTT histogram file: %s\n",
+			rtt_histogram_file);
+		return;
+	}
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (hist->counts[i] == 0)
+			continue;
+		seen += hist->counts[i];
+		fprintf(fp, "%llu %.3lf %.3lf\n", hist_value(i),
+			100.0 * hist->counts[i] / hist->total,
+			100.0 * seen / hist->total);
+	}
+
+	(void)fclose(fp);
+}
+
+/*
+ * print_ol_types:
+ *   Print the results of each query type
+ */
+void
+print_ol_types(struct ol_typestats **types) {
+	static char *qtype_strings[] = QTYPE_STRINGS;
+	static int qtype_codes[] = QTYPE_CODES;
+	struct ol_typestats *ts;
+	unsigned int i, j, n;
+	char name[32];
+	const char *sep;
+
+	n = sizeof(qtype_strings) / sizeof(qtype_strings[0]);
+	if (n > sizeof(qtype_codes) / sizeof(qtype_codes[0]))
+		n = sizeof(qtype_codes) / sizeof(qtype_codes[0]);
+
+	printf("  Per query type:\n");
+	printf("\n");
+
+	for (i = 0; i < OL_TYPES; i++) {
+		ts = types[i];
+		if (ts == NULL || ts->sent == 0)
+			continue;
+
+		if (i == OL_TYPES - 1)
+			strcpy(name, "other");
+		else {
+			snprintf(name, sizeof(name), "TYPE%u", i);
+			for (j = 0; j < n; j++) {
+				if (qtype_codes[j] == (int)i &&
+				    strcmp(qtype_strings[j], "*") != 0) {
+					snprintf(name, sizeof(name), "%s",
+						 qtype_strings[j]);
+					break;
+				}
+			}
+		}
+
+		printf("    %-10s sent %llu, completed %llu, lost %llu\n",
+		       name, ts->sent, ts->completed, ts->timed_out);
+		if (ts->hist.total > 0)
+			printf("               RTT 50%%ile %.6lf, 99%%ile "
+			       "%.6lf, max %.6lf sec\n",
+			       hist_percentile(&ts->hist, 50) / 1000000.0,
+			       hist_percentile(&ts->hist, 99) / 1000000.0,
+			       ts->hist.max / 1000000.0);
+		sep = "               ";
+		for (j = 0; j < 16; j++) {
+			if (ts->rcodecounts[j] == 0)
+				continue;
+			printf("%s%s %u", sep, rcode_strings[j],
+			       ts->rcodecounts[j]);
+			sep = ", ";
+		}
+		if (sep[0] == ',')
+			printf("\n");
+	}
+
+	printf("\n");
+}
+
+/*
+ * run_openloop:
+ *   Send the queries on a fixed schedule from ol_threads threads and
+ *   print the statistics
+ *
+ *   Return -1 on failure
+ *   Return a non-negative integer otherwise
+ */
+int
+run_openloop(void) {
+	struct ol_thread *threads, total;
+	struct timeval time_of_start;
+	unsigned long long start, finish;
+	unsigned int i, j, k;
+	double run_time, send_time;
+	char serveraddr[NI_MAXHOST];
+
+	if (capture_file != NULL) {
+		if (ol_load_capture() == -1)
+			return (-1);
+	} else {
+		if (ol_load() == -1)
+			return (-1);
+		printf("[Status] Read %u queries\n", ol_nqueries);
+	}
+
+	threads = calloc(ol_threads, sizeof(*threads));
+	if (threads == NULL) {
+		fprintf(stderr, "Error: allocating memory for threads\n");
+		return (-1);
+	}
+
+	/*
+	 * When replaying, all the queries of a captured source go to the
+	 * same thread (and socket), in their captured order.
+	 */
+	if (capture_file != NULL) {
+		for (i = 0; i < ol_nqueries; i++)
+			threads[ol_queries[i].source % ol_threads].nreplay++;
+		for (i = 0; i < ol_threads; i++) {
+			threads[i].replay = malloc((threads[i].nreplay + 1) *
+						   sizeof(unsigned int));
+			if (threads[i].replay == NULL) {
+				fprintf(stderr, "Error: allocating memory "
+					"for threads\n");
+				return (-1);
+			}
+			threads[i].nreplay = 0;
+		}
+		for (i = 0; i < ol_nqueries; i++) {
+			struct ol_thread *t;
+
+			t = &threads[ol_queries[i].source % ol_threads];
+			t->replay[t->nreplay++] = i;
+		}
+	}
+
+	for (i = 0; i < ol_threads; i++) {
+		for (j = 0; j < ol_sockets; j++) {
+			struct ol_socket *s = &threads[i].sockets[j];
+
+			s->slots = calloc(65536, sizeof(*s->slots));
+			if (s->slots == NULL) {
+				fprintf(stderr, "Error: allocating memory "
+					"for outstanding queries\n");
+				return (-1);
+			}
+			s->fd = open_socket();
+			if (s->fd == -1)
+				return (-1);
+			if (connect(s->fd, server_ai->ai_addr,
+				    server_ai->ai_addrlen) == -1) {
+				perror("Error: connect");
+				return (-1);
+			}
+		}
+	}
+
+	if (getnameinfo(server_ai->ai_addr, server_ai->ai_addrlen,
+			serveraddr, sizeof(serveraddr), NULL, 0,
+			NI_NUMERICHOST) != 0)
+		strcpy(serveraddr, "???");
+	if (capture_file != NULL)
+		printf("[Status] Replaying at %gx speed to %s from %u "
+		       "threads, %u sockets each\n", replay_speed,
+		       serveraddr, ol_threads, ol_sockets);
+	else
+		printf("[Status] Sending %u qps to %s from %u threads, "
+		       "%u sockets each\n", target_qps, serveraddr,
+		       ol_threads, ol_sockets);
+
+	set_timenow(&time_of_start);
+	start = now_ns() + OL_START_DELAY;
+	for (i = 0; i < ol_threads; i++) {
+		threads[i].index = i;
+		threads[i].start = start;
+		threads[i].next_query = (capture_file != NULL) ? 0 : i;
+		if (pthread_create(&threads[i].thread, NULL, ol_run,
+				   &threads[i]) != 0) {
+			fprintf(stderr, "Error: creating thread %u\n", i);
+			return (-1);
+		}
+	}
+
+	for (i = 0; i < ol_threads; i++)
+		(void)pthread_join(threads[i].thread, NULL);
+	finish = now_ns();
+	set_timenow(&time_of_end_of_run);
+
+	printf("[Status] Testing complete\n");
+
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < ol_threads; i++) {
+		struct ol_thread *t = &threads[i];
+
+		total.sent += t->sent;
+		total.completed += t->completed;
+		total.timed_out += t->timed_out;
+		total.overruns += t->overruns;
+		total.delayed += t->delayed;
+		total.mismatched += t->mismatched;
+		total.send_errors += t->send_errors;
+		if (t->max_lag > total.max_lag)
+			total.max_lag = t->max_lag;
+		if (t->last_send > total.last_send)
+			total.last_send = t->last_send;
+		for (j = 0; j < 16; j++)
+			rcodecounts[j] += t->rcodecounts[j];
+		hist_merge(&total.hist, &t->hist);
+		for (j = 0; j < OL_TYPES; j++) {
+			struct ol_typestats *from = t->types[j], *to;
+
+			if (from == NULL)
+				continue;
+			if (total.types[j] == NULL)
+				total.types[j] = calloc(1, sizeof(*to));
+			to = total.types[j];
+			if (to != NULL) {
+				to->sent += from->sent;
+				to->completed += from->completed;
+				to->timed_out += from->timed_out;
+				for (k = 0; k < 16; k++)
+					to->rcodecounts[k] +=
+						from->rcodecounts[k];
+				hist_merge(&to->hist, &from->hist);
+			}
+			free(from);
+		}
+		for (j = 0; j < ol_sockets; j++) {
+			(void)close(t->sockets[j].fd);
+			free(t->sockets[j].slots);
+		}
+		if (t->replay != NULL)
+			free(t->replay);
+	}
+	free(threads);
+
+	run_time = (finish > start) ? (finish - start) / 1000000000.0 : 0.0;
+	send_time = (total.last_send > start) ?
+		(total.last_send - start) / 1000000000.0 : 0.0;
+
+	printf("\n");
+	printf("Statistics:\n");
+	printf("\n");
+	if (capture_file != NULL)
+		printf("  Mode:                 replay at %gx, %u threads, "
+		       "%u sockets each\n", replay_speed, ol_threads,
+		       ol_sockets);
+	else
+		printf("  Mode:                 open loop, %u threads, "
+		       "%u sockets each\n", ol_threads, ol_sockets);
+	printf("  Parse input file:     %s\n",
+	       ((run_only_once == TRUE) ? "once" : "multiple times"));
+	if (use_timelimit)
+		printf("  Run time limit:       %u seconds\n", run_timelimit);
+	if (run_only_once == FALSE)
+		printf("  Ran through file:     %llu times\n",
+		       total.sent / ol_nqueries);
+	printf("\n");
+
+	printf("  Queries sent:         %llu queries\n", total.sent);
+	printf("  Queries completed:    %llu queries\n", total.completed);
+	printf("  Queries lost:         %llu queries\n", total.timed_out);
+	printf("  Queries delayed(?):   %llu queries\n", total.delayed);
+	if (total.overruns > 0)
+		printf("  Lost to id reuse:     %llu queries\n",
+		       total.overruns);
+	if (total.mismatched > 0)
+		printf("  Mismatched responses: %llu\n", total.mismatched);
+	if (total.send_errors > 0)
+		printf("  Send errors:          %llu\n", total.send_errors);
+	printf("\n");
+
+	printf("  RTT max:              %3.6lf sec\n",
+	       total.hist.max / 1000000.0);
+	printf("  RTT min:              %3.6lf sec\n",
+	       total.hist.min / 1000000.0);
+	print_percentiles(&total.hist);
+	printf("  Max send lag:         %3.6lf sec\n",
+	       total.max_lag / 1000000000.0);
+	print_ol_histogram(&total.hist);
+	printf("\n");
+
+	if (countrcodes) {
+		for (i = 0; i < 16; i++) {
+			if (rcodecounts[i] == 0)
+				continue;
+			printf("  Returned %8s:    %u queries\n",
+			       rcode_strings[i], rcodecounts[i]);
+		}
+		printf("\n");
+	}
+
+	printf("  Percentage completed: %6.2lf%%\n", (total.sent == 0) ?
+	       0.0 : 100.0 * total.completed / total.sent);
+	printf("  Percentage lost:      %6.2lf%%\n", (total.sent == 0) ?
+	       0.0 : 100.0 * total.timed_out / total.sent);
+	printf("\n");
+
+	printf("  Started at:           %s",
+	       ctime((const time_t *)&time_of_start.tv_sec));
+	printf("  Finished at:          %s",
+	       ctime((const time_t *)&time_of_end_of_run.tv_sec));
+	printf("  Ran for:              %.6lf seconds\n", run_time);
+	printf("\n");
+
+	printf("  Queries per second:   %.6lf qps\n", (run_time == 0.0) ?
+	       0.0 : total.completed / run_time);
+	if (target_qps > 0)
+		printf("  Sent QPS/target:      %.6lf/%d qps\n",
+		       (send_time == 0.0) ? 0.0 : total.sent / send_time,
+		       target_qps);
+	else
+		printf("  Sent QPS:             %.6lf qps\n",
+		       (send_time == 0.0) ? 0.0 : total.sent / send_time);
+	printf("\n");
+
+	print_ol_types(total.types);
+	for (j = 0; j < OL_TYPES; j++)
+		if (total.types[j] != NULL)
+			free(total.types[j]);
+
+	return (0);
 }
 
 /*
@@ -2155,6 +3630,15 @@ main(int argc, char **argv) {
 	if (setup(argc, argv) == -1)
 		return (-1);
 
+	if (ol_threads > 0) {
+		printf("[Status] Processing input data\n");
+		if (run_openloop() == -1)
+			return (-1);
+		close_socket();
+		close_datafile();
+		return (0);
+	}
+
 	/* XXX: move this to setup: */
 	timeout_queries = malloc(sizeof(struct query_mininfo) * 65536);
 	if (timeout_queries == NULL) {
@@ -2231,7 +3715,7 @@ main(int argc, char **argv) {
 			 &time_of_first_query, &time_of_program_start,
 			 &time_of_end_of_run, &time_of_stop_sending,
 			 rtt_counted, rtt_max, rtt_min, rtt_total,
-			 rtt_overflows, rttarray);
+			 rtt_overflows, rttarray, &rtt_hist);
 
 	return (0);
 }
@@ -21,6 +21,8 @@
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/string.h>
@@ -108,6 +110,8 @@ dns_acl_anyornone(isc_mem_t *mctx, isc_boolean_t neg, dns_acl_t **target) {
 		return (result);
 
 	result = dns_iptable_addprefix(acl->iptable, NULL, 0, ISC_TF(!neg));
+	if (result == ISC_R_SUCCESS)
+		result = dns_acl_compile(acl);
 	if (result != ISC_R_SUCCESS) {
 		dns_acl_detach(&acl);
 		return (result);
@@ -193,12 +197,8 @@ dns_acl_match(const isc_netaddr_t *reqaddr,
 	      int *match,
 	      const dns_aclelement_t **matchelt)
 {
-	isc_uint16_t bitlen, family;
-	isc_prefix_t pfx;
-	isc_radix_node_t *node = NULL;
 	const isc_netaddr_t *addr;
 	isc_netaddr_t v4addr;
-	isc_result_t result;
 	int match_num = -1;
 	unsigned int i;
 
@@ -214,35 +214,18 @@ dns_acl_match(const isc_netaddr_t *reqaddr,
 		addr = &v4addr;
 	}
 
-	/* Always match with host addresses. */
-	family = addr->family;
-	bitlen = family == AF_INET6 ? 128 : 32;
-	NETADDR_TO_PREFIX_T(addr, pfx, bitlen);
-
-	/* Assume no match. */
-	*match = 0;
-
-	/* Search radix. */
-	result = isc_radix_search(acl->iptable->radix, &node, &pfx);
-
-	/* Found a match. */
-	if (result == ISC_R_SUCCESS && node != NULL) {
-		match_num = node->node_num[ISC_IS6(family)];
-		if (*(isc_boolean_t *) node->data[ISC_IS6(family)] == ISC_TRUE)
-			*match = match_num;
-		else
-			*match = -match_num;
-	}
+	/* Search the IP table. */
+	dns_iptable_search(acl->iptable, addr, match);
+	if (*match != 0)
+		match_num = abs(*match);
 
 	/* Now search non-radix elements for a match with a lower node_num. */
 	for (i = 0; i < acl->length; i++) {
 		dns_aclelement_t *e = &acl->elements[i];
 
 		/* Already found a better match? */
-		if (match_num != -1 && match_num < e->node_num) {
-			isc_refcount_destroy(&pfx.refcount);
+		if (match_num != -1 && match_num < e->node_num)
 			return (ISC_R_SUCCESS);
-		}
 
 		if (dns_aclelement_match(reqaddr, reqsigner,
 					 e, env, matchelt)) {
@@ -252,15 +235,30 @@ dns_acl_match(const isc_netaddr_t *reqaddr,
 				else
 					*match = e->node_num;
 			}
-			isc_refcount_destroy(&pfx.refcount);
 			return (ISC_R_SUCCESS);
 		}
 	}
 
-	isc_refcount_destroy(&pfx.refcount);
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Compile the IP table of an ACL that is complete, so that
+ * dns_acl_match() need not search the radix tree.  An ACL whose
+ * table is too large to compile is still matched correctly.
+ */
+isc_result_t
+dns_acl_compile(dns_acl_t *acl) {
+	isc_result_t result;
+
+	REQUIRE(DNS_ACL_VALID(acl));
+
+	result = dns_iptable_compile(acl->iptable);
+	if (result == ISC_R_RANGE)
+		result = ISC_R_SUCCESS;
+	return (result);
+}
+
 /*
  * Merge the contents of one ACL into another.  Call dns_iptable_merge()
  * for the IP tables, then concatenate the element arrays.
@@ -0,0 +1,612 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <isc/platform.h>
+
+#ifdef ISC_PLATFORM_HAVESYSUNH
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include <isc/buffer.h>
+#include <isc/condition.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/print.h>
+#include <isc/refcount.h>
+#include <isc/region.h>
+#include <isc/ringbuf.h>
+#include <isc/sockaddr.h>
+#include <isc/stdio.h>
+#include <isc/stdtime.h>
+#include <isc/strerror.h>
+#include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/capture.h>
+#include <dns/log.h>
+
+#define CAPTURE_MAGIC			ISC_MAGIC('D', 'C', 'a', 'p')
+#define VALID_CAPTURE(c)		ISC_MAGIC_VALID(c, CAPTURE_MAGIC)
+
+/*%
+ * Bytes of frames each ring can hold; a power of two, and room for
+ * several of the largest (TCP) messages.
+ */
+#define RINGSIZE		(1024 * 1024)
+
+/*%
+ * How long the writer thread sleeps when it is not woken by a ring
+ * filling up, in milliseconds.
+ */
+#define FLUSHINTERVAL		100
+
+struct dns_capture {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	isc_refcount_t		references;
+	dns_captureoutput_t	output;
+	char			*path;
+	isc_ringbuf_t		*ringbuf;
+
+	/* Writer thread only, after creation. */
+	FILE			*fp;
+	int			fd;
+	isc_stdtime_t		lastconnect;
+	isc_boolean_t		connectfailed;
+	isc_uint64_t		reported;	/* drops as last logged */
+	isc_stdtime_t		reportedtime;
+
+	isc_mutex_t		lock;
+	isc_uint64_t		lost;		/* locked by lock */
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t		thread;
+	isc_condition_t		cond;
+	isc_boolean_t		exiting;	/* locked by lock */
+#else
+	isc_stdtime_t		flushed;
+#endif
+};
+
+static void
+makeheader(unsigned char *header) {
+	memmove(header, DNS_CAPTURE_MAGIC, 8);
+	header[8] = 0;
+	header[9] = DNS_CAPTURE_VERSION;
+	header[10] = header[11] = 0;
+}
+
+static isc_result_t
+openfile(dns_capture_t *capture) {
+	unsigned char header[DNS_CAPTURE_HEADERLEN];
+	isc_result_t result;
+	off_t offset;
+
+	result = isc_stdio_open(capture->path, "ab", &capture->fp);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = isc_stdio_seek(capture->fp, 0, SEEK_END);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_tell(capture->fp, &offset);
+	if (result == ISC_R_SUCCESS && offset == 0) {
+		makeheader(header);
+		result = isc_stdio_write(header, sizeof(header), 1,
+					 capture->fp, NULL);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_stdio_close(capture->fp);
+		capture->fp = NULL;
+	}
+	return (result);
+}
+
+#ifdef ISC_PLATFORM_HAVESYSUNH
+/*%
+ * Write all of 'data'.  Without threads the socket is non-blocking:
+ * ISC_R_NOSPACE means nothing was written because the reader is
+ * behind, while a write that stops part way cannot be finished
+ * without blocking and breaks the framing, so it is a failure.
+ */
+static isc_result_t
+writeall(int fd, const unsigned char *data, size_t len) {
+	isc_boolean_t started = ISC_FALSE;
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, data, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && !started &&
+		    (errno == EAGAIN || errno == EWOULDBLOCK))
+			return (ISC_R_NOSPACE);
+		if (n <= 0)
+			return (ISC_R_FAILURE);
+		started = ISC_TRUE;
+		data += n;
+		len -= n;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static isc_boolean_t
+setnonblocking(int fd) {
+#ifdef ISC_PLATFORM_USETHREADS
+	UNUSED(fd);
+	return (ISC_TRUE);
+#else
+	int flags;
+
+	flags = fcntl(fd, F_GETFL, 0);
+	return (ISC_TF(flags != -1 &&
+		       fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1));
+#endif
+}
+
+static void
+closesocket(dns_capture_t *capture, const char *reason) {
+	char strbuf[ISC_STRERRORSIZE];
+
+	isc__strerror(errno, strbuf, sizeof(strbuf));
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+		      DNS_LOGMODULE_CAPTURE, ISC_LOG_WARNING,
+		      "capture socket '%s': %s: %s", capture->path,
+		      reason, strbuf);
+	(void)close(capture->fd);
+	capture->fd = -1;
+}
+
+/*%
+ * Make sure the socket is connected, trying at most once a second.
+ * Failures are logged once until a connection succeeds.  Without
+ * threads the rings are drained by the thread that captures, so the
+ * socket is made non-blocking: a reader that is not accepting or is
+ * not keeping up costs dropped frames, never a wait.
+ */
+static isc_boolean_t
+connectsocket(dns_capture_t *capture) {
+	unsigned char header[DNS_CAPTURE_HEADERLEN];
+	struct sockaddr_un addr;
+	char strbuf[ISC_STRERRORSIZE];
+	isc_stdtime_t now;
+
+	if (capture->fd != -1)
+		return (ISC_TRUE);
+
+	isc_stdtime_get(&now);
+	if (now == capture->lastconnect)
+		return (ISC_FALSE);
+	capture->lastconnect = now;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strlcpy(addr.sun_path, capture->path, sizeof(addr.sun_path));
+
+	capture->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (capture->fd != -1 &&
+	    (!setnonblocking(capture->fd) ||
+	     connect(capture->fd, (struct sockaddr *)&addr,
+		     sizeof(addr)) == -1)) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		(void)close(capture->fd);
+		capture->fd = -1;
+	} else if (capture->fd == -1)
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+	if (capture->fd == -1) {
+		if (!capture->connectfailed)
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_CAPTURE, ISC_LOG_WARNING,
+				      "capture socket '%s': unable to "
+				      "connect: %s; dropping frames until "
+				      "it can be", capture->path, strbuf);
+		capture->connectfailed = ISC_TRUE;
+		return (ISC_FALSE);
+	}
+
+	makeheader(header);
+	if (writeall(capture->fd, header, sizeof(header)) != ISC_R_SUCCESS) {
+		closesocket(capture, "writing header");
+		return (ISC_FALSE);
+	}
+	if (capture->connectfailed)
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_CAPTURE, ISC_LOG_INFO,
+			      "capture socket '%s': connected",
+			      capture->path);
+	capture->connectfailed = ISC_FALSE;
+	return (ISC_TRUE);
+}
+#endif /* ISC_PLATFORM_HAVESYSUNH */
+
+/*%
+ * Count the frames in a batch that cannot be written as lost.
+ */
+static void
+dropbatch(dns_capture_t *capture, const unsigned char *data, size_t len) {
+	isc_uint64_t frames = 0;
+	size_t off = 0;
+
+	while (off + 4 <= len) {
+		off += ((isc_uint32_t)data[off] << 24) |
+		       ((isc_uint32_t)data[off + 1] << 16) |
+		       ((isc_uint32_t)data[off + 2] << 8) | data[off + 3];
+		frames++;
+	}
+	LOCK(&capture->lock);
+	capture->lost += frames;
+	UNLOCK(&capture->lock);
+}
+
+static void
+writebatch(void *arg, unsigned char *data, unsigned int len) {
+	dns_capture_t *capture = arg;
+	isc_result_t result;
+
+	if (capture->output == dns_captureoutput_file) {
+		if (capture->fp == NULL) {
+			dropbatch(capture, data, len);
+			return;
+		}
+		result = isc_stdio_write(data, 1, len, capture->fp, NULL);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_CAPTURE, ISC_LOG_ERROR,
+				      "writing capture file '%s': %s",
+				      capture->path,
+				      isc_result_totext(result));
+			dropbatch(capture, data, len);
+		}
+		return;
+	}
+
+#ifdef ISC_PLATFORM_HAVESYSUNH
+	if (!connectsocket(capture)) {
+		dropbatch(capture, data, len);
+		return;
+	}
+	result = writeall(capture->fd, data, len);
+	if (result == ISC_R_NOSPACE) {
+		dropbatch(capture, data, len);
+	} else if (result != ISC_R_SUCCESS) {
+		/* The reader gets a new header when we reconnect. */
+		closesocket(capture, "connection lost");
+		dropbatch(capture, data, len);
+	}
+#else
+	dropbatch(capture, data, len);
+#endif
+}
+
+/*%
+ * Move everything queued in the rings to the output.  Called by the
+ * writer thread, or without threads by dns_capture_message().
+ */
+static void
+drain(dns_capture_t *capture) {
+	isc_uint64_t dropped;
+	isc_stdtime_t now;
+
+	isc_ringbuf_drain(capture->ringbuf, writebatch, capture);
+	if (capture->fp != NULL)
+		(void)isc_stdio_flush(capture->fp);
+
+	/* Say so when frames are being lost, but not too often. */
+	dropped = dns_capture_dropped(capture);
+	if (dropped != capture->reported) {
+		isc_stdtime_get(&now);
+		if (now - capture->reportedtime >= 60) {
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_CAPTURE, ISC_LOG_WARNING,
+				      "capture '%s': %" ISC_PRINT_QUADFORMAT
+				      "u frames dropped", capture->path,
+				      dropped - capture->reported);
+			capture->reported = dropped;
+			capture->reportedtime = now;
+		}
+	}
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+writer(isc_threadarg_t arg) {
+	dns_capture_t *capture = arg;
+	isc_interval_t interval;
+	isc_time_t until;
+	isc_boolean_t exiting = ISC_FALSE;
+
+	isc_interval_set(&interval, 0, FLUSHINTERVAL * 1000000);
+	while (!exiting) {
+		LOCK(&capture->lock);
+		if (!capture->exiting) {
+			if (isc_time_nowplusinterval(&until, &interval) ==
+			    ISC_R_SUCCESS)
+				(void)isc_condition_waituntil(&capture->cond,
+							      &capture->lock,
+							      &until);
+		}
+		exiting = capture->exiting;
+		UNLOCK(&capture->lock);
+		drain(capture);
+	}
+	return ((isc_threadresult_t)0);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
+isc_result_t
+dns_capture_create(isc_mem_t *mctx, dns_captureoutput_t output,
+		   const char *path, unsigned int nrings,
+		   dns_capture_t **capturep)
+{
+	dns_capture_t *capture;
+	isc_result_t result;
+
+	REQUIRE(path != NULL);
+	REQUIRE(nrings > 0);
+	REQUIRE(capturep != NULL && *capturep == NULL);
+
+	if (output == dns_captureoutput_unix) {
+#ifdef ISC_PLATFORM_HAVESYSUNH
+		struct sockaddr_un addr;
+
+		if (strlen(path) >= sizeof(addr.sun_path))
+			return (ISC_R_NOSPACE);
+#else
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
+
+	capture = isc_mem_get(mctx, sizeof(*capture));
+	if (capture == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(capture, 0, sizeof(*capture));
+	isc_mem_attach(mctx, &capture->mctx);
+	capture->output = output;
+	capture->fd = -1;
+
+	capture->path = isc_mem_strdup(mctx, path);
+	if (capture->path == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_mctx;
+	}
+	result = isc_ringbuf_create(mctx, nrings, RINGSIZE,
+				    &capture->ringbuf);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_path;
+	if (output == dns_captureoutput_file) {
+		result = openfile(capture);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_ringbuf;
+	}
+	result = isc_refcount_init(&capture->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_file;
+	result = isc_mutex_init(&capture->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_refcount;
+
+#ifdef ISC_PLATFORM_USETHREADS
+	result = isc_condition_init(&capture->cond);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+	result = isc_thread_create(writer, capture, &capture->thread);
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_condition_destroy(&capture->cond);
+		goto cleanup_lock;
+	}
+#endif
+
+	capture->magic = CAPTURE_MAGIC;
+	*capturep = capture;
+	return (ISC_R_SUCCESS);
+
+#ifdef ISC_PLATFORM_USETHREADS
+ cleanup_lock:
+	DESTROYLOCK(&capture->lock);
+#endif
+ cleanup_refcount:
+	isc_refcount_decrement(&capture->references, NULL);
+	isc_refcount_destroy(&capture->references);
+ cleanup_file:
+	if (capture->fp != NULL)
+		(void)isc_stdio_close(capture->fp);
+ cleanup_ringbuf:
+	isc_ringbuf_destroy(&capture->ringbuf);
+ cleanup_path:
+	isc_mem_free(mctx, capture->path);
+ cleanup_mctx:
+	isc_mem_putanddetach(&capture->mctx, capture, sizeof(*capture));
+	return (result);
+}
+
+void
+dns_capture_attach(dns_capture_t *source, dns_capture_t **targetp) {
+	REQUIRE(VALID_CAPTURE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+static void
+destroy(dns_capture_t *capture) {
+#ifdef ISC_PLATFORM_USETHREADS
+	/* The writer drains the rings once more on its way out. */
+	LOCK(&capture->lock);
+	capture->exiting = ISC_TRUE;
+	SIGNAL(&capture->cond);
+	UNLOCK(&capture->lock);
+	(void)isc_thread_join(capture->thread, NULL);
+	(void)isc_condition_destroy(&capture->cond);
+#else
+	drain(capture);
+#endif
+
+	if (capture->fp != NULL)
+		(void)isc_stdio_close(capture->fp);
+#ifdef ISC_PLATFORM_HAVESYSUNH
+	if (capture->fd != -1)
+		(void)close(capture->fd);
+#endif
+	DESTROYLOCK(&capture->lock);
+	isc_refcount_destroy(&capture->references);
+	isc_ringbuf_destroy(&capture->ringbuf);
+	isc_mem_free(capture->mctx, capture->path);
+	capture->magic = 0;
+	isc_mem_putanddetach(&capture->mctx, capture, sizeof(*capture));
+}
+
+void
+dns_capture_detach(dns_capture_t **capturep) {
+	dns_capture_t *capture;
+	unsigned int refs;
+
+	REQUIRE(capturep != NULL && VALID_CAPTURE(*capturep));
+	capture = *capturep;
+	*capturep = NULL;
+
+	isc_refcount_decrement(&capture->references, &refs);
+	if (refs == 0)
+		destroy(capture);
+}
+
+isc_boolean_t
+dns_capture_matches(dns_capture_t *capture, dns_captureoutput_t output,
+		    const char *path)
+{
+	REQUIRE(VALID_CAPTURE(capture));
+	REQUIRE(path != NULL);
+
+	return (ISC_TF(capture->output == output &&
+		       strcmp(capture->path, path) == 0));
+}
+
+static void
+putaddr(isc_buffer_t *b, const isc_sockaddr_t *sa, int pf) {
+	if (sa == NULL || isc_sockaddr_pf(sa) != pf) {
+		isc_buffer_putuint16(b, 0);
+		if (pf == PF_INET)
+			isc_buffer_putuint32(b, 0);
+		else if (pf == PF_INET6) {
+			isc_buffer_putuint32(b, 0);
+			isc_buffer_putuint32(b, 0);
+			isc_buffer_putuint32(b, 0);
+			isc_buffer_putuint32(b, 0);
+		}
+		return;
+	}
+	isc_buffer_putuint16(b, isc_sockaddr_getport(sa));
+	if (pf == PF_INET)
+		isc_buffer_putmem(b, (const unsigned char *)
+				  &sa->type.sin.sin_addr, 4);
+	else
+		isc_buffer_putmem(b, (const unsigned char *)
+				  &sa->type.sin6.sin6_addr, 16);
+}
+
+void
+dns_capture_message(dns_capture_t *capture, dns_capturetype_t type,
+		    isc_boolean_t tcp, const isc_sockaddr_t *qaddr,
+		    const isc_sockaddr_t *raddr, const isc_time_t *when,
+		    const isc_region_t *message)
+{
+	unsigned char header[DNS_CAPTURE_FRAMEHEADER];
+	isc_buffer_t b;
+	isc_region_t r[2];
+	isc_time_t now;
+	isc_boolean_t wake;
+	int pf = 0;
+
+	REQUIRE(VALID_CAPTURE(capture));
+	REQUIRE(message != NULL);
+
+	if (when == NULL) {
+		TIME_NOW(&now);
+		when = &now;
+	}
+	if (qaddr != NULL)
+		pf = isc_sockaddr_pf(qaddr);
+	else if (raddr != NULL)
+		pf = isc_sockaddr_pf(raddr);
+	if (pf != PF_INET && pf != PF_INET6)
+		pf = 0;
+
+	isc_buffer_init(&b, header, sizeof(header));
+	isc_buffer_putuint32(&b, 0);
+	isc_buffer_putuint8(&b, (isc_uint8_t)type);
+	isc_buffer_putuint8(&b, tcp ? DNS_CAPTURE_F_TCP : 0);
+	isc_buffer_putuint8(&b, pf == PF_INET6 ? 6 : (pf == PF_INET ? 4 : 0));
+	isc_buffer_putuint8(&b, 0);
+	isc_buffer_putuint32(&b, isc_time_seconds(when));
+	isc_buffer_putuint32(&b, isc_time_nanoseconds(when) / 1000);
+	putaddr(&b, qaddr, pf);
+	putaddr(&b, raddr, pf);
+
+	r[0].base = header;
+	r[0].length = isc_buffer_usedlength(&b);
+	r[1] = *message;
+	header[0] = ((r[0].length + r[1].length) >> 24) & 0xff;
+	header[1] = ((r[0].length + r[1].length) >> 16) & 0xff;
+	header[2] = ((r[0].length + r[1].length) >> 8) & 0xff;
+	header[3] = (r[0].length + r[1].length) & 0xff;
+
+	if (isc_ringbuf_putv(capture->ringbuf, r, 2, &wake) != ISC_R_SUCCESS)
+		return;
+
+#ifdef ISC_PLATFORM_USETHREADS
+	/*
+	 * Wake the writer early when the ring passes half full.  A
+	 * missed wakeup only delays the writer until its next timeout.
+	 */
+	if (wake)
+		SIGNAL(&capture->cond);
+#else
+	{
+		isc_stdtime_t stdnow;
+
+		isc_stdtime_get(&stdnow);
+		if (wake || stdnow != capture->flushed) {
+			drain(capture);
+			capture->flushed = stdnow;
+		}
+	}
+#endif
+}
+
+isc_uint64_t
+dns_capture_dropped(dns_capture_t *capture) {
+	isc_uint64_t lost;
+
+	REQUIRE(VALID_CAPTURE(capture));
+
+	LOCK(&capture->lock);
+	lost = capture->lost;
+	UNLOCK(&capture->lock);
+	return (lost + isc_ringbuf_dropped(capture->ringbuf));
+}
@@ -26,7 +26,9 @@
 #include <config.h>
 
 #include <isc/buffer.h>
+#include <isc/atomic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/once.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
@@ -77,9 +79,20 @@ static dns_dbimplementation_t rbtimp;
 static dns_dbimplementation_t rbt64imp;
 #endif
 
+/*%
+ * See dns_db_generation().
+ */
+static isc_int32_t generation = 0;
+#if defined(ISC_PLATFORM_USETHREADS) && !defined(ISC_PLATFORM_HAVEXADD)
+static isc_mutex_t genlock;
+#endif
+
 static void
 initialize(void) {
 	RUNTIME_CHECK(isc_rwlock_init(&implock, 0, 0) == ISC_R_SUCCESS);
+#if defined(ISC_PLATFORM_USETHREADS) && !defined(ISC_PLATFORM_HAVEXADD)
+	RUNTIME_CHECK(isc_mutex_init(&genlock) == ISC_R_SUCCESS);
+#endif
 
 	rbtimp.name = "rbt";
 	rbtimp.create = dns_rbtdb_create;
@@ -459,6 +472,8 @@ dns_db_closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	REQUIRE(versionp != NULL && *versionp != NULL);
 
 	(db->methods->closeversion)(db, versionp, commit);
+	if (commit)
+		dns_db_newgeneration();
 
 	ENSURE(*versionp == NULL);
 }
@@ -1025,3 +1040,37 @@ dns_db_rpz_findips(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		(db->methods->rpz_findips)(rpz, rpz_type, zone, db, version,
 					   ardataset, st, query_qname);
 }
+
+void
+dns_db_rpz_setsummary(dns_db_t *db, dns_rpz_summary_t *summary, int num) {
+	if (db->methods->rpz_setsummary != NULL)
+		(db->methods->rpz_setsummary)(db, summary, num);
+}
+
+void
+dns_db_setslabstore(dns_db_t *db, dns_slabstore_t *store) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(store != NULL);
+
+	if (db->methods->setslabstore != NULL)
+		(db->methods->setslabstore)(db, store);
+}
+
+isc_uint32_t
+dns_db_generation(void) {
+	return ((isc_uint32_t)generation);
+}
+
+void
+dns_db_newgeneration(void) {
+#if defined(ISC_PLATFORM_USETHREADS) && !defined(ISC_PLATFORM_HAVEXADD)
+	RUNTIME_CHECK(isc_once_do(&once, initialize) == ISC_R_SUCCESS);
+	LOCK(&genlock);
+	generation++;
+	UNLOCK(&genlock);
+#elif defined(ISC_PLATFORM_HAVEXADD)
+	isc_atomic_xadd(&generation, 1);
+#else
+	generation++;
+#endif
+}
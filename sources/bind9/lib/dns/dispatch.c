@@ -3634,6 +3634,32 @@ dns_dispatch_getentrysocket(dns_dispentry_t *resp) {
 		return (NULL);
 }
 
+isc_result_t
+dns_dispatch_getentrylocaladdress(dns_dispentry_t *resp,
+				  isc_sockaddr_t *addrp)
+{
+	dns_dispatch_t *disp;
+
+	REQUIRE(VALID_RESPONSE(resp));
+	REQUIRE(addrp != NULL);
+
+	disp = resp->disp;
+	if (disp->socktype != isc_sockettype_udp)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	/*
+	 * The entry's port is the one its socket was bound to when the
+	 * dispatch picked it; otherwise the dispatch's address has it,
+	 * unless the kernel chose.
+	 */
+	*addrp = disp->local;
+	if (resp->port != 0)
+		isc_sockaddr_setport(addrp, resp->port);
+	if (isc_sockaddr_getport(addrp) == 0)
+		return (ISC_R_NOTFOUND);
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_dispatch_getlocaladdress(dns_dispatch_t *disp, isc_sockaddr_t *addrp) {
 
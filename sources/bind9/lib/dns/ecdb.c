@@ -583,7 +583,9 @@ static dns_dbmethods_t ecdb_methods = {
 	NULL,			/* rpz_enabled */
 	NULL,			/* rpz_findips */
 	NULL,			/* findnodeext */
-	NULL			/* findext */
+	NULL,			/* findext */
+	NULL,			/* rpz_setsummary */
+	NULL			/* setslabstore */
 };
 
 static isc_result_t
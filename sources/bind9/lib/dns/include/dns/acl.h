@@ -143,6 +143,22 @@ dns_acl_merge(dns_acl_t *dest, dns_acl_t *source, isc_boolean_t pos);
  * an unexpected positive match in the parent ACL.
  */
 
+isc_result_t
+dns_acl_compile(dns_acl_t *acl);
+/*%<
+ * Prepare the IP prefixes of 'acl' for fast matching.  This should be
+ * done once the ACL is complete and before it is shared: adding to or
+ * merging into it afterwards discards the compiled form, and matching
+ * falls back to the slower search until it is compiled again.
+ *
+ * Requires:
+ *\li	'acl' to be a valid acl.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
 void
 dns_acl_attach(dns_acl_t *source, dns_acl_t **target);
 /*%<
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_CAPTURE_H
+#define DNS_CAPTURE_H 1
+
+/*! \file dns/capture.h
+ * \brief
+ * Binary capture of DNS messages.
+ *
+ * A capture records whole DNS messages as they are received or sent,
+ * with their time and the addresses involved, as length-prefixed
+ * frames.  Frames are copied into the per-thread ring buffers of an
+ * isc_ringbuf_t and written to a file or a Unix domain stream socket by
+ * a thread of the capture's own, so capturing never waits for the
+ * output; when the rings are full frames are dropped and counted.
+ *
+ * The output starts with a header of DNS_CAPTURE_HEADERLEN octets:
+ * the 8 octet magic DNS_CAPTURE_MAGIC, a 16 bit format version and 16
+ * bits of zero.  Each frame then consists of (integers in network byte
+ * order):
+ *
+ *\li	32 bits		frame length, including this field
+ *\li	8 bits		dns_capturetype_t
+ *\li	8 bits		DNS_CAPTURE_F_* flags
+ *\li	8 bits		address family: 4, 6 or 0 (unknown)
+ *\li	8 bits		zero
+ *\li	32 bits		time, seconds since the epoch
+ *\li	32 bits		time, microseconds
+ *\li	16 bits		port of the querying side
+ *\li	0, 4 or 16	address of the querying side
+ *\li	16 bits		port of the responding side
+ *\li	0, 4 or 16	address of the responding side
+ *\li	the rest	the DNS message, as on the wire
+ *
+ * A socket reader is sent the header each time the writer connects.
+ * If the socket cannot be connected, or the connection is lost, frames
+ * are dropped until a new connection succeeds; connecting is retried
+ * at most once a second.
+ */
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+#define DNS_CAPTURE_MAGIC		"BIND9CAP"
+#define DNS_CAPTURE_VERSION		1
+#define DNS_CAPTURE_HEADERLEN		12
+#define DNS_CAPTURE_FRAMEHEADER		52	/*%< maximum; IPv6 */
+
+#define DNS_CAPTURE_F_TCP		0x01
+
+#define DNS_CAPTURE_CLIENT	(dns_capturetype_clientquery | \
+				 dns_capturetype_clientresponse)
+#define DNS_CAPTURE_RESOLVER	(dns_capturetype_resolverquery | \
+				 dns_capturetype_resolverresponse)
+#define DNS_CAPTURE_QUERY	(dns_capturetype_clientquery | \
+				 dns_capturetype_resolverquery)
+#define DNS_CAPTURE_RESPONSE	(dns_capturetype_clientresponse | \
+				 dns_capturetype_resolverresponse)
+#define DNS_CAPTURE_ALL		(DNS_CAPTURE_CLIENT | DNS_CAPTURE_RESOLVER)
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_capture_create(isc_mem_t *mctx, dns_captureoutput_t output,
+		   const char *path, unsigned int nrings,
+		   dns_capture_t **capturep);
+/*%<
+ * Create a capture writing to the file or socket 'path', and start its
+ * writer thread.  'nrings' threads get a ring buffer of their own; any
+ * further thread shares one more ring, under a lock.
+ *
+ * A file is appended to.  A socket need not be listening yet.
+ *
+ * Requires:
+ *\li	'path' is not NULL.
+ *\li	'nrings' > 0.
+ *\li	capturep != NULL && *capturep == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_NOTIMPLEMENTED	Unix domain sockets are not supported.
+ *\li	#ISC_R_NOSPACE		'path' is too long for a socket name.
+ *\li	any error opening the file or starting the writer thread.
+ */
+
+void
+dns_capture_attach(dns_capture_t *source, dns_capture_t **targetp);
+
+void
+dns_capture_detach(dns_capture_t **capturep);
+/*%<
+ * Detach from a capture.  On the last detach the writer thread is
+ * stopped after writing out whatever is queued, and the output closed.
+ */
+
+isc_boolean_t
+dns_capture_matches(dns_capture_t *capture, dns_captureoutput_t output,
+		    const char *path);
+/*%<
+ * Return ISC_TRUE if 'capture' writes to 'output' at 'path', so that a
+ * reconfiguration can keep it.
+ */
+
+void
+dns_capture_message(dns_capture_t *capture, dns_capturetype_t type,
+		    isc_boolean_t tcp, const isc_sockaddr_t *qaddr,
+		    const isc_sockaddr_t *raddr, const isc_time_t *when,
+		    const isc_region_t *message);
+/*%<
+ * Queue a frame for 'message', which was sent or received at 'when'
+ * (now if NULL) between the querying side 'qaddr' and the responding
+ * side 'raddr'.  Either address may be NULL if it is not known.  Never
+ * blocks; if the calling thread's ring is full the frame is dropped.
+ */
+
+isc_uint64_t
+dns_capture_dropped(dns_capture_t *capture);
+/*%<
+ * Return the number of frames dropped so far, whether because a ring
+ * was full or because they could not be written.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_CAPTURE_H */
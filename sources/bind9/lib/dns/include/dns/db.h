@@ -194,6 +194,11 @@ typedef struct dns_dbmethods {
 				   dns_clientinfo_t *clientinfo,
 				   dns_rdataset_t *rdataset,
 				   dns_rdataset_t *sigrdataset);
+	void		(*rpz_setsummary)(dns_db_t *db,
+					  dns_rpz_summary_t *summary,
+					  int num);
+	void		(*setslabstore)(dns_db_t *db,
+					dns_slabstore_t *store);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -1568,6 +1573,44 @@ dns_db_rpz_findips(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
  *	    or NULL, an empty name, 0, DNS_RPZ_POLICY_MISS, and 0
  */
 
+void
+dns_db_rpz_setsummary(dns_db_t *db, dns_rpz_summary_t *summary, int num);
+/*%<
+ * Report the triggers of a database marked for response policy rewriting
+ * to 'summary' as those of policy zone 'num'.
+ */
+
+void
+dns_db_setslabstore(dns_db_t *db, dns_slabstore_t *store);
+/*%<
+ * Make the new zone database 'db' keep its rdata in the shared 'store'
+ * (see dns/slabstore.h).  This must be done before anything is added
+ * to 'db'; databases that do not support sharing ignore the call.
+ *
+ * Requires:
+ * \li	'db' is a valid zone database.
+ * \li	'store' is a valid slab store.
+ */
+
+isc_uint32_t
+dns_db_generation(void);
+/*%<
+ * Return a counter that changes whenever the data visible to
+ * authoritative lookups may have changed: a new version of a zone
+ * database was committed, a database was attached to or detached from a
+ * zone, or a zone was added to or removed from a zone table.
+ *
+ * Anything derived from zone data and stamped with the generation read
+ * before the lookups may be reused while the generation is unchanged.
+ */
+
+void
+dns_db_newgeneration(void);
+/*%<
+ * Advance the counter returned by dns_db_generation().  Call it after
+ * the change has become visible to lookups.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* DNS_DB_H */
@@ -458,6 +458,24 @@ dns_dispatch_getsocket(dns_dispatch_t *disp);
  *\li	The socket the dispatcher is using.
  */
 
+isc_result_t
+dns_dispatch_getentrylocaladdress(dns_dispentry_t *resp,
+				  isc_sockaddr_t *addrp);
+/*%<
+ * Return the local address, including the port, that the query of
+ * 'resp' is sent from, without asking the socket.  This currently only
+ * works for UDP dispatches.
+ *
+ * Requires:
+ *\li	resp is valid.
+ *\li	addrp to be non null.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTFOUND		the kernel chose the port.
+ *\li	ISC_R_NOTIMPLEMENTED
+ */
+
 isc_result_t
 dns_dispatch_getlocaladdress(dns_dispatch_t *disp, isc_sockaddr_t *addrp);
 /*%<
@@ -79,6 +79,9 @@
 #define DNS_EVENT_ZONELOAD			(ISC_EVENTCLASS_DNS + 49)
 #define DNS_EVENT_KEYDONE			(ISC_EVENTCLASS_DNS + 50)
 #define DNS_EVENT_SETNSEC3PARAM			(ISC_EVENTCLASS_DNS + 51)
+#define DNS_EVENT_ZONESIGNBATCH			(ISC_EVENTCLASS_DNS + 52)
+#define DNS_EVENT_ZONETIMER			(ISC_EVENTCLASS_DNS + 53)
+#define DNS_EVENT_ZONESIGNDONE			(ISC_EVENTCLASS_DNS + 54)
 
 #define DNS_EVENT_FIRSTEVENT			(ISC_EVENTCLASS_DNS + 0)
 #define DNS_EVENT_LASTEVENT			(ISC_EVENTCLASS_DNS + 65535)
@@ -25,11 +25,14 @@
 
 #include <dns/types.h>
 
+typedef struct dns_iptrie dns_iptrie_t;
+
 struct dns_iptable {
 	unsigned int		magic;
 	isc_mem_t		*mctx;
 	isc_refcount_t		refcount;
 	isc_radix_tree_t	*radix;
+	dns_iptrie_t		*trie;		/*%< compiled 'radix', or NULL */
 	ISC_LINK(dns_iptable_t)	nextincache;
 };
 
@@ -61,6 +64,31 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, isc_boolean_t pos);
  * Merge one IP table into another one.
  */
 
+isc_result_t
+dns_iptable_compile(dns_iptable_t *tab);
+/*%<
+ * Build a read-only copy of the table that dns_iptable_search() can
+ * search in a few cache lines, without following the radix tree.  It
+ * is discarded when a prefix is added to the table or another table
+ * is merged into it.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_RANGE	the table is too large to be worth compiling;
+ *			searches keep using the radix tree.
+ */
+
+void
+dns_iptable_search(const dns_iptable_t *tab, const isc_netaddr_t *addr,
+		   int *match);
+/*%<
+ * Look up the host address 'addr' in 'tab'.  '*match' is set to the
+ * node number of the first prefix added to the table that contains
+ * 'addr', negated if it was a negative entry, or to zero if there is
+ * none.
+ */
+
 void
 dns_iptable_attach(dns_iptable_t *source, dns_iptable_t **target);
 
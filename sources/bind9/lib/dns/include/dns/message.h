@@ -169,6 +169,10 @@ typedef int dns_messagetextflag_t;
 						   source buffer */
 #define DNS_MESSAGEPARSE_IGNORETRUNCATION 0x0008 /*%< truncation errors are
 						  * not fatal. */
+#define DNS_MESSAGEPARSE_LAZY		0x0010	/*%< decode the answer,
+						   authority and additional
+						   sections when first
+						   used */
 
 /*
  * Control behavior of rendering
@@ -254,6 +258,11 @@ struct dns_message {
 
 	dns_rdatasetorderfunc_t		order;
 	const void *			order_arg;
+
+	unsigned int			parseoptions;
+	unsigned int			pending[DNS_SECTION_MAX];
+	unsigned int			pendingcount[DNS_SECTION_MAX];
+	isc_result_t			pendingresult[DNS_SECTION_MAX];
 };
 
 struct dns_ednsopt {
@@ -439,6 +448,19 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  * If #DNS_MESSAGEPARSE_IGNORETRUNCATION is set then return as many complete
  * RR's as possible, DNS_R_RECOVERABLE will be returned.
  *
+ * If #DNS_MESSAGEPARSE_LAZY is set, the records of the answer, authority
+ * and additional sections are checked as they would be otherwise, so
+ * the same messages are rejected with the same errors, but they are
+ * not kept: they are decoded again the first time they are used
+ * through dns_message_firstname(), dns_message_findname() or
+ * dns_message_sectiontotext().  OPT and TSIG records at the end of a
+ * section are still decoded at once.  A section holding a SIG record,
+ * or an OPT or TSIG record elsewhere, is decoded in full, as are all
+ * sections of messages without a question and of UPDATE messages.
+ * The wire data must stay in place until the message is reset, unless
+ * #DNS_MESSAGEPARSE_CLONEBUFFER is also set.
+ * Code that walks msg->sections[] directly must not use this option.
+ *
  * OPT and TSIG records are always handled specially, regardless of the
  * 'preserve_order' setting.
  *
@@ -638,6 +660,9 @@ dns_message_firstname(dns_message_t *msg, dns_section_t section);
  * Returns:
  *\li	#ISC_R_SUCCESS		-- All is well.
  *\li	#ISC_R_NOMORE		-- No names on given section.
+ *\li	#ISC_R_NOMEMORY		-- A section left pending by
+ *				   #DNS_MESSAGEPARSE_LAZY could not be
+ *				   decoded.
  */
 
 isc_result_t
@@ -717,6 +742,9 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
  *\li	#DNS_R_NXDOMAIN		-- name does not exist in that section.
  *\li	#DNS_R_NXRRSET		-- The name does exist, but the desired
  *				   type does not.
+ *\li	#ISC_R_NOMEMORY		-- A section left pending by
+ *				   #DNS_MESSAGEPARSE_LAZY could not be
+ *				   decoded.
  */
 
 isc_result_t
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*! \file dns/respcache.h
+ * \brief A cache of rendered responses.
+ *
+ * An authoritative server answers the same few questions over and over
+ * with the same bytes.  A response cache keeps the rendered response to
+ * a query under a key chosen by the caller (typically the question and
+ * the header and EDNS bits that shape the answer) so that a repeated
+ * query can be answered by copying the response and patching its ID.
+ *
+ * Each entry records:
+ *
+ *\li	the generation of the zone data it was built from (see
+ *	dns_db_generation()); an entry of any other generation is stale
+ *	and is dropped when it is found.
+ *
+ *\li	up to #DNS_RESPCACHE_MAXCONDS ACLs the answer depended on, with
+ *	their outcome; the entry is only used for clients that get the
+ *	same outcome.
+ *
+ *\li	the zone the answer came from, if any, and a tag for the caller.
+ *
+ * The cache has a fixed number of slots; an entry replaces whatever was
+ * in its slot.
+ *
+ * All operations are thread safe.
+ */
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+#define DNS_RESPCACHE_MAXCONDS	4
+
+typedef struct dns_respcachecond {
+	dns_acl_t	*acl;
+	isc_boolean_t	destination;	/*%< match the destination address */
+	isc_boolean_t	allowed;	/*%< the outcome for the response */
+} dns_respcachecond_t;
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int size,
+		     dns_respcache_t **cachep);
+/*%<
+ * Create an empty response cache with room for 'size' responses,
+ * rounded up to a power of two.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'size' > 0.
+ *\li	'cachep' != NULL && '*cachep' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOMEMORY
+ */
+
+void
+dns_respcache_attach(dns_respcache_t *source, dns_respcache_t **targetp);
+
+void
+dns_respcache_detach(dns_respcache_t **cachep);
+/*%<
+ * The cache, and the zone and ACL references held by its entries, are
+ * released when the last reference is detached.
+ */
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *cache, const isc_region_t *key,
+		  isc_uint32_t generation, const isc_region_t *response,
+		  const dns_respcachecond_t *conds, unsigned int nconds,
+		  dns_zone_t *zone, isc_uint32_t tag);
+/*%<
+ * Store a copy of 'response' under 'key', replacing the entry in its
+ * slot.  The entry holds references to 'zone' (which may be NULL) and to
+ * the ACLs of the 'nconds' conditions.
+ *
+ * 'generation' must have been read before any of the data in 'response'
+ * was looked up.
+ *
+ * Requires:
+ *\li	'key' and 'response' are not empty.
+ *\li	'nconds' <= #DNS_RESPCACHE_MAXCONDS.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOMEMORY
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const isc_region_t *key,
+		   isc_uint32_t generation, const isc_netaddr_t *source,
+		   const isc_netaddr_t *destination, const dns_aclenv_t *env,
+		   isc_buffer_t *target, dns_zone_t **zonep,
+		   isc_uint32_t *tagp);
+/*%<
+ * Copy the response stored under 'key' to 'target' if it was built from
+ * zone data of the current 'generation' and each of its ACL conditions
+ * has the same outcome for 'source' and 'destination' (matched without
+ * a signer in 'env').  On success the zone of the entry is attached to
+ * '*zonep' (which is left NULL for an entry without a zone) and its tag
+ * stored in '*tagp'.
+ *
+ * Requires:
+ *\li	'zonep' != NULL && '*zonep' == NULL.
+ *\li	'tagp' != NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTFOUND	no usable entry.
+ *\li	ISC_R_NOSPACE	the response does not fit in 'target'; nothing
+ *			was copied.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
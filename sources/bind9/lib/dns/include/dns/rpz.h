@@ -85,6 +85,26 @@ struct dns_rpz_zone {
  */
 typedef struct dns_rpz_cidr	dns_rpz_cidr_t;
 
+/*
+ * Summary of the triggers of all of the policy zones of a view.
+ * Bit N of a dns_rpz_zbits_t stands for the policy zone with num N.
+ * Policy zones after the first DNS_RPZ_SUMMARY_ZONES are not summarized
+ * and must always be searched.
+ */
+typedef struct dns_rpz_summary	dns_rpz_summary_t;
+typedef struct dns_rpz_snapshot	dns_rpz_snapshot_t;
+typedef isc_uint64_t		dns_rpz_zbits_t;
+#define DNS_RPZ_SUMMARY_ZONES	64
+#define DNS_RPZ_ALL_ZBITS	((dns_rpz_zbits_t)-1)
+#define DNS_RPZ_ZBIT(num)	((num) < DNS_RPZ_SUMMARY_ZONES ?	\
+				 (dns_rpz_zbits_t)1 << (num) : 0)
+/*
+ * ISC_TRUE if policy zone 'num' cannot have a trigger in 'zbits'.
+ */
+#define DNS_RPZ_SUMMARY_MISS(zbits, num)				\
+	((num) < DNS_RPZ_SUMMARY_ZONES &&				\
+	 ((zbits) & ((dns_rpz_zbits_t)1 << (num))) == 0)
+
 /*
  * context for finding the best policy
  */
@@ -147,6 +167,10 @@ typedef struct {
 	dns_fixedname_t		_qnamef;
 	dns_fixedname_t		_r_namef;
 	dns_fixedname_t		_fnamef;
+	/*
+	 * The summary of the policy zones when the query started.
+	 */
+	dns_rpz_snapshot_t	*snapshot;
 } dns_rpz_st_t;
 
 #define DNS_RPZ_TTL_DEFAULT		5
@@ -189,11 +213,134 @@ dns_rpz_cidr_deleteip(dns_rpz_cidr_t *cidr, dns_name_t *name);
 void
 dns_rpz_cidr_addip(dns_rpz_cidr_t *cidr, dns_name_t *name);
 
+void
+dns_rpz_cidr_updated(dns_rpz_cidr_t *cidr, isc_uint64_t usecs);
+/*%<
+ * Record that applying a committed update to the policy zone database
+ * owning 'cidr' took 'usecs' microseconds, and let queries use the
+ * triggers of the update.  The tree write lock of the database must be
+ * held.
+ */
+
+void
+dns_rpz_cidr_publish(dns_rpz_cidr_t *cidr);
+/*%<
+ * Let queries use the triggers reported by the policy zone database
+ * owning 'cidr', such as when it has been loaded.
+ */
+
+isc_boolean_t
+dns_rpz_cidr_incomplete(dns_rpz_cidr_t *cidr);
+/*%<
+ * ISC_TRUE if the summary of the policy zone database owning 'cidr'
+ * lacks some of its triggers, and so cannot skip the zone until the
+ * database reports each of its names with dns_rpz_cidr_summarize()
+ * and then calls dns_rpz_cidr_summarized().  The tree write lock of
+ * the database must be held.
+ */
+
+isc_result_t
+dns_rpz_cidr_summarize(dns_rpz_cidr_t *cidr, dns_name_t *name);
+/*%<
+ * Report the triggers of 'name' again to the summary.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY, and the summary is still incomplete.
+ */
+
+void
+dns_rpz_cidr_summarized(dns_rpz_cidr_t *cidr);
+/*%<
+ * Note that every name of the database has been reported to the
+ * summary without error.
+ */
+
 isc_result_t
 dns_rpz_cidr_find(dns_rpz_cidr_t *cidr, const isc_netaddr_t *netaddr,
 		  dns_rpz_type_t type, dns_name_t *canon_name,
 		  dns_name_t *search_name, dns_rpz_cidr_bits_t *prefix);
 
+isc_result_t
+dns_rpz_summary_create(isc_mem_t *mctx, dns_rpz_summary_t **summaryp);
+
+void
+dns_rpz_summary_attach(dns_rpz_summary_t *source, dns_rpz_summary_t **target);
+
+void
+dns_rpz_summary_detach(dns_rpz_summary_t **summaryp);
+
+void
+dns_rpz_summary_setupdatehisto(dns_rpz_summary_t *summary,
+			       isc_histo_t *histo);
+/*%<
+ * Set a histogram of the time in microseconds taken to apply updates
+ * to the policy zones of the summary.
+ *
+ * Requires:
+ *\li	'summary' does not have a histogram yet.
+ */
+
+isc_histo_t *
+dns_rpz_summary_getupdatehisto(dns_rpz_summary_t *summary);
+/*%<
+ * Return the histogram set by dns_rpz_summary_setupdatehisto(), or NULL.
+ */
+
+void
+dns_rpz_cidr_setsummary(dns_rpz_cidr_t *cidr, dns_rpz_summary_t *summary,
+			int num);
+/*%<
+ * Make the policy zone database owning 'cidr' report its triggers to
+ * 'summary' as those of policy zone 'num', copying those it has already
+ * reported to its previous summary, if any.  The previous summary
+ * searches the zone from then on.  The tree write lock of the database
+ * must be held.
+ */
+
+void
+dns_rpz_summary_current(dns_rpz_summary_t *summary,
+			dns_rpz_snapshot_t **snapshotp);
+/*%<
+ * Make '*snapshotp' the snapshot of 'summary' that new queries use,
+ * detaching any other snapshot in it.  The snapshot never changes,
+ * and the cost of a call is a comparison while it is still current.
+ *
+ * Requires:
+ *\li	'snapshotp' is not NULL, and '*snapshotp' is NULL or was set
+ *	by an earlier call.
+ *
+ * Ensures:
+ *\li	'*snapshotp' is NULL if 'summary' is NULL.
+ */
+
+void
+dns_rpz_snapshot_detach(dns_rpz_snapshot_t **snapshotp);
+
+dns_rpz_zbits_t
+dns_rpz_snapshot_names(dns_rpz_snapshot_t *snapshot, dns_rpz_type_t type,
+		       dns_name_t *name);
+/*%<
+ * Return the policy zones that might have a QNAME or NSDNAME ('type')
+ * trigger for 'name', either for the name itself or as a wildcard.
+ * A NULL 'snapshot' might have any trigger.
+ */
+
+dns_rpz_zbits_t
+dns_rpz_snapshot_ip(dns_rpz_snapshot_t *snapshot, dns_rpz_type_t type,
+		    const isc_netaddr_t *netaddr);
+/*%<
+ * Return the policy zones with an IP or NSIP ('type') trigger for a
+ * prefix containing 'netaddr'.
+ */
+
+void
+dns_rpz_snapshot_enabled(dns_rpz_snapshot_t *snapshot, dns_rpz_zbits_t zbits,
+			 dns_rpz_st_t *st);
+/*%<
+ * Like dns_rpz_enabled_get() for all of the policy zones in 'zbits'.
+ */
+
 dns_rpz_policy_t
 dns_rpz_decode_cname(dns_rpz_zone_t *rpz, dns_rdataset_t *rdataset,
 		     dns_name_t *selfname);
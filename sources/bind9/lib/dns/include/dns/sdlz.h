@@ -370,6 +370,45 @@ dns_sdlz_setdb_t dns_sdlz_setdb;
  * Create the database pointers for a writeable SDLZ zone
  */
 
+isc_result_t
+dns_sdlz_setcache(dns_dlzdb_t *dlzdatabase, dns_ttl_t maxttl,
+		  dns_ttl_t maxncachettl, size_t maxsize, unsigned int threads);
+/*%<
+ * Cache the results of driver lookups made through 'dlzdatabase'.
+ * Answers are kept for their smallest TTL but no longer than 'maxttl';
+ * names the driver has no records for are kept for 'maxncachettl'.
+ * Once the cache holds about 'maxsize' bytes (0 is unlimited) the
+ * least recently used entries are dropped.  If 'threads' is not zero
+ * and threads are available, that many threads look up again entries
+ * in the last quarter of their life that are still being asked for,
+ * so they are renewed before they expire.
+ *
+ * The cache ignores the client: it must not be used with drivers whose
+ * answers depend on who is asking.  Updates through the database flush
+ * the updated zone's entries; changes made to the backend directly are
+ * not seen until entries expire or dns_sdlz_flushcache() is called.
+ *
+ * Requires:
+ *\li	'dlzdatabase' is a valid DLZ database not yet in use and without
+ *	a cache.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTIMPLEMENTED	'dlzdatabase' is not an SDLZ driver.
+ *\li	ISC_R_NOMEMORY
+ */
+
+isc_result_t
+dns_sdlz_flushcache(dns_dlzdb_t *dlzdatabase, dns_name_t *name);
+/*%<
+ * Drop cached results for 'name' in any zone, or all of them if 'name'
+ * is NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTFOUND	'dlzdatabase' has no cache.
+ */
+
 
 ISC_LANG_ENDDECLS
 
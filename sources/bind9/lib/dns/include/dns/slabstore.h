@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_SLABSTORE_H
+#define DNS_SLABSTORE_H 1
+
+/*! \file dns/slabstore.h
+ * \brief Reference counted rdataslab bodies shared between databases.
+ *
+ * Servers with many zones hold the same RRsets over and over: the NS
+ * RRset of a hosting provider, its MX RRset, the address of its web
+ * server.  A slab store keeps a single copy of each distinct rdataslab
+ * (the slab without its reserved area, see dns/rdataslab.h) and hands
+ * out references to it.  Databases intern a slab when they add it and
+ * release it when they free it; the copy is freed with the last
+ * reference.
+ *
+ * Slabs are compared byte for byte, so the rdata order recorded in a
+ * slab is part of its identity.
+ *
+ * All operations are thread safe.
+ */
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+typedef struct dns_slabstorestats {
+	isc_uint64_t	lookups;	/*%< calls to dns_slabstore_intern() */
+	isc_uint64_t	hits;		/*%< ... that found a stored slab */
+	isc_uint64_t	entries;	/*%< distinct slabs stored */
+	isc_uint64_t	references;	/*%< references to them */
+	isc_uint64_t	bytes;		/*%< size of the distinct slabs */
+	isc_uint64_t	saved;		/*%< size of the copies not made */
+} dns_slabstorestats_t;
+
+isc_result_t
+dns_slabstore_create(isc_mem_t *mctx, dns_slabstore_t **storep);
+/*%<
+ * Create an empty slab store.  Stored slabs are allocated from 'mctx',
+ * so a memory context of its own shows what the store uses.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'storep' != NULL && '*storep' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOMEMORY
+ */
+
+void
+dns_slabstore_attach(dns_slabstore_t *source, dns_slabstore_t **targetp);
+
+void
+dns_slabstore_detach(dns_slabstore_t **storep);
+/*%<
+ * The store is destroyed when the last reference is detached.  All
+ * interned slabs must have been released by then.
+ */
+
+isc_result_t
+dns_slabstore_intern(dns_slabstore_t *store, const unsigned char *slab,
+		     unsigned int length, unsigned char **slabp);
+/*%<
+ * Find the stored copy of the 'length' bytes at 'slab', storing a copy
+ * if there is none, and return it with a new reference in '*slabp'.
+ * The caller keeps ownership of 'slab'.
+ *
+ * Requires:
+ *\li	'length' > 0.
+ *\li	'slabp' != NULL && '*slabp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOMEMORY
+ */
+
+void
+dns_slabstore_release(dns_slabstore_t *store, unsigned char **slabp);
+/*%<
+ * Release a reference returned by dns_slabstore_intern() and set
+ * '*slabp' to NULL.
+ */
+
+void
+dns_slabstore_getstats(dns_slabstore_t *store, dns_slabstorestats_t *stats);
+/*%<
+ * Copy the current counters of 'store' to 'stats'.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SLABSTORE_H */
@@ -49,6 +49,7 @@ typedef void					dns_clientrestrans_t;
 typedef void					dns_clientreqtrans_t;
 typedef void					dns_clientupdatetrans_t;
 typedef struct dns_cache			dns_cache_t;
+typedef struct dns_capture			dns_capture_t;
 typedef isc_uint16_t				dns_cert_t;
 typedef struct dns_compress			dns_compress_t;
 typedef struct dns_db				dns_db_t;
@@ -113,10 +114,12 @@ typedef isc_uint16_t				dns_rdatatype_t;
 typedef struct dns_request			dns_request_t;
 typedef struct dns_requestmgr			dns_requestmgr_t;
 typedef struct dns_resolver			dns_resolver_t;
+typedef struct dns_respcache			dns_respcache_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef isc_uint8_t				dns_secalg_t;
 typedef isc_uint8_t				dns_secproto_t;
 typedef struct dns_signature			dns_signature_t;
+typedef struct dns_slabstore			dns_slabstore_t;
 typedef struct dns_ssurule			dns_ssurule_t;
 typedef struct dns_ssutable			dns_ssutable_t;
 typedef struct dns_stats			dns_stats_t;
@@ -198,6 +201,18 @@ typedef enum {
 	dns_v4_aaaa_break_dnssec = 2
 } dns_v4_aaaa_t;
 
+typedef enum {
+	dns_capturetype_clientquery = 0x01,
+	dns_capturetype_clientresponse = 0x02,
+	dns_capturetype_resolverquery = 0x04,
+	dns_capturetype_resolverresponse = 0x08
+} dns_capturetype_t;
+
+typedef enum {
+	dns_captureoutput_file = 0,
+	dns_captureoutput_unix = 1
+} dns_captureoutput_t;
+
 /*
  * These are generated by gen.c.
  */
@@ -111,6 +111,10 @@ struct dns_view {
 	isc_event_t			reqevent;
 	isc_stats_t *			resstats;
 	dns_stats_t *			resquerystats;
+	isc_histo_t *			latencyhisto;
+	dns_capture_t *			capture;
+	unsigned int			capturetypes;
+	dns_respcache_t *		respcache;
 	isc_boolean_t			cacheshared;
 
 	/* Configurable data. */
@@ -166,6 +170,7 @@ struct dns_view {
 	dns_dns64list_t 		dns64;
 	unsigned int 			dns64cnt;
 	ISC_LIST(dns_rpz_zone_t)	rpz_zones;
+	dns_rpz_summary_t		*rpz_summary;
 	isc_boolean_t			rpz_recursive_only;
 	isc_boolean_t			rpz_break_dnssec;
 	unsigned int			rpz_min_ns_labels;
@@ -1012,6 +1017,59 @@ dns_view_getresquerystats(dns_view_t *view, dns_stats_t **statsp);
  *\li	'statsp' != NULL && '*statsp' != NULL
  */
 
+void
+dns_view_setlatencyhisto(dns_view_t *view, isc_histo_t *histo);
+/*%<
+ * Set a histogram of the time taken to answer clients of 'view'.  It is
+ * attached to the view but is only updated by the caller.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ *
+ *\li	'histo' is valid.
+ */
+
+void
+dns_view_getlatencyhisto(dns_view_t *view, isc_histo_t **histop);
+/*%<
+ * Get the latency histogram for 'view'.  If one is set '*histop' will be
+ * attached to it; otherwise, '*histop' will be untouched.
+ *
+ * Requires:
+ * \li	'view' is valid.
+ *
+ *\li	'histop' != NULL && '*histop' == NULL
+ */
+
+void
+dns_view_setcapture(dns_view_t *view, dns_capture_t *capture,
+		    unsigned int types);
+/*%<
+ * Capture the messages of 'view' whose dns_capturetype_t is in the
+ * mask 'types' to 'capture'.  The client and resolver code check
+ * view->capture and view->capturetypes before building a frame.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ *
+ *\li	'capture' is valid, and 'types' is not zero.
+ */
+
+void
+dns_view_setrespcache(dns_view_t *view, dns_respcache_t *respcache);
+/*%<
+ * Keep responses to queries in 'view' in 'respcache' (see
+ * dns/respcache.h).  The server checks view->respcache; the view only
+ * holds the reference, which is released as soon as the last strong
+ * reference to the view goes away so that the zones the cached
+ * responses refer to can be freed.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ *
+ *\li	'respcache' is valid.
+ */
+
 isc_boolean_t
 dns_view_iscacheshared(dns_view_t *view);
 /*%<
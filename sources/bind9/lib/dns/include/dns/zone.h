@@ -719,13 +719,13 @@ dns_zone_setaltxfrsource4(dns_zone_t *zone,
  *\li	#ISC_R_SUCCESS
  */
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getxfrsource4(dns_zone_t *zone);
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getaltxfrsource4(dns_zone_t *zone);
 /*%<
- *	Returns the source address set by a previous dns_zone_setxfrsource4
- *	call, or the default of inaddr_any, port 0.
+ *	Returns a copy of the source address set by a previous
+ *	dns_zone_setxfrsource4 call, or the default of inaddr_any, port 0.
  *
  * Require:
  *\li	'zone' to be a valid zone.
@@ -747,13 +747,13 @@ dns_zone_setaltxfrsource6(dns_zone_t *zone,
  *\li	#ISC_R_SUCCESS
  */
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getxfrsource6(dns_zone_t *zone);
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getaltxfrsource6(dns_zone_t *zone);
 /*%<
- *	Returns the source address set by a previous dns_zone_setxfrsource6
- *	call, or the default of in6addr_any, port 0.
+ *	Returns a copy of the source address set by a previous
+ *	dns_zone_setxfrsource6 call, or the default of in6addr_any, port 0.
  *
  * Require:
  *\li	'zone' to be a valid zone.
@@ -772,11 +772,11 @@ dns_zone_setnotifysrc4(dns_zone_t *zone, const isc_sockaddr_t *notifysrc);
  *\li	#ISC_R_SUCCESS
  */
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getnotifysrc4(dns_zone_t *zone);
 /*%<
- *	Returns the source address set by a previous dns_zone_setnotifysrc4
- *	call, or the default of inaddr_any, port 0.
+ *	Returns a copy of the source address set by a previous
+ *	dns_zone_setnotifysrc4 call, or the default of inaddr_any, port 0.
  *
  * Require:
  *\li	'zone' to be a valid zone.
@@ -795,11 +795,11 @@ dns_zone_setnotifysrc6(dns_zone_t *zone, const isc_sockaddr_t *notifysrc);
  *\li	#ISC_R_SUCCESS
  */
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getnotifysrc6(dns_zone_t *zone);
 /*%<
- *	Returns the source address set by a previous dns_zone_setnotifysrc6
- *	call, or the default of in6addr_any, port 0.
+ *	Returns a copy of the source address set by a previous
+ *	dns_zone_setnotifysrc6 call, or the default of in6addr_any, port 0.
  *
  * Require:
  *\li	'zone' to be a valid zone.
@@ -1448,6 +1448,19 @@ dns_zonemgr_setsize(dns_zonemgr_t *zmgr, int num_zones);
  *\li	zmgr->zonetasks has been initialized.
  */
 
+isc_result_t
+dns_zonemgr_setsigningtasks(dns_zonemgr_t *zmgr, unsigned int ntasks);
+/*%<
+ *	Set the number of tasks used to compute RRSIGs in parallel
+ *	while a zone is being signed incrementally.  The zone's own
+ *	task also computes signatures, so 'ntasks' is the number of
+ *	additional tasks; 0 disables parallel signing.  This may be
+ *	called again to resize the pool.
+ *
+ * Requires:
+ *\li	zmgr is a valid zone manager.
+ */
+
 isc_result_t
 dns_zonemgr_createzone(dns_zonemgr_t *zmgr, dns_zone_t **zonep);
 /*%<
@@ -1596,6 +1609,18 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr);
  *\li	'zmgr' to be a valid zone manager.
  */
 
+void
+dns_zonemgr_setslabstore(dns_zonemgr_t *zmgr, dns_slabstore_t *store);
+/*%<
+ *	Make the databases that zones of 'zmgr' load or transfer from now
+ *	on keep their rdata in 'store' (see dns/slabstore.h), or stop
+ *	sharing if 'store' is NULL.  Databases already in use keep the
+ *	store they were created with.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
 void
 dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value);
 /*%<
@@ -1730,6 +1755,17 @@ void
 dns_zone_setrcvquerystats(dns_zone_t *zone, dns_stats_t *stats);
 #endif
 
+void
+dns_zone_setlatencyhisto(dns_zone_t *zone, isc_histo_t *histo);
+/*%<
+ * Set a histogram of the time taken to answer queries for the zone.
+ * Like the statistics sets above it is only updated by the caller, and
+ * only installed while request statistics are enabled.
+ *
+ * Requires:
+ * \li	'zone' to be a valid zone.
+ */
+
 isc_stats_t *
 dns_zone_getrequeststats(dns_zone_t *zone);
 
@@ -1738,6 +1774,9 @@ dns_stats_t *
 dns_zone_getrcvquerystats(dns_zone_t *zone);
 #endif
 
+isc_histo_t *
+dns_zone_getlatencyhisto(dns_zone_t *zone);
+
 /*%<
  * Get the additional statistics for zone, if one is installed.
  *
@@ -2051,6 +2090,24 @@ dns_zone_getraw(dns_zone_t *zone, dns_zone_t **raw);
 isc_result_t
 dns_zone_keydone(dns_zone_t *zone, const char *data);
 
+isc_result_t
+dns_zone_getsigningprogress(dns_zone_t *zone, dns_secalg_t algorithm,
+			    isc_uint16_t keyid, isc_uint32_t *nodes,
+			    isc_uint32_t *signatures, isc_uint32_t *seconds);
+/*%
+ * Report the progress of signing 'zone' with the key identified by
+ * 'algorithm' and 'keyid': the number of nodes visited, the number of
+ * signatures generated and the number of seconds since signing began.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOTFOUND if the zone is not being signed with the key.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ * \li	'nodes', 'signatures' and 'seconds' to be non NULL.
+ */
+
 isc_result_t
 dns_zone_setnsec3param(dns_zone_t *zone, isc_uint8_t hash, isc_uint8_t flags,
 		       isc_uint16_t iter, isc_uint8_t saltlen,
@@ -2081,9 +2138,10 @@ dns_zone_synckeyzone(dns_zone_t *zone);
  */
 
 isc_result_t
-dns_zone_rpz_enable(dns_zone_t *zone);
+dns_zone_rpz_enable(dns_zone_t *zone, dns_rpz_summary_t *summary, int num);
 /*%
- * Set the response policy associated with a zone.
+ * Set the response policy associated with a zone, and make its databases
+ * report their triggers to 'summary' as those of policy zone 'num'.
  */
 
 isc_result_t
@@ -2092,6 +2150,13 @@ dns_zone_rpz_enable_db(dns_zone_t *zone, dns_db_t *db);
  * If a zone is a response policy zone, mark its new database.
  */
 
+void
+dns_zone_sharedb(dns_zone_t *zone, dns_db_t *db);
+/*%
+ * Let the new database 'db' of 'zone' share its rdata through the slab
+ * store of the zone's manager, if it has one.
+ */
+
 isc_boolean_t
 dns_zone_get_rpz(dns_zone_t *zone);
 
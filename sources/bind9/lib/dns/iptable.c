@@ -18,12 +18,49 @@
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include <isc/mem.h>
+#include <isc/netaddr.h>
 #include <isc/radix.h>
+#include <isc/string.h>
+#include <isc/util.h>
 
 #include <dns/acl.h>
 
+/*
+ * A compiled table is a multibit trie consuming STRIDE address bits per
+ * level, so that a node of FANOUT 32 bit entries fills one 64 byte cache
+ * line.  Nodes are kept in one array and refer to each other by index.
+ * Node 0 is the IPv4 root and node 1 the IPv6 root.
+ *
+ * Every prefix is expanded to the entries it covers in the node at the
+ * level where it ends, and each entry holds the best match for the
+ * addresses below it ("leaf pushing"), so a search simply follows child
+ * entries until it reaches a match entry: at most 8 nodes for IPv4 and
+ * 32 for IPv6, and usually far fewer.  An entry is either a child node
+ * index, shifted left one bit with the low bit set, or the match value
+ * (0, or a node number which is negative for a negative entry) shifted
+ * left one bit.
+ */
+#define STRIDE		4
+#define FANOUT		(1 << STRIDE)
+#define MAXNODES	65536		/* 4MB */
+
+#define ISCHILD(e)	(((e) & 1) != 0)
+#define CHILD(e)	((e) >> 1)
+#define MKCHILD(n)	(((isc_uint32_t)(n) << 1) | 1)
+#define VALUE(e)	((int)((isc_int32_t)(e) / 2))
+#define MKVALUE(v)	((isc_uint32_t)(v) << 1)
+
+struct dns_iptrie {
+	isc_uint32_t		*nodes;
+	unsigned int		count;		/* nodes in use */
+	unsigned int		alloc;		/* nodes allocated */
+};
+
 static void destroy_iptable(dns_iptable_t *dtab);
+static void trie_free(dns_iptable_t *tab);
 
 /*
  * Create a new IP table and the underlying radix structure
@@ -40,6 +77,7 @@ dns_iptable_create(isc_mem_t *mctx, dns_iptable_t **target) {
 	isc_mem_attach(mctx, &tab->mctx);
 	isc_refcount_init(&tab->refcount, 1);
 	tab->radix = NULL;
+	tab->trie = NULL;
 	tab->magic = DNS_IPTABLE_MAGIC;
 
 	result = isc_radix_create(mctx, &tab->radix, RADIX_MAXBITS);
@@ -72,6 +110,7 @@ dns_iptable_addprefix(dns_iptable_t *tab, isc_netaddr_t *addr,
 	INSIST(DNS_IPTABLE_VALID(tab));
 	INSIST(tab->radix);
 
+	trie_free(tab);
 	NETADDR_TO_PREFIX_T(addr, pfx, bitlen);
 
 	result = isc_radix_insert(tab->radix, &node, NULL, &pfx);
@@ -120,6 +159,7 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, isc_boolean_t pos)
 	isc_radix_node_t *node, *new_node;
 	int max_node = 0;
 
+	trie_free(tab);
 	RADIX_WALK (source->radix->head, node) {
 		new_node = NULL;
 		result = isc_radix_insert (tab->radix, &new_node, node, NULL);
@@ -155,6 +195,197 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, isc_boolean_t pos)
 	return (ISC_R_SUCCESS);
 }
 
+static inline unsigned int
+nibble(const unsigned char *addr, unsigned int bit) {
+	unsigned int byte = addr[bit >> 3];
+
+	return (((bit & 7) == 0) ? (byte >> 4) : (byte & 0x0f));
+}
+
+static isc_result_t
+trie_newnode(dns_iptable_t *tab, isc_uint32_t fill, unsigned int *nodep) {
+	dns_iptrie_t *trie = tab->trie;
+	isc_uint32_t *nodes;
+	unsigned int alloc, i;
+
+	if (trie->count == trie->alloc) {
+		if (trie->alloc >= MAXNODES)
+			return (ISC_R_RANGE);
+		alloc = trie->alloc * 2;
+		nodes = isc_mem_get(tab->mctx,
+				    alloc * FANOUT * sizeof(isc_uint32_t));
+		if (nodes == NULL)
+			return (ISC_R_NOMEMORY);
+		memmove(nodes, trie->nodes,
+			trie->count * FANOUT * sizeof(isc_uint32_t));
+		isc_mem_put(tab->mctx, trie->nodes,
+			    trie->alloc * FANOUT * sizeof(isc_uint32_t));
+		trie->nodes = nodes;
+		trie->alloc = alloc;
+	}
+
+	nodes = &trie->nodes[trie->count * FANOUT];
+	for (i = 0; i < FANOUT; i++)
+		nodes[i] = fill;
+	*nodep = trie->count++;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Make 'value' the match of the entry at 'slot' and every address
+ * below it that does not already have a match with a lower node number,
+ * which was added to the radix tree first.
+ */
+static void
+trie_apply(dns_iptrie_t *trie, unsigned int slot, int value) {
+	isc_uint32_t e = trie->nodes[slot];
+	unsigned int i;
+	int old;
+
+	if (ISCHILD(e)) {
+		for (i = 0; i < FANOUT; i++)
+			trie_apply(trie, CHILD(e) * FANOUT + i, value);
+		return;
+	}
+	old = VALUE(e);
+	if (old == 0 || abs(value) < abs(old))
+		trie->nodes[slot] = MKVALUE(value);
+}
+
+static isc_result_t
+trie_insert(dns_iptable_t *tab, unsigned int root, const unsigned char *addr,
+	    unsigned int bitlen, int value)
+{
+	dns_iptrie_t *trie = tab->trie;
+	unsigned int node = root, bit = 0, slot, child, first, count, i;
+	isc_result_t result;
+
+	while (bitlen - bit > STRIDE) {
+		slot = node * FANOUT + nibble(addr, bit);
+		if (!ISCHILD(trie->nodes[slot])) {
+			result = trie_newnode(tab, trie->nodes[slot], &child);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+			trie->nodes[slot] = MKCHILD(child);
+		}
+		node = CHILD(trie->nodes[slot]);
+		bit += STRIDE;
+	}
+
+	/* The last 0 to STRIDE bits select a run of entries in 'node'. */
+	count = 1 << (STRIDE - (bitlen - bit));
+	first = nibble(addr, bit) & ~(count - 1);
+	for (i = first; i < first + count; i++)
+		trie_apply(trie, node * FANOUT + i, value);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+trie_free(dns_iptable_t *tab) {
+	dns_iptrie_t *trie = tab->trie;
+
+	if (trie == NULL)
+		return;
+	tab->trie = NULL;
+	isc_mem_put(tab->mctx, trie->nodes,
+		    trie->alloc * FANOUT * sizeof(isc_uint32_t));
+	isc_mem_put(tab->mctx, trie, sizeof(*trie));
+}
+
+isc_result_t
+dns_iptable_compile(dns_iptable_t *tab) {
+	isc_radix_node_t *node;
+	isc_result_t result;
+	unsigned int root;
+	int family, value;
+
+	REQUIRE(DNS_IPTABLE_VALID(tab));
+
+	trie_free(tab);
+	tab->trie = isc_mem_get(tab->mctx, sizeof(*tab->trie));
+	if (tab->trie == NULL)
+		return (ISC_R_NOMEMORY);
+	tab->trie->alloc = 16;
+	tab->trie->count = 0;
+	tab->trie->nodes = isc_mem_get(tab->mctx, tab->trie->alloc * FANOUT *
+				       sizeof(isc_uint32_t));
+	if (tab->trie->nodes == NULL) {
+		isc_mem_put(tab->mctx, tab->trie, sizeof(*tab->trie));
+		tab->trie = NULL;
+		return (ISC_R_NOMEMORY);
+	}
+	RUNTIME_CHECK(trie_newnode(tab, MKVALUE(0), &root) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(trie_newnode(tab, MKVALUE(0), &root) == ISC_R_SUCCESS);
+
+	/*
+	 * As in isc_radix_search(), node_num[0] and data[0] describe the
+	 * node's IPv4 prefix and node_num[1] and data[1] its IPv6 prefix.
+	 */
+	RADIX_WALK(tab->radix->head, node) {
+		for (family = 0; family < 2; family++) {
+			if (node->node_num[family] == -1 ||
+			    node->data[family] == NULL)
+				continue;
+			value = node->node_num[family];
+			if (*(isc_boolean_t *)node->data[family] != ISC_TRUE)
+				value = -value;
+			result = trie_insert(tab, family,
+					     isc_prefix_touchar(node->prefix),
+					     node->prefix->bitlen, value);
+			if (result != ISC_R_SUCCESS) {
+				trie_free(tab);
+				return (result);
+			}
+		}
+	} RADIX_WALK_END;
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_iptable_search(const dns_iptable_t *tab, const isc_netaddr_t *addr,
+		   int *match)
+{
+	const unsigned char *bytes;
+	const isc_uint32_t *nodes;
+	isc_radix_node_t *node = NULL;
+	isc_prefix_t pfx;
+	isc_uint32_t e;
+	isc_result_t result;
+	unsigned int bit;
+
+	REQUIRE(DNS_IPTABLE_VALID(tab));
+	REQUIRE(addr->family == AF_INET || addr->family == AF_INET6);
+
+	*match = 0;
+
+	if (tab->trie != NULL) {
+		nodes = tab->trie->nodes;
+		if (addr->family == AF_INET) {
+			bytes = (const unsigned char *)&addr->type.in;
+			e = nodes[nibble(bytes, 0)];
+		} else {
+			bytes = (const unsigned char *)&addr->type.in6;
+			e = nodes[FANOUT + nibble(bytes, 0)];
+		}
+		for (bit = STRIDE; ISCHILD(e); bit += STRIDE)
+			e = nodes[CHILD(e) * FANOUT + nibble(bytes, bit)];
+		*match = VALUE(e);
+		return;
+	}
+
+	/* Always match with host addresses. */
+	NETADDR_TO_PREFIX_T(addr, pfx, addr->family == AF_INET6 ? 128 : 32);
+	result = isc_radix_search(tab->radix, &node, &pfx);
+	if (result == ISC_R_SUCCESS && node != NULL) {
+		*match = node->node_num[ISC_IS6(addr->family)];
+		if (*(isc_boolean_t *)node->data[ISC_IS6(addr->family)] !=
+		    ISC_TRUE)
+			*match = -*match;
+	}
+	isc_refcount_destroy(&pfx.refcount);
+}
+
 void
 dns_iptable_attach(dns_iptable_t *source, dns_iptable_t **target) {
 	REQUIRE(DNS_IPTABLE_VALID(source));
@@ -178,6 +409,7 @@ destroy_iptable(dns_iptable_t *dtab) {
 
 	REQUIRE(DNS_IPTABLE_VALID(dtab));
 
+	trie_free(dtab);
 	if (dtab->radix != NULL) {
 		isc_radix_destroy(dtab->radix, NULL);
 		dtab->radix = NULL;
@@ -31,6 +31,7 @@
 #include <isc/util.h>
 
 #include <dns/dnssec.h>
+#include <dns/fixedname.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
 #include <dns/masterdump.h>
@@ -387,7 +388,11 @@ msginitprivate(dns_message_t *m) {
 	for (i = 0; i < DNS_SECTION_MAX; i++) {
 		m->cursors[i] = NULL;
 		m->counts[i] = 0;
+		m->pending[i] = 0;
+		m->pendingcount[i] = 0;
+		m->pendingresult[i] = ISC_R_SUCCESS;
 	}
+	m->parseoptions = 0;
 	m->opt = NULL;
 	m->sig0 = NULL;
 	m->sig0name = NULL;
@@ -438,38 +443,44 @@ msginit(dns_message_t *m) {
 }
 
 static inline void
-msgresetnames(dns_message_t *msg, unsigned int first_section) {
-	unsigned int i;
+msgresetsection(dns_message_t *msg, unsigned int section) {
 	dns_name_t *name, *next_name;
 	dns_rdataset_t *rds, *next_rds;
 
 	/*
-	 * Clean up name lists by calling the rdataset disassociate function.
+	 * Clean up the name list by calling the rdataset disassociate
+	 * function.
 	 */
-	for (i = first_section; i < DNS_SECTION_MAX; i++) {
-		name = ISC_LIST_HEAD(msg->sections[i]);
-		while (name != NULL) {
-			next_name = ISC_LIST_NEXT(name, link);
-			ISC_LIST_UNLINK(msg->sections[i], name, link);
-
-			rds = ISC_LIST_HEAD(name->list);
-			while (rds != NULL) {
-				next_rds = ISC_LIST_NEXT(rds, link);
-				ISC_LIST_UNLINK(name->list, rds, link);
-
-				INSIST(dns_rdataset_isassociated(rds));
-				dns_rdataset_disassociate(rds);
-				isc_mempool_put(msg->rdspool, rds);
-				rds = next_rds;
-			}
-			if (dns_name_dynamic(name))
-				dns_name_free(name, msg->mctx);
-			isc_mempool_put(msg->namepool, name);
-			name = next_name;
+	name = ISC_LIST_HEAD(msg->sections[section]);
+	while (name != NULL) {
+		next_name = ISC_LIST_NEXT(name, link);
+		ISC_LIST_UNLINK(msg->sections[section], name, link);
+
+		rds = ISC_LIST_HEAD(name->list);
+		while (rds != NULL) {
+			next_rds = ISC_LIST_NEXT(rds, link);
+			ISC_LIST_UNLINK(name->list, rds, link);
+
+			INSIST(dns_rdataset_isassociated(rds));
+			dns_rdataset_disassociate(rds);
+			isc_mempool_put(msg->rdspool, rds);
+			rds = next_rds;
 		}
+		if (dns_name_dynamic(name))
+			dns_name_free(name, msg->mctx);
+		isc_mempool_put(msg->namepool, name);
+		name = next_name;
 	}
 }
 
+static inline void
+msgresetnames(dns_message_t *msg, unsigned int first_section) {
+	unsigned int i;
+
+	for (i = first_section; i < DNS_SECTION_MAX; i++)
+		msgresetsection(msg, i);
+}
+
 static void
 msgresetopt(dns_message_t *msg)
 {
@@ -1161,9 +1172,13 @@ update(dns_section_t section, dns_rdataclass_t rdclass) {
 	return (ISC_FALSE);
 }
 
+/*
+ * Parse records 'first' up to 'last' of a section.
+ */
 static isc_result_t
 getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
-	   dns_section_t sectionid, unsigned int options)
+	   dns_section_t sectionid, unsigned int options,
+	   unsigned int first, unsigned int last)
 {
 	isc_region_t r;
 	unsigned int count, rdatalen;
@@ -1186,7 +1201,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	best_effort = ISC_TF(options & DNS_MESSAGEPARSE_BESTEFFORT);
 	seen_problem = ISC_FALSE;
 
-	for (count = 0; count < msg->counts[sectionid]; count++) {
+	for (count = first; count < last; count++) {
 		int recstart = source->current;
 		isc_boolean_t skip_name_search, skip_type_search;
 
@@ -1578,6 +1593,186 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	return (result);
 }
 
+/*
+ * Check the records of a section as getsection() would, without
+ * keeping them: owner names are decompressed into a fixed name and
+ * rdata into a buffer on the stack, so nothing is allocated.  A record
+ * getsection() would reject makes this fail, and so does one that
+ * cannot be checked on its own: a singleton type, whose duplicates
+ * must match, or rdata that does not fit the buffer.  The section is
+ * then parsed at once, which gives the same result as a full parse.
+ *
+ * '*keep' is set to the number of leading records that may be decoded
+ * later: all of them, or those before a final run of OPT and TSIG
+ * records, which dns_message_parse() must see at once and which are
+ * found at '*tail'.  A SIG record might be a SIG(0), and an OPT or TSIG
+ * record anywhere else is an error, so either makes '*keep' zero.
+ */
+static isc_result_t
+checksection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
+	     dns_section_t sectionid, unsigned int *keep, isc_buffer_t *tail)
+{
+	unsigned char data[SCRATCHPAD_SIZE];
+	isc_buffer_t target, recstart;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdata_t rdata;
+	isc_region_t r;
+	unsigned int count, rdatalen;
+	dns_rdatatype_t rdtype;
+	dns_rdataclass_t rdclass;
+	dns_section_t tkeysection;
+	isc_result_t result;
+	isc_boolean_t mixed;
+
+	*keep = msg->counts[sectionid];
+	mixed = ISC_FALSE;
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	for (count = 0; count < msg->counts[sectionid]; count++) {
+		recstart = *source;
+
+		isc_buffer_remainingregion(source, &r);
+		isc_buffer_setactive(source, r.length);
+		result = dns_name_fromwire(name, source, dctx, 0, NULL);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+
+		isc_buffer_remainingregion(source, &r);
+		if (r.length < 2 + 2 + 4 + 2)
+			return (ISC_R_UNEXPECTEDEND);
+		rdtype = isc_buffer_getuint16(source);
+		rdclass = isc_buffer_getuint16(source);
+		isc_buffer_forward(source, 4);
+		rdatalen = isc_buffer_getuint16(source);
+		if (r.length - (2 + 2 + 4 + 2) < rdatalen)
+			return (ISC_R_UNEXPECTEDEND);
+
+		/*
+		 * OPT and TSIG records are only skipped here; those that
+		 * may appear where they are are parsed at once.
+		 */
+		if (rdtype == dns_rdatatype_opt ||
+		    rdtype == dns_rdatatype_tsig) {
+			isc_buffer_forward(source, rdatalen);
+			if (*keep == msg->counts[sectionid]) {
+				*keep = count;
+				*tail = recstart;
+			}
+			continue;
+		}
+		if (rdtype == dns_rdatatype_sig ||
+		    *keep != msg->counts[sectionid])
+			mixed = ISC_TRUE;
+
+		if (rdtype != dns_rdatatype_dnskey &&
+		    rdtype != dns_rdatatype_sig &&
+		    rdtype != dns_rdatatype_tkey &&
+		    msg->rdclass != dns_rdataclass_any &&
+		    msg->rdclass != rdclass)
+			return (DNS_R_FORMERR);
+		if (rdtype == dns_rdatatype_tkey) {
+			if ((msg->flags & DNS_MESSAGEFLAG_QR) == 0)
+				tkeysection = DNS_SECTION_ADDITIONAL;
+			else
+				tkeysection = DNS_SECTION_ANSWER;
+			if (sectionid != tkeysection &&
+			    sectionid != DNS_SECTION_ANSWER)
+				return (DNS_R_FORMERR);
+		}
+		if (dns_rdatatype_questiononly(rdtype) ||
+		    dns_rdatatype_issingleton(rdtype))
+			return (DNS_R_FORMERR);
+
+		dns_rdata_init(&rdata);
+		isc_buffer_init(&target, data, sizeof(data));
+		isc_buffer_setactive(source, rdatalen);
+		result = dns_rdata_fromwire(&rdata, rdclass, rdtype, source,
+					    dctx, 0, &target);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		if (rdtype == dns_rdatatype_rrsig &&
+		    dns_rdata_covers(&rdata) == 0)
+			return (DNS_R_FORMERR);
+		if (rdtype == dns_rdatatype_nsec3 &&
+		    !dns_rdata_checkowner(name, msg->rdclass, rdtype,
+					  ISC_FALSE))
+			return (DNS_R_BADOWNERNAME);
+	}
+	if (mixed)
+		*keep = 0;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Decode a section that dns_message_parse() left pending.  A failure
+ * leaves the section empty and is returned again on every later call.
+ */
+static isc_result_t
+decodesection(dns_message_t *msg, dns_section_t sectionid) {
+	isc_buffer_t source;
+	dns_decompress_t dctx;
+	isc_result_t result;
+
+	if (msg->pending[sectionid] == 0)
+		return (msg->pendingresult[sectionid]);
+
+	INSIST(msg->pending[sectionid] < msg->saved.length);
+
+	isc_buffer_init(&source, msg->saved.base, msg->saved.length);
+	isc_buffer_add(&source, msg->saved.length);
+	isc_buffer_forward(&source, msg->pending[sectionid]);
+	msg->pending[sectionid] = 0;
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_ANY);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+
+	result = getsection(&source, msg, &dctx, sectionid,
+			    msg->parseoptions, 0, msg->pendingcount[sectionid]);
+	if (result == DNS_R_RECOVERABLE)
+		result = ISC_R_SUCCESS;
+	if (result != ISC_R_SUCCESS)
+		msgresetsection(msg, sectionid);
+	msg->pendingresult[sectionid] = result;
+	return (result);
+}
+
+/*
+ * Parse a section of the message, or with DNS_MESSAGEPARSE_LAZY just
+ * check it and remember where it starts, parsing only a final run of
+ * OPT and TSIG records.  Sections that cannot be left for later, and
+ * those that do not check out, are parsed at once so that the result
+ * is the same as without DNS_MESSAGEPARSE_LAZY.
+ */
+static isc_result_t
+parsesection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
+	     dns_section_t sectionid, unsigned int options,
+	     isc_boolean_t lazy)
+{
+	isc_buffer_t start, tail;
+	unsigned int keep;
+	isc_result_t result;
+
+	if (lazy && msg->counts[sectionid] != 0) {
+		start = *source;
+		result = checksection(source, msg, dctx, sectionid, &keep,
+				      &tail);
+		if (result == ISC_R_SUCCESS && keep != 0) {
+			msg->pending[sectionid] = start.current;
+			msg->pendingcount[sectionid] = keep;
+			if (keep == msg->counts[sectionid])
+				return (ISC_R_SUCCESS);
+			*source = tail;
+			return (getsection(source, msg, dctx, sectionid,
+					   options, keep,
+					   msg->counts[sectionid]));
+		}
+		*source = start;
+	}
+	return (getsection(source, msg, dctx, sectionid, options,
+			   0, msg->counts[sectionid]));
+}
+
 isc_result_t
 dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		  unsigned int options)
@@ -1589,6 +1784,7 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	isc_buffer_t origsource;
 	isc_boolean_t seen_problem;
 	isc_boolean_t ignore_tc;
+	isc_boolean_t lazy;
 
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(source != NULL);
@@ -1596,6 +1792,7 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 
 	seen_problem = ISC_FALSE;
 	ignore_tc = ISC_TF(options & DNS_MESSAGEPARSE_IGNORETRUNCATION);
+	msg->parseoptions = options;
 
 	origsource = *source;
 
@@ -1637,7 +1834,17 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		return (ret);
 	msg->question_ok = 1;
 
-	ret = getsection(source, msg, &dctx, DNS_SECTION_ANSWER, options);
+	/*
+	 * Without a question the class of the message is taken from the
+	 * first record, and UPDATE sections have their own rules, so
+	 * those messages are always parsed in full.
+	 */
+	lazy = ISC_TF((options & DNS_MESSAGEPARSE_LAZY) != 0 &&
+		      msg->counts[DNS_SECTION_QUESTION] != 0 &&
+		      msg->opcode != dns_opcode_update);
+
+	ret = parsesection(source, msg, &dctx, DNS_SECTION_ANSWER, options,
+			   lazy);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc)
 		goto truncated;
 	if (ret == DNS_R_RECOVERABLE) {
@@ -1645,9 +1852,10 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		ret = ISC_R_SUCCESS;
 	}
 	if (ret != ISC_R_SUCCESS)
-		return (ret);
+		goto failure;
 
-	ret = getsection(source, msg, &dctx, DNS_SECTION_AUTHORITY, options);
+	ret = parsesection(source, msg, &dctx, DNS_SECTION_AUTHORITY, options,
+			   lazy);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc)
 		goto truncated;
 	if (ret == DNS_R_RECOVERABLE) {
@@ -1655,9 +1863,10 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		ret = ISC_R_SUCCESS;
 	}
 	if (ret != ISC_R_SUCCESS)
-		return (ret);
+		goto failure;
 
-	ret = getsection(source, msg, &dctx, DNS_SECTION_ADDITIONAL, options);
+	ret = parsesection(source, msg, &dctx, DNS_SECTION_ADDITIONAL, options,
+			   lazy);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc)
 		goto truncated;
 	if (ret == DNS_R_RECOVERABLE) {
@@ -1665,7 +1874,7 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		ret = ISC_R_SUCCESS;
 	}
 	if (ret != ISC_R_SUCCESS)
-		return (ret);
+		goto failure;
 
 	isc_buffer_remainingregion(source, &r);
 	if (r.length != 0) {
@@ -1681,8 +1890,10 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	else {
 		msg->saved.length = isc_buffer_usedlength(&origsource);
 		msg->saved.base = isc_mem_get(msg->mctx, msg->saved.length);
-		if (msg->saved.base == NULL)
-			return (ISC_R_NOMEMORY);
+		if (msg->saved.base == NULL) {
+			ret = ISC_R_NOMEMORY;
+			goto failure;
+		}
 		memmove(msg->saved.base, isc_buffer_base(&origsource),
 			msg->saved.length);
 		msg->free_saved = 1;
@@ -1693,6 +1904,13 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	if (seen_problem == ISC_TRUE)
 		return (DNS_R_RECOVERABLE);
 	return (ISC_R_SUCCESS);
+
+ failure:
+	/*
+	 * The wire data is not saved, so nothing can be decoded later.
+	 */
+	memset(msg->pending, 0, sizeof(msg->pending));
+	return (ret);
 }
 
 isc_result_t
@@ -2269,9 +2487,15 @@ dns_message_renderreset(dns_message_t *msg) {
 
 isc_result_t
 dns_message_firstname(dns_message_t *msg, dns_section_t section) {
+	isc_result_t result;
+
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(VALID_NAMED_SECTION(section));
 
+	result = decodesection(msg, section);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
 	msg->cursors[section] = ISC_LIST_HEAD(msg->sections[section]);
 
 	if (msg->cursors[section] == NULL)
@@ -2333,6 +2557,12 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
 			REQUIRE(*rdataset == NULL);
 	}
 
+	if (VALID_NAMED_SECTION(section)) {
+		result = decodesection(msg, section);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
 	result = findname(&foundname, target,
 			  &msg->sections[section]);
 
@@ -3141,6 +3371,12 @@ dns_message_sectiontotext(dns_message_t *msg, dns_section_t section,
 	REQUIRE(target != NULL);
 	REQUIRE(VALID_SECTION(section));
 
+	if (VALID_NAMED_SECTION(section)) {
+		result = decodesection(msg, section);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
 	if (ISC_LIST_EMPTY(msg->sections[section]))
 		return (ISC_R_SUCCESS);
 
@@ -58,6 +58,7 @@
 #include <dns/rdataslab.h>
 #include <dns/rdatastruct.h>
 #include <dns/result.h>
+#include <dns/slabstore.h>
 #include <dns/stats.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -155,6 +156,7 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define free_rbtdb free_rbtdb64
 #define free_rbtdb_callback free_rbtdb_callback64
 #define free_rdataset free_rdataset64
+#define free_unshared free_unshared64
 #define getnsec3parameters getnsec3parameters64
 #define getoriginnode getoriginnode64
 #define getrrsetstats getrrsetstats64
@@ -196,15 +198,21 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define resign_insert resign_insert64
 #define resign_sooner resign_sooner64
 #define resigned resigned64
+#define rpz_commit rpz_commit64
 #define rpz_enabled rpz_enabled64
 #define rpz_findips rpz_findips64
+#define rpz_resummarize rpz_resummarize64
+#define rpz_setsummary rpz_setsummary64
 #define set_index set_index64
 #define set_ttl set_ttl64
 #define setsigningtime setsigningtime64
+#define setslabstore setslabstore64
+#define share_rdataset share_rdataset64
 #define settask settask64
 #define setup_delegation setup_delegation64
 #define subtractrdataset subtractrdataset64
 #define ttl_sooner ttl_sooner64
+#define unshare_header unshare_header64
 #define update_header update_header64
 #define update_rrsetstats update_rrsetstats64
 #define zone_find zone_find64
@@ -401,6 +409,7 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 #define RDATASET_ATTR_STATCOUNT         0x0040
 #define RDATASET_ATTR_OPTOUT		0x0080
 #define RDATASET_ATTR_NEGATIVE          0x0100
+#define RDATASET_ATTR_SHARED            0x0200
 
 typedef struct acache_cbarg {
 	dns_rdatasetadditional_t        type;
@@ -441,6 +450,35 @@ struct acachectl {
 	(((header)->attributes & RDATASET_ATTR_OPTOUT) != 0)
 #define NEGATIVE(header) \
 	(((header)->attributes & RDATASET_ATTR_NEGATIVE) != 0)
+#define SHARED(header) \
+	(((header)->attributes & RDATASET_ATTR_SHARED) != 0)
+
+/*%
+ * The rdataslab of a header normally follows it in the same block of
+ * memory.  A header whose slab is kept in the database's slab store
+ * (see dns/slabstore.h) is followed by a pointer to the stored slab
+ * instead.
+ */
+#define SHARED_HEADER_SIZE \
+	(sizeof(rdatasetheader_t) + sizeof(unsigned char *))
+
+static inline unsigned char *
+header_raw(rdatasetheader_t *header) {
+	if (SHARED(header))
+		return (*(unsigned char **)(header + 1));
+	return ((unsigned char *)(header + 1));
+}
+
+/*%
+ * The header that 'rdataset' was bound to; see bind_rdataset().
+ */
+static inline rdatasetheader_t *
+rdataset_header(dns_rdataset_t *rdataset) {
+	if (rdataset->private7 != NULL &&
+	    (rdataset->attributes & DNS_RDATASETATTR_CLOSEST) == 0)
+		return (rdataset->private7);
+	return ((rdatasetheader_t *)rdataset->private3 - 1);
+}
 
 #define DEFAULT_NODE_LOCK_COUNT         7       /*%< Should be prime. */
 
@@ -532,6 +570,7 @@ struct dns_rbtdb {
 	rbtdb_nodelock_t *              node_locks;
 	dns_rbtnode_t *                 origin_node;
 	dns_stats_t *			rrsetstats; /* cache DB only */
+	dns_slabstore_t *		slabstore; /* zone DB only */
 	/* Locked by lock. */
 	unsigned int                    active;
 	isc_refcount_t                  references;
@@ -606,6 +645,14 @@ typedef struct {
 typedef struct {
 	dns_rbtdb_t *           rbtdb;
 	isc_stdtime_t           now;
+	/*
+	 * The node most recently added to the main tree.  Master files
+	 * and zone transfers deliver all rdatasets of an owner name
+	 * consecutively, so remembering it avoids walking the tree (and
+	 * redoing the wildcard bookkeeping) for every rdataset.
+	 */
+	dns_rbtnode_t *         lastnode;
+	dns_fixedname_t         lastname;
 } rbtdb_load_t;
 
 static void rdataset_disassociate(dns_rdataset_t *rdataset);
@@ -1091,6 +1138,8 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 
 	if (rbtdb->rrsetstats != NULL)
 		dns_stats_detach(&rbtdb->rrsetstats);
+	if (rbtdb->slabstore != NULL)
+		dns_slabstore_detach(&rbtdb->slabstore);
 
 #ifdef BIND9
 	if (rbtdb->rpz_cidr != NULL)
@@ -1328,7 +1377,7 @@ free_acachearray(isc_mem_t *mctx, rdatasetheader_t *header,
 	if (array == NULL)
 		return;
 
-	raw = (unsigned char *)header + sizeof(*header);
+	raw = header_raw(header);
 	count = raw[0] * 256 + raw[1];
 
 	/*
@@ -1418,7 +1467,12 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset)
 
 	if ((rdataset->attributes & RDATASET_ATTR_NONEXISTENT) != 0)
 		size = sizeof(*rdataset);
-	else
+	else if (SHARED(rdataset)) {
+		unsigned char *raw = header_raw(rdataset);
+
+		dns_slabstore_release(rbtdb->slabstore, &raw);
+		size = SHARED_HEADER_SIZE;
+	} else
 		size = dns_rdataslab_size((unsigned char *)rdataset,
 					  sizeof(*rdataset));
 	isc_mem_put(mctx, rdataset, size);
@@ -2215,7 +2269,7 @@ setnsec3parameters(dns_db_t *db, rbtdb_version_t *version) {
 			/*
 			 * Find A NSEC3PARAM with a supported algorithm.
 			 */
-			raw = (unsigned char *)header + sizeof(*header);
+			raw = header_raw(header);
 			count = raw[0] * 256 + raw[1]; /* count */
 #if DNS_RDATASET_FIXED
 			raw += count * 4 + 2;
@@ -2299,6 +2353,120 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	}
 }
 
+#ifdef BIND9
+/*
+ * Report every trigger of a response policy zone again if its summary
+ * is missing some, such as after running out of memory or being given
+ * a new summary without its triggers.
+ * The tree write lock must be held by the caller.
+ */
+static void
+rpz_resummarize(dns_rbtdb_t *rbtdb) {
+	dns_rbtnodechain_t chain;
+	dns_rbtnode_t *node;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	isc_result_t result;
+
+	if (!dns_rpz_cidr_incomplete(rbtdb->rpz_cidr))
+		return;
+
+	dns_fixedname_init(&fname);
+	name = dns_fixedname_name(&fname);
+	dns_rbtnodechain_init(&chain, rbtdb->common.mctx);
+	result = dns_rbtnodechain_first(&chain, rbtdb->tree, NULL, NULL);
+	while (result == ISC_R_SUCCESS || result == DNS_R_NEWORIGIN) {
+		node = NULL;
+		result = dns_rbtnodechain_current(&chain, NULL, NULL, &node);
+		if (result != ISC_R_SUCCESS)
+			break;
+		if (node->rpz) {
+			dns_rbt_fullnamefromnode(node, name);
+			result = dns_rpz_cidr_summarize(rbtdb->rpz_cidr, name);
+			if (result != ISC_R_SUCCESS)
+				break;
+		}
+		result = dns_rbtnodechain_next(&chain, NULL, NULL);
+	}
+	dns_rbtnodechain_invalidate(&chain);
+	if (result == ISC_R_NOMORE || result == ISC_R_NOTFOUND)
+		dns_rpz_cidr_summarized(rbtdb->rpz_cidr);
+}
+
+/*
+ * Bring the triggers of a response policy zone up to date with the
+ * nodes changed by a version being committed.  Only those nodes are
+ * visited, so an IXFR or dynamic update costs in proportion to its
+ * size, and the triggers of names still being changed by an open
+ * version are not seen by queries before the version is committed.
+ */
+static void
+rpz_commit(dns_rbtdb_t *rbtdb, rbtdb_version_t *version) {
+	rbtdb_changed_t *changed;
+	dns_rbtnode_t *node;
+	rdatasetheader_t *header, *header_next;
+	nodelock_t *lock;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	isc_boolean_t active;
+	isc_time_t start, end;
+
+	isc_time_now(&start);
+	dns_fixedname_init(&fname);
+	name = dns_fixedname_name(&fname);
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	for (changed = HEAD(version->changed_list);
+	     changed != NULL;
+	     changed = NEXT(changed, link)) {
+		node = changed->node;
+		if (node->nsec != DNS_RBT_NSEC_NORMAL &&
+		    node->nsec != DNS_RBT_NSEC_HAS_NSEC)
+			continue;
+
+		/*
+		 * Does the node have any data in the new version?
+		 */
+		active = ISC_FALSE;
+		lock = &rbtdb->node_locks[node->locknum].lock;
+		NODE_LOCK(lock, isc_rwlocktype_read);
+		for (header = node->data;
+		     header != NULL && !active;
+		     header = header_next) {
+			header_next = header->next;
+			do {
+				if (header->serial <= version->serial &&
+				    !IGNORE(header)) {
+					if (NONEXISTENT(header))
+						header = NULL;
+					break;
+				} else
+					header = header->down;
+			} while (header != NULL);
+			if (header != NULL)
+				active = ISC_TRUE;
+		}
+		NODE_UNLOCK(lock, isc_rwlocktype_read);
+
+		if (active == ISC_TF(node->rpz != 0))
+			continue;
+		dns_rbt_fullnamefromnode(node, name);
+		if (active) {
+			dns_rpz_cidr_addip(rbtdb->rpz_cidr, name);
+			node->rpz = 1;
+		} else {
+			dns_rpz_cidr_deleteip(rbtdb->rpz_cidr, name);
+			node->rpz = 0;
+		}
+	}
+	rpz_resummarize(rbtdb);
+	isc_time_now(&end);
+	dns_rpz_cidr_updated(rbtdb->rpz_cidr,
+			     isc_time_microdiff(&end, &start));
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+}
+#endif
+
 static void
 closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
@@ -2320,6 +2488,15 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 	ISC_LIST_INIT(cleanup_list);
 	ISC_LIST_INIT(resigned_list);
 
+#ifdef BIND9
+	/*
+	 * Only the writer changes its own 'writer' flag and change list.
+	 */
+	if (commit && version->writer && rbtdb->rpz_cidr != NULL &&
+	    !EMPTY(version->changed_list))
+		rpz_commit(rbtdb, version);
+#endif
+
 	isc_refcount_decrement(&version->references, &refs);
 	if (refs > 0) {         /* typical and easy case first */
 		if (commit) {
@@ -2665,18 +2842,6 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 		node = NULL;
 		result = dns_rbt_addnode(tree, name, &node);
 		if (result == ISC_R_SUCCESS) {
-#ifdef BIND9
-			if (tree == rbtdb->tree && rbtdb->rpz_cidr != NULL) {
-				dns_fixedname_t fnamef;
-				dns_name_t *fname;
-
-				dns_fixedname_init(&fnamef);
-				fname = dns_fixedname_name(&fnamef);
-				dns_rbt_fullnamefromnode(node, fname);
-				dns_rpz_cidr_addip(rbtdb->rpz_cidr, fname);
-				node->rpz = 1;
-			}
-#endif
 			dns_rbt_namefromnode(node, &nodename);
 #ifdef DNS_RBT_USEHASH
 			node->locknum = node->hashval % rbtdb->node_lock_count;
@@ -2933,7 +3098,7 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		rdataset->attributes |= DNS_RDATASETATTR_OPTOUT;
 	rdataset->private1 = rbtdb;
 	rdataset->private2 = node;
-	raw = (unsigned char *)header + sizeof(*header);
+	raw = header_raw(header);
 	rdataset->private3 = raw;
 	rdataset->count = header->count++;
 	if (rdataset->count == ISC_UINT32_MAX)
@@ -2954,6 +3119,13 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	rdataset->private7 = header->closest;
 	if (rdataset->private7 != NULL)
 		rdataset->attributes |=  DNS_RDATASETATTR_CLOSEST;
+	else if (SHARED(header)) {
+		/*
+		 * Closest encloser proofs are only cached, so in a zone
+		 * database 'private7' is free to lead back to the header.
+		 */
+		rdataset->private7 = header;
+	}
 
 	/*
 	 * Copy out re-signing information.
@@ -3053,7 +3225,7 @@ valid_glue(rbtdb_search_t *search, dns_name_t *name, rbtdb_rdatatype_t type,
 	}
 
 	header = search->zonecut_rdataset;
-	raw = (unsigned char *)header + sizeof(*header);
+	raw = header_raw(header);
 	count = raw[0] * 256 + raw[1];
 #if DNS_RDATASET_FIXED
 	raw += 2 + (4 * count);
@@ -3422,7 +3594,7 @@ matchparams(rdatasetheader_t *header, rbtdb_search_t *search)
 
 	REQUIRE(header->type == dns_rdatatype_nsec3);
 
-	raw = (unsigned char *)header + sizeof(*header);
+	raw = header_raw(header);
 	count = raw[0] * 256 + raw[1]; /* count */
 #if DNS_RDATASET_FIXED
 	raw += count * 4 + 2;
@@ -4916,8 +5088,43 @@ rpz_findips(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 
 	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
 }
+
+/*
+ * Report the policy triggers of a database to the summary of its view.
+ */
+static void
+rpz_setsummary(dns_db_t *db, dns_rpz_summary_t *summary, int num) {
+	dns_rbtdb_t *rbtdb;
+
+	rbtdb = (dns_rbtdb_t *)db;
+	REQUIRE(VALID_RBTDB(rbtdb));
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	if (rbtdb->rpz_cidr != NULL) {
+		dns_rpz_cidr_setsummary(rbtdb->rpz_cidr, summary, num);
+		rpz_resummarize(rbtdb);
+	}
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+}
 #endif
 
+static void
+setslabstore(dns_db_t *db, dns_slabstore_t *store) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+
+	/*
+	 * Headers are released to the store they were interned in, so it
+	 * cannot be changed once set.
+	 */
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
+	if (rbtdb->slabstore == NULL &&
+	    (rbtdb->attributes & RBTDB_ATTR_LOADED) == 0)
+		dns_slabstore_attach(store, &rbtdb->slabstore);
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+}
+
 static isc_result_t
 cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	   dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
@@ -6034,6 +6241,77 @@ resign_delete(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
 	}
 }
 
+/*
+ * Move the slab of the new header '*headerp' into the database's slab
+ * store, if it has one, and replace the header with one that refers to
+ * the stored slab.  If that fails the header keeps its own copy.  SOA,
+ * NSEC, NSEC3 and RRSIG RRsets are specific to their zone, so they are
+ * not looked up.
+ */
+static void
+share_rdataset(dns_rbtdb_t *rbtdb, rdatasetheader_t **headerp) {
+	rdatasetheader_t *header = *headerp, *shared;
+	unsigned char *raw = NULL;
+	unsigned int size;
+
+	if (rbtdb->slabstore == NULL || NONEXISTENT(header) || SHARED(header))
+		return;
+	switch (RBTDB_RDATATYPE_BASE(header->type)) {
+	case dns_rdatatype_soa:
+	case dns_rdatatype_nsec:
+	case dns_rdatatype_nsec3:
+	case dns_rdatatype_rrsig:
+		return;
+	default:
+		break;
+	}
+
+	INSIST(header->heap_index == 0);
+	size = dns_rdataslab_size((unsigned char *)header, sizeof(*header));
+	if (dns_slabstore_intern(rbtdb->slabstore, header_raw(header),
+				 size - sizeof(*header), &raw) != ISC_R_SUCCESS)
+		return;
+	shared = isc_mem_get(rbtdb->common.mctx, SHARED_HEADER_SIZE);
+	if (shared == NULL) {
+		dns_slabstore_release(rbtdb->slabstore, &raw);
+		return;
+	}
+	*shared = *header;
+	shared->attributes |= RDATASET_ATTR_SHARED;
+	*(unsigned char **)(shared + 1) = raw;
+	isc_mem_put(rbtdb->common.mctx, header, size);
+	*headerp = shared;
+}
+
+/*
+ * Return a temporary copy of the shared header 'header' with its slab
+ * following it, for the rdataslab functions that need that layout.
+ * The copy is not a header of the database: it must be freed with
+ * free_unshared(), not free_rdataset().
+ */
+static rdatasetheader_t *
+unshare_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	rdatasetheader_t *copy;
+	unsigned int size;
+
+	INSIST(SHARED(header));
+
+	size = dns_rdataslab_size(header_raw(header), 0);
+	copy = isc_mem_get(rbtdb->common.mctx, sizeof(*copy) + size);
+	if (copy == NULL)
+		return (NULL);
+	*copy = *header;
+	copy->attributes &= ~RDATASET_ATTR_SHARED;
+	memmove(copy + 1, header_raw(header), size);
+	return (copy);
+}
+
+static void
+free_unshared(dns_rbtdb_t *rbtdb, rdatasetheader_t *copy) {
+	isc_mem_put(rbtdb->common.mctx, copy,
+		    dns_rdataslab_size((unsigned char *)copy, sizeof(*copy)));
+}
+
 static isc_result_t
 add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
       rdatasetheader_t *newheader, unsigned int options, isc_boolean_t loading,
@@ -6041,6 +6319,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 {
 	rbtdb_changed_t *changed = NULL;
 	rdatasetheader_t *topheader, *topheader_prev, *header, *sigheader;
+	rdatasetheader_t *unshared;
 	unsigned char *merged;
 	isc_result_t result;
 	isc_boolean_t header_nx;
@@ -6231,6 +6510,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 			unsigned int flags = 0;
 			INSIST(rbtversion->serial >= header->serial);
 			merged = NULL;
+			unshared = NULL;
 			result = ISC_R_SUCCESS;
 
 			if ((options & DNS_DBADD_EXACT) != 0)
@@ -6240,15 +6520,23 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 					result = DNS_R_NOTEXACT;
 			else if (newheader->rdh_ttl != header->rdh_ttl)
 				flags |= DNS_RDATASLAB_FORCE;
+			if (result == ISC_R_SUCCESS && SHARED(header)) {
+				unshared = unshare_header(rbtdb, header);
+				if (unshared == NULL)
+					result = ISC_R_NOMEMORY;
+			}
 			if (result == ISC_R_SUCCESS)
 				result = dns_rdataslab_merge(
-					     (unsigned char *)header,
+					     (unsigned char *)((unshared != NULL) ?
+							       unshared : header),
 					     (unsigned char *)newheader,
 					     (unsigned int)(sizeof(*newheader)),
 					     rbtdb->common.mctx,
 					     rbtdb->common.rdclass,
 					     (dns_rdatatype_t)header->type,
 					     flags, &merged);
+			if (unshared != NULL)
+				free_unshared(rbtdb, unshared);
 			if (result == ISC_R_SUCCESS) {
 				/*
 				 * If 'header' has the same serial number as
@@ -6357,6 +6645,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 		}
 		INSIST(rbtversion == NULL ||
 		       rbtversion->serial >= topheader->serial);
+		share_rdataset(rbtdb, &newheader);
 		if (topheader_prev != NULL)
 			topheader_prev->next = newheader;
 		else
@@ -6434,6 +6723,8 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 			return (DNS_R_UNCHANGED);
 		}
 
+		share_rdataset(rbtdb, &newheader);
+
 		if (topheader != NULL) {
 			/*
 			 * We have an list of rdatasets of the given type,
@@ -6812,6 +7103,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	dns_rbtnode_t *rbtnode = (dns_rbtnode_t *)node;
 	rbtdb_version_t *rbtversion = version;
 	rdatasetheader_t *topheader, *topheader_prev, *header, *newheader;
+	rdatasetheader_t *unshared;
 	unsigned char *subresult;
 	isc_region_t region;
 	isc_result_t result;
@@ -6884,21 +7176,30 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	if (header != NULL && EXISTS(header)) {
 		unsigned int flags = 0;
 		subresult = NULL;
+		unshared = NULL;
 		result = ISC_R_SUCCESS;
 		if ((options & DNS_DBSUB_EXACT) != 0) {
 			flags |= DNS_RDATASLAB_EXACT;
 			if (newheader->rdh_ttl != header->rdh_ttl)
 				result = DNS_R_NOTEXACT;
 		}
+		if (result == ISC_R_SUCCESS && SHARED(header)) {
+			unshared = unshare_header(rbtdb, header);
+			if (unshared == NULL)
+				result = ISC_R_NOMEMORY;
+		}
 		if (result == ISC_R_SUCCESS)
 			result = dns_rdataslab_subtract(
-					(unsigned char *)header,
+					(unsigned char *)((unshared != NULL) ?
+							  unshared : header),
 					(unsigned char *)newheader,
 					(unsigned int)(sizeof(*newheader)),
 					rbtdb->common.mctx,
 					rbtdb->common.rdclass,
 					(dns_rdatatype_t)header->type,
 					flags, &subresult);
+		if (unshared != NULL)
+			free_unshared(rbtdb, unshared);
 		if (result == ISC_R_SUCCESS) {
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			newheader = (rdatasetheader_t *)subresult;
@@ -6916,6 +7217,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			 */
 			newheader->additional_auth = NULL;
 			newheader->additional_glue = NULL;
+			share_rdataset(rbtdb, &newheader);
 		} else if (result == DNS_R_NXRRSET) {
 			/*
 			 * This subtraction would remove all of the rdata;
@@ -7119,7 +7421,13 @@ loadnode(dns_rbtdb_t *rbtdb, dns_name_t *name, dns_rbtnode_t **nodep,
 
  done:
 #ifdef BIND9
-	if (noderesult == ISC_R_SUCCESS && rbtdb->rpz_cidr != NULL) {
+	/*
+	 * Nodes made for wildcards or by splitting need to be added
+	 * when they get data of their own.
+	 */
+	if ((noderesult == ISC_R_SUCCESS ||
+	     (noderesult == ISC_R_EXISTS && !node->rpz)) &&
+	    rbtdb->rpz_cidr != NULL) {
 		dns_rpz_cidr_addip(rbtdb->rpz_cidr, name);
 		node->rpz = 1;
 	}
@@ -7153,6 +7461,25 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 	    !IS_CACHE(rbtdb) && !dns_name_equal(name, &rbtdb->common.origin))
 		return (DNS_R_NOTZONETOP);
 
+	node = NULL;
+	if (loadctx->lastnode != NULL &&
+	    rdataset->type != dns_rdatatype_nsec3 &&
+	    rdataset->covers != dns_rdatatype_nsec3 &&
+	    (rdataset->type != dns_rdatatype_nsec ||
+	     loadctx->lastnode->nsec == DNS_RBT_NSEC_HAS_NSEC) &&
+	    dns_name_equal(name, dns_fixedname_name(&loadctx->lastname)))
+	{
+		/*
+		 * Same owner as the previous rdataset: the node and
+		 * any wildcard magic already exist.
+		 */
+		if (rdataset->type == dns_rdatatype_ns &&
+		    dns_name_iswildcard(name))
+			return (DNS_R_INVALIDNS);
+		node = loadctx->lastnode;
+		goto addheader;
+	}
+
 	if (rdataset->type != dns_rdatatype_nsec3 &&
 	    rdataset->covers != dns_rdatatype_nsec3)
 		add_empty_wildcards(rbtdb, name);
@@ -7173,7 +7500,6 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 			return (result);
 	}
 
-	node = NULL;
 	if (rdataset->type == dns_rdatatype_nsec3 ||
 	    rdataset->covers == dns_rdatatype_nsec3) {
 		result = dns_rbt_addnode(rbtdb->nsec3, name, &node);
@@ -7197,7 +7523,16 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 			rbtdb->node_lock_count;
 #endif
 	}
+	if (node->nsec != DNS_RBT_NSEC_NSEC3) {
+		loadctx->lastnode = node;
+		result = dns_name_copy(name,
+				       dns_fixedname_name(&loadctx->lastname),
+				       NULL);
+		if (result != ISC_R_SUCCESS)
+			loadctx->lastnode = NULL;
+	}
 
+ addheader:
 	result = dns_rdataslab_fromrdataset(rdataset, rbtdb->common.mctx,
 					    &region,
 					    sizeof(rdatasetheader_t));
@@ -7250,6 +7585,8 @@ beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp, dns_dbload_t **dbloadp) {
 		return (ISC_R_NOMEMORY);
 
 	loadctx->rbtdb = rbtdb;
+	loadctx->lastnode = NULL;
+	dns_fixedname_init(&loadctx->lastname);
 	if (IS_CACHE(rbtdb))
 		isc_stdtime_get(&loadctx->now);
 	else
@@ -7296,6 +7633,18 @@ endload(dns_db_t *db, dns_dbload_t **dbloadp) {
 	if (! IS_CACHE(rbtdb))
 		iszonesecure(db, rbtdb->current_version, rbtdb->origin_node);
 
+#ifdef BIND9
+	/*
+	 * Let queries skip a response policy zone by its new triggers.
+	 */
+	if (rbtdb->rpz_cidr != NULL) {
+		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+		rpz_resummarize(rbtdb);
+		dns_rpz_cidr_publish(rbtdb->rpz_cidr);
+		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	}
+#endif
+
 	*dbloadp = NULL;
 
 	isc_mem_put(rbtdb->common.mctx, loadctx, sizeof(*loadctx));
@@ -7490,8 +7839,7 @@ setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
 	REQUIRE(!IS_CACHE(rbtdb));
 	REQUIRE(rdataset != NULL);
 
-	header = rdataset->private3;
-	header--;
+	header = rdataset_header(rdataset);
 
 	NODE_LOCK(&rbtdb->node_locks[header->node->locknum].lock,
 		  isc_rwlocktype_write);
@@ -7590,9 +7938,8 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 
 	node = rdataset->private2;
 	INSIST(node != NULL);
-	header = rdataset->private3;
-	INSIST(header != NULL);
-	header--;
+	INSIST(rdataset->private3 != NULL);
+	header = rdataset_header(rdataset);
 
 	if (header->heap_index == 0)
 		return;
@@ -7665,7 +8012,13 @@ static dns_dbmethods_t zone_methods = {
 	NULL,
 #endif
 	NULL,
-	NULL
+	NULL,
+#ifdef BIND9
+	rpz_setsummary,
+#else
+	NULL,
+#endif
+	setslabstore
 };
 
 static dns_dbmethods_t cache_methods = {
@@ -7708,6 +8061,8 @@ static dns_dbmethods_t cache_methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -7787,6 +8142,7 @@ dns_rbtdb_create
 	}
 
 	rbtdb->rrsetstats = NULL;
+	rbtdb->slabstore = NULL;
 	if (IS_CACHE(rbtdb)) {
 		result = dns_rdatasetstats_create(mctx, &rbtdb->rrsetstats);
 		if (result != ISC_R_SUCCESS)
@@ -8291,9 +8647,8 @@ static void
 rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust) {
 	dns_rbtdb_t *rbtdb = rdataset->private1;
 	dns_rbtnode_t *rbtnode = rdataset->private2;
-	rdatasetheader_t *header = rdataset->private3;
+	rdatasetheader_t *header = rdataset_header(rdataset);
 
-	header--;
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 	header->trust = rdataset->trust = trust;
@@ -8305,9 +8660,8 @@ static void
 rdataset_expire(dns_rdataset_t *rdataset) {
 	dns_rbtdb_t *rbtdb = rdataset->private1;
 	dns_rbtnode_t *rbtnode = rdataset->private2;
-	rdatasetheader_t *header = rdataset->private3;
+	rdatasetheader_t *header = rdataset_header(rdataset);
 
-	header--;
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 	expire_header(rbtdb, header, ISC_FALSE);
@@ -9040,7 +9394,7 @@ rdataset_getadditional(dns_rdataset_t *rdataset, dns_rdatasetadditional_t type,
 	UNUSED(qtype); /* we do not use this value at least for now */
 	UNUSED(acache);
 
-	header = (struct rdatasetheader *)(raw - sizeof(*header));
+	header = rdataset_header(rdataset);
 
 	total_count = raw[0] * 256 + raw[1];
 	INSIST(total_count > current_count);
@@ -9203,7 +9557,7 @@ rdataset_setadditional(dns_rdataset_t *rdataset, dns_rdatasetadditional_t type,
 	if (type == dns_rdatasetadditional_fromcache)
 		return (ISC_R_SUCCESS);
 
-	header = (struct rdatasetheader *)(raw - sizeof(*header));
+	header = rdataset_header(rdataset);
 
 	total_count = raw[0] * 256 + raw[1];
 	INSIST(total_count > current_count);
@@ -9342,7 +9696,7 @@ rdataset_putadditional(dns_acache_t *acache, dns_rdataset_t *rdataset,
 	if (type == dns_rdatasetadditional_fromcache)
 		return (ISC_R_SUCCESS);
 
-	header = (struct rdatasetheader *)(raw - sizeof(*header));
+	header = rdataset_header(rdataset);
 
 	total_count = raw[0] * 256 + raw[1];
 	INSIST(total_count > current_count);
@@ -36,6 +36,7 @@
 #include <dns/acl.h>
 #include <dns/adb.h>
 #include <dns/cache.h>
+#include <dns/capture.h>
 #include <dns/db.h>
 #include <dns/dispatch.h>
 #include <dns/ds.h>
@@ -178,6 +179,8 @@ typedef struct query {
 	unsigned int			attributes;
 	unsigned int			sends;
 	unsigned int			connects;
+	isc_sockaddr_t			localaddr;	/* for capture */
+	isc_boolean_t			haslocaladdr;
 	unsigned char			data[512];
 } resquery_t;
 
@@ -1276,6 +1279,54 @@ resquery_udpconnected(isc_task_t *task, isc_event_t *event) {
 	process_sendevent(query, event);
 }
 
+/*%
+ * Find the local address of 'query'.  A UDP dispatch knows the port the
+ * query was sent from.  Failing that, the dispatch's address has no
+ * port when the query has a socket of its own, so ask the socket.
+ */
+static isc_result_t
+resquery_localaddress(resquery_t *query, isc_sockaddr_t *addrp) {
+	isc_socket_t *socket = NULL;
+
+	if (query->dispentry != NULL &&
+	    dns_dispatch_getentrylocaladdress(query->dispentry,
+					      addrp) == ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+	if (query->exclusivesocket && query->dispentry != NULL)
+		socket = dns_dispatch_getentrysocket(query->dispentry);
+	else if (!query->exclusivesocket)
+		socket = dns_dispatch_getsocket(query->dispatch);
+	if (socket != NULL &&
+	    isc_socket_getsockname(socket, addrp) == ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+	return (dns_dispatch_getlocaladdress(query->dispatch, addrp));
+}
+
+/*%
+ * Queue a capture frame for 'message', exchanged between our query
+ * socket and the server, if the view captures 'type'.  The local
+ * address is looked up once per query.
+ */
+static void
+resquery_capture(resquery_t *query, dns_capturetype_t type,
+		 const isc_region_t *message)
+{
+	dns_view_t *view = query->fctx->res->view;
+
+	if (view->capture == NULL || (view->capturetypes & type) == 0)
+		return;
+
+	if (!query->haslocaladdr &&
+	    resquery_localaddress(query, &query->localaddr) == ISC_R_SUCCESS)
+		query->haslocaladdr = ISC_TRUE;
+
+	dns_capture_message(view->capture, type,
+			    ISC_TF((query->options & DNS_FETCHOPT_TCP) != 0),
+			    query->haslocaladdr ? &query->localaddr : NULL,
+			    &query->addrinfo->sockaddr, NULL, message);
+}
+
 static void
 resquery_senddone(isc_task_t *task, isc_event_t *event) {
 	resquery_t *query = event->ev_arg;
@@ -1417,6 +1468,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	query->dispatchmgr = res->dispatchmgr;
 	query->dispatch = NULL;
 	query->exclusivesocket = ISC_FALSE;
+	query->haslocaladdr = ISC_FALSE;
 	query->tcpsocket = NULL;
 	if (res->view->peers != NULL) {
 		dns_peer_t *peer = NULL;
@@ -2047,6 +2099,9 @@ resquery_send(resquery_t *query) {
 
 	query->sends++;
 
+	isc_buffer_usedregion(&query->buffer, &r);
+	resquery_capture(query, dns_capturetype_resolverquery, &r);
+
 	QTRACE("sent");
 
 	return (ISC_R_SUCCESS);
@@ -6933,6 +6988,7 @@ resquery_response(isc_task_t *task, isc_event_t *event) {
 	isc_result_t broken_server;
 	badnstype_t broken_type = badns_response;
 	isc_boolean_t no_response;
+	isc_region_t r;
 
 	REQUIRE(VALID_QUERY(query));
 	fctx = query->fctx;
@@ -7018,6 +7074,9 @@ resquery_response(isc_task_t *task, isc_event_t *event) {
 
 	message = fctx->rmessage;
 
+	isc_buffer_usedregion(&devent->buffer, &r);
+	resquery_capture(query, dns_capturetype_resolverresponse, &r);
+
 	if (query->tsig != NULL) {
 		result = dns_message_setquerytsig(message, query->tsig);
 		if (result != ISC_R_SUCCESS)
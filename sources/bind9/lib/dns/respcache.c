@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/netaddr.h>
+#include <isc/refcount.h>
+#include <isc/region.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/acl.h>
+#include <dns/respcache.h>
+#include <dns/zone.h>
+
+#define RESPCACHE_MAGIC			ISC_MAGIC('R', 's', 'p', 'C')
+#define VALID_RESPCACHE(c)		ISC_MAGIC_VALID(c, RESPCACHE_MAGIC)
+
+/*%
+ * Slot i is protected by locks[i % RESPCACHE_NLOCKS].
+ */
+#define RESPCACHE_NLOCKS		64
+
+typedef struct respcache_entry respcache_entry_t;
+struct respcache_entry {
+	isc_uint32_t			hash;
+	isc_uint32_t			generation;
+	isc_uint32_t			tag;
+	dns_zone_t			*zone;
+	unsigned int			nconds;
+	dns_respcachecond_t		conds[DNS_RESPCACHE_MAXCONDS];
+	unsigned int			keylen;
+	unsigned int			length;
+	/* 'keylen' bytes of key, then 'length' bytes of response */
+};
+#define ENTRY_KEY(e)		((unsigned char *)((e) + 1))
+#define ENTRY_RESPONSE(e)	(ENTRY_KEY(e) + (e)->keylen)
+
+struct dns_respcache {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	isc_refcount_t			references;
+	unsigned int			size;		/* power of 2 */
+	respcache_entry_t		**table;
+	isc_mutex_t			locks[RESPCACHE_NLOCKS];
+};
+
+#define SLOT_LOCK(c, i)		(&(c)->locks[(i) % RESPCACHE_NLOCKS])
+
+static isc_uint32_t
+key_hash(const isc_region_t *key) {
+	isc_uint32_t hash = 2166136261U;
+	const unsigned char *p = key->base;
+	unsigned int length = key->length;
+
+	while (length-- > 0)
+		hash = (hash ^ *p++) * 16777619U;
+	return (hash);
+}
+
+static void
+free_entry(dns_respcache_t *cache, respcache_entry_t *e) {
+	unsigned int i;
+
+	for (i = 0; i < e->nconds; i++)
+		dns_acl_detach(&e->conds[i].acl);
+	if (e->zone != NULL)
+		dns_zone_detach(&e->zone);
+	isc_mem_put(cache->mctx, e, sizeof(*e) + e->keylen + e->length);
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, unsigned int size,
+		     dns_respcache_t **cachep)
+{
+	dns_respcache_t *cache;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(cache, 0, sizeof(*cache));
+
+	cache->size = 1;
+	while (cache->size < size && cache->size < (1U << 31))
+		cache->size <<= 1;
+	cache->table = isc_mem_get(mctx, cache->size * sizeof(*cache->table));
+	if (cache->table == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_cache;
+	}
+	memset(cache->table, 0, cache->size * sizeof(*cache->table));
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_table;
+	for (i = 0; i < RESPCACHE_NLOCKS; i++) {
+		result = isc_mutex_init(&cache->locks[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_locks;
+	}
+
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->magic = RESPCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_locks:
+	while (i-- > 0)
+		DESTROYLOCK(&cache->locks[i]);
+	isc_refcount_destroy(&cache->references);
+ cleanup_table:
+	isc_mem_put(mctx, cache->table, cache->size * sizeof(*cache->table));
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_respcache_attach(dns_respcache_t *source, dns_respcache_t **targetp) {
+	REQUIRE(VALID_RESPCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_respcache_detach(dns_respcache_t **cachep) {
+	dns_respcache_t *cache;
+	unsigned int refs, i;
+
+	REQUIRE(cachep != NULL && VALID_RESPCACHE(*cachep));
+	cache = *cachep;
+	*cachep = NULL;
+
+	isc_refcount_decrement(&cache->references, &refs);
+	if (refs != 0)
+		return;
+
+	for (i = 0; i < cache->size; i++)
+		if (cache->table[i] != NULL)
+			free_entry(cache, cache->table[i]);
+	isc_mem_put(cache->mctx, cache->table,
+		    cache->size * sizeof(*cache->table));
+	for (i = 0; i < RESPCACHE_NLOCKS; i++)
+		DESTROYLOCK(&cache->locks[i]);
+	isc_refcount_destroy(&cache->references);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *cache, const isc_region_t *key,
+		  isc_uint32_t generation, const isc_region_t *response,
+		  const dns_respcachecond_t *conds, unsigned int nconds,
+		  dns_zone_t *zone, isc_uint32_t tag)
+{
+	respcache_entry_t *e, *old;
+	unsigned int i, slot;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(key != NULL && key->length > 0);
+	REQUIRE(response != NULL && response->length > 0);
+	REQUIRE(nconds <= DNS_RESPCACHE_MAXCONDS);
+	REQUIRE(nconds == 0 || conds != NULL);
+
+	e = isc_mem_get(cache->mctx,
+			sizeof(*e) + key->length + response->length);
+	if (e == NULL)
+		return (ISC_R_NOMEMORY);
+	e->hash = key_hash(key);
+	e->generation = generation;
+	e->tag = tag;
+	e->zone = NULL;
+	if (zone != NULL)
+		dns_zone_attach(zone, &e->zone);
+	for (i = 0; i < nconds; i++) {
+		e->conds[i] = conds[i];
+		e->conds[i].acl = NULL;
+		dns_acl_attach(conds[i].acl, &e->conds[i].acl);
+	}
+	e->nconds = nconds;
+	e->keylen = key->length;
+	e->length = response->length;
+	memmove(ENTRY_KEY(e), key->base, key->length);
+	memmove(ENTRY_RESPONSE(e), response->base, response->length);
+
+	slot = e->hash & (cache->size - 1);
+	LOCK(SLOT_LOCK(cache, slot));
+	old = cache->table[slot];
+	cache->table[slot] = e;
+	UNLOCK(SLOT_LOCK(cache, slot));
+
+	if (old != NULL)
+		free_entry(cache, old);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const isc_region_t *key,
+		   isc_uint32_t generation, const isc_netaddr_t *source,
+		   const isc_netaddr_t *destination, const dns_aclenv_t *env,
+		   isc_buffer_t *target, dns_zone_t **zonep,
+		   isc_uint32_t *tagp)
+{
+	respcache_entry_t *e, *stale = NULL;
+	const isc_netaddr_t *addr;
+	isc_result_t result;
+	isc_boolean_t allowed;
+	isc_uint32_t hash;
+	unsigned int i, slot;
+	int match;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(key != NULL && key->length > 0);
+	REQUIRE(source != NULL && destination != NULL && env != NULL);
+	REQUIRE(zonep != NULL && *zonep == NULL);
+	REQUIRE(tagp != NULL);
+
+	hash = key_hash(key);
+	slot = hash & (cache->size - 1);
+
+	LOCK(SLOT_LOCK(cache, slot));
+	e = cache->table[slot];
+	if (e == NULL || e->hash != hash || e->keylen != key->length ||
+	    memcmp(ENTRY_KEY(e), key->base, key->length) != 0)
+	{
+		result = ISC_R_NOTFOUND;
+		goto unlock;
+	}
+	if (e->generation != generation) {
+		cache->table[slot] = NULL;
+		stale = e;
+		result = ISC_R_NOTFOUND;
+		goto unlock;
+	}
+	for (i = 0; i < e->nconds; i++) {
+		addr = e->conds[i].destination ? destination : source;
+		result = dns_acl_match(addr, NULL, e->conds[i].acl, env,
+				       &match, NULL);
+		allowed = ISC_TF(result == ISC_R_SUCCESS && match > 0);
+		if (allowed != e->conds[i].allowed) {
+			result = ISC_R_NOTFOUND;
+			goto unlock;
+		}
+	}
+	if (isc_buffer_availablelength(target) < e->length) {
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+	isc_buffer_putmem(target, ENTRY_RESPONSE(e), e->length);
+	if (e->zone != NULL)
+		dns_zone_attach(e->zone, zonep);
+	*tagp = e->tag;
+	result = ISC_R_SUCCESS;
+
+ unlock:
+	UNLOCK(SLOT_LOCK(cache, slot));
+
+	if (stale != NULL)
+		free_entry(cache, stale);
+	return (result);
+}
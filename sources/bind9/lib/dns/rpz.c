@@ -22,10 +22,14 @@
 #include <config.h>
 
 #include <isc/buffer.h>
+#include <isc/histo.h>
+#include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/net.h>
 #include <isc/netaddr.h>
 #include <isc/print.h>
+#include <isc/refcount.h>
 #include <isc/stdlib.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -122,6 +126,10 @@ struct dns_rpz_cidr {
 	dns_name_t		ip_name;	/* RPZ_IP_ZONE.origin. */
 	dns_name_t		nsip_name;      /* RPZ_NSIP_ZONE.origin. */
 	dns_name_t		nsdname_name;	/* RPZ_NSDNAME_ZONE.origin */
+	unsigned int		origin_labels;
+	dns_rpz_summary_t	*summary;	/* of the view */
+	int			num;		/* policy zone in summary */
+	isc_boolean_t		incomplete;	/* triggers not in summary */
 };
 
 const char *
@@ -196,6 +204,1402 @@ dns_rpz_policy2str(dns_rpz_policy_t policy) {
 	return (str);
 }
 
+/*
+ * Convert an IP address to a CIDR tree key.
+ */
+static isc_boolean_t
+netaddr2key(const isc_netaddr_t *netaddr, dns_rpz_cidr_key_t *key) {
+	int i;
+
+	if (netaddr->family == AF_INET) {
+		key->w[0] = 0;
+		key->w[1] = 0;
+		key->w[2] = ADDR_V4MAPPED;
+		key->w[3] = ntohl(netaddr->type.in.s_addr);
+	} else if (netaddr->family == AF_INET6) {
+		dns_rpz_cidr_key_t src_ip6;
+
+		/*
+		 * Given the int aligned struct in_addr member of netaddr->type
+		 * one could cast netaddr->type.in6 to dns_rpz_cidr_key_t *,
+		 * but there are objections.
+		 */
+		memmove(src_ip6.w, &netaddr->type.in6, sizeof(src_ip6.w));
+		for (i = 0; i < 4; i++) {
+			key->w[i] = ntohl(src_ip6.w[i]);
+		}
+	} else {
+		return (ISC_FALSE);
+	}
+	return (ISC_TRUE);
+}
+
+/*
+ * The summary of the policy zones of a view lets a query skip the
+ * policy zones that cannot have a trigger for it without finding
+ * their databases.
+ *
+ * The radix tree of each policy zone database adds and removes its
+ * triggers in hash tables in the summary as it adds and deletes its
+ * names, including while a zone transfer or dynamic update changes the
+ * zone.  Entries are tagged with the tree that added them, so the old
+ * and new databases of a zone being reloaded can both contribute.
+ * QNAME and NSDNAME triggers are keyed by the downcased wire form of
+ * the name that they trigger on, with wildcards kept apart and keyed
+ * by the name below the "*" label.  IP and NSIP triggers are keyed by
+ * their prefix length and CIDR block in a table of their own.
+ *
+ * Queries do not use those tables.  When a database finishes a load or
+ * commits an update, the changes are compiled into a new snapshot that
+ * replaces the one queries use, and a snapshot never changes once it
+ * is made.  The name triggers of a snapshot are split by hash into
+ * SUMMARY_CHUNKS chunks, and only the chunks with changed triggers are
+ * rebuilt; the others are shared with the previous snapshot.  The IP
+ * and NSIP triggers are flattened into sorted tables of address
+ * ranges, so that an address is found with one binary search whatever
+ * the prefix lengths in use.  Deleted triggers can stay in the current
+ * snapshot until the next one is made, which only costs a search.
+ *
+ * A policy zone with a database that could not record all of its
+ * triggers is always searched until the database has reported them
+ * again, which it does when it next commits an update or is given a
+ * summary.  One with a database that left for the summary of another
+ * view is always searched for as long as this summary is used.  If a
+ * snapshot cannot be made for lack of memory, every policy zone is
+ * searched until one can.
+ */
+#define RPZ_SUMMARY_MAGIC		ISC_MAGIC('R', 'P', 'Z', 'S')
+#define VALID_SUMMARY(s)		ISC_MAGIC_VALID(s, RPZ_SUMMARY_MAGIC)
+#define RPZ_SNAPSHOT_MAGIC		ISC_MAGIC('R', 'P', 'Z', 'N')
+#define VALID_SNAPSHOT(s)		ISC_MAGIC_VALID(s, RPZ_SNAPSHOT_MAGIC)
+
+#define SUMMARY_QNAME			0
+#define SUMMARY_QNAME_WILD		1
+#define SUMMARY_NSDNAME			2
+#define SUMMARY_NSDNAME_WILD		3
+#define SUMMARY_IP			4
+#define SUMMARY_NSIP			5
+#define SUMMARY_ISIP(type)		((type) >= SUMMARY_IP)
+
+/*
+ * Kinds of triggers counted for dns_rpz_snapshot_enabled().
+ */
+#define SUMMARY_HAVE_IP			0
+#define SUMMARY_HAVE_NSIPv4		1
+#define SUMMARY_HAVE_NSIPv6		2
+#define SUMMARY_HAVE_NSDNAME		3
+#define SUMMARY_HAVES			4
+
+/*
+ * The hash tables never have fewer buckets than there are chunks,
+ * so the buckets of the entries of a chunk are those congruent to it.
+ */
+#define SUMMARY_CHUNKBITS		10
+#define SUMMARY_CHUNKS			(1 << SUMMARY_CHUNKBITS)
+#define SUMMARY_CHUNK(hash)		((hash) & (SUMMARY_CHUNKS - 1))
+#define SUMMARY_MINSIZE			SUMMARY_CHUNKS
+
+#define DOWNCASE(c)			((c) >= 'A' && (c) <= 'Z' ?	\
+					 (c) - 'A' + 'a' : (c))
+
+typedef struct summary_entry summary_entry_t;
+struct summary_entry {
+	summary_entry_t			*next;
+	const dns_rpz_cidr_t		*owner;
+	isc_uint32_t			hash;
+	isc_uint16_t			length;
+	isc_uint8_t			type;
+	isc_uint8_t			num;
+	/* 'length' bytes of key follow */
+};
+#define ENTRY_KEY(e)		((unsigned char *)((e) + 1))
+
+typedef struct {
+	unsigned int			size;		/* power of 2 */
+	unsigned int			count;
+	summary_entry_t			**buckets;
+} summary_table_t;
+
+/*
+ * The name triggers of a snapshot with the same chunk number, in a
+ * single block: a hash table of 'nbuckets' + 1 offsets into 'count'
+ * entries, followed by their keys.
+ */
+typedef struct {
+	isc_refcount_t			references;
+	size_t				size;
+	unsigned int			nbuckets;	/* power of 2 */
+	unsigned int			count;
+} summary_chunk_t;
+
+typedef struct {
+	isc_uint32_t			hash;
+	isc_uint32_t			key;		/* offset of the key */
+	isc_uint16_t			length;
+	isc_uint8_t			type;
+	isc_uint8_t			num;
+} chunk_entry_t;
+
+#define CHUNK_OFFSETS(c)	((isc_uint32_t *)((c) + 1))
+#define CHUNK_ENTRIES(c)	((chunk_entry_t *)(CHUNK_OFFSETS(c) +	\
+						   (c)->nbuckets + 1))
+#define CHUNK_KEYS(c)		((unsigned char *)(CHUNK_ENTRIES(c) +	\
+						   (c)->count))
+#define CHUNK_BUCKET(c, hash)	(((hash) >> SUMMARY_CHUNKBITS) &	\
+				 ((c)->nbuckets - 1))
+
+/*
+ * The IP or NSIP triggers of a snapshot as sorted address ranges,
+ * each with the policy zones that have a trigger containing it.
+ * Addresses below the first range are in no trigger.
+ */
+typedef struct {
+	dns_rpz_cidr_key_t		start;
+	dns_rpz_zbits_t			zbits;
+} summary_range_t;
+
+typedef struct {
+	isc_refcount_t			references;
+	unsigned int			count;
+	unsigned int			alloc;
+	summary_range_t			*range;
+} summary_ranges_t;
+
+struct dns_rpz_snapshot {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	isc_refcount_t			references;
+	dns_rpz_zbits_t			unknown;	/* always searched */
+	dns_rpz_zbits_t			have[SUMMARY_HAVES];
+	summary_ranges_t		*ranges[2];	/* IP, NSIP */
+	summary_chunk_t			*chunks[SUMMARY_CHUNKS];
+};
+
+struct dns_rpz_summary {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	isc_refcount_t			references;
+	isc_mutex_t			lock;
+	/* Locked by lock. */
+	summary_table_t			names;
+	summary_table_t			ips;
+	unsigned int			have[DNS_RPZ_SUMMARY_ZONES]
+					    [SUMMARY_HAVES];
+	unsigned int			incomplete[DNS_RPZ_SUMMARY_ZONES];
+	dns_rpz_zbits_t			departed;
+	isc_boolean_t			changed;
+	isc_boolean_t			ipchanged;
+	isc_uint8_t			dirty[SUMMARY_CHUNKS];
+	dns_rpz_snapshot_t		*built;
+	dns_rpz_snapshot_t		*everything;
+	/*
+	 * Changed with the lock held, but compared without it by
+	 * dns_rpz_summary_current().
+	 */
+	dns_rpz_snapshot_t		*current;
+	isc_histo_t			*updatehisto;
+};
+
+static isc_uint32_t
+summary_hash(unsigned int type, const unsigned char *key,
+	     unsigned int length)
+{
+	isc_uint32_t hash = 2166136261U;
+
+	hash = (hash ^ type) * 16777619U;
+	while (length-- > 0)
+		hash = (hash ^ *key++) * 16777619U;
+	return (hash);
+}
+
+/*
+ * Which dns_rpz_snapshot_enabled() count an entry is in, if any.
+ */
+static int
+summary_have(summary_entry_t *e) {
+	dns_rpz_cidr_key_t ip;
+	const unsigned char *key;
+
+	switch (e->type) {
+	case SUMMARY_IP:
+		return (SUMMARY_HAVE_IP);
+	case SUMMARY_NSIP:
+		key = ENTRY_KEY(e);
+		memmove(&ip, key + 1, sizeof(ip));
+		if (key[0] >= 96 && ip.w[0] == 0 && ip.w[1] == 0 &&
+		    ip.w[2] == ADDR_V4MAPPED)
+			return (SUMMARY_HAVE_NSIPv4);
+		return (SUMMARY_HAVE_NSIPv6);
+	case SUMMARY_NSDNAME:
+	case SUMMARY_NSDNAME_WILD:
+		return (SUMMARY_HAVE_NSDNAME);
+	default:
+		return (-1);
+	}
+}
+
+/*
+ * Count or uncount an entry, and note that the next snapshot
+ * must be made with the change.
+ */
+static void
+summary_count(dns_rpz_summary_t *summary, summary_entry_t *e,
+	      int delta)
+{
+	int have;
+
+	have = summary_have(e);
+	if (have >= 0)
+		summary->have[e->num][have] += delta;
+
+	summary->changed = ISC_TRUE;
+	if (SUMMARY_ISIP(e->type))
+		summary->ipchanged = ISC_TRUE;
+	else
+		summary->dirty[SUMMARY_CHUNK(e->hash)] = 1;
+}
+
+static isc_result_t
+table_init(isc_mem_t *mctx, summary_table_t *table) {
+	table->size = SUMMARY_MINSIZE;
+	table->count = 0;
+	table->buckets = isc_mem_get(mctx, table->size *
+				     sizeof(*table->buckets));
+	if (table->buckets == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(table->buckets, 0, table->size * sizeof(*table->buckets));
+	return (ISC_R_SUCCESS);
+}
+
+static void
+table_grow(isc_mem_t *mctx, summary_table_t *table) {
+	summary_entry_t **buckets, *e, *next;
+	unsigned int size, i;
+
+	size = table->size * 2;
+	buckets = isc_mem_get(mctx, size * sizeof(*buckets));
+	if (buckets == NULL)
+		return;
+	memset(buckets, 0, size * sizeof(*buckets));
+	for (i = 0; i < table->size; i++) {
+		for (e = table->buckets[i]; e != NULL; e = next) {
+			next = e->next;
+			e->next = buckets[e->hash & (size - 1)];
+			buckets[e->hash & (size - 1)] = e;
+		}
+	}
+	isc_mem_put(mctx, table->buckets, table->size * sizeof(*buckets));
+	table->buckets = buckets;
+	table->size = size;
+}
+
+static summary_table_t *
+summary_table(dns_rpz_summary_t *summary, unsigned int type) {
+	return (SUMMARY_ISIP(type) ? &summary->ips : &summary->names);
+}
+
+/*
+ * Add a trigger of policy zone 'num' from 'owner'.
+ * The summary lock must be held.
+ */
+static isc_result_t
+summary_add(dns_rpz_summary_t *summary, const dns_rpz_cidr_t *owner,
+	    int num, unsigned int type, const unsigned char *key,
+	    unsigned int length)
+{
+	summary_table_t *table = summary_table(summary, type);
+	summary_entry_t *e, **bucket;
+	isc_uint32_t hash;
+
+	hash = summary_hash(type, key, length);
+	bucket = &table->buckets[hash & (table->size - 1)];
+	for (e = *bucket; e != NULL; e = e->next) {
+		if (e->owner == owner && e->hash == hash && e->type == type &&
+		    e->length == length && memcmp(ENTRY_KEY(e), key,
+						  length) == 0)
+			return (ISC_R_SUCCESS);
+	}
+
+	e = isc_mem_get(summary->mctx, sizeof(*e) + length);
+	if (e == NULL)
+		return (ISC_R_NOMEMORY);
+	e->owner = owner;
+	e->hash = hash;
+	e->length = length;
+	e->type = type;
+	e->num = num;
+	memmove(ENTRY_KEY(e), key, length);
+	e->next = *bucket;
+	*bucket = e;
+	table->count++;
+	summary_count(summary, e, 1);
+
+	if (table->count > table->size * 2)
+		table_grow(summary->mctx, table);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+summary_free(dns_rpz_summary_t *summary, summary_table_t *table,
+	     summary_entry_t **ep)
+{
+	summary_entry_t *e = *ep;
+
+	*ep = e->next;
+	table->count--;
+	summary_count(summary, e, -1);
+	isc_mem_put(summary->mctx, e, sizeof(*e) + e->length);
+}
+
+/*
+ * Remove a trigger added by 'owner'.
+ * The summary lock must be held.
+ */
+static void
+summary_remove(dns_rpz_summary_t *summary, const dns_rpz_cidr_t *owner,
+	       unsigned int type, const unsigned char *key,
+	       unsigned int length)
+{
+	summary_table_t *table = summary_table(summary, type);
+	summary_entry_t *e, **ep;
+	isc_uint32_t hash;
+
+	hash = summary_hash(type, key, length);
+	for (ep = &table->buckets[hash & (table->size - 1)];
+	     (e = *ep) != NULL;
+	     ep = &e->next) {
+		if (e->owner == owner && e->hash == hash && e->type == type &&
+		    e->length == length && memcmp(ENTRY_KEY(e), key,
+						  length) == 0) {
+			summary_free(summary, table, ep);
+			return;
+		}
+	}
+}
+
+/*
+ * Remove all of the triggers added by 'owner', or all of them.
+ * The summary lock must be held.
+ */
+static void
+summary_forget(dns_rpz_summary_t *summary, summary_table_t *table,
+	       const dns_rpz_cidr_t *owner)
+{
+	summary_entry_t *e, **ep;
+	unsigned int i;
+
+	for (i = 0; i < table->size; i++) {
+		ep = &table->buckets[i];
+		while ((e = *ep) != NULL) {
+			if (owner == NULL || e->owner == owner)
+				summary_free(summary, table, ep);
+			else
+				ep = &e->next;
+		}
+	}
+}
+
+/*
+ * Note whether the summary lacks triggers of the database owning 'cidr'.
+ * The summary lock must be held.
+ */
+static void
+summary_incomplete(dns_rpz_cidr_t *cidr, isc_boolean_t incomplete) {
+	dns_rpz_summary_t *summary = cidr->summary;
+
+	if (cidr->incomplete == incomplete)
+		return;
+	cidr->incomplete = incomplete;
+	if (incomplete)
+		summary->incomplete[cidr->num]++;
+	else
+		summary->incomplete[cidr->num]--;
+	summary->changed = ISC_TRUE;
+}
+
+static void
+chunk_detach(isc_mem_t *mctx, summary_chunk_t **chunkp) {
+	summary_chunk_t *chunk = *chunkp;
+	unsigned int refs;
+
+	*chunkp = NULL;
+	isc_refcount_decrement(&chunk->references, &refs);
+	if (refs != 0)
+		return;
+	isc_refcount_destroy(&chunk->references);
+	isc_mem_put(mctx, chunk, chunk->size);
+}
+
+static void
+ranges_detach(isc_mem_t *mctx, summary_ranges_t **rangesp) {
+	summary_ranges_t *ranges = *rangesp;
+	unsigned int refs;
+
+	*rangesp = NULL;
+	isc_refcount_decrement(&ranges->references, &refs);
+	if (refs != 0)
+		return;
+	isc_refcount_destroy(&ranges->references);
+	isc_mem_put(mctx, ranges->range, ranges->alloc * sizeof(*ranges->range));
+	isc_mem_put(mctx, ranges, sizeof(*ranges));
+}
+
+static isc_result_t
+snapshot_create(isc_mem_t *mctx, dns_rpz_snapshot_t **snapshotp) {
+	dns_rpz_snapshot_t *snapshot;
+	isc_result_t result;
+
+	snapshot = isc_mem_get(mctx, sizeof(*snapshot));
+	if (snapshot == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(snapshot, 0, sizeof(*snapshot));
+	result = isc_refcount_init(&snapshot->references, 1);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, snapshot, sizeof(*snapshot));
+		return (result);
+	}
+	isc_mem_attach(mctx, &snapshot->mctx);
+	snapshot->magic = RPZ_SNAPSHOT_MAGIC;
+	*snapshotp = snapshot;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+snapshot_attach(dns_rpz_snapshot_t *source, dns_rpz_snapshot_t **target) {
+	REQUIRE(VALID_SNAPSHOT(source));
+	REQUIRE(target != NULL && *target == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*target = source;
+}
+
+void
+dns_rpz_snapshot_detach(dns_rpz_snapshot_t **snapshotp) {
+	dns_rpz_snapshot_t *snapshot;
+	unsigned int refs, i;
+
+	REQUIRE(snapshotp != NULL && VALID_SNAPSHOT(*snapshotp));
+	snapshot = *snapshotp;
+	*snapshotp = NULL;
+
+	isc_refcount_decrement(&snapshot->references, &refs);
+	if (refs != 0)
+		return;
+
+	for (i = 0; i < SUMMARY_CHUNKS; i++) {
+		if (snapshot->chunks[i] != NULL)
+			chunk_detach(snapshot->mctx, &snapshot->chunks[i]);
+	}
+	for (i = 0; i < 2; i++) {
+		if (snapshot->ranges[i] != NULL)
+			ranges_detach(snapshot->mctx, &snapshot->ranges[i]);
+	}
+	isc_refcount_destroy(&snapshot->references);
+	snapshot->magic = 0;
+	isc_mem_putanddetach(&snapshot->mctx, snapshot, sizeof(*snapshot));
+}
+
+/*
+ * Compile the name triggers with chunk number 'c'.
+ */
+static isc_result_t
+chunk_make(dns_rpz_summary_t *summary, unsigned int c,
+	   summary_chunk_t **chunkp)
+{
+	summary_table_t *table = &summary->names;
+	summary_chunk_t *chunk;
+	summary_entry_t *e;
+	chunk_entry_t *entry;
+	isc_uint32_t *offsets;
+	unsigned char *keys;
+	unsigned int i, b, count, keylen, nbuckets;
+	size_t size;
+	isc_result_t result;
+
+	count = 0;
+	keylen = 0;
+	for (i = c; i < table->size; i += SUMMARY_CHUNKS) {
+		for (e = table->buckets[i]; e != NULL; e = e->next) {
+			count++;
+			keylen += e->length;
+		}
+	}
+	if (count == 0) {
+		*chunkp = NULL;
+		return (ISC_R_SUCCESS);
+	}
+
+	for (nbuckets = 1; nbuckets < count; nbuckets <<= 1)
+		continue;
+	size = sizeof(*chunk) + (nbuckets + 1) * sizeof(*offsets) +
+	       count * sizeof(*entry) + keylen;
+	chunk = isc_mem_get(summary->mctx, size);
+	if (chunk == NULL)
+		return (ISC_R_NOMEMORY);
+	result = isc_refcount_init(&chunk->references, 1);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(summary->mctx, chunk, size);
+		return (result);
+	}
+	chunk->size = size;
+	chunk->nbuckets = nbuckets;
+	chunk->count = count;
+	offsets = CHUNK_OFFSETS(chunk);
+	entry = CHUNK_ENTRIES(chunk);
+	keys = CHUNK_KEYS(chunk);
+
+	/*
+	 * Count the entries of each bucket, turn the counts into the
+	 * offsets of the buckets, and fill the buckets, which leaves each
+	 * offset at the start of the next bucket.
+	 */
+	memset(offsets, 0, (nbuckets + 1) * sizeof(*offsets));
+	for (i = c; i < table->size; i += SUMMARY_CHUNKS) {
+		for (e = table->buckets[i]; e != NULL; e = e->next)
+			offsets[CHUNK_BUCKET(chunk, e->hash) + 1]++;
+	}
+	for (b = 0; b < nbuckets; b++)
+		offsets[b + 1] += offsets[b];
+	keylen = 0;
+	for (i = c; i < table->size; i += SUMMARY_CHUNKS) {
+		for (e = table->buckets[i]; e != NULL; e = e->next) {
+			b = offsets[CHUNK_BUCKET(chunk, e->hash)]++;
+			entry[b].hash = e->hash;
+			entry[b].key = keylen;
+			entry[b].length = e->length;
+			entry[b].type = e->type;
+			entry[b].num = e->num;
+			memmove(keys + keylen, ENTRY_KEY(e), e->length);
+			keylen += e->length;
+		}
+	}
+	for (b = nbuckets; b > 0; b--)
+		offsets[b] = offsets[b - 1];
+	offsets[0] = 0;
+
+	*chunkp = chunk;
+	return (ISC_R_SUCCESS);
+}
+
+static int
+key_cmp(const dns_rpz_cidr_key_t *key1, const dns_rpz_cidr_key_t *key2) {
+	int i;
+
+	for (i = 0; i < DNS_RPZ_CIDR_WORDS; i++) {
+		if (key1->w[i] != key2->w[i])
+			return (key1->w[i] < key2->w[i] ? -1 : 1);
+	}
+	return (0);
+}
+
+/*
+ * Step to the next address, returning ISC_FALSE past the last.
+ */
+static isc_boolean_t
+key_next(dns_rpz_cidr_key_t *key) {
+	int i;
+
+	for (i = DNS_RPZ_CIDR_WORDS - 1; i >= 0; i--) {
+		if (++key->w[i] != 0)
+			return (ISC_TRUE);
+	}
+	return (ISC_FALSE);
+}
+
+typedef struct {
+	dns_rpz_cidr_key_t		first;
+	dns_rpz_cidr_key_t		last;
+	dns_rpz_cidr_bits_t		prefix;
+	dns_rpz_zbits_t			zbits;
+} summary_block_t;
+
+static int
+block_cmp(const void *p1, const void *p2) {
+	const summary_block_t *b1 = p1, *b2 = p2;
+	int cmp;
+
+	cmp = key_cmp(&b1->first, &b2->first);
+	if (cmp != 0)
+		return (cmp);
+	return ((int)b1->prefix - (int)b2->prefix);
+}
+
+/*
+ * Start a range of the addresses from 'start' on, replacing a range
+ * that started at the same address.
+ */
+static void
+range_add(summary_ranges_t *ranges, const dns_rpz_cidr_key_t *start,
+	  dns_rpz_zbits_t zbits)
+{
+	summary_range_t *last;
+
+	if (ranges->count != 0) {
+		last = &ranges->range[ranges->count - 1];
+		if (key_cmp(&last->start, start) == 0) {
+			last->zbits = zbits;
+			return;
+		}
+	}
+	INSIST(ranges->count < ranges->alloc);
+	ranges->range[ranges->count].start = *start;
+	ranges->range[ranges->count].zbits = zbits;
+	ranges->count++;
+}
+
+/*
+ * Compile the IP ('type' SUMMARY_IP) or NSIP triggers into ranges.
+ * The CIDR blocks of the triggers are sorted so that each block comes
+ * after the blocks that contain it.  The blocks containing the current
+ * one are kept on a stack with the policy zones of all of them, so that
+ * a range can be started where each block starts and where it ends.
+ */
+static isc_result_t
+ranges_make(dns_rpz_summary_t *summary, unsigned int type,
+	    summary_ranges_t **rangesp)
+{
+	summary_table_t *table = &summary->ips;
+	summary_ranges_t *ranges;
+	summary_block_t *blocks, *block, *stack;
+	summary_entry_t *e;
+	dns_rpz_cidr_key_t next;
+	dns_rpz_zbits_t zbits;
+	unsigned int i, n, depth;
+	int bits, w;
+	isc_result_t result;
+
+	n = 0;
+	for (i = 0; i < table->size; i++) {
+		for (e = table->buckets[i]; e != NULL; e = e->next) {
+			if (e->type == type)
+				n++;
+		}
+	}
+	if (n == 0) {
+		*rangesp = NULL;
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * The blocks and the stack of containing blocks.
+	 */
+	blocks = isc_mem_get(summary->mctx, 2 * n * sizeof(*blocks));
+	if (blocks == NULL)
+		return (ISC_R_NOMEMORY);
+	stack = blocks + n;
+
+	ranges = isc_mem_get(summary->mctx, sizeof(*ranges));
+	if (ranges == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_blocks;
+	}
+	ranges->count = 0;
+	ranges->alloc = 2 * n;
+	ranges->range = isc_mem_get(summary->mctx,
+				    ranges->alloc * sizeof(*ranges->range));
+	if (ranges->range == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_ranges;
+	}
+	result = isc_refcount_init(&ranges->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_range;
+
+	block = blocks;
+	for (i = 0; i < table->size; i++) {
+		for (e = table->buckets[i]; e != NULL; e = e->next) {
+			if (e->type != type)
+				continue;
+			block->prefix = ENTRY_KEY(e)[0];
+			memmove(&block->first, ENTRY_KEY(e) + 1,
+				sizeof(block->first));
+			for (w = 0; w < DNS_RPZ_CIDR_WORDS; w++) {
+				bits = block->prefix -
+				       w * DNS_RPZ_CIDR_WORD_BITS;
+				if (bits >= DNS_RPZ_CIDR_WORD_BITS)
+					block->last.w[w] = block->first.w[w];
+				else if (bits <= 0)
+					block->last.w[w] = ~0U;
+				else
+					block->last.w[w] = block->first.w[w] |
+						~DNS_RPZ_WORD_MASK(bits);
+			}
+			block->zbits = DNS_RPZ_ZBIT(e->num);
+			block++;
+		}
+	}
+	qsort(blocks, n, sizeof(*blocks), block_cmp);
+
+	depth = 0;
+	for (i = 0; i <= n; i++) {
+		/*
+		 * End the blocks that end before this one starts.
+		 */
+		while (depth > 0 &&
+		       (i == n ||
+			key_cmp(&stack[depth - 1].last, &blocks[i].first) < 0))
+		{
+			next = stack[--depth].last;
+			if (key_next(&next))
+				range_add(ranges, &next, depth > 0 ?
+					  stack[depth - 1].zbits : 0);
+		}
+		if (i == n)
+			break;
+
+		zbits = blocks[i].zbits;
+		if (depth > 0)
+			zbits |= stack[depth - 1].zbits;
+		range_add(ranges, &blocks[i].first, zbits);
+		stack[depth] = blocks[i];
+		stack[depth].zbits = zbits;
+		depth++;
+	}
+	isc_mem_put(summary->mctx, blocks, 2 * n * sizeof(*blocks));
+
+	*rangesp = ranges;
+	return (ISC_R_SUCCESS);
+
+ cleanup_range:
+	isc_mem_put(summary->mctx, ranges->range,
+		    ranges->alloc * sizeof(*ranges->range));
+ cleanup_ranges:
+	isc_mem_put(summary->mctx, ranges, sizeof(*ranges));
+ cleanup_blocks:
+	isc_mem_put(summary->mctx, blocks, 2 * n * sizeof(*blocks));
+	return (result);
+}
+
+/*
+ * Make a snapshot of the summary from the chunks and ranges of the last
+ * one that have not changed and new ones for those that have.
+ * The summary lock must be held.
+ */
+static isc_result_t
+snapshot_make(dns_rpz_summary_t *summary, dns_rpz_snapshot_t **snapshotp) {
+	dns_rpz_snapshot_t *snapshot = NULL, *built = summary->built;
+	summary_chunk_t *chunk;
+	unsigned int i, have;
+	int num;
+	isc_result_t result;
+
+	result = snapshot_create(summary->mctx, &snapshot);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	for (i = 0; i < SUMMARY_CHUNKS; i++) {
+		if (built != NULL && !summary->dirty[i]) {
+			chunk = built->chunks[i];
+			if (chunk != NULL) {
+				isc_refcount_increment(&chunk->references,
+						       NULL);
+				snapshot->chunks[i] = chunk;
+			}
+			continue;
+		}
+		result = chunk_make(summary, i, &snapshot->chunks[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (built != NULL && !summary->ipchanged) {
+			if (built->ranges[i] != NULL) {
+				isc_refcount_increment(
+					&built->ranges[i]->references, NULL);
+				snapshot->ranges[i] = built->ranges[i];
+			}
+			continue;
+		}
+		result = ranges_make(summary, i == 0 ? SUMMARY_IP :
+				     SUMMARY_NSIP, &snapshot->ranges[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
+
+	for (num = 0; num < DNS_RPZ_SUMMARY_ZONES; num++) {
+		for (have = 0; have < SUMMARY_HAVES; have++) {
+			if (summary->have[num][have] != 0)
+				snapshot->have[have] |= DNS_RPZ_ZBIT(num);
+		}
+		if (summary->incomplete[num] != 0)
+			snapshot->unknown |= DNS_RPZ_ZBIT(num);
+	}
+	snapshot->unknown |= summary->departed;
+
+	*snapshotp = snapshot;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	dns_rpz_snapshot_detach(&snapshot);
+	return (result);
+}
+
+/*
+ * Replace the snapshot used by queries if the summary has changed.
+ * The summary lock must be held.
+ */
+static void
+summary_publish(dns_rpz_summary_t *summary) {
+	dns_rpz_snapshot_t *snapshot = NULL, *old;
+	isc_result_t result;
+
+	if (!summary->changed)
+		return;
+
+	result = snapshot_make(summary, &snapshot);
+	if (result == ISC_R_SUCCESS) {
+		summary->changed = ISC_FALSE;
+		summary->ipchanged = ISC_FALSE;
+		memset(summary->dirty, 0, sizeof(summary->dirty));
+		if (summary->built != NULL)
+			dns_rpz_snapshot_detach(&summary->built);
+		snapshot_attach(snapshot, &summary->built);
+	} else {
+		/*
+		 * Search everything until a snapshot can be made.
+		 */
+		snapshot_attach(summary->everything, &snapshot);
+	}
+
+	old = summary->current;
+	summary->current = snapshot;
+	dns_rpz_snapshot_detach(&old);
+}
+
+/*
+ * Find the policy zones with a trigger in a snapshot.
+ */
+static dns_rpz_zbits_t
+snapshot_zbits(dns_rpz_snapshot_t *snapshot, unsigned int type,
+	       const unsigned char *key, unsigned int length)
+{
+	summary_chunk_t *chunk;
+	chunk_entry_t *entry;
+	isc_uint32_t *offsets;
+	unsigned char *keys;
+	dns_rpz_zbits_t zbits = 0;
+	isc_uint32_t hash;
+	unsigned int b, i;
+
+	hash = summary_hash(type, key, length);
+	chunk = snapshot->chunks[SUMMARY_CHUNK(hash)];
+	if (chunk == NULL)
+		return (0);
+	offsets = CHUNK_OFFSETS(chunk);
+	entry = CHUNK_ENTRIES(chunk);
+	keys = CHUNK_KEYS(chunk);
+	b = CHUNK_BUCKET(chunk, hash);
+	for (i = offsets[b]; i < offsets[b + 1]; i++) {
+		if (entry[i].hash == hash && entry[i].type == type &&
+		    entry[i].length == length &&
+		    memcmp(keys + entry[i].key, key, length) == 0)
+			zbits |= DNS_RPZ_ZBIT(entry[i].num);
+	}
+	return (zbits);
+}
+
+/*
+ * Make the key of the owner name of a QNAME or NSDNAME trigger from its
+ * labels before the last 'suffix' labels, less a leading "*" label.
+ * Return ISC_TRUE if there was a "*".
+ */
+static isc_boolean_t
+name_key(dns_name_t *name, unsigned int suffix, unsigned char *key,
+	 unsigned int *lengthp)
+{
+	dns_name_t prefix;
+	isc_region_t r;
+	unsigned int labels, first, i;
+
+	labels = dns_name_countlabels(name);
+	first = 0;
+	if (labels > suffix && dns_name_iswildcard(name))
+		first = 1;
+	dns_name_init(&prefix, NULL);
+	dns_name_getlabelsequence(name, first, labels - suffix - first,
+				  &prefix);
+	dns_name_toregion(&prefix, &r);
+	INSIST(r.length < DNS_NAME_MAXWIRE);
+	/*
+	 * Label lengths are below 'A', so only the labels are downcased.
+	 */
+	for (i = 0; i < r.length; i++)
+		key[i] = DOWNCASE(r.base[i]);
+	key[i++] = '\0';
+	*lengthp = i;
+	return (ISC_TF(first != 0));
+}
+
+static void
+ip_key(unsigned char *key, const dns_rpz_cidr_key_t *ip,
+       dns_rpz_cidr_bits_t prefix)
+{
+	dns_rpz_cidr_key_t masked;
+	int i, bits;
+
+	for (i = 0; i < DNS_RPZ_CIDR_WORDS; i++) {
+		bits = prefix - i * DNS_RPZ_CIDR_WORD_BITS;
+		if (bits >= DNS_RPZ_CIDR_WORD_BITS)
+			masked.w[i] = ip->w[i];
+		else if (bits <= 0)
+			masked.w[i] = 0;
+		else
+			masked.w[i] = ip->w[i] & DNS_RPZ_WORD_MASK(bits);
+	}
+	key[0] = prefix;
+	memmove(key + 1, &masked, sizeof(masked));
+}
+
+/*
+ * Add or remove a trigger of the policy zone of a radix tree
+ * in the summary of its view.  A tree that cannot add a trigger
+ * must report all of them again before its zone can be skipped.
+ */
+static isc_result_t
+summary_update(dns_rpz_cidr_t *cidr, unsigned int type,
+	       const unsigned char *key, unsigned int length,
+	       isc_boolean_t add)
+{
+	dns_rpz_summary_t *summary = cidr->summary;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (summary == NULL) {
+		if (add)
+			cidr->incomplete = ISC_TRUE;
+		return (ISC_R_SUCCESS);
+	}
+
+	LOCK(&summary->lock);
+	if (add) {
+		result = summary_add(summary, cidr, cidr->num, type,
+				     key, length);
+		if (result != ISC_R_SUCCESS)
+			summary_incomplete(cidr, ISC_TRUE);
+	} else {
+		summary_remove(summary, cidr, type, key, length);
+	}
+	UNLOCK(&summary->lock);
+	return (result);
+}
+
+static isc_result_t
+summary_name(dns_rpz_cidr_t *cidr, dns_name_t *name, dns_rpz_type_t type,
+	     isc_boolean_t add)
+{
+	unsigned char key[DNS_NAME_MAXWIRE];
+	unsigned int length, stype, suffix;
+
+	if (type == DNS_RPZ_TYPE_NSDNAME) {
+		stype = SUMMARY_NSDNAME;
+		suffix = dns_name_countlabels(&cidr->nsdname_name);
+	} else {
+		stype = SUMMARY_QNAME;
+		suffix = cidr->origin_labels;
+	}
+	if (dns_name_countlabels(name) < suffix)
+		return (ISC_R_SUCCESS);
+	if (name_key(name, suffix, key, &length))
+		stype++;
+	return (summary_update(cidr, stype, key, length, add));
+}
+
+static isc_result_t
+summary_ip(dns_rpz_cidr_t *cidr, const dns_rpz_cidr_key_t *ip,
+	   dns_rpz_cidr_bits_t prefix, dns_rpz_type_t type,
+	   isc_boolean_t add)
+{
+	unsigned char key[1 + sizeof(dns_rpz_cidr_key_t)];
+
+	ip_key(key, ip, prefix);
+	return (summary_update(cidr, type == DNS_RPZ_TYPE_NSIP ?
+			       SUMMARY_NSIP : SUMMARY_IP, key, sizeof(key),
+			       add));
+}
+
+isc_result_t
+dns_rpz_summary_create(isc_mem_t *mctx, dns_rpz_summary_t **summaryp) {
+	dns_rpz_summary_t *summary;
+	isc_result_t result;
+
+	REQUIRE(summaryp != NULL && *summaryp == NULL);
+
+	summary = isc_mem_get(mctx, sizeof(*summary));
+	if (summary == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(summary, 0, sizeof(*summary));
+
+	result = isc_refcount_init(&summary->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_summary;
+	result = isc_mutex_init(&summary->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_refcount;
+	result = table_init(mctx, &summary->names);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+	result = table_init(mctx, &summary->ips);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_names;
+
+	/*
+	 * Queries search every policy zone until the first snapshot.
+	 */
+	result = snapshot_create(mctx, &summary->everything);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_ips;
+	summary->everything->unknown = DNS_RPZ_ALL_ZBITS;
+	snapshot_attach(summary->everything, &summary->current);
+	summary->changed = ISC_TRUE;
+	summary->ipchanged = ISC_TRUE;
+	memset(summary->dirty, 1, sizeof(summary->dirty));
+
+	isc_mem_attach(mctx, &summary->mctx);
+	summary->magic = RPZ_SUMMARY_MAGIC;
+	*summaryp = summary;
+	return (ISC_R_SUCCESS);
+
+ cleanup_ips:
+	isc_mem_put(mctx, summary->ips.buckets,
+		    summary->ips.size * sizeof(*summary->ips.buckets));
+ cleanup_names:
+	isc_mem_put(mctx, summary->names.buckets,
+		    summary->names.size * sizeof(*summary->names.buckets));
+ cleanup_lock:
+	DESTROYLOCK(&summary->lock);
+ cleanup_refcount:
+	isc_refcount_destroy(&summary->references);
+ cleanup_summary:
+	isc_mem_put(mctx, summary, sizeof(*summary));
+	return (result);
+}
+
+void
+dns_rpz_summary_attach(dns_rpz_summary_t *source, dns_rpz_summary_t **target)
+{
+	REQUIRE(VALID_SUMMARY(source));
+	REQUIRE(target != NULL && *target == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*target = source;
+}
+
+void
+dns_rpz_summary_detach(dns_rpz_summary_t **summaryp) {
+	dns_rpz_summary_t *summary;
+	unsigned int refs;
+
+	REQUIRE(summaryp != NULL && VALID_SUMMARY(*summaryp));
+	summary = *summaryp;
+	*summaryp = NULL;
+
+	isc_refcount_decrement(&summary->references, &refs);
+	if (refs != 0)
+		return;
+
+	summary_forget(summary, &summary->names, NULL);
+	summary_forget(summary, &summary->ips, NULL);
+	isc_mem_put(summary->mctx, summary->names.buckets,
+		    summary->names.size * sizeof(*summary->names.buckets));
+	isc_mem_put(summary->mctx, summary->ips.buckets,
+		    summary->ips.size * sizeof(*summary->ips.buckets));
+	if (summary->built != NULL)
+		dns_rpz_snapshot_detach(&summary->built);
+	dns_rpz_snapshot_detach(&summary->current);
+	dns_rpz_snapshot_detach(&summary->everything);
+	if (summary->updatehisto != NULL)
+		isc_histo_detach(&summary->updatehisto);
+	DESTROYLOCK(&summary->lock);
+	isc_refcount_destroy(&summary->references);
+	summary->magic = 0;
+	isc_mem_putanddetach(&summary->mctx, summary, sizeof(*summary));
+}
+
+void
+dns_rpz_summary_setupdatehisto(dns_rpz_summary_t *summary,
+			       isc_histo_t *histo)
+{
+	REQUIRE(VALID_SUMMARY(summary));
+	REQUIRE(summary->updatehisto == NULL);
+
+	isc_histo_attach(histo, &summary->updatehisto);
+}
+
+isc_histo_t *
+dns_rpz_summary_getupdatehisto(dns_rpz_summary_t *summary) {
+	REQUIRE(VALID_SUMMARY(summary));
+
+	return (summary->updatehisto);
+}
+
+void
+dns_rpz_summary_current(dns_rpz_summary_t *summary,
+			dns_rpz_snapshot_t **snapshotp)
+{
+	REQUIRE(snapshotp != NULL);
+
+	/*
+	 * A snapshot held by the caller that is still the current one
+	 * cannot go away, so checking it needs no lock.
+	 */
+	if (summary != NULL && *snapshotp != NULL &&
+	    *snapshotp == summary->current)
+		return;
+
+	if (*snapshotp != NULL)
+		dns_rpz_snapshot_detach(snapshotp);
+	if (summary == NULL)
+		return;
+
+	REQUIRE(VALID_SUMMARY(summary));
+
+	LOCK(&summary->lock);
+	snapshot_attach(summary->current, snapshotp);
+	UNLOCK(&summary->lock);
+}
+
+/*
+ * Point a radix tree at the summary of its view.
+ * The tree write lock of its database must be held by the caller.
+ */
+void
+dns_rpz_cidr_setsummary(dns_rpz_cidr_t *cidr, dns_rpz_summary_t *summary,
+			int num)
+{
+	dns_rpz_summary_t *old;
+	summary_table_t *table;
+	summary_entry_t *e;
+	isc_boolean_t incomplete;
+	unsigned int i, t;
+
+	REQUIRE(cidr != NULL);
+	REQUIRE(summary == NULL || VALID_SUMMARY(summary));
+
+	/*
+	 * Later policy zones are always searched.
+	 */
+	if (num >= DNS_RPZ_SUMMARY_ZONES)
+		summary = NULL;
+
+	old = cidr->summary;
+	if (old != NULL && old == summary) {
+		LOCK(&summary->lock);
+		if (cidr->num != num) {
+			incomplete = cidr->incomplete;
+			summary_incomplete(cidr, ISC_FALSE);
+			for (t = 0; t < 2; t++) {
+				table = t == 0 ? &summary->names :
+						 &summary->ips;
+				for (i = 0; i < table->size; i++) {
+					for (e = table->buckets[i];
+					     e != NULL;
+					     e = e->next) {
+						if (e->owner != cidr)
+							continue;
+						summary_count(summary, e, -1);
+						e->num = num;
+						summary_count(summary, e, 1);
+					}
+				}
+			}
+			cidr->num = num;
+			summary_incomplete(cidr, incomplete);
+		}
+		summary_publish(summary);
+		UNLOCK(&summary->lock);
+		return;
+	}
+
+	/*
+	 * The triggers reported to the old summary, if all of them were,
+	 * are all that the new one needs.  Only reconfiguration moves a
+	 * tree, and only to a new summary, so the locks of two summaries
+	 * are never taken in the other order.
+	 */
+	incomplete = cidr->incomplete;
+	if (old != NULL) {
+		LOCK(&old->lock);
+		if (summary != NULL) {
+			LOCK(&summary->lock);
+			for (t = 0; t < 2; t++) {
+				table = t == 0 ? &old->names : &old->ips;
+				for (i = 0; i < table->size; i++) {
+					for (e = table->buckets[i];
+					     e != NULL;
+					     e = e->next) {
+						if (e->owner == cidr &&
+						    summary_add(summary, cidr,
+							num, e->type,
+							ENTRY_KEY(e),
+							e->length) !=
+						    ISC_R_SUCCESS)
+							incomplete = ISC_TRUE;
+					}
+				}
+			}
+			UNLOCK(&summary->lock);
+		}
+
+		/*
+		 * The old summary would miss our future changes,
+		 * so its view must always search this policy zone.
+		 */
+		summary_forget(old, &old->names, cidr);
+		summary_forget(old, &old->ips, cidr);
+		summary_incomplete(cidr, ISC_FALSE);
+		old->departed |= DNS_RPZ_ZBIT(cidr->num);
+		old->changed = ISC_TRUE;
+		summary_publish(old);
+		UNLOCK(&old->lock);
+		dns_rpz_summary_detach(&cidr->summary);
+		if (summary == NULL)
+			incomplete = ISC_TRUE;
+	}
+
+	cidr->num = num;
+	cidr->incomplete = ISC_FALSE;
+	if (summary != NULL) {
+		dns_rpz_summary_attach(summary, &cidr->summary);
+		LOCK(&summary->lock);
+		summary_incomplete(cidr, incomplete);
+		summary_publish(summary);
+		UNLOCK(&summary->lock);
+	} else {
+		cidr->incomplete = incomplete;
+	}
+}
+
+/*
+ * Does the summary lack some triggers of the tree?
+ * The tree write lock of its database must be held by the caller.
+ */
+isc_boolean_t
+dns_rpz_cidr_incomplete(dns_rpz_cidr_t *cidr) {
+	REQUIRE(cidr != NULL);
+
+	return (ISC_TF(cidr->summary != NULL && cidr->incomplete));
+}
+
+/*
+ * The tree has reported all of its triggers again.
+ * The tree write lock of its database must be held by the caller.
+ */
+void
+dns_rpz_cidr_summarized(dns_rpz_cidr_t *cidr) {
+	REQUIRE(cidr != NULL);
+
+	if (cidr->summary == NULL)
+		return;
+	LOCK(&cidr->summary->lock);
+	summary_incomplete(cidr, ISC_FALSE);
+	summary_publish(cidr->summary);
+	UNLOCK(&cidr->summary->lock);
+}
+
+/*
+ * Let queries use the triggers the tree has reported so far.
+ */
+void
+dns_rpz_cidr_publish(dns_rpz_cidr_t *cidr) {
+	REQUIRE(cidr != NULL);
+
+	if (cidr->summary == NULL)
+		return;
+	LOCK(&cidr->summary->lock);
+	summary_publish(cidr->summary);
+	UNLOCK(&cidr->summary->lock);
+}
+
+dns_rpz_zbits_t
+dns_rpz_snapshot_names(dns_rpz_snapshot_t *snapshot, dns_rpz_type_t type,
+		       dns_name_t *name)
+{
+	unsigned char key[DNS_NAME_MAXWIRE];
+	isc_region_t r;
+	dns_rpz_zbits_t zbits;
+	unsigned int i, stype;
+
+	if (snapshot == NULL)
+		return (DNS_RPZ_ALL_ZBITS);
+
+	REQUIRE(VALID_SNAPSHOT(snapshot));
+	REQUIRE(type == DNS_RPZ_TYPE_QNAME || type == DNS_RPZ_TYPE_NSDNAME);
+	REQUIRE(dns_name_isabsolute(name));
+
+	dns_name_toregion(name, &r);
+	INSIST(r.length > 0);
+	for (i = 0; i < r.length; i++)
+		key[i] = DOWNCASE(r.base[i]);
+	stype = (type == DNS_RPZ_TYPE_QNAME) ? SUMMARY_QNAME : SUMMARY_NSDNAME;
+
+	zbits = snapshot->unknown;
+	zbits |= snapshot_zbits(snapshot, stype, key, r.length);
+	/*
+	 * Wildcards match the names below their parents.
+	 */
+	for (i = key[0] + 1; i < r.length; i += key[i] + 1)
+		zbits |= snapshot_zbits(snapshot, stype + 1,
+					&key[i], r.length - i);
+	return (zbits);
+}
+
+dns_rpz_zbits_t
+dns_rpz_snapshot_ip(dns_rpz_snapshot_t *snapshot, dns_rpz_type_t type,
+		    const isc_netaddr_t *netaddr)
+{
+	summary_ranges_t *ranges;
+	dns_rpz_cidr_key_t ip;
+	unsigned int lo, hi, mid;
+
+	if (snapshot == NULL)
+		return (DNS_RPZ_ALL_ZBITS);
+
+	REQUIRE(VALID_SNAPSHOT(snapshot));
+	REQUIRE(type == DNS_RPZ_TYPE_IP || type == DNS_RPZ_TYPE_NSIP);
+
+	if (!netaddr2key(netaddr, &ip))
+		return (0);
+
+	ranges = snapshot->ranges[type == DNS_RPZ_TYPE_NSIP];
+	if (ranges == NULL)
+		return (snapshot->unknown);
+
+	/*
+	 * Find the last range starting at or before the address.
+	 */
+	lo = 0;
+	hi = ranges->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (key_cmp(&ranges->range[mid].start, &ip) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return (snapshot->unknown);
+	return (snapshot->unknown | ranges->range[lo - 1].zbits);
+}
+
+void
+dns_rpz_snapshot_enabled(dns_rpz_snapshot_t *snapshot, dns_rpz_zbits_t zbits,
+			 dns_rpz_st_t *st)
+{
+	if (snapshot == NULL || zbits == 0)
+		return;
+
+	REQUIRE(VALID_SNAPSHOT(snapshot));
+
+	if ((zbits & snapshot->have[SUMMARY_HAVE_IP]) != 0)
+		st->state |= DNS_RPZ_HAVE_IP;
+	if ((zbits & snapshot->have[SUMMARY_HAVE_NSIPv4]) != 0)
+		st->state |= DNS_RPZ_HAVE_NSIPv4;
+	if ((zbits & snapshot->have[SUMMARY_HAVE_NSIPv6]) != 0)
+		st->state |= DNS_RPZ_HAVE_NSIPv6;
+	if ((zbits & snapshot->have[SUMMARY_HAVE_NSDNAME]) != 0)
+		st->state |= DNS_RPZ_HAVE_NSDNAME;
+}
+
 /*
  * Free the radix tree of a response policy database.
  */
@@ -234,6 +1638,16 @@ dns_rpz_cidr_free(dns_rpz_cidr_t **cidrp) {
 		cur = parent;
 	}
 
+	if (cidr->summary != NULL) {
+		LOCK(&cidr->summary->lock);
+		summary_forget(cidr->summary, &cidr->summary->names, cidr);
+		summary_forget(cidr->summary, &cidr->summary->ips, cidr);
+		summary_incomplete(cidr, ISC_FALSE);
+		summary_publish(cidr->summary);
+		UNLOCK(&cidr->summary->lock);
+		dns_rpz_summary_detach(&cidr->summary);
+	}
+
 	dns_name_free(&cidr->ip_name, cidr->mctx);
 	dns_name_free(&cidr->nsip_name, cidr->mctx);
 	dns_name_free(&cidr->nsdname_name, cidr->mctx);
@@ -242,7 +1656,7 @@ dns_rpz_cidr_free(dns_rpz_cidr_t **cidrp) {
 }
 
 /*
- * Forget a view's list of policy zones.
+ * Forget a view's list of policy zones and their summary.
  */
 void
 dns_rpz_view_destroy(dns_view_t *view) {
@@ -250,6 +1664,9 @@ dns_rpz_view_destroy(dns_view_t *view) {
 
 	REQUIRE(view != NULL);
 
+	if (view->rpz_summary != NULL)
+		dns_rpz_summary_detach(&view->rpz_summary);
+
 	while (!ISC_LIST_EMPTY(view->rpz_zones)) {
 		zone = ISC_LIST_HEAD(view->rpz_zones);
 		ISC_LIST_UNLINK(view->rpz_zones, zone, link);
@@ -282,6 +1699,7 @@ dns_rpz_new_cidr(isc_mem_t *mctx, dns_name_t *origin,
 		return (ISC_R_NOMEMORY);
 	memset(cidr, 0, sizeof(*cidr));
 	cidr->mctx = mctx;
+	cidr->origin_labels = dns_name_countlabels(origin);
 
 	dns_name_init(&cidr->ip_name, NULL);
 	result = dns_name_fromstring2(&cidr->ip_name, DNS_RPZ_IP_ZONE, origin,
@@ -940,6 +2358,11 @@ dns_rpz_cidr_addip(dns_rpz_cidr_t *cidr, dns_name_t *name) {
 
 	REQUIRE(cidr != NULL);
 
+	/*
+	 * Any name can be found as a QNAME trigger.
+	 */
+	(void)summary_name(cidr, name, DNS_RPZ_TYPE_QNAME, ISC_TRUE);
+
 	/*
 	 * No worries if the new name is not an IP address.
 	 */
@@ -950,6 +2373,8 @@ dns_rpz_cidr_addip(dns_rpz_cidr_t *cidr, dns_name_t *name) {
 		break;
 	case DNS_RPZ_TYPE_NSDNAME:
 		cidr->have_nsdname = ISC_TRUE;
+		(void)summary_name(cidr, name, DNS_RPZ_TYPE_NSDNAME,
+				   ISC_TRUE);
 		return;
 	case DNS_RPZ_TYPE_QNAME:
 	case DNS_RPZ_TYPE_BAD:
@@ -961,6 +2386,8 @@ dns_rpz_cidr_addip(dns_rpz_cidr_t *cidr, dns_name_t *name) {
 		return;
 
 	result = search(cidr, &tgt_ip, tgt_prefix, type, ISC_TRUE, NULL);
+	if (result == ISC_R_SUCCESS)
+		(void)summary_ip(cidr, &tgt_ip, tgt_prefix, type, ISC_TRUE);
 	if (result == ISC_R_EXISTS &&
 	    isc_log_wouldlog(dns_lctx, DNS_RPZ_ERROR_LEVEL))
 	{
@@ -993,6 +2420,8 @@ dns_rpz_cidr_deleteip(dns_rpz_cidr_t *cidr, dns_name_t *name) {
 	if (cidr == NULL)
 		return;
 
+	(void)summary_name(cidr, name, DNS_RPZ_TYPE_QNAME, ISC_FALSE);
+
 	/*
 	 * Decide which kind of policy zone IP address it is, if either
 	 * and then find its node.
@@ -1006,7 +2435,10 @@ dns_rpz_cidr_deleteip(dns_rpz_cidr_t *cidr, dns_name_t *name) {
 		/*
 		 * We cannot easily count nsdnames because
 		 * internal rbt nodes get deleted.
+		 * The summary counts only the names that were added.
 		 */
+		(void)summary_name(cidr, name, DNS_RPZ_TYPE_NSDNAME,
+				   ISC_FALSE);
 		return;
 	case DNS_RPZ_TYPE_QNAME:
 	case DNS_RPZ_TYPE_BAD:
@@ -1021,6 +2453,8 @@ dns_rpz_cidr_deleteip(dns_rpz_cidr_t *cidr, dns_name_t *name) {
 	if (result != ISC_R_SUCCESS)
 		return;
 
+	(void)summary_ip(cidr, &tgt_ip, tgt_prefix, type, ISC_FALSE);
+
 	result = search(cidr, &tgt_ip, tgt_prefix, type, ISC_FALSE, &tgt);
 	if (result != ISC_R_SUCCESS) {
 		badname(DNS_RPZ_ERROR_LEVEL, name, "; missing rpz node", "");
@@ -1083,6 +2517,62 @@ dns_rpz_cidr_deleteip(dns_rpz_cidr_t *cidr, dns_name_t *name) {
 	} while (tgt != NULL);
 }
 
+/*
+ * Report the triggers of a name again to the summary of the view.
+ *	The tree write lock must be held by the caller.
+ */
+isc_result_t
+dns_rpz_cidr_summarize(dns_rpz_cidr_t *cidr, dns_name_t *name) {
+	isc_result_t result;
+	dns_rpz_cidr_key_t tgt_ip;
+	dns_rpz_cidr_bits_t tgt_prefix;
+	dns_rpz_type_t type;
+
+	REQUIRE(cidr != NULL);
+
+	result = summary_name(cidr, name, DNS_RPZ_TYPE_QNAME, ISC_TRUE);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	type = set_type(cidr, name);
+	switch (type) {
+	case DNS_RPZ_TYPE_IP:
+	case DNS_RPZ_TYPE_NSIP:
+		break;
+	case DNS_RPZ_TYPE_NSDNAME:
+		return (summary_name(cidr, name, DNS_RPZ_TYPE_NSDNAME,
+				     ISC_TRUE));
+	case DNS_RPZ_TYPE_QNAME:
+	case DNS_RPZ_TYPE_BAD:
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Bad IP names were logged when they were added.
+	 */
+	result = name2ipkey(cidr, DNS_RPZ_DEBUG_QUIET, name,
+			    type, &tgt_ip, &tgt_prefix);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+	return (summary_ip(cidr, &tgt_ip, tgt_prefix, type, ISC_TRUE));
+}
+
+/*
+ * Account for an update applied to a response policy database
+ * and let queries use its triggers.
+ *	The tree write lock must be held by the caller.
+ */
+void
+dns_rpz_cidr_updated(dns_rpz_cidr_t *cidr, isc_uint64_t usecs) {
+	REQUIRE(cidr != NULL);
+
+	if (cidr->summary == NULL)
+		return;
+	if (cidr->summary->updatehisto != NULL)
+		isc_histo_add(cidr->summary->updatehisto, usecs);
+	dns_rpz_cidr_publish(cidr);
+}
+
 /*
  * Caller must hold tree lock.
  * Return  ISC_R_NOTFOUND
@@ -1097,31 +2587,9 @@ dns_rpz_cidr_find(dns_rpz_cidr_t *cidr, const isc_netaddr_t *netaddr,
 	dns_rpz_cidr_key_t tgt_ip;
 	isc_result_t result;
 	dns_rpz_cidr_node_t *found;
-	int i;
 
-	/*
-	 * Convert IP address to CIDR tree key.
-	 */
-	if (netaddr->family == AF_INET) {
-		tgt_ip.w[0] = 0;
-		tgt_ip.w[1] = 0;
-		tgt_ip.w[2] = ADDR_V4MAPPED;
-		tgt_ip.w[3] = ntohl(netaddr->type.in.s_addr);
-	} else if (netaddr->family == AF_INET6) {
-		dns_rpz_cidr_key_t src_ip6;
-
-		/*
-		 * Given the int aligned struct in_addr member of netaddr->type
-		 * one could cast netaddr->type.in6 to dns_rpz_cidr_key_t *,
-		 * but there are objections.
-		 */
-		memmove(src_ip6.w, &netaddr->type.in6, sizeof(src_ip6.w));
-		for (i = 0; i < 4; i++) {
-			tgt_ip.w[i] = ntohl(src_ip6.w[i]);
-		}
-	} else {
+	if (!netaddr2key(netaddr, &tgt_ip))
 		return (ISC_R_NOTFOUND);
-	}
 
 	result = search(cidr, &tgt_ip, 128, type, ISC_FALSE, &found);
 	if (result != ISC_R_SUCCESS && result != DNS_R_PARTIALMATCH)
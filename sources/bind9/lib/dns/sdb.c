@@ -1298,7 +1298,9 @@ static dns_dbmethods_t sdb_methods = {
 	NULL,			/* rpz_enabled */
 	NULL,			/* rpz_findips */
 	findnodeext,
-	findext
+	findext,
+	NULL,			/* rpz_setsummary */
+	NULL			/* setslabstore */
 };
 
 static isc_result_t
@@ -58,6 +58,7 @@
 #include <string.h>
 
 #include <isc/buffer.h>
+#include <isc/condition.h>
 #include <isc/lex.h>
 #include <isc/log.h>
 #include <isc/rwlock.h>
@@ -67,7 +68,10 @@
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/print.h>
+#include <isc/refcount.h>
 #include <isc/region.h>
+#include <isc/stdtime.h>
+#include <isc/thread.h>
 
 #include <dns/callbacks.h>
 #include <dns/db.h>
@@ -100,11 +104,31 @@ struct dns_sdlzimplementation {
 	dns_dlzimplementation_t		*dlz_imp;
 };
 
+typedef struct sdlz_cache sdlz_cache_t;
+typedef struct sdlz_entry sdlz_entry_t;
+typedef struct sdlz_job sdlz_job_t;
+
+/*%
+ * What dns_sdlzcreate() hands back to the DLZ layer as 'dbdata': the
+ * driver's own data plus the optional result cache.  Databases made by
+ * findzone hold a reference so the cache outlives any that are still
+ * in use when the instance is destroyed.
+ */
+typedef struct sdlz_instance {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	dns_sdlzimplementation_t	*imp;
+	void				*dbdata;
+	isc_refcount_t			references;
+	sdlz_cache_t			*cache;
+} sdlz_instance_t;
+
 struct dns_sdlz_db {
 	/* Unlocked */
 	dns_db_t			common;
 	void				*dbdata;
 	dns_sdlzimplementation_t	*dlzimp;
+	sdlz_instance_t			*instance;
 	isc_mutex_t			refcnt_lock;
 	/* Locked */
 	unsigned int			references;
@@ -142,6 +166,82 @@ typedef struct sdlz_rdatasetiter {
 	dns_rdatalist_t			*current;
 } sdlz_rdatasetiter_t;
 
+/*%
+ * The result cache.  Each entry holds the answer to one driver lookup,
+ * that is every RRset of one name, in wire form: for each RRset the
+ * type (2 octets), TTL (4) and count (2), then for each rdata its
+ * length (2) and data.  A negative entry records that the driver found
+ * nothing.  Entries are spread over stripes by name hash so lookups on
+ * different names rarely contend; each stripe evicts its least
+ * recently used entries beyond its share of the size limit.
+ *
+ * Rdataslabs are not used: a slab holds a single RRset and sorts and
+ * deduplicates its rdata, whereas a driver lookup yields every RRset
+ * of the name in the driver's order, and SDLZ nodes and rdatasets are
+ * built on rdatalists.  Keeping the records exactly as the node held
+ * them lets a hit rebuild the whole node with one copy and one pass,
+ * and answer as the driver would have.
+ */
+struct sdlz_entry {
+	sdlz_entry_t			*next;		/* hash chain */
+	ISC_LINK(sdlz_entry_t)		link;		/* LRU */
+	unsigned int			hashval;
+	isc_stdtime_t			stored;
+	dns_ttl_t			ttl;
+	isc_boolean_t			negative;
+	isc_boolean_t			refreshing;
+	unsigned int			size;
+	unsigned int			namelen;
+	unsigned int			zonelen;
+	unsigned int			datalen;
+	/* Name, zone and data follow. */
+};
+
+#define SDLZ_CACHE_STRIPES	16
+#define SDLZ_CACHE_BUCKETS	1024	/* per stripe */
+#define SDLZ_CACHE_MAXJOBS	1024
+
+typedef struct sdlz_stripe {
+	isc_mutex_t			lock;
+	sdlz_entry_t			*table[SDLZ_CACHE_BUCKETS];
+	ISC_LIST(sdlz_entry_t)		lru;
+	size_t				bytes;
+	unsigned int			generation;	/* bumped by flushes */
+} sdlz_stripe_t;
+
+/*%
+ * Entries in the last quarter of their life are looked up again by
+ * the refresh threads, so that busy names are renewed before they
+ * expire and only cold misses wait for the driver.
+ */
+struct sdlz_job {
+	ISC_LINK(sdlz_job_t)		link;
+	dns_fixedname_t			zone;
+	dns_fixedname_t			name;
+	dns_rdataclass_t		rdclass;
+	unsigned int			generation;
+};
+
+struct sdlz_cache {
+	isc_mem_t			*mctx;
+	sdlz_instance_t			*instance;	/* not counted */
+	dns_ttl_t			maxttl;
+	dns_ttl_t			maxncachettl;
+	size_t				maxsize;	/* per stripe */
+	sdlz_stripe_t			stripes[SDLZ_CACHE_STRIPES];
+	/* Refresh threads. */
+	unsigned int			nthreads;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t			*threads;
+	isc_mutex_t			qlock;
+	isc_condition_t			qcond;
+	/* Locked by qlock. */
+	ISC_LIST(sdlz_job_t)		jobs;
+	unsigned int			njobs;
+	isc_boolean_t			shuttingdown;
+#endif
+};
+
 
 #define SDLZDB_MAGIC		ISC_MAGIC('D', 'L', 'Z', 'S')
 
@@ -153,6 +253,9 @@ typedef struct sdlz_rdatasetiter {
 #define VALID_SDLZDB(sdlzdb)	((sdlzdb) != NULL && \
 				 (sdlzdb)->common.impmagic == SDLZDB_MAGIC)
 
+#define SDLZINST_MAGIC		ISC_MAGIC('D','L','Z','I')
+#define VALID_SDLZINST(inst)	ISC_MAGIC_VALID(inst, SDLZINST_MAGIC)
+
 #define SDLZLOOKUP_MAGIC	ISC_MAGIC('D','L','Z','L')
 #define VALID_SDLZLOOKUP(sdlzl)	ISC_MAGIC_VALID(sdlzl, SDLZLOOKUP_MAGIC)
 #define VALID_SDLZNODE(sdlzn)	VALID_SDLZLOOKUP(sdlzn)
@@ -195,6 +298,14 @@ static void list_tordataset(dns_rdatalist_t *rdatalist,
 
 static void detachnode(dns_db_t *db, dns_dbnode_t **targetp);
 
+static isc_result_t dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg,
+				      void *dbdata, dns_name_t *name,
+				      dns_rdataclass_t rdclass,
+				      dns_db_t **dbp);
+static void instance_detach(sdlz_instance_t **instp);
+static void cache_flush(sdlz_cache_t *cache, dns_name_t *name);
+static void cache_flushzone(sdlz_cache_t *cache, dns_name_t *zone);
+
 static void		dbiterator_destroy(dns_dbiterator_t **iteratorp);
 static isc_result_t	dbiterator_first(dns_dbiterator_t *iterator);
 static isc_result_t	dbiterator_last(dns_dbiterator_t *iterator);
@@ -339,6 +450,7 @@ destroy(dns_sdlz_db_t *sdlz) {
 	(void)isc_mutex_destroy(&sdlz->refcnt_lock);
 
 	dns_name_free(&sdlz->common.origin, mctx);
+	instance_detach(&sdlz->instance);
 
 	isc_mem_put(mctx, sdlz, sizeof(dns_sdlz_db_t));
 	isc_mem_detach(&mctx);
@@ -462,6 +574,8 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 	if (*versionp != NULL)
 		sdlz_log(ISC_LOG_ERROR,
 			"sdlz closeversion on origin %s failed", origin);
+	else if (commit && sdlz->instance->cache != NULL)
+		cache_flushzone(sdlz->instance->cache, &sdlz->common.origin);
 
 	sdlz->future_version = NULL;
 }
@@ -537,12 +651,14 @@ destroynode(dns_sdlznode_t *node) {
 	detach(&db);
 }
 
+/*
+ * Ask the driver about 'name'.
+ */
 static isc_result_t
-findnodeext(dns_db_t *db, dns_name_t *name, isc_boolean_t create,
-	    dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
-	    dns_dbnode_t **nodep)
+lookupnode(dns_sdlz_db_t *sdlz, dns_name_t *name, isc_boolean_t create,
+	   dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
+	   dns_sdlznode_t **nodep)
 {
-	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
 	dns_sdlznode_t *node = NULL;
 	isc_result_t result;
 	isc_buffer_t b;
@@ -552,9 +668,6 @@ findnodeext(dns_db_t *db, dns_name_t *name, isc_boolean_t create,
 	isc_boolean_t isorigin;
 	dns_sdlzauthorityfunc_t authority;
 
-	REQUIRE(VALID_SDLZDB(sdlz));
-	REQUIRE(nodep != NULL && *nodep == NULL);
-
 	if (sdlz->dlzimp->methods->newversion == NULL) {
 		REQUIRE(create == ISC_FALSE);
 	}
@@ -565,7 +678,7 @@ findnodeext(dns_db_t *db, dns_name_t *name, isc_boolean_t create,
 		unsigned int labels;
 
 		labels = dns_name_countlabels(name) -
-			 dns_name_countlabels(&db->origin);
+			 dns_name_countlabels(&sdlz->common.origin);
 		dns_name_init(&relname, NULL);
 		dns_name_getlabelsequence(name, 0, labels, &relname);
 		result = dns_name_totext(&relname, ISC_TRUE, &b);
@@ -653,6 +766,677 @@ findnodeext(dns_db_t *db, dns_name_t *name, isc_boolean_t create,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Result cache.
+ */
+
+#define SDLZ_BUCKET(h)	(((h) / SDLZ_CACHE_STRIPES) % SDLZ_CACHE_BUCKETS)
+
+#define ENTRY_NAME(e)	((unsigned char *)((e) + 1))
+#define ENTRY_ZONE(e)	(ENTRY_NAME(e) + (e)->namelen)
+#define ENTRY_DATA(e)	(ENTRY_ZONE(e) + (e)->zonelen)
+
+static inline sdlz_stripe_t *
+cache_stripe(sdlz_cache_t *cache, unsigned int hashval) {
+	return (&cache->stripes[hashval % SDLZ_CACHE_STRIPES]);
+}
+
+/*%
+ * Entries are keyed on the lower cased wire forms of the owner name
+ * and the zone.
+ */
+static void
+cache_key(dns_name_t *name, dns_fixedname_t *fixed, isc_region_t *r) {
+	dns_name_t *lower;
+
+	dns_fixedname_init(fixed);
+	lower = dns_fixedname_name(fixed);
+	RUNTIME_CHECK(dns_name_downcase(name, lower, NULL) == ISC_R_SUCCESS);
+	dns_name_toregion(lower, r);
+}
+
+static sdlz_entry_t **
+entry_find(sdlz_stripe_t *stripe, unsigned int hashval, isc_region_t *name,
+	   isc_region_t *zone)
+{
+	sdlz_entry_t **ep, *entry;
+
+	for (ep = &stripe->table[SDLZ_BUCKET(hashval)];
+	     *ep != NULL;
+	     ep = &(*ep)->next)
+	{
+		entry = *ep;
+		if (entry->hashval == hashval &&
+		    entry->namelen == name->length &&
+		    (zone == NULL || entry->zonelen == zone->length) &&
+		    memcmp(ENTRY_NAME(entry), name->base, name->length) == 0 &&
+		    (zone == NULL ||
+		     memcmp(ENTRY_ZONE(entry), zone->base, zone->length) == 0))
+			break;
+	}
+	return (ep);
+}
+
+static void
+entry_free(sdlz_cache_t *cache, sdlz_stripe_t *stripe, sdlz_entry_t **ep) {
+	sdlz_entry_t *entry = *ep;
+
+	*ep = entry->next;
+	ISC_LIST_UNLINK(stripe->lru, entry, link);
+	stripe->bytes -= entry->size;
+	isc_mem_put(cache->mctx, entry, entry->size);
+}
+
+static isc_boolean_t
+cache_enqueue(sdlz_cache_t *cache, dns_sdlz_db_t *sdlz, dns_name_t *name,
+	      unsigned int generation)
+{
+#ifdef ISC_PLATFORM_USETHREADS
+	sdlz_job_t *job;
+	isc_boolean_t queued = ISC_FALSE;
+
+	job = isc_mem_get(cache->mctx, sizeof(*job));
+	if (job == NULL)
+		return (ISC_FALSE);
+	ISC_LINK_INIT(job, link);
+	dns_fixedname_init(&job->zone);
+	dns_fixedname_init(&job->name);
+	RUNTIME_CHECK(dns_name_copy(&sdlz->common.origin,
+				    dns_fixedname_name(&job->zone),
+				    NULL) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(dns_name_copy(name, dns_fixedname_name(&job->name),
+				    NULL) == ISC_R_SUCCESS);
+	job->rdclass = sdlz->common.rdclass;
+	job->generation = generation;
+
+	LOCK(&cache->qlock);
+	if (!cache->shuttingdown && cache->njobs < SDLZ_CACHE_MAXJOBS) {
+		ISC_LIST_APPEND(cache->jobs, job, link);
+		cache->njobs++;
+		SIGNAL(&cache->qcond);
+		queued = ISC_TRUE;
+	}
+	UNLOCK(&cache->qlock);
+
+	if (!queued)
+		isc_mem_put(cache->mctx, job, sizeof(*job));
+	return (queued);
+#else
+	UNUSED(cache);
+	UNUSED(sdlz);
+	UNUSED(name);
+	UNUSED(generation);
+	return (ISC_FALSE);
+#endif
+}
+
+/*%
+ * Build a node from the wire form records in 'b', which the node takes
+ * over, capping each TTL at 'ttl'.
+ */
+static isc_result_t
+node_fromwire(dns_sdlz_db_t *sdlz, dns_name_t *name, isc_buffer_t *b,
+	      dns_ttl_t ttl, dns_sdlznode_t **nodep)
+{
+	isc_mem_t *mctx = sdlz->common.mctx;
+	dns_sdlznode_t *node = NULL;
+	dns_rdatalist_t *list;
+	dns_rdata_t *rdata;
+	isc_region_t r;
+	unsigned int count;
+	isc_result_t result;
+
+	result = createnode(sdlz, &node);
+	if (result != ISC_R_SUCCESS) {
+		isc_buffer_free(&b);
+		return (result);
+	}
+	ISC_LIST_APPEND(node->buffers, b, link);
+
+	node->name = isc_mem_get(mctx, sizeof(dns_name_t));
+	if (node->name == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	dns_name_init(node->name, NULL);
+	result = dns_name_dup(name, mctx, node->name);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, node->name, sizeof(dns_name_t));
+		node->name = NULL;
+		goto cleanup;
+	}
+
+	while (isc_buffer_remaininglength(b) > 0) {
+		list = isc_mem_get(mctx, sizeof(dns_rdatalist_t));
+		if (list == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		list->rdclass = sdlz->common.rdclass;
+		list->type = isc_buffer_getuint16(b);
+		list->covers = 0;
+		list->ttl = ISC_MIN(isc_buffer_getuint32(b), ttl);
+		ISC_LIST_INIT(list->rdata);
+		ISC_LINK_INIT(list, link);
+		ISC_LIST_APPEND(node->lists, list, link);
+
+		for (count = isc_buffer_getuint16(b); count > 0; count--) {
+			rdata = isc_mem_get(mctx, sizeof(dns_rdata_t));
+			if (rdata == NULL) {
+				result = ISC_R_NOMEMORY;
+				goto cleanup;
+			}
+			dns_rdata_init(rdata);
+			r.length = isc_buffer_getuint16(b);
+			r.base = isc_buffer_current(b);
+			isc_buffer_forward(b, r.length);
+			dns_rdata_fromregion(rdata, list->rdclass, list->type,
+					     &r);
+			ISC_LIST_APPEND(list->rdata, rdata, link);
+		}
+	}
+
+	*nodep = node;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	destroynode(node);
+	return (result);
+}
+
+/*%
+ * Look 'name' up in the cache.  '*hitp' is set if the cache answered,
+ * in which case ISC_R_NOTFOUND means the driver had nothing for the
+ * name.  On a miss, '*generationp' is set for cache_store().
+ */
+static isc_result_t
+cache_find(sdlz_cache_t *cache, dns_sdlz_db_t *sdlz, dns_name_t *name,
+	   unsigned int *generationp, isc_boolean_t *hitp,
+	   dns_sdlznode_t **nodep)
+{
+	sdlz_stripe_t *stripe;
+	sdlz_entry_t **ep, *entry;
+	dns_fixedname_t fname, fzone;
+	isc_region_t namer, zoner;
+	isc_buffer_t *b = NULL;
+	isc_stdtime_t now;
+	isc_boolean_t negative;
+	unsigned int hashval;
+	dns_ttl_t ttl;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	*hitp = ISC_FALSE;
+
+	cache_key(name, &fname, &namer);
+	cache_key(&sdlz->common.origin, &fzone, &zoner);
+	hashval = dns_name_hash(name, ISC_FALSE);
+	stripe = cache_stripe(cache, hashval);
+	isc_stdtime_get(&now);
+
+	LOCK(&stripe->lock);
+	*generationp = stripe->generation;
+	ep = entry_find(stripe, hashval, &namer, &zoner);
+	entry = *ep;
+	if (entry != NULL &&
+	    (now < entry->stored || now - entry->stored >= entry->ttl))
+	{
+		entry_free(cache, stripe, ep);
+		entry = NULL;
+	}
+	if (entry == NULL) {
+		UNLOCK(&stripe->lock);
+		return (ISC_R_NOTFOUND);
+	}
+
+	ISC_LIST_UNLINK(stripe->lru, entry, link);
+	ISC_LIST_PREPEND(stripe->lru, entry, link);
+
+	ttl = entry->ttl - (now - entry->stored);
+	if (cache->nthreads > 0 && !entry->refreshing &&
+	    ttl <= entry->ttl / 4)
+		entry->refreshing = cache_enqueue(cache, sdlz, name,
+						  stripe->generation);
+
+	negative = entry->negative;
+	if (!negative && entry->datalen > 0) {
+		result = isc_buffer_allocate(sdlz->common.mctx, &b,
+					     entry->datalen);
+		if (result == ISC_R_SUCCESS)
+			isc_buffer_putmem(b, ENTRY_DATA(entry),
+					  entry->datalen);
+	}
+	UNLOCK(&stripe->lock);
+
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	*hitp = ISC_TRUE;
+	if (negative)
+		return (ISC_R_NOTFOUND);
+	if (b == NULL) {
+		result = isc_buffer_allocate(sdlz->common.mctx, &b, 1);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	return (node_fromwire(sdlz, name, b, ttl, nodep));
+}
+
+/*%
+ * Remember the outcome of looking 'name' up.  Answers are kept for the
+ * smallest TTL among them, capped at max-cache-ttl; "not found" and
+ * names without records for max-ncache-ttl.  Anything else is not
+ * cached, nor is anything if the stripe was flushed since the lookup
+ * began.
+ */
+static void
+cache_store(sdlz_cache_t *cache, dns_sdlz_db_t *sdlz, dns_name_t *name,
+	    isc_result_t result, dns_sdlznode_t *node,
+	    unsigned int generation)
+{
+	sdlz_stripe_t *stripe;
+	sdlz_entry_t **ep, *entry;
+	dns_rdatalist_t *list;
+	dns_rdata_t *rdata;
+	dns_fixedname_t fname, fzone;
+	isc_region_t namer, zoner;
+	isc_buffer_t b;
+	unsigned int hashval, bucket, datalen = 0, count;
+	size_t size;
+	dns_ttl_t ttl;
+
+	if (result == ISC_R_SUCCESS) {
+		ttl = cache->maxttl;
+		for (list = ISC_LIST_HEAD(node->lists);
+		     list != NULL;
+		     list = ISC_LIST_NEXT(list, link))
+		{
+			if (list->ttl < ttl)
+				ttl = list->ttl;
+			datalen += 8;
+			for (rdata = ISC_LIST_HEAD(list->rdata);
+			     rdata != NULL;
+			     rdata = ISC_LIST_NEXT(rdata, link))
+				datalen += 2 + rdata->length;
+		}
+		if (ISC_LIST_EMPTY(node->lists))
+			ttl = cache->maxncachettl;
+	} else if (result == ISC_R_NOTFOUND)
+		ttl = cache->maxncachettl;
+	else
+		return;
+	if (ttl == 0)
+		return;
+
+	cache_key(name, &fname, &namer);
+	cache_key(&sdlz->common.origin, &fzone, &zoner);
+	size = sizeof(*entry) + namer.length + zoner.length + datalen;
+	if (cache->maxsize != 0 && size > cache->maxsize)
+		return;
+
+	entry = isc_mem_get(cache->mctx, size);
+	if (entry == NULL)
+		return;
+	entry->next = NULL;
+	ISC_LINK_INIT(entry, link);
+	entry->hashval = hashval = dns_name_hash(name, ISC_FALSE);
+	isc_stdtime_get(&entry->stored);
+	entry->ttl = ttl;
+	entry->negative = ISC_TF(result != ISC_R_SUCCESS);
+	entry->refreshing = ISC_FALSE;
+	entry->size = size;
+	entry->namelen = namer.length;
+	entry->zonelen = zoner.length;
+	entry->datalen = datalen;
+	memmove(ENTRY_NAME(entry), namer.base, namer.length);
+	memmove(ENTRY_ZONE(entry), zoner.base, zoner.length);
+
+	isc_buffer_init(&b, ENTRY_DATA(entry), datalen);
+	for (list = (result == ISC_R_SUCCESS) ? ISC_LIST_HEAD(node->lists)
+					      : NULL;
+	     list != NULL;
+	     list = ISC_LIST_NEXT(list, link))
+	{
+		count = 0;
+		for (rdata = ISC_LIST_HEAD(list->rdata);
+		     rdata != NULL;
+		     rdata = ISC_LIST_NEXT(rdata, link))
+			count++;
+		isc_buffer_putuint16(&b, list->type);
+		isc_buffer_putuint32(&b, list->ttl);
+		isc_buffer_putuint16(&b, count);
+		for (rdata = ISC_LIST_HEAD(list->rdata);
+		     rdata != NULL;
+		     rdata = ISC_LIST_NEXT(rdata, link))
+		{
+			isc_buffer_putuint16(&b, rdata->length);
+			isc_buffer_putmem(&b, rdata->data, rdata->length);
+		}
+	}
+
+	stripe = cache_stripe(cache, hashval);
+	LOCK(&stripe->lock);
+	if (stripe->generation != generation) {
+		UNLOCK(&stripe->lock);
+		isc_mem_put(cache->mctx, entry, size);
+		return;
+	}
+	ep = entry_find(stripe, hashval, &namer, &zoner);
+	if (*ep != NULL)
+		entry_free(cache, stripe, ep);
+	bucket = SDLZ_BUCKET(hashval);
+	entry->next = stripe->table[bucket];
+	stripe->table[bucket] = entry;
+	ISC_LIST_PREPEND(stripe->lru, entry, link);
+	stripe->bytes += size;
+
+	while (cache->maxsize != 0 && stripe->bytes > cache->maxsize) {
+		sdlz_entry_t *victim = ISC_LIST_TAIL(stripe->lru);
+
+		for (ep = &stripe->table[SDLZ_BUCKET(victim->hashval)];
+		     *ep != victim;
+		     ep = &(*ep)->next)
+			;
+		entry_free(cache, stripe, ep);
+	}
+	UNLOCK(&stripe->lock);
+}
+
+/*%
+ * Forget 'name' in every zone, or everything if 'name' is NULL.
+ */
+static void
+cache_flush(sdlz_cache_t *cache, dns_name_t *name) {
+	sdlz_stripe_t *stripe;
+	sdlz_entry_t **ep;
+	dns_fixedname_t fname;
+	isc_region_t namer;
+	unsigned int hashval, i;
+
+	if (name != NULL) {
+		cache_key(name, &fname, &namer);
+		hashval = dns_name_hash(name, ISC_FALSE);
+		stripe = cache_stripe(cache, hashval);
+		LOCK(&stripe->lock);
+		stripe->generation++;
+		for (;;) {
+			ep = entry_find(stripe, hashval, &namer, NULL);
+			if (*ep == NULL)
+				break;
+			entry_free(cache, stripe, ep);
+		}
+		UNLOCK(&stripe->lock);
+		return;
+	}
+
+	for (stripe = cache->stripes;
+	     stripe < cache->stripes + SDLZ_CACHE_STRIPES;
+	     stripe++)
+	{
+		LOCK(&stripe->lock);
+		stripe->generation++;
+		for (i = 0; i < SDLZ_CACHE_BUCKETS; i++)
+			while (stripe->table[i] != NULL)
+				entry_free(cache, stripe, &stripe->table[i]);
+		UNLOCK(&stripe->lock);
+	}
+}
+
+/*%
+ * Forget everything cached for 'zone'.  Every stripe's generation is
+ * bumped, so lookups and refreshes of the zone already under way are
+ * not stored; those of other zones merely miss being cached once.
+ */
+static void
+cache_flushzone(sdlz_cache_t *cache, dns_name_t *zone) {
+	sdlz_stripe_t *stripe;
+	sdlz_entry_t **ep, *entry;
+	dns_fixedname_t fzone;
+	isc_region_t zoner;
+	unsigned int i;
+
+	cache_key(zone, &fzone, &zoner);
+	for (stripe = cache->stripes;
+	     stripe < cache->stripes + SDLZ_CACHE_STRIPES;
+	     stripe++)
+	{
+		LOCK(&stripe->lock);
+		stripe->generation++;
+		for (i = 0; i < SDLZ_CACHE_BUCKETS; i++) {
+			ep = &stripe->table[i];
+			while ((entry = *ep) != NULL) {
+				if (entry->zonelen == zoner.length &&
+				    memcmp(ENTRY_ZONE(entry), zoner.base,
+					   zoner.length) == 0)
+					entry_free(cache, stripe, ep);
+				else
+					ep = &entry->next;
+			}
+		}
+		UNLOCK(&stripe->lock);
+	}
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static void
+cache_refresh(sdlz_cache_t *cache, sdlz_job_t *job) {
+	sdlz_instance_t *inst = cache->instance;
+	dns_name_t *name = dns_fixedname_name(&job->name);
+	dns_db_t *db = NULL;
+	dns_sdlznode_t *node = NULL;
+	isc_result_t result;
+
+	result = dns_sdlzcreateDBP(inst->mctx, inst->imp, inst,
+				   dns_fixedname_name(&job->zone),
+				   job->rdclass, &db);
+	if (result != ISC_R_SUCCESS)
+		return;
+
+	/*
+	 * There is no client to pass on; drivers whose answers depend
+	 * on the client should not be cached at all.
+	 */
+	result = lookupnode((dns_sdlz_db_t *)db, name, ISC_FALSE, NULL, NULL,
+			    &node);
+	cache_store(cache, (dns_sdlz_db_t *)db, name, result, node,
+		    job->generation);
+	if (node != NULL)
+		destroynode(node);
+	dns_db_detach(&db);
+}
+
+static isc_threadresult_t
+cache_refresher(isc_threadarg_t arg) {
+	sdlz_cache_t *cache = arg;
+	sdlz_job_t *job;
+
+	LOCK(&cache->qlock);
+	for (;;) {
+		while (!cache->shuttingdown && ISC_LIST_EMPTY(cache->jobs))
+			WAIT(&cache->qcond, &cache->qlock);
+		if (cache->shuttingdown)
+			break;
+		job = ISC_LIST_HEAD(cache->jobs);
+		ISC_LIST_UNLINK(cache->jobs, job, link);
+		cache->njobs--;
+		UNLOCK(&cache->qlock);
+
+		cache_refresh(cache, job);
+		isc_mem_put(cache->mctx, job, sizeof(*job));
+
+		LOCK(&cache->qlock);
+	}
+	UNLOCK(&cache->qlock);
+
+	return ((isc_threadresult_t)0);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
+/*%
+ * Stop the refresh threads and drop any lookups still queued.
+ */
+static void
+cache_shutdown(sdlz_cache_t *cache) {
+#ifdef ISC_PLATFORM_USETHREADS
+	sdlz_job_t *job;
+	unsigned int i;
+
+	if (cache->threads == NULL)
+		return;
+
+	LOCK(&cache->qlock);
+	cache->shuttingdown = ISC_TRUE;
+	BROADCAST(&cache->qcond);
+	UNLOCK(&cache->qlock);
+
+	for (i = 0; i < cache->nthreads; i++)
+		(void)isc_thread_join(cache->threads[i], NULL);
+	isc_mem_put(cache->mctx, cache->threads,
+		    cache->nthreads * sizeof(isc_thread_t));
+	cache->threads = NULL;
+
+	while ((job = ISC_LIST_HEAD(cache->jobs)) != NULL) {
+		ISC_LIST_UNLINK(cache->jobs, job, link);
+		isc_mem_put(cache->mctx, job, sizeof(*job));
+	}
+	cache->njobs = 0;
+#else
+	UNUSED(cache);
+#endif
+}
+
+static void
+cache_destroy(sdlz_cache_t **cachep) {
+	sdlz_cache_t *cache = *cachep;
+	unsigned int i;
+
+	*cachep = NULL;
+
+	cache_shutdown(cache);
+	cache_flush(cache, NULL);
+	for (i = 0; i < SDLZ_CACHE_STRIPES; i++)
+		DESTROYLOCK(&cache->stripes[i].lock);
+#ifdef ISC_PLATFORM_USETHREADS
+	(void)isc_condition_destroy(&cache->qcond);
+	DESTROYLOCK(&cache->qlock);
+#endif
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+static isc_result_t
+cache_create(sdlz_instance_t *inst, dns_ttl_t maxttl, dns_ttl_t maxncachettl,
+	     size_t maxsize, unsigned int nthreads, sdlz_cache_t **cachep)
+{
+	sdlz_cache_t *cache;
+	isc_result_t result;
+	unsigned int i;
+
+	cache = isc_mem_get(inst->mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(cache, 0, sizeof(*cache));
+	cache->instance = inst;
+	cache->maxttl = maxttl;
+	cache->maxncachettl = maxncachettl;
+	cache->maxsize = maxsize / SDLZ_CACHE_STRIPES;
+	if (maxsize != 0 && cache->maxsize == 0)
+		cache->maxsize = 1;
+
+	for (i = 0; i < SDLZ_CACHE_STRIPES; i++) {
+		result = isc_mutex_init(&cache->stripes[i].lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_stripes;
+		ISC_LIST_INIT(cache->stripes[i].lru);
+	}
+
+#ifdef ISC_PLATFORM_USETHREADS
+	result = isc_mutex_init(&cache->qlock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_stripes;
+	result = isc_condition_init(&cache->qcond);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_qlock;
+	ISC_LIST_INIT(cache->jobs);
+	isc_mem_attach(inst->mctx, &cache->mctx);
+
+	if (nthreads > 0) {
+		cache->threads = isc_mem_get(cache->mctx,
+					     nthreads * sizeof(isc_thread_t));
+		if (cache->threads == NULL) {
+			cache_destroy(&cache);
+			return (ISC_R_NOMEMORY);
+		}
+		cache->nthreads = nthreads;
+		for (i = 0; i < nthreads; i++) {
+			result = isc_thread_create(cache_refresher, cache,
+						   &cache->threads[i]);
+			if (result != ISC_R_SUCCESS)
+				break;
+		}
+		if (result != ISC_R_SUCCESS) {
+			/* Stop the threads that did start. */
+			LOCK(&cache->qlock);
+			cache->shuttingdown = ISC_TRUE;
+			BROADCAST(&cache->qcond);
+			UNLOCK(&cache->qlock);
+			while (i-- > 0)
+				(void)isc_thread_join(cache->threads[i], NULL);
+			isc_mem_put(cache->mctx, cache->threads,
+				    nthreads * sizeof(isc_thread_t));
+			cache->threads = NULL;
+			cache_destroy(&cache);
+			return (result);
+		}
+	}
+#else
+	UNUSED(nthreads);
+	isc_mem_attach(inst->mctx, &cache->mctx);
+#endif
+
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+#ifdef ISC_PLATFORM_USETHREADS
+ cleanup_qlock:
+	DESTROYLOCK(&cache->qlock);
+#endif
+ cleanup_stripes:
+	while (i-- > 0)
+		DESTROYLOCK(&cache->stripes[i].lock);
+	isc_mem_put(inst->mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+static isc_result_t
+findnodeext(dns_db_t *db, dns_name_t *name, isc_boolean_t create,
+	    dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
+	    dns_dbnode_t **nodep)
+{
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
+	sdlz_cache_t *cache;
+	dns_sdlznode_t *node = NULL;
+	unsigned int generation = 0;
+	isc_boolean_t hit;
+	isc_result_t result;
+
+	REQUIRE(VALID_SDLZDB(sdlz));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+
+	cache = sdlz->instance->cache;
+	if (cache == NULL || create)
+		return (lookupnode(sdlz, name, create, methods, clientinfo,
+				   (dns_sdlznode_t **)nodep));
+
+	result = cache_find(cache, sdlz, name, &generation, &hit, &node);
+	if (!hit) {
+		result = lookupnode(sdlz, name, ISC_FALSE, methods,
+				    clientinfo, &node);
+		cache_store(cache, sdlz, name, result, node, generation);
+	}
+	if (result == ISC_R_SUCCESS)
+		*nodep = node;
+	return (result);
+}
+
 static isc_result_t
 findnode(dns_db_t *db, dns_name_t *name, isc_boolean_t create,
 	 dns_dbnode_t **nodep)
@@ -1263,7 +2047,9 @@ static dns_dbmethods_t sdlzdb_methods = {
 	NULL,			/* rpz_enabled */
 	NULL,			/* rpz_findips */
 	findnodeext,
-	findext
+	findext,
+	NULL,			/* rpz_setsummary */
+	NULL			/* setslabstore */
 };
 
 /*
@@ -1470,10 +2256,13 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 	isc_result_t result;
 	dns_sdlz_db_t *sdlzdb;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
+	unsigned int refs;
 
 	/* check that things are as we expect */
 	REQUIRE(dbp != NULL && *dbp == NULL);
 	REQUIRE(name != NULL);
+	REQUIRE(VALID_SDLZINST(inst));
 
 	imp = (dns_sdlzimplementation_t *) driverarg;
 
@@ -1500,8 +2289,10 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 	sdlzdb->common.attributes = 0;
 	sdlzdb->common.rdclass = rdclass;
 	sdlzdb->common.mctx = NULL;
-	sdlzdb->dbdata = dbdata;
+	sdlzdb->dbdata = inst->dbdata;
 	sdlzdb->references = 1;
+	isc_refcount_increment(&inst->references, &refs);
+	sdlzdb->instance = inst;
 
 	/* attach to the memory context */
 	isc_mem_attach(mctx, &sdlzdb->common.mctx);
@@ -1537,11 +2328,13 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	isc_netaddr_t netaddr;
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
 	 */
 	REQUIRE(driverarg != NULL);
+	REQUIRE(VALID_SDLZINST(inst));
 	REQUIRE(name != NULL);
 	REQUIRE(clientaddr != NULL);
 	REQUIRE(dbp != NULL && *dbp == NULL);
@@ -1570,7 +2363,8 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	/* Call SDLZ driver's find zone method */
 	if (imp->methods->allowzonexfr != NULL) {
 		MAYBE_LOCK(imp);
-		result = imp->methods->allowzonexfr(imp->driverarg, dbdata,
+		result = imp->methods->allowzonexfr(imp->driverarg,
+						    inst->dbdata,
 						    namestr, clientstr);
 		MAYBE_UNLOCK(imp);
 		/*
@@ -1591,6 +2385,7 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	       char *argv[], void *driverarg, void **dbdata)
 {
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst;
 	isc_result_t result = ISC_R_NOTFOUND;
 
 	/* Write debugging message to log */
@@ -1602,15 +2397,21 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	REQUIRE(driverarg != NULL);
 	REQUIRE(dlzname != NULL);
 	REQUIRE(dbdata != NULL);
-	UNUSED(mctx);
 
 	imp = driverarg;
 
+	inst = isc_mem_get(mctx, sizeof(*inst));
+	if (inst == NULL)
+		return (ISC_R_NOMEMORY);
+	inst->imp = imp;
+	inst->dbdata = NULL;
+	inst->cache = NULL;
+
 	/* If the create method exists, call it. */
 	if (imp->methods->create != NULL) {
 		MAYBE_LOCK(imp);
 		result = imp->methods->create(dlzname, argc, argv,
-					      imp->driverarg, dbdata);
+					      imp->driverarg, &inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
 
@@ -1619,28 +2420,66 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 		sdlz_log(ISC_LOG_DEBUG(2), "SDLZ driver loaded successfully.");
 	} else {
 		sdlz_log(ISC_LOG_ERROR, "SDLZ driver failed to load.");
+		isc_mem_put(mctx, inst, sizeof(*inst));
+		return (result);
 	}
 
+	isc_refcount_init(&inst->references, 1);
+	inst->mctx = NULL;
+	isc_mem_attach(mctx, &inst->mctx);
+	inst->magic = SDLZINST_MAGIC;
+	*dbdata = inst;
+
 	return (result);
 }
 
+static void
+instance_detach(sdlz_instance_t **instp) {
+	sdlz_instance_t *inst;
+	unsigned int refs;
+
+	REQUIRE(instp != NULL && VALID_SDLZINST(*instp));
+
+	inst = *instp;
+	*instp = NULL;
+
+	isc_refcount_decrement(&inst->references, &refs);
+	if (refs > 0)
+		return;
+
+	if (inst->cache != NULL)
+		cache_destroy(&inst->cache);
+	isc_refcount_destroy(&inst->references);
+	inst->magic = 0;
+	isc_mem_putanddetach(&inst->mctx, inst, sizeof(*inst));
+}
+
 static void
 dns_sdlzdestroy(void *driverdata, void **dbdata)
 {
 
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = (sdlz_instance_t *)dbdata;
+
+	REQUIRE(VALID_SDLZINST(inst));
 
 	/* Write debugging message to log */
 	sdlz_log(ISC_LOG_DEBUG(2), "Unloading SDLZ driver.");
 
 	imp = driverdata;
 
+	/* No refreshes may reach the driver once it is gone. */
+	if (inst->cache != NULL)
+		cache_shutdown(inst->cache);
+
 	/* If the destroy method exists, call it. */
 	if (imp->methods->destroy != NULL) {
 		MAYBE_LOCK(imp);
-		imp->methods->destroy(imp->driverarg, dbdata);
+		imp->methods->destroy(imp->driverarg, inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
+
+	instance_detach(&inst);
 }
 
 static isc_result_t
@@ -1651,11 +2490,13 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	char namestr[DNS_NAME_MAXTEXT + 1];
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
 	 */
 	REQUIRE(driverarg != NULL);
+	REQUIRE(VALID_SDLZINST(inst));
 	REQUIRE(name != NULL);
 	REQUIRE(dbp != NULL && *dbp == NULL);
 
@@ -1673,7 +2514,7 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 
 	/* Call SDLZ driver's find zone method */
 	MAYBE_LOCK(imp);
-	result = imp->methods->findzone(imp->driverarg, dbdata, namestr);
+	result = imp->methods->findzone(imp->driverarg, inst->dbdata, namestr);
 	MAYBE_UNLOCK(imp);
 
 	/*
@@ -1693,15 +2534,18 @@ dns_sdlzconfigure(void *driverarg, void *dbdata, dns_view_t *view)
 {
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst = dbdata;
 
 	REQUIRE(driverarg != NULL);
+	REQUIRE(VALID_SDLZINST(inst));
 
 	imp = (dns_sdlzimplementation_t *) driverarg;
 
 	/* Call SDLZ driver's configure method */
 	if (imp->methods->configure != NULL) {
 		MAYBE_LOCK(imp);
-		result = imp->methods->configure(view, imp->driverarg, dbdata);
+		result = imp->methods->configure(view, imp->driverarg,
+						 inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	} else {
 		result = ISC_R_SUCCESS;
@@ -1725,8 +2569,10 @@ dns_sdlzssumatch(dns_name_t *signer, dns_name_t *name, isc_netaddr_t *tcpaddr,
 	isc_region_t token_region;
 	isc_uint32_t token_len = 0;
 	isc_boolean_t ret;
+	sdlz_instance_t *inst = dbdata;
 
 	REQUIRE(driverarg != NULL);
+	REQUIRE(VALID_SDLZINST(inst));
 
 	imp = (dns_sdlzimplementation_t *) driverarg;
 	if (imp->methods->ssumatch == NULL)
@@ -1765,7 +2611,7 @@ dns_sdlzssumatch(dns_name_t *signer, dns_name_t *name, isc_netaddr_t *tcpaddr,
 	ret = imp->methods->ssumatch(b_signer, b_name, b_addr, b_type, b_key,
 				     token_len,
 				     token_len != 0 ? token_region.base : NULL,
-				     imp->driverarg, dbdata);
+				     imp->driverarg, inst->dbdata);
 	MAYBE_UNLOCK(imp);
 	return (ret);
 }
@@ -2118,3 +2964,40 @@ dns_sdlz_setdb(dns_dlzdb_t *dlzdatabase, dns_rdataclass_t rdclass,
 				   dlzdatabase->dbdata, name, rdclass, dbp);
 	return (result);
 }
+
+isc_result_t
+dns_sdlz_setcache(dns_dlzdb_t *dlzdatabase, dns_ttl_t maxttl,
+		  dns_ttl_t maxncachettl, size_t maxsize, unsigned int threads)
+{
+	sdlz_instance_t *inst;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+
+	if (dlzdatabase->implementation->methods != &sdlzmethods)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	inst = dlzdatabase->dbdata;
+	REQUIRE(VALID_SDLZINST(inst));
+	REQUIRE(inst->cache == NULL);
+
+	return (cache_create(inst, maxttl, maxncachettl, maxsize, threads,
+			     &inst->cache));
+}
+
+isc_result_t
+dns_sdlz_flushcache(dns_dlzdb_t *dlzdatabase, dns_name_t *name) {
+	sdlz_instance_t *inst;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+
+	if (dlzdatabase->implementation->methods != &sdlzmethods)
+		return (ISC_R_NOTFOUND);
+
+	inst = dlzdatabase->dbdata;
+	REQUIRE(VALID_SDLZINST(inst));
+	if (inst->cache == NULL)
+		return (ISC_R_NOTFOUND);
+
+	cache_flush(inst->cache, name);
+	return (ISC_R_SUCCESS);
+}
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/slabstore.h>
+
+#define SLABSTORE_MAGIC			ISC_MAGIC('S', 'l', 'b', 'S')
+#define VALID_SLABSTORE(s)		ISC_MAGIC_VALID(s, SLABSTORE_MAGIC)
+
+/*
+ * The table is split into stripes by the low bits of the slab hash,
+ * each with its own lock, buckets and counters, so that zones loading
+ * or freeing in parallel rarely wait for each other.  Buckets within a
+ * stripe are chosen by the bits above those.
+ */
+#define SLABSTORE_STRIPEBITS		4
+#define SLABSTORE_STRIPES		(1 << SLABSTORE_STRIPEBITS)
+#define SLABSTORE_MINSIZE		64	/* per stripe */
+
+#define SLABSTORE_STRIPE(h)		((h) & (SLABSTORE_STRIPES - 1))
+#define SLABSTORE_BUCKET(h, size)	\
+	(((h) >> SLABSTORE_STRIPEBITS) & ((size) - 1))
+
+typedef struct slab_entry slab_entry_t;
+struct slab_entry {
+	slab_entry_t			*next;
+	isc_uint32_t			hash;
+	unsigned int			length;
+	unsigned int			references;	/* locked by stripe */
+	/* 'length' bytes of slab follow */
+};
+#define ENTRY_SLAB(e)		((unsigned char *)((e) + 1))
+#define SLAB_ENTRY(s)		((slab_entry_t *)(s) - 1)
+
+typedef struct slab_stripe {
+	isc_mutex_t			lock;
+	/* Locked by lock. */
+	unsigned int			size;		/* power of 2 */
+	slab_entry_t			**table;
+	dns_slabstorestats_t		stats;
+} slab_stripe_t;
+
+struct dns_slabstore {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	isc_refcount_t			references;
+	slab_stripe_t			stripes[SLABSTORE_STRIPES];
+};
+
+static isc_uint32_t
+slab_hash(const unsigned char *slab, unsigned int length) {
+	isc_uint32_t hash = 2166136261U;
+
+	while (length-- > 0)
+		hash = (hash ^ *slab++) * 16777619U;
+	return (hash);
+}
+
+/*
+ * Double the size of the stripe's table.  If that cannot be done the
+ * chains just get longer.  Called with the stripe locked.
+ */
+static void
+stripe_grow(dns_slabstore_t *store, slab_stripe_t *stripe) {
+	slab_entry_t **table, *e, *next;
+	unsigned int size, i, bucket;
+
+	size = stripe->size * 2;
+	table = isc_mem_get(store->mctx, size * sizeof(*table));
+	if (table == NULL)
+		return;
+	memset(table, 0, size * sizeof(*table));
+	for (i = 0; i < stripe->size; i++) {
+		for (e = stripe->table[i]; e != NULL; e = next) {
+			next = e->next;
+			bucket = SLABSTORE_BUCKET(e->hash, size);
+			e->next = table[bucket];
+			table[bucket] = e;
+		}
+	}
+	isc_mem_put(store->mctx, stripe->table,
+		    stripe->size * sizeof(*table));
+	stripe->table = table;
+	stripe->size = size;
+}
+
+isc_result_t
+dns_slabstore_create(isc_mem_t *mctx, dns_slabstore_t **storep) {
+	dns_slabstore_t *store;
+	slab_stripe_t *stripe;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(storep != NULL && *storep == NULL);
+
+	store = isc_mem_get(mctx, sizeof(*store));
+	if (store == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(store, 0, sizeof(*store));
+
+	result = isc_refcount_init(&store->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_store;
+
+	for (i = 0; i < SLABSTORE_STRIPES; i++) {
+		stripe = &store->stripes[i];
+		stripe->size = SLABSTORE_MINSIZE;
+		stripe->table = isc_mem_get(mctx, stripe->size *
+						  sizeof(*stripe->table));
+		if (stripe->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup_stripes;
+		}
+		memset(stripe->table, 0,
+		       stripe->size * sizeof(*stripe->table));
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, stripe->table,
+				    stripe->size * sizeof(*stripe->table));
+			goto cleanup_stripes;
+		}
+	}
+
+	isc_mem_attach(mctx, &store->mctx);
+	store->magic = SLABSTORE_MAGIC;
+	*storep = store;
+	return (ISC_R_SUCCESS);
+
+ cleanup_stripes:
+	while (i-- > 0) {
+		stripe = &store->stripes[i];
+		DESTROYLOCK(&stripe->lock);
+		isc_mem_put(mctx, stripe->table,
+			    stripe->size * sizeof(*stripe->table));
+	}
+	isc_refcount_destroy(&store->references);
+ cleanup_store:
+	isc_mem_put(mctx, store, sizeof(*store));
+	return (result);
+}
+
+void
+dns_slabstore_attach(dns_slabstore_t *source, dns_slabstore_t **targetp) {
+	REQUIRE(VALID_SLABSTORE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_slabstore_detach(dns_slabstore_t **storep) {
+	dns_slabstore_t *store;
+	slab_stripe_t *stripe;
+	unsigned int refs, i;
+
+	REQUIRE(storep != NULL && VALID_SLABSTORE(*storep));
+	store = *storep;
+	*storep = NULL;
+
+	isc_refcount_decrement(&store->references, &refs);
+	if (refs != 0)
+		return;
+
+	for (i = 0; i < SLABSTORE_STRIPES; i++) {
+		stripe = &store->stripes[i];
+		INSIST(stripe->stats.entries == 0);
+		isc_mem_put(store->mctx, stripe->table,
+			    stripe->size * sizeof(*stripe->table));
+		DESTROYLOCK(&stripe->lock);
+	}
+	isc_refcount_destroy(&store->references);
+	store->magic = 0;
+	isc_mem_putanddetach(&store->mctx, store, sizeof(*store));
+}
+
+isc_result_t
+dns_slabstore_intern(dns_slabstore_t *store, const unsigned char *slab,
+		     unsigned int length, unsigned char **slabp)
+{
+	slab_stripe_t *stripe;
+	slab_entry_t *e, **bucket;
+	isc_uint32_t hash;
+
+	REQUIRE(VALID_SLABSTORE(store));
+	REQUIRE(slab != NULL && length > 0);
+	REQUIRE(slabp != NULL && *slabp == NULL);
+
+	hash = slab_hash(slab, length);
+	stripe = &store->stripes[SLABSTORE_STRIPE(hash)];
+
+	LOCK(&stripe->lock);
+	stripe->stats.lookups++;
+	bucket = &stripe->table[SLABSTORE_BUCKET(hash, stripe->size)];
+	for (e = *bucket; e != NULL; e = e->next) {
+		if (e->hash == hash && e->length == length &&
+		    memcmp(ENTRY_SLAB(e), slab, length) == 0)
+			break;
+	}
+	if (e != NULL) {
+		e->references++;
+		stripe->stats.hits++;
+		stripe->stats.references++;
+		stripe->stats.saved += length;
+		UNLOCK(&stripe->lock);
+		*slabp = ENTRY_SLAB(e);
+		return (ISC_R_SUCCESS);
+	}
+
+	e = isc_mem_get(store->mctx, sizeof(*e) + length);
+	if (e == NULL) {
+		UNLOCK(&stripe->lock);
+		return (ISC_R_NOMEMORY);
+	}
+	e->hash = hash;
+	e->length = length;
+	e->references = 1;
+	memmove(ENTRY_SLAB(e), slab, length);
+	e->next = *bucket;
+	*bucket = e;
+	stripe->stats.entries++;
+	stripe->stats.references++;
+	stripe->stats.bytes += length;
+	if (stripe->stats.entries > stripe->size * 2)
+		stripe_grow(store, stripe);
+	UNLOCK(&stripe->lock);
+
+	*slabp = ENTRY_SLAB(e);
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_slabstore_release(dns_slabstore_t *store, unsigned char **slabp) {
+	slab_stripe_t *stripe;
+	slab_entry_t *e, **ep;
+
+	REQUIRE(VALID_SLABSTORE(store));
+	REQUIRE(slabp != NULL && *slabp != NULL);
+
+	e = SLAB_ENTRY(*slabp);
+	*slabp = NULL;
+	stripe = &store->stripes[SLABSTORE_STRIPE(e->hash)];
+
+	LOCK(&stripe->lock);
+	INSIST(e->references > 0);
+	stripe->stats.references--;
+	if (--e->references > 0) {
+		stripe->stats.saved -= e->length;
+		UNLOCK(&stripe->lock);
+		return;
+	}
+	for (ep = &stripe->table[SLABSTORE_BUCKET(e->hash, stripe->size)];
+	     *ep != e;
+	     ep = &(*ep)->next)
+		INSIST(*ep != NULL);
+	*ep = e->next;
+	stripe->stats.entries--;
+	stripe->stats.bytes -= e->length;
+	UNLOCK(&stripe->lock);
+
+	isc_mem_put(store->mctx, e, sizeof(*e) + e->length);
+}
+
+void
+dns_slabstore_getstats(dns_slabstore_t *store, dns_slabstorestats_t *stats) {
+	slab_stripe_t *stripe;
+	unsigned int i;
+
+	REQUIRE(VALID_SLABSTORE(store));
+	REQUIRE(stats != NULL);
+
+	/*
+	 * The stripes are read one at a time, so the totals need not
+	 * describe a single moment while slabs are being interned.
+	 */
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < SLABSTORE_STRIPES; i++) {
+		stripe = &store->stripes[i];
+		LOCK(&stripe->lock);
+		stats->lookups += stripe->stats.lookups;
+		stats->hits += stripe->stats.hits;
+		stats->entries += stripe->stats.entries;
+		stats->references += stripe->stats.references;
+		stats->bytes += stripe->stats.bytes;
+		stats->saved += stripe->stats.saved;
+		UNLOCK(&stripe->lock);
+	}
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/netaddr.h>
+#include <isc/string.h>
+
+#include <dns/acl.h>
+#include <dns/iptable.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+static isc_uint32_t seed = 1;
+
+static isc_uint32_t
+next(void) {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8);
+}
+
+static void
+randomaddr(isc_netaddr_t *na, isc_boolean_t v6) {
+	unsigned char bytes[16];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(bytes); i++)
+		bytes[i] = next() & 0xff;
+	/* Keep addresses close together so that prefixes overlap. */
+	bytes[0] &= 0x3;
+	if (v6)
+		isc_netaddr_fromin6(na, (struct in6_addr *)bytes);
+	else
+		isc_netaddr_fromin(na, (struct in_addr *)bytes);
+}
+
+static int
+match(dns_acl_t *acl, isc_netaddr_t *na) {
+	isc_result_t result;
+	int m;
+
+	result = dns_acl_match(na, NULL, acl, NULL, &m, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (m);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(compile);
+ATF_TC_HEAD(compile, tc) {
+	atf_tc_set_md_var(tc, "descr", "compiled ACLs match like the radix "
+			  "tree");
+}
+ATF_TC_BODY(compile, tc) {
+	static isc_netaddr_t probes[4000];
+	static int expect[4000];
+	isc_netaddr_t na;
+	isc_result_t result;
+	dns_acl_t *acl = NULL;
+	unsigned int i, bitlen;
+	isc_boolean_t v6;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_acl_create(mctx, 0, &acl);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 500; i++) {
+		v6 = ISC_TF((i & 1) != 0);
+		randomaddr(&na, v6);
+		bitlen = next() % (v6 ? 129 : 33);
+		if (bitlen == 0)
+			bitlen = 1;
+		result = dns_iptable_addprefix(acl->iptable, &na, bitlen,
+					       ISC_TF((next() & 3) != 0));
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		/* Probe the prefix itself too. */
+		probes[i] = na;
+	}
+	for (; i < sizeof(probes) / sizeof(probes[0]); i++)
+		randomaddr(&probes[i], ISC_TF((i & 1) != 0));
+
+	ATF_REQUIRE(acl->iptable->trie == NULL);
+	for (i = 0; i < sizeof(probes) / sizeof(probes[0]); i++)
+		expect[i] = match(acl, &probes[i]);
+
+	result = dns_acl_compile(acl);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(acl->iptable->trie != NULL);
+	for (i = 0; i < sizeof(probes) / sizeof(probes[0]); i++)
+		ATF_CHECK_EQ(match(acl, &probes[i]), expect[i]);
+
+	dns_acl_detach(&acl);
+	dns_test_end();
+}
+
+ATF_TC(order);
+ATF_TC_HEAD(order, tc) {
+	atf_tc_set_md_var(tc, "descr", "the first matching prefix wins and "
+			  "adding a prefix discards the compiled table");
+}
+ATF_TC_BODY(order, tc) {
+	isc_netaddr_t na, inner;
+	struct in_addr in;
+	isc_result_t result;
+	dns_acl_t *acl = NULL;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_acl_create(mctx, 0, &acl);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* !10.0.0.0/8; 10.1.0.0/16; */
+	in.s_addr = htonl(0x0a000000);
+	isc_netaddr_fromin(&na, &in);
+	result = dns_iptable_addprefix(acl->iptable, &na, 8, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	in.s_addr = htonl(0x0a010000);
+	isc_netaddr_fromin(&na, &in);
+	result = dns_iptable_addprefix(acl->iptable, &na, 16, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_acl_compile(acl);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = htonl(0x0a010203);
+	isc_netaddr_fromin(&inner, &in);
+	ATF_CHECK_EQ(match(acl, &inner), -1);
+	in.s_addr = htonl(0x0b010203);
+	isc_netaddr_fromin(&na, &in);
+	ATF_CHECK_EQ(match(acl, &na), 0);
+
+	/* 11.0.0.0/8 */
+	result = dns_iptable_addprefix(acl->iptable, &na, 8, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(acl->iptable->trie == NULL);
+	ATF_CHECK_EQ(match(acl, &na), 3);
+	result = dns_acl_compile(acl);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(match(acl, &na), 3);
+	ATF_CHECK_EQ(match(acl, &inner), -1);
+
+	dns_acl_detach(&acl);
+	dns_test_end();
+}
+
+ATF_TC(anyornone);
+ATF_TC_HEAD(anyornone, tc) {
+	atf_tc_set_md_var(tc, "descr", "\"any\" and \"none\" match both "
+			  "address families");
+}
+ATF_TC_BODY(anyornone, tc) {
+	isc_netaddr_t na4, na6;
+	isc_result_t result;
+	dns_acl_t *any = NULL, *none = NULL;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_acl_any(mctx, &any);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_acl_none(mctx, &none);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(any->iptable->trie != NULL);
+
+	randomaddr(&na4, ISC_FALSE);
+	randomaddr(&na6, ISC_TRUE);
+	ATF_CHECK_EQ(match(any, &na4), 1);
+	ATF_CHECK_EQ(match(any, &na6), 1);
+	ATF_CHECK_EQ(match(none, &na4), -1);
+	ATF_CHECK_EQ(match(none, &na6), -1);
+
+	dns_acl_detach(&any);
+	dns_acl_detach(&none);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, compile);
+	ATF_TP_ADD_TC(tp, order);
+	ATF_TP_ADD_TC(tp, anyornone);
+
+	return (atf_no_error());
+}
@@ -148,6 +148,78 @@ ATF_TC_BODY(dispatchset_get, tc) {
 	dns_test_end();
 }
 
+static void
+nullaction(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+}
+
+static void
+check_entrylocaladdress(unsigned int attrs) {
+	isc_result_t result;
+	isc_sockaddr_t local, dest, entryaddr, sockaddr;
+	struct in_addr in;
+	dns_dispatch_t *disp = NULL;
+	dns_dispentry_t *resp = NULL;
+	isc_socket_t *sock;
+	isc_task_t *task = NULL;
+	isc_uint16_t id;
+
+	result = dns_dispatchmgr_create(mctx, NULL, &dispatchmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = htonl(INADDR_LOOPBACK);
+	isc_sockaddr_fromin(&local, &in, 0);
+	isc_sockaddr_fromin(&dest, &in, 53);
+	result = dns_dispatch_getudp(dispatchmgr, socketmgr, taskmgr,
+				     &local, 512, 6, 1024, 17, 19, attrs,
+				     attrs, &disp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_dispatch_addresponse2(disp, &dest, task, nullaction,
+					   NULL, &id, &resp, socketmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	sock = dns_dispatch_getentrysocket(resp);
+	if (sock == NULL)
+		sock = dns_dispatch_getsocket(disp);
+	ATF_REQUIRE(sock != NULL);
+	result = isc_socket_getsockname(sock, &sockaddr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_dispatch_getentrylocaladdress(resp, &entryaddr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(isc_sockaddr_equal(&entryaddr, &sockaddr));
+
+	dns_dispatch_removeresponse(&resp, NULL);
+	dns_dispatch_detach(&disp);
+	isc_task_detach(&task);
+	dns_dispatchmgr_destroy(&dispatchmgr);
+}
+
+ATF_TC(entrylocaladdress);
+ATF_TC_HEAD(entrylocaladdress, tc) {
+	atf_tc_set_md_var(tc, "descr", "the local address of a dispatch "
+			  "entry matches its socket's");
+}
+ATF_TC_BODY(entrylocaladdress, tc) {
+	isc_result_t result;
+	unsigned int attrs;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	attrs = DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_UDP;
+	check_entrylocaladdress(attrs);
+	check_entrylocaladdress(attrs | DNS_DISPATCHATTR_EXCLUSIVE);
+
+	dns_test_end();
+}
 
 /*
  * Main
@@ -155,6 +227,7 @@ ATF_TC_BODY(dispatchset_get, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, dispatchset_create);
 	ATF_TP_ADD_TC(tp, dispatchset_get);
+	ATF_TP_ADD_TC(tp, entrylocaladdress);
 	return (atf_no_error());
 }
 
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/buffer.h>
+#include <isc/string.h>
+
+#include <dns/masterdump.h>
+#include <dns/message.h>
+#include <dns/rdataset.h>
+
+#include "dnstest.h"
+
+/*
+ * A response for www.bench.example/A: two A records in the answer
+ * section, two NS records in the authority section, their addresses
+ * and an OPT record in the additional section.
+ */
+static unsigned char response[] = {
+	0x4d, 0x3c, 0x84, 0x80, 0x00, 0x01, 0x00, 0x02,
+	0x00, 0x02, 0x00, 0x05, 0x03, 0x77, 0x77, 0x77,
+	0x05, 0x62, 0x65, 0x6e, 0x63, 0x68, 0x07, 0x65,
+	0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x00, 0x00,
+	0x01, 0x00, 0x01, 0xc0, 0x0c, 0x00, 0x01, 0x00,
+	0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 0xc0,
+	0x00, 0x02, 0x50, 0xc0, 0x0c, 0x00, 0x01, 0x00,
+	0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 0xc0,
+	0x00, 0x02, 0x51, 0xc0, 0x10, 0x00, 0x02, 0x00,
+	0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x06, 0x03,
+	0x6e, 0x73, 0x32, 0xc0, 0x10, 0xc0, 0x10, 0x00,
+	0x02, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00,
+	0x06, 0x03, 0x6e, 0x73, 0x31, 0xc0, 0x10, 0xc0,
+	0x61, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e,
+	0x10, 0x00, 0x04, 0xc0, 0x00, 0x02, 0x01, 0xc0,
+	0x61, 0x00, 0x1c, 0x00, 0x01, 0x00, 0x00, 0x0e,
+	0x10, 0x00, 0x10, 0x20, 0x01, 0x0d, 0xb8, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x01, 0xc0, 0x4f, 0x00, 0x01, 0x00,
+	0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 0xc0,
+	0x00, 0x02, 0x02, 0xc0, 0x4f, 0x00, 0x1c, 0x00,
+	0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x10, 0x20,
+	0x01, 0x0d, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+	0x00, 0x29, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00,
+};
+
+/*
+ * A query for www.example/A with an address for it and an OPT record
+ * in the additional section.
+ */
+static unsigned char query[] = {
+	0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x02, 0x03, 0x77, 0x77, 0x77,
+	0x07, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+	0x00, 0x00, 0x01, 0x00, 0x01, 0xc0, 0x0c, 0x00,
+	0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00,
+	0x04, 0xc0, 0x00, 0x02, 0x01, 0x00, 0x00, 0x29,
+	0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+#define QUERYOWNER	29	/* the owner name of the address */
+#define QUERYTYPE	32	/* the low octet of its type */
+#define QUERYCLASS	34	/* ... of its class */
+#define QUERYRDLEN	40	/* ... of its rdata length */
+
+#define OPTLEN		11	/* the OPT record at the end */
+#define GLUELEN		88	/* the addresses before it */
+#define ANSWEROWNER	35	/* the owner name of the first answer */
+
+/*
+ * Helper functions
+ */
+
+static isc_result_t
+parse(dns_message_t **msgp, unsigned char *wire, unsigned int length,
+      unsigned int options)
+{
+	isc_buffer_t source;
+	isc_result_t result;
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, msgp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&source, wire, length);
+	isc_buffer_add(&source, length);
+	return (dns_message_parse(*msgp, &source, options));
+}
+
+static void
+totext(dns_message_t *msg, char *text, unsigned int size) {
+	isc_buffer_t target;
+	isc_result_t result;
+
+	isc_buffer_init(&target, text, size - 1);
+	result = dns_message_totext(msg, &dns_master_style_debug, 0, &target);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	text[isc_buffer_usedlength(&target)] = '\0';
+}
+
+/*
+ * Parse 'wire' with and without DNS_MESSAGEPARSE_LAZY and check that
+ * the results print the same.  Return the lazily parsed message.
+ */
+static dns_message_t *
+compare(unsigned char *wire, unsigned int length) {
+	dns_message_t *eager = NULL, *lazy = NULL;
+	isc_result_t result;
+	char text1[4096], text2[4096];
+
+	result = parse(&eager, wire, length, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = parse(&lazy, wire, length, DNS_MESSAGEPARSE_LAZY);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK(lazy->pending[DNS_SECTION_ANSWER] != 0);
+	ATF_CHECK(lazy->pending[DNS_SECTION_AUTHORITY] != 0);
+
+	totext(eager, text1, sizeof(text1));
+	totext(lazy, text2, sizeof(text2));
+	ATF_CHECK_STREQ(text1, text2);
+
+	ATF_CHECK_EQ(lazy->pending[DNS_SECTION_ANSWER], 0);
+	ATF_CHECK_EQ(lazy->pending[DNS_SECTION_AUTHORITY], 0);
+	ATF_CHECK_EQ(lazy->pending[DNS_SECTION_ADDITIONAL], 0);
+
+	dns_message_destroy(&eager);
+	return (lazy);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(lazy);
+ATF_TC_HEAD(lazy, tc) {
+	atf_tc_set_md_var(tc, "descr", "lazily parsed sections are decoded "
+			  "on first use and match a full parse");
+}
+ATF_TC_BODY(lazy, tc) {
+	dns_message_t *msg = NULL;
+	dns_name_t *name;
+	unsigned char wire[sizeof(response)];
+	unsigned int length;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The OPT record at the end is decoded at once, the addresses
+	 * before it are left pending.
+	 */
+	result = parse(&msg, response, sizeof(response),
+		       DNS_MESSAGEPARSE_LAZY);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(msg->opt != NULL);
+	ATF_CHECK(msg->pending[DNS_SECTION_ANSWER] != 0);
+	ATF_CHECK(msg->pending[DNS_SECTION_AUTHORITY] != 0);
+	ATF_CHECK(msg->pending[DNS_SECTION_ADDITIONAL] != 0);
+	ATF_CHECK_EQ(msg->pendingcount[DNS_SECTION_ADDITIONAL], 4);
+
+	result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	name = NULL;
+	dns_message_currentname(msg, DNS_SECTION_ANSWER, &name);
+	ATF_CHECK_EQ(ISC_LIST_HEAD(name->list)->type, dns_rdatatype_a);
+	ATF_CHECK(msg->pending[DNS_SECTION_AUTHORITY] != 0);
+
+	/* A reset drops what was not decoded. */
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	ATF_CHECK_EQ(msg->pending[DNS_SECTION_AUTHORITY], 0);
+	dns_message_destroy(&msg);
+
+	msg = compare(response, sizeof(response));
+	dns_message_destroy(&msg);
+
+	/*
+	 * Without the OPT record the whole additional section is left
+	 * pending.
+	 */
+	length = sizeof(response) - OPTLEN;
+	memmove(wire, response, length);
+	wire[11]--;
+	result = parse(&msg, wire, length, DNS_MESSAGEPARSE_LAZY);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(msg->opt == NULL);
+	ATF_CHECK_EQ(msg->pendingcount[DNS_SECTION_ADDITIONAL], 4);
+	dns_message_destroy(&msg);
+
+	msg = compare(wire, length);
+	dns_message_destroy(&msg);
+
+	/*
+	 * With the OPT record first nothing in the additional section
+	 * is left pending.
+	 */
+	length = sizeof(response) - OPTLEN - GLUELEN;
+	memmove(wire, response, length);
+	memmove(wire + length, response + length + GLUELEN, OPTLEN);
+	memmove(wire + length + OPTLEN, response + length, GLUELEN);
+	result = parse(&msg, wire, sizeof(wire), DNS_MESSAGEPARSE_LAZY);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(msg->opt != NULL);
+	ATF_CHECK_EQ(msg->pending[DNS_SECTION_ADDITIONAL], 0);
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+ATF_TC(lazyerrors);
+ATF_TC_HEAD(lazyerrors, tc) {
+	atf_tc_set_md_var(tc, "descr", "errors in lazily parsed sections are "
+			  "returned on use, truncation at once");
+}
+ATF_TC_BODY(lazyerrors, tc) {
+	dns_message_t *msg = NULL;
+	unsigned char wire[sizeof(response)];
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * A compression pointer past the owner name itself fails the
+	 * parse, lazy or not.
+	 */
+	memmove(wire, response, sizeof(response));
+	wire[ANSWEROWNER + 1] = 0xff;
+
+	result = parse(&msg, wire, sizeof(wire), 0);
+	ATF_CHECK_EQ(result, DNS_R_BADPOINTER);
+	dns_message_destroy(&msg);
+
+	result = parse(&msg, wire, sizeof(wire), DNS_MESSAGEPARSE_LAZY);
+	ATF_CHECK_EQ(result, DNS_R_BADPOINTER);
+	dns_message_destroy(&msg);
+
+	/*
+	 * With DNS_MESSAGEPARSE_BESTEFFORT the same error is recovered
+	 * from the same way.
+	 */
+	memmove(wire, response, sizeof(response));
+	wire[ANSWEROWNER + 5] = 0x00;	/* the first answer in class 0 */
+	result = parse(&msg, wire, sizeof(wire), DNS_MESSAGEPARSE_BESTEFFORT);
+	ATF_CHECK_EQ(result, DNS_R_RECOVERABLE);
+	dns_message_destroy(&msg);
+	result = parse(&msg, wire, sizeof(wire), DNS_MESSAGEPARSE_BESTEFFORT |
+		       DNS_MESSAGEPARSE_LAZY);
+	ATF_CHECK_EQ(result, DNS_R_RECOVERABLE);
+	ATF_CHECK_EQ(msg->pending[DNS_SECTION_ANSWER], 0);
+	result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_message_destroy(&msg);
+
+	/*
+	 * A truncated message fails the parse as it always did.
+	 */
+	result = parse(&msg, response, sizeof(response) - OPTLEN - 1,
+		       DNS_MESSAGEPARSE_LAZY);
+	ATF_CHECK_EQ(result, ISC_R_UNEXPECTEDEND);
+	dns_message_destroy(&msg);
+
+	result = parse(&msg, response, sizeof(response) - OPTLEN - 1,
+		       DNS_MESSAGEPARSE_LAZY |
+		       DNS_MESSAGEPARSE_IGNORETRUNCATION);
+	ATF_CHECK_EQ(result, DNS_R_RECOVERABLE);
+	result = dns_message_firstname(msg, DNS_SECTION_AUTHORITY);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+ATF_TC(lazyquery);
+ATF_TC_HEAD(lazyquery, tc) {
+	atf_tc_set_md_var(tc, "descr", "queries with a corrupt additional "
+			  "section are rejected as by a full parse");
+}
+ATF_TC_BODY(lazyquery, tc) {
+	dns_message_t *eager = NULL, *lazy = NULL;
+	unsigned char wire[sizeof(query)];
+	isc_result_t result, expect;
+	unsigned int i;
+	static const struct {
+		unsigned int offset;
+		unsigned char value;
+	} corrupt[] = {
+		{ QUERYRDLEN, 0x03 },		/* short address */
+		{ QUERYRDLEN, 0x05 },		/* long address */
+		{ QUERYCLASS, 0x03 },		/* class CH */
+		{ QUERYTYPE, 0x05 },		/* CNAME, a singleton */
+		{ QUERYTYPE, 0xfc },		/* AXFR, question only */
+		{ QUERYOWNER + 1, QUERYOWNER },	/* pointer to itself */
+		{ QUERYOWNER, 0x3f },		/* label past the end */
+	};
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Intact, the address is left pending. */
+	result = parse(&lazy, query, sizeof(query), DNS_MESSAGEPARSE_LAZY);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(lazy->opt != NULL);
+	ATF_CHECK_EQ(lazy->pendingcount[DNS_SECTION_ADDITIONAL], 1);
+	dns_message_destroy(&lazy);
+
+	for (i = 0; i < sizeof(corrupt) / sizeof(corrupt[0]); i++) {
+		memmove(wire, query, sizeof(query));
+		wire[corrupt[i].offset] = corrupt[i].value;
+
+		expect = parse(&eager, wire, sizeof(wire), 0);
+		result = parse(&lazy, wire, sizeof(wire),
+			       DNS_MESSAGEPARSE_LAZY);
+		ATF_CHECK_MSG(result == expect, "case %u: %s, expected %s",
+			      i, isc_result_totext(result),
+			      isc_result_totext(expect));
+		ATF_CHECK_MSG(expect != ISC_R_SUCCESS, "case %u parsed", i);
+		dns_message_destroy(&eager);
+		dns_message_destroy(&lazy);
+	}
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, lazy);
+	ATF_TP_ADD_TC(tp, lazyerrors);
+	ATF_TP_ADD_TC(tp, lazyquery);
+
+	return (atf_no_error());
+}
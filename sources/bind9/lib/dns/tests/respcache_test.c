@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/buffer.h>
+#include <isc/netaddr.h>
+#include <isc/string.h>
+
+#include <dns/acl.h>
+#include <dns/db.h>
+#include <dns/respcache.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+static dns_aclenv_t env;
+static isc_netaddr_t source, destination;
+
+static void
+setup(void) {
+	struct in_addr in;
+	isc_result_t result;
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_aclenv_init(mctx, &env);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = htonl(0xc0000201);		/* 192.0.2.1 */
+	isc_netaddr_fromin(&source, &in);
+	in.s_addr = htonl(0xc0000235);		/* 192.0.2.53 */
+	isc_netaddr_fromin(&destination, &in);
+}
+
+static void
+teardown(void) {
+	dns_aclenv_destroy(&env);
+	dns_test_end();
+}
+
+static void
+region(isc_region_t *r, const char *s) {
+	DE_CONST(s, r->base);
+	r->length = strlen(s);
+}
+
+/*
+ * Look up 'key' with room for 'size' bytes, returning the result and
+ * leaving the response, if any, in 'data'.
+ */
+static isc_result_t
+find(dns_respcache_t *cache, const char *key, isc_uint32_t generation,
+     unsigned char *data, unsigned int size, isc_uint32_t *tagp)
+{
+	isc_region_t k;
+	isc_buffer_t b;
+	isc_result_t result;
+	dns_zone_t *zone = NULL;
+
+	region(&k, key);
+	isc_buffer_init(&b, data, size);
+	result = dns_respcache_find(cache, &k, generation, &source,
+				    &destination, &env, &b, &zone, tagp);
+	if (result == ISC_R_SUCCESS) {
+		ATF_REQUIRE(zone == NULL);
+		isc_buffer_putuint8(&b, 0);
+	} else
+		ATF_REQUIRE_EQ(isc_buffer_usedlength(&b), 0);
+	return (result);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(addfind);
+ATF_TC_HEAD(addfind, tc) {
+	atf_tc_set_md_var(tc, "descr", "add and find responses");
+}
+ATF_TC_BODY(addfind, tc) {
+	dns_respcache_t *cache = NULL;
+	isc_region_t key, response;
+	unsigned char data[64];
+	isc_uint32_t tag = 0;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	result = dns_respcache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(find(cache, "a", 1, data, sizeof(data), &tag),
+		     ISC_R_NOTFOUND);
+
+	region(&key, "a");
+	region(&response, "response a");
+	result = dns_respcache_add(cache, &key, 1, &response, NULL, 0,
+				   NULL, 42);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_REQUIRE_EQ(find(cache, "a", 1, data, sizeof(data), &tag),
+		       ISC_R_SUCCESS);
+	ATF_CHECK_STREQ((char *)data, "response a");
+	ATF_CHECK_EQ(tag, 42);
+	ATF_CHECK_EQ(find(cache, "b", 1, data, sizeof(data), &tag),
+		     ISC_R_NOTFOUND);
+
+	/* Too little room. */
+	ATF_CHECK_EQ(find(cache, "a", 1, data, 5, &tag), ISC_R_NOSPACE);
+
+	/* A new response replaces the old one. */
+	region(&response, "second a");
+	result = dns_respcache_add(cache, &key, 1, &response, NULL, 0,
+				   NULL, 43);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(find(cache, "a", 1, data, sizeof(data), &tag),
+		       ISC_R_SUCCESS);
+	ATF_CHECK_STREQ((char *)data, "second a");
+	ATF_CHECK_EQ(tag, 43);
+
+	dns_respcache_detach(&cache);
+	teardown();
+}
+
+ATF_TC(generation);
+ATF_TC_HEAD(generation, tc) {
+	atf_tc_set_md_var(tc, "descr", "responses from older zone data "
+				       "are not used");
+}
+ATF_TC_BODY(generation, tc) {
+	dns_respcache_t *cache = NULL;
+	isc_region_t key, response;
+	unsigned char data[64];
+	isc_uint32_t generation, tag;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	result = dns_respcache_create(mctx, 1, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	generation = dns_db_generation();
+	region(&key, "a");
+	region(&response, "response a");
+	result = dns_respcache_add(cache, &key, generation, &response,
+				   NULL, 0, NULL, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(find(cache, "a", dns_db_generation(), data,
+			  sizeof(data), &tag), ISC_R_SUCCESS);
+
+	dns_db_newgeneration();
+	ATF_CHECK(dns_db_generation() != generation);
+	ATF_CHECK_EQ(find(cache, "a", dns_db_generation(), data,
+			  sizeof(data), &tag), ISC_R_NOTFOUND);
+	/* The stale entry was dropped. */
+	ATF_CHECK_EQ(find(cache, "a", generation, data, sizeof(data), &tag),
+		     ISC_R_NOTFOUND);
+
+	dns_respcache_detach(&cache);
+	teardown();
+}
+
+ATF_TC(conditions);
+ATF_TC_HEAD(conditions, tc) {
+	atf_tc_set_md_var(tc, "descr", "responses are only used for "
+				       "clients with the same ACL outcomes");
+}
+ATF_TC_BODY(conditions, tc) {
+	dns_respcache_t *cache = NULL;
+	dns_respcachecond_t conds[2];
+	dns_acl_t *any = NULL, *none = NULL;
+	isc_region_t key, response;
+	unsigned char data[64];
+	isc_uint32_t tag;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	result = dns_respcache_create(mctx, 16, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_acl_any(mctx, &any);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_acl_none(mctx, &none);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	conds[0].acl = any;
+	conds[0].destination = ISC_FALSE;
+	conds[0].allowed = ISC_TRUE;
+	conds[1].acl = none;
+	conds[1].destination = ISC_TRUE;
+	conds[1].allowed = ISC_FALSE;
+	region(&key, "allowed");
+	region(&response, "allowed");
+	result = dns_respcache_add(cache, &key, 1, &response, conds, 2,
+				   NULL, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	conds[1].allowed = ISC_TRUE;
+	region(&key, "denied");
+	region(&response, "denied");
+	result = dns_respcache_add(cache, &key, 1, &response, conds, 2,
+				   NULL, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* The cache holds its own references. */
+	dns_acl_detach(&any);
+	dns_acl_detach(&none);
+
+	ATF_CHECK_EQ(find(cache, "allowed", 1, data, sizeof(data), &tag),
+		     ISC_R_SUCCESS);
+	ATF_CHECK_EQ(find(cache, "denied", 1, data, sizeof(data), &tag),
+		     ISC_R_NOTFOUND);
+
+	dns_respcache_detach(&cache);
+	teardown();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, addfind);
+	ATF_TP_ADD_TC(tp, generation);
+	ATF_TP_ADD_TC(tp, conditions);
+
+	return (atf_no_error());
+}
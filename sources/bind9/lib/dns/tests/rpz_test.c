@@ -0,0 +1,712 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/histo.h>
+#include <isc/mem.h>
+#include <isc/net.h>
+#include <isc/netaddr.h>
+#include <isc/string.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rpz.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+#define ORIGIN	"rpz.example."
+
+/*
+ * Allocations from the summary memory context fail while this is set.
+ */
+static isc_boolean_t failing = ISC_FALSE;
+
+static void *
+failalloc(void *arg, size_t size) {
+	UNUSED(arg);
+
+	if (failing)
+		return (NULL);
+	return (malloc(size));
+}
+
+static void
+failfree(void *arg, void *ptr) {
+	UNUSED(arg);
+
+	free(ptr);
+}
+
+static dns_name_t *
+str2name(dns_fixedname_t *fixed, const char *str) {
+	isc_result_t result;
+	dns_name_t *name;
+
+	dns_fixedname_init(fixed);
+	name = dns_fixedname_name(fixed);
+	result = dns_name_fromstring(name, str, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (name);
+}
+
+static dns_rpz_cidr_t *
+newcidr(void) {
+	dns_fixedname_t fixed;
+	dns_rpz_cidr_t *cidr = NULL;
+	isc_result_t result;
+
+	result = dns_rpz_new_cidr(mctx, str2name(&fixed, ORIGIN), &cidr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (cidr);
+}
+
+static void
+add(dns_rpz_cidr_t *cidr, const char *str) {
+	dns_fixedname_t fixed;
+
+	dns_rpz_cidr_addip(cidr, str2name(&fixed, str));
+	dns_rpz_cidr_publish(cidr);
+}
+
+static void
+delete(dns_rpz_cidr_t *cidr, const char *str) {
+	dns_fixedname_t fixed;
+
+	dns_rpz_cidr_deleteip(cidr, str2name(&fixed, str));
+	dns_rpz_cidr_publish(cidr);
+}
+
+/*
+ * Look in the snapshot of a summary that a new query would use.
+ */
+static dns_rpz_zbits_t
+names(dns_rpz_summary_t *summary, dns_rpz_type_t type, const char *str) {
+	dns_rpz_snapshot_t *snapshot = NULL;
+	dns_fixedname_t fixed;
+	dns_rpz_zbits_t zbits;
+
+	dns_rpz_summary_current(summary, &snapshot);
+	zbits = dns_rpz_snapshot_names(snapshot, type, str2name(&fixed, str));
+	dns_rpz_snapshot_detach(&snapshot);
+	return (zbits);
+}
+
+static dns_rpz_zbits_t
+ipv4(dns_rpz_summary_t *summary, dns_rpz_type_t type, isc_uint32_t addr) {
+	dns_rpz_snapshot_t *snapshot = NULL;
+	isc_netaddr_t netaddr;
+	struct in_addr ina;
+	dns_rpz_zbits_t zbits;
+
+	ina.s_addr = htonl(addr);
+	isc_netaddr_fromin(&netaddr, &ina);
+	dns_rpz_summary_current(summary, &snapshot);
+	zbits = dns_rpz_snapshot_ip(snapshot, type, &netaddr);
+	dns_rpz_snapshot_detach(&snapshot);
+	return (zbits);
+}
+
+static void
+enabled(dns_rpz_summary_t *summary, dns_rpz_zbits_t zbits,
+	dns_rpz_st_t *st)
+{
+	dns_rpz_snapshot_t *snapshot = NULL;
+
+	memset(st, 0, sizeof(*st));
+	dns_rpz_summary_current(summary, &snapshot);
+	dns_rpz_snapshot_enabled(snapshot, zbits, st);
+	dns_rpz_snapshot_detach(&snapshot);
+}
+
+/*
+ * Add or delete the "CNAME ." policy of a name in a new version.
+ */
+static void
+update(dns_db_t *db, dns_dbversion_t *version, const char *str,
+       isc_boolean_t adding)
+{
+	static unsigned char root = 0;
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	result = dns_db_findnode(db, str2name(&fixed, str), ISC_TRUE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	if (adding) {
+		rdata.data = &root;
+		rdata.length = 1;
+		rdata.rdclass = dns_rdataclass_in;
+		rdata.type = dns_rdatatype_cname;
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_cname;
+		rdatalist.ttl = 300;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+		dns_rdataset_init(&rdataset);
+		result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_db_addrdataset(db, node, version, 0, &rdataset,
+					    0, NULL);
+		dns_rdataset_disassociate(&rdataset);
+	} else
+		result = dns_db_deleterdataset(db, node, version,
+					       dns_rdatatype_cname, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(names);
+ATF_TC_HEAD(names, tc) {
+	atf_tc_set_md_var(tc, "descr", "QNAME and NSDNAME triggers are "
+			  "summarized");
+}
+ATF_TC_BODY(names, tc) {
+	dns_rpz_summary_t *summary = NULL;
+	dns_rpz_cidr_t *cidr;
+	dns_rpz_st_t st;
+	isc_result_t result;
+	const dns_rpz_zbits_t bit = DNS_RPZ_ZBIT(3);
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rpz_summary_create(mctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cidr = newcidr();
+	dns_rpz_cidr_setsummary(cidr, summary, 3);
+
+	add(cidr, "Bad.Example." ORIGIN);
+	add(cidr, "*.wild.example." ORIGIN);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "bad.example."), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "BAD.EXAMPLE."), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "a.bad.example."), 0);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "example."), 0);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_NSDNAME, "bad.example."), 0);
+
+	/* Wildcards match only below their parents. */
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME,
+			   "a.b.wild.example."), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "wild.example."), 0);
+
+	/* The apex is a trigger for the root. */
+	add(cidr, ORIGIN);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "."), bit);
+	delete(cidr, ORIGIN);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "."), 0);
+
+	delete(cidr, "bad.example." ORIGIN);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "bad.example."), 0);
+
+	enabled(summary, DNS_RPZ_ALL_ZBITS, &st);
+	ATF_CHECK_EQ(st.state & DNS_RPZ_HAVE_NSDNAME, 0);
+
+#ifdef ENABLE_RPZ_NSDNAME
+	add(cidr, "ns.evil.rpz-nsdname." ORIGIN);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_NSDNAME, "ns.evil."), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_NSDNAME, "evil."), 0);
+	enabled(summary, bit, &st);
+	ATF_CHECK((st.state & DNS_RPZ_HAVE_NSDNAME) != 0);
+	enabled(summary, ~bit, &st);
+	ATF_CHECK_EQ(st.state & DNS_RPZ_HAVE_NSDNAME, 0);
+#endif
+
+	dns_rpz_cidr_free(&cidr);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME,
+			   "a.b.wild.example."), 0);
+	dns_rpz_summary_detach(&summary);
+	dns_test_end();
+}
+
+ATF_TC(addresses);
+ATF_TC_HEAD(addresses, tc) {
+	atf_tc_set_md_var(tc, "descr", "IP and NSIP triggers are "
+			  "summarized by prefix");
+}
+ATF_TC_BODY(addresses, tc) {
+	dns_rpz_summary_t *summary = NULL;
+	dns_rpz_cidr_t *cidr;
+	dns_rpz_st_t st;
+	isc_result_t result;
+	const dns_rpz_zbits_t bit = DNS_RPZ_ZBIT(0);
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rpz_summary_create(mctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cidr = newcidr();
+	dns_rpz_cidr_setsummary(cidr, summary, 0);
+
+	add(cidr, "24.0.2.0.192.rpz-ip." ORIGIN);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), bit);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc00002ff), bit);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000301), 0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_NSIP, 0xc0000201), 0);
+
+	/* The IP trigger names are QNAME triggers too. */
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME,
+			   "24.0.2.0.192.rpz-ip."), bit);
+
+	enabled(summary, bit, &st);
+	ATF_CHECK((st.state & DNS_RPZ_HAVE_IP) != 0);
+	ATF_CHECK_EQ(st.state & (DNS_RPZ_HAVE_NSIPv4 | DNS_RPZ_HAVE_NSIPv6), 0);
+
+	add(cidr, "32.1.2.0.192.rpz-ip." ORIGIN);
+	delete(cidr, "24.0.2.0.192.rpz-ip." ORIGIN);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), bit);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000202), 0);
+	delete(cidr, "32.1.2.0.192.rpz-ip." ORIGIN);
+	enabled(summary, bit, &st);
+	ATF_CHECK_EQ(st.state & DNS_RPZ_HAVE_IP, 0);
+
+#ifdef ENABLE_RPZ_NSIP
+	add(cidr, "16.0.0.1.10.rpz-nsip." ORIGIN);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_NSIP, 0x0a011234), bit);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a011234), 0);
+	add(cidr, "48.zz.db8.2001.rpz-nsip." ORIGIN);
+	enabled(summary, bit, &st);
+	ATF_CHECK((st.state & DNS_RPZ_HAVE_NSIPv4) != 0);
+	ATF_CHECK((st.state & DNS_RPZ_HAVE_NSIPv6) != 0);
+#endif
+
+	dns_rpz_cidr_free(&cidr);
+	dns_rpz_summary_detach(&summary);
+	dns_test_end();
+}
+
+ATF_TC(contributors);
+ATF_TC_HEAD(contributors, tc) {
+	atf_tc_set_md_var(tc, "descr", "databases can share and move "
+			  "between summaries");
+}
+ATF_TC_BODY(contributors, tc) {
+	dns_rpz_summary_t *summary = NULL, *next = NULL;
+	dns_rpz_cidr_t *old, *new;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rpz_summary_create(mctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* The old and new databases of a zone being reloaded. */
+	old = newcidr();
+	dns_rpz_cidr_setsummary(old, summary, 1);
+	add(old, "gone.example." ORIGIN);
+	add(old, "kept.example." ORIGIN);
+	new = newcidr();
+	dns_rpz_cidr_setsummary(new, summary, 1);
+	add(new, "kept.example." ORIGIN);
+	dns_rpz_cidr_free(&old);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "gone.example."), 0);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "kept.example."),
+		     DNS_RPZ_ZBIT(1));
+
+	/* A reconfiguration moves the database to a new summary. */
+	result = dns_rpz_summary_create(mctx, &next);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rpz_cidr_setsummary(new, next, 2);
+	ATF_CHECK_EQ(names(next, DNS_RPZ_TYPE_QNAME, "kept.example."),
+		     DNS_RPZ_ZBIT(2));
+	ATF_CHECK_EQ(names(next, DNS_RPZ_TYPE_QNAME, "gone.example."), 0);
+
+	/* The old summary no longer skips only the zone that moved. */
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "gone.example."),
+		     DNS_RPZ_ZBIT(1));
+	dns_rpz_summary_detach(&summary);
+
+	/* Later policy zones are not summarized. */
+	dns_rpz_cidr_setsummary(new, next, DNS_RPZ_SUMMARY_ZONES);
+	ATF_CHECK(!DNS_RPZ_SUMMARY_MISS(0, DNS_RPZ_SUMMARY_ZONES));
+
+	dns_rpz_cidr_free(&new);
+	dns_rpz_summary_detach(&next);
+	dns_test_end();
+}
+
+ATF_TC(database);
+ATF_TC_HEAD(database, tc) {
+	atf_tc_set_md_var(tc, "descr", "policy zone databases report their "
+			  "names when loaded and changed");
+}
+ATF_TC_BODY(database, tc) {
+	dns_rpz_summary_t *summary = NULL;
+	dns_fixedname_t fixed;
+	dns_dbversion_t *version = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+	const dns_rpz_zbits_t bit = DNS_RPZ_ZBIT(0);
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rpz_summary_create(mctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", str2name(&fixed, ORIGIN),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_rpz_enabled(db, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_rpz_setsummary(db, summary, 0);
+	result = dns_db_load(db, "testdata/rpz/rpz.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "wild.example."), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "a.wild.example."),
+		     bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "b.x.example."), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "x.example."), 0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), bit);
+
+	/* The empty node gets data in an update. */
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	update(db, version, "x.example." ORIGIN, ISC_TRUE);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "x.example."), bit);
+
+	dns_db_detach(&db);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "wild.example."), 0);
+	dns_rpz_summary_detach(&summary);
+	dns_test_end();
+}
+
+ATF_TC(commit);
+ATF_TC_HEAD(commit, tc) {
+	atf_tc_set_md_var(tc, "descr", "updates change the triggers of a "
+			  "policy zone when they are committed");
+}
+ATF_TC_BODY(commit, tc) {
+	dns_rpz_summary_t *summary = NULL;
+	isc_histo_t *histo = NULL;
+	isc_uint64_t buckets[ISC_HISTO_BUCKETS];
+	isc_uint64_t count;
+	dns_fixedname_t fixed;
+	dns_dbversion_t *version = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+	const dns_rpz_zbits_t bit = DNS_RPZ_ZBIT(3);
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rpz_summary_create(mctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_histo_create(mctx, 1, &histo);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rpz_summary_setupdatehisto(summary, histo);
+	ATF_CHECK_EQ(dns_rpz_summary_getupdatehisto(summary), histo);
+
+	result = dns_db_create(mctx, "rbt", str2name(&fixed, ORIGIN),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_rpz_enabled(db, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_rpz_setsummary(db, summary, 3);
+	result = dns_db_load(db, "testdata/rpz/rpz.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), bit);
+
+	/*
+	 * Replace one address trigger with another, as an IXFR would.
+	 * Nothing changes until the version is committed.
+	 */
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	update(db, version, "32.1.2.0.192.rpz-ip." ORIGIN, ISC_FALSE);
+	update(db, version, "24.0.100.51.198.rpz-ip." ORIGIN, ISC_TRUE);
+	update(db, version, "new.example." ORIGIN, ISC_TRUE);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), bit);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc6336407), 0);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "new.example."), 0);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), 0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc6336407), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "new.example."), bit);
+
+	/* A rolled back version changes nothing. */
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	update(db, version, "new.example." ORIGIN, ISC_FALSE);
+	update(db, version, "32.1.2.0.192.rpz-ip." ORIGIN, ISC_TRUE);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), 0);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "new.example."), bit);
+
+	/* Only the committed update was timed. */
+	isc_histo_merge(histo, buckets, &count);
+	ATF_CHECK_EQ(count, 1);
+
+	dns_db_detach(&db);
+	isc_histo_detach(&histo);
+	dns_rpz_summary_detach(&summary);
+	dns_test_end();
+}
+
+ATF_TC(ranges);
+ATF_TC_HEAD(ranges, tc) {
+	atf_tc_set_md_var(tc, "descr", "nested and adjacent address "
+			  "triggers of several zones are found");
+}
+ATF_TC_BODY(ranges, tc) {
+	dns_rpz_summary_t *summary = NULL;
+	dns_rpz_cidr_t *cidr0, *cidr1;
+	isc_result_t result;
+	const dns_rpz_zbits_t bit0 = DNS_RPZ_ZBIT(0), bit1 = DNS_RPZ_ZBIT(1);
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rpz_summary_create(mctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	cidr0 = newcidr();
+	dns_rpz_cidr_setsummary(cidr0, summary, 0);
+	cidr1 = newcidr();
+	dns_rpz_cidr_setsummary(cidr1, summary, 1);
+
+	add(cidr0, "8.0.0.0.10.rpz-ip." ORIGIN);
+	add(cidr0, "32.5.1.0.10.rpz-ip." ORIGIN);
+	add(cidr1, "24.0.1.0.10.rpz-ip." ORIGIN);
+	add(cidr1, "24.0.2.0.10.rpz-ip." ORIGIN);
+	add(cidr1, "32.255.255.255.255.rpz-ip." ORIGIN);
+
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x09ffffff), 0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000000), bit0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a0000ff), bit0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000100),
+		     bit0 | bit1);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000105),
+		     bit0 | bit1);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000106),
+		     bit0 | bit1);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a0002ff),
+		     bit0 | bit1);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000300), bit0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0affffff), bit0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0b000000), 0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xfffffffe), 0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xffffffff), bit1);
+
+	/* The block of the other zone ends where its last trigger does. */
+	delete(cidr1, "24.0.2.0.10.rpz-ip." ORIGIN);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a0001ff),
+		     bit0 | bit1);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000200), bit0);
+
+	/* The same block in both zones. */
+	add(cidr1, "8.0.0.0.10.rpz-ip." ORIGIN);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000300),
+		     bit0 | bit1);
+	dns_rpz_cidr_free(&cidr0);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000300), bit1);
+
+	dns_rpz_cidr_free(&cidr1);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000300), 0);
+	dns_rpz_summary_detach(&summary);
+	dns_test_end();
+}
+
+ATF_TC(snapshot);
+ATF_TC_HEAD(snapshot, tc) {
+	atf_tc_set_md_var(tc, "descr", "queries keep their snapshot of "
+			  "the summary until they look for a new one");
+}
+ATF_TC_BODY(snapshot, tc) {
+	dns_rpz_summary_t *summary = NULL;
+	dns_rpz_snapshot_t *snapshot = NULL, *first;
+	dns_rpz_cidr_t *cidr;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result;
+	const dns_rpz_zbits_t bit = DNS_RPZ_ZBIT(5);
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rpz_summary_create(mctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Nothing is skipped before the zones have been loaded. */
+	dns_rpz_summary_current(summary, &snapshot);
+	name = str2name(&fixed, "a.example.");
+	ATF_CHECK_EQ(dns_rpz_snapshot_names(snapshot, DNS_RPZ_TYPE_QNAME,
+					    name), DNS_RPZ_ALL_ZBITS);
+
+	cidr = newcidr();
+	dns_rpz_cidr_setsummary(cidr, summary, 5);
+	add(cidr, "a.example." ORIGIN);
+	ATF_CHECK_EQ(dns_rpz_snapshot_names(snapshot, DNS_RPZ_TYPE_QNAME,
+					    name), DNS_RPZ_ALL_ZBITS);
+	dns_rpz_summary_current(summary, &snapshot);
+	ATF_CHECK_EQ(dns_rpz_snapshot_names(snapshot, DNS_RPZ_TYPE_QNAME,
+					    name), bit);
+
+	/* An unchanged summary keeps its snapshot. */
+	first = snapshot;
+	dns_rpz_cidr_publish(cidr);
+	dns_rpz_summary_current(summary, &snapshot);
+	ATF_CHECK_EQ(snapshot, first);
+
+	/* Unchanged parts of a snapshot are still found in the next. */
+	add(cidr, "b.example." ORIGIN);
+	ATF_CHECK_EQ(dns_rpz_snapshot_names(snapshot, DNS_RPZ_TYPE_QNAME,
+			str2name(&fixed, "b.example.")), 0);
+	dns_rpz_summary_current(summary, &snapshot);
+	ATF_CHECK_EQ(dns_rpz_snapshot_names(snapshot, DNS_RPZ_TYPE_QNAME,
+			str2name(&fixed, "b.example.")), bit);
+	ATF_CHECK_EQ(dns_rpz_snapshot_names(snapshot, DNS_RPZ_TYPE_QNAME,
+			str2name(&fixed, "a.example.")), bit);
+
+	dns_rpz_summary_current(NULL, &snapshot);
+	ATF_CHECK_EQ(snapshot, NULL);
+	dns_rpz_cidr_free(&cidr);
+	dns_rpz_summary_detach(&summary);
+	dns_test_end();
+}
+
+ATF_TC(recovery);
+ATF_TC_HEAD(recovery, tc) {
+	atf_tc_set_md_var(tc, "descr", "a summary that runs out of memory "
+			  "searches the zone until it has all its triggers");
+}
+ATF_TC_BODY(recovery, tc) {
+	dns_rpz_summary_t *summary = NULL;
+	dns_rpz_cidr_t *cidr;
+	dns_fixedname_t fixed;
+	dns_dbversion_t *version = NULL;
+	dns_db_t *db = NULL;
+	isc_mem_t *fmctx = NULL;
+	isc_result_t result;
+	const dns_rpz_zbits_t bit = DNS_RPZ_ZBIT(2);
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_mem_createx2(0, 0, failalloc, failfree, NULL, &fmctx, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rpz_summary_create(fmctx, &summary);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* A trigger that was not recorded makes the zone unknown. */
+	cidr = newcidr();
+	dns_rpz_cidr_setsummary(cidr, summary, 2);
+	failing = ISC_TRUE;
+	dns_rpz_cidr_addip(cidr, str2name(&fixed, "a.example." ORIGIN));
+	failing = ISC_FALSE;
+	ATF_CHECK(dns_rpz_cidr_incomplete(cidr));
+	dns_rpz_cidr_publish(cidr);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "miss.example."),
+		     bit);
+	result = dns_rpz_cidr_summarize(cidr,
+					str2name(&fixed, "a.example." ORIGIN));
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_rpz_cidr_summarized(cidr);
+	ATF_CHECK(!dns_rpz_cidr_incomplete(cidr));
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "miss.example."), 0);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "a.example."), bit);
+	dns_rpz_cidr_free(&cidr);
+
+	/*
+	 * A database loaded without memory for the summary or a snapshot
+	 * reports its triggers again with its next update.
+	 */
+	result = dns_db_create(mctx, "rbt", str2name(&fixed, ORIGIN),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_rpz_enabled(db, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_rpz_setsummary(db, summary, 2);
+	failing = ISC_TRUE;
+	result = dns_db_load(db, "testdata/rpz/rpz.data");
+	failing = ISC_FALSE;
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "miss.example."),
+		     DNS_RPZ_ALL_ZBITS);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000001),
+		     DNS_RPZ_ALL_ZBITS);
+
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	update(db, version, "new.example." ORIGIN, ISC_TRUE);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "miss.example."), 0);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "new.example."), bit);
+	ATF_CHECK_EQ(names(summary, DNS_RPZ_TYPE_QNAME, "a.wild.example."),
+		     bit);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0xc0000201), bit);
+	ATF_CHECK_EQ(ipv4(summary, DNS_RPZ_TYPE_IP, 0x0a000001), 0);
+
+	dns_db_detach(&db);
+	dns_rpz_summary_detach(&summary);
+	isc_mem_destroy(&fmctx);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, names);
+	ATF_TP_ADD_TC(tp, addresses);
+	ATF_TP_ADD_TC(tp, contributors);
+	ATF_TP_ADD_TC(tp, database);
+	ATF_TP_ADD_TC(tp, commit);
+	ATF_TP_ADD_TC(tp, ranges);
+	ATF_TP_ADD_TC(tp, snapshot);
+	ATF_TP_ADD_TC(tp, recovery);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/mutex.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dlz.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/sdlz.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+/*%
+ * A driver serving "example" with an address for "www" and one with a
+ * zero TTL for "zero", and "other" with an address for "www".  It
+ * counts the lookups that reach it from the test and, separately, from
+ * the cache's refresh threads.
+ */
+static isc_mutex_t lock;
+static unsigned long self;
+static int lookups;		/* locked by lock */
+static int refreshes;		/* locked by lock */
+static int version;
+
+static int
+count(int *counter) {
+	int value;
+
+	LOCK(&lock);
+	value = *counter;
+	UNLOCK(&lock);
+	return (value);
+}
+
+static isc_result_t
+test_create(const char *dlzname, unsigned int argc, char *argv[],
+	    void *driverarg, void **dbdata)
+{
+	UNUSED(dlzname);
+	UNUSED(argc);
+	UNUSED(argv);
+	UNUSED(driverarg);
+
+	*dbdata = &lookups;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+test_findzone(void *driverarg, void *dbdata, const char *name) {
+	UNUSED(driverarg);
+	UNUSED(dbdata);
+
+	if (strcmp(name, "example") == 0 || strcmp(name, "other") == 0)
+		return (ISC_R_SUCCESS);
+	return (ISC_R_NOTFOUND);
+}
+
+static isc_result_t
+test_lookup(const char *zone, const char *name, void *driverarg,
+	    void *dbdata, dns_sdlzlookup_t *lookup,
+	    dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo)
+{
+	UNUSED(zone);
+	UNUSED(driverarg);
+	UNUSED(dbdata);
+	UNUSED(methods);
+	UNUSED(clientinfo);
+
+	if (strcmp(name, "*") == 0)
+		return (ISC_R_NOTFOUND);
+	LOCK(&lock);
+	if ((unsigned long)isc_thread_self() == self)
+		lookups++;
+	else
+		refreshes++;
+	UNLOCK(&lock);
+	if (strcmp(name, "www.example") == 0 ||
+	    strcmp(name, "www.other") == 0)
+		return (dns_sdlz_putrr(lookup, "a", 300, "192.0.2.1"));
+	if (strcmp(name, "zero.example") == 0)
+		return (dns_sdlz_putrr(lookup, "a", 0, "192.0.2.2"));
+	return (ISC_R_NOTFOUND);
+}
+
+static isc_result_t
+test_newversion(const char *zone, void *driverarg, void *dbdata,
+		void **versionp)
+{
+	UNUSED(zone);
+	UNUSED(driverarg);
+	UNUSED(dbdata);
+
+	*versionp = &version;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+test_closeversion(const char *zone, isc_boolean_t commit, void *driverarg,
+		  void *dbdata, void **versionp)
+{
+	UNUSED(zone);
+	UNUSED(commit);
+	UNUSED(driverarg);
+	UNUSED(dbdata);
+
+	*versionp = NULL;
+}
+
+static dns_sdlzmethods_t test_methods = {
+	test_create,
+	NULL,			/* destroy */
+	test_findzone,
+	test_lookup,
+	NULL,			/* authority */
+	NULL,			/* allnodes */
+	NULL,			/* allowzonexfr */
+	test_newversion,
+	test_closeversion,
+	NULL,			/* configure */
+	NULL,			/* ssumatch */
+	NULL,			/* addrdataset */
+	NULL,			/* subtractrdataset */
+	NULL			/* delrdataset */
+};
+
+static dns_sdlzimplementation_t *imp = NULL;
+static dns_dlzdb_t *dlzdb = NULL;
+
+/*%
+ * Open the database of the zone 'originstr'.
+ */
+static void
+opendb(const char *originstr, dns_db_t **dbp) {
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	origin = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(origin, originstr, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_sdlz_setdb(dlzdb, dns_rdataclass_in, origin, dbp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+setup(dns_ttl_t maxttl, dns_ttl_t maxncachettl, unsigned int threads,
+      dns_db_t **dbp)
+{
+	char *argv[] = { NULL };
+	isc_result_t result;
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	self = (unsigned long)isc_thread_self();
+	lookups = 0;
+	refreshes = 0;
+
+	result = dns_sdlzregister("test", &test_methods, NULL, 0, mctx, &imp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	DE_CONST("test", argv[0]);
+	result = dns_dlzcreate(mctx, "test", "test", 1, argv, &dlzdb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_sdlz_setcache(dlzdb, maxttl, maxncachettl, 0, threads);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	opendb("example.", dbp);
+}
+
+static void
+teardown(dns_db_t **dbp) {
+	dns_db_detach(dbp);
+	dns_dlzdestroy(&dlzdb);
+	dns_sdlzunregister(&imp);
+	DESTROYLOCK(&lock);
+	dns_test_end();
+}
+
+/*%
+ * Wait for the clock to reach the second 'when', or the start of the
+ * next second if 'when' is 0, and return it.
+ */
+static isc_stdtime_t
+waitfor(isc_stdtime_t when) {
+	isc_stdtime_t now, start;
+
+	isc_stdtime_get(&start);
+	if (when == 0)
+		when = start + 1;
+	for (now = start; now < when; isc_stdtime_get(&now))
+		dns_test_nap(10000);
+	return (now);
+}
+
+/*%
+ * Look up the address of 'namestr', returning its TTL in '*ttlp'.
+ */
+static isc_result_t
+lookup(dns_db_t *db, const char *namestr, dns_ttl_t *ttlp) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, namestr, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnode(db, name, ISC_FALSE, &node);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_a, 0, 0,
+				     &rdataset, NULL);
+	if (result == ISC_R_SUCCESS) {
+		ATF_CHECK_EQ(dns_rdataset_count(&rdataset), 1);
+		if (ttlp != NULL)
+			*ttlp = rdataset.ttl;
+		dns_rdataset_disassociate(&rdataset);
+	}
+	dns_db_detachnode(db, &node);
+	return (result);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(hit);
+ATF_TC_HEAD(hit, tc) {
+	atf_tc_set_md_var(tc, "descr", "answers are served from the cache "
+			  "with their TTL capped");
+}
+ATF_TC_BODY(hit, tc) {
+	dns_db_t *db = NULL;
+	dns_ttl_t ttl = 0;
+
+	UNUSED(tc);
+
+	setup(60, 60, 0, &db);
+
+	ATF_CHECK_EQ(lookup(db, "www.example.", &ttl), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(ttl, 300);
+	ATF_CHECK_EQ(count(&lookups), 1);
+	ATF_CHECK_EQ(lookup(db, "WWW.Example.", &ttl), ISC_R_SUCCESS);
+	ATF_CHECK(ttl <= 60 && ttl > 0);
+	ATF_CHECK_EQ(count(&lookups), 1);
+
+	/* A zero TTL is never cached. */
+	ATF_CHECK_EQ(lookup(db, "zero.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "zero.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count(&lookups), 3);
+
+	teardown(&db);
+}
+
+ATF_TC(negative);
+ATF_TC_HEAD(negative, tc) {
+	atf_tc_set_md_var(tc, "descr", "names the driver does not have are "
+			  "cached for max-ncache-ttl");
+}
+ATF_TC_BODY(negative, tc) {
+	dns_db_t *db = NULL;
+
+	UNUSED(tc);
+
+	setup(60, 60, 0, &db);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(count(&lookups), 1);
+	teardown(&db);
+
+	setup(60, 0, 0, &db);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(count(&lookups), 2);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count(&lookups), 3);
+	teardown(&db);
+}
+
+ATF_TC(flush);
+ATF_TC_HEAD(flush, tc) {
+	atf_tc_set_md_var(tc, "descr", "flushing and committed updates "
+			  "drop cached answers");
+}
+ATF_TC_BODY(flush, tc) {
+	dns_db_t *db = NULL, *other = NULL;
+	dns_dbversion_t *ver = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup(60, 60, 0, &db);
+
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(count(&lookups), 2);
+
+	/* By name. */
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, "WWW.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sdlz_flushcache(dlzdb, name), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(count(&lookups), 3);
+
+	/* Everything. */
+	ATF_CHECK_EQ(dns_sdlz_flushcache(dlzdb, NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(count(&lookups), 5);
+
+	/* A rolled back update leaves the cache alone... */
+	result = dns_db_newversion(db, &ver);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &ver, ISC_FALSE);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count(&lookups), 5);
+
+	/* ...and a committed one empties it of that zone only. */
+	opendb("other.", &other);
+	ATF_CHECK_EQ(lookup(other, "www.other.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count(&lookups), 6);
+	result = dns_db_newversion(db, &ver);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &ver, ISC_TRUE);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(lookup(db, "none.example.", NULL), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(count(&lookups), 8);
+	ATF_CHECK_EQ(lookup(other, "www.other.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count(&lookups), 8);
+
+	dns_db_detach(&other);
+	teardown(&db);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+ATF_TC(refresh);
+ATF_TC_HEAD(refresh, tc) {
+	atf_tc_set_md_var(tc, "descr", "answers asked for late in their life "
+			  "are looked up again in the background");
+}
+ATF_TC_BODY(refresh, tc) {
+	dns_db_t *db = NULL;
+	isc_stdtime_t stored, now;
+	int i;
+
+	UNUSED(tc);
+
+	setup(4, 4, 2, &db);
+
+	/*
+	 * Store the entry just after a second begins so that it is known
+	 * to have been stored in that second, then hit it at the start of
+	 * its last second, where only a refresh can reach the driver.
+	 */
+	stored = waitfor(0);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+	ATF_REQUIRE_EQ(now, stored);
+	ATF_CHECK_EQ(count(&lookups), 1);
+
+	waitfor(stored + 3);
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+	ATF_REQUIRE_EQ(now, stored + 3);
+	ATF_CHECK_EQ(count(&lookups), 1);
+	for (i = 0; i < 500 && count(&refreshes) == 0; i++)
+		dns_test_nap(10000);
+	ATF_CHECK_EQ(count(&refreshes), 1);
+
+	/* The entry is not refreshed again while the first is pending. */
+	ATF_CHECK_EQ(lookup(db, "www.example.", NULL), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count(&lookups), 1);
+	ATF_CHECK_EQ(count(&refreshes), 1);
+
+	/* Shutting down with the threads idle must not hang. */
+	teardown(&db);
+}
+#endif
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, hit);
+	ATF_TP_ADD_TC(tp, negative);
+	ATF_TP_ADD_TC(tp, flush);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, refresh);
+#endif
+
+	return (atf_no_error());
+}
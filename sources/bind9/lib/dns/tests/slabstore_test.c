@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/string.h>
+#include <isc/thread.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/slabstore.h>
+
+#include "dnstest.h"
+
+#define NTHREADS	4
+#define COUNT		5000
+
+/*
+ * Helper functions
+ */
+
+static dns_db_t *
+loaddb(dns_slabstore_t *store, const char *origin) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_db_t *db = NULL;
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), origin, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", dns_fixedname_name(&fixed),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_setslabstore(db, store);
+	result = dns_db_load(db, "testdata/dbiterator/zone1.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (db);
+}
+
+/*
+ * Return the number of TXT records at 'owner' in the current version.
+ */
+static unsigned int
+counttxt(dns_db_t *db, const char *owner) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	unsigned int count;
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring2(dns_fixedname_name(&fixed), owner,
+				      dns_db_origin(db), 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), ISC_FALSE,
+				 &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_txt, 0, 0,
+				     &rdataset, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	count = dns_rdataset_count(&rdataset);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+	return (count);
+}
+
+/*
+ * Add or remove the TXT record "more" at 'owner'.
+ */
+static void
+changetxt(dns_db_t *db, const char *owner, isc_boolean_t add) {
+	static unsigned char more[] = { 4, 'm', 'o', 'r', 'e' };
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_region_t r;
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring2(dns_fixedname_name(&fixed), owner,
+				      dns_db_origin(db), 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), ISC_FALSE,
+				 &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	r.base = more;
+	r.length = sizeof(more);
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_txt, &r);
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_txt;
+	rdatalist.ttl = 600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	if (add)
+		result = dns_db_addrdataset(db, node, version, 0, &rdataset,
+					    DNS_DBADD_MERGE, NULL);
+	else
+		result = dns_db_subtractrdataset(db, node, version, &rdataset,
+						 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+}
+
+/*
+ * Intern and release each of the slabs 0 to COUNT - 1 in turn.
+ */
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+churn(void *arg) {
+	dns_slabstore_t *store = arg;
+	unsigned char buf[4], *s;
+	isc_result_t result;
+	unsigned int i;
+
+	for (i = 0; i < COUNT; i++) {
+		memmove(buf, &i, sizeof(buf));
+		s = NULL;
+		result = dns_slabstore_intern(store, buf, sizeof(buf), &s);
+		if (result == ISC_R_SUCCESS)
+			dns_slabstore_release(store, &s);
+	}
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(intern);
+ATF_TC_HEAD(intern, tc) {
+	atf_tc_set_md_var(tc, "descr", "equal slabs share one copy until "
+			  "the last reference is released");
+}
+ATF_TC_BODY(intern, tc) {
+	static const unsigned char slab1[] = { 0, 1, 0, 4, 10, 0, 0, 1 };
+	static const unsigned char slab2[] = { 0, 1, 0, 4, 10, 0, 0, 2 };
+	unsigned char copy[sizeof(slab1)];
+	unsigned char *s1 = NULL, *s2 = NULL, *s3 = NULL;
+	dns_slabstore_t *store = NULL;
+	dns_slabstorestats_t stats;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_slabstore_create(mctx, &store);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	memmove(copy, slab1, sizeof(copy));
+	result = dns_slabstore_intern(store, slab1, sizeof(slab1), &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_slabstore_intern(store, copy, sizeof(copy), &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_slabstore_intern(store, slab2, sizeof(slab2), &s3);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK(s1 == s2);
+	ATF_CHECK(s1 != s3);
+	ATF_CHECK(s1 != slab1 && s1 != copy);
+	ATF_CHECK(memcmp(s1, slab1, sizeof(slab1)) == 0);
+	ATF_CHECK(memcmp(s3, slab2, sizeof(slab2)) == 0);
+
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK_EQ(stats.lookups, 3);
+	ATF_CHECK_EQ(stats.hits, 1);
+	ATF_CHECK_EQ(stats.entries, 2);
+	ATF_CHECK_EQ(stats.references, 3);
+	ATF_CHECK_EQ(stats.bytes, sizeof(slab1) + sizeof(slab2));
+	ATF_CHECK_EQ(stats.saved, sizeof(slab1));
+
+	dns_slabstore_release(store, &s1);
+	ATF_CHECK(s1 == NULL);
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK_EQ(stats.entries, 2);
+	ATF_CHECK_EQ(stats.saved, 0);
+	ATF_CHECK(memcmp(s2, slab1, sizeof(slab1)) == 0);
+
+	dns_slabstore_release(store, &s2);
+	dns_slabstore_release(store, &s3);
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK_EQ(stats.entries, 0);
+	ATF_CHECK_EQ(stats.references, 0);
+	ATF_CHECK_EQ(stats.bytes, 0);
+
+	dns_slabstore_detach(&store);
+	dns_test_end();
+}
+
+ATF_TC(grow);
+ATF_TC_HEAD(grow, tc) {
+	atf_tc_set_md_var(tc, "descr", "slabs stay reachable while the "
+			  "table grows");
+}
+ATF_TC_BODY(grow, tc) {
+	static unsigned char *slabs[5000];
+	unsigned char buf[4], *s;
+	dns_slabstore_t *store = NULL;
+	dns_slabstorestats_t stats;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_slabstore_create(mctx, &store);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < sizeof(slabs) / sizeof(slabs[0]); i++) {
+		memmove(buf, &i, sizeof(buf));
+		result = dns_slabstore_intern(store, buf, sizeof(buf),
+					      &slabs[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < sizeof(slabs) / sizeof(slabs[0]); i++) {
+		memmove(buf, &i, sizeof(buf));
+		s = NULL;
+		result = dns_slabstore_intern(store, buf, sizeof(buf), &s);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(s == slabs[i]);
+		dns_slabstore_release(store, &s);
+	}
+
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK_EQ(stats.entries, sizeof(slabs) / sizeof(slabs[0]));
+	ATF_CHECK_EQ(stats.hits, sizeof(slabs) / sizeof(slabs[0]));
+
+	for (i = 0; i < sizeof(slabs) / sizeof(slabs[0]); i++)
+		dns_slabstore_release(store, &slabs[i]);
+	dns_slabstore_detach(&store);
+	dns_test_end();
+}
+
+ATF_TC(threads);
+ATF_TC_HEAD(threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "slabs interned and released by "
+			  "several threads at once");
+}
+ATF_TC_BODY(threads, tc) {
+	static unsigned char *slabs[COUNT];
+	unsigned char buf[4];
+	dns_slabstore_t *store = NULL;
+	dns_slabstorestats_t stats;
+	isc_result_t result;
+	unsigned int i, nthreads = 1;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t threads[NTHREADS];
+#endif
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_slabstore_create(mctx, &store);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Hold a reference to each slab so that every lookup hits. */
+	for (i = 0; i < COUNT; i++) {
+		memmove(buf, &i, sizeof(buf));
+		result = dns_slabstore_intern(store, buf, sizeof(buf),
+					      &slabs[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+#ifdef ISC_PLATFORM_USETHREADS
+	nthreads = NTHREADS;
+	for (i = 0; i < nthreads; i++) {
+		result = isc_thread_create(churn, store, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(threads[i], NULL);
+#else
+	(void)churn(store);
+#endif
+
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK_EQ(stats.lookups, (nthreads + 1) * COUNT);
+	ATF_CHECK_EQ(stats.hits, nthreads * COUNT);
+	ATF_CHECK_EQ(stats.entries, COUNT);
+	ATF_CHECK_EQ(stats.references, COUNT);
+	ATF_CHECK_EQ(stats.saved, 0);
+
+	for (i = 0; i < COUNT; i++)
+		dns_slabstore_release(store, &slabs[i]);
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK_EQ(stats.entries, 0);
+	ATF_CHECK_EQ(stats.bytes, 0);
+	dns_slabstore_detach(&store);
+	dns_test_end();
+}
+
+ATF_TC(sharedb);
+ATF_TC_HEAD(sharedb, tc) {
+	atf_tc_set_md_var(tc, "descr", "zone databases share rdata and "
+			  "updates to one do not show in the other");
+}
+ATF_TC_BODY(sharedb, tc) {
+	dns_slabstore_t *store = NULL;
+	dns_slabstorestats_t stats;
+	dns_db_t *db1, *db2;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_slabstore_create(mctx, &store);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	db1 = loaddb(store, "test");
+	db2 = loaddb(store, "example");
+
+	/*
+	 * Every TXT "test" RRset and the A RRsets are shared, within a
+	 * database as well as between the two.
+	 */
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK(stats.entries > 0);
+	ATF_CHECK(stats.hits >= 17);
+	ATF_CHECK(stats.saved > 0);
+
+	changetxt(db1, "a", ISC_TRUE);
+	ATF_CHECK_EQ(counttxt(db1, "a"), 2);
+	ATF_CHECK_EQ(counttxt(db1, "b"), 1);
+	ATF_CHECK_EQ(counttxt(db2, "a"), 1);
+
+	changetxt(db1, "a", ISC_FALSE);
+	ATF_CHECK_EQ(counttxt(db1, "a"), 1);
+	ATF_CHECK_EQ(counttxt(db2, "a"), 1);
+
+	dns_db_detach(&db1);
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK(stats.entries > 0);
+	ATF_CHECK_EQ(counttxt(db2, "k"), 1);
+
+	dns_db_detach(&db2);
+	dns_slabstore_getstats(store, &stats);
+	ATF_CHECK_EQ(stats.entries, 0);
+	ATF_CHECK_EQ(stats.references, 0);
+
+	dns_slabstore_detach(&store);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, intern);
+	ATF_TP_ADD_TC(tp, grow);
+	ATF_TP_ADD_TC(tp, threads);
+	ATF_TP_ADD_TC(tp, sharedb);
+
+	return (atf_no_error());
+}
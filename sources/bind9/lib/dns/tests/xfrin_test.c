@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/event.h>
+#include <isc/hash.h>
+#include <isc/lex.h>
+#include <isc/sockaddr.h>
+#include <isc/string.h>
+#include <isc/task.h>
+#include <isc/thread.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/xfrin.h>
+#include <dns/zone.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+#define SOA	"ns.example. hostmaster.example. 1 3600 600 86400 300"
+#define SIG(c, t) \
+	c " 8 2 300 20300101000000 20000101000000 " t " example. AAAA"
+
+typedef struct {
+	const char *owner;
+	dns_rdatatype_t type;
+	const char *text;
+} xfrrecord_t;
+
+/*
+ * The transfer, in two messages.  RRsets are split by a record of
+ * another name, by a message boundary and by an RRSIG of another
+ * covered type; all of these must end up in the right RRset.
+ */
+static xfrrecord_t message1[] = {
+	{ "example.", dns_rdatatype_soa, SOA },
+	{ "example.", dns_rdatatype_ns, "ns.example." },
+	{ "a.example.", dns_rdatatype_a, "10.0.0.1" },
+	{ "a.example.", dns_rdatatype_a, "10.0.0.2" },
+	{ "a.example.", dns_rdatatype_rrsig, SIG("A", "1") },
+	{ "a.example.", dns_rdatatype_rrsig, SIG("TXT", "2") },
+	{ NULL, 0, NULL }
+};
+
+static xfrrecord_t message2[] = {
+	{ "a.example.", dns_rdatatype_rrsig, SIG("TXT", "3") },
+	{ "a.example.", dns_rdatatype_txt, "\"text\"" },
+	{ "b.example.", dns_rdatatype_a, "10.0.0.3" },
+	{ "a.example.", dns_rdatatype_a, "10.0.0.3" },
+	{ "ns.example.", dns_rdatatype_a, "10.0.0.53" },
+	{ "example.", dns_rdatatype_soa, SOA },
+	{ NULL, 0, NULL }
+};
+
+static int listener = -1;
+static isc_sockaddr_t masteraddr;
+static dns_zone_t *zone = NULL;
+static dns_xfrin_ctx_t *xfr = NULL;
+static isc_result_t xfrresult;
+static isc_boolean_t xfrdone;
+static isc_boolean_t taskdone;
+static dns_db_t *db = NULL;
+
+/*
+ * The RRsets the transfer must produce.
+ */
+static struct {
+	const char *owner;
+	dns_rdatatype_t type;
+	dns_rdatatype_t covers;
+	unsigned int expect;
+	unsigned int found;
+} rrsets[] = {
+	{ "example.", dns_rdatatype_soa, 0, 1, 0 },
+	{ "example.", dns_rdatatype_ns, 0, 1, 0 },
+	{ "a.example.", dns_rdatatype_a, 0, 3, 0 },
+	{ "a.example.", dns_rdatatype_txt, 0, 1, 0 },
+	{ "a.example.", dns_rdatatype_rrsig, dns_rdatatype_a, 1, 0 },
+	{ "a.example.", dns_rdatatype_rrsig, dns_rdatatype_txt, 2, 0 },
+	{ "b.example.", dns_rdatatype_a, 0, 1, 0 },
+	{ "ns.example.", dns_rdatatype_a, 0, 1, 0 },
+	{ NULL, 0, 0, 0, 0 }
+};
+
+static void
+putrecord(isc_buffer_t *b, const xfrrecord_t *record) {
+	dns_fixedname_t fixed;
+	isc_buffer_t source;
+	isc_lex_t *lex = NULL;
+	unsigned char *rdlen;
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	isc_buffer_constinit(&source, record->owner, strlen(record->owner));
+	isc_buffer_add(&source, strlen(record->owner));
+	result = dns_name_fromtext(dns_fixedname_name(&fixed), &source,
+				   dns_rootname, 0, b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_putuint16(b, record->type);
+	isc_buffer_putuint16(b, dns_rdataclass_in);
+	isc_buffer_putuint32(b, 300);
+	rdlen = isc_buffer_used(b);
+	isc_buffer_putuint16(b, 0);
+
+	result = isc_lex_create(mctx, 64, &lex);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_constinit(&source, record->text, strlen(record->text));
+	isc_buffer_add(&source, strlen(record->text));
+	result = isc_lex_openbuffer(lex, &source);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rdata_fromtext(NULL, dns_rdataclass_in, record->type,
+				    lex, dns_rootname, 0, mctx, b, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_lex_destroy(&lex);
+
+	rdlen[0] = ((unsigned char *)isc_buffer_used(b) - rdlen - 2) >> 8;
+	rdlen[1] = ((unsigned char *)isc_buffer_used(b) - rdlen - 2) & 0xff;
+}
+
+/*
+ * Send 'records' as one response to the query in 'query', with the
+ * question only in the first message.
+ */
+static void
+sendmessage(int fd, const unsigned char *query, size_t qlen,
+	    const xfrrecord_t *records, isc_boolean_t first)
+{
+	unsigned char data[4096];
+	isc_buffer_t b;
+	unsigned int count = 0;
+	const xfrrecord_t *record;
+	ssize_t n;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	isc_buffer_putuint16(&b, 0);			/* length */
+	isc_buffer_putmem(&b, query, 2);		/* id */
+	isc_buffer_putuint16(&b, 0x8400);		/* QR, AA */
+	isc_buffer_putuint16(&b, first ? 1 : 0);
+	for (record = records; record->owner != NULL; record++)
+		count++;
+	isc_buffer_putuint16(&b, count);
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putuint16(&b, 0);
+	if (first)
+		isc_buffer_putmem(&b, query + 12, qlen - 12);
+	for (record = records; record->owner != NULL; record++)
+		putrecord(&b, record);
+
+	data[0] = (isc_buffer_usedlength(&b) - 2) >> 8;
+	data[1] = (isc_buffer_usedlength(&b) - 2) & 0xff;
+	n = write(fd, data, isc_buffer_usedlength(&b));
+	ATF_REQUIRE_EQ(n, (ssize_t)isc_buffer_usedlength(&b));
+}
+
+/*
+ * A master that answers one AXFR query.
+ */
+static isc_threadresult_t
+master(isc_threadarg_t arg) {
+	unsigned char query[512];
+	size_t qlen, len;
+	ssize_t n;
+	int fd;
+
+	UNUSED(arg);
+
+	fd = accept(listener, NULL, NULL);
+	ATF_REQUIRE(fd >= 0);
+	for (len = 0; len < 2; len += n) {
+		n = read(fd, query + len, 2 - len);
+		ATF_REQUIRE(n > 0);
+	}
+	qlen = (query[0] << 8) | query[1];
+	ATF_REQUIRE(qlen > 12 && qlen <= sizeof(query));
+	for (len = 0; len < qlen; len += n) {
+		n = read(fd, query + len, qlen - len);
+		ATF_REQUIRE(n > 0);
+	}
+
+	/* Only the question; the query has no other sections. */
+	ATF_REQUIRE_EQ(query[5], 1);
+	ATF_REQUIRE_EQ(query[7] | query[9] | query[11], 0);
+
+	sendmessage(fd, query, qlen, message1, ISC_TRUE);
+	sendmessage(fd, query, qlen, message2, ISC_FALSE);
+	close(fd);
+
+	return ((isc_threadresult_t)0);
+}
+
+static unsigned int
+count(const char *owner, dns_rdatatype_t type, dns_rdatatype_t covers) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	isc_buffer_t source;
+	isc_result_t result;
+	unsigned int n = 0;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	isc_buffer_constinit(&source, owner, strlen(owner));
+	isc_buffer_add(&source, strlen(owner));
+	result = dns_name_fromtext(name, &source, dns_rootname, 0, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (0);
+
+	result = dns_db_findnode(db, name, ISC_FALSE, &node);
+	if (result != ISC_R_SUCCESS)
+		return (0);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, NULL, type, covers, 0,
+				     &rdataset, NULL);
+	if (result == ISC_R_SUCCESS) {
+		n = dns_rdataset_count(&rdataset);
+		dns_rdataset_disassociate(&rdataset);
+	}
+	dns_db_detachnode(db, &node);
+	return (n);
+}
+
+/*
+ * The library globals are per-thread in this port, so the transfer
+ * runs on a single worker thread which gets a hash table of its own,
+ * and the database it built is searched from that thread too.  As in
+ * the zone code, the transfer is started and released in its task.
+ */
+static void
+hash_create(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	if (isc_hash_create(mctx, ectx, DNS_NAME_MAXWIRE) == ISC_R_SUCCESS)
+		taskdone = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static void
+hash_destroy(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_hash_destroy();
+	taskdone = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static void
+xfrin_done(dns_zone_t *xfrzone, isc_result_t result) {
+	UNUSED(xfrzone);
+
+	dns_xfrin_detach(&xfr);
+	xfrresult = result;
+	xfrdone = ISC_TRUE;
+}
+
+static void
+xfrin_start(isc_task_t *task, isc_event_t *event) {
+	isc_result_t result;
+
+	result = dns_xfrin_create(zone, dns_rdatatype_axfr, &masteraddr,
+				  NULL, mctx, timermgr, socketmgr, task,
+				  xfrin_done, &xfr);
+	if (result != ISC_R_SUCCESS) {
+		xfrresult = result;
+		xfrdone = ISC_TRUE;
+	}
+	taskdone = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static void
+lookup(isc_task_t *task, isc_event_t *event) {
+	unsigned int i;
+
+	UNUSED(task);
+
+	for (i = 0; rrsets[i].owner != NULL; i++)
+		rrsets[i].found = count(rrsets[i].owner, rrsets[i].type,
+					rrsets[i].covers);
+	taskdone = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static isc_boolean_t
+runintask(isc_task_t *task, isc_taskaction_t action) {
+	isc_event_t *event;
+	int i;
+
+	taskdone = ISC_FALSE;
+	event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+				   action, NULL, sizeof(*event));
+	if (event == NULL)
+		return (ISC_FALSE);
+	isc_task_send(task, &event);
+	for (i = 0; i < 500 && !taskdone; i++)
+		dns_test_nap(10000);
+	return (taskdone);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(axfr);
+ATF_TC_HEAD(axfr, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "AXFR records are batched into the right RRsets");
+}
+ATF_TC_BODY(axfr, tc) {
+	struct sockaddr_in sin;
+	socklen_t sinlen = sizeof(sin);
+	dns_fixedname_t fixed;
+	isc_buffer_t source;
+	isc_taskmgr_t *xfrtaskmgr = NULL;
+	isc_task_t *task = NULL;
+	isc_thread_t thread;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	ATF_REQUIRE(listener >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ATF_REQUIRE_EQ(bind(listener, (struct sockaddr *)&sin, sizeof(sin)),
+		       0);
+	ATF_REQUIRE_EQ(listen(listener, 1), 0);
+	ATF_REQUIRE_EQ(getsockname(listener, (struct sockaddr *)&sin,
+				   &sinlen), 0);
+	isc_sockaddr_fromin(&masteraddr, &sin.sin_addr, ntohs(sin.sin_port));
+	result = isc_thread_create(master, NULL, &thread);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zone_create(&zone, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_fixedname_init(&fixed);
+	isc_buffer_constinit(&source, "example.", 8);
+	isc_buffer_add(&source, 8);
+	result = dns_name_fromtext(dns_fixedname_name(&fixed), &source,
+				   dns_rootname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_setorigin(zone, dns_fixedname_name(&fixed));
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_zone_settype(zone, dns_zone_slave);
+	dns_zone_setclass(zone, dns_rdataclass_in);
+
+	result = isc_taskmgr_create(mctx, 1, 0, &xfrtaskmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_task_create(xfrtaskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(runintask(task, hash_create));
+
+	xfrdone = ISC_FALSE;
+	ATF_REQUIRE(runintask(task, xfrin_start));
+	for (i = 0; i < 500 && !xfrdone; i++)
+		dns_test_nap(10000);
+	ATF_REQUIRE(xfrdone);
+	ATF_REQUIRE_EQ(xfrresult, ISC_R_SUCCESS);
+	isc_thread_join(thread, NULL);
+	close(listener);
+
+	result = dns_zone_getdb(zone, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	/* Even a first transfer builds its database in its own context. */
+	ATF_CHECK(db->mctx != mctx);
+	ATF_REQUIRE(runintask(task, lookup));
+	for (i = 0; rrsets[i].owner != NULL; i++)
+		ATF_CHECK_EQ_MSG(rrsets[i].found, rrsets[i].expect,
+				 "%s/%u/%u: %u records", rrsets[i].owner,
+				 rrsets[i].type, rrsets[i].covers,
+				 rrsets[i].found);
+	dns_db_detach(&db);
+
+	dns_zone_detach(&zone);
+	ATF_REQUIRE(runintask(task, hash_destroy));
+	isc_task_detach(&task);
+	isc_taskmgr_destroy(&xfrtaskmgr);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, axfr);
+
+	return (atf_no_error());
+}
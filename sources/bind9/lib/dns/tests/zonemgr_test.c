@@ -25,6 +25,7 @@
 #include <unistd.h>
 
 #include <isc/buffer.h>
+#include <isc/sockaddr.h>
 #include <isc/task.h>
 #include <isc/timer.h>
 
@@ -150,6 +151,64 @@ ATF_TC_BODY(zonemgr_createzone, tc) {
 	dns_test_end();
 }
 
+ATF_TC(zonemgr_sources);
+ATF_TC_HEAD(zonemgr_sources, tc) {
+	atf_tc_set_md_var(tc, "descr", "zones share equal source addresses");
+}
+ATF_TC_BODY(zonemgr_sources, tc) {
+	dns_zone_t *zone1 = NULL, *zone2 = NULL;
+	isc_sockaddr_t addr, any, src;
+	struct in_addr in;
+	isc_result_t result;
+	size_t inuse;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zone_create(&zone1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_create(&zone2, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_sockaddr_any(&any);
+	src = dns_zone_getxfrsource4(zone1);
+	ATF_CHECK(isc_sockaddr_equal(&src, &any));
+
+	in.s_addr = inet_addr("10.53.0.1");
+	isc_sockaddr_fromin(&addr, &in, 5300);
+	result = dns_zone_setxfrsource4(zone1, &addr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	src = dns_zone_getxfrsource4(zone1);
+	ATF_CHECK(isc_sockaddr_equal(&src, &addr));
+	src = dns_zone_getxfrsource4(zone2);
+	ATF_CHECK(isc_sockaddr_equal(&src, &any));
+
+	/* The second zone shares the first one's copy. */
+	inuse = isc_mem_inuse(mctx);
+	result = dns_zone_setxfrsource4(zone2, &addr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_mem_inuse(mctx), inuse);
+	src = dns_zone_getxfrsource4(zone2);
+	ATF_CHECK(isc_sockaddr_equal(&src, &addr));
+
+	/* Changing one zone leaves the other alone. */
+	result = dns_zone_setnotifysrc4(zone1, &addr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	src = dns_zone_getnotifysrc4(zone1);
+	ATF_CHECK(isc_sockaddr_equal(&src, &addr));
+	src = dns_zone_getnotifysrc4(zone2);
+	ATF_CHECK(isc_sockaddr_equal(&src, &any));
+	src = dns_zone_getxfrsource4(zone2);
+	ATF_CHECK(isc_sockaddr_equal(&src, &addr));
+
+	dns_zone_detach(&zone1);
+	dns_zone_detach(&zone2);
+
+	dns_test_end();
+}
+
 ATF_TC(zonemgr_unreachable);
 ATF_TC_HEAD(zonemgr_unreachable, tc) {
 	atf_tc_set_md_var(tc, "descr", "manage and release a zone");
@@ -234,6 +293,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, zonemgr_create);
 	ATF_TP_ADD_TC(tp, zonemgr_managezone);
 	ATF_TP_ADD_TC(tp, zonemgr_createzone);
+	ATF_TP_ADD_TC(tp, zonemgr_sources);
 	ATF_TP_ADD_TC(tp, zonemgr_unreachable);
 	return (atf_no_error());
 }
@@ -23,6 +23,7 @@
 
 #include <isc/file.h>
 #include <isc/hash.h>
+#include <isc/histo.h>
 #include <isc/print.h>
 #include <isc/sha2.h>
 #include <isc/stats.h>
@@ -34,6 +35,7 @@
 #include <dns/acl.h>
 #include <dns/adb.h>
 #include <dns/cache.h>
+#include <dns/capture.h>
 #include <dns/db.h>
 #include <dns/dispatch.h>
 #include <dns/dlz.h>
@@ -54,6 +56,7 @@
 #include <dns/rdataset.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/stats.h>
@@ -154,6 +157,10 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->rootexclude = NULL;
 	view->resstats = NULL;
 	view->resquerystats = NULL;
+	view->latencyhisto = NULL;
+	view->capture = NULL;
+	view->capturetypes = 0;
+	view->respcache = NULL;
 	view->cacheshared = ISC_FALSE;
 	ISC_LIST_INIT(view->dns64);
 	view->dns64cnt = 0;
@@ -199,6 +206,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->v4_aaaa = dns_v4_aaaa_ok;
 	view->v4_aaaa_acl = NULL;
 	ISC_LIST_INIT(view->rpz_zones);
+	view->rpz_summary = NULL;
 	view->rpz_recursive_only = ISC_TRUE;
 	view->rpz_break_dnssec = ISC_FALSE;
 	dns_fixedname_init(&view->dlv_fixed);
@@ -346,6 +354,7 @@ destroy(dns_view_t *view) {
 #else /* BIND9 */
 	INSIST(view->acache == NULL);
 	INSIST(ISC_LIST_EMPTY(view->rpz_zones));
+	INSIST(view->rpz_summary == NULL);
 	INSIST(view->rrl == NULL);
 #endif /* BIND9 */
 	if (view->requestmgr != NULL)
@@ -437,6 +446,10 @@ destroy(dns_view_t *view) {
 		isc_stats_detach(&view->resstats);
 	if (view->resquerystats != NULL)
 		dns_stats_detach(&view->resquerystats);
+	if (view->latencyhisto != NULL)
+		isc_histo_detach(&view->latencyhisto);
+	if (view->capture != NULL)
+		dns_capture_detach(&view->capture);
 	if (view->secroots_priv != NULL)
 		dns_keytable_detach(&view->secroots_priv);
 #ifdef BIND9
@@ -500,11 +513,14 @@ view_flushanddetach(dns_view_t **viewp, isc_boolean_t flush) {
 		view->flush = ISC_TRUE;
 	isc_refcount_decrement(&view->references, &refs);
 	if (refs == 0) {
+		dns_respcache_t *respcache;
 #ifdef BIND9
 		dns_zone_t *mkzone = NULL, *rdzone = NULL;
 #endif
 
 		LOCK(&view->lock);
+		respcache = view->respcache;
+		view->respcache = NULL;
 		if (!RESSHUTDOWN(view))
 			dns_resolver_shutdown(view->resolver);
 		if (!ADBSHUTDOWN(view))
@@ -534,6 +550,10 @@ view_flushanddetach(dns_view_t **viewp, isc_boolean_t flush) {
 		done = all_done(view);
 		UNLOCK(&view->lock);
 
+		/* The cached responses hold zone references too. */
+		if (respcache != NULL)
+			dns_respcache_detach(&respcache);
+
 #ifdef BIND9
 		/* Need to detach zones outside view lock */
 		if (mkzone != NULL)
@@ -1791,6 +1811,46 @@ dns_view_getresquerystats(dns_view_t *view, dns_stats_t **statsp) {
 		dns_stats_attach(view->resquerystats, statsp);
 }
 
+void
+dns_view_setlatencyhisto(dns_view_t *view, isc_histo_t *histo) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+	REQUIRE(view->latencyhisto == NULL);
+
+	isc_histo_attach(histo, &view->latencyhisto);
+}
+
+void
+dns_view_getlatencyhisto(dns_view_t *view, isc_histo_t **histop) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(histop != NULL && *histop == NULL);
+
+	if (view->latencyhisto != NULL)
+		isc_histo_attach(view->latencyhisto, histop);
+}
+
+void
+dns_view_setcapture(dns_view_t *view, dns_capture_t *capture,
+		    unsigned int types)
+{
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+	REQUIRE(view->capture == NULL);
+	REQUIRE(types != 0);
+
+	dns_capture_attach(capture, &view->capture);
+	view->capturetypes = types;
+}
+
+void
+dns_view_setrespcache(dns_view_t *view, dns_respcache_t *respcache) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+	REQUIRE(view->respcache == NULL);
+
+	dns_respcache_attach(respcache, &view->respcache);
+}
+
 isc_result_t
 dns_view_initsecroots(dns_view_t *view, isc_mem_t *mctx) {
 	REQUIRE(DNS_VIEW_VALID(view));
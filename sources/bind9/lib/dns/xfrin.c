@@ -164,6 +164,18 @@ struct dns_xfrin_ctx {
 	struct {
 		dns_addrdatasetfunc_t add_func;
 		dns_dbload_t	      *add_private;
+		isc_mem_t	      *dbmctx;	/*%< Arena of the new db */
+		/*%
+		 * The RRset currently being accumulated.  Records are
+		 * handed to the database one RRset at a time, in the
+		 * order they arrive on the wire.
+		 */
+		dns_fixedname_t	      name;
+		dns_rdatalist_t	      rdl;
+		dns_rdata_t	      *rdatas;
+		unsigned int	      nrdatas;
+		unsigned int	      maxrdatas;
+		isc_buffer_t	      *rdatabuf;
 	} axfr;
 
 	struct {
@@ -174,6 +186,20 @@ struct dns_xfrin_ctx {
 	} ixfr;
 };
 
+/*%
+ * Every AXFR builds the new database in a memory context of its own, so
+ * that the memory can be accounted for and is handed back in full when
+ * the database is freed.  The context grows with the transfer itself:
+ * it takes each allocation straight from malloc(), unless the zone being
+ * replaced had at least this many nodes, in which case it carves them
+ * out of large chunks of its own.
+ *
+ * The database being replaced stays loaded, and keeps answering queries,
+ * until the transfer commits, so peak memory during an AXFR is still
+ * roughly that of both copies of the zone.
+ */
+#define XFRIN_ARENA_NODES	  10000
+
 #define XFRIN_MAGIC		  ISC_MAGIC('X', 'f', 'r', 'I')
 #define VALID_XFRIN(x)		  ISC_MAGIC_VALID(x, XFRIN_MAGIC)
 
@@ -202,7 +228,7 @@ static isc_result_t axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp);
 static isc_result_t axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 				   dns_name_t *name, dns_ttl_t ttl,
 				   dns_rdata_t *rdata);
-static isc_result_t axfr_apply(dns_xfrin_ctx_t *xfr);
+static isc_result_t axfr_flush(dns_xfrin_ctx_t *xfr);
 static isc_result_t axfr_commit(dns_xfrin_ctx_t *xfr);
 static isc_result_t axfr_finalize(dns_xfrin_ctx_t *xfr);
 
@@ -253,11 +279,35 @@ xfrin_log(dns_xfrin_ctx_t *xfr, int level, const char *fmt, ...)
 static isc_result_t
 axfr_init(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
+	unsigned int nodes = 0;
 
 	xfr->is_ixfr = ISC_FALSE;
 
-	if (xfr->db != NULL)
+	if (xfr->db != NULL) {
+		nodes = dns_db_nodecount(xfr->db);
 		dns_db_detach(&xfr->db);
+	}
+
+	if (xfr->axfr.dbmctx != NULL)
+		isc_mem_detach(&xfr->axfr.dbmctx);
+	if (nodes >= XFRIN_ARENA_NODES)
+		CHECK(isc_mem_create(0, 0, &xfr->axfr.dbmctx));
+	else
+		CHECK(isc_mem_create2(1, 0, &xfr->axfr.dbmctx, 0));
+	isc_mem_setname(xfr->axfr.dbmctx, "xfrin", NULL);
+
+	if (xfr->axfr.rdatas == NULL) {
+		xfr->axfr.rdatas = isc_mem_get(xfr->mctx,
+					       16 * sizeof(dns_rdata_t));
+		if (xfr->axfr.rdatas == NULL)
+			FAIL(ISC_R_NOMEMORY);
+		xfr->axfr.maxrdatas = 16;
+	}
+	if (xfr->axfr.rdatabuf == NULL)
+		CHECK(isc_buffer_allocate(xfr->mctx, &xfr->axfr.rdatabuf,
+					  4096));
+	xfr->axfr.nrdatas = 0;
+	isc_buffer_clear(xfr->axfr.rdatabuf);
 
 	CHECK(axfr_makedb(xfr, &xfr->db));
 	CHECK(dns_db_beginload(xfr->db, &xfr->axfr.add_func,
@@ -271,7 +321,10 @@ static isc_result_t
 axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp) {
 	isc_result_t result;
 
-	result = dns_db_create(xfr->mctx, /* XXX */
+	isc_mem_t *mctx;
+
+	mctx = (xfr->axfr.dbmctx != NULL) ? xfr->axfr.dbmctx : xfr->mctx;
+	result = dns_db_create(mctx, /* XXX */
 			       "rbt",	/* XXX guess */
 			       &xfr->name,
 			       dns_dbtype_zone,
@@ -280,39 +333,133 @@ axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp) {
 			       dbp);
 	if (result == ISC_R_SUCCESS)
 		result = dns_zone_rpz_enable_db(xfr->zone, *dbp);
+	if (result == ISC_R_SUCCESS)
+		dns_zone_sharedb(xfr->zone, *dbp);
 	return (result);
 }
 
+/*
+ * Make room for another rdata of 'length' bytes in the current RRset.
+ */
+static isc_result_t
+axfr_reserve(dns_xfrin_ctx_t *xfr, unsigned int length) {
+	isc_buffer_t *buf = NULL;
+	unsigned char *oldbase;
+	dns_rdata_t *rdatas;
+	unsigned int i, size;
+	isc_result_t result;
+
+	if (xfr->axfr.nrdatas == xfr->axfr.maxrdatas) {
+		size = xfr->axfr.maxrdatas * 2;
+		rdatas = isc_mem_get(xfr->mctx, size * sizeof(dns_rdata_t));
+		if (rdatas == NULL)
+			return (ISC_R_NOMEMORY);
+		memcpy(rdatas, xfr->axfr.rdatas,
+		       xfr->axfr.nrdatas * sizeof(dns_rdata_t));
+		isc_mem_put(xfr->mctx, xfr->axfr.rdatas,
+			    xfr->axfr.maxrdatas * sizeof(dns_rdata_t));
+		xfr->axfr.rdatas = rdatas;
+		xfr->axfr.maxrdatas = size;
+	}
+
+	if (isc_buffer_availablelength(xfr->axfr.rdatabuf) >= length)
+		return (ISC_R_SUCCESS);
+
+	size = isc_buffer_length(xfr->axfr.rdatabuf) * 2;
+	while (size - isc_buffer_usedlength(xfr->axfr.rdatabuf) < length)
+		size *= 2;
+	result = isc_buffer_allocate(xfr->mctx, &buf, size);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	oldbase = isc_buffer_base(xfr->axfr.rdatabuf);
+	isc_buffer_putmem(buf, oldbase,
+			  isc_buffer_usedlength(xfr->axfr.rdatabuf));
+	for (i = 0; i < xfr->axfr.nrdatas; i++)
+		xfr->axfr.rdatas[i].data = (unsigned char *)isc_buffer_base(buf)
+			+ (xfr->axfr.rdatas[i].data - oldbase);
+	isc_buffer_free(&xfr->axfr.rdatabuf);
+	xfr->axfr.rdatabuf = buf;
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 	     dns_name_t *name, dns_ttl_t ttl, dns_rdata_t *rdata)
 {
 	isc_result_t result;
+	dns_rdatatype_t covers;
+	dns_rdata_t *copy;
 
-	dns_difftuple_t *tuple = NULL;
+	REQUIRE(op == DNS_DIFFOP_ADD);
 
 	CHECK(dns_zone_checknames(xfr->zone, name, rdata));
-	CHECK(dns_difftuple_create(xfr->diff.mctx, op,
-				   name, ttl, rdata, &tuple));
-	dns_diff_append(&xfr->diff, &tuple);
-	if (++xfr->difflen > 100)
-		CHECK(axfr_apply(xfr));
+
+	/*
+	 * Records of one RRset are normally sent back to back; hand the
+	 * accumulated RRset to the database as soon as that run ends.
+	 */
+	covers = (rdata->type == dns_rdatatype_rrsig) ?
+		 dns_rdata_covers(rdata) : 0;
+	if (xfr->axfr.nrdatas != 0 &&
+	    (xfr->axfr.rdl.type != rdata->type ||
+	     xfr->axfr.rdl.covers != covers ||
+	     !dns_name_equal(name, dns_fixedname_name(&xfr->axfr.name))))
+		CHECK(axfr_flush(xfr));
+
+	if (xfr->axfr.nrdatas == 0) {
+		CHECK(dns_name_copy(name, dns_fixedname_name(&xfr->axfr.name),
+				    NULL));
+		dns_rdatalist_init(&xfr->axfr.rdl);
+		xfr->axfr.rdl.type = rdata->type;
+		xfr->axfr.rdl.covers = covers;
+		xfr->axfr.rdl.rdclass = rdata->rdclass;
+		xfr->axfr.rdl.ttl = ttl;
+	}
+
+	CHECK(axfr_reserve(xfr, rdata->length));
+	copy = &xfr->axfr.rdatas[xfr->axfr.nrdatas++];
+	dns_rdata_init(copy);
+	copy->data = isc_buffer_used(xfr->axfr.rdatabuf);
+	copy->length = rdata->length;
+	copy->rdclass = rdata->rdclass;
+	copy->type = rdata->type;
+	copy->flags = rdata->flags;
+	isc_buffer_putmem(xfr->axfr.rdatabuf, rdata->data, rdata->length);
 	result = ISC_R_SUCCESS;
  failure:
 	return (result);
 }
 
 /*
- * Store a set of AXFR RRs in the database.
+ * Store the accumulated RRset in the database.
  */
 static isc_result_t
-axfr_apply(dns_xfrin_ctx_t *xfr) {
+axfr_flush(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
-
-	CHECK(dns_diff_load(&xfr->diff,
-			    xfr->axfr.add_func, xfr->axfr.add_private));
-	xfr->difflen = 0;
-	dns_diff_clear(&xfr->diff);
+	dns_rdataset_t rds;
+	unsigned int i;
+
+	if (xfr->axfr.nrdatas == 0)
+		return (ISC_R_SUCCESS);
+
+	ISC_LIST_INIT(xfr->axfr.rdl.rdata);
+	for (i = 0; i < xfr->axfr.nrdatas; i++)
+		ISC_LIST_APPEND(xfr->axfr.rdl.rdata, &xfr->axfr.rdatas[i],
+				link);
+
+	dns_rdataset_init(&rds);
+	CHECK(dns_rdatalist_tordataset(&xfr->axfr.rdl, &rds));
+	rds.trust = dns_trust_ultimate;
+	result = (*xfr->axfr.add_func)(xfr->axfr.add_private,
+				       dns_fixedname_name(&xfr->axfr.name),
+				       &rds);
+	dns_rdataset_disassociate(&rds);
+	if (result == DNS_R_UNCHANGED || result == DNS_R_NXRRSET)
+		result = ISC_R_SUCCESS;
+	CHECK(result);
+
+	xfr->axfr.nrdatas = 0;
+	isc_buffer_clear(xfr->axfr.rdatabuf);
 	result = ISC_R_SUCCESS;
  failure:
 	return (result);
@@ -322,7 +469,7 @@ static isc_result_t
 axfr_commit(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
 
-	CHECK(axfr_apply(xfr));
+	CHECK(axfr_flush(xfr));
 	CHECK(dns_db_endload(xfr->db, &xfr->axfr.add_private));
 
 	result = ISC_R_SUCCESS;
@@ -616,10 +763,10 @@ dns_xfrin_create(dns_zone_t *zone, dns_rdatatype_t xfrtype,
 
 	switch (isc_sockaddr_pf(masteraddr)) {
 	case PF_INET:
-		sourceaddr = *dns_zone_getxfrsource4(zone);
+		sourceaddr = dns_zone_getxfrsource4(zone);
 		break;
 	case PF_INET6:
-		sourceaddr = *dns_zone_getxfrsource6(zone);
+		sourceaddr = dns_zone_getxfrsource6(zone);
 		break;
 	default:
 		INSIST(0);
@@ -731,6 +878,7 @@ xfrin_reset(dns_xfrin_ctx_t *xfr) {
 		(void)dns_db_endload(xfr->db, &xfr->axfr.add_private);
 		xfr->axfr.add_func = NULL;
 	}
+	xfr->axfr.nrdatas = 0;
 
 	if (xfr->tcpmsg_valid) {
 		dns_tcpmsg_invalidate(&xfr->tcpmsg);
@@ -849,6 +997,12 @@ xfrin_create(isc_mem_t *mctx,
 
 	xfr->axfr.add_func = NULL;
 	xfr->axfr.add_private = NULL;
+	xfr->axfr.dbmctx = NULL;
+	dns_fixedname_init(&xfr->axfr.name);
+	xfr->axfr.rdatas = NULL;
+	xfr->axfr.nrdatas = 0;
+	xfr->axfr.maxrdatas = 0;
+	xfr->axfr.rdatabuf = NULL;
 
 	CHECK(dns_name_dup(zonename, mctx, &xfr->name));
 
@@ -1403,6 +1557,7 @@ static void
 maybe_free(dns_xfrin_ctx_t *xfr) {
 	isc_uint64_t msecs;
 	isc_uint64_t persec;
+	isc_uint64_t recspersec;
 
 	REQUIRE(VALID_XFRIN(xfr));
 
@@ -1420,13 +1575,18 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 	if (msecs == 0)
 		msecs = 1;
 	persec = (xfr->nbytes * 1000) / msecs;
+	recspersec = ((isc_uint64_t)xfr->nrecs * 1000) / msecs;
 	xfrin_log(xfr, ISC_LOG_INFO,
 		  "Transfer completed: %d messages, %d records, "
 		  "%" ISC_PRINT_QUADFORMAT "u bytes, "
-		  "%u.%03u secs (%u bytes/sec)",
+		  "%u.%03u secs (%u bytes/sec) (%u records/sec)",
 		  xfr->nmsg, xfr->nrecs, xfr->nbytes,
 		  (unsigned int) (msecs / 1000), (unsigned int) (msecs % 1000),
-		  (unsigned int) persec);
+		  (unsigned int) persec, (unsigned int) recspersec);
+	if (xfr->axfr.dbmctx != NULL)
+		xfrin_log(xfr, ISC_LOG_DEBUG(1),
+			  "zone database uses %lu bytes",
+			  (unsigned long) isc_mem_inuse(xfr->axfr.dbmctx));
 
 	if (xfr->socket != NULL)
 		isc_socket_detach(&xfr->socket);
@@ -1451,6 +1611,13 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 	if (xfr->axfr.add_private != NULL)
 		(void)dns_db_endload(xfr->db, &xfr->axfr.add_private);
 
+	if (xfr->axfr.rdatas != NULL)
+		isc_mem_put(xfr->mctx, xfr->axfr.rdatas,
+			    xfr->axfr.maxrdatas * sizeof(dns_rdata_t));
+
+	if (xfr->axfr.rdatabuf != NULL)
+		isc_buffer_free(&xfr->axfr.rdatabuf);
+
 	if (xfr->tcpmsg_valid)
 		dns_tcpmsg_invalidate(&xfr->tcpmsg);
 
@@ -1466,6 +1633,9 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 	if (xfr->db != NULL)
 		dns_db_detach(&xfr->db);
 
+	if (xfr->axfr.dbmctx != NULL)
+		isc_mem_detach(&xfr->axfr.dbmctx);
+
 	if (xfr->zone != NULL)
 		dns_zone_idetach(&xfr->zone);
 
@@ -21,8 +21,11 @@
 #include <errno.h>
 
 #include <isc/file.h>
+#include <isc/heap.h>
 #include <isc/hex.h>
+#include <isc/histo.h>
 #include <isc/mutex.h>
+#include <isc/once.h>
 #include <isc/pool.h>
 #include <isc/print.h>
 #include <isc/random.h>
@@ -73,6 +76,7 @@
 #include <dns/resolver.h>
 #include <dns/result.h>
 #include <dns/rriterator.h>
+#include <dns/slabstore.h>
 #include <dns/soa.h>
 #include <dns/ssu.h>
 #include <dns/stats.h>
@@ -150,6 +154,8 @@ typedef struct dns_nsec3chain dns_nsec3chain_t;
 typedef ISC_LIST(dns_nsec3chain_t) dns_nsec3chainlist_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
+typedef struct zone_sources zone_sources_t;
+typedef struct signbatch signbatch_t;
 
 #define DNS_ZONE_CHECKLOCK
 #ifdef DNS_ZONE_CHECKLOCK
@@ -209,7 +215,6 @@ struct dns_zone {
 	/* Locked */
 	dns_zonemgr_t		*zmgr;
 	ISC_LINK(dns_zone_t)	link;		/* Used by zmgr. */
-	isc_timer_t		*timer;
 	unsigned int		irefs;
 	dns_name_t		origin;
 	char			*masterfile;
@@ -260,12 +265,7 @@ struct dns_zone {
 	isc_sockaddr_t		notifyfrom;
 	isc_task_t		*task;
 	isc_task_t		*loadtask;
-	isc_sockaddr_t		notifysrc4;
-	isc_sockaddr_t		notifysrc6;
-	isc_sockaddr_t		xfrsource4;
-	isc_sockaddr_t		xfrsource6;
-	isc_sockaddr_t		altxfrsource4;
-	isc_sockaddr_t		altxfrsource6;
+	zone_sources_t		*sources;
 	isc_sockaddr_t		sourceaddr;
 	dns_xfrin_ctx_t		*xfr;		/* task locked */
 	dns_tsigkey_t		*tsigkey;	/* key used for xfr */
@@ -307,6 +307,14 @@ struct dns_zone {
 	 */
 	ISC_LINK(dns_zone_t)	statelink;
 	dns_zonelist_t		*statelist;
+	/*%
+	 * The zone's maintenance timer is an entry in the zone manager's
+	 * timer heap rather than an isc_timer_t of its own.  Locked by
+	 * the zone manager's timerlock.
+	 */
+	isc_time_t		timerdue;
+	unsigned int		timerindex;	/* 0 if not in the heap */
+	isc_event_t		*timerevent;	/* posted, not yet run */
 	/*%
 	 * Statistics counters about zone management.
 	 */
@@ -319,6 +327,7 @@ struct dns_zone {
 	isc_boolean_t		requeststats_on;
 	isc_stats_t		*requeststats;
 	dns_stats_t		*rcvquerystats;
+	isc_histo_t		*latencyhisto;
 	isc_uint32_t		notifydelay;
 	dns_isselffunc_t	isself;
 	void			*isselfarg;
@@ -336,6 +345,11 @@ struct dns_zone {
 	 * Keys that are signing the zone for the first time.
 	 */
 	dns_signinglist_t	signing;
+	/*%
+	 * Signatures being computed ahead of the next zone_sign() pass.
+	 * Only used by the zone's task.
+	 */
+	signbatch_t		*signbatch;
 	dns_nsec3chainlist_t	nsec3chain;
 	/*%
 	 * Signing / re-signing quantum stopping parameters.
@@ -358,6 +372,8 @@ struct dns_zone {
 	 * whether this is a response policy zone
 	 */
 	isc_boolean_t           is_rpz;
+	dns_rpz_summary_t	*rpz_summary;
+	int			rpz_num;
 
 	/*%
 	 * Serial number update method.
@@ -463,6 +479,29 @@ typedef struct {
 		if (result != ISC_R_SUCCESS) goto failure; \
 	} while (0)
 
+/*%
+ * Notify and transfer source addresses.  Almost every zone uses the
+ * same ones, so zones point at a shared, reference counted copy and
+ * the setters replace a zone's copy instead of modifying it.
+ */
+struct zone_sources {
+	unsigned int		references;	/* Locked by sources_lock */
+	isc_mem_t		*mctx;
+	ISC_LINK(zone_sources_t) link;
+	isc_sockaddr_t		notifysrc4;
+	isc_sockaddr_t		notifysrc6;
+	isc_sockaddr_t		xfrsource4;
+	isc_sockaddr_t		xfrsource6;
+	isc_sockaddr_t		altxfrsource4;
+	isc_sockaddr_t		altxfrsource6;
+};
+
+/*%
+ * At most this many distinct sets of source addresses are shared;
+ * further sets are private to the zone using them.
+ */
+#define ZONE_SOURCES_SHARED	16
+
 struct dns_unreachable {
 	isc_sockaddr_t	remote;
 	isc_sockaddr_t	local;
@@ -480,6 +519,7 @@ struct dns_zonemgr {
 	isc_socketmgr_t *	socketmgr;
 	isc_taskpool_t *	zonetasks;
 	isc_taskpool_t *	loadtasks;
+	isc_taskpool_t *	signtasks;	/* Locked by rwlock */
 	isc_task_t *		task;
 	isc_pool_t *		mctxpool;
 	isc_ratelimiter_t *	notifyrl;
@@ -489,11 +529,13 @@ struct dns_zonemgr {
 	isc_rwlock_t		rwlock;
 	isc_mutex_t		iolock;
 	isc_rwlock_t		urlock;
+	isc_mutex_t		timerlock;
 
 	/* Locked by rwlock. */
 	dns_zonelist_t		zones;
 	dns_zonelist_t		waiting_for_xfrin;
 	dns_zonelist_t		xfrin_in_progress;
+	dns_slabstore_t *	slabstore;
 
 	/* Configuration data. */
 	isc_uint32_t		transfersin;
@@ -512,6 +554,15 @@ struct dns_zonemgr {
 	/* Locked by urlock. */
 	/* LRU cache */
 	struct dns_unreachable	unreachable[UNREACH_CHACHE_SIZE];
+
+	/*
+	 * Locked by timerlock.  All zone maintenance timers are kept in
+	 * 'timerheap', ordered by due time; 'timer' fires for the
+	 * earliest of them at 'timerdue'.
+	 */
+	isc_heap_t *		timerheap;
+	isc_timer_t *		timer;
+	isc_time_t		timerdue;
 };
 
 /*%
@@ -601,6 +652,10 @@ struct dns_signing {
 	isc_uint16_t		keyid;
 	isc_boolean_t		delete;
 	isc_boolean_t		done;
+	/* Progress, reported by dns_zone_getsigningprogress(). */
+	isc_uint32_t		nodes;
+	isc_uint32_t		signatures;
+	isc_time_t		start;
 	ISC_LINK(dns_signing_t)	link;
 };
 
@@ -740,6 +795,11 @@ static isc_result_t zonemgr_getio(dns_zonemgr_t *zmgr, isc_boolean_t high,
 				  void *arg, dns_io_t **iop);
 static void zonemgr_putio(dns_io_t **iop);
 static void zonemgr_cancelio(dns_io_t *io);
+static isc_result_t zonemgr_settimer(dns_zonemgr_t *zmgr, dns_zone_t *zone,
+				     const isc_time_t *due);
+static isc_boolean_t timer_less(void *v1, void *v2);
+static void timer_index(void *what, unsigned int index);
+static void zmgr_timer(isc_task_t *task, isc_event_t *event);
 
 static isc_result_t
 zone_get_from_db(dns_zone_t *zone, dns_db_t *db, unsigned int *nscount,
@@ -749,6 +809,8 @@ zone_get_from_db(dns_zone_t *zone, dns_db_t *db, unsigned int *nscount,
 		 unsigned int *errors);
 
 static void zone_freedbargs(dns_zone_t *zone);
+static void sources_initialize(void);
+static void zone_detachsources(dns_zone_t *zone);
 static void forward_callback(isc_task_t *task, isc_event_t *event);
 static void zone_saveunique(dns_zone_t *zone, const char *path,
 			    const char *templat);
@@ -761,15 +823,25 @@ static isc_result_t delete_nsec(dns_db_t *db, dns_dbversion_t *ver,
 				dns_dbnode_t *node, dns_name_t *name,
 				dns_diff_t *diff);
 static void zone_rekey(dns_zone_t *zone);
+static void zone_signbatchdone(isc_task_t *task, isc_event_t *event);
 static isc_result_t zone_send_securedb(dns_zone_t *zone, dns_db_t *db);
 static void setrl(isc_ratelimiter_t *rl, unsigned int *rate,
 		  unsigned int value);
 
 #define ENTER zone_debuglog(zone, me, 1, "enter")
 
+/*%
+ * Zones using the default database share this argument list.
+ */
 static const unsigned int dbargc_default = 1;
 static const char *dbargv_default[] = { "rbt" };
 
+static isc_once_t sources_once = ISC_ONCE_INIT;
+static isc_mutex_t sources_lock;
+static ISC_LIST(zone_sources_t) sources_shared;	/* Locked by sources_lock */
+static unsigned int sources_count;		/* Locked by sources_lock */
+static zone_sources_t sources_default;
+
 #define DNS_ZONE_JITTER_ADD(a, b, c) \
 	do { \
 		isc_interval_t _i; \
@@ -923,17 +995,16 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->readio = NULL;
 	zone->dctx = NULL;
 	zone->writeio = NULL;
-	zone->timer = NULL;
 	zone->idlein = DNS_DEFAULT_IDLEIN;
 	zone->idleout = DNS_DEFAULT_IDLEOUT;
 	zone->log_key_expired_timer = 0;
 	ISC_LIST_INIT(zone->notifies);
-	isc_sockaddr_any(&zone->notifysrc4);
-	isc_sockaddr_any6(&zone->notifysrc6);
-	isc_sockaddr_any(&zone->xfrsource4);
-	isc_sockaddr_any6(&zone->xfrsource6);
-	isc_sockaddr_any(&zone->altxfrsource4);
-	isc_sockaddr_any6(&zone->altxfrsource6);
+	RUNTIME_CHECK(isc_once_do(&sources_once, sources_initialize)
+		      == ISC_R_SUCCESS);
+	LOCK(&sources_lock);
+	sources_default.references++;
+	zone->sources = &sources_default;
+	UNLOCK(&sources_lock);
 	zone->xfr = NULL;
 	zone->tsigkey = NULL;
 	zone->maxxfrin = MAX_XFER_TIME;
@@ -948,21 +1019,28 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->checkns = NULL;
 	ISC_LINK_INIT(zone, statelink);
 	zone->statelist = NULL;
+	isc_time_settoepoch(&zone->timerdue);
+	zone->timerindex = 0;
+	zone->timerevent = NULL;
 	zone->stats = NULL;
 	zone->requeststats_on = ISC_FALSE;
 	zone->statlevel = dns_zonestat_none;
 	zone->requeststats = NULL;
 	zone->rcvquerystats = NULL;
+	zone->latencyhisto = NULL;
 	zone->notifydelay = 5;
 	zone->isself = NULL;
 	zone->isselfarg = NULL;
 	ISC_LIST_INIT(zone->signing);
+	zone->signbatch = NULL;
 	ISC_LIST_INIT(zone->nsec3chain);
 	zone->signatures = 10;
 	zone->nodes = 100;
 	zone->privatetype = (dns_rdatatype_t)0xffffU;
 	zone->added = ISC_FALSE;
 	zone->is_rpz = ISC_FALSE;
+	zone->rpz_summary = NULL;
+	zone->rpz_num = 0;
 	ISC_LIST_INIT(zone->forwards);
 	zone->raw = NULL;
 	zone->secure = NULL;
@@ -983,6 +1061,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	return (ISC_R_SUCCESS);
 
  free_erefs:
+	zone_detachsources(zone);
 	isc_refcount_decrement(&zone->erefs, NULL);
 	isc_refcount_destroy(&zone->erefs);
 
@@ -1011,7 +1090,7 @@ zone_free(dns_zone_t *zone) {
 	REQUIRE(isc_refcount_current(&zone->erefs) == 0);
 	REQUIRE(zone->irefs == 0);
 	REQUIRE(!LOCKED_ZONE(zone));
-	REQUIRE(zone->timer == NULL);
+	REQUIRE(zone->timerindex == 0 && zone->timerevent == NULL);
 	REQUIRE(zone->zmgr == NULL);
 
 	/*
@@ -1061,11 +1140,16 @@ zone_free(dns_zone_t *zone) {
 		isc_stats_detach(&zone->requeststats);
 	if(zone->rcvquerystats != NULL )
 		dns_stats_detach(&zone->rcvquerystats);
+	if (zone->latencyhisto != NULL)
+		isc_histo_detach(&zone->latencyhisto);
 	if (zone->db != NULL)
 		zone_detachdb(zone);
+	if (zone->rpz_summary != NULL)
+		dns_rpz_summary_detach(&zone->rpz_summary);
 	if (zone->acache != NULL)
 		dns_acache_detach(&zone->acache);
 	zone_freedbargs(zone);
+	zone_detachsources(zone);
 	RUNTIME_CHECK(dns_zone_setmasterswithkeys(zone, NULL, NULL, 0)
 		      == ISC_R_SUCCESS);
 	RUNTIME_CHECK(dns_zone_setalsonotify(zone, NULL, 0)
@@ -1240,12 +1324,17 @@ dns_zone_settype(dns_zone_t *zone, dns_zonetype_t type) {
 	UNLOCK_ZONE(zone);
 }
 
+static isc_boolean_t
+zone_defaultdbargs(dns_zone_t *zone) {
+	return (ISC_TF((void *)zone->db_argv == (void *)dbargv_default));
+}
+
 static void
 zone_freedbargs(dns_zone_t *zone) {
 	unsigned int i;
 
 	/* Free the old database argument list. */
-	if (zone->db_argv != NULL) {
+	if (zone->db_argv != NULL && !zone_defaultdbargs(zone)) {
 		for (i = 0; i < zone->db_argc; i++)
 			isc_mem_free(zone->mctx, zone->db_argv[i]);
 		isc_mem_put(zone->mctx, zone->db_argv,
@@ -1301,6 +1390,15 @@ dns_zone_setdbtype(dns_zone_t *zone,
 
 	LOCK_ZONE(zone);
 
+	if (dbargc == dbargc_default &&
+	    strcmp(dbargv[0], dbargv_default[0]) == 0)
+	{
+		zone_freedbargs(zone);
+		zone->db_argc = dbargc_default;
+		DE_CONST(dbargv_default, zone->db_argv);
+		goto unlock;
+	}
+
 	/* Set up a new database argument list. */
 	new = isc_mem_get(zone->mctx, dbargc * sizeof(*new));
 	if (new == NULL)
@@ -1557,7 +1655,9 @@ dns_zone_isdynamic(dns_zone_t *zone, isc_boolean_t ignore_freeze) {
  * Set the response policy index and information for a zone.
  */
 isc_result_t
-dns_zone_rpz_enable(dns_zone_t *zone) {
+dns_zone_rpz_enable(dns_zone_t *zone, dns_rpz_summary_t *summary, int num) {
+	dns_db_t *db = NULL;
+
 	/*
 	 * Only RBTDB zones can be used for response policy zones,
 	 * because only they have the code to load the create the summary data.
@@ -1570,6 +1670,32 @@ dns_zone_rpz_enable(dns_zone_t *zone) {
 
 	zone->is_rpz = ISC_TRUE;
 
+#ifdef BIND9
+	/*
+	 * Move the triggers of the current database to the new summary.
+	 */
+	LOCK_ZONE(zone);
+	if (zone->rpz_summary != NULL)
+		dns_rpz_summary_detach(&zone->rpz_summary);
+	if (summary != NULL)
+		dns_rpz_summary_attach(summary, &zone->rpz_summary);
+	zone->rpz_num = num;
+	UNLOCK_ZONE(zone);
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL)
+		dns_db_attach(zone->db, &db);
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+	if (db != NULL) {
+		dns_db_rpz_setsummary(db, summary, num);
+		dns_db_detach(&db);
+	}
+#else
+	UNUSED(summary);
+	UNUSED(num);
+	UNUSED(db);
+#endif
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -1578,14 +1704,41 @@ dns_zone_get_rpz(dns_zone_t *zone) {
 	return (zone->is_rpz);
 }
 
+/*
+ * Share the rdata of a new database through the zone manager's slab
+ * store, if it has one.
+ */
+void
+dns_zone_sharedb(dns_zone_t *zone, dns_db_t *db) {
+	dns_zonemgr_t *zmgr;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(db != NULL);
+
+	zmgr = zone->zmgr;
+	if (zmgr == NULL)
+		return;
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	if (zmgr->slabstore != NULL)
+		dns_db_setslabstore(db, zmgr->slabstore);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+}
+
 /*
  * If a zone is a response policy zone, mark its new database.
  */
 isc_result_t
 dns_zone_rpz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 #ifdef BIND9
-	if (zone->is_rpz)
-		return (dns_db_rpz_enabled(db, NULL));
+	isc_result_t result;
+
+	if (zone->is_rpz) {
+		result = dns_db_rpz_enabled(db, NULL);
+		if (result == ISC_R_SUCCESS)
+			dns_db_rpz_setsummary(db, zone->rpz_summary,
+					      zone->rpz_num);
+		return (result);
+	}
 #endif
 	return (ISC_R_SUCCESS);
 }
@@ -2050,6 +2203,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 	result = dns_zone_rpz_enable_db(zone, db);
 	if (result != ISC_R_SUCCESS)
 		return (result);
+	dns_zone_sharedb(zone, db);
 	options = get_master_options(zone);
 	if (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_MANYERRORS))
 		options |= DNS_MASTER_MANYERRORS;
@@ -4836,110 +4990,277 @@ dns_zone_getkeyopts(dns_zone_t *zone) {
 	return (zone->keyopts);
 }
 
+static void
+sources_initialize(void) {
+	RUNTIME_CHECK(isc_mutex_init(&sources_lock) == ISC_R_SUCCESS);
+	ISC_LIST_INIT(sources_shared);
+	memset(&sources_default, 0, sizeof(sources_default));
+	isc_sockaddr_any(&sources_default.notifysrc4);
+	isc_sockaddr_any6(&sources_default.notifysrc6);
+	isc_sockaddr_any(&sources_default.xfrsource4);
+	isc_sockaddr_any6(&sources_default.xfrsource6);
+	isc_sockaddr_any(&sources_default.altxfrsource4);
+	isc_sockaddr_any6(&sources_default.altxfrsource6);
+	/* The defaults are never freed. */
+	sources_default.references = 1;
+	ISC_LINK_INIT(&sources_default, link);
+	ISC_LIST_APPEND(sources_shared, &sources_default, link);
+	sources_count = 1;
+}
+
+static isc_boolean_t
+sources_equal(const zone_sources_t *a, const zone_sources_t *b) {
+	return (ISC_TF(isc_sockaddr_equal(&a->notifysrc4, &b->notifysrc4) &&
+		       isc_sockaddr_equal(&a->notifysrc6, &b->notifysrc6) &&
+		       isc_sockaddr_equal(&a->xfrsource4, &b->xfrsource4) &&
+		       isc_sockaddr_equal(&a->xfrsource6, &b->xfrsource6) &&
+		       isc_sockaddr_equal(&a->altxfrsource4,
+					  &b->altxfrsource4) &&
+		       isc_sockaddr_equal(&a->altxfrsource6,
+					  &b->altxfrsource6)));
+}
+
+/*
+ * Release 'sources'.  Called with sources_lock held.
+ */
+static void
+sources_detach(zone_sources_t *sources) {
+	INSIST(sources->references > 0);
+	if (--sources->references != 0)
+		return;
+	INSIST(sources != &sources_default);
+	if (ISC_LINK_LINKED(sources, link)) {
+		ISC_LIST_UNLINK(sources_shared, sources, link);
+		sources_count--;
+	}
+	isc_mem_putanddetach(&sources->mctx, sources, sizeof(*sources));
+}
+
+static void
+zone_detachsources(dns_zone_t *zone) {
+	if (zone->sources == NULL)
+		return;
+	LOCK(&sources_lock);
+	sources_detach(zone->sources);
+	UNLOCK(&sources_lock);
+	zone->sources = NULL;
+}
+
+/*
+ * Make 'zone' use source addresses equal to 'sources', sharing an
+ * existing copy if there is one.  Called with the zone locked.
+ */
+static isc_result_t
+zone_setsources(dns_zone_t *zone, const zone_sources_t *sources) {
+	zone_sources_t *s;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	if (sources_equal(zone->sources, sources))
+		return (ISC_R_SUCCESS);
+
+	LOCK(&sources_lock);
+	for (s = ISC_LIST_HEAD(sources_shared);
+	     s != NULL;
+	     s = ISC_LIST_NEXT(s, link))
+	{
+		if (sources_equal(s, sources))
+			break;
+	}
+	if (s == NULL) {
+		s = isc_mem_get(zone->mctx, sizeof(*s));
+		if (s == NULL) {
+			UNLOCK(&sources_lock);
+			return (ISC_R_NOMEMORY);
+		}
+		*s = *sources;
+		s->references = 0;
+		s->mctx = NULL;
+		isc_mem_attach(zone->mctx, &s->mctx);
+		ISC_LINK_INIT(s, link);
+		if (sources_count < ZONE_SOURCES_SHARED) {
+			ISC_LIST_APPEND(sources_shared, s, link);
+			sources_count++;
+		}
+	}
+	s->references++;
+	sources_detach(zone->sources);
+	zone->sources = s;
+	UNLOCK(&sources_lock);
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_zone_setxfrsource4(dns_zone_t *zone, const isc_sockaddr_t *xfrsource) {
+	zone_sources_t sources;
+	isc_result_t result;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	LOCK_ZONE(zone);
-	zone->xfrsource4 = *xfrsource;
+	sources = *zone->sources;
+	sources.xfrsource4 = *xfrsource;
+	result = zone_setsources(zone, &sources);
 	UNLOCK_ZONE(zone);
 
-	return (ISC_R_SUCCESS);
+	return (result);
 }
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getxfrsource4(dns_zone_t *zone) {
+	isc_sockaddr_t addr;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
-	return (&zone->xfrsource4);
+
+	LOCK_ZONE(zone);
+	addr = zone->sources->xfrsource4;
+	UNLOCK_ZONE(zone);
+	return (addr);
 }
 
 isc_result_t
 dns_zone_setxfrsource6(dns_zone_t *zone, const isc_sockaddr_t *xfrsource) {
+	zone_sources_t sources;
+	isc_result_t result;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	LOCK_ZONE(zone);
-	zone->xfrsource6 = *xfrsource;
+	sources = *zone->sources;
+	sources.xfrsource6 = *xfrsource;
+	result = zone_setsources(zone, &sources);
 	UNLOCK_ZONE(zone);
 
-	return (ISC_R_SUCCESS);
+	return (result);
 }
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getxfrsource6(dns_zone_t *zone) {
+	isc_sockaddr_t addr;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
-	return (&zone->xfrsource6);
+
+	LOCK_ZONE(zone);
+	addr = zone->sources->xfrsource6;
+	UNLOCK_ZONE(zone);
+	return (addr);
 }
 
 isc_result_t
 dns_zone_setaltxfrsource4(dns_zone_t *zone,
 			  const isc_sockaddr_t *altxfrsource)
 {
+	zone_sources_t sources;
+	isc_result_t result;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	LOCK_ZONE(zone);
-	zone->altxfrsource4 = *altxfrsource;
+	sources = *zone->sources;
+	sources.altxfrsource4 = *altxfrsource;
+	result = zone_setsources(zone, &sources);
 	UNLOCK_ZONE(zone);
 
-	return (ISC_R_SUCCESS);
+	return (result);
 }
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getaltxfrsource4(dns_zone_t *zone) {
+	isc_sockaddr_t addr;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
-	return (&zone->altxfrsource4);
+
+	LOCK_ZONE(zone);
+	addr = zone->sources->altxfrsource4;
+	UNLOCK_ZONE(zone);
+	return (addr);
 }
 
 isc_result_t
 dns_zone_setaltxfrsource6(dns_zone_t *zone,
 			  const isc_sockaddr_t *altxfrsource)
 {
+	zone_sources_t sources;
+	isc_result_t result;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	LOCK_ZONE(zone);
-	zone->altxfrsource6 = *altxfrsource;
+	sources = *zone->sources;
+	sources.altxfrsource6 = *altxfrsource;
+	result = zone_setsources(zone, &sources);
 	UNLOCK_ZONE(zone);
 
-	return (ISC_R_SUCCESS);
+	return (result);
 }
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getaltxfrsource6(dns_zone_t *zone) {
+	isc_sockaddr_t addr;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
-	return (&zone->altxfrsource6);
+
+	LOCK_ZONE(zone);
+	addr = zone->sources->altxfrsource6;
+	UNLOCK_ZONE(zone);
+	return (addr);
 }
 
 isc_result_t
 dns_zone_setnotifysrc4(dns_zone_t *zone, const isc_sockaddr_t *notifysrc) {
+	zone_sources_t sources;
+	isc_result_t result;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	LOCK_ZONE(zone);
-	zone->notifysrc4 = *notifysrc;
+	sources = *zone->sources;
+	sources.notifysrc4 = *notifysrc;
+	result = zone_setsources(zone, &sources);
 	UNLOCK_ZONE(zone);
 
-	return (ISC_R_SUCCESS);
+	return (result);
 }
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getnotifysrc4(dns_zone_t *zone) {
+	isc_sockaddr_t addr;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
-	return (&zone->notifysrc4);
+
+	LOCK_ZONE(zone);
+	addr = zone->sources->notifysrc4;
+	UNLOCK_ZONE(zone);
+	return (addr);
 }
 
 isc_result_t
 dns_zone_setnotifysrc6(dns_zone_t *zone, const isc_sockaddr_t *notifysrc) {
+	zone_sources_t sources;
+	isc_result_t result;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	LOCK_ZONE(zone);
-	zone->notifysrc6 = *notifysrc;
+	sources = *zone->sources;
+	sources.notifysrc6 = *notifysrc;
+	result = zone_setsources(zone, &sources);
 	UNLOCK_ZONE(zone);
 
-	return (ISC_R_SUCCESS);
+	return (result);
 }
 
-isc_sockaddr_t *
+isc_sockaddr_t
 dns_zone_getnotifysrc6(dns_zone_t *zone) {
+	isc_sockaddr_t addr;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
-	return (&zone->notifysrc6);
+
+	LOCK_ZONE(zone);
+	addr = zone->sources->notifysrc6;
+	UNLOCK_ZONE(zone);
+	return (addr);
 }
 
 static isc_boolean_t
@@ -5983,68 +6304,505 @@ add_nsec(dns_db_t *db, dns_dbversion_t *version, dns_name_t *name,
 	return (result);
 }
 
+/*%
+ * Signatures for the next pass of zone_sign(), computed ahead of it by
+ * the zone manager's signing tasks.  The zone's task queues the RRsets
+ * that the pass is expected to sign, starts the signing tasks on them
+ * and carries on; the last signing task to finish posts
+ * DNS_EVENT_ZONESIGNDONE back to the zone.  The pass then runs as
+ * before, taking the precomputed RRSIG for each RRset it signs when
+ * one is there and signing inline when it is not, so records reach the
+ * diff and journal in their usual order and signed_with_key() sees
+ * each new RRSIG as soon as it is added.
+ *
+ * A dst key must not be used by two threads at once, so each signing
+ * task has its own copy of the zone keys.
+ */
+typedef struct signjob {
+	dns_fixedname_t		name;
+	dns_rdataset_t		rdataset;
+	unsigned int		key;		/* Index into each key set */
+	dns_rdata_t		rdata;
+	unsigned char		*data;
+	unsigned int		datalen;
+	isc_result_t		result;
+} signjob_t;
+
+struct signbatch {
+	isc_mem_t		*mctx;
+	isc_mutex_t		lock;
+	unsigned int		next;		/* Locked by lock */
+	unsigned int		started;	/* Locked by lock */
+	unsigned int		running;	/* Locked by lock */
+	isc_event_t		*done;		/* Locked by lock */
+	isc_task_t		*task;
+	isc_boolean_t		complete;
+	dns_db_t		*db;
+	dns_dbversion_t		*version;
+	dst_key_t		**keys;		/* 'nkeys' per signing task */
+	unsigned int		nkeys;
+	unsigned int		nhelpers;
+	unsigned int		maxhelpers;
+	signjob_t		**jobs;
+	unsigned int		njobs;
+	unsigned int		maxjobs;
+	unsigned int		match;
+	unsigned int		used;
+	isc_stdtime_t		inception;
+	isc_stdtime_t		expire;
+};
+
+/*
+ * Create a batch for 'nhelpers' signing tasks, signing RRsets of
+ * 'version' of 'db' with 'keys'.  The batch takes over 'keys' and
+ * loads a copy of them for each additional signing task; if a copy
+ * cannot be loaded fewer tasks are used.
+ */
 static isc_result_t
-sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
-	    dns_dbversion_t *version, isc_boolean_t build_nsec3,
-	    isc_boolean_t build_nsec, dst_key_t *key,
-	    isc_stdtime_t inception, isc_stdtime_t expire,
-	    unsigned int minimum, isc_boolean_t is_ksk,
-	    isc_boolean_t keyset_kskonly, isc_boolean_t *delegation,
-	    dns_diff_t *diff, isc_int32_t *signatures, isc_mem_t *mctx)
+signbatch_create(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *version,
+		 dst_key_t **keys, unsigned int nkeys, unsigned int nhelpers,
+		 isc_stdtime_t inception, isc_stdtime_t expire,
+		 signbatch_t **batchp)
 {
+	signbatch_t *batch;
+	dst_key_t *copy[DNS_MAXZONEKEYS];
+	unsigned int h, i, j, ncopy;
 	isc_result_t result;
-	dns_rdatasetiter_t *iterator = NULL;
-	dns_rdataset_t rdataset;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
-	isc_buffer_t buffer;
-	unsigned char data[1024];
-	isc_boolean_t seen_soa, seen_ns, seen_rr, seen_dname, seen_nsec,
-		      seen_nsec3, seen_ds;
-	isc_boolean_t bottom;
 
-	result = dns_db_allrdatasets(db, node, version, 0, &iterator);
+	REQUIRE(batchp != NULL && *batchp == NULL);
+	REQUIRE(nkeys > 0 && nhelpers > 0);
+
+	batch = isc_mem_get(zone->mctx, sizeof(*batch));
+	if (batch == NULL)
+		return (ISC_R_NOMEMORY);
+	batch->keys = isc_mem_get(zone->mctx,
+				  nkeys * nhelpers * sizeof(*batch->keys));
+	if (batch->keys == NULL) {
+		isc_mem_put(zone->mctx, batch, sizeof(*batch));
+		return (ISC_R_NOMEMORY);
+	}
+	result = isc_mutex_init(&batch->lock);
 	if (result != ISC_R_SUCCESS) {
-		if (result == ISC_R_NOTFOUND)
-			result = ISC_R_SUCCESS;
+		isc_mem_put(zone->mctx, batch->keys,
+			    nkeys * nhelpers * sizeof(*batch->keys));
+		isc_mem_put(zone->mctx, batch, sizeof(*batch));
 		return (result);
 	}
+	batch->mctx = NULL;
+	isc_mem_attach(zone->mctx, &batch->mctx);
+	batch->next = 0;
+	batch->started = 0;
+	batch->running = 0;
+	batch->done = NULL;
+	batch->task = NULL;
+	batch->complete = ISC_FALSE;
+	batch->db = NULL;
+	dns_db_attach(db, &batch->db);
+	batch->version = NULL;
+	dns_db_attachversion(db, version, &batch->version);
+	batch->nkeys = nkeys;
+	batch->maxhelpers = nhelpers;
+	batch->jobs = NULL;
+	batch->njobs = 0;
+	batch->maxjobs = 0;
+	batch->match = 0;
+	batch->used = 0;
+	batch->inception = inception;
+	batch->expire = expire;
+
+	memmove(batch->keys, keys, nkeys * sizeof(*keys));
+	for (h = 1; h < nhelpers; h++) {
+		result = find_zone_keys(zone, db, version, zone->mctx,
+					DNS_MAXZONEKEYS, copy, &ncopy);
+		if (result != ISC_R_SUCCESS)
+			break;
+		for (i = 0; i < nkeys; i++) {
+			for (j = 0; j < ncopy; j++)
+				if (copy[j] != NULL &&
+				    ALG(copy[j]) == ALG(keys[i]) &&
+				    dst_key_id(copy[j]) == dst_key_id(keys[i]))
+					break;
+			if (j == ncopy)
+				break;
+			batch->keys[h * nkeys + i] = copy[j];
+			copy[j] = NULL;
+		}
+		for (j = 0; j < ncopy; j++)
+			if (copy[j] != NULL)
+				dst_key_free(&copy[j]);
+		if (i < nkeys) {
+			while (i-- > 0)
+				dst_key_free(&batch->keys[h * nkeys + i]);
+			break;
+		}
+	}
+	batch->nhelpers = h;
 
-	dns_rdataset_init(&rdataset);
-	isc_buffer_init(&buffer, data, sizeof(data));
-	seen_rr = seen_soa = seen_ns = seen_dname = seen_nsec =
-	seen_nsec3 = seen_ds = ISC_FALSE;
-	for (result = dns_rdatasetiter_first(iterator);
-	     result == ISC_R_SUCCESS;
-	     result = dns_rdatasetiter_next(iterator)) {
-		dns_rdatasetiter_current(iterator, &rdataset);
-		if (rdataset.type == dns_rdatatype_soa)
-			seen_soa = ISC_TRUE;
-		else if (rdataset.type == dns_rdatatype_ns)
-			seen_ns = ISC_TRUE;
-		else if (rdataset.type == dns_rdatatype_ds)
-			seen_ds = ISC_TRUE;
-		else if (rdataset.type == dns_rdatatype_dname)
-			seen_dname = ISC_TRUE;
-		else if (rdataset.type == dns_rdatatype_nsec)
-			seen_nsec = ISC_TRUE;
-		else if (rdataset.type == dns_rdatatype_nsec3)
-			seen_nsec3 = ISC_TRUE;
-		if (rdataset.type != dns_rdatatype_rrsig)
-			seen_rr = ISC_TRUE;
-		dns_rdataset_disassociate(&rdataset);
+	*batchp = batch;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Free a batch that no signing task is using any more.  This must be
+ * done by the zone's task.
+ */
+static void
+signbatch_destroy(signbatch_t **batchp) {
+	signbatch_t *batch = *batchp;
+	signjob_t *job;
+	unsigned int i, nkeys;
+
+	*batchp = NULL;
+
+	INSIST(batch->running == 0);
+
+	for (i = 0; i < batch->njobs; i++) {
+		job = batch->jobs[i];
+		if (dns_rdataset_isassociated(&job->rdataset))
+			dns_rdataset_disassociate(&job->rdataset);
+		if (job->data != NULL)
+			isc_mem_put(batch->mctx, job->data, job->datalen);
+		isc_mem_put(batch->mctx, job, sizeof(*job));
+	}
+	if (batch->jobs != NULL)
+		isc_mem_put(batch->mctx, batch->jobs,
+			    batch->maxjobs * sizeof(*batch->jobs));
+	nkeys = batch->nkeys * batch->nhelpers;
+	for (i = 0; i < nkeys; i++)
+		dst_key_free(&batch->keys[i]);
+	isc_mem_put(batch->mctx, batch->keys,
+		    batch->nkeys * batch->maxhelpers * sizeof(*batch->keys));
+	if (batch->done != NULL)
+		isc_event_free(&batch->done);
+	if (batch->task != NULL)
+		isc_task_detach(&batch->task);
+	dns_db_closeversion(batch->db, &batch->version, ISC_FALSE);
+	dns_db_detach(&batch->db);
+	DESTROYLOCK(&batch->lock);
+	isc_mem_putanddetach(&batch->mctx, batch, sizeof(*batch));
+}
+
+/*
+ * Queue the signing of 'rdataset' with key 'key' of the batch.
+ */
+static isc_result_t
+signbatch_add(signbatch_t *batch, dns_name_t *name, dns_rdataset_t *rdataset,
+	      unsigned int key)
+{
+	signjob_t *job, **jobs;
+	unsigned int maxjobs;
+
+	if (batch->njobs == batch->maxjobs) {
+		maxjobs = (batch->maxjobs == 0) ? 16 : batch->maxjobs * 2;
+		jobs = isc_mem_get(batch->mctx, maxjobs * sizeof(*jobs));
+		if (jobs == NULL)
+			return (ISC_R_NOMEMORY);
+		if (batch->jobs != NULL) {
+			memcpy(jobs, batch->jobs,
+			       batch->njobs * sizeof(*jobs));
+			isc_mem_put(batch->mctx, batch->jobs,
+				    batch->maxjobs * sizeof(*jobs));
+		}
+		batch->jobs = jobs;
+		batch->maxjobs = maxjobs;
 	}
-	if (result != ISC_R_NOMORE)
-		goto failure;
-	if (seen_ns && !seen_soa)
-		*delegation = ISC_TRUE;
-	/*
-	 * Going from insecure to NSEC3.
-	 * Don't generate NSEC3 records for NSEC3 records.
-	 */
-	if (build_nsec3 && !seen_nsec3 && seen_rr) {
-		isc_boolean_t unsecure = !seen_ds && seen_ns && !seen_soa;
-		CHECK(dns_nsec3_addnsec3s(db, version, name, minimum,
-					  unsecure, diff));
+
+	job = isc_mem_get(batch->mctx, sizeof(*job));
+	if (job == NULL)
+		return (ISC_R_NOMEMORY);
+	dns_fixedname_init(&job->name);
+	dns_name_copy(name, dns_fixedname_name(&job->name), NULL);
+	dns_rdataset_init(&job->rdataset);
+	dns_rdataset_clone(rdataset, &job->rdataset);
+	job->key = key;
+	dns_rdata_init(&job->rdata);
+	job->data = NULL;
+	job->datalen = 0;
+	job->result = ISC_R_UNSET;
+	batch->jobs[batch->njobs++] = job;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_boolean_t
+rdataset_equal(dns_rdataset_t *a, dns_rdataset_t *b) {
+	dns_rdata_t rdata1 = DNS_RDATA_INIT;
+	dns_rdata_t rdata2 = DNS_RDATA_INIT;
+	isc_result_t result1, result2;
+
+	if (a->type != b->type || a->ttl != b->ttl ||
+	    dns_rdataset_count(a) != dns_rdataset_count(b))
+		return (ISC_FALSE);
+
+	for (result1 = dns_rdataset_first(a), result2 = dns_rdataset_first(b);
+	     result1 == ISC_R_SUCCESS && result2 == ISC_R_SUCCESS;
+	     result1 = dns_rdataset_next(a), result2 = dns_rdataset_next(b))
+	{
+		dns_rdataset_current(a, &rdata1);
+		dns_rdataset_current(b, &rdata2);
+		if (dns_rdata_compare(&rdata1, &rdata2) != 0)
+			return (ISC_FALSE);
+		dns_rdata_reset(&rdata1);
+		dns_rdata_reset(&rdata2);
+	}
+	return (ISC_TF(result1 == ISC_R_NOMORE && result2 == ISC_R_NOMORE));
+}
+
+/*
+ * Find the precomputed signature of 'rdataset' at 'name' by 'key'.
+ * The pass asks for signatures in roughly the order they were queued,
+ * so the search resumes after the last one found.
+ */
+static isc_boolean_t
+signbatch_find(signbatch_t *batch, dns_name_t *name, dns_rdataset_t *rdataset,
+	       dst_key_t *key, dns_rdata_t *rdata)
+{
+	signjob_t *job;
+	dst_key_t *jobkey;
+	unsigned int i;
+
+	for (i = batch->match; i < batch->njobs; i++) {
+		job = batch->jobs[i];
+		jobkey = batch->keys[job->key];
+		if (job->rdataset.type != rdataset->type ||
+		    ALG(jobkey) != ALG(key) ||
+		    dst_key_id(jobkey) != dst_key_id(key) ||
+		    !dns_name_equal(dns_fixedname_name(&job->name), name))
+			continue;
+		if (job->result != ISC_R_SUCCESS ||
+		    !rdataset_equal(&job->rdataset, rdataset))
+			return (ISC_FALSE);
+		batch->match = i + 1;
+		batch->used++;
+		dns_rdata_clone(&job->rdata, rdata);
+		return (ISC_TRUE);
+	}
+	return (ISC_FALSE);
+}
+
+static void
+signjob_sign(signbatch_t *batch, signjob_t *job, dst_key_t *key) {
+	isc_buffer_t buffer;
+	unsigned int sigsize;
+
+	/*
+	 * The RRSIG's fixed fields, the signer's name and the signature.
+	 */
+	job->result = dst_key_sigsize(key, &sigsize);
+	if (job->result != ISC_R_SUCCESS)
+		return;
+	job->datalen = 18 + dst_key_name(key)->length + sigsize;
+	job->data = isc_mem_get(batch->mctx, job->datalen);
+	if (job->data == NULL) {
+		job->result = ISC_R_NOMEMORY;
+		return;
+	}
+	isc_buffer_init(&buffer, job->data, job->datalen);
+	job->result = dns_dnssec_sign(dns_fixedname_name(&job->name),
+				      &job->rdataset, key, &batch->inception,
+				      &batch->expire, batch->mctx, &buffer,
+				      &job->rdata);
+}
+
+/*
+ * A signing task: compute signatures with this task's copy of the keys
+ * until there are no jobs left to start.  The last task to finish lets
+ * the zone know; the batch must not be touched after that.
+ */
+static void
+signbatch_helper(isc_task_t *task, isc_event_t *event) {
+	signbatch_t *batch = event->ev_arg;
+	isc_event_t *done = NULL;
+	isc_task_t *zonetask = NULL;
+	dst_key_t **keys;
+	signjob_t *job;
+
+	UNUSED(task);
+
+	INSIST(event->ev_type == DNS_EVENT_ZONESIGNBATCH);
+	isc_event_free(&event);
+
+	LOCK(&batch->lock);
+	INSIST(batch->started < batch->nhelpers);
+	keys = &batch->keys[batch->started++ * batch->nkeys];
+	UNLOCK(&batch->lock);
+
+	for (;;) {
+		LOCK(&batch->lock);
+		if (batch->next == batch->njobs) {
+			UNLOCK(&batch->lock);
+			break;
+		}
+		job = batch->jobs[batch->next++];
+		UNLOCK(&batch->lock);
+
+		signjob_sign(batch, job, keys[job->key]);
+	}
+
+	LOCK(&batch->lock);
+	INSIST(batch->running > 0);
+	if (--batch->running == 0) {
+		done = batch->done;
+		batch->done = NULL;
+		zonetask = batch->task;
+	}
+	UNLOCK(&batch->lock);
+	if (done != NULL)
+		isc_task_send(zonetask, &done);
+}
+
+/*
+ * Start the zone manager's signing tasks on 'batch'.
+ */
+static isc_result_t
+signbatch_start(dns_zone_t *zone, signbatch_t *batch) {
+	isc_event_t **events;
+	isc_task_t *task;
+	dns_zone_t *dummy = NULL;
+	unsigned int i, n;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	n = batch->nhelpers;
+	if (n > batch->njobs)
+		n = batch->njobs;
+
+	events = isc_mem_get(zone->mctx, n * sizeof(*events));
+	if (events == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(events, 0, n * sizeof(*events));
+	batch->done = isc_event_allocate(zone->mctx, zone,
+					 DNS_EVENT_ZONESIGNDONE,
+					 zone_signbatchdone, zone,
+					 sizeof(isc_event_t));
+	if (batch->done == NULL)
+		CHECK(ISC_R_NOMEMORY);
+	for (i = 0; i < n; i++) {
+		events[i] = isc_event_allocate(zone->mctx, zone,
+					       DNS_EVENT_ZONESIGNBATCH,
+					       signbatch_helper, batch,
+					       sizeof(isc_event_t));
+		if (events[i] == NULL)
+			CHECK(ISC_R_NOMEMORY);
+	}
+
+	RWLOCK(&zone->zmgr->rwlock, isc_rwlocktype_read);
+	if (zone->zmgr->signtasks == NULL) {
+		RWUNLOCK(&zone->zmgr->rwlock, isc_rwlocktype_read);
+		CHECK(ISC_R_SHUTTINGDOWN);
+	}
+	/*
+	 * The completion event holds a reference to the zone.
+	 */
+	LOCK_ZONE(zone);
+	zone_iattach(zone, &dummy);
+	isc_task_attach(zone->task, &batch->task);
+	UNLOCK_ZONE(zone);
+	batch->running = n;
+	for (i = 0; i < n; i++) {
+		task = NULL;
+		isc_taskpool_gettask(zone->zmgr->signtasks, &task);
+		isc_task_send(task, &events[i]);
+		isc_task_detach(&task);
+	}
+	RWUNLOCK(&zone->zmgr->rwlock, isc_rwlocktype_read);
+
+ failure:
+	for (i = 0; i < n; i++)
+		if (events[i] != NULL)
+			isc_event_free(&events[i]);
+	if (result != ISC_R_SUCCESS && batch->done != NULL)
+		isc_event_free(&batch->done);
+	isc_mem_put(zone->mctx, events, n * sizeof(*events));
+	return (result);
+}
+
+/*
+ * Does zone_sign() sign 'rdataset' with 'key'?
+ */
+static isc_boolean_t
+sign_wanted(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    dns_rdataset_t *rdataset, dst_key_t *key, isc_boolean_t is_ksk,
+	    isc_boolean_t keyset_kskonly, isc_boolean_t delegation)
+{
+	if (rdataset->type == dns_rdatatype_soa ||
+	    rdataset->type == dns_rdatatype_rrsig)
+		return (ISC_FALSE);
+	if (rdataset->type == dns_rdatatype_dnskey) {
+		if (!is_ksk && keyset_kskonly)
+			return (ISC_FALSE);
+	} else if (is_ksk)
+		return (ISC_FALSE);
+	if (delegation &&
+	    rdataset->type != dns_rdatatype_ds &&
+	    rdataset->type != dns_rdatatype_nsec)
+		return (ISC_FALSE);
+	if (signed_with_key(db, node, version, rdataset->type, key))
+		return (ISC_FALSE);
+	return (ISC_TRUE);
+}
+
+static isc_result_t
+sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
+	    dns_dbversion_t *version, isc_boolean_t build_nsec3,
+	    isc_boolean_t build_nsec, dst_key_t *key,
+	    isc_stdtime_t inception, isc_stdtime_t expire,
+	    unsigned int minimum, isc_boolean_t is_ksk,
+	    isc_boolean_t keyset_kskonly, isc_boolean_t *delegation,
+	    dns_diff_t *diff, isc_int32_t *signatures, isc_mem_t *mctx,
+	    signbatch_t *batch)
+{
+	isc_result_t result;
+	dns_rdatasetiter_t *iterator = NULL;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_buffer_t buffer;
+	unsigned char data[1024];
+	isc_boolean_t seen_soa, seen_ns, seen_rr, seen_dname, seen_nsec,
+		      seen_nsec3, seen_ds;
+	isc_boolean_t bottom;
+
+	result = dns_db_allrdatasets(db, node, version, 0, &iterator);
+	if (result != ISC_R_SUCCESS) {
+		if (result == ISC_R_NOTFOUND)
+			result = ISC_R_SUCCESS;
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	isc_buffer_init(&buffer, data, sizeof(data));
+	seen_rr = seen_soa = seen_ns = seen_dname = seen_nsec =
+	seen_nsec3 = seen_ds = ISC_FALSE;
+	for (result = dns_rdatasetiter_first(iterator);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(iterator)) {
+		dns_rdatasetiter_current(iterator, &rdataset);
+		if (rdataset.type == dns_rdatatype_soa)
+			seen_soa = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_ns)
+			seen_ns = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_ds)
+			seen_ds = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_dname)
+			seen_dname = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_nsec)
+			seen_nsec = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_nsec3)
+			seen_nsec3 = ISC_TRUE;
+		if (rdataset.type != dns_rdatatype_rrsig)
+			seen_rr = ISC_TRUE;
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (result != ISC_R_NOMORE)
+		goto failure;
+	if (seen_ns && !seen_soa)
+		*delegation = ISC_TRUE;
+	/*
+	 * Going from insecure to NSEC3.
+	 * Don't generate NSEC3 records for NSEC3 records.
+	 */
+	if (build_nsec3 && !seen_nsec3 && seen_rr) {
+		isc_boolean_t unsecure = !seen_ds && seen_ns && !seen_soa;
+		CHECK(dns_nsec3_addnsec3s(db, version, name, minimum,
+					  unsecure, diff));
 		(*signatures)--;
 	}
 	/*
@@ -6067,24 +6825,19 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	result = dns_rdatasetiter_first(iterator);
 	while (result == ISC_R_SUCCESS) {
 		dns_rdatasetiter_current(iterator, &rdataset);
-		if (rdataset.type == dns_rdatatype_soa ||
-		    rdataset.type == dns_rdatatype_rrsig)
-			goto next_rdataset;
-		if (rdataset.type == dns_rdatatype_dnskey) {
-			if (!is_ksk && keyset_kskonly)
-				goto next_rdataset;
-		} else if (is_ksk)
-			goto next_rdataset;
-		if (*delegation &&
-		    rdataset.type != dns_rdatatype_ds &&
-		    rdataset.type != dns_rdatatype_nsec)
+		if (!sign_wanted(db, node, version, &rdataset, key, is_ksk,
+				 keyset_kskonly, *delegation))
 			goto next_rdataset;
-		if (signed_with_key(db, node, version, rdataset.type, key))
-			goto next_rdataset;
-		/* Calculate the signature, creating a RRSIG RDATA. */
-		isc_buffer_clear(&buffer);
-		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception,
-				      &expire, mctx, &buffer, &rdata));
+		/*
+		 * Calculate the signature, creating a RRSIG RDATA, unless
+		 * it has been computed ahead of this pass.
+		 */
+		if (batch == NULL ||
+		    !signbatch_find(batch, name, &rdataset, key, &rdata)) {
+			isc_buffer_clear(&buffer);
+			CHECK(dns_dnssec_sign(name, &rdataset, key, &inception,
+					      &expire, mctx, &buffer, &rdata));
+		}
 		/* Update the database and journal with the RRSIG. */
 		/* XXX inefficient - will cause dataset merging */
 		CHECK(update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
@@ -6107,6 +6860,325 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	return (result);
 }
 
+/*
+ * Should 'signing' sign with key 'i' of 'keys'?  '*is_ksk' is set if
+ * the key signs as a KSK, and '*both' if the zone has both KSKs and
+ * ZSKs of the key's algorithm.
+ */
+static isc_boolean_t
+signing_usekey(dns_signing_t *signing, dst_key_t **keys, unsigned int nkeys,
+	       unsigned int i, isc_boolean_t check_ksk, isc_boolean_t *is_ksk,
+	       isc_boolean_t *both)
+{
+	isc_boolean_t have_ksk, have_nonksk;
+	unsigned int j;
+
+	*both = ISC_FALSE;
+
+	/*
+	 * Find the keys we want to sign with.
+	 */
+	if (!dst_key_isprivate(keys[i]))
+		return (ISC_FALSE);
+
+	/*
+	 * When adding look for the specific key.
+	 */
+	if (!signing->delete &&
+	    (dst_key_alg(keys[i]) != signing->algorithm ||
+	     dst_key_id(keys[i]) != signing->keyid))
+		return (ISC_FALSE);
+
+	/*
+	 * When deleting make sure we are properly signed
+	 * with the algorithm that was being removed.
+	 */
+	if (signing->delete && ALG(keys[i]) != signing->algorithm)
+		return (ISC_FALSE);
+
+	/*
+	 * Do we do KSK processing?
+	 */
+	if (check_ksk && !REVOKE(keys[i])) {
+		if (KSK(keys[i])) {
+			have_ksk = ISC_TRUE;
+			have_nonksk = ISC_FALSE;
+		} else {
+			have_ksk = ISC_FALSE;
+			have_nonksk = ISC_TRUE;
+		}
+		for (j = 0; j < nkeys; j++) {
+			if (j == i || ALG(keys[i]) != ALG(keys[j]))
+				continue;
+			if (REVOKE(keys[j]))
+				continue;
+			if (KSK(keys[j]))
+				have_ksk = ISC_TRUE;
+			else
+				have_nonksk = ISC_TRUE;
+			*both = have_ksk && have_nonksk;
+			if (*both)
+				break;
+		}
+	}
+	if (*both || REVOKE(keys[i]))
+		*is_ksk = KSK(keys[i]);
+	else
+		*is_ksk = ISC_FALSE;
+	return (ISC_TRUE);
+}
+
+/*
+ * Queue the RRsets at 'node' that zone_sign() is expected to sign with
+ * key 'key' of 'batch', the way sign_a_node() selects them.
+ */
+static isc_result_t
+signbatch_node(signbatch_t *batch, dns_name_t *name, dns_dbnode_t *node,
+	       unsigned int key, isc_boolean_t is_ksk,
+	       isc_boolean_t keyset_kskonly, isc_boolean_t build_nsec3,
+	       isc_boolean_t build_nsec, isc_boolean_t *delegation,
+	       isc_int32_t *signatures)
+{
+	isc_result_t result;
+	dns_rdatasetiter_t *iterator = NULL;
+	dns_rdataset_t rdataset;
+	isc_boolean_t seen_soa, seen_ns, seen_rr, seen_dname, seen_nsec,
+		      seen_nsec3;
+
+	result = dns_db_allrdatasets(batch->db, node, batch->version, 0,
+				     &iterator);
+	if (result != ISC_R_SUCCESS) {
+		if (result == ISC_R_NOTFOUND)
+			result = ISC_R_SUCCESS;
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	seen_rr = seen_soa = seen_ns = seen_dname = seen_nsec =
+	seen_nsec3 = ISC_FALSE;
+	for (result = dns_rdatasetiter_first(iterator);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(iterator)) {
+		dns_rdatasetiter_current(iterator, &rdataset);
+		if (rdataset.type == dns_rdatatype_soa)
+			seen_soa = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_ns)
+			seen_ns = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_dname)
+			seen_dname = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_nsec)
+			seen_nsec = ISC_TRUE;
+		else if (rdataset.type == dns_rdatatype_nsec3)
+			seen_nsec3 = ISC_TRUE;
+		if (rdataset.type != dns_rdatatype_rrsig)
+			seen_rr = ISC_TRUE;
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (result != ISC_R_NOMORE)
+		goto failure;
+	if (seen_ns && !seen_soa)
+		*delegation = ISC_TRUE;
+	/*
+	 * The pass counts the NSEC3 and NSEC records it builds here
+	 * against its signature quota.  A new NSEC is signed by the
+	 * pass itself, as it is not in this version to be queued.
+	 */
+	if (build_nsec3 && !seen_nsec3 && seen_rr)
+		(*signatures)--;
+	if (build_nsec && !seen_nsec3 && !seen_nsec && seen_rr &&
+	    !dns_name_equal(name, dns_db_origin(batch->db))) {
+		(*signatures)--;
+		if (!is_ksk)
+			(*signatures)--;
+	}
+	for (result = dns_rdatasetiter_first(iterator);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(iterator)) {
+		dns_rdatasetiter_current(iterator, &rdataset);
+		if (sign_wanted(batch->db, node, batch->version, &rdataset,
+				batch->keys[key], is_ksk, keyset_kskonly,
+				*delegation)) {
+			CHECK(signbatch_add(batch, name, &rdataset, key));
+			(*signatures)--;
+		}
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (result == ISC_R_NOMORE)
+		result = ISC_R_SUCCESS;
+	if (seen_dname)
+		*delegation = ISC_TRUE;
+ failure:
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	dns_rdatasetiter_destroy(&iterator);
+	return (result);
+}
+
+/*
+ * Start computing the signatures of the next zone_sign() pass on the
+ * zone manager's signing tasks.  Returns ISC_TRUE if they are being
+ * computed; zone_signbatchdone() runs the pass when they are.  Nodes
+ * and RRsets are picked as the pass picks them, but from the current
+ * version and without the pass's own changes, so a few guesses may be
+ * wrong: those signatures go unused, and anything missing is signed
+ * by the pass itself.
+ */
+static isc_boolean_t
+zone_signahead(dns_zone_t *zone) {
+	const char me[] = "zone_signahead";
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_dbiterator_t *dbiterator = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed, fcut;
+	dns_name_t *name, *cut;
+	dns_signing_t *signing;
+	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
+	dst_key_t *key;
+	signbatch_t *batch = NULL;
+	isc_boolean_t check_ksk, keyset_kskonly, kskonly, is_ksk, both;
+	isc_boolean_t build_nsec = ISC_FALSE;
+	isc_boolean_t build_nsec3 = ISC_FALSE;
+	isc_boolean_t delegation, started = ISC_FALSE;
+	isc_int32_t signatures;
+	isc_uint32_t nodes, jitter;
+	isc_stdtime_t now, inception, expire;
+	unsigned int i, nkeys = 0, helpers = 0;
+	isc_result_t result;
+
+	ENTER;
+
+	if (zone->update_disabled || zone->zmgr == NULL || zone->task == NULL)
+		return (ISC_FALSE);
+
+	RWLOCK(&zone->zmgr->rwlock, isc_rwlocktype_read);
+	if (zone->zmgr->signtasks != NULL)
+		helpers = isc_taskpool_size(zone->zmgr->signtasks);
+	RWUNLOCK(&zone->zmgr->rwlock, isc_rwlocktype_read);
+	if (helpers == 0)
+		return (ISC_FALSE);
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL)
+		dns_db_attach(zone->db, &db);
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+	if (db == NULL)
+		return (ISC_FALSE);
+	dns_db_currentversion(db, &version);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_fixedname_init(&fcut);
+	cut = dns_fixedname_name(&fcut);
+
+	CHECK(find_zone_keys(zone, db, version, zone->mctx, DNS_MAXZONEKEYS,
+			     zone_keys, &nkeys));
+	if (nkeys == 0)
+		goto failure;
+
+	/*
+	 * As zone_sign() does; the pass uses these times.
+	 */
+	isc_stdtime_get(&now);
+	inception = now - 3600;
+	isc_random_get(&jitter);
+	expire = now + dns_zone_getsigvalidityinterval(zone) - jitter % 3600;
+
+	CHECK(signbatch_create(zone, db, version, zone_keys, nkeys, helpers,
+			       inception, expire, &batch));
+	nkeys = 0;
+
+	CHECK(dns_private_chains(db, version, zone->privatetype,
+				 &build_nsec, &build_nsec3));
+	if (!build_nsec && !build_nsec3)
+		build_nsec = ISC_TRUE;
+
+	check_ksk = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_UPDATECHECKKSK);
+	keyset_kskonly = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_DNSKEYKSKONLY);
+	nodes = zone->nodes * (1 + helpers);
+	signatures = zone->signatures * (1 + helpers);
+
+	for (signing = ISC_LIST_HEAD(zone->signing);
+	     signing != NULL && nodes > 0 && signatures > 0;
+	     signing = ISC_LIST_NEXT(signing, link))
+	{
+		if (signing->done || signing->db != db)
+			continue;
+
+		/*
+		 * Walk from where the signing's own iterator is.
+		 */
+		dns_dbiterator_current(signing->dbiterator, &node, name);
+		dns_db_detachnode(db, &node);
+		dns_dbiterator_pause(signing->dbiterator);
+		CHECK(dns_db_createiterator(db, 0, &dbiterator));
+		result = dns_dbiterator_seek(dbiterator, name);
+		delegation = ISC_FALSE;
+		while (result == ISC_R_SUCCESS && nodes-- > 0 &&
+		       signatures > 0)
+		{
+			dns_dbiterator_current(dbiterator, &node, name);
+			dns_dbiterator_pause(dbiterator);
+			if (delegation && dns_name_issubdomain(name, cut))
+				goto next_node;
+			delegation = ISC_FALSE;
+			for (i = 0; i < batch->nkeys; i++) {
+				key = batch->keys[i];
+				/*
+				 * zone_sign() drops the key being deleted.
+				 */
+				if (signing->delete &&
+				    ALG(key) == signing->algorithm &&
+				    dst_key_id(key) == signing->keyid)
+					continue;
+				if (!signing_usekey(signing, batch->keys,
+						    batch->nkeys, i, check_ksk,
+						    &is_ksk, &both))
+					continue;
+				kskonly = ISC_TF(both && keyset_kskonly);
+				CHECK(signbatch_node(batch, name, node, i,
+						     is_ksk, kskonly,
+						     build_nsec3, build_nsec,
+						     &delegation, &signatures));
+				if (!signing->delete)
+					break;
+			}
+			if (delegation)
+				dns_name_copy(name, cut, NULL);
+ next_node:
+			dns_db_detachnode(db, &node);
+			result = dns_dbiterator_next(dbiterator);
+		}
+		dns_dbiterator_destroy(&dbiterator);
+		if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE)
+			goto failure;
+	}
+	result = ISC_R_SUCCESS;
+
+	if (batch->njobs == 0)
+		goto failure;
+	CHECK(signbatch_start(zone, batch));
+	zone->signbatch = batch;
+	batch = NULL;
+	started = ISC_TRUE;
+
+ failure:
+	if (result != ISC_R_SUCCESS)
+		dns_zone_log(zone, ISC_LOG_DEBUG(1), "zone_signahead -> %s",
+			     dns_result_totext(result));
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+	if (dbiterator != NULL)
+		dns_dbiterator_destroy(&dbiterator);
+	if (batch != NULL)
+		signbatch_destroy(&batch);
+	for (i = 0; i < nkeys; i++)
+		dst_key_free(&zone_keys[i]);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	dns_db_detach(&db);
+	return (started);
+}
+
 /*
  * If 'update_only' is set then don't create a NSEC RRset if it doesn't exist.
  */
@@ -7463,7 +8535,8 @@ zone_sign(dns_zone_t *zone) {
 	isc_int32_t signatures;
 	isc_boolean_t check_ksk, keyset_kskonly, is_ksk;
 	isc_boolean_t commit = ISC_FALSE;
-	isc_boolean_t delegation;
+	isc_boolean_t delegation, stale;
+	signbatch_t *batch = NULL;
 	isc_boolean_t build_nsec = ISC_FALSE;
 	isc_boolean_t build_nsec3 = ISC_FALSE;
 	isc_boolean_t first;
@@ -7472,10 +8545,26 @@ zone_sign(dns_zone_t *zone) {
 	isc_uint32_t jitter;
 	unsigned int i, j;
 	unsigned int nkeys = 0;
-	isc_uint32_t nodes;
+	unsigned int scale = 1;
+	isc_uint32_t nodes, nodesigs;
 
 	ENTER;
 
+	/*
+	 * The signatures of this pass are still being computed; it runs
+	 * when they are done.
+	 */
+	batch = zone->signbatch;
+	if (batch != NULL && !batch->complete) {
+		isc_time_settoepoch(&zone->signingtime);
+		return;
+	}
+	zone->signbatch = NULL;
+	if (batch == NULL && zone_signahead(zone)) {
+		isc_time_settoepoch(&zone->signingtime);
+		return;
+	}
+
 	dns_rdataset_init(&rdataset);
 	dns_fixedname_init(&fixed);
 	name = dns_fixedname_name(&fixed);
@@ -7532,13 +8621,29 @@ zone_sign(dns_zone_t *zone) {
 	isc_random_get(&jitter);
 	expire = soaexpire - jitter % 3600;
 
+	/*
+	 * Signatures computed ahead of the pass carry the times they
+	 * were made with.
+	 */
+	if (batch != NULL) {
+		inception = batch->inception;
+		expire = batch->expire;
+	}
+
 	/*
 	 * We keep pulling nodes off each iterator in turn until
 	 * we have no more nodes to pull off or we reach the limits
-	 * for this quantum.
+	 * for this quantum.  Each signing task adds a quantum's worth
+	 * of signatures.
 	 */
-	nodes = zone->nodes;
-	signatures = zone->signatures;
+	if (zone->zmgr != NULL) {
+		RWLOCK(&zone->zmgr->rwlock, isc_rwlocktype_read);
+		if (zone->zmgr->signtasks != NULL)
+			scale += isc_taskpool_size(zone->zmgr->signtasks);
+		RWUNLOCK(&zone->zmgr->rwlock, isc_rwlocktype_read);
+	}
+	nodes = zone->nodes * scale;
+	signatures = zone->signatures * scale;
 	signing = ISC_LIST_HEAD(zone->signing);
 	first = ISC_TRUE;
 
@@ -7557,23 +8662,26 @@ zone_sign(dns_zone_t *zone) {
 		nextsigning = ISC_LIST_NEXT(signing, link);
 
 		ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
-		if (signing->done || signing->db != zone->db) {
+		stale = ISC_TF(signing->done || signing->db != zone->db);
+		ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+		if (stale) {
 			/*
 			 * The zone has been reloaded.	We will have
 			 * created new signings as part of the reload
 			 * process so we can destroy this one.
 			 */
+			LOCK_ZONE(zone);
 			ISC_LIST_UNLINK(zone->signing, signing, link);
+			UNLOCK_ZONE(zone);
 			ISC_LIST_APPEND(cleanup, signing, link);
-			ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
 			goto next_signing;
 		}
-		ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
 
 		if (signing->db != db)
 			goto next_signing;
 
 		delegation = ISC_FALSE;
+		nodesigs = 0;
 
 		if (first && signing->delete) {
 			/*
@@ -7637,68 +8745,19 @@ zone_sign(dns_zone_t *zone) {
 		dns_dbiterator_pause(signing->dbiterator);
 		for (i = 0; i < nkeys; i++) {
 			isc_boolean_t both = ISC_FALSE;
+			isc_int32_t before = signatures;
 
-			/*
-			 * Find the keys we want to sign with.
-			 */
-			if (!dst_key_isprivate(zone_keys[i]))
-				continue;
-
-			/*
-			 * When adding look for the specific key.
-			 */
-			if (!signing->delete &&
-			    (dst_key_alg(zone_keys[i]) != signing->algorithm ||
-			     dst_key_id(zone_keys[i]) != signing->keyid))
-				continue;
-
-			/*
-			 * When deleting make sure we are properly signed
-			 * with the algorithm that was being removed.
-			 */
-			if (signing->delete &&
-			    ALG(zone_keys[i]) != signing->algorithm)
+			if (!signing_usekey(signing, zone_keys, nkeys, i,
+					    check_ksk, &is_ksk, &both))
 				continue;
 
-			/*
-			 * Do we do KSK processing?
-			 */
-			if (check_ksk && !REVOKE(zone_keys[i])) {
-				isc_boolean_t have_ksk, have_nonksk;
-				if (KSK(zone_keys[i])) {
-					have_ksk = ISC_TRUE;
-					have_nonksk = ISC_FALSE;
-				} else {
-					have_ksk = ISC_FALSE;
-					have_nonksk = ISC_TRUE;
-				}
-				for (j = 0; j < nkeys; j++) {
-					if (j == i ||
-					    ALG(zone_keys[i]) !=
-					    ALG(zone_keys[j]))
-						continue;
-					if (REVOKE(zone_keys[j]))
-						continue;
-					if (KSK(zone_keys[j]))
-						have_ksk = ISC_TRUE;
-					else
-						have_nonksk = ISC_TRUE;
-					both = have_ksk && have_nonksk;
-					if (both)
-						break;
-				}
-			}
-			if (both || REVOKE(zone_keys[i]))
-				is_ksk = KSK(zone_keys[i]);
-			else
-				is_ksk = ISC_FALSE;
-
 			CHECK(sign_a_node(db, name, node, version, build_nsec3,
 					  build_nsec, zone_keys[i], inception,
 					  expire, zone->minimum, is_ksk,
 					  ISC_TF(both && keyset_kskonly),
 					  &delegation, zonediff.diff,
-					  &signatures, zone->mctx));
+					  &signatures, zone->mctx, batch));
+			nodesigs += before - signatures;
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -7708,15 +8767,22 @@ zone_sign(dns_zone_t *zone) {
 		}
 
 		/*
-		 * Go onto next node.
+		 * Go onto next node.  The progress counters are read by
+		 * dns_zone_getsigningprogress() under the zone lock.
 		 */
  next_node:
 		first = ISC_FALSE;
+		LOCK_ZONE(zone);
+		signing->nodes++;
+		signing->signatures += nodesigs;
+		UNLOCK_ZONE(zone);
 		dns_db_detachnode(db, &node);
 		do {
 			result = dns_dbiterator_next(signing->dbiterator);
 			if (result == ISC_R_NOMORE) {
+				LOCK_ZONE(zone);
 				ISC_LIST_UNLINK(zone->signing, signing, link);
+				UNLOCK_ZONE(zone);
 				ISC_LIST_APPEND(cleanup, signing, link);
 				dns_dbiterator_pause(signing->dbiterator);
 				if (nkeys != 0 && build_nsec) {
@@ -7878,9 +8944,17 @@ zone_sign(dns_zone_t *zone) {
 	}
 
  failure:
+	if (batch != NULL) {
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "zone_sign: used %u of %u signatures computed "
+			     "ahead", batch->used, batch->njobs);
+		signbatch_destroy(&batch);
+	}
+
 	/*
 	 * Rollback the cleanup list.
 	 */
+	LOCK_ZONE(zone);
 	signing = ISC_LIST_HEAD(cleanup);
 	while (signing != NULL) {
 		ISC_LIST_UNLINK(cleanup, signing, link);
@@ -7889,6 +8963,7 @@ zone_sign(dns_zone_t *zone) {
 		dns_dbiterator_pause(signing->dbiterator);
 		signing = ISC_LIST_HEAD(cleanup);
 	}
+	UNLOCK_ZONE(zone);
 
 	for (signing = ISC_LIST_HEAD(zone->signing);
 	     signing != NULL;
@@ -7922,6 +8997,42 @@ zone_sign(dns_zone_t *zone) {
 	INSIST(version == NULL);
 }
 
+/*
+ * The signing tasks have computed the signatures of the next
+ * zone_sign() pass: run it.
+ */
+static void
+zone_signbatchdone(isc_task_t *task, isc_event_t *event) {
+	const char me[] = "zone_signbatchdone";
+	dns_zone_t *zone = event->ev_arg;
+	isc_boolean_t exiting;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	INSIST(event->ev_type == DNS_EVENT_ZONESIGNDONE);
+	INSIST(DNS_ZONE_VALID(zone));
+	isc_event_free(&event);
+
+	ENTER;
+
+	INSIST(zone->signbatch != NULL);
+	zone->signbatch->complete = ISC_TRUE;
+	LOCK_ZONE(zone);
+	exiting = DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING);
+	UNLOCK_ZONE(zone);
+	if (exiting)
+		signbatch_destroy(&zone->signbatch);
+	else {
+		zone_sign(zone);
+		TIME_NOW(&now);
+		LOCK_ZONE(zone);
+		zone_settimer(zone, &now);
+		UNLOCK_ZONE(zone);
+	}
+	dns_zone_idetach(&zone);
+}
+
 static isc_result_t
 normalize_key(dns_rdata_t *rr, dns_rdata_t *target,
 	      unsigned char *data, int size)
@@ -9668,11 +10779,11 @@ notify_isself(dns_zone_t *zone, isc_sockaddr_t *dst) {
 
 	switch (isc_sockaddr_pf(dst)) {
 	case PF_INET:
-		src = zone->notifysrc4;
+		src = zone->sources->notifysrc4;
 		isc_sockaddr_any(&any);
 		break;
 	case PF_INET6:
-		src = zone->notifysrc6;
+		src = zone->sources->notifysrc6;
 		isc_sockaddr_any6(&any);
 		break;
 	default:
@@ -9933,11 +11044,11 @@ notify_send_toaddr(isc_task_t *task, isc_event_t *event) {
 	switch (isc_sockaddr_pf(&notify->dst)) {
 	case PF_INET:
 		if (!have_notifysource)
-			src = notify->zone->notifysrc4;
+			src = notify->zone->sources->notifysrc4;
 		break;
 	case PF_INET6:
 		if (!have_notifysource)
-			src = notify->zone->notifysrc6;
+			src = notify->zone->sources->notifysrc6;
 		break;
 	default:
 		result = ISC_R_NOTIMPLEMENTED;
@@ -11198,21 +12309,21 @@ soa_query(isc_task_t *task, isc_event_t *event) {
 	switch (isc_sockaddr_pf(&zone->masteraddr)) {
 	case PF_INET:
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_USEALTXFRSRC)) {
-			if (isc_sockaddr_equal(&zone->altxfrsource4,
-					       &zone->xfrsource4))
+			if (isc_sockaddr_equal(&zone->sources->altxfrsource4,
+					       &zone->sources->xfrsource4))
 				goto skip_master;
-			zone->sourceaddr = zone->altxfrsource4;
+			zone->sourceaddr = zone->sources->altxfrsource4;
 		} else if (!have_xfrsource)
-			zone->sourceaddr = zone->xfrsource4;
+			zone->sourceaddr = zone->sources->xfrsource4;
 		break;
 	case PF_INET6:
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_USEALTXFRSRC)) {
-			if (isc_sockaddr_equal(&zone->altxfrsource6,
-					       &zone->xfrsource6))
+			if (isc_sockaddr_equal(&zone->sources->altxfrsource6,
+					       &zone->sources->xfrsource6))
 				goto skip_master;
-			zone->sourceaddr = zone->altxfrsource6;
+			zone->sourceaddr = zone->sources->altxfrsource6;
 		} else if (!have_xfrsource)
-			zone->sourceaddr = zone->xfrsource6;
+			zone->sourceaddr = zone->sources->xfrsource6;
 		break;
 	default:
 		result = ISC_R_NOTIMPLEMENTED;
@@ -11447,15 +12558,15 @@ ns_query(dns_zone_t *zone, dns_rdataset_t *soardataset, dns_stub_t *stub) {
 	switch (isc_sockaddr_pf(&zone->masteraddr)) {
 	case PF_INET:
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_USEALTXFRSRC))
-			zone->sourceaddr = zone->altxfrsource4;
+			zone->sourceaddr = zone->sources->altxfrsource4;
 		else if (!have_xfrsource)
-			zone->sourceaddr = zone->xfrsource4;
+			zone->sourceaddr = zone->sources->xfrsource4;
 		break;
 	case PF_INET6:
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_USEALTXFRSRC))
-			zone->sourceaddr = zone->altxfrsource6;
+			zone->sourceaddr = zone->sources->altxfrsource6;
 		else if (!have_xfrsource)
-			zone->sourceaddr = zone->xfrsource6;
+			zone->sourceaddr = zone->sources->xfrsource6;
 		break;
 	default:
 		result = ISC_R_NOTIMPLEMENTED;
@@ -11585,12 +12696,6 @@ zone_shutdown(isc_task_t *task, isc_event_t *event) {
 
 	forward_cancel(zone);
 
-	if (zone->timer != NULL) {
-		isc_timer_detach(&zone->timer);
-		INSIST(zone->irefs > 0);
-		zone->irefs--;
-	}
-
 	if (zone->view != NULL)
 		dns_view_weakdetach(&zone->view);
 
@@ -11622,13 +12727,30 @@ static void
 zone_timer(isc_task_t *task, isc_event_t *event) {
 	const char me[] = "zone_timer";
 	dns_zone_t *zone = (dns_zone_t *)event->ev_arg;
+	dns_zonemgr_t *zmgr;
 
 	UNUSED(task);
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	ENTER;
 
-	zone_maintenance(zone);
+	/*
+	 * The zone manager purges this event when it releases the zone,
+	 * with the zone locked; if it was already running, the release
+	 * has forgotten it and the zone is no longer maintained.
+	 */
+	LOCK_ZONE(zone);
+	zmgr = zone->zmgr;
+	if (zmgr != NULL) {
+		LOCK(&zmgr->timerlock);
+		INSIST(zone->timerevent == event);
+		zone->timerevent = NULL;
+		UNLOCK(&zmgr->timerlock);
+	}
+	UNLOCK_ZONE(zone);
+
+	if (zmgr != NULL)
+		zone_maintenance(zone);
 
 	isc_event_free(&event);
 }
@@ -11641,7 +12763,7 @@ zone_settimer(dns_zone_t *zone, isc_time_t *now) {
 
 	ENTER;
 	REQUIRE(DNS_ZONE_VALID(zone));
-	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING))
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING) || zone->zmgr == NULL)
 		return;
 
 	isc_time_settoepoch(&next);
@@ -11746,8 +12868,7 @@ zone_settimer(dns_zone_t *zone, isc_time_t *now) {
 
 	if (isc_time_isepoch(&next)) {
 		zone_debuglog(zone, me, 10, "settimer inactive");
-		result = isc_timer_reset(zone->timer, isc_timertype_inactive,
-					  NULL, NULL, ISC_TRUE);
+		result = zonemgr_settimer(zone->zmgr, zone, &next);
 		if (result != ISC_R_SUCCESS)
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "could not deactivate zone timer: %s",
@@ -11755,8 +12876,7 @@ zone_settimer(dns_zone_t *zone, isc_time_t *now) {
 	} else {
 		if (isc_time_compare(&next, now) <= 0)
 			next = *now;
-		result = isc_timer_reset(zone->timer, isc_timertype_once,
-					 &next, NULL, ISC_TRUE);
+		result = zonemgr_settimer(zone->zmgr, zone, &next);
 		if (result != ISC_R_SUCCESS)
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "could not reset zone timer: %s",
@@ -13430,6 +14550,7 @@ receive_secure_db(isc_task_t *task, isc_event_t *event) {
 			       zone->db_argc - 1, zone->db_argv + 1, &db);
 	if (result != ISC_R_SUCCESS)
 		goto failure;
+	dns_zone_sharedb(zone, db);
 
 	result = dns_db_newversion(db, &version);
 	if (result != ISC_R_SUCCESS)
@@ -13775,6 +14896,14 @@ zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(zone->db == NULL && db != NULL);
 
 	dns_db_attach(db, &zone->db);
+#ifdef BIND9
+	/*
+	 * The zone may have been given another summary by a
+	 * reconfiguration while the database was being loaded.
+	 */
+	if (zone->is_rpz)
+		dns_db_rpz_setsummary(db, zone->rpz_summary, zone->rpz_num);
+#endif
 	if (zone->acache != NULL) {
 		isc_result_t result;
 		result = dns_acache_setdb(zone->acache, db);
@@ -13784,6 +14913,7 @@ zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 					 isc_result_totext(result));
 		}
 	}
+	dns_db_newgeneration();
 }
 
 /* The caller must hold the dblock as a writer. */
@@ -13794,6 +14924,7 @@ zone_detachdb(dns_zone_t *zone) {
 	if (zone->acache != NULL)
 		(void)dns_acache_putdb(zone->acache, zone->db);
 	dns_db_detach(&zone->db);
+	dns_db_newgeneration();
 }
 
 static void
@@ -14420,10 +15551,10 @@ sendtomaster(dns_forward_t *forward) {
 	 */
 	switch (isc_sockaddr_pf(&forward->addr)) {
 	case PF_INET:
-		src = forward->zone->xfrsource4;
+		src = forward->zone->sources->xfrsource4;
 		break;
 	case PF_INET6:
-		src = forward->zone->xfrsource6;
+		src = forward->zone->sources->xfrsource6;
 		break;
 	default:
 		result = ISC_R_NOTIMPLEMENTED;
@@ -14658,6 +15789,7 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	zmgr->socketmgr = socketmgr;
 	zmgr->zonetasks = NULL;
 	zmgr->loadtasks = NULL;
+	zmgr->signtasks = NULL;
 	zmgr->mctxpool = NULL;
 	zmgr->task = NULL;
 	zmgr->notifyrl = NULL;
@@ -14714,6 +15846,7 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 
 	zmgr->iolimit = 1;
 	zmgr->ioactive = 0;
+	zmgr->slabstore = NULL;
 	ISC_LIST_INIT(zmgr->high);
 	ISC_LIST_INIT(zmgr->low);
 
@@ -14721,15 +15854,35 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	if (result != ISC_R_SUCCESS)
 		goto free_startuprefreshrl;
 
+	zmgr->timerheap = NULL;
+	zmgr->timer = NULL;
+	isc_time_settoepoch(&zmgr->timerdue);
+	result = isc_mutex_init(&zmgr->timerlock);
+	if (result != ISC_R_SUCCESS)
+		goto free_iolock;
+
+	result = isc_heap_create(mctx, timer_less, timer_index, 0,
+				 &zmgr->timerheap);
+	if (result != ISC_R_SUCCESS)
+		goto free_timerlock;
+
+	result = isc_timer_create(timermgr, isc_timertype_inactive,
+				  NULL, NULL, zmgr->task, zmgr_timer, zmgr,
+				  &zmgr->timer);
+	if (result != ISC_R_SUCCESS)
+		goto free_timerheap;
+
 	zmgr->magic = ZONEMGR_MAGIC;
 
 	*zmgrp = zmgr;
 	return (ISC_R_SUCCESS);
 
-#if 0
+ free_timerheap:
+	isc_heap_destroy(&zmgr->timerheap);
+ free_timerlock:
+	DESTROYLOCK(&zmgr->timerlock);
  free_iolock:
 	DESTROYLOCK(&zmgr->iolock);
-#endif
  free_startuprefreshrl:
 	isc_ratelimiter_detach(&zmgr->startuprefreshrl);
  free_startupnotifyrl:
@@ -14777,10 +15930,146 @@ dns_zonemgr_createzone(dns_zonemgr_t *zmgr, dns_zone_t **zonep) {
 	return (result);
 }
 
-isc_result_t
-dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
+/*
+ * Zone maintenance timers.
+ */
+static isc_boolean_t
+timer_less(void *v1, void *v2) {
+	dns_zone_t *z1 = v1, *z2 = v2;
+
+	return (ISC_TF(isc_time_compare(&z1->timerdue, &z2->timerdue) < 0));
+}
+
+static void
+timer_index(void *what, unsigned int index) {
+	dns_zone_t *zone = what;
+
+	zone->timerindex = index;
+}
+
+/*
+ * Make the zone manager's timer fire for the earliest zone timer.
+ * Called with timerlock held.
+ */
+static isc_result_t
+zmgr_resettimer(dns_zonemgr_t *zmgr) {
+	dns_zone_t *first;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (zmgr->timer == NULL)
+		return (ISC_R_SHUTTINGDOWN);
+
+	first = isc_heap_element(zmgr->timerheap, 1);
+	if (first == NULL) {
+		if (!isc_time_isepoch(&zmgr->timerdue))
+			result = isc_timer_reset(zmgr->timer,
+						 isc_timertype_inactive,
+						 NULL, NULL, ISC_TRUE);
+		isc_time_settoepoch(&zmgr->timerdue);
+	} else if (isc_time_compare(&first->timerdue, &zmgr->timerdue) != 0) {
+		result = isc_timer_reset(zmgr->timer, isc_timertype_once,
+					 &first->timerdue, NULL, ISC_TRUE);
+		if (result == ISC_R_SUCCESS)
+			zmgr->timerdue = first->timerdue;
+	}
+	return (result);
+}
+
+/*
+ * Run maintenance on 'zone' at 'due', or never if 'due' is the epoch.
+ */
+static isc_result_t
+zonemgr_settimer(dns_zonemgr_t *zmgr, dns_zone_t *zone,
+		 const isc_time_t *due)
+{
+	isc_result_t result = ISC_R_SUCCESS;
+	int cmp;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK(&zmgr->timerlock);
+	if (isc_time_isepoch(due)) {
+		if (zone->timerindex != 0) {
+			isc_heap_delete(zmgr->timerheap, zone->timerindex);
+			zone->timerindex = 0;
+		}
+	} else if (zone->timerindex == 0) {
+		zone->timerdue = *due;
+		result = isc_heap_insert(zmgr->timerheap, zone);
+	} else {
+		cmp = isc_time_compare(due, &zone->timerdue);
+		zone->timerdue = *due;
+		if (cmp < 0)
+			isc_heap_increased(zmgr->timerheap, zone->timerindex);
+		else if (cmp > 0)
+			isc_heap_decreased(zmgr->timerheap, zone->timerindex);
+	}
+	if (result == ISC_R_SUCCESS)
+		result = zmgr_resettimer(zmgr);
+	UNLOCK(&zmgr->timerlock);
+
+	return (result);
+}
+
+/*
+ * Post a timer event to each zone whose timer is due.
+ */
+static void
+zmgr_timer(isc_task_t *task, isc_event_t *event) {
+	dns_zonemgr_t *zmgr = event->ev_arg;
+	dns_zone_t *zone;
+	isc_event_t *ev;
+	isc_interval_t interval;
+	isc_time_t now;
 	isc_result_t result;
 
+	UNUSED(task);
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	isc_event_free(&event);
+
+	TIME_NOW(&now);
+	isc_interval_set(&interval, 1, 0);
+
+	LOCK(&zmgr->timerlock);
+	isc_time_settoepoch(&zmgr->timerdue);
+	while ((zone = isc_heap_element(zmgr->timerheap, 1)) != NULL &&
+	       isc_time_compare(&zone->timerdue, &now) <= 0)
+	{
+		if (zone->timerevent == NULL) {
+			ev = isc_event_allocate(zone->mctx, zone,
+						DNS_EVENT_ZONETIMER,
+						zone_timer, zone,
+						sizeof(isc_event_t));
+			if (ev == NULL &&
+			    isc_time_add(&now, &interval,
+					 &zone->timerdue) == ISC_R_SUCCESS)
+			{
+				/* Try again in a second. */
+				isc_heap_decreased(zmgr->timerheap, 1);
+				continue;
+			}
+			if (ev != NULL) {
+				zone->timerevent = ev;
+				isc_task_send(zone->task, &ev);
+			}
+		}
+		isc_heap_delete(zmgr->timerheap, 1);
+		zone->timerindex = 0;
+	}
+	result = zmgr_resettimer(zmgr);
+	UNLOCK(&zmgr->timerlock);
+
+	if (result != ISC_R_SUCCESS && result != ISC_R_SHUTTINGDOWN)
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_ZONE, ISC_LOG_ERROR,
+			      "could not reset zone manager timer: %s",
+			      isc_result_totext(result));
+}
+
+isc_result_t
+dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	REQUIRE(DNS_ZONE_VALID(zone));
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
@@ -14790,7 +16079,6 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 	LOCK_ZONE(zone);
 	REQUIRE(zone->task == NULL);
-	REQUIRE(zone->timer == NULL);
 	REQUIRE(zone->zmgr == NULL);
 
 	isc_taskpool_gettask(zmgr->zonetasks, &zone->task);
@@ -14804,34 +16092,13 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	isc_task_setname(zone->task, "zone", zone);
 	isc_task_setname(zone->loadtask, "loadzone", zone);
 
-	result = isc_timer_create(zmgr->timermgr, isc_timertype_inactive,
-				  NULL, NULL,
-				  zone->task, zone_timer, zone,
-				  &zone->timer);
-
-	if (result != ISC_R_SUCCESS)
-		goto cleanup_tasks;
-
-	/*
-	 * The timer "holds" a iref.
-	 */
-	zone->irefs++;
-	INSIST(zone->irefs != 0);
-
 	ISC_LIST_APPEND(zmgr->zones, zone, link);
 	zone->zmgr = zmgr;
 	zmgr->refs++;
 
-	goto unlock;
-
- cleanup_tasks:
-	isc_task_detach(&zone->loadtask);
-	isc_task_detach(&zone->task);
-
- unlock:
 	UNLOCK_ZONE(zone);
 	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
-	return (result);
+	return (ISC_R_SUCCESS);
 }
 
 void
@@ -14848,6 +16115,23 @@ dns_zonemgr_releasezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	ISC_LIST_UNLINK(zmgr->zones, zone, link);
 	zone->zmgr = NULL;
 	zmgr->refs--;
+
+	/*
+	 * Stop the zone's timer.  A posted timer event that has not run
+	 * yet is purged; one that is running checks zone->zmgr under the
+	 * zone lock and gives up.  The caller need not be in the zone's
+	 * task.
+	 */
+	LOCK(&zmgr->timerlock);
+	if (zone->timerindex != 0) {
+		isc_heap_delete(zmgr->timerheap, zone->timerindex);
+		zone->timerindex = 0;
+	}
+	if (zone->timerevent != NULL) {
+		(void)isc_task_purgeevent(zone->task, zone->timerevent);
+		zone->timerevent = NULL;
+	}
+	UNLOCK(&zmgr->timerlock);
 	if (zmgr->refs == 0)
 		free_now = ISC_TRUE;
 
@@ -14940,12 +16224,21 @@ dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 	isc_ratelimiter_shutdown(zmgr->startupnotifyrl);
 	isc_ratelimiter_shutdown(zmgr->startuprefreshrl);
 
+	LOCK(&zmgr->timerlock);
+	if (zmgr->timer != NULL)
+		isc_timer_detach(&zmgr->timer);
+	UNLOCK(&zmgr->timerlock);
+
 	if (zmgr->task != NULL)
 		isc_task_destroy(&zmgr->task);
 	if (zmgr->zonetasks != NULL)
 		isc_taskpool_destroy(&zmgr->zonetasks);
 	if (zmgr->loadtasks != NULL)
 		isc_taskpool_destroy(&zmgr->loadtasks);
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->signtasks != NULL)
+		isc_taskpool_destroy(&zmgr->signtasks);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 	if (zmgr->mctxpool != NULL)
 		isc_pool_destroy(&zmgr->mctxpool);
 
@@ -15060,6 +16353,41 @@ dns_zonemgr_setsize(dns_zonemgr_t *zmgr, int num_zones) {
 	return (result);
 }
 
+isc_result_t
+dns_zonemgr_setsigningtasks(dns_zonemgr_t *zmgr, unsigned int ntasks) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_taskpool_t *pool = NULL;
+	unsigned int current = 0;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+#ifdef ISC_PLATFORM_USETHREADS
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	if (zmgr->signtasks != NULL)
+		current = isc_taskpool_size(zmgr->signtasks);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	if (current == ntasks)
+		return (ISC_R_SUCCESS);
+
+	if (ntasks > 0)
+		result = isc_taskpool_create(zmgr->taskmgr, zmgr->mctx,
+					     ntasks, 1, &pool);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#else
+	UNUSED(ntasks);
+	UNUSED(current);
+#endif
+
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->signtasks != NULL)
+		isc_taskpool_destroy(&zmgr->signtasks);
+	zmgr->signtasks = pool;
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+
+	return (ISC_R_SUCCESS);
+}
+
 static void
 zonemgr_free(dns_zonemgr_t *zmgr) {
 	isc_mem_t *mctx;
@@ -15069,7 +16397,14 @@ zonemgr_free(dns_zonemgr_t *zmgr) {
 
 	zmgr->magic = 0;
 
+	if (zmgr->timer != NULL)
+		isc_timer_detach(&zmgr->timer);
+	INSIST(isc_heap_element(zmgr->timerheap, 1) == NULL);
+	isc_heap_destroy(&zmgr->timerheap);
+	DESTROYLOCK(&zmgr->timerlock);
 	DESTROYLOCK(&zmgr->iolock);
+	if (zmgr->slabstore != NULL)
+		dns_slabstore_detach(&zmgr->slabstore);
 	isc_ratelimiter_detach(&zmgr->notifyrl);
 	isc_ratelimiter_detach(&zmgr->refreshrl);
 	isc_ratelimiter_detach(&zmgr->startupnotifyrl);
@@ -15272,6 +16607,19 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr) {
 	return (zmgr->iolimit);
 }
 
+void
+dns_zonemgr_setslabstore(dns_zonemgr_t *zmgr, dns_slabstore_t *store) {
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->slabstore != NULL)
+		dns_slabstore_detach(&zmgr->slabstore);
+	if (store != NULL)
+		dns_slabstore_attach(store, &zmgr->slabstore);
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+}
+
 /*
  * Get permission to request a file handle from the OS.
  * An event will be sent to action when one is available.
@@ -15704,6 +17052,19 @@ dns_zone_setrcvquerystats(dns_zone_t *zone, dns_stats_t *stats) {
 }
 #endif
 
+void
+dns_zone_setlatencyhisto(dns_zone_t *zone, isc_histo_t *histo) {
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	if (zone->requeststats_on && histo != NULL) {
+		if (zone->latencyhisto == NULL)
+			isc_histo_attach(histo, &zone->latencyhisto);
+	}
+	UNLOCK_ZONE(zone);
+}
+
 isc_stats_t *
 dns_zone_getrequeststats(dns_zone_t *zone) {
 	/*
@@ -15734,6 +17095,17 @@ dns_zone_getrcvquerystats(dns_zone_t *zone) {
 }
 #endif
 
+/*
+ * See note from dns_zone_getrequeststats().
+ */
+isc_histo_t *
+dns_zone_getlatencyhisto(dns_zone_t *zone) {
+	if (zone->requeststats_on)
+		return (zone->latencyhisto);
+	else
+		return (NULL);
+}
+
 void
 dns_zone_dialup(dns_zone_t *zone) {
 
@@ -15962,6 +17334,39 @@ dns_zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm,
 	return (result);
 }
 
+isc_result_t
+dns_zone_getsigningprogress(dns_zone_t *zone, dns_secalg_t algorithm,
+			    isc_uint16_t keyid, isc_uint32_t *nodes,
+			    isc_uint32_t *signatures, isc_uint32_t *seconds)
+{
+	isc_result_t result = ISC_R_NOTFOUND;
+	dns_signing_t *signing;
+	isc_time_t now;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(nodes != NULL && signatures != NULL && seconds != NULL);
+
+	TIME_NOW(&now);
+	LOCK_ZONE(zone);
+	for (signing = ISC_LIST_HEAD(zone->signing);
+	     signing != NULL;
+	     signing = ISC_LIST_NEXT(signing, link))
+	{
+		if (signing->algorithm != algorithm ||
+		    signing->keyid != keyid || signing->done)
+			continue;
+		*nodes = signing->nodes;
+		*signatures = signing->signatures;
+		*seconds = isc_time_seconds(&now) -
+			   isc_time_seconds(&signing->start);
+		result = ISC_R_SUCCESS;
+		break;
+	}
+	UNLOCK_ZONE(zone);
+
+	return (result);
+}
+
 static const char *hex = "0123456789ABCDEF";
 
 isc_result_t
@@ -16049,8 +17454,11 @@ zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm, isc_uint16_t keyid,
 	signing->keyid = keyid;
 	signing->delete = delete;
 	signing->done = ISC_FALSE;
+	signing->nodes = 0;
+	signing->signatures = 0;
 
 	TIME_NOW(&now);
+	signing->start = now;
 
 	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
 	if (zone->db != NULL)
@@ -16946,7 +18354,6 @@ dns_zone_getserialupdatemethod(dns_zone_t *zone) {
  */
 isc_result_t
 dns_zone_link(dns_zone_t *zone, dns_zone_t *raw) {
-	isc_result_t result;
 	dns_zonemgr_t *zmgr;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -16969,19 +18376,6 @@ dns_zone_link(dns_zone_t *zone, dns_zone_t *raw) {
 	LOCK_ZONE(zone);
 	LOCK_ZONE(raw);
 
-	result = isc_timer_create(zmgr->timermgr, isc_timertype_inactive,
-				  NULL, NULL, zone->task, zone_timer, raw,
-				  &raw->timer);
-	if (result != ISC_R_SUCCESS)
-		goto unlock;
-
-	/*
-	 * The timer "holds" a iref.
-	 */
-	raw->irefs++;
-	INSIST(raw->irefs != 0);
-
-
 	/* dns_zone_attach(raw, &zone->raw); */
 	isc_refcount_increment(&raw->erefs, NULL);
 	zone->raw = raw;
@@ -16996,11 +18390,10 @@ dns_zone_link(dns_zone_t *zone, dns_zone_t *raw) {
 	raw->zmgr = zmgr;
 	zmgr->refs++;
 
- unlock:
 	UNLOCK_ZONE(raw);
 	UNLOCK_ZONE(zone);
 	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
-	return (result);
+	return (ISC_R_SUCCESS);
 }
 
 void
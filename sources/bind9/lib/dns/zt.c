@@ -28,6 +28,7 @@
 #include <isc/task.h>
 #include <isc/util.h>
 
+#include <dns/db.h>
 #include <dns/log.h>
 #include <dns/name.h>
 #include <dns/rbt.h>
@@ -134,6 +135,9 @@ dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone) {
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
 
+	if (result == ISC_R_SUCCESS)
+		dns_db_newgeneration();
+
 	return (result);
 }
 
@@ -152,6 +156,9 @@ dns_zt_unmount(dns_zt_t *zt, dns_zone_t *zone) {
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
 
+	if (result == ISC_R_SUCCESS)
+		dns_db_newgeneration();
+
 	return (result);
 }
 
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <isc/histo.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#define ISC_HISTO_MAGIC			ISC_MAGIC('H', 's', 't', 'o')
+#define ISC_HISTO_VALID(x)		ISC_MAGIC_VALID(x, ISC_HISTO_MAGIC)
+
+/*
+ * Bits of a value kept below the leading one; 2^SUBBITS buckets per
+ * power of two.
+ */
+#define SUBBITS		3
+#define SUBBUCKETS	(1 << SUBBITS)
+
+typedef struct histo_shard {
+	isc_uint64_t	buckets[ISC_HISTO_BUCKETS];
+} histo_shard_t;
+
+/*%
+ * Thread N (see isc_thread_ordinal()) counts in shard N without locking,
+ * as no other thread writes to it; threads beyond the last shard share
+ * 'shared' under 'sharedlock'.  isc_histo_merge() reads the per-thread
+ * shards unlocked, so a count may show up there a moment late.
+ */
+struct isc_histo {
+	/*% Unlocked */
+	unsigned int	magic;
+	isc_mem_t	*mctx;
+	unsigned int	nshards;
+	histo_shard_t	*shards;
+
+	isc_mutex_t	sharedlock;
+	histo_shard_t	shared;		/* locked by sharedlock */
+
+	isc_mutex_t	lock;
+	unsigned int	references;	/* locked by lock */
+};
+
+isc_result_t
+isc_histo_create(isc_mem_t *mctx, unsigned int nshards, isc_histo_t **histop)
+{
+	isc_histo_t *histo;
+	isc_result_t result;
+
+	REQUIRE(histop != NULL && *histop == NULL);
+
+	if (nshards == 0)
+		nshards = 1;
+#ifndef ISC_PLATFORM_USETHREADS
+	nshards = 1;
+#endif
+
+	histo = isc_mem_get(mctx, sizeof(*histo));
+	if (histo == NULL)
+		return (ISC_R_NOMEMORY);
+
+	result = isc_mutex_init(&histo->lock);
+	if (result != ISC_R_SUCCESS)
+		goto clean_histo;
+
+	result = isc_mutex_init(&histo->sharedlock);
+	if (result != ISC_R_SUCCESS)
+		goto clean_mutex;
+
+	histo->shards = isc_mem_get(mctx, nshards * sizeof(histo_shard_t));
+	if (histo->shards == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto clean_sharedlock;
+	}
+	memset(histo->shards, 0, nshards * sizeof(histo_shard_t));
+	memset(&histo->shared, 0, sizeof(histo->shared));
+
+	histo->mctx = NULL;
+	isc_mem_attach(mctx, &histo->mctx);
+	histo->nshards = nshards;
+	histo->references = 1;
+	histo->magic = ISC_HISTO_MAGIC;
+
+	*histop = histo;
+	return (ISC_R_SUCCESS);
+
+ clean_sharedlock:
+	DESTROYLOCK(&histo->sharedlock);
+
+ clean_mutex:
+	DESTROYLOCK(&histo->lock);
+
+ clean_histo:
+	isc_mem_put(mctx, histo, sizeof(*histo));
+
+	return (result);
+}
+
+void
+isc_histo_attach(isc_histo_t *histo, isc_histo_t **histop) {
+	REQUIRE(ISC_HISTO_VALID(histo));
+	REQUIRE(histop != NULL && *histop == NULL);
+
+	LOCK(&histo->lock);
+	histo->references++;
+	UNLOCK(&histo->lock);
+
+	*histop = histo;
+}
+
+void
+isc_histo_detach(isc_histo_t **histop) {
+	isc_histo_t *histo;
+	isc_boolean_t free_now;
+
+	REQUIRE(histop != NULL && ISC_HISTO_VALID(*histop));
+
+	histo = *histop;
+	*histop = NULL;
+
+	LOCK(&histo->lock);
+	INSIST(histo->references > 0);
+	free_now = ISC_TF(--histo->references == 0);
+	UNLOCK(&histo->lock);
+
+	if (!free_now)
+		return;
+
+	DESTROYLOCK(&histo->sharedlock);
+	isc_mem_put(histo->mctx, histo->shards,
+		    histo->nshards * sizeof(histo_shard_t));
+	DESTROYLOCK(&histo->lock);
+	histo->magic = 0;
+	isc_mem_putanddetach(&histo->mctx, histo, sizeof(*histo));
+}
+
+static inline unsigned int
+value_bucket(isc_uint64_t value) {
+	unsigned int msb, exp;
+
+	if (value < 2 * SUBBUCKETS)
+		return ((unsigned int)value);
+	if (value > 0xffffffffU)
+		return (ISC_HISTO_BUCKETS - 1);
+
+	for (msb = SUBBITS + 1; (value >> (msb + 1)) != 0; msb++)
+		;
+	exp = msb - SUBBITS;
+	return (exp * SUBBUCKETS + (unsigned int)(value >> exp));
+}
+
+void
+isc_histo_add(isc_histo_t *histo, isc_uint64_t value) {
+	unsigned int bucket;
+#ifdef ISC_PLATFORM_USETHREADS
+	unsigned int ordinal;
+#endif
+
+	REQUIRE(ISC_HISTO_VALID(histo));
+
+	bucket = value_bucket(value);
+
+#ifdef ISC_PLATFORM_USETHREADS
+	ordinal = isc_thread_ordinal();
+	if (ordinal < histo->nshards) {
+		histo->shards[ordinal].buckets[bucket]++;
+		return;
+	}
+
+	LOCK(&histo->sharedlock);
+	histo->shared.buckets[bucket]++;
+	UNLOCK(&histo->sharedlock);
+#else
+	histo->shards[0].buckets[bucket]++;
+#endif
+}
+
+void
+isc_histo_merge(isc_histo_t *histo, isc_uint64_t buckets[ISC_HISTO_BUCKETS],
+		isc_uint64_t *countp)
+{
+	isc_uint64_t count = 0;
+	unsigned int i, b;
+
+	REQUIRE(ISC_HISTO_VALID(histo));
+	REQUIRE(buckets != NULL && countp != NULL);
+
+	LOCK(&histo->sharedlock);
+	memmove(buckets, histo->shared.buckets,
+		ISC_HISTO_BUCKETS * sizeof(buckets[0]));
+	UNLOCK(&histo->sharedlock);
+	for (i = 0; i < histo->nshards; i++)
+		for (b = 0; b < ISC_HISTO_BUCKETS; b++)
+			buckets[b] += histo->shards[i].buckets[b];
+	for (b = 0; b < ISC_HISTO_BUCKETS; b++)
+		count += buckets[b];
+	*countp = count;
+}
+
+void
+isc_histo_bucketrange(unsigned int bucket, isc_uint64_t *minp,
+		      isc_uint64_t *maxp)
+{
+	unsigned int exp;
+	isc_uint64_t mant;
+
+	REQUIRE(bucket < ISC_HISTO_BUCKETS);
+	REQUIRE(minp != NULL && maxp != NULL);
+
+	if (bucket < 2 * SUBBUCKETS) {
+		*minp = *maxp = bucket;
+		return;
+	}
+	exp = bucket / SUBBUCKETS - 1;
+	mant = bucket % SUBBUCKETS + SUBBUCKETS;
+	*minp = mant << exp;
+	*maxp = ((mant + 1) << exp) - 1;
+}
+
+isc_uint64_t
+isc_histo_quantile(const isc_uint64_t buckets[ISC_HISTO_BUCKETS],
+		   isc_uint64_t count, unsigned int permille)
+{
+	isc_uint64_t rank, seen = 0, min, max;
+	unsigned int b;
+
+	REQUIRE(permille <= 1000);
+
+	if (count == 0)
+		return (0);
+
+	/* The smallest rank that covers 'permille' of the values. */
+	rank = (count * permille + 999) / 1000;
+	if (rank == 0)
+		rank = 1;
+	for (b = 0; b < ISC_HISTO_BUCKETS - 1; b++) {
+		seen += buckets[b];
+		if (seen >= rank)
+			break;
+	}
+	isc_histo_bucketrange(b, &min, &max);
+	return (max);
+}
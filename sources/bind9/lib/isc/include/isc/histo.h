@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ISC_HISTO_H
+#define ISC_HISTO_H 1
+
+/*! \file isc/histo.h
+ * \brief Log-linear histograms of unsigned values, such as latencies in
+ * microseconds.
+ *
+ * Values below 16 have a bucket each; above that every power of two is
+ * split into 8 buckets, so a bucket's width is at most 1/8 of its lower
+ * bound.  Values of 2^32 and above are counted in the last bucket.
+ *
+ * Each of the first 'nshards' threads to count (in isc_thread_ordinal()
+ * order) has a set of buckets of its own that it updates without
+ * locking; any other threads share one locked set.  isc_histo_merge()
+ * adds the sets together.
+ */
+
+#include <isc/types.h>
+
+ISC_LANG_BEGINDECLS
+
+#define ISC_HISTO_BUCKETS	240
+
+isc_result_t
+isc_histo_create(isc_mem_t *mctx, unsigned int nshards, isc_histo_t **histop);
+/*%<
+ * Create a histogram with 'nshards' per-thread sets of buckets (at
+ * least one).
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'histop' != NULL && '*histop' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOMEMORY
+ */
+
+void
+isc_histo_attach(isc_histo_t *histo, isc_histo_t **histop);
+/*%<
+ * Attach to a histogram.
+ */
+
+void
+isc_histo_detach(isc_histo_t **histop);
+/*%<
+ * Detach from a histogram, freeing it when the last reference goes.
+ */
+
+void
+isc_histo_add(isc_histo_t *histo, isc_uint64_t value);
+/*%<
+ * Count one occurrence of 'value'.
+ */
+
+void
+isc_histo_merge(isc_histo_t *histo, isc_uint64_t buckets[ISC_HISTO_BUCKETS],
+		isc_uint64_t *countp);
+/*%<
+ * Sum the shards of 'histo' into 'buckets' and the total number of
+ * values into '*countp'.  Counting may continue meanwhile, so the
+ * result is a snapshot that is consistent only per bucket.
+ */
+
+void
+isc_histo_bucketrange(unsigned int bucket, isc_uint64_t *minp,
+		      isc_uint64_t *maxp);
+/*%<
+ * Return the smallest and largest values counted in 'bucket'.
+ *
+ * Requires:
+ *\li	'bucket' < ISC_HISTO_BUCKETS.
+ */
+
+isc_uint64_t
+isc_histo_quantile(const isc_uint64_t buckets[ISC_HISTO_BUCKETS],
+		   isc_uint64_t count, unsigned int permille);
+/*%<
+ * Return an upper bound for the 'permille'/1000 quantile of merged
+ * 'buckets' holding 'count' values, e.g. 990 for the 99th percentile.
+ * Returns 0 when 'count' is 0.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* ISC_HISTO_H */
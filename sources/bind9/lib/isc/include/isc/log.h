@@ -864,6 +864,28 @@ isc_log_closefilelogs(isc_log_t *lctx);
  *	next needed.
  */
 
+isc_result_t
+isc_logfile_roll(isc_logfile_t *file);
+/*%<
+ * Roll 'file' the way an #ISC_LOG_TOFILE channel rolls its file when it
+ * reaches its maximum size: 'file->name' is renamed to 'file->name'.0,
+ * older versions are shifted up and those beyond 'file->versions' are
+ * removed.  Only 'name' and 'versions' are used.  The file should not
+ * be open.
+ *
+ * Notes:
+ *\li	This is for files written outside the logging system that are
+ *	to be rolled like a logging channel's.  Problems renaming or
+ *	removing individual files are reported with syslog().
+ *
+ * Requires:
+ *\li	'file' is not NULL and 'file->name' is a writable string.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS	also when 'file->versions' is #ISC_LOG_ROLLNEVER
+ *\li	Any error from reading the file's directory.
+ */
+
 isc_logcategory_t *
 isc_log_categorybyname(isc_log_t *lctx, const char *name);
 /*%<
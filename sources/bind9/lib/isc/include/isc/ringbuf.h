@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ISC_RINGBUF_H
+#define ISC_RINGBUF_H 1
+
+/*! \file isc/ringbuf.h
+ * \brief Bounded byte queues from many threads to one consumer.
+ *
+ * Each of the first 'nrings' threads to write gets a ring of its own;
+ * only that thread advances the ring's head and only the consumer its
+ * tail, so with atomic loads and stores neither side locks.  Further
+ * threads share one more ring under a lock, as do all rings where
+ * atomic operations are not available.  A write that does not fit is
+ * refused rather than waited for, so writers never block on the
+ * consumer.
+ *
+ * Writes are copied whole: the consumer sees the bytes of a write
+ * either entirely or not at all, so records written with one call
+ * are never split.
+ */
+
+#include <isc/types.h>
+
+ISC_LANG_BEGINDECLS
+
+typedef void
+(*isc_ringbuf_drainfunc_t)(void *arg, unsigned char *data, unsigned int len);
+
+isc_result_t
+isc_ringbuf_create(isc_mem_t *mctx, unsigned int nrings, unsigned int size,
+		   isc_ringbuf_t **ringbufp);
+/*%<
+ * Create 'nrings' rings, plus one shared by any further threads, each
+ * holding 'size' bytes.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'nrings' > 0.
+ *\li	'size' is a power of two.
+ *\li	'ringbufp' != NULL && '*ringbufp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOMEMORY
+ */
+
+void
+isc_ringbuf_destroy(isc_ringbuf_t **ringbufp);
+/*%<
+ * Free the rings and anything still queued in them.  No thread may be
+ * using '*ringbufp'.
+ */
+
+isc_result_t
+isc_ringbuf_putv(isc_ringbuf_t *ringbuf, const isc_region_t *regions,
+		 unsigned int count, isc_boolean_t *wakep);
+/*%<
+ * Append the concatenation of 'count' regions to the calling thread's
+ * ring.  If 'wakep' is not NULL, '*wakep' is set to ISC_TRUE if this
+ * write filled the ring past half way, so the caller may wake the
+ * consumer early, and to ISC_FALSE otherwise.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOSPACE	the ring is too full; nothing was written and
+ *			the write was counted as dropped.
+ */
+
+void
+isc_ringbuf_drain(isc_ringbuf_t *ringbuf, isc_ringbuf_drainfunc_t func,
+		  void *arg);
+/*%<
+ * Empty the rings in turn, calling 'func' with the contents of each
+ * non-empty ring as one contiguous block.  Only one thread may drain
+ * at a time.
+ */
+
+isc_uint64_t
+isc_ringbuf_dropped(isc_ringbuf_t *ringbuf);
+/*%<
+ * Return the number of writes refused so far.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* ISC_RINGBUF_H */
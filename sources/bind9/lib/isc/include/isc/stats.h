@@ -52,6 +52,28 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int nshards);
+/*%<
+ * Like isc_stats_create(), but keep 'nshards' copies of the counters,
+ * each on cache lines of its own.  Every thread updates one copy, chosen
+ * by the order in which threads first use a sharded set, and the copies
+ * are summed by isc_stats_dump().  Heavily updated sets should have a
+ * shard per worker thread so that the threads don't contend for the
+ * counters' cache lines.  In a non-threaded build there is one shard.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -210,6 +210,36 @@ isc_task_create(isc_taskmgr_t *manager, unsigned int quantum,
  *\li	#ISC_R_SHUTTINGDOWN
  */
 
+isc_result_t
+isc_task_createbound(isc_taskmgr_t *manager, unsigned int quantum,
+		     unsigned int threadid, isc_task_t **taskp);
+/*%<
+ * Create a task which is only ever run by one of the manager's worker
+ * threads, 'threadid' modulo the number of workers.  Events sent to a
+ * bound task are kept on that worker's own ready queue, so the memory
+ * the task touches stays in one processor's caches.
+ *
+ * Notes:
+ *
+ *\li	Otherwise the same as isc_task_create().  Without worker threads
+ *	the task is not bound to anything.
+ *
+ *\li	A bound task cannot be made privileged.
+ *
+ * Requires:
+ *
+ *\li	'manager' is a valid task manager.
+ *
+ *\li	taskp != NULL && *taskp == NULL
+ *
+ * Returns:
+ *
+ *\li   #ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_UNEXPECTED
+ *\li	#ISC_R_SHUTTINGDOWN
+ */
+
 void
 isc_task_attach(isc_task_t *source, isc_task_t **targetp);
 /*%<
@@ -786,6 +816,28 @@ isc_taskmgr_excltask(isc_taskmgr_t *mgr, isc_task_t **taskp);
  */
 
 
+isc_result_t
+isc_taskmgr_setaffinity(isc_taskmgr_t *manager, const unsigned int *cpus,
+			unsigned int ncpus);
+/*%<
+ * Restrict worker thread 'n' of 'manager' to processor
+ * 'cpus[n % ncpus]'.  Together with isc_task_createbound() this keeps
+ * a bound task, and the memory it allocates, on one processor (and so
+ * on one NUMA node).
+ *
+ * Requires:
+ *\li	'manager' is a valid task manager.
+ *
+ *\li	'cpus' != NULL && 'ncpus' > 0
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED	no worker threads, or the system cannot
+ *				set thread affinity.
+ *\li	Other errors from isc_thread_setaffinity(); the remaining workers
+ *	are still set.
+ */
+
 #ifdef HAVE_LIBXML2
 
 int
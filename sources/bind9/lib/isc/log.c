@@ -231,10 +231,7 @@ static isc_result_t
 sync_channellist(isc_logconfig_t *lcfg);
 
 static isc_result_t
-greatest_version(isc_logchannel_t *channel, int *greatest);
-
-static isc_result_t
-roll_log(isc_logchannel_t *channel);
+greatest_version(isc_logfile_t *file, int *greatest);
 
 static void
 isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
@@ -1141,7 +1138,7 @@ sync_channellist(isc_logconfig_t *lcfg) {
 }
 
 static isc_result_t
-greatest_version(isc_logchannel_t *channel, int *greatestp) {
+greatest_version(isc_logfile_t *file, int *greatestp) {
 	/* XXXDCL HIGHLY NT */
 	char *basename, *digit_end;
 	const char *dirname;
@@ -1154,15 +1151,14 @@ greatest_version(isc_logchannel_t *channel, int *greatestp) {
 	char *basename2;
 #endif
 
-	REQUIRE(channel->type == ISC_LOG_TOFILE);
-
 	/*
 	 * It is safe to DE_CONST the file.name because it was copied
-	 * with isc_mem_strdup in isc_log_createchannel.
+	 * with isc_mem_strdup in isc_log_createchannel, or by the caller
+	 * of isc_logfile_roll.
 	 */
-	basename = strrchr(FILE_NAME(channel), sep);
+	basename = strrchr(file->name, sep);
 #ifdef _WIN32
-	basename2 = strrchr(FILE_NAME(channel), '\\');
+	basename2 = strrchr(file->name, '\\');
 	if ((basename != NULL && basename2 != NULL && basename2 > basename) ||
 	    (basename == NULL && basename2 != NULL)) {
 		basename = basename2;
@@ -1171,9 +1167,9 @@ greatest_version(isc_logchannel_t *channel, int *greatestp) {
 #endif
 	if (basename != NULL) {
 		*basename++ = '\0';
-		dirname = FILE_NAME(channel);
+		dirname = file->name;
 	} else {
-		DE_CONST(FILE_NAME(channel), basename);
+		DE_CONST(file->name, basename);
 		dirname = ".";
 	}
 	basenamelen = strlen(basename);
@@ -1184,7 +1180,7 @@ greatest_version(isc_logchannel_t *channel, int *greatestp) {
 	/*
 	 * Replace the file separator if it was taken out.
 	 */
-	if (basename != FILE_NAME(channel))
+	if (basename != file->name)
 		*(basename - 1) = sep;
 
 	/*
@@ -1211,23 +1207,25 @@ greatest_version(isc_logchannel_t *channel, int *greatestp) {
 	return (ISC_R_SUCCESS);
 }
 
-static isc_result_t
-roll_log(isc_logchannel_t *channel) {
+isc_result_t
+isc_logfile_roll(isc_logfile_t *file) {
 	int i, n, greatest;
 	char current[PATH_MAX + 1];
 	char new[PATH_MAX + 1];
 	const char *path;
 	isc_result_t result;
 
+	REQUIRE(file != NULL && file->name != NULL);
+
 	/*
 	 * Do nothing (not even excess version trimming) if ISC_LOG_ROLLNEVER
 	 * is specified.  Apparently complete external control over the log
 	 * files is desired.
 	 */
-	if (FILE_VERSIONS(channel) == ISC_LOG_ROLLNEVER)
+	if (file->versions == ISC_LOG_ROLLNEVER)
 		return (ISC_R_SUCCESS);
 
-	path = FILE_NAME(channel);
+	path = file->name;
 
 	/*
 	 * Set greatest_version to the greatest existing version
@@ -1235,30 +1233,30 @@ roll_log(isc_logchannel_t *channel) {
 	 * though the file names are 0 based, so an oldest log of log.1
 	 * is a greatest_version of 2.
 	 */
-	result = greatest_version(channel, &greatest);
+	result = greatest_version(file, &greatest);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
 	/*
 	 * Now greatest should be set to the highest version number desired.
-	 * Since the highest number is one less than FILE_VERSIONS(channel)
+	 * Since the highest number is one less than file->versions
 	 * when not doing infinite log rolling, greatest will need to be
 	 * decremented when it is equal to -- or greater than --
-	 * FILE_VERSIONS(channel).  When greatest is less than
-	 * FILE_VERSIONS(channel), it is already suitable for use as
+	 * file->versions.  When greatest is less than
+	 * file->versions, it is already suitable for use as
 	 * the maximum version number.
 	 */
 
-	if (FILE_VERSIONS(channel) == ISC_LOG_ROLLINFINITE ||
-	    FILE_VERSIONS(channel) > greatest)
+	if (file->versions == ISC_LOG_ROLLINFINITE ||
+	    file->versions > greatest)
 		;		/* Do nothing. */
 	else
 		/*
-		 * When greatest is >= FILE_VERSIONS(channel), it needs to
-		 * be reduced until it is FILE_VERSIONS(channel) - 1.
+		 * When greatest is >= file->versions, it needs to
+		 * be reduced until it is file->versions - 1.
 		 * Remove any excess logs on the way to that value.
 		 */
-		while (--greatest >= FILE_VERSIONS(channel)) {
+		while (--greatest >= file->versions) {
 			n = snprintf(current, sizeof(current), "%s.%d",
 				     path, greatest);
 			if (n >= (int)sizeof(current) || n < 0)
@@ -1293,7 +1291,7 @@ roll_log(isc_logchannel_t *channel) {
 			       isc_result_totext(result));
 	}
 
-	if (FILE_VERSIONS(channel) != 0) {
+	if (file->versions != 0) {
 		n = snprintf(new, sizeof(new), "%s.0", path);
 		if (n >= (int)sizeof(new) || n < 0)
 			result = ISC_R_NOSPACE;
@@ -1355,7 +1353,7 @@ isc_log_open(isc_logchannel_t *channel) {
 	if (result == ISC_R_SUCCESS && roll) {
 		if (FILE_VERSIONS(channel) == ISC_LOG_ROLLNEVER)
 			return (ISC_R_MAXSIZE);
-		result = roll_log(channel);
+		result = isc_logfile_roll(&channel->destination.file);
 		if (result != ISC_R_SUCCESS) {
 			if ((channel->flags & ISC_LOG_OPENERR) == 0) {
 				syslog(LOG_ERR,
@@ -111,7 +111,9 @@ typedef ISC_LIST(debuglink_t)	debuglist_t;
 
 /* List of all active memory contexts. */
 
-static __thread ISC_LIST(isc__mem_t)	contexts;
+typedef ISC_LIST(isc__mem_t)		contextlist_t;
+
+static __thread contextlist_t		contexts;
 static __thread isc_once_t		once = ISC_ONCE_INIT;
 static __thread isc_mutex_t		contextslock;
 static __thread isc_mutex_t 		createlock;
@@ -166,6 +168,12 @@ struct isc__mem {
 
 	unsigned int		memalloc_failures;
 	ISC_LINK(isc__mem_t)	link;
+	/*%
+	 * The context list is per thread, and a context may be destroyed
+	 * by another thread than the one that created it.
+	 */
+	contextlist_t *		contexts;
+	isc_mutex_t *		contextslock;
 };
 
 #define MEMPOOL_MAGIC		ISC_MAGIC('M', 'E', 'M', 'p')
@@ -1012,6 +1020,8 @@ isc__mem_createx2(size_t init_max_size, size_t target_size,
 	LOCK(&contextslock);
 	ISC_LIST_INITANDAPPEND(contexts, ctx, link);
 	UNLOCK(&contextslock);
+	ctx->contexts = &contexts;
+	ctx->contextslock = &contextslock;
 
 	*ctxp = (isc_mem_t *)ctx;
 	return (ISC_R_SUCCESS);
@@ -1055,10 +1065,10 @@ destroy(isc__mem_t *ctx) {
 	unsigned int i;
 	isc_ondestroy_t ondest;
 
-	LOCK(&contextslock);
-	ISC_LIST_UNLINK(contexts, ctx, link);
+	LOCK(ctx->contextslock);
+	ISC_LIST_UNLINK(*ctx->contexts, ctx, link);
 	totallost += ctx->inuse;
-	UNLOCK(&contextslock);
+	UNLOCK(ctx->contextslock);
 
 	ctx->common.impmagic = 0;
 	ctx->common.magic = 0;
@@ -30,6 +30,7 @@ isc_thread_setconcurrency(unsigned int level);
 
 #define isc_thread_self() ((unsigned long)0)
 #define isc_thread_yield() ((void)0)
+#define isc_thread_ordinal() (0U)
 
 ISC_LANG_ENDDECLS
 
@@ -41,9 +41,29 @@ isc_thread_create(isc_threadfunc_t, isc_threadarg_t, isc_thread_t *);
 void
 isc_thread_setconcurrency(unsigned int level);
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, unsigned int cpu);
+/*%<
+ * Restrict 'thread' to run only on processor 'cpu'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_RANGE		'cpu' is larger than the system supports.
+ *\li	#ISC_R_NOTIMPLEMENTED	the system cannot set thread affinity.
+ *\li	#ISC_R_UNEXPECTED
+ */
+
 void
 isc_thread_yield(void);
 
+unsigned int
+isc_thread_ordinal(void);
+/*%<
+ * Return the calling thread's ordinal: threads are numbered from 0 in
+ * the order in which they first call this function, and keep their
+ * number for life.  Suitable for picking per-thread slots in an array.
+ */
+
 /* XXX We could do fancier error handling... */
 
 #define isc_thread_join(t, rp) \
@@ -25,6 +25,8 @@
 #include <sched.h>
 #endif
 
+#include <isc/mutex.h>
+#include <isc/once.h>
 #include <isc/thread.h>
 #include <isc/util.h>
 
@@ -79,6 +81,25 @@ isc_thread_setconcurrency(unsigned int level) {
 #endif
 }
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, unsigned int cpu) {
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SET)
+	cpu_set_t set;
+
+	if (cpu >= CPU_SETSIZE)
+		return (ISC_R_RANGE);
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+		return (ISC_R_UNEXPECTED);
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(thread);
+	UNUSED(cpu);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 void
 isc_thread_yield(void) {
 #if defined(HAVE_SCHED_YIELD)
@@ -89,3 +110,34 @@ isc_thread_yield(void) {
 	pthread_yield_np();
 #endif
 }
+
+static isc_once_t	ordinal_once = ISC_ONCE_INIT;
+static isc_thread_key_t	ordinal_key;
+static isc_mutex_t	ordinal_lock;
+static unsigned int	ordinal_next = 0;	/* locked by ordinal_lock */
+
+static void
+ordinal_initialize(void) {
+	RUNTIME_CHECK(isc_mutex_init(&ordinal_lock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_thread_key_create(&ordinal_key, NULL) == 0);
+}
+
+unsigned int
+isc_thread_ordinal(void) {
+	void *value;
+	unsigned int ordinal;
+
+	RUNTIME_CHECK(isc_once_do(&ordinal_once, ordinal_initialize)
+		      == ISC_R_SUCCESS);
+
+	value = isc_thread_key_getspecific(ordinal_key);
+	if (value != NULL)
+		return ((unsigned int)((size_t)value - 1));
+
+	LOCK(&ordinal_lock);
+	ordinal = ordinal_next++;
+	UNLOCK(&ordinal_lock);
+	(void)isc_thread_key_setspecific(ordinal_key,
+					 (void *)((size_t)ordinal + 1));
+	return (ordinal);
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/atomic.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/platform.h>
+#include <isc/region.h>
+#include <isc/ringbuf.h>
+#include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#define ISC_RINGBUF_MAGIC		ISC_MAGIC('R', 'n', 'g', 'B')
+#define ISC_RINGBUF_VALID(x)		ISC_MAGIC_VALID(x, ISC_RINGBUF_MAGIC)
+
+/*
+ * With atomic loads and stores a ring needs no lock: its owner only
+ * moves 'head' and the consumer only moves 'tail', each after the data
+ * it covers has been copied.  The atomic read of the other side's index
+ * orders the copies against it.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && \
+    defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVEATOMICSTORE)
+#define RINGBUF_LOCKFREE 1
+#define LOAD(p)		((isc_uint32_t)isc_atomic_xadd((p), 0))
+#define STORE(p, v)	isc_atomic_store((p), (isc_int32_t)(v))
+#else
+#define LOAD(p)		((isc_uint32_t)*(p))
+#define STORE(p, v)	(*(p) = (isc_int32_t)(v))
+#endif
+
+#define CACHELINE	64
+
+typedef struct ring {
+	/* Written by the producer. */
+	isc_int32_t		head;
+	isc_uint32_t		dropped;
+	isc_boolean_t		shared;
+	char			pad1[CACHELINE - 12];
+	/* Written by the consumer. */
+	isc_int32_t		tail;
+	char			pad2[CACHELINE - 4];
+	isc_mutex_t		lock;
+	unsigned char		*buf;
+} ring_t;
+
+struct isc_ringbuf {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	unsigned int		nrings;		/* not counting the shared */
+	unsigned int		size;
+	ring_t			*rings;
+	unsigned char		*batch;		/* consumer */
+};
+
+/*%
+ * Thread N (see isc_thread_ordinal()) writes to ring N if there is one,
+ * and otherwise to the shared ring.
+ */
+static inline ring_t *
+thread_ring(isc_ringbuf_t *ringbuf) {
+#ifdef ISC_PLATFORM_USETHREADS
+	unsigned int number = isc_thread_ordinal();
+
+	if (number < ringbuf->nrings)
+		return (&ringbuf->rings[number]);
+	return (&ringbuf->rings[ringbuf->nrings]);
+#else
+	return (&ringbuf->rings[0]);
+#endif
+}
+
+isc_result_t
+isc_ringbuf_create(isc_mem_t *mctx, unsigned int nrings, unsigned int size,
+		   isc_ringbuf_t **ringbufp)
+{
+	isc_ringbuf_t *ringbuf;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(nrings > 0);
+	REQUIRE(size > 0 && (size & (size - 1)) == 0);
+	REQUIRE(ringbufp != NULL && *ringbufp == NULL);
+
+#ifndef ISC_PLATFORM_USETHREADS
+	/* Everything runs in one thread. */
+	nrings = 1;
+#endif
+
+	ringbuf = isc_mem_get(mctx, sizeof(*ringbuf));
+	if (ringbuf == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(ringbuf, 0, sizeof(*ringbuf));
+	ringbuf->nrings = nrings;
+	ringbuf->size = size;
+
+	result = ISC_R_NOMEMORY;
+	ringbuf->batch = isc_mem_get(mctx, size);
+	if (ringbuf->batch == NULL)
+		goto cleanup;
+	ringbuf->rings = isc_mem_get(mctx, (nrings + 1) * sizeof(ring_t));
+	if (ringbuf->rings == NULL)
+		goto cleanup;
+	memset(ringbuf->rings, 0, (nrings + 1) * sizeof(ring_t));
+	for (i = 0; i <= nrings; i++) {
+		ring_t *ring = &ringbuf->rings[i];
+
+		ring->shared = ISC_TF(i == nrings);
+		ring->buf = isc_mem_get(mctx, size);
+		if (ring->buf == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		result = isc_mutex_init(&ring->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, ring->buf, size);
+			ring->buf = NULL;
+			goto cleanup;
+		}
+	}
+
+	isc_mem_attach(mctx, &ringbuf->mctx);
+	ringbuf->magic = ISC_RINGBUF_MAGIC;
+	*ringbufp = ringbuf;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	if (ringbuf->rings != NULL) {
+		for (i = 0; i <= nrings && ringbuf->rings[i].buf != NULL; i++)
+		{
+			DESTROYLOCK(&ringbuf->rings[i].lock);
+			isc_mem_put(mctx, ringbuf->rings[i].buf, size);
+		}
+		isc_mem_put(mctx, ringbuf->rings,
+			    (nrings + 1) * sizeof(ring_t));
+	}
+	if (ringbuf->batch != NULL)
+		isc_mem_put(mctx, ringbuf->batch, size);
+	isc_mem_put(mctx, ringbuf, sizeof(*ringbuf));
+	return (result);
+}
+
+void
+isc_ringbuf_destroy(isc_ringbuf_t **ringbufp) {
+	isc_ringbuf_t *ringbuf;
+	unsigned int i;
+
+	REQUIRE(ringbufp != NULL && ISC_RINGBUF_VALID(*ringbufp));
+	ringbuf = *ringbufp;
+	*ringbufp = NULL;
+
+	for (i = 0; i <= ringbuf->nrings; i++) {
+		DESTROYLOCK(&ringbuf->rings[i].lock);
+		isc_mem_put(ringbuf->mctx, ringbuf->rings[i].buf,
+			    ringbuf->size);
+	}
+	isc_mem_put(ringbuf->mctx, ringbuf->rings,
+		    (ringbuf->nrings + 1) * sizeof(ring_t));
+	isc_mem_put(ringbuf->mctx, ringbuf->batch, ringbuf->size);
+	ringbuf->magic = 0;
+	isc_mem_putanddetach(&ringbuf->mctx, ringbuf, sizeof(*ringbuf));
+}
+
+isc_result_t
+isc_ringbuf_putv(isc_ringbuf_t *ringbuf, const isc_region_t *regions,
+		 unsigned int count, isc_boolean_t *wakep)
+{
+	ring_t *ring;
+	isc_uint32_t head, tail, used, len, off, n;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int i;
+
+	REQUIRE(ISC_RINGBUF_VALID(ringbuf));
+	REQUIRE(regions != NULL || count == 0);
+
+	len = 0;
+	for (i = 0; i < count; i++)
+		len += regions[i].length;
+
+	ring = thread_ring(ringbuf);
+#ifdef RINGBUF_LOCKFREE
+	if (ring->shared)
+		LOCK(&ring->lock);
+#else
+	LOCK(&ring->lock);
+#endif
+	head = (isc_uint32_t)ring->head;
+	tail = LOAD(&ring->tail);
+	used = head - tail;
+	if (len > ringbuf->size - used) {
+		ring->dropped++;
+		result = ISC_R_NOSPACE;
+	} else {
+		off = head & (ringbuf->size - 1);
+		for (i = 0; i < count; i++) {
+			const unsigned char *data = regions[i].base;
+			isc_uint32_t left = regions[i].length;
+
+			while (left > 0) {
+				n = ISC_MIN(left, ringbuf->size - off);
+				memmove(ring->buf + off, data, n);
+				data += n;
+				left -= n;
+				off = (off + n) & (ringbuf->size - 1);
+			}
+		}
+		STORE(&ring->head, head + len);
+	}
+#ifdef RINGBUF_LOCKFREE
+	if (ring->shared)
+		UNLOCK(&ring->lock);
+#else
+	UNLOCK(&ring->lock);
+#endif
+
+	if (wakep != NULL)
+		*wakep = ISC_TF(result == ISC_R_SUCCESS &&
+				used < ringbuf->size / 2 &&
+				used + len >= ringbuf->size / 2);
+	return (result);
+}
+
+void
+isc_ringbuf_drain(isc_ringbuf_t *ringbuf, isc_ringbuf_drainfunc_t func,
+		  void *arg)
+{
+	ring_t *ring;
+	isc_uint32_t head, tail, used, off, n;
+	unsigned int i;
+
+	REQUIRE(ISC_RINGBUF_VALID(ringbuf));
+	REQUIRE(func != NULL);
+
+	for (i = 0; i <= ringbuf->nrings; i++) {
+		ring = &ringbuf->rings[i];
+#ifndef RINGBUF_LOCKFREE
+		LOCK(&ring->lock);
+#endif
+		head = LOAD(&ring->head);
+		tail = (isc_uint32_t)ring->tail;
+		used = head - tail;
+		if (used != 0) {
+			off = tail & (ringbuf->size - 1);
+			n = ISC_MIN(used, ringbuf->size - off);
+			memmove(ringbuf->batch, ring->buf + off, n);
+			memmove(ringbuf->batch + n, ring->buf, used - n);
+			STORE(&ring->tail, head);
+		}
+#ifndef RINGBUF_LOCKFREE
+		UNLOCK(&ring->lock);
+#endif
+		if (used != 0)
+			(func)(arg, ringbuf->batch, used);
+	}
+}
+
+isc_uint64_t
+isc_ringbuf_dropped(isc_ringbuf_t *ringbuf) {
+	isc_uint64_t dropped = 0;
+	unsigned int i;
+
+	REQUIRE(ISC_RINGBUF_VALID(ringbuf));
+
+	for (i = 0; i <= ringbuf->nrings; i++)
+		dropped += ringbuf->rings[i].dropped;
+	return (dropped);
+}
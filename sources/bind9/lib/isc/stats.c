@@ -20,29 +20,44 @@
 
 #include <config.h>
 
+#include <stddef.h>
 #include <string.h>
 
 #include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC			ISC_MAGIC('S', 't', 'a', 't')
 #define ISC_STATS_VALID(x)		ISC_MAGIC_VALID(x, ISC_STATS_MAGIC)
 
 #ifndef ISC_STATS_USEMULTIFIELDS
-#if defined(ISC_RWLOCK_USEATOMIC) && defined(ISC_PLATFORM_HAVEXADD) && !defined(ISC_PLATFORM_HAVEXADDQ)
+#if defined(ISC_PLATFORM_HAVEXADD) && !defined(ISC_PLATFORM_HAVEXADDQ)
 #define ISC_STATS_USEMULTIFIELDS 1
 #else
 #define ISC_STATS_USEMULTIFIELDS 0
 #endif
 #endif	/* ISC_STATS_USEMULTIFIELDS */
 
+/*%
+ * A counter split into 32-bit halves can't be read while its low half
+ * has wrapped and its high half is still to be incremented.  On those
+ * platforms updates hold 'counterlock' shared and readers exclusive,
+ * as long as the rwlock is cheap enough to take on every update.
+ */
+#if ISC_STATS_USEMULTIFIELDS && defined(ISC_RWLOCK_USEATOMIC)
+#define ISC_STATS_LOCKCOUNTERS 1
+#else
+#define ISC_STATS_LOCKCOUNTERS 0
+#endif
+
 #if ISC_STATS_USEMULTIFIELDS
 typedef struct {
 	isc_uint32_t hi;
@@ -52,45 +67,75 @@ typedef struct {
 typedef isc_uint64_t isc_stat_t;
 #endif
 
+/*%
+ * Each shard of counters starts on a cache line of its own, so that
+ * threads counting in different shards never share a line.
+ */
+#define CACHELINE	64
+#define SHARD_STRIDE(n) \
+	(((n) * sizeof(isc_stat_t) + CACHELINE - 1) / CACHELINE * \
+	 (CACHELINE / sizeof(isc_stat_t)))
+
 struct isc_stats {
 	/*% Unlocked */
 	unsigned int	magic;
 	isc_mem_t	*mctx;
 	int		ncounters;
+	unsigned int	nshards;
+	size_t		stride;		/* counters per shard */
 
 	isc_mutex_t	lock;
 	unsigned int	references; /* locked by lock */
 
 	/*%
-	 * Locked by counterlock or unlocked if efficient rwlock is not
-	 * available.
+	 * 'nshards' arrays of 'stride' counters.  A thread only updates
+	 * the shard picked by shard_counters(), with an atomic add where
+	 * available so that threads sharing a shard don't lose counts;
+	 * since no other thread touches the cache line the add is cheap.
+	 * Readers sum the shards, locking only where counters are split
+	 * (see ISC_STATS_LOCKCOUNTERS).
 	 */
-#ifdef ISC_RWLOCK_USEATOMIC
+#if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_t	counterlock;
 #endif
 	isc_stat_t	*counters;
-
-	/*%
-	 * We don't want to lock the counters while we are dumping, so we first
-	 * copy the current counter values into a local array.  This buffer
-	 * will be used as the copy destination.  It's allocated on creation
-	 * of the stats structure so that the dump operation won't fail due
-	 * to memory allocation failure.
-	 * XXX: this approach is weird for non-threaded build because the
-	 * additional memory and the copy overhead could be avoided.  We prefer
-	 * simplicity here, however, under the assumption that this function
-	 * should be only rarely called.
-	 */
-	isc_uint64_t	*copiedcounters;
+	void		*countersbase;	/* unaligned allocation */
+	size_t		counterssize;
 };
 
+/*%
+ * Up to 'nshards' threads each have a shard to themselves.
+ */
+static inline isc_stat_t *
+shard_counters(isc_stats_t *stats) {
+#ifdef ISC_PLATFORM_USETHREADS
+	if (stats->nshards > 1)
+		return (stats->counters +
+			(isc_thread_ordinal() % stats->nshards) *
+			stats->stride);
+#endif
+	return (stats->counters);
+}
+
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, unsigned int nshards,
+	     isc_stats_t **statsp)
+{
 	isc_stats_t *stats;
 	isc_result_t result = ISC_R_SUCCESS;
+	size_t stride, offset;
 
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
+#ifdef ISC_PLATFORM_USETHREADS
+	if (nshards == 0)
+		nshards = 1;
+	stride = (nshards > 1) ? SHARD_STRIDE(ncounters) : (size_t)ncounters;
+#else
+	nshards = 1;
+	stride = ncounters;
+#endif
+
 	stats = isc_mem_get(mctx, sizeof(*stats));
 	if (stats == NULL)
 		return (ISC_R_NOMEMORY);
@@ -99,42 +144,44 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	stats->counters = isc_mem_get(mctx, sizeof(isc_stat_t) * ncounters);
-	if (stats->counters == NULL) {
+	stats->counterssize = sizeof(isc_stat_t) * stride * nshards;
+	if (nshards > 1)
+		stats->counterssize += CACHELINE;
+	stats->countersbase = isc_mem_get(mctx, stats->counterssize);
+	if (stats->countersbase == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto clean_mutex;
 	}
-	stats->copiedcounters = isc_mem_get(mctx,
-					    sizeof(isc_uint64_t) * ncounters);
-	if (stats->copiedcounters == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto clean_counters;
-	}
-
-#ifdef ISC_RWLOCK_USEATOMIC
+#if ISC_STATS_LOCKCOUNTERS
 	result = isc_rwlock_init(&stats->counterlock, 0, 0);
 	if (result != ISC_R_SUCCESS)
-		goto clean_copiedcounters;
+		goto clean_counters;
 #endif
 
+	offset = 0;
+	if (nshards > 1) {
+		offset = (size_t)stats->countersbase % CACHELINE;
+		if (offset != 0)
+			offset = CACHELINE - offset;
+	}
+	stats->counters = (isc_stat_t *)((char *)stats->countersbase + offset);
+
 	stats->references = 1;
-	memset(stats->counters, 0, sizeof(isc_stat_t) * ncounters);
+	memset(stats->countersbase, 0, stats->counterssize);
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
+	stats->nshards = nshards;
+	stats->stride = stride;
 	stats->magic = ISC_STATS_MAGIC;
 
 	*statsp = stats;
 
 	return (result);
 
+#if ISC_STATS_LOCKCOUNTERS
 clean_counters:
-	isc_mem_put(mctx, stats->counters, sizeof(isc_stat_t) * ncounters);
-
-#ifdef ISC_RWLOCK_USEATOMIC
-clean_copiedcounters:
-	isc_mem_put(mctx, stats->copiedcounters,
-		    sizeof(isc_stat_t) * ncounters);
+	isc_mem_put(mctx, stats->countersbase, stats->counterssize);
 #endif
 
 clean_mutex:
@@ -172,14 +219,12 @@ isc_stats_detach(isc_stats_t **statsp) {
 	UNLOCK(&stats->lock);
 
 	if (stats->references == 0) {
-		isc_mem_put(stats->mctx, stats->copiedcounters,
-			    sizeof(isc_stat_t) * stats->ncounters);
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc_stat_t) * stats->ncounters);
-		DESTROYLOCK(&stats->lock);
-#ifdef ISC_RWLOCK_USEATOMIC
+#if ISC_STATS_LOCKCOUNTERS
 		isc_rwlock_destroy(&stats->counterlock);
 #endif
+		isc_mem_put(stats->mctx, stats->countersbase,
+			    stats->counterssize);
+		DESTROYLOCK(&stats->lock);
 		isc_mem_putanddetach(&stats->mctx, stats, sizeof(*stats));
 	}
 }
@@ -193,102 +238,106 @@ isc_stats_ncounters(isc_stats_t *stats) {
 
 static inline void
 incrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = shard_counters(stats);
 	isc_int32_t prev;
 
-#ifdef ISC_RWLOCK_USEATOMIC
-	/*
-	 * We use a "read" lock to prevent other threads from reading the
-	 * counter while we "writing" a counter field.  The write access itself
-	 * is protected by the atomic operation.
-	 */
+#if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_read);
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, 1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, 1);
 	/*
 	 * If the lower 32-bit field overflows, increment the higher field.
-	 * Note that it's *theoretically* possible that the lower field
-	 * overlaps again before the higher field is incremented.  It doesn't
-	 * matter, however, because we don't read the value until
-	 * isc_stats_copy() is called where the whole process is protected
-	 * by the write (exclusive) lock.
+	 * Readers can't see the counter in between, as they hold
+	 * 'counterlock' exclusively.
 	 */
 	if (prev == (isc_int32_t)0xffffffff)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi, 1);
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi, 1);
 #elif defined(ISC_PLATFORM_HAVEXADDQ)
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], 1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], 1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]++;
+	counters[counter]++;
 #endif
 
-#ifdef ISC_RWLOCK_USEATOMIC
+#if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_read);
 #endif
 }
 
 static inline void
 decrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = shard_counters(stats);
 	isc_int32_t prev;
 
-#ifdef ISC_RWLOCK_USEATOMIC
+#if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_read);
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, -1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, -1);
 	if (prev == 0)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi,
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi,
 				-1);
 #elif defined(ISC_PLATFORM_HAVEXADDQ)
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], -1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], -1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]--;
+	counters[counter]--;
 #endif
 
-#ifdef ISC_RWLOCK_USEATOMIC
+#if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_read);
 #endif
 }
 
-static void
-copy_counters(isc_stats_t *stats) {
-	int i;
+/*
+ * Sum 'counter' over the shards.  A decremented counter may be
+ * "negative" in one shard and positive in another; the unsigned sum is
+ * still the right value.
+ */
+static isc_uint64_t
+readcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters;
+	isc_uint64_t value = 0;
+	unsigned int shard;
 
-#ifdef ISC_RWLOCK_USEATOMIC
-	/*
-	 * We use a "write" lock before "reading" the statistics counters as
-	 * an exclusive lock.
-	 */
+#if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
-
+	for (shard = 0; shard < stats->nshards; shard++) {
+		counters = stats->counters + shard * stats->stride;
 #if ISC_STATS_USEMULTIFIELDS
-	for (i = 0; i < stats->ncounters; i++) {
-		stats->copiedcounters[i] =
-				(isc_uint64_t)(stats->counters[i].hi) << 32 |
-				stats->counters[i].lo;
-	}
+		value += (isc_uint64_t)(counters[counter].hi) << 32 |
+			 counters[counter].lo;
 #else
-	UNUSED(i);
-	memmove(stats->copiedcounters, stats->counters,
-		stats->ncounters * sizeof(isc_stat_t));
+		value += counters[counter];
 #endif
-
-#ifdef ISC_RWLOCK_USEATOMIC
+	}
+#if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_write);
 #endif
+
+	return (value);
 }
 
 isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 1, statsp));
+}
+
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int nshards)
+{
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, ncounters, nshards, statsp));
 }
 
 void
@@ -311,16 +360,19 @@ void
 isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn,
 	       void *arg, unsigned int options)
 {
+	isc_uint64_t value;
 	int i;
 
 	REQUIRE(ISC_STATS_VALID(stats));
 
-	copy_counters(stats);
-
+	/*
+	 * Each counter is summed into a local, so concurrent dumps share
+	 * nothing, and 'dump_fn' runs without the counters locked.
+	 */
 	for (i = 0; i < stats->ncounters; i++) {
-		if ((options & ISC_STATSDUMP_VERBOSE) == 0 &&
-		    stats->copiedcounters[i] == 0)
-				continue;
-		dump_fn((isc_statscounter_t)i, stats->copiedcounters[i], arg);
+		value = readcounter(stats, i);
+		if ((options & ISC_STATSDUMP_VERBOSE) == 0 && value == 0)
+			continue;
+		dump_fn((isc_statscounter_t)i, value, arg);
 	}
 }
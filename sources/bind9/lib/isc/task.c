@@ -116,6 +116,7 @@ struct isc__task {
 	char				name[16];
 	void *				tag;
 	/* Locked by task manager lock. */
+	int				threadid;	/*%< -1: any */
 	LINK(isc__task_t)		link;
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
@@ -132,6 +133,26 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+typedef struct isc__taskworker isc__taskworker_t;
+
+#ifdef USE_WORKER_THREADS
+/*%
+ * A worker thread.  Bound tasks are queued on their worker's own ready
+ * list, and each worker sleeps on its own condition so that it can be
+ * woken for its bound tasks alone.
+ */
+struct isc__taskworker {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	isc_thread_t			thread;
+	/* Locked by task manager lock. */
+	isc__tasklist_t			ready_tasks;
+	isc_condition_t			work_available;
+	isc_boolean_t			idle;
+	isc_boolean_t			lastbound;
+};
+#endif /* USE_WORKER_THREADS */
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -139,7 +160,7 @@ struct isc__taskmgr {
 	isc_mutex_t			lock;
 #ifdef ISC_PLATFORM_USETHREADS
 	unsigned int			workers;
-	isc_thread_t *			threads;
+	isc__taskworker_t *		threads;
 #endif /* ISC_PLATFORM_USETHREADS */
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
@@ -148,7 +169,6 @@ struct isc__taskmgr {
 	isc__tasklist_t			ready_priority_tasks;
 	isc_taskmgrmode_t		mode;
 #ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
 	isc_condition_t			exclusive_granted;
 	isc_condition_t			paused;
 #endif /* ISC_PLATFORM_USETHREADS */
@@ -244,14 +264,22 @@ ISC_TASKFUNC_SCOPE isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskmgr_t *manager, isc__taskworker_t *worker);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskmgr_t *manager, isc__taskworker_t *worker);
 
 static inline void
 push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
 
+#ifdef USE_WORKER_THREADS
+static inline void
+wake_readyq(isc__taskmgr_t *manager, isc__task_t *task);
+
+static void
+wake_all(isc__taskmgr_t *manager);
+#endif /* USE_WORKER_THREADS */
+
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
 
@@ -321,7 +349,7 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
+		wake_all(manager);
 	}
 #endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
@@ -332,11 +360,10 @@ task_finished(isc__task_t *task) {
 	isc_mem_put(manager->mctx, task, sizeof(*task));
 }
 
-ISC_TASKFUNC_SCOPE isc_result_t
-isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
-		 isc_task_t **taskp)
+static isc_result_t
+task_create(isc__taskmgr_t *manager, unsigned int quantum,
+	    isc_boolean_t bound, unsigned int threadid, isc_task_t **taskp)
 {
-	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 	isc__task_t *task;
 	isc_boolean_t exiting;
 	isc_result_t result;
@@ -363,6 +390,7 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	task->now = 0;
 	memset(task->name, 0, sizeof(task->name));
 	task->tag = NULL;
+	task->threadid = -1;
 	INIT_LINK(task, link);
 	INIT_LINK(task, ready_link);
 	INIT_LINK(task, ready_priority_link);
@@ -372,6 +400,13 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+#ifdef USE_WORKER_THREADS
+		if (bound)
+			task->threadid = threadid % manager->workers;
+#else
+		UNUSED(bound);
+		UNUSED(threadid);
+#endif /* USE_WORKER_THREADS */
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = ISC_TRUE;
@@ -391,6 +426,22 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	return (ISC_R_SUCCESS);
 }
 
+ISC_TASKFUNC_SCOPE isc_result_t
+isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
+		 isc_task_t **taskp)
+{
+	return (task_create((isc__taskmgr_t *)manager0, quantum, ISC_FALSE, 0,
+			    taskp));
+}
+
+isc_result_t
+isc_task_createbound(isc_taskmgr_t *manager0, unsigned int quantum,
+		     unsigned int threadid, isc_task_t **taskp)
+{
+	return (task_create((isc__taskmgr_t *)manager0, quantum, ISC_TRUE,
+			    threadid, taskp));
+}
+
 ISC_TASKFUNC_SCOPE void
 isc__task_attach(isc_task_t *source0, isc_task_t **targetp) {
 	isc__task_t *source = (isc__task_t *)source0;
@@ -470,7 +521,7 @@ task_ready(isc__task_t *task) {
 	push_readyq(manager, task);
 #ifdef USE_WORKER_THREADS
 	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+		wake_readyq(manager, task);
 #endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
 }
@@ -920,20 +971,25 @@ isc__task_getcurrenttime(isc_task_t *task0, isc_stdtime_t *t) {
 /*
  * Return ISC_TRUE if the current ready list for the manager, which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
- * the manager is currently in normal or privileged execution mode.
+ * the manager is currently in normal or privileged execution mode, is
+ * empty.  In normal mode, the tasks bound to 'worker' (if not NULL) are
+ * also considered.
  *
  * Caller must hold the task manager lock.
  */
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskmgr_t *manager, isc__taskworker_t *worker) {
+	if (manager->mode != isc_taskmgrmode_normal)
+		return (ISC_TF(EMPTY(manager->ready_priority_tasks)));
 
-	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
-	else
-		queue = manager->ready_priority_tasks;
+#ifdef USE_WORKER_THREADS
+	if (worker != NULL && !EMPTY(worker->ready_tasks))
+		return (ISC_FALSE);
+#else
+	UNUSED(worker);
+#endif /* USE_WORKER_THREADS */
 
-	return (ISC_TF(EMPTY(queue)));
+	return (ISC_TF(EMPTY(manager->ready_tasks)));
 }
 
 /*
@@ -942,12 +998,30 @@ empty_readyq(isc__taskmgr_t *manager) {
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
+ * In normal mode a worker takes tasks alternately from its own list of
+ * bound tasks and the shared list, so that neither can starve the other.
+ *
  * Caller must hold the task manager lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskmgr_t *manager, isc__taskworker_t *worker) {
 	isc__task_t *task;
 
+#ifdef USE_WORKER_THREADS
+	if (manager->mode == isc_taskmgrmode_normal && worker != NULL) {
+		task = HEAD(worker->ready_tasks);
+		if (task != NULL &&
+		    (!worker->lastbound || EMPTY(manager->ready_tasks))) {
+			DEQUEUE(worker->ready_tasks, task, ready_link);
+			worker->lastbound = ISC_TRUE;
+			return (task);
+		}
+		worker->lastbound = ISC_FALSE;
+	}
+#else
+	UNUSED(worker);
+#endif /* USE_WORKER_THREADS */
+
 	if (manager->mode == isc_taskmgrmode_normal)
 		task = HEAD(manager->ready_tasks);
 	else
@@ -964,21 +1038,76 @@ pop_readyq(isc__taskmgr_t *manager) {
 }
 
 /*
- * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
- * flag set, then also push it onto the ready_priority_tasks queue.
+ * Push 'task' onto the ready_tasks queue, or the ready queue of its
+ * worker if it is bound to one.  If 'task' has the privilege flag set,
+ * then also push it onto the ready_priority_tasks queue.
  *
  * Caller must hold the task manager lock.
  */
 static inline void
 push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
+#ifdef USE_WORKER_THREADS
+	if (task->threadid >= 0) {
+		ENQUEUE(manager->threads[task->threadid].ready_tasks, task,
+			ready_link);
+		return;
+	}
+#endif /* USE_WORKER_THREADS */
 	ENQUEUE(manager->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
 		ENQUEUE(manager->ready_priority_tasks, task,
 			ready_priority_link);
 }
 
+#ifdef USE_WORKER_THREADS
+/*
+ * Wake a worker to run 'task', which has just been pushed onto a ready
+ * queue: its own worker if it is bound, otherwise any idle one.
+ *
+ * Caller must hold the task manager lock.
+ */
+static inline void
+wake_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
+	isc__taskworker_t *worker;
+	unsigned int i;
+
+	if (task->threadid >= 0) {
+		worker = &manager->threads[task->threadid];
+		if (worker->idle) {
+			worker->idle = ISC_FALSE;
+			SIGNAL(&worker->work_available);
+		}
+		return;
+	}
+
+	for (i = 0; i < manager->workers; i++) {
+		worker = &manager->threads[i];
+		if (worker->idle) {
+			worker->idle = ISC_FALSE;
+			SIGNAL(&worker->work_available);
+			return;
+		}
+	}
+}
+
+/*
+ * Wake every worker.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+wake_all(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->workers; i++) {
+		manager->threads[i].idle = ISC_FALSE;
+		BROADCAST(&manager->threads[i].work_available);
+	}
+}
+#endif /* USE_WORKER_THREADS */
+
 static void
-dispatch(isc__taskmgr_t *manager) {
+dispatch(isc__taskmgr_t *manager, isc__taskworker_t *worker) {
 	isc__task_t *task;
 #ifndef USE_WORKER_THREADS
 	unsigned int total_dispatch_count = 0;
@@ -1056,26 +1185,29 @@ dispatch(isc__taskmgr_t *manager) {
 		 * If a pause has been requested, don't do any work
 		 * until it's been released.
 		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
+		while ((empty_readyq(manager, worker) ||
+			manager->pause_requested ||
 			manager->exclusive_requested) && !FINISHED(manager))
 		{
 			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
 						    ISC_MSGSET_GENERAL,
 						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
+			worker->idle = ISC_TRUE;
+			WAIT(&worker->work_available, &manager->lock);
+			worker->idle = ISC_FALSE;
 			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
 						    ISC_MSGSET_TASK,
 						    ISC_MSG_AWAKE, "awake"));
 		}
 #else /* USE_WORKER_THREADS */
 		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
+		    empty_readyq(manager, worker))
 			break;
 #endif /* USE_WORKER_THREADS */
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
 
-		task = pop_readyq(manager);
+		task = pop_readyq(manager, worker);
 		if (task != NULL) {
 			unsigned int dispatch_count = 0;
 			isc_boolean_t done = ISC_FALSE;
@@ -1253,10 +1385,11 @@ dispatch(isc__taskmgr_t *manager) {
 		 * we're stuck.  Automatically drop privileges at that
 		 * point and continue with the regular ready queue.
 		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
+		if (manager->tasks_running == 0 &&
+		    manager->mode != isc_taskmgrmode_normal &&
+		    empty_readyq(manager, NULL)) {
 			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
+			wake_all(manager);
 		}
 #endif
 	}
@@ -1265,7 +1398,7 @@ dispatch(isc__taskmgr_t *manager) {
 	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
 	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
 			    ready_priority_link);
-	if (empty_readyq(manager))
+	if (empty_readyq(manager, NULL))
 		manager->mode = isc_taskmgrmode_normal;
 #endif
 
@@ -1278,12 +1411,18 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskworker_t *worker = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	/*
+	 * Number the workers before other threads, so that they get the
+	 * per-thread slots of histograms and ring buffers.
+	 */
+	(void)isc_thread_ordinal();
+
+	dispatch(worker->manager, worker);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1299,10 +1438,12 @@ run(void *uap) {
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
-
 #ifdef USE_WORKER_THREADS
+	unsigned int i;
+
+	for (i = 0; i < manager->workers; i++)
+		(void)isc_condition_destroy(&manager->threads[i].work_available);
 	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
 	(void)isc_condition_destroy(&manager->paused);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
@@ -1363,26 +1504,18 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
 	manager->workers = 0;
 	manager->threads = isc_mem_allocate(mctx,
-					    workers * sizeof(isc_thread_t));
+					    workers * sizeof(isc__taskworker_t));
 	if (manager->threads == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto cleanup_lock;
 	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_threads;
-	}
 	if (isc_condition_init(&manager->exclusive_granted) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_condition_init() %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"));
 		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
+		goto cleanup_threads;
 	}
 	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1413,12 +1546,21 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	 * Start workers.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
-				      &manager->threads[manager->workers]) ==
+		isc__taskworker_t *worker = &manager->threads[manager->workers];
+
+		worker->manager = manager;
+		INIT_LIST(worker->ready_tasks);
+		worker->idle = ISC_FALSE;
+		worker->lastbound = ISC_FALSE;
+		if (isc_condition_init(&worker->work_available) !=
+		    ISC_R_SUCCESS)
+			continue;
+		if (isc_thread_create(run, worker, &worker->thread) ==
 		    ISC_R_SUCCESS) {
 			manager->workers++;
 			started++;
-		}
+		} else
+			(void)isc_condition_destroy(&worker->work_available);
 	}
 	UNLOCK(&manager->lock);
 
@@ -1440,8 +1582,6 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
  cleanup_exclusivegranted:
 	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
  cleanup_threads:
 	isc_mem_free(mctx, manager->threads);
  cleanup_lock:
@@ -1533,14 +1673,14 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * there's work left to do, and if there are already no tasks left
 	 * it will cause the workers to see manager->exiting.
 	 */
-	BROADCAST(&manager->work_available);
+	wake_all(manager);
 	UNLOCK(&manager->lock);
 
 	/*
 	 * Wait for all the worker threads to exit.
 	 */
 	for (i = 0; i < manager->workers; i++)
-		(void)isc_thread_join(manager->threads[i], NULL);
+		(void)isc_thread_join(manager->threads[i].thread, NULL);
 #else /* USE_WORKER_THREADS */
 	/*
 	 * Dispatch the shutdown events.
@@ -1596,7 +1736,7 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 		return (ISC_FALSE);
 
 	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
+	is_ready = !empty_readyq(manager, NULL);
 	UNLOCK(&manager->lock);
 
 	return (is_ready);
@@ -1613,7 +1753,7 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
 
-	dispatch(manager);
+	dispatch(manager, NULL);
 
 	return (ISC_R_SUCCESS);
 }
@@ -1637,7 +1777,7 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 	LOCK(&manager->lock);
 	if (manager->pause_requested) {
 		manager->pause_requested = ISC_FALSE;
-		BROADCAST(&manager->work_available);
+		wake_all(manager);
 	}
 	UNLOCK(&manager->lock);
 }
@@ -1704,7 +1844,7 @@ isc__task_endexclusive(isc_task_t *task0) {
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
 	manager->exclusive_requested = ISC_FALSE;
-	BROADCAST(&manager->work_available);
+	wake_all(manager);
 	UNLOCK(&manager->lock);
 #else
 	UNUSED(task0);
@@ -1717,6 +1857,8 @@ isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	isc__taskmgr_t *manager = task->manager;
 	isc_boolean_t oldpriv;
 
+	REQUIRE(!priv || task->threadid < 0);
+
 	LOCK(&task->lock);
 	oldpriv = ISC_TF((task->flags & TASK_F_PRIVILEGED) != 0);
 	if (priv)
@@ -1756,6 +1898,34 @@ isc__task_register(void) {
 }
 #endif
 
+isc_result_t
+isc_taskmgr_setaffinity(isc_taskmgr_t *manager0, const unsigned int *cpus,
+			unsigned int ncpus)
+{
+	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
+#ifdef USE_WORKER_THREADS
+	isc_result_t result, tresult;
+	unsigned int i;
+#endif
+
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(cpus != NULL && ncpus > 0);
+
+#ifdef USE_WORKER_THREADS
+	result = ISC_R_SUCCESS;
+	for (i = 0; i < manager->workers; i++) {
+		tresult = isc_thread_setaffinity(manager->threads[i].thread,
+						 cpus[i % ncpus]);
+		if (tresult != ISC_R_SUCCESS && result == ISC_R_SUCCESS)
+			result = tresult;
+	}
+	return (result);
+#else
+	UNUSED(manager);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* USE_WORKER_THREADS */
+}
+
 isc_boolean_t
 isc_task_exiting(isc_task_t *t) {
 	isc__task_t *task = (isc__task_t *)t;
@@ -25,6 +25,7 @@
 
 #include <isc/hmacmd5.h>
 #include <isc/hmacsha.h>
+#include <isc/iterated_hash.h>
 #include <isc/md5.h>
 #include <isc/sha1.h>
 #include <isc/util.h>
@@ -1782,6 +1783,79 @@ ATF_TC_BODY(isc_hmacmd5, tc) {
 	}
 }
 
+ATF_TC(isc_iterated_hash_multi);
+ATF_TC_HEAD(isc_iterated_hash_multi, tc) {
+	atf_tc_set_md_var(tc, "descr", "batched iterated hashes match "
+			  "isc_iterated_hash() and RFC5155 Appendix A");
+}
+ATF_TC_BODY(isc_iterated_hash_multi, tc) {
+	static const unsigned char rfcsalt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+	static const unsigned char example[] = "\007example";
+	static const unsigned char a_example[] = "\001a\007example";
+	static const int saltlens[] = { 0, 4, 35, 36, 100, 255 };
+	static const int iterations[] = { 0, 1, 12, 150 };
+	unsigned char names[9][64], salt[255];
+	unsigned char hashes[9][ISC_SHA1_DIGESTLENGTH];
+	unsigned char expect[NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[9];
+	const unsigned char *in[9];
+	int inlength[9], len;
+	unsigned int count, i, j, k;
+
+	UNUSED(tc);
+
+	for (i = 0; i < 9; i++)
+		out[i] = hashes[i];
+
+	/* Test vectors */
+	in[0] = example;
+	inlength[0] = sizeof(example);
+	in[1] = a_example;
+	inlength[1] = sizeof(a_example);
+	len = isc_iterated_hash_multi(out, 1, 12, rfcsalt, sizeof(rfcsalt),
+				      in, inlength, 2);
+	ATF_REQUIRE_EQ(len, ISC_SHA1_DIGESTLENGTH);
+	tohexstr(hashes[0], ISC_SHA1_DIGESTLENGTH, str);
+	ATF_CHECK_STREQ(str, "0x065368ABEED7EC6E9FEBA96B8C8BC3E8B791F716");
+	tohexstr(hashes[1], ISC_SHA1_DIGESTLENGTH, str);
+	ATF_CHECK_STREQ(str, "0x196DD8C3306783A8190F52C262D2B7E5E836E7F5");
+
+	/* Unsupported algorithm */
+	ATF_CHECK_EQ(isc_iterated_hash_multi(out, 2, 12, rfcsalt,
+					     sizeof(rfcsalt), in, inlength,
+					     2), 0);
+
+	/* Batches of every size against the single name function. */
+	for (i = 0; i < sizeof(salt); i++)
+		salt[i] = (unsigned char)(i * 7);
+	for (i = 0; i < 9; i++) {
+		inlength[i] = 1 + i * 7;
+		for (j = 0; j < (unsigned int)inlength[i]; j++)
+			names[i][j] = (unsigned char)(i + j);
+		in[i] = names[i];
+	}
+	for (i = 0; i < sizeof(saltlens) / sizeof(saltlens[0]); i++)
+		for (j = 0; j < sizeof(iterations) / sizeof(iterations[0]);
+		     j++)
+			for (count = 1; count <= 9; count++) {
+				len = isc_iterated_hash_multi(out, 1,
+							      iterations[j],
+							      salt,
+							      saltlens[i],
+							      in, inlength,
+							      count);
+				ATF_REQUIRE_EQ(len, ISC_SHA1_DIGESTLENGTH);
+				for (k = 0; k < count; k++) {
+					isc_iterated_hash(expect, 1,
+							  iterations[j],
+							  salt, saltlens[i],
+							  in[k], inlength[k]);
+					ATF_CHECK(memcmp(expect, hashes[k],
+						  ISC_SHA1_DIGESTLENGTH) == 0);
+				}
+			}
+}
+
 /*
  * Main
  */
@@ -1792,6 +1866,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_hmacsha256);
 	ATF_TP_ADD_TC(tp, isc_hmacsha384);
 	ATF_TP_ADD_TC(tp, isc_hmacsha512);
+	ATF_TP_ADD_TC(tp, isc_iterated_hash_multi);
 	ATF_TP_ADD_TC(tp, isc_md5);
 	ATF_TP_ADD_TC(tp, isc_sha1);
 	ATF_TP_ADD_TC(tp, isc_sha224);
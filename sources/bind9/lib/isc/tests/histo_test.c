@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+
+#include <atf-c.h>
+
+#include <isc/histo.h>
+#include <isc/platform.h>
+#include <isc/result.h>
+#include <isc/thread.h>
+
+#include "isctest.h"
+
+ATF_TC(isc_histo_buckets);
+ATF_TC_HEAD(isc_histo_buckets, tc) {
+	atf_tc_set_md_var(tc, "descr", "histogram bucket ranges");
+}
+ATF_TC_BODY(isc_histo_buckets, tc) {
+	isc_uint64_t min, max, prevmax = 0;
+	unsigned int b;
+
+	UNUSED(tc);
+
+	/* Small values are exact. */
+	isc_histo_bucketrange(0, &min, &max);
+	ATF_CHECK_EQ(min, 0);
+	ATF_CHECK_EQ(max, 0);
+	isc_histo_bucketrange(15, &min, &max);
+	ATF_CHECK_EQ(min, 15);
+	ATF_CHECK_EQ(max, 15);
+
+	/* Buckets are contiguous and no wider than 1/8 of their base. */
+	for (b = 1; b < ISC_HISTO_BUCKETS; b++) {
+		isc_histo_bucketrange(b, &min, &max);
+		ATF_CHECK_EQ(min, prevmax + 1);
+		ATF_CHECK(max >= min);
+		if (min >= 16)
+			ATF_CHECK(max - min + 1 <= min / 8);
+		prevmax = max;
+	}
+	ATF_CHECK_EQ(prevmax, (isc_uint64_t)0xffffffffU);
+}
+
+ATF_TC(isc_histo_quantile);
+ATF_TC_HEAD(isc_histo_quantile, tc) {
+	atf_tc_set_md_var(tc, "descr", "histogram counting and quantiles");
+}
+ATF_TC_BODY(isc_histo_quantile, tc) {
+	isc_result_t result;
+	isc_histo_t *histo = NULL, *histo2 = NULL;
+	isc_uint64_t buckets[ISC_HISTO_BUCKETS];
+	isc_uint64_t count, q;
+	unsigned int i;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_histo_create(mctx, 4, &histo);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_histo_merge(histo, buckets, &count);
+	ATF_CHECK_EQ(count, 0);
+	ATF_CHECK_EQ(isc_histo_quantile(buckets, count, 500), 0);
+
+	/* 1..1000 */
+	for (i = 1; i <= 1000; i++)
+		isc_histo_add(histo, i);
+	isc_histo_add(histo, (isc_uint64_t)1 << 40);
+
+	isc_histo_attach(histo, &histo2);
+	isc_histo_merge(histo2, buckets, &count);
+	isc_histo_detach(&histo2);
+	ATF_CHECK_EQ(count, 1001);
+	ATF_CHECK_EQ(buckets[ISC_HISTO_BUCKETS - 1], 1);
+
+	/*
+	 * A quantile is reported as the top of the bucket holding it,
+	 * which is at most 1/8 above the true value.
+	 */
+	q = isc_histo_quantile(buckets, count, 500);
+	ATF_CHECK(q >= 501 && q <= 501 + 501 / 8);
+	q = isc_histo_quantile(buckets, count, 990);
+	ATF_CHECK(q >= 991 && q <= 991 + 991 / 8);
+	q = isc_histo_quantile(buckets, count, 1);
+	ATF_CHECK_EQ(q, 2);
+	q = isc_histo_quantile(buckets, count, 1000);
+	ATF_CHECK_EQ(q, (isc_uint64_t)0xffffffffU);
+
+	isc_histo_detach(&histo);
+	isc_test_end();
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+#define NTHREADS	8
+#define NVALUES		100000
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+add_values(isc_threadarg_t arg) {
+	isc_histo_t *histo = arg;
+	unsigned int i;
+
+	for (i = 0; i < NVALUES; i++)
+		isc_histo_add(histo, i % 16);
+	return ((isc_threadresult_t)0);
+}
+#endif
+
+ATF_TC(isc_histo_threads);
+ATF_TC_HEAD(isc_histo_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "concurrent counting, with more "
+			  "threads than per-thread shards");
+}
+ATF_TC_BODY(isc_histo_threads, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_histo_t *histo = NULL;
+	isc_thread_t threads[NTHREADS];
+	isc_uint64_t buckets[ISC_HISTO_BUCKETS];
+	isc_uint64_t count;
+	unsigned int i;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_histo_create(mctx, NTHREADS / 2, &histo);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(add_values, histo, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+
+	isc_histo_merge(histo, buckets, &count);
+	ATF_CHECK_EQ(count, (isc_uint64_t)NTHREADS * NVALUES);
+	for (i = 0; i < 16; i++)
+		ATF_CHECK_EQ(buckets[i], (isc_uint64_t)NTHREADS * NVALUES / 16);
+
+	isc_histo_detach(&histo);
+	isc_test_end();
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("threads not enabled");
+#endif
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, isc_histo_buckets);
+	ATF_TP_ADD_TC(tp, isc_histo_quantile);
+	ATF_TP_ADD_TC(tp, isc_histo_threads);
+	return (atf_no_error());
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+
+#include <atf-c.h>
+
+#include <isc/region.h>
+#include <isc/result.h>
+#include <isc/ringbuf.h>
+#include <isc/string.h>
+
+#include "isctest.h"
+
+typedef struct {
+	unsigned char	data[256];
+	unsigned int	len;
+	unsigned int	calls;
+} sink_t;
+
+static void
+collect(void *arg, unsigned char *data, unsigned int len) {
+	sink_t *sink = arg;
+
+	ATF_REQUIRE(sink->len + len <= sizeof(sink->data));
+	memmove(sink->data + sink->len, data, len);
+	sink->len += len;
+	sink->calls++;
+}
+
+ATF_TC(isc_ringbuf_putv);
+ATF_TC_HEAD(isc_ringbuf_putv, tc) {
+	atf_tc_set_md_var(tc, "descr", "ring buffer writes, wrap and drops");
+}
+ATF_TC_BODY(isc_ringbuf_putv, tc) {
+	isc_result_t result;
+	isc_ringbuf_t *ringbuf = NULL;
+	unsigned char a[20], b[10];
+	isc_region_t r[2];
+	isc_boolean_t wake;
+	sink_t sink;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_ringbuf_create(mctx, 1, 64, &ringbuf);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < sizeof(a); i++)
+		a[i] = i;
+	for (i = 0; i < sizeof(b); i++)
+		b[i] = 100 + i;
+	r[0].base = a;
+	r[0].length = sizeof(a);
+	r[1].base = b;
+	r[1].length = sizeof(b);
+
+	/* 30 bytes: not yet half full. */
+	result = isc_ringbuf_putv(ringbuf, r, 2, &wake);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(!wake);
+
+	/* 60 bytes: past half way. */
+	result = isc_ringbuf_putv(ringbuf, r, 2, &wake);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(wake);
+
+	/* Does not fit; refused whole and counted. */
+	result = isc_ringbuf_putv(ringbuf, r, 1, &wake);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	ATF_CHECK(!wake);
+	ATF_CHECK_EQ(isc_ringbuf_dropped(ringbuf), 1);
+
+	memset(&sink, 0, sizeof(sink));
+	isc_ringbuf_drain(ringbuf, collect, &sink);
+	ATF_CHECK_EQ(sink.calls, 1);
+	ATF_REQUIRE_EQ(sink.len, 60);
+	ATF_CHECK(memcmp(sink.data, a, sizeof(a)) == 0);
+	ATF_CHECK(memcmp(sink.data + 20, b, sizeof(b)) == 0);
+	ATF_CHECK(memcmp(sink.data + 30, a, sizeof(a)) == 0);
+
+	/* This write wraps around the end of the ring. */
+	result = isc_ringbuf_putv(ringbuf, r, 2, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	memset(&sink, 0, sizeof(sink));
+	isc_ringbuf_drain(ringbuf, collect, &sink);
+	ATF_REQUIRE_EQ(sink.len, 30);
+	ATF_CHECK(memcmp(sink.data, a, sizeof(a)) == 0);
+	ATF_CHECK(memcmp(sink.data + 20, b, sizeof(b)) == 0);
+
+	/* Nothing left. */
+	memset(&sink, 0, sizeof(sink));
+	isc_ringbuf_drain(ringbuf, collect, &sink);
+	ATF_CHECK_EQ(sink.calls, 0);
+
+	isc_ringbuf_destroy(&ringbuf);
+	ATF_CHECK_EQ(ringbuf, NULL);
+	isc_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, isc_ringbuf_putv);
+	return (atf_no_error());
+}
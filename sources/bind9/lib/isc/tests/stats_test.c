@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2015  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+
+#include "isctest.h"
+
+#define NCOUNTERS	5
+#define NTHREADS	6
+#define COUNT		10000
+
+static isc_uint64_t values[NCOUNTERS];
+
+static void
+getvalue(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	UNUSED(arg);
+
+	values[counter] = value;
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+count(void *arg) {
+	isc_stats_t *stats = arg;
+	int i;
+
+	for (i = 0; i < COUNT; i++) {
+		isc_stats_increment(stats, 0);
+		isc_stats_increment(stats, 1);
+		isc_stats_decrement(stats, 1);
+		isc_stats_increment(stats, 3);
+	}
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_stats_shards);
+ATF_TC_HEAD(isc_stats_shards, tc) {
+	atf_tc_set_md_var(tc, "descr", "sharded statistics counters");
+}
+ATF_TC_BODY(isc_stats_shards, tc) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+	unsigned int nthreads = 1;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t threads[NTHREADS];
+	unsigned int i;
+#endif
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Fewer shards than threads, so some are shared. */
+	result = isc_stats_create2(mctx, &stats, NCOUNTERS, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_stats_ncounters(stats), NCOUNTERS);
+
+#ifdef ISC_PLATFORM_USETHREADS
+	nthreads = NTHREADS;
+	for (i = 0; i < nthreads; i++) {
+		result = isc_thread_create(count, stats, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(threads[i], NULL);
+#else
+	(void)count(stats);
+#endif
+	/* The main thread's shard takes the counter "below zero". */
+	isc_stats_decrement(stats, 4);
+	isc_stats_decrement(stats, 4);
+	isc_stats_increment(stats, 4);
+
+	memset(values, 0xff, sizeof(values));
+	isc_stats_dump(stats, getvalue, NULL, ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK_EQ(values[0], nthreads * COUNT);
+	ATF_CHECK_EQ(values[1], 0);
+	ATF_CHECK_EQ(values[2], 0);
+	ATF_CHECK_EQ(values[3], nthreads * COUNT);
+	ATF_CHECK_EQ(values[4], (isc_uint64_t)-1);
+
+	isc_stats_detach(&stats);
+	isc_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, isc_stats_shards);
+	return (atf_no_error());
+}
@@ -25,6 +25,7 @@
 #include <unistd.h>
 
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include "../task_p.h"
@@ -64,6 +65,20 @@ set_and_drop(isc_task_t *task, isc_event_t *event) {
 	isc_taskmgr_setmode(taskmgr, isc_taskmgrmode_normal);
 }
 
+/* task event handler, records the thread it ran on */
+static void
+set_thread(isc_task_t *task, isc_event_t *event) {
+	unsigned long *value = (unsigned long *) event->ev_arg;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	*value = isc_thread_self();
+	counter++;
+	UNLOCK(&set_lock);
+}
+
 /*
  * Individual unit tests
  */
@@ -402,6 +417,66 @@ ATF_TC_BODY(privilege_drop, tc) {
 	isc_test_end();
 }
 
+/* Bound tasks */
+ATF_TC(bound_events);
+ATF_TC_HEAD(bound_events, tc) {
+	atf_tc_set_md_var(tc, "descr", "events for a bound task all run "
+				       "on the same worker thread");
+}
+ATF_TC_BODY(bound_events, tc) {
+	isc_result_t result;
+	isc_task_t *task1 = NULL, *task2 = NULL;
+	isc_event_t *event;
+	unsigned long threads[20];
+	int n, i = 0;
+
+	UNUSED(tc);
+
+	counter = 0;
+
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Worker 'ncpus + 1' is worker 1. */
+	result = isc_task_createbound(taskmgr, 1, 1, &task1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_task_createbound(taskmgr, 1, ncpus + 1, &task2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (n = 0; n < 20; n++) {
+		isc_task_t *task = (n % 2 == 0) ? task1 : task2;
+
+		threads[n] = ~0UL;
+		event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+					   set_thread, &threads[n],
+					   sizeof (isc_event_t));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(task, &event);
+	}
+
+	while (counter < 20 && i++ < 5000) {
+#ifndef ISC_PLATFORM_USETHREADS
+		while (isc__taskmgr_ready(taskmgr))
+			isc__taskmgr_dispatch(taskmgr);
+#endif
+		isc_test_nap(1000);
+	}
+
+	ATF_CHECK_EQ(counter, 20);
+	for (n = 0; n < 20; n++)
+		ATF_CHECK_EQ(threads[n], threads[0]);
+
+	isc_task_destroy(&task1);
+	ATF_REQUIRE_EQ(task1, NULL);
+	isc_task_destroy(&task2);
+	ATF_REQUIRE_EQ(task2, NULL);
+
+	isc_test_end();
+}
+
 /*
  * Main
  */
@@ -410,6 +485,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, all_events);
 	ATF_TP_ADD_TC(tp, privileged_events);
 	ATF_TP_ADD_TC(tp, privilege_drop);
+	ATF_TP_ADD_TC(tp, bound_events);
 
 	return (atf_no_error());
 }
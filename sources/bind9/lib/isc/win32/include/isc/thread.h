@@ -83,6 +83,9 @@ isc_thread_join(isc_thread_t, isc_threadresult_t *);
 void
 isc_thread_setconcurrency(unsigned int level);
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, unsigned int cpu);
+
 int
 isc_thread_key_create(isc_thread_key_t *key, void (*func)(void *));
 
@@ -95,6 +98,9 @@ isc_thread_key_getspecific(isc_thread_key_t);
 int
 isc_thread_key_setspecific(isc_thread_key_t key, void *value);
 
+unsigned int
+isc_thread_ordinal(void);
+
 #define isc_thread_yield() Sleep(0)
 
 ISC_LANG_ENDDECLS
@@ -21,7 +21,9 @@
 
 #include <process.h>
 
+#include <isc/once.h>
 #include <isc/thread.h>
+#include <isc/util.h>
 
 isc_result_t
 isc_thread_create(isc_threadfunc_t start, isc_threadarg_t arg,
@@ -67,6 +69,15 @@ isc_thread_setconcurrency(unsigned int level) {
 	 */
 }
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, unsigned int cpu) {
+	if (cpu >= sizeof(DWORD_PTR) * 8)
+		return (ISC_R_RANGE);
+	if (SetThreadAffinityMask(thread, (DWORD_PTR)1 << cpu) == 0)
+		return (ISC_R_UNEXPECTED);
+	return (ISC_R_SUCCESS);
+}
+
 void *
 isc_thread_key_getspecific(isc_thread_key_t key) {
 	return(TlsGetValue(key));
@@ -88,3 +99,30 @@ int
 isc_thread_key_delete(isc_thread_key_t key) {
 	return (TlsFree(key) ? 0 : GetLastError());
 }
+
+static isc_once_t	ordinal_once = ISC_ONCE_INIT;
+static isc_thread_key_t	ordinal_key;
+static LONG		ordinal_next = 0;
+
+static void
+ordinal_initialize(void) {
+	RUNTIME_CHECK(isc_thread_key_create(&ordinal_key, NULL) == 0);
+}
+
+unsigned int
+isc_thread_ordinal(void) {
+	void *value;
+	unsigned int ordinal;
+
+	RUNTIME_CHECK(isc_once_do(&ordinal_once, ordinal_initialize)
+		      == ISC_R_SUCCESS);
+
+	value = isc_thread_key_getspecific(ordinal_key);
+	if (value != NULL)
+		return ((unsigned int)((size_t)value - 1));
+
+	ordinal = (unsigned int)InterlockedIncrement(&ordinal_next) - 1;
+	(void)isc_thread_key_setspecific(ordinal_key,
+					 (void *)((size_t)ordinal + 1));
+	return (ordinal);
+}
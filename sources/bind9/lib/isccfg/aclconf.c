@@ -303,6 +303,7 @@ cfg_acl_fromconfig2(const cfg_obj_t *caml, const cfg_obj_t *cctx,
 	const cfg_listelt_t *elt;
 	dns_iptable_t *iptab;
 	int new_nest_level = 0;
+	isc_boolean_t absorb;
 
 	if (nest_level != 0)
 		new_nest_level = nest_level - 1;
@@ -310,7 +311,8 @@ cfg_acl_fromconfig2(const cfg_obj_t *caml, const cfg_obj_t *cctx,
 	REQUIRE(target != NULL);
 	REQUIRE(*target == NULL || DNS_ACL_VALID(*target));
 
-	if (*target != NULL) {
+	absorb = ISC_TF(*target != NULL);
+	if (absorb) {
 		/*
 		 * If target already points to an ACL, then we're being
 		 * called recursively to configure a nested ACL.  The
@@ -538,6 +540,16 @@ nested_acl:
 		INSIST(dacl->length <= dacl->alloc);
 	}
 
+	/*
+	 * The ACL is complete unless it is being absorbed into a
+	 * parent, which will compile it when it is.
+	 */
+	if (!absorb) {
+		result = dns_acl_compile(dacl);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
+
 	dns_acl_attach(dacl, target);
 	result = ISC_R_SUCCESS;
 
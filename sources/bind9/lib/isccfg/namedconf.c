@@ -552,6 +552,75 @@ static cfg_type_t cfg_type_rrsetorder = {
 	&cfg_rep_list, &cfg_type_rrsetorderingelement
 };
 
+/*%
+ * Message capture: "capture { client query; resolver; };" and
+ * "capture-output ( file | unix ) <path>;".
+ */
+static const char *capturetype_enums[] = {
+	"all", "client", "resolver", NULL };
+static cfg_type_t cfg_type_capturetype = {
+	"capturetype", cfg_parse_enum, cfg_print_ustring, cfg_doc_enum,
+	&cfg_rep_string, &capturetype_enums
+};
+
+static isc_result_t
+parse_optional_enum(cfg_parser_t *pctx, const cfg_type_t *type,
+		    cfg_obj_t **ret)
+{
+	isc_result_t result;
+
+	CHECK(cfg_peektoken(pctx, 0));
+	if (pctx->token.type == isc_tokentype_string &&
+	    cfg_is_enum(TOKEN_STRING(pctx), type->of))
+		return (cfg_parse_enum(pctx, type, ret));
+	return (cfg_parse_void(pctx, NULL, ret));
+
+ cleanup:
+	return (result);
+}
+
+static void
+doc_optional_enum(cfg_printer_t *pctx, const cfg_type_t *type) {
+	cfg_print_chars(pctx, "[ ", 2);
+	cfg_doc_enum(pctx, type);
+	cfg_print_chars(pctx, " ]", 2);
+}
+
+static const char *capturemode_enums[] = { "query", "response", NULL };
+static cfg_type_t cfg_type_capturemode = {
+	"capturemode", parse_optional_enum, cfg_print_ustring,
+	doc_optional_enum, &cfg_rep_string, &capturemode_enums
+};
+
+static cfg_tuplefielddef_t capturetype_fields[] = {
+	{ "type", &cfg_type_capturetype, 0 },
+	{ "mode", &cfg_type_capturemode, 0 },
+	{ NULL, NULL, 0 }
+};
+static cfg_type_t cfg_type_capturetypemode = {
+	"capturetypemode", cfg_parse_tuple, cfg_print_tuple, cfg_doc_tuple,
+	&cfg_rep_tuple, capturetype_fields
+};
+static cfg_type_t cfg_type_capture = {
+	"capture", cfg_parse_bracketed_list, cfg_print_bracketed_list,
+	cfg_doc_bracketed_list, &cfg_rep_list, &cfg_type_capturetypemode
+};
+
+static const char *captureoutput_enums[] = { "file", "unix", NULL };
+static cfg_type_t cfg_type_captureoutputtype = {
+	"captureoutputtype", cfg_parse_enum, cfg_print_ustring, cfg_doc_enum,
+	&cfg_rep_string, &captureoutput_enums
+};
+static cfg_tuplefielddef_t captureoutput_fields[] = {
+	{ "type", &cfg_type_captureoutputtype, 0 },
+	{ "path", &cfg_type_qstring, 0 },
+	{ NULL, NULL, 0 }
+};
+static cfg_type_t cfg_type_captureoutput = {
+	"captureoutput", cfg_parse_tuple, cfg_print_tuple, cfg_doc_tuple,
+	&cfg_rep_tuple, captureoutput_fields
+};
+
 static keyword_type_t port_kw = { "port", &cfg_type_uint32 };
 
 static cfg_type_t cfg_type_optional_port = {
@@ -831,6 +900,12 @@ static cfg_type_t cfg_type_bracketed_portlist = {
 	&cfg_rep_list, &cfg_type_portrange
 };
 
+static cfg_type_t cfg_type_bracketed_uint32list = {
+	"bracketed_uint32list", cfg_parse_bracketed_list,
+	cfg_print_bracketed_list, cfg_doc_bracketed_list,
+	&cfg_rep_list, &cfg_type_uint32
+};
+
 /*%
  * Clauses that can be found within the top level of the named.conf
  * file only.
@@ -883,6 +958,7 @@ options_clauses[] = {
 	{ "avoid-v4-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "avoid-v6-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "bindkeys-file", &cfg_type_qstring, 0 },
+	{ "capture-output", &cfg_type_captureoutput, 0 },
 	{ "blackhole", &cfg_type_bracketed_aml, 0 },
 	{ "coresize", &cfg_type_size, 0 },
 	{ "datasize", &cfg_type_size, 0 },
@@ -901,6 +977,7 @@ options_clauses[] = {
 	{ "host-statistics-max", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTIMP },
 	{ "hostname", &cfg_type_qstringornone, 0 },
 	{ "interface-interval", &cfg_type_uint32, 0 },
+	{ "keep-response-order", &cfg_type_bracketed_aml, 0 },
 	{ "listen-on", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "listen-on-v6", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "managed-keys-directory", &cfg_type_qstring, 0 },
@@ -913,6 +990,7 @@ options_clauses[] = {
 	{ "pid-file", &cfg_type_qstringornone, 0 },
 	{ "port", &cfg_type_uint32, 0 },
 	{ "querylog", &cfg_type_boolean, 0 },
+	{ "querylog-file", &cfg_type_logfile, 0 },
 	{ "recursing-file", &cfg_type_qstring, 0 },
 	{ "random-device", &cfg_type_qstring, 0 },
 	{ "recursive-clients", &cfg_type_uint32, 0 },
@@ -921,6 +999,7 @@ options_clauses[] = {
 	{ "serial-queries", &cfg_type_uint32, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "serial-query-rate", &cfg_type_uint32, 0 },
 	{ "server-id", &cfg_type_serverid, 0 },
+	{ "share-rdata", &cfg_type_boolean, 0 },
 	{ "stacksize", &cfg_type_size, 0 },
 	{ "statistics-file", &cfg_type_qstring, 0 },
 	{ "statistics-interval", &cfg_type_uint32, CFG_CLAUSEFLAG_NYI },
@@ -939,6 +1018,8 @@ options_clauses[] = {
 	{ "use-v4-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "use-v6-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "version", &cfg_type_qstringornone, 0 },
+	{ "worker-cpus", &cfg_type_bracketed_uint32list, 0 },
+	{ "zone-load-concurrency", &cfg_type_uint32, 0 },
 	{ NULL, NULL, 0 }
 };
 
@@ -1351,6 +1432,7 @@ view_clauses[] = {
 	{ "attach-cache", &cfg_type_astring, 0 },
 	{ "auth-nxdomain", &cfg_type_boolean, CFG_CLAUSEFLAG_NEWDEFAULT },
 	{ "cache-file", &cfg_type_qstring, 0 },
+	{ "capture", &cfg_type_capture, 0 },
 	{ "check-names", &cfg_type_checknames, CFG_CLAUSEFLAG_MULTI },
 	{ "cleaning-interval", &cfg_type_uint32, 0 },
 	{ "clients-per-query", &cfg_type_uint32, 0 },
@@ -1401,6 +1483,7 @@ view_clauses[] = {
 	{ "recursion", &cfg_type_boolean, 0 },
 	{ "request-nsid", &cfg_type_boolean, 0 },
 	{ "resolver-query-timeout", &cfg_type_uint32, 0 },
+	{ "response-cache-entries", &cfg_type_uint32, 0 },
 	{ "rfc2308-type1", &cfg_type_boolean, CFG_CLAUSEFLAG_NYI },
 	{ "root-delegation-only",  &cfg_type_optional_exclude, 0 },
 	{ "rrset-order", &cfg_type_rrsetorder, 0 },
@@ -1410,6 +1493,7 @@ view_clauses[] = {
 	{ "transfer-format", &cfg_type_transferformat, 0 },
 	{ "use-queryport-pool", &cfg_type_boolean, CFG_CLAUSEFLAG_OBSOLETE },
 	{ "zero-no-soa-ttl-cache", &cfg_type_boolean, 0 },
+	{ "zone-index", &cfg_type_qstring, 0 },
 #ifdef ALLOW_FILTER_AAAA_ON_V4
 	{ "filter-aaaa", &cfg_type_bracketed_aml, 0 },
 	{ "filter-aaaa-on-v4", &cfg_type_v4_aaaa, 0 },
@@ -1660,6 +1744,10 @@ cfg_type_t cfg_type_zoneopts = {
 static cfg_clausedef_t
 dlz_clauses[] = {
 	{ "database", &cfg_type_astring, 0 },
+	{ "max-cache-size", &cfg_type_sizenodefault, 0 },
+	{ "max-cache-ttl", &cfg_type_uint32, 0 },
+	{ "max-ncache-ttl", &cfg_type_uint32, 0 },
+	{ "refresh-threads", &cfg_type_uint32, 0 },
 	{ NULL, NULL, 0 }
 };
 static cfg_clausedef_t *
@@ -134,6 +134,11 @@ __unused static const char copyright[] =
 #define	MAXWAIT		10000		/* max ms to wait for response */
 #define	MAXALARM	(60 * 60)	/* max seconds for alarm timeout */
 #define	MAXTOS		255
+#define	MT_MAXTARGETS	(1 << 20)	/* most targets in one run */
+#define	MT_DATALEN	(TIMEVAL_LEN + 4) /* timestamp and round number */
+#define	MT_BURST	64		/* most packets sent or read at once */
+#define	MT_RCVBUF	(4 * 1024 * 1024) /* receive buffer for many targets */
+#define	TV2US(tv)	((double)(tv).tv_sec * 1000000.0 + (tv).tv_usec)
 
 #define	A(bit)		rcvd_tbl[(bit)>>3]	/* identify byte in array */
 #define	B(bit)		(1 << ((bit) & 0x07))	/* identify bit in byte */
@@ -177,6 +182,7 @@ static __thread int options;
 #define	F_WAITTIME	0x400000
 #define	F_CONNECT	0x800000
 #define F_PRTIME	0x1000000
+#define	F_MULTI		0x2000000
 
 /*
  * MAX_DUP_CHK is the number of bits in received table, i.e. the maximum
@@ -229,6 +235,32 @@ static __thread int waittime = MAXWAIT;		/* timeout for each packet */
 static __thread long nrcvtimeout = 0;		/* # of packets we got back after waittime */
 static __thread int icmp_len = 0;		/* length of the ICMP header */
 
+/*
+ * Multiple targets: one entry per target, indexed by the echo ID and
+ * sequence number of the requests sent to it.  Times are in ms.
+ */
+struct mtarget {
+	struct in_addr	addr;
+	u_int32_t	nsent;		/* rounds sent */
+	u_int32_t	nrecv;		/* rounds answered */
+	u_int32_t	ndup;		/* duplicate replies */
+	u_int32_t	window;		/* answered bits of the last 32 rounds */
+	float		tmin;
+	float		tmax;
+	double		tsum;
+	double		tsumsq;
+};
+static __thread struct mtarget *mtargets;
+static __thread u_int32_t nmtargets;		/* # of targets */
+static __thread u_int32_t mtargets_size;	/* # of entries allocated */
+static __thread u_int32_t mtidx;		/* target of the next request */
+static __thread char *mtfile;			/* file of targets */
+static __thread double mtrate;			/* max packets per second */
+static __thread u_long mtreport;		/* seconds between reports */
+static __thread long intv_sent;			/* # sent in this report */
+static __thread long intv_recv;			/* # received in this report */
+static __thread double intv_min, intv_max, intv_sum;
+
 /* timing */
 static __thread int timing;			/* flag to do timing */
 static __thread double tmin = 999999999.0;	/* minimum round trip time */
@@ -245,6 +277,14 @@ static void fill(char *, char *);
 static u_short in_cksum(u_short *, int);
 static void check_status(void);
 static void finish(void) __dead2;
+static void mt_add(struct in_addr);
+static void mt_addspec(const char *);
+static void mt_finish(void) __dead2;
+static int mt_index(const struct icmp *, u_int32_t *);
+static void mt_load(char *const *, int);
+static void mt_loop(struct msghdr *, socklen_t) __dead2;
+static void mt_pack(char *, int, struct sockaddr_in *, struct timeval *, int);
+static void mt_report(void);
 static void pinger(void);
 static char *pr_addr(struct in_addr);
 static char *pr_ntime(n_time);
@@ -354,6 +394,17 @@ ping_main(int argc, char *const *argv)
     tsum = 0.0;        /* sum of all times, for doing average */
     tsumsq = 0.0;        /* sum of all times squared, for std. dev. */
     
+    /* multiple targets */
+    mtargets = NULL;
+    nmtargets = 0;
+    mtargets_size = 0;
+    mtidx = 0;
+    mtfile = NULL;
+    mtrate = 0.0;
+    mtreport = 0;
+    intv_sent = intv_recv = 0;
+    intv_min = intv_max = intv_sum = 0.0;
+
     finish_up = 0;  /* nonzero if we've been told to finish up */
     siginfo_p = 0;
 
@@ -377,7 +428,7 @@ ping_main(int argc, char *const *argv)
 
 	outpack = outpackhdr + sizeof(struct ip);
 	while ((ch = getopt_long(argc, argv,
-	    "AaB:b:Cc:DdfG:g:h:I:i:k:K:Ll:M:m:noP:p:QqRrS:s:T:t:vW:z:",
+	    "AaB:b:Cc:Dde:F:fG:g:h:I:i:k:K:Ll:M:m:noP:p:QqRrS:s:T:t:U:vW:z:",
 	    longopts, NULL)) != -1)
 	{
 		switch(ch) {
@@ -410,6 +461,18 @@ ping_main(int argc, char *const *argv)
 		case 'd':
 			options |= F_SO_DEBUG;
 			break;
+		case 'e':		/* max packets per second */
+			t = strtod(optarg, &ep);
+            if (*ep || ep == optarg || t <= 0.0) {
+                errx(EX_USAGE, "invalid rate: `%s'", optarg);
+            }
+			options |= F_MULTI;
+			mtrate = t;
+			break;
+		case 'F':		/* file of targets */
+			options |= F_MULTI;
+			mtfile = optarg;
+			break;
 		case 'f':
 			if (uid) {
 				errno = EPERM;
@@ -637,6 +700,15 @@ ping_main(int argc, char *const *argv)
             }
 			alarm((unsigned int)alarmtimeout);
 			break;
+		case 'U':		/* seconds between reports */
+			mtreport = strtoul(optarg, &ep, 0);
+            if (*ep || ep == optarg || mtreport < 1 ||
+                mtreport > MAXALARM) {
+                errx(EX_USAGE, "invalid report interval: `%s'",
+                     optarg);
+            }
+			options |= F_MULTI;
+			break;
 		case 'v':
 			options |= F_VERBOSE;
 			break;
@@ -680,9 +752,29 @@ ping_main(int argc, char *const *argv)
         errx(1, "bad interface name");
     }
 
-	if (argc - optind != 1)
-		usage();
-	target = argv[optind];
+	if (argc - optind > 1 ||
+	    (argc - optind == 1 && strchr(argv[optind], '/') != NULL))
+		options |= F_MULTI;
+	if (options & F_MULTI) {
+		if (argc == optind && mtfile == NULL)
+			usage();
+		if (options & (F_FLOOD | F_SWEEP | F_MASK | F_TIME |
+		    F_RROUTE | F_MIF | F_NOLOOP | F_MTTL | F_ONCE |
+		    F_CONNECT) || preload != 0) {
+			errx(EX_USAGE, "-f, -G, -g, -h, -I, -L, -l, -M, -o, "
+			    "-R, -T and -apple-connect cannot be used with "
+			    "multiple targets");
+		}
+		if (datalen < MT_DATALEN) {
+			errx(EX_USAGE, "packet size too small for multiple "
+			    "targets: %d < %d", datalen, MT_DATALEN);
+		}
+		target = NULL;
+	} else {
+		if (argc - optind != 1)
+			usage();
+		target = argv[optind];
+	}
 
 	switch (options & (F_MASK|F_TIME)) {
 	case 0: break;
@@ -755,7 +847,11 @@ ping_main(int argc, char *const *argv)
 	to = &whereto;
 	to->sin_family = AF_INET;
 	to->sin_len = sizeof *to;
-	if (inet_aton(target, &to->sin_addr) != 0) {
+	if (options & F_MULTI) {
+		mt_load(argv + optind, argc - optind);
+		to->sin_addr = mtargets[0].addr;
+		hostname = NULL;
+	} else if (inet_aton(target, &to->sin_addr) != 0) {
 		hostname = target;
 	} else {
 		hp = gethostbyname2(target, AF_INET);
@@ -776,6 +872,8 @@ ping_main(int argc, char *const *argv)
 	do {
 		struct ifaddrs *ifa_list, *ifa;
 		
+		if (options & F_MULTI)
+			break;
 		if (IN_MULTICAST(ntohl(whereto.sin_addr.s_addr)) || whereto.sin_addr.s_addr == INADDR_BROADCAST) {
 			no_dup = 1;
 			break;
@@ -1006,8 +1104,19 @@ ping_main(int argc, char *const *argv)
 	if (uid == 0)
 		(void)setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)&hold,
 		    sizeof(hold));
+	if (options & F_MULTI) {
+		/* Replies from many targets can arrive together. */
+		hold = MT_RCVBUF;
+		(void)setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&hold,
+		    sizeof(hold));
+	}
 
-	if (to->sin_family == AF_INET) {
+	if (options & F_MULTI) {
+		(void)fprintf(thread_stdout, "PING %u targets", nmtargets);
+		if (source)
+			(void)fprintf(thread_stdout, " from %s", shostname);
+		(void)fprintf(thread_stdout, ": %d data bytes\n", datalen);
+	} else if (to->sin_family == AF_INET) {
 		(void)fprintf(thread_stdout, "PING %s (%s)", hostname,
 		    inet_ntoa(to->sin_addr));
 		if (source)
@@ -1076,6 +1185,9 @@ ping_main(int argc, char *const *argv)
 	iov.iov_base = packet;
 	iov.iov_len = IP_MAXPACKET;
 
+	if (options & F_MULTI)
+		mt_loop(&msg, sizeof(ctrl));	/* does not return */
+
 	if (preload == 0)
 		pinger();		/* send the first ping */
 	else {
@@ -1242,6 +1354,7 @@ pinger(void)
 	struct tv32 tv32;
 	struct ip *ip;
 	struct icmp *icp;
+	u_int32_t round;
 	int cc, i;
 	u_char *packet;
 
@@ -1250,10 +1363,24 @@ pinger(void)
 	icp->icmp_type = icmp_type;
 	icp->icmp_code = 0;
 	icp->icmp_cksum = 0;
-	icp->icmp_seq = htons(ntransmitted);
-	icp->icmp_id = ident;			/* ID */
+	if (options & F_MULTI) {
+		/*
+		 * The ID and sequence number carry the index of the
+		 * target and the data its round; see mt_index().
+		 */
+		icp->icmp_seq = htons(mtidx & 0xffff);
+		icp->icmp_id = (ident + (mtidx >> 16)) & 0xffff;
+		whereto.sin_addr = mtargets[mtidx].addr;
+		round = htonl(mtargets[mtidx].nsent);
+		bcopy((void *)&round,
+		    (void *)&outpack[ICMP_MINLEN + phdr_len + TIMEVAL_LEN],
+		    sizeof(round));
+	} else {
+		icp->icmp_seq = htons(ntransmitted);
+		icp->icmp_id = ident;		/* ID */
 
-	CLR(ntransmitted % mx_dup_ck);
+		CLR(ntransmitted % mx_dup_ck);
+	}
 
 	if (datalen >= TIMEVAL_LEN)	/* can we time transfer */
 		timing = 1;
@@ -1283,6 +1410,7 @@ pinger(void)
 		cc += sizeof(struct ip);
 		ip = (struct ip *)outpackhdr;
 		ip->ip_len = cc;
+		ip->ip_dst = whereto.sin_addr;
 		ip->ip_sum = in_cksum((u_short *)outpackhdr, cc);
 		packet = outpackhdr;
 	}
@@ -1337,14 +1465,16 @@ pinger(void)
 	}
 	if (i < 0 || i != cc)  {
 		if (i < 0) {
-			if (options & F_FLOOD && errno == ENOBUFS) {
+			if (options & (F_FLOOD | F_MULTI) &&
+			    errno == ENOBUFS) {
 				usleep(FLOOD_BACKOFF);
 				return;
 			}
             warn("sendto");
 		} else {
             warn("%s: partial write: %d of %d bytes",
-			     hostname, i, cc);
+			     hostname != NULL ? hostname :
+			     inet_ntoa(whereto.sin_addr), i, cc);
 		}
 	}
 	ntransmitted++;
@@ -1770,6 +1900,517 @@ finish(void)
         exit(2);
 }
 
+/*
+ * mt_add --
+ *	Append a target to the table.
+ */
+static void
+mt_add(struct in_addr addr)
+{
+	struct mtarget *mt;
+	u_int32_t size;
+
+	if (IN_MULTICAST(ntohl(addr.s_addr)) ||
+	    addr.s_addr == INADDR_BROADCAST) {
+		errx(EX_USAGE, "%s: multicast and broadcast addresses cannot "
+		    "be used with multiple targets", inet_ntoa(addr));
+	}
+	if (nmtargets == mtargets_size) {
+		if (nmtargets == MT_MAXTARGETS) {
+			errx(EX_USAGE, "too many targets: more than %d",
+			    MT_MAXTARGETS);
+		}
+		size = mtargets_size ? mtargets_size * 2 : 1024;
+		mt = realloc(mtargets, size * sizeof(*mt));
+		if (mt == NULL)
+			err(EX_OSERR, "realloc");
+		mtargets = mt;
+		mtargets_size = size;
+	}
+	mt = &mtargets[nmtargets++];
+	memset(mt, 0, sizeof(*mt));
+	mt->addr = addr;
+}
+
+/*
+ * mt_addspec --
+ *	Add the targets named by a host name, an address or a network in
+ * address/prefix-length form.  The network and broadcast addresses of a
+ * network are skipped unless the prefix is 31 or 32 bits long.
+ */
+static void
+mt_addspec(const char *spec)
+{
+	char buf[MAXHOSTNAMELEN], *ep;
+	const char *p;
+	struct hostent *hp;
+	struct in_addr addr;
+	u_int32_t a, first, last, mask;
+	u_long len;
+
+	if ((p = strchr(spec, '/')) != NULL) {
+		len = strtoul(p + 1, &ep, 10);
+		if ((size_t)(p - spec) >= sizeof(buf) || *ep ||
+		    ep == p + 1 || len > 32) {
+			errx(EX_USAGE, "invalid network: `%s'", spec);
+		}
+		memcpy(buf, spec, p - spec);
+		buf[p - spec] = '\0';
+		if (inet_aton(buf, &addr) == 0)
+			errx(EX_USAGE, "invalid network: `%s'", spec);
+		mask = len ? 0xffffffffU << (32 - len) : 0;
+		first = ntohl(addr.s_addr) & mask;
+		last = first | ~mask;
+		if (len < 31) {
+			first++;
+			last--;
+		}
+		if ((u_int64_t)last - first + 1 >
+		    (u_int64_t)MT_MAXTARGETS - nmtargets) {
+			errx(EX_USAGE, "too many targets: more than %d",
+			    MT_MAXTARGETS);
+		}
+		for (a = first; ; a++) {
+			addr.s_addr = htonl(a);
+			mt_add(addr);
+			if (a == last)
+				break;
+		}
+		return;
+	}
+
+	if (inet_aton(spec, &addr) == 0) {
+		hp = gethostbyname2(spec, AF_INET);
+		if (!hp) {
+			errx(EX_NOHOST, "cannot resolve %s: %s",
+			    spec, hstrerror(h_errno));
+		}
+		if ((unsigned)hp->h_length > sizeof(addr)) {
+			errx(1, "gethostbyname2 returned an illegal address");
+		}
+		memcpy(&addr, hp->h_addr_list[0], sizeof(addr));
+	}
+	mt_add(addr);
+}
+
+/*
+ * mt_load --
+ *	Build the table of targets from the command line and the -F file,
+ * which has one target per line; '#' starts a comment.
+ */
+static void
+mt_load(char *const *targets, int ntargets)
+{
+	FILE *fp;
+	char *line, *p;
+	size_t linecap;
+	int i;
+
+	for (i = 0; i < ntargets; i++)
+		mt_addspec(targets[i]);
+
+	if (mtfile != NULL) {
+		if (strcmp(mtfile, "-") == 0)
+			fp = thread_stdin;
+		else if ((fp = fopen(mtfile, "r")) == NULL)
+			err(EX_NOINPUT, "%s", mtfile);
+		line = NULL;
+		linecap = 0;
+		while (getline(&line, &linecap, fp) > 0) {
+			p = line + strspn(line, " \t");
+			p[strcspn(p, " \t\r\n#")] = '\0';
+			if (*p != '\0')
+				mt_addspec(p);
+		}
+		free(line);
+		if (ferror(fp))
+			err(EX_IOERR, "%s", mtfile);
+		if (fp != thread_stdin)
+			(void)fclose(fp);
+	}
+
+	if (nmtargets == 0)
+		errx(EX_USAGE, "no targets");
+}
+
+/*
+ * mt_index --
+ *	Find the target an echo request or reply belongs to.  The low 16
+ * bits of the index are the sequence number and the rest is added to
+ * our ID, so any number of targets fit in a few IDs from ident up.
+ */
+static int
+mt_index(const struct icmp *icp, u_int32_t *idxp)
+{
+	u_int32_t idx;
+
+	idx = ((u_int32_t)((icp->icmp_id - ident) & 0xffff) << 16) |
+	    ntohs(icp->icmp_seq);
+	if (idx >= nmtargets)
+		return (0);
+	*idxp = idx;
+	return (1);
+}
+
+/*
+ * mt_loop --
+ *	Send requests to all the targets on schedule and collect the
+ * replies until done.  A round sends one request to every target, spread
+ * evenly over the interval or slower if -e says so; a target gets its
+ * next request one interval after its previous one.
+ */
+static void
+mt_loop(struct msghdr *msg, socklen_t ctrllen)
+{
+	struct sockaddr_in *from;
+	struct timeval now, timeout, *tv;
+	struct cmsghdr *cmsg;
+	struct mtarget *mt;
+	fd_set rfds;
+	double due, gap, linger, next, report, rounddue, t;
+	u_long round;
+	long sent;
+	int burst, cc, n, tc;
+
+	if ((unsigned)s >= FD_SETSIZE) {
+		errx(EX_OSERR, "descriptor too large");
+	}
+	from = (struct sockaddr_in *)msg->msg_name;
+	gap = interval * 1000.0 / nmtargets;
+	if (mtrate > 0.0 && 1000000.0 / mtrate > gap)
+		gap = 1000000.0 / mtrate;
+
+	(void)gettimeofday(&now, NULL);
+	t = TV2US(now);
+	next = rounddue = t;
+	report = mtreport ? t + mtreport * 1000000.0 : 0.0;
+	linger = 0.0;
+	round = 0;
+	mtidx = 0;
+
+	while (!finish_up) {
+		check_status();
+		(void)gettimeofday(&now, NULL);
+		t = TV2US(now);
+		if (report != 0.0 && t >= report) {
+			mt_report();
+			report += mtreport * 1000000.0;
+			if (report <= t)
+				report = t + mtreport * 1000000.0;
+		}
+
+		/* Don't make up for more than a second of lost time. */
+		if (t - next > 1000000.0)
+			next = t;
+		for (burst = 0; burst < MT_BURST; burst++) {
+			if ((npackets && round >= (u_long)npackets) ||
+			    t < next || t < rounddue)
+				break;
+			sent = ntransmitted;
+			pinger();
+			if (ntransmitted == sent)
+				break;		/* out of buffers, try again */
+			mt = &mtargets[mtidx];
+			mt->nsent++;
+			mt->window <<= 1;
+			intv_sent++;
+			next += gap;
+			if (++mtidx == nmtargets) {
+				mtidx = 0;
+				round++;
+				rounddue += interval * 1000.0;
+			}
+		}
+
+		if (npackets && round >= (u_long)npackets) {
+			/* Wait for the last replies as for one target. */
+			if (linger == 0.0)
+				linger = t + (nreceived ?
+				    MAX(1000.0, 2 * tmax) : waittime) * 1000.0;
+			if (t >= linger)
+				break;
+			due = linger;
+		} else if (burst == MT_BURST)
+			due = t;
+		else
+			due = MAX(next, rounddue);
+		if (report != 0.0 && report < due)
+			due = report;
+		due = due > t ? due - t : 0.0;
+		timeout.tv_sec = (long)(due / 1000000.0);
+		timeout.tv_usec = (long)(due - timeout.tv_sec * 1000000.0);
+
+		FD_ZERO(&rfds);
+		FD_SET(s, &rfds);
+		n = select(s + 1, &rfds, NULL, NULL, &timeout);
+		if (n <= 0)
+			continue;	/* Timed out or EINTR. */
+
+		/* Read what has arrived, then go back to sending. */
+		for (burst = 0; burst < 4 * MT_BURST; burst++) {
+			msg->msg_controllen = ctrllen;
+			msg->msg_namelen = sizeof(*from);
+			if ((cc = recvmsg(s, msg, MSG_DONTWAIT)) < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					warn("recvmsg");
+				break;
+			}
+			tv = NULL;
+			tc = -1;
+			for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+			    cmsg = CMSG_NXTHDR(msg, cmsg)) {
+#ifdef SO_TIMESTAMP
+				if (cmsg->cmsg_level == SOL_SOCKET &&
+				    cmsg->cmsg_type == SCM_TIMESTAMP &&
+				    cmsg->cmsg_len == CMSG_LEN(sizeof *tv)) {
+					/* Copy to avoid alignment problems: */
+					memcpy(&now, CMSG_DATA(cmsg),
+					    sizeof(now));
+					tv = &now;
+				}
+#endif
+				if (cmsg->cmsg_level == SOL_SOCKET &&
+				    cmsg->cmsg_type == SO_TRAFFIC_CLASS &&
+				    cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+					/* Copy to avoid alignment problems: */
+					memcpy(&tc, CMSG_DATA(cmsg), sizeof(tc));
+				}
+			}
+			if (tv == NULL) {
+				(void)gettimeofday(&now, NULL);
+				tv = &now;
+			}
+			mt_pack((char *)msg->msg_iov->iov_base, cc, from, tv,
+			    tc);
+		}
+	}
+	mt_finish();
+}
+
+/*
+ * mt_pack --
+ *	Account for a packet received in multiple target mode, printing it
+ * unless -q.  A reply counts for its target if it comes from the
+ * target's address for a round sent to it no more than 32 rounds ago
+ * (and within -W); the rounds answered are kept to spot duplicates.
+ */
+static void
+mt_pack(char *buf, int cc, struct sockaddr_in *from, struct timeval *tv,
+    int tc)
+{
+	struct mtarget *mt;
+	struct icmp *icp, *oicmp;
+	struct ip *ip, *oip;
+	struct timeval tv1;
+	struct tv32 tv32;
+	const u_char *tp;
+	double triptime;
+	u_int32_t age, idx, round;
+	int dupflag, hlen, ours;
+
+	ip = (struct ip *)buf;
+	hlen = ip->ip_hl << 2;
+	if (cc < hlen + ICMP_MINLEN) {
+		if (options & F_VERBOSE)
+            warn("packet too short (%d bytes) from %s\n", cc,
+			     inet_ntoa(from->sin_addr));
+		return;
+	}
+	cc -= hlen;
+	icp = (struct icmp *)(buf + hlen);
+
+	if (icp->icmp_type != icmp_type_rsp) {
+		/* Report errors about our requests as pr_pack() does. */
+		oip = (struct ip *)((char *)icp + ICMP_MINLEN);
+		ours = 0;
+		if (cc >= ICMP_MINLEN + (int)sizeof(struct ip) &&
+		    cc >= ICMP_MINLEN + (oip->ip_hl << 2) + ICMP_MINLEN) {
+			oicmp = (struct icmp *)((char *)oip +
+			    (oip->ip_hl << 2));
+			ours = oip->ip_p == IPPROTO_ICMP &&
+			    oicmp->icmp_type == ICMP_ECHO &&
+			    mt_index(oicmp, &idx) &&
+			    oip->ip_dst.s_addr == mtargets[idx].addr.s_addr;
+		}
+		if (((options & F_VERBOSE) && uid == 0) ||
+		    (!(options & F_QUIET2) && ours)) {
+			if (options & F_PRTIME)
+				pr_currenttime();
+			(void)fprintf(thread_stdout, "%d bytes from %s: ", cc,
+			    pr_addr(from->sin_addr));
+			pr_icmph(icp);
+		}
+		return;
+	}
+
+	if (!mt_index(icp, &idx))
+		return;			/* 'Twas not our ECHO */
+	mt = &mtargets[idx];
+	if (from->sin_addr.s_addr != mt->addr.s_addr ||
+	    cc < ICMP_MINLEN + phdr_len + MT_DATALEN)
+		return;
+	tp = (const u_char *)icp + ICMP_MINLEN + phdr_len;
+	/* Copy to avoid alignment problems: */
+	memcpy(&tv32, tp, sizeof(tv32));
+	memcpy(&round, tp + TIMEVAL_LEN, sizeof(round));
+	round = ntohl(round);
+	if (round >= mt->nsent)
+		return;
+	tv1.tv_sec = ntohl(tv32.tv32_sec);
+	tv1.tv_usec = ntohl(tv32.tv32_usec);
+	tvsub(tv, &tv1);
+	triptime = ((double)tv->tv_sec) * 1000.0 +
+	    ((double)tv->tv_usec) / 1000.0;
+
+	age = mt->nsent - 1 - round;
+	if (age >= 32 || (options & F_WAITTIME && triptime > waittime)) {
+		++nrcvtimeout;
+		return;
+	}
+	if (mt->window & (1U << age)) {
+		++mt->ndup;
+		++nrepeats;
+		dupflag = 1;
+	} else {
+		mt->window |= 1U << age;
+		if (mt->nrecv == 0 || triptime < mt->tmin)
+			mt->tmin = triptime;
+		if (mt->nrecv == 0 || triptime > mt->tmax)
+			mt->tmax = triptime;
+		mt->tsum += triptime;
+		mt->tsumsq += triptime * triptime;
+		mt->nrecv++;
+		if (intv_recv == 0 || triptime < intv_min)
+			intv_min = triptime;
+		if (intv_recv == 0 || triptime > intv_max)
+			intv_max = triptime;
+		intv_sum += triptime;
+		intv_recv++;
+		++nreceived;
+		dupflag = 0;
+	}
+	tsum += triptime;
+	tsumsq += triptime * triptime;
+	if (triptime < tmin)
+		tmin = triptime;
+	if (triptime > tmax)
+		tmax = triptime;
+
+	if (options & F_QUIET)
+		return;
+	if (options & F_PRTIME)
+		pr_currenttime();
+	(void)fprintf(thread_stdout, "%d bytes from %s: icmp_seq=%u", cc,
+	    inet_ntoa(from->sin_addr), round);
+	(void)fprintf(thread_stdout, " ttl=%d", ip->ip_ttl);
+	(void)fprintf(thread_stdout, " time=%.3f ms", triptime);
+	if (tc != -1)
+		(void)fprintf(thread_stdout, " tc=%d", tc);
+	if (dupflag)
+		(void)fprintf(thread_stdout, " (DUP!)");
+	if (options & F_AUDIBLE)
+		(void)write(fileno(thread_stdout), &BBELL, 1);
+	(void)putchar('\n');
+}
+
+/*
+ * mt_report --
+ *	Print the totals of the last -U interval over all targets.
+ */
+static void
+mt_report(void)
+{
+
+	if (options & F_PRTIME)
+		pr_currenttime();
+	(void)fprintf(thread_stdout, "%ld packets transmitted, "
+	    "%ld packets received", intv_sent, intv_recv);
+	if (intv_sent)
+		(void)fprintf(thread_stdout, ", %.1f%% packet loss",
+		    intv_recv >= intv_sent ? 0.0 :
+		    (intv_sent - intv_recv) * 100.0 / intv_sent);
+	if (intv_recv)
+		(void)fprintf(thread_stdout,
+		    ", round-trip min/avg/max = %.3f/%.3f/%.3f ms",
+		    intv_min, intv_sum / intv_recv, intv_max);
+	(void)putchar('\n');
+	(void)fflush(thread_stdout);
+	intv_sent = intv_recv = 0;
+	intv_min = intv_max = intv_sum = 0.0;
+}
+
+/*
+ * mt_finish --
+ *	Print out statistics for each target and all of them, and give up.
+ */
+static void
+mt_finish(void)
+{
+	struct mtarget *mt;
+	double avg, vari;
+	u_int32_t alive, i;
+
+	(void)signal(SIGINT, SIG_IGN);
+	(void)signal(SIGALRM, SIG_IGN);
+	(void)putchar('\n');
+	(void)fflush(thread_stdout);
+	(void)fprintf(thread_stdout, "--- %u targets ping statistics ---\n",
+	    nmtargets);
+	for (alive = i = 0; i < nmtargets; i++) {
+		mt = &mtargets[i];
+		(void)fprintf(thread_stdout, "%s: %u transmitted, %u received",
+		    inet_ntoa(mt->addr), mt->nsent, mt->nrecv);
+		if (mt->ndup)
+			(void)fprintf(thread_stdout, ", +%u duplicates",
+			    mt->ndup);
+		if (mt->nsent)
+			(void)fprintf(thread_stdout, ", %.1f%% packet loss",
+			    (mt->nsent - mt->nrecv) * 100.0 / mt->nsent);
+		if (mt->nrecv) {
+			alive++;
+			avg = mt->tsum / mt->nrecv;
+			vari = mt->tsumsq / mt->nrecv - avg * avg;
+			(void)fprintf(thread_stdout,
+			    ", min/avg/max/stddev = %.3f/%.3f/%.3f/%.3f ms",
+			    mt->tmin, avg, mt->tmax,
+			    vari > 0.0 ? sqrt(vari) : 0.0);
+		}
+		(void)putchar('\n');
+	}
+
+	(void)fprintf(thread_stdout, "%u of %u targets answered, ", alive,
+	    nmtargets);
+	(void)fprintf(thread_stdout, "%ld packets transmitted, ",
+	    ntransmitted);
+	(void)fprintf(thread_stdout, "%ld packets received, ", nreceived);
+	if (nrepeats)
+		(void)fprintf(thread_stdout, "+%ld duplicates, ", nrepeats);
+	if (ntransmitted)
+		(void)fprintf(thread_stdout, "%.1f%% packet loss",
+		    ((ntransmitted - nreceived) * 100.0) / ntransmitted);
+	if (nrcvtimeout)
+		(void)fprintf(thread_stdout, ", %ld packets out of wait time",
+		    nrcvtimeout);
+	(void)putchar('\n');
+	if (nreceived) {
+		double n = nreceived + nrepeats;
+		avg = tsum / n;
+		vari = tsumsq / n - avg * avg;
+		(void)fprintf(thread_stdout,
+		    "round-trip min/avg/max/stddev = %.3f/%.3f/%.3f/%.3f ms\n",
+		    tmin, avg, tmax, vari > 0.0 ? sqrt(vari) : 0.0);
+	}
+
+	free(mtargets);
+	mtargets = NULL;
+	if (nreceived)
+		exit(0);
+	else
+		exit(2);
+}
+
 #ifdef notdef
 static char *ttab[] = {
 	"Echo Reply",		/* ip + seq + udata */
@@ -2220,7 +2861,7 @@ static void
 usage(void)
 {
     
-    (void)fprintf(thread_stderr, "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n",
+    (void)fprintf(thread_stderr, "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n",
                   "usage: ping [-AaDdfnoQqRrv] [-c count] [-G sweepmaxsize]",
                   "            [-g sweepminsize] [-h sweepincrsize] [-i wait]",
                   "            [-l preload] [-M mask | time] [-m ttl]" SECOPT " [-p pattern]",
@@ -2229,7 +2870,10 @@ usage(void)
                   "       ping [-AaDdfLnoQqRrv] [-c count] [-I iface] [-i wait]",
                   "            [-l preload] [-M mask | time] [-m ttl]" SECOPT " [-p pattern] [-S src_addr]",
                   "            [-s packetsize] [-T ttl] [-t timeout] [-W waittime]",
-                  "            [-z tos] mcast-group");
+                  "            [-z tos] mcast-group",
+                  "       ping [-aDdnQqrv] [-c count] [-e rate] [-F file] [-i wait] [-m ttl]",
+                  "            [-S src_addr] [-s packetsize] [-t timeout] [-U interval]",
+                  "            [-W waittime] [-z tos] host | network/len ...");
     (void)fprintf(thread_stderr, "Apple specific options (to be specified before mcast-group or host like all options)\n");
     (void)fprintf(thread_stderr, "            -b boundif           # bind the socket to the interface\n");
     (void)fprintf(thread_stderr, "            -k traffic_class     # set traffic class socket option\n");